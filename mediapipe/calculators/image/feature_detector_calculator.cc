@@ -32,6 +32,7 @@
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/framework/port/threadpool.h"
 #include "mediapipe/framework/tool/options_util.h"
+#include "mediapipe/util/tracking/frame_analysis.h"
 #include "tensorflow/lite/interpreter.h"
 
 namespace mediapipe {
@@ -43,6 +44,9 @@ const int kNumThreads = 16;
 // A calculator to apply local feature detection.
 // Input stream:
 //   IMAGE: Input image frame of type ImageFrame from video stream.
+//   FRAME_ANALYSIS: Alternatively to IMAGE, the FrameAnalysis of the input
+//     frame (see FrameAnalysisCalculator), sharing its grayscale frame,
+//     pyramid and features with other calculators.
 // Output streams:
 //   FEATURES: The detected keypoints from input image as vector<cv::KeyPoint>.
 //   PATCHES:  Optional output the extracted patches as vector<cv::Mat>
@@ -57,13 +61,9 @@ class FeatureDetectorCalculator : public CalculatorBase {
 
  private:
   FeatureDetectorCalculatorOptions options_;
-  cv::Ptr<cv::Feature2D> feature_detector_;
+  FrameAnalysis::OrbSettings orb_settings_;
   std::unique_ptr<::mediapipe::ThreadPool> pool_;
 
-  // Create image pyramid based on input image.
-  void ComputeImagePyramid(const cv::Mat& input_image,
-                           std::vector<cv::Mat>* image_pyramid);
-
   // Extract the patch for single feature with image pyramid.
   cv::Mat ExtractPatch(const cv::KeyPoint& feature,
                        const std::vector<cv::Mat>& image_pyramid);
@@ -73,9 +73,15 @@ REGISTER_CALCULATOR(FeatureDetectorCalculator);
 
 ::mediapipe::Status FeatureDetectorCalculator::GetContract(
     CalculatorContract* cc) {
+  RET_CHECK(cc->Inputs().HasTag("IMAGE") ^
+            cc->Inputs().HasTag("FRAME_ANALYSIS"))
+      << "Exactly one of IMAGE or FRAME_ANALYSIS must be specified.";
   if (cc->Inputs().HasTag("IMAGE")) {
     cc->Inputs().Tag("IMAGE").Set<ImageFrame>();
   }
+  if (cc->Inputs().HasTag("FRAME_ANALYSIS")) {
+    cc->Inputs().Tag("FRAME_ANALYSIS").Set<FrameAnalysis>();
+  }
   if (cc->Outputs().HasTag("FEATURES")) {
     cc->Outputs().Tag("FEATURES").Set<std::vector<cv::KeyPoint>>();
   }
@@ -92,9 +98,11 @@ REGISTER_CALCULATOR(FeatureDetectorCalculator);
   options_ =
       tool::RetrieveOptions(cc->Options(), cc->InputSidePackets(), kOptionsTag)
           .GetExtension(FeatureDetectorCalculatorOptions::ext);
-  feature_detector_ = cv::ORB::create(
-      options_.max_features(), options_.scale_factor(),
-      options_.pyramid_level(), kPatchSize - 1, 0, 2, cv::ORB::FAST_SCORE);
+  orb_settings_.max_features = options_.max_features();
+  orb_settings_.scale_factor = options_.scale_factor();
+  orb_settings_.num_levels = options_.pyramid_level();
+  orb_settings_.edge_threshold = kPatchSize - 1;
+  orb_settings_.fast_score = true;
   pool_ = absl::make_unique<::mediapipe::ThreadPool>("ThreadPool", kNumThreads);
   pool_->StartWorkers();
   return ::mediapipe::OkStatus();
@@ -106,13 +114,20 @@ REGISTER_CALCULATOR(FeatureDetectorCalculator);
     // Indicator packet.
     return ::mediapipe::OkStatus();
   }
-  InputStream* input_frame = &(cc->Inputs().Tag("IMAGE"));
-  cv::Mat input_view = formats::MatView(&input_frame->Get<ImageFrame>());
-  cv::Mat grayscale_view;
-  cv::cvtColor(input_view, grayscale_view, cv::COLOR_RGB2GRAY);
+  std::unique_ptr<FrameAnalysis> image_analysis;
+  const FrameAnalysis* analysis;
+  if (cc->Inputs().HasTag("FRAME_ANALYSIS")) {
+    analysis = &cc->Inputs().Tag("FRAME_ANALYSIS").Get<FrameAnalysis>();
+  } else {
+    InputStream* input_frame = &(cc->Inputs().Tag("IMAGE"));
+    cv::Mat input_view = formats::MatView(&input_frame->Get<ImageFrame>());
+    cv::Mat grayscale_view;
+    cv::cvtColor(input_view, grayscale_view, cv::COLOR_RGB2GRAY);
+    image_analysis = absl::make_unique<FrameAnalysis>(grayscale_view);
+    analysis = image_analysis.get();
+  }
 
-  std::vector<cv::KeyPoint> keypoints;
-  feature_detector_->detect(grayscale_view, keypoints);
+  std::vector<cv::KeyPoint> keypoints = analysis->Orb(orb_settings_).keypoints;
   if (keypoints.size() > options_.max_features()) {
     keypoints.resize(options_.max_features());
   }
@@ -126,15 +141,15 @@ REGISTER_CALCULATOR(FeatureDetectorCalculator);
     auto landmarks_ptr = absl::make_unique<NormalizedLandmarkList>();
     for (int j = 0; j < keypoints.size(); ++j) {
       auto feature_landmark = landmarks_ptr->add_landmark();
-      feature_landmark->set_x(keypoints[j].pt.x / grayscale_view.cols);
-      feature_landmark->set_y(keypoints[j].pt.y / grayscale_view.rows);
+      feature_landmark->set_x(keypoints[j].pt.x / analysis->width());
+      feature_landmark->set_y(keypoints[j].pt.y / analysis->height());
     }
     cc->Outputs().Tag("LANDMARKS").Add(landmarks_ptr.release(), timestamp);
   }
 
   if (cc->Outputs().HasTag("PATCHES")) {
-    std::vector<cv::Mat> image_pyramid;
-    ComputeImagePyramid(grayscale_view, &image_pyramid);
+    const std::vector<cv::Mat>& image_pyramid = analysis->Pyramid(
+        options_.scale_factor(), options_.pyramid_level());
     std::vector<cv::Mat> patch_mat;
     patch_mat.resize(keypoints.size());
     absl::BlockingCounter counter(keypoints.size());
@@ -179,18 +194,6 @@ REGISTER_CALCULATOR(FeatureDetectorCalculator);
   return ::mediapipe::OkStatus();
 }
 
-void FeatureDetectorCalculator::ComputeImagePyramid(
-    const cv::Mat& input_image, std::vector<cv::Mat>* image_pyramid) {
-  cv::Mat tmp_image = input_image;
-  cv::Mat src_image = input_image;
-  for (int i = 0; i < options_.pyramid_level(); ++i) {
-    image_pyramid->push_back(src_image);
-    cv::resize(src_image, tmp_image, cv::Size(), 1.0f / options_.scale_factor(),
-               1.0f / options_.scale_factor());
-    src_image = tmp_image;
-  }
-}
-
 cv::Mat FeatureDetectorCalculator::ExtractPatch(
     const cv::KeyPoint& feature, const std::vector<cv::Mat>& image_pyramid) {
   cv::Mat img = image_pyramid[feature.octave];
@@ -15,6 +15,7 @@
 #include "mediapipe/calculators/image/image_transformation_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/image_frame_allocator.h"
 #include "mediapipe/framework/formats/image_frame_opencv.h"
 #include "mediapipe/framework/port/opencv_core_inc.h"
 #include "mediapipe/framework/port/opencv_imgproc_inc.h"
@@ -211,6 +212,7 @@ REGISTER_CALCULATOR(ImageTransformationCalculator);
     RET_CHECK(cc->Outputs().HasTag(kImageFrameTag));
     cc->Inputs().Tag(kImageFrameTag).Set<ImageFrame>();
     cc->Outputs().Tag(kImageFrameTag).Set<ImageFrame>();
+    cc->UseService(kImageFrameAllocatorService).Optional();
   }
 #if !defined(MEDIAPIPE_DISABLE_GPU)
   if (cc->Inputs().HasTag(kGpuBufferTag)) {
@@ -472,8 +474,14 @@ REGISTER_CALCULATOR(ImageTransformationCalculator);
     flipped_mat = rotated_mat;
   }
 
-  std::unique_ptr<ImageFrame> output_frame(
-      new ImageFrame(format, output_width, output_height));
+  std::unique_ptr<ImageFrame> output_frame;
+  if (cc->Service(kImageFrameAllocatorService).IsAvailable()) {
+    output_frame = cc->Service(kImageFrameAllocatorService)
+                       .GetObject()
+                       .NewImageFrame(format, output_width, output_height);
+  } else {
+    output_frame.reset(new ImageFrame(format, output_width, output_height));
+  }
   cv::Mat output_mat = formats::MatView(output_frame.get());
   flipped_mat.copyTo(output_mat);
   cc->Outputs()
@@ -22,6 +22,7 @@
 #include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/util/resource_util.h"
 #include "mediapipe/util/tflite/config.h"
+#include "mediapipe/util/tflite/normalize_image.h"
 #include "tensorflow/lite/error_reporter.h"
 #include "tensorflow/lite/interpreter.h"
 
@@ -345,13 +346,10 @@ bool ShouldUseGpu(CC* cc) {
       uint8* tensor_buffer = tensor->data.uint8;
       RET_CHECK(tensor_buffer);
       for (int row = 0; row < height; ++row) {
-        for (int col = 0; col < width; ++col) {
-          for (int channel = 0; channel < channels_preserved; ++channel) {
-            *tensor_buffer++ = image_buffer[channel];
-          }
-          image_buffer += channels;
-        }
-        image_buffer += width_padding;
+        PackImageRow(image_buffer, width, channels, channels_preserved,
+                     tensor_buffer);
+        tensor_buffer += width * channels_preserved;
+        image_buffer += width * channels + width_padding;
       }
     } else {
       float* tensor_buffer = tensor->data.f;
@@ -689,42 +687,26 @@ template <class T>
   const int width = image_frame.Width();
   const int channels = image_frame.NumberOfChannels();
   const int channels_preserved = std::min(channels, max_num_channels_);
-  const int channels_ignored = channels - channels_preserved;
 
+  // If the output float range is set and we are not using custom
+  // normalization, normalize the pixel values from [0, 255] to the specified
+  // output range. Otherwise normalize them to [0, 1], with a zero bias.
+  // Verified that there are no precision issues with 1.0f / 255.0f expression
+  float scale = 1.0f / 255.0f;
+  float bias = 0.0f;
   if (output_range_.has_value()) {
-    // If the output float range is set and we are not using custom
-    // normalization, normalize the pixel values from [0, 255] to the specified
-    // output range.
     RET_CHECK_NE(output_range_->first, output_range_->second);
-    const float scale = (output_range_->second - output_range_->first) / 255.0f;
-    const float bias = output_range_->first;
-
-    for (int i = 0; i < height; ++i) {
-      const T* image_ptr = reinterpret_cast<const T*>(
-          image_frame.PixelData() +
-          (flip_vertically ? height - 1 - i : i) * image_frame.WidthStep());
-      for (int j = 0; j < width; ++j) {
-        for (int c = 0; c < channels_preserved; ++c) {
-          *tensor_ptr++ = *image_ptr++ * scale + bias;
-        }
-        image_ptr += channels_ignored;
-      }
-    }
-  } else {
-    // [0,1], scale only (bias == 0)
-    // Verified that there are no precision issues with 1.0f / 255.0f expression
-    const float scale = 1.0f / 255.0f;
-    for (int i = 0; i < height; ++i) {
-      const T* image_ptr = reinterpret_cast<const T*>(
-          image_frame.PixelData() +
-          (flip_vertically ? height - 1 - i : i) * image_frame.WidthStep());
-      for (int j = 0; j < width; ++j) {
-        for (int c = 0; c < channels_preserved; ++c) {
-          *tensor_ptr++ = *image_ptr++ * scale;
-        }
-        image_ptr += channels_ignored;
-      }
-    }
+    scale = (output_range_->second - output_range_->first) / 255.0f;
+    bias = output_range_->first;
+  }
+
+  for (int i = 0; i < height; ++i) {
+    const T* image_ptr = reinterpret_cast<const T*>(
+        image_frame.PixelData() +
+        (flip_vertically ? height - 1 - i : i) * image_frame.WidthStep());
+    NormalizeImageRow(image_ptr, width, channels, channels_preserved, scale,
+                      bias, tensor_ptr);
+    tensor_ptr += width * channels_preserved;
   }
 
   return ::mediapipe::OkStatus();
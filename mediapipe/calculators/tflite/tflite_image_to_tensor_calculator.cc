@@ -0,0 +1,416 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "mediapipe/calculators/tflite/tflite_image_to_tensor_calculator.pb.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/rect.pb.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "tensorflow/lite/interpreter.h"
+
+namespace {
+constexpr char kImageFrameTag[] = "IMAGE";
+constexpr char kNormRectTag[] = "NORM_RECT";
+constexpr char kTensorsTag[] = "TENSORS";
+constexpr char kLetterboxPaddingTag[] = "LETTERBOX_PADDING";
+}  // namespace
+
+namespace mediapipe {
+
+namespace {
+
+// Samples an 8-bit ImageFrame with bilinear interpolation.
+class BilinearSampler {
+ public:
+  BilinearSampler(const ImageFrame& image_frame, int channels_preserved,
+                  bool replicate_border)
+      : pixels_(image_frame.PixelData()),
+        width_(image_frame.Width()),
+        height_(image_frame.Height()),
+        width_step_(image_frame.WidthStep()),
+        channels_(image_frame.NumberOfChannels()),
+        channels_preserved_(channels_preserved),
+        replicate_border_(replicate_border) {}
+
+  // Writes the preserved channel values at (x, y), where the pixel centers
+  // are at integral coordinates.
+  void Sample(float x, float y, float* values) const {
+    const int x0 = static_cast<int>(std::floor(x));
+    const int y0 = static_cast<int>(std::floor(y));
+    const float ax = x - x0;
+    const float ay = y - y0;
+    if (x0 >= 0 && y0 >= 0 && x0 + 1 < width_ && y0 + 1 < height_) {
+      const uint8* p00 = pixels_ + y0 * width_step_ + x0 * channels_;
+      const uint8* p10 = p00 + channels_;
+      const uint8* p01 = p00 + width_step_;
+      const uint8* p11 = p01 + channels_;
+      for (int c = 0; c < channels_preserved_; ++c) {
+        const float top = p00[c] + ax * (p10[c] - p00[c]);
+        const float bottom = p01[c] + ax * (p11[c] - p01[c]);
+        values[c] = top + ay * (bottom - top);
+      }
+      return;
+    }
+    // At the border of the image, some of the four pixels are outside of it.
+    for (int c = 0; c < channels_preserved_; ++c) {
+      const float p00 = Value(x0, y0, c);
+      const float p10 = Value(x0 + 1, y0, c);
+      const float p01 = Value(x0, y0 + 1, c);
+      const float p11 = Value(x0 + 1, y0 + 1, c);
+      const float top = p00 + ax * (p10 - p00);
+      const float bottom = p01 + ax * (p11 - p01);
+      values[c] = top + ay * (bottom - top);
+    }
+  }
+
+ private:
+  float Value(int x, int y, int c) const {
+    if (x < 0 || y < 0 || x >= width_ || y >= height_) {
+      if (!replicate_border_) {
+        return 0.0f;
+      }
+      x = std::min(std::max(x, 0), width_ - 1);
+      y = std::min(std::max(y, 0), height_ - 1);
+    }
+    return pixels_[y * width_step_ + x * channels_ + c];
+  }
+
+  const uint8* pixels_;
+  const int width_;
+  const int height_;
+  const int width_step_;
+  const int channels_;
+  const int channels_preserved_;
+  const bool replicate_border_;
+};
+
+// Stores a sampled value into a float or a quantized tensor.
+inline void StoreValue(float value, float scale, float bias, float* out) {
+  *out = value * scale + bias;
+}
+inline void StoreValue(float value, float scale, float bias, uint8* out) {
+  *out = static_cast<uint8>(std::min(std::max(value + 0.5f, 0.0f), 255.0f));
+}
+
+}  // namespace
+
+// Calculator for cropping, resizing, letterboxing and normalizing an
+// ImageFrame into a TfLiteTensor in a single pass.
+//
+// It replaces a chain of ImageTransformationCalculator (or
+// ImageCroppingCalculator) and TfLiteConverterCalculator on CPU: each tensor
+// value is sampled bilinearly from the region of interest of the input image
+// and normalized as it is written, so that no intermediate ImageFrame is
+// produced.
+//
+// Input:
+//  IMAGE - ImageFrame (SRGB, SRGBA or GRAY8).
+//  NORM_RECT (optional) - NormalizedRect, the region of interest of the
+//    image, possibly rotated. The whole image is used when the input is
+//    absent or empty.
+//
+// Output:
+//  TENSORS - Vector of TfLiteTensor of type kTfLiteFloat32, or kTfLiteUint8,
+//    with shape [output_height, output_width, channels].
+//  LETTERBOX_PADDING (optional) - An std::array<float, 4> with the padding
+//    from the 4 sides ([left, top, right, bottom]) of the tensor, normalized
+//    to [0.f, 1.f] by the tensor dimensions, as expected by the
+//    DetectionLetterboxRemovalCalculator. The padding is non-zero only when
+//    keep_aspect_ratio is set.
+//
+// Example use:
+// node {
+//   calculator: "TfLiteImageToTensorCalculator"
+//   input_stream: "IMAGE:input_image"
+//   output_stream: "TENSORS:image_tensor"
+//   output_stream: "LETTERBOX_PADDING:letterbox_padding"
+//   options: {
+//     [mediapipe.TfLiteImageToTensorCalculatorOptions.ext] {
+//       output_width: 128
+//       output_height: 128
+//       keep_aspect_ratio: true
+//     }
+//   }
+// }
+//
+// The output tensor is owned by the calculator and is overwritten by the
+// next input, as for the TfLiteConverterCalculator.
+//
+// This calculator uses FixedSizeInputStreamHandler by default.
+//
+class TfLiteImageToTensorCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc);
+
+  ::mediapipe::Status Open(CalculatorContext* cc) override;
+  ::mediapipe::Status Process(CalculatorContext* cc) override;
+  ::mediapipe::Status Close(CalculatorContext* cc) override;
+
+ private:
+  ::mediapipe::Status LoadOptions(CalculatorContext* cc);
+  // Sets up the tensor for images with the given number of channels.
+  ::mediapipe::Status InitTensor(int channels_preserved);
+  // Fills the tensor with the region of interest of image_frame, and returns
+  // the letterbox padding.
+  template <class T>
+  std::array<float, 4> SampleImage(const ImageFrame& image_frame,
+                                   const NormalizedRect& roi, T* tensor_ptr);
+
+  ::mediapipe::TfLiteImageToTensorCalculatorOptions options_;
+  std::unique_ptr<tflite::Interpreter> interpreter_ = nullptr;
+
+  int channels_preserved_ = 0;
+  float scale_ = 1.0f / 255.0f;
+  float bias_ = 0.0f;
+};
+REGISTER_CALCULATOR(TfLiteImageToTensorCalculator);
+
+::mediapipe::Status TfLiteImageToTensorCalculator::GetContract(
+    CalculatorContract* cc) {
+  RET_CHECK(cc->Inputs().HasTag(kImageFrameTag));
+  RET_CHECK(cc->Outputs().HasTag(kTensorsTag));
+
+  cc->Inputs().Tag(kImageFrameTag).Set<ImageFrame>();
+  if (cc->Inputs().HasTag(kNormRectTag)) {
+    cc->Inputs().Tag(kNormRectTag).Set<NormalizedRect>();
+  }
+  cc->Outputs().Tag(kTensorsTag).Set<std::vector<TfLiteTensor>>();
+  if (cc->Outputs().HasTag(kLetterboxPaddingTag)) {
+    cc->Outputs().Tag(kLetterboxPaddingTag).Set<std::array<float, 4>>();
+  }
+
+  // Assign this calculator's default InputStreamHandler.
+  cc->SetInputStreamHandler("FixedSizeInputStreamHandler");
+
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status TfLiteImageToTensorCalculator::Open(CalculatorContext* cc) {
+  cc->SetOffset(TimestampDiff(0));
+
+  MP_RETURN_IF_ERROR(LoadOptions(cc));
+
+  interpreter_ = absl::make_unique<tflite::Interpreter>();
+  interpreter_->AddTensors(1);
+  interpreter_->SetInputs({0});
+
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status TfLiteImageToTensorCalculator::Process(
+    CalculatorContext* cc) {
+  if (cc->Inputs().Tag(kImageFrameTag).IsEmpty()) {
+    return ::mediapipe::OkStatus();
+  }
+  const auto& image_frame = cc->Inputs().Tag(kImageFrameTag).Get<ImageFrame>();
+  const ImageFormat::Format format = image_frame.Format();
+  if (!(format == ImageFormat::SRGBA || format == ImageFormat::SRGB ||
+        format == ImageFormat::GRAY8)) {
+    RET_CHECK_FAIL() << "Unsupported CPU input format.";
+  }
+
+  NormalizedRect roi;
+  roi.set_x_center(0.5f);
+  roi.set_y_center(0.5f);
+  roi.set_width(1.0f);
+  roi.set_height(1.0f);
+  if (cc->Inputs().HasTag(kNormRectTag) &&
+      !cc->Inputs().Tag(kNormRectTag).IsEmpty()) {
+    roi = cc->Inputs().Tag(kNormRectTag).Get<NormalizedRect>();
+    RET_CHECK(roi.width() > 0.0f && roi.height() > 0.0f)
+        << "The region of interest must not be empty.";
+  }
+
+  const int channels_preserved =
+      std::min(image_frame.NumberOfChannels(), options_.max_num_channels());
+  if (channels_preserved != channels_preserved_) {
+    MP_RETURN_IF_ERROR(InitTensor(channels_preserved));
+  }
+
+  TfLiteTensor* tensor = interpreter_->tensor(interpreter_->inputs()[0]);
+  std::array<float, 4> padding;
+  if (options_.use_quantized_tensors()) {
+    RET_CHECK(tensor->data.uint8);
+    padding = SampleImage(image_frame, roi, tensor->data.uint8);
+  } else {
+    RET_CHECK(tensor->data.f);
+    padding = SampleImage(image_frame, roi, tensor->data.f);
+  }
+
+  auto output_tensors = absl::make_unique<std::vector<TfLiteTensor>>();
+  output_tensors->emplace_back(*tensor);
+  cc->Outputs()
+      .Tag(kTensorsTag)
+      .Add(output_tensors.release(), cc->InputTimestamp());
+  if (cc->Outputs().HasTag(kLetterboxPaddingTag)) {
+    cc->Outputs()
+        .Tag(kLetterboxPaddingTag)
+        .AddPacket(MakePacket<std::array<float, 4>>(padding).At(
+            cc->InputTimestamp()));
+  }
+
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status TfLiteImageToTensorCalculator::Close(
+    CalculatorContext* cc) {
+  interpreter_.reset();
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status TfLiteImageToTensorCalculator::LoadOptions(
+    CalculatorContext* cc) {
+  options_ = cc->Options<::mediapipe::TfLiteImageToTensorCalculatorOptions>();
+  RET_CHECK_GT(options_.output_width(), 0);
+  RET_CHECK_GT(options_.output_height(), 0);
+  RET_CHECK(options_.max_num_channels() == 1 ||
+            options_.max_num_channels() == 3 ||
+            options_.max_num_channels() == 4)
+      << "Valid values of max_num_channels are 1, 3 and 4.";
+
+  // Normalize the pixel values from [0, 255] to [0, 1] by default, and
+  // otherwise to [-1, 1] or the specified output range.
+  float range_min = 0.0f;
+  float range_max = 1.0f;
+  if (options_.zero_center()) {
+    range_min = -1.0f;
+  }
+  if (options_.has_output_tensor_float_range()) {
+    range_min = options_.output_tensor_float_range().min();
+    range_max = options_.output_tensor_float_range().max();
+    RET_CHECK_GT(range_max, range_min);
+  }
+  scale_ = (range_max - range_min) / 255.0f;
+  bias_ = range_min;
+
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status TfLiteImageToTensorCalculator::InitTensor(
+    int channels_preserved) {
+  TfLiteQuantization quant;
+  if (options_.use_quantized_tensors()) {
+    quant.type = kTfLiteAffineQuantization;
+    auto quant_params = static_cast<TfLiteAffineQuantization*>(
+        malloc(sizeof(TfLiteAffineQuantization)));
+    quant_params->scale = TfLiteFloatArrayCreate(1);
+    quant_params->scale->data[0] = 1.0;
+    quant_params->zero_point = TfLiteIntArrayCreate(1);
+    quant_params->zero_point->data[0] = 0;
+    quant_params->quantized_dimension = 0;
+    quant.params = quant_params;
+    interpreter_->SetTensorParametersReadWrite(0, kTfLiteUInt8, "",
+                                               {channels_preserved}, quant);
+  } else {
+    // Initialize structure for no quantization.
+    quant.type = kTfLiteNoQuantization;
+    quant.params = nullptr;
+    interpreter_->SetTensorParametersReadWrite(0, kTfLiteFloat32, "",
+                                               {channels_preserved}, quant);
+  }
+  // The output size is fixed, so the tensor is allocated once.
+  const int tensor_idx = interpreter_->inputs()[0];
+  RET_CHECK_EQ(
+      interpreter_->ResizeInputTensor(
+          tensor_idx, {options_.output_height(), options_.output_width(),
+                       channels_preserved}),
+      kTfLiteOk);
+  RET_CHECK_EQ(interpreter_->AllocateTensors(), kTfLiteOk);
+  channels_preserved_ = channels_preserved;
+  return ::mediapipe::OkStatus();
+}
+
+template <class T>
+std::array<float, 4> TfLiteImageToTensorCalculator::SampleImage(
+    const ImageFrame& image_frame, const NormalizedRect& roi, T* tensor_ptr) {
+  const int output_width = options_.output_width();
+  const int output_height = options_.output_height();
+  const float roi_width = roi.width() * image_frame.Width();
+  const float roi_height = roi.height() * image_frame.Height();
+
+  // The part of the tensor covered by the region of interest.
+  int content_width = output_width;
+  int content_height = output_height;
+  if (options_.keep_aspect_ratio()) {
+    const float scale =
+        std::min(output_width / roi_width, output_height / roi_height);
+    content_width = std::min(
+        output_width, std::max(1, static_cast<int>(
+                                      std::round(roi_width * scale))));
+    content_height = std::min(
+        output_height, std::max(1, static_cast<int>(
+                                       std::round(roi_height * scale))));
+  }
+  const int pad_left = (output_width - content_width) / 2;
+  const int pad_top = (output_height - content_height) / 2;
+  const int pad_right = output_width - content_width - pad_left;
+
+  // The image position of a tensor pixel center (x, y) of the content is
+  //   roi_center + R * ((x, y) + 0.5 - content_center) * roi_size / content
+  // where R rotates clockwise by the rotation of the region of interest.
+  // Image positions are offset by half a pixel, to put the pixel centers at
+  // integral coordinates.
+  const float step_x = roi_width / content_width;
+  const float step_y = roi_height / content_height;
+  const float cos_r = std::cos(roi.rotation());
+  const float sin_r = std::sin(roi.rotation());
+  const float origin_x = roi.x_center() * image_frame.Width() - 0.5f;
+  const float origin_y = roi.y_center() * image_frame.Height() - 0.5f;
+
+  const BilinearSampler sampler(
+      image_frame, channels_preserved_,
+      options_.border_mode() ==
+          TfLiteImageToTensorCalculatorOptions::BORDER_REPLICATE);
+  // The padding is the normalized value of a zero pixel.
+  T pad_value;
+  StoreValue(0.0f, scale_, bias_, &pad_value);
+  float values[4];
+  for (int y = 0; y < output_height; ++y) {
+    if (y < pad_top || y >= pad_top + content_height) {
+      tensor_ptr = std::fill_n(tensor_ptr, output_width * channels_preserved_,
+                               pad_value);
+      continue;
+    }
+    tensor_ptr =
+        std::fill_n(tensor_ptr, pad_left * channels_preserved_, pad_value);
+    const float u = (0.5f - content_width * 0.5f) * step_x;
+    const float v = (y - pad_top + 0.5f - content_height * 0.5f) * step_y;
+    const float row_x = origin_x + cos_r * u - sin_r * v;
+    const float row_y = origin_y + sin_r * u + cos_r * v;
+    for (int x = 0; x < content_width; ++x) {
+      sampler.Sample(row_x + x * cos_r * step_x, row_y + x * sin_r * step_x,
+                     values);
+      for (int c = 0; c < channels_preserved_; ++c) {
+        StoreValue(values[c], scale_, bias_, tensor_ptr++);
+      }
+    }
+    tensor_ptr =
+        std::fill_n(tensor_ptr, pad_right * channels_preserved_, pad_value);
+  }
+
+  return {static_cast<float>(pad_left) / output_width,
+          static_cast<float>(pad_top) / output_height,
+          static_cast<float>(pad_right) / output_width,
+          static_cast<float>(output_height - content_height - pad_top) /
+              output_height};
+}
+
+}  // namespace mediapipe
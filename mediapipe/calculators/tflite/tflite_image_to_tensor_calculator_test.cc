@@ -0,0 +1,213 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <array>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/substitute.h"
+#include "mediapipe/calculators/tflite/tflite_image_to_tensor_calculator.pb.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/image_format.pb.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/rect.pb.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"  // NOLINT
+#include "mediapipe/framework/tool/sink.h"
+#include "tensorflow/lite/interpreter.h"
+
+namespace mediapipe {
+namespace {
+
+// Returns an image whose pixel (x, y) has value 10 * y + x + c in channel c.
+std::unique_ptr<ImageFrame> MakeImage(ImageFormat::Format format, int width,
+                                      int height) {
+  auto image = absl::make_unique<ImageFrame>(format, width, height);
+  const int channels = image->NumberOfChannels();
+  for (int y = 0; y < height; ++y) {
+    uint8* row = image->MutablePixelData() + y * image->WidthStep();
+    for (int x = 0; x < width; ++x) {
+      for (int c = 0; c < channels; ++c) {
+        row[x * channels + c] = 10 * y + x + c;
+      }
+    }
+  }
+  return image;
+}
+
+class TfLiteImageToTensorCalculatorTest : public ::testing::Test {
+ protected:
+  // Runs the calculator with the given options on one image. The graph is
+  // kept open, as the output tensors are owned by the calculator.
+  void Run(const std::string& options, std::unique_ptr<ImageFrame> image,
+           std::unique_ptr<NormalizedRect> roi = nullptr) {
+    CalculatorGraphConfig graph_config =
+        ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(
+            absl::Substitute(R"(
+              input_stream: "image"
+              input_stream: "roi"
+              node {
+                calculator: "TfLiteImageToTensorCalculator"
+                input_stream: "IMAGE:image"
+                input_stream: "NORM_RECT:roi"
+                output_stream: "TENSORS:tensors"
+                output_stream: "LETTERBOX_PADDING:padding"
+                options {
+                  [mediapipe.TfLiteImageToTensorCalculatorOptions.ext] {
+                    $0
+                  }
+                }
+              }
+            )",
+                             options));
+    tool::AddVectorSink("tensors", &graph_config, &tensor_packets_);
+    tool::AddVectorSink("padding", &graph_config, &padding_packets_);
+
+    graph_ = absl::make_unique<CalculatorGraph>();
+    MP_ASSERT_OK(graph_->Initialize(graph_config));
+    MP_ASSERT_OK(graph_->StartRun({}));
+    MP_ASSERT_OK(graph_->AddPacketToInputStream(
+        "image", Adopt(image.release()).At(Timestamp(0))));
+    if (roi) {
+      MP_ASSERT_OK(graph_->AddPacketToInputStream(
+          "roi", Adopt(roi.release()).At(Timestamp(0))));
+    }
+    MP_ASSERT_OK(graph_->CloseInputStream("roi"));
+    MP_ASSERT_OK(graph_->WaitUntilIdle());
+    ASSERT_EQ(1, tensor_packets_.size());
+    ASSERT_EQ(1, padding_packets_.size());
+  }
+
+  void TearDown() override {
+    if (graph_) {
+      MP_ASSERT_OK(graph_->CloseAllInputStreams());
+      MP_ASSERT_OK(graph_->WaitUntilDone());
+    }
+  }
+
+  const TfLiteTensor& OutputTensor() {
+    const auto& tensors = tensor_packets_[0].Get<std::vector<TfLiteTensor>>();
+    EXPECT_EQ(1, tensors.size());
+    return tensors[0];
+  }
+
+  const std::array<float, 4>& OutputPadding() {
+    return padding_packets_[0].Get<std::array<float, 4>>();
+  }
+
+  std::unique_ptr<CalculatorGraph> graph_;
+  std::vector<Packet> tensor_packets_;
+  std::vector<Packet> padding_packets_;
+};
+
+TEST_F(TfLiteImageToTensorCalculatorTest, CopiesImageOfTensorSize) {
+  Run("output_width: 4 output_height: 3 zero_center: false",
+      MakeImage(ImageFormat::SRGBA, 4, 3));
+  const TfLiteTensor& tensor = OutputTensor();
+  EXPECT_EQ(kTfLiteFloat32, tensor.type);
+  ASSERT_EQ(3, tensor.dims->size);
+  EXPECT_EQ(3, tensor.dims->data[0]);
+  EXPECT_EQ(4, tensor.dims->data[1]);
+  EXPECT_EQ(3, tensor.dims->data[2]);
+  // The alpha channel is dropped.
+  for (int y = 0; y < 3; ++y) {
+    for (int x = 0; x < 4; ++x) {
+      for (int c = 0; c < 3; ++c) {
+        EXPECT_FLOAT_EQ((10 * y + x + c) / 255.0f,
+                        tensor.data.f[(y * 4 + x) * 3 + c])
+            << "at " << x << ", " << y << ", " << c;
+      }
+    }
+  }
+  EXPECT_EQ((std::array<float, 4>{0.f, 0.f, 0.f, 0.f}), OutputPadding());
+}
+
+TEST_F(TfLiteImageToTensorCalculatorTest, CropsRegionOfInterest) {
+  auto roi = absl::make_unique<NormalizedRect>();
+  roi->set_x_center(0.75f);
+  roi->set_y_center(0.5f);
+  roi->set_width(0.5f);
+  roi->set_height(1.0f);
+  Run("output_width: 2 output_height: 2 use_quantized_tensors: true",
+      MakeImage(ImageFormat::GRAY8, 4, 2), std::move(roi));
+  const TfLiteTensor& tensor = OutputTensor();
+  EXPECT_EQ(kTfLiteUInt8, tensor.type);
+  const std::vector<uint8> expected = {2, 3, 12, 13};
+  EXPECT_EQ(expected, std::vector<uint8>(tensor.data.uint8,
+                                         tensor.data.uint8 + 4));
+}
+
+TEST_F(TfLiteImageToTensorCalculatorTest, RotatesRegionOfInterest) {
+  auto roi = absl::make_unique<NormalizedRect>();
+  roi->set_x_center(0.5f);
+  roi->set_y_center(0.5f);
+  roi->set_width(1.0f);
+  roi->set_height(1.0f);
+  roi->set_rotation(M_PI / 2);
+  Run("output_width: 3 output_height: 3 zero_center: false",
+      MakeImage(ImageFormat::GRAY8, 3, 3), std::move(roi));
+  // The tensor pixel (x, y) is the image pixel (2 - y, x).
+  const TfLiteTensor& tensor = OutputTensor();
+  for (int y = 0; y < 3; ++y) {
+    for (int x = 0; x < 3; ++x) {
+      EXPECT_NEAR((10 * x + 2 - y) / 255.0f, tensor.data.f[y * 3 + x], 1e-5)
+          << "at " << x << ", " << y;
+    }
+  }
+}
+
+TEST_F(TfLiteImageToTensorCalculatorTest, LetterboxesAndResizes) {
+  Run("output_width: 2 output_height: 4 keep_aspect_ratio: true",
+      MakeImage(ImageFormat::GRAY8, 4, 4));
+  // The image is halved into the middle 2x2 pixels of the tensor. Each of
+  // them averages 2x2 image pixels.
+  const TfLiteTensor& tensor = OutputTensor();
+  // The rows are [padding, image, image, padding].
+  const std::vector<float> expected = {
+      -1.f,
+      -1.f,
+      5.5f / 127.5f - 1.f,
+      7.5f / 127.5f - 1.f,
+      25.5f / 127.5f - 1.f,
+      27.5f / 127.5f - 1.f,
+      -1.f,
+      -1.f,
+  };
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_FLOAT_EQ(expected[i], tensor.data.f[i]) << "at " << i;
+  }
+  EXPECT_EQ((std::array<float, 4>{0.f, 0.25f, 0.f, 0.25f}), OutputPadding());
+}
+
+TEST_F(TfLiteImageToTensorCalculatorTest, ReplicatesBorder) {
+  auto roi = absl::make_unique<NormalizedRect>();
+  roi->set_x_center(1.0f);
+  roi->set_y_center(0.5f);
+  roi->set_width(1.0f);
+  roi->set_height(1.0f);
+  Run(R"(output_width: 2 output_height: 1 use_quantized_tensors: true
+         border_mode: BORDER_REPLICATE)",
+      MakeImage(ImageFormat::GRAY8, 2, 1), std::move(roi));
+  const TfLiteTensor& tensor = OutputTensor();
+  EXPECT_EQ(1, tensor.data.uint8[0]);
+  EXPECT_EQ(1, tensor.data.uint8[1]);
+}
+
+}  // namespace
+}  // namespace mediapipe
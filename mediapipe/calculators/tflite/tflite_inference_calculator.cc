@@ -12,12 +12,17 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstdint>
 #include <cstring>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "mediapipe/calculators/tflite/tflite_inference_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/port/ret_check.h"
@@ -28,6 +33,7 @@
 #endif  // !__EMSCRIPTEN__ || __EMSCRIPTEN_PTHREADS__
 
 #include "mediapipe/util/resource_util.h"
+#include "mediapipe/util/tflite/tflite_interpreter_pool.h"
 #include "tensorflow/lite/error_reporter.h"
 #include "tensorflow/lite/interpreter.h"
 #include "tensorflow/lite/kernels/register.h"
@@ -145,6 +151,15 @@ int GetXnnpackNumThreads(
 #endif  // !__EMSCRIPTEN__ || __EMSCRIPTEN_PTHREADS__
 }
 
+// Returns whether the XNNPACK delegate is requested for CPU inference.
+bool XnnpackRequested(const mediapipe::TfLiteInferenceCalculatorOptions& opts) {
+#if defined(__EMSCRIPTEN__)
+  return true;
+#else
+  return opts.has_delegate() && opts.delegate().has_xnnpack();
+#endif  // __EMSCRIPTEN__
+}
+
 // Calculator Header Section
 
 // Runs inference on the provided input TFLite tensors and TFLite model.
@@ -209,6 +224,21 @@ int GetXnnpackNumThreads(
 //  (i.e. after calling graph.WaitUntilDone()).
 //  GPU tensor support rquires OpenGL ES 3.1+.
 //  This calculator uses FixedSizeInputStreamHandler by default.
+//  With max_batch_size > 1, the output packets of a batch are sent when the
+//  batch runs, so the calculator does not promise a timestamp offset. A
+//  partial batch runs when its timeout expires on a packet arrival, when the
+//  input timestamp bound advances without a packet, and when the input
+//  stream closes. Batching requires max_in_flight == 1, since the pending
+//  batch is shared by all Process() calls.
+//  When a TfLiteInterpreterPool is provided through
+//  kTfLiteInterpreterPoolService, CPU inference without batching checks out
+//  an interpreter of the shared model from the pool for each Process() call.
+//  The calculator keeps its interpreters until it closes, so output tensors
+//  stay valid until another Process() call uses the same interpreter. This
+//  also allows max_in_flight > 1 without batching, with one interpreter per
+//  parallel call.
+//  Pooled interpreters that use XNNPACK share the delegate of the pool, and
+//  thus its number of threads.
 //
 class TfLiteInferenceCalculator : public CalculatorBase {
  public:
@@ -232,9 +262,10 @@ class TfLiteInferenceCalculator : public CalculatorBase {
   ::mediapipe::Status LoadDelegate(CalculatorContext* cc);
   ::mediapipe::Status InitTFLiteGPURunner(CalculatorContext* cc);
   ::mediapipe::Status ProcessInputsCpu(
-      CalculatorContext* cc, std::vector<TfLiteTensor>* output_tensors_cpu);
+      CalculatorContext* cc, tflite::Interpreter* interpreter,
+      std::vector<TfLiteTensor>* output_tensors_cpu);
   ::mediapipe::Status ProcessOutputsCpu(
-      CalculatorContext* cc,
+      CalculatorContext* cc, tflite::Interpreter* interpreter,
       std::unique_ptr<std::vector<TfLiteTensor>> output_tensors_cpu);
   ::mediapipe::Status ProcessInputsGpu(
       CalculatorContext* cc, std::vector<GpuTensor>* output_tensors_gpu);
@@ -242,6 +273,12 @@ class TfLiteInferenceCalculator : public CalculatorBase {
       CalculatorContext* cc,
       std::unique_ptr<std::vector<TfLiteTensor>> output_tensors_cpu,
       std::unique_ptr<std::vector<GpuTensor>> output_tensors_gpu);
+  bool ShouldUseInterpreterPool(CalculatorContext* cc);
+  ::mediapipe::Status InitInterpreterPool(CalculatorContext* cc);
+  ::mediapipe::Status ProcessPooled(CalculatorContext* cc);
+  ::mediapipe::Status InitBatching();
+  ::mediapipe::Status ProcessBatched(CalculatorContext* cc);
+  ::mediapipe::Status RunBatch(CalculatorContext* cc);
 
   ::mediapipe::Status RunInContextIfNeeded(
       std::function<::mediapipe::Status(void)> f) {
@@ -284,6 +321,24 @@ class TfLiteInferenceCalculator : public CalculatorBase {
 
   bool use_kernel_caching_ = false;
   std::string cached_kernel_filename_;
+
+  // Micro-batching state, used when max_batch_size_ > 1.
+  int max_batch_size_ = 1;
+  absl::Duration batch_timeout_;
+  std::vector<Packet> pending_inputs_;
+  absl::Time oldest_pending_time_;
+  // Holds the output tensors of each batch entry, as there is no way to
+  // slice the batched output tensors of interpreter_ in place.
+  std::unique_ptr<tflite::Interpreter> batch_outputs_;
+
+  // Shared interpreter state, used when interpreter_pool_ is set.
+  TfLiteInterpreterPool* interpreter_pool_ = nullptr;
+  std::string interpreter_pool_key_;
+  TfLiteInterpreterPool::InterpreterFactory interpreter_factory_;
+  absl::Mutex idle_interpreters_mutex_;
+  // The interpreters checked out by this calculator that are not in use.
+  std::vector<TfLiteInterpreterPool::InterpreterPtr> idle_interpreters_
+      ABSL_GUARDED_BY(idle_interpreters_mutex_);
 };
 REGISTER_CALCULATOR(TfLiteInferenceCalculator);
 
@@ -336,6 +391,7 @@ bool ShouldUseGpu(CC* cc) {
   if (cc->InputSidePackets().HasTag("MODEL")) {
     cc->InputSidePackets().Tag("MODEL").Set<TfLiteModelPtr>();
   }
+  cc->UseService(kTfLiteInterpreterPoolService).Optional();
 
   if (ShouldUseGpu(cc)) {
 #if MEDIAPIPE_TFLITE_GL_INFERENCE
@@ -345,6 +401,13 @@ bool ShouldUseGpu(CC* cc) {
 #endif
   }
 
+  // With batching, Process() also runs when the input timestamp bound
+  // advances without a packet, so that a gap in the input stream flushes a
+  // partial batch.
+  if (options.max_batch_size() > 1) {
+    cc->SetProcessTimestampBounds(true);
+  }
+
   // Assign this calculator's default InputStreamHandler.
   cc->SetInputStreamHandler("FixedSizeInputStreamHandler");
 
@@ -352,14 +415,24 @@ bool ShouldUseGpu(CC* cc) {
 }
 
 ::mediapipe::Status TfLiteInferenceCalculator::Open(CalculatorContext* cc) {
-  cc->SetOffset(TimestampDiff(0));
-
   const auto& options =
       cc->Options<::mediapipe::TfLiteInferenceCalculatorOptions>();
 
+  max_batch_size_ = options.max_batch_size();
+  RET_CHECK_GE(max_batch_size_, 1);
+  // The batch being filled is shared by all Process() calls.
+  RET_CHECK(max_batch_size_ == 1 || cc->MaxInFlight() == 1)
+      << "max_batch_size > 1 requires max_in_flight == 1.";
+  batch_timeout_ = absl::Microseconds(options.batch_timeout_us());
+  if (max_batch_size_ == 1) {
+    cc->SetOffset(TimestampDiff(0));
+  }
+
   gpu_inference_ = ShouldUseGpu(cc);
   gpu_input_ = cc->Inputs().HasTag(kTensorsGpuTag);
   gpu_output_ = cc->Outputs().HasTag(kTensorsGpuTag);
+  RET_CHECK(max_batch_size_ == 1 || (!gpu_input_ && !gpu_output_))
+      << "max_batch_size > 1 is only supported for CPU tensors.";
 
   use_advanced_gpu_api_ = MEDIAPIPE_TFLITE_GL_INFERENCE &&
                           options.has_delegate() &&
@@ -383,6 +456,10 @@ bool ShouldUseGpu(CC* cc) {
   }
   CHECK(!use_advanced_gpu_api_ || gpu_inference_);
 
+  if (ShouldUseInterpreterPool(cc)) {
+    return InitInterpreterPool(cc);
+  }
+
   MP_RETURN_IF_ERROR(LoadModel(cc));
 
   if (gpu_inference_) {
@@ -410,6 +487,12 @@ bool ShouldUseGpu(CC* cc) {
 }
 
 ::mediapipe::Status TfLiteInferenceCalculator::Process(CalculatorContext* cc) {
+  if (max_batch_size_ > 1) {
+    return ProcessBatched(cc);
+  }
+  if (interpreter_pool_) {
+    return ProcessPooled(cc);
+  }
   return RunInContextIfNeeded([this, cc]() -> ::mediapipe::Status {
     // 0. Declare outputs
     auto output_tensors_gpu = absl::make_unique<std::vector<GpuTensor>>();
@@ -419,7 +502,8 @@ bool ShouldUseGpu(CC* cc) {
     if (gpu_input_) {
       MP_RETURN_IF_ERROR(ProcessInputsGpu(cc, output_tensors_gpu.get()));
     } else {
-      MP_RETURN_IF_ERROR(ProcessInputsCpu(cc, output_tensors_cpu.get()));
+      MP_RETURN_IF_ERROR(
+          ProcessInputsCpu(cc, interpreter_.get(), output_tensors_cpu.get()));
     }
 
     // 2. Run inference.
@@ -438,7 +522,8 @@ bool ShouldUseGpu(CC* cc) {
       MP_RETURN_IF_ERROR(ProcessOutputsGpu(cc, std::move(output_tensors_cpu),
                                            std::move(output_tensors_gpu)));
     } else {
-      MP_RETURN_IF_ERROR(ProcessOutputsCpu(cc, std::move(output_tensors_cpu)));
+      MP_RETURN_IF_ERROR(ProcessOutputsCpu(cc, interpreter_.get(),
+                                           std::move(output_tensors_cpu)));
     }
 
     return ::mediapipe::OkStatus();
@@ -460,6 +545,14 @@ bool ShouldUseGpu(CC* cc) {
 }
 
 ::mediapipe::Status TfLiteInferenceCalculator::Close(CalculatorContext* cc) {
+  if (!pending_inputs_.empty()) {
+    MP_RETURN_IF_ERROR(RunBatch(cc));
+  }
+  {
+    // Return the interpreters to the pool.
+    absl::MutexLock lock(&idle_interpreters_mutex_);
+    idle_interpreters_.clear();
+  }
   MP_RETURN_IF_ERROR(WriteKernelsToFile());
 
   return RunInContextIfNeeded([this]() -> ::mediapipe::Status {
@@ -487,7 +580,8 @@ bool ShouldUseGpu(CC* cc) {
 // Calculator Auxiliary Section
 
 ::mediapipe::Status TfLiteInferenceCalculator::ProcessInputsCpu(
-    CalculatorContext* cc, std::vector<TfLiteTensor>* output_tensors_cpu) {
+    CalculatorContext* cc, tflite::Interpreter* interpreter,
+    std::vector<TfLiteTensor>* output_tensors_cpu) {
   if (cc->Inputs().Tag(kTensorsTag).IsEmpty()) {
     return ::mediapipe::OkStatus();
   }
@@ -500,12 +594,12 @@ bool ShouldUseGpu(CC* cc) {
     RET_CHECK(input_tensor->data.raw);
     if (use_quantized_tensors_) {
       const uint8* input_tensor_buffer = input_tensor->data.uint8;
-      uint8* local_tensor_buffer = interpreter_->typed_input_tensor<uint8>(i);
+      uint8* local_tensor_buffer = interpreter->typed_input_tensor<uint8>(i);
       std::memcpy(local_tensor_buffer, input_tensor_buffer,
                   input_tensor->bytes);
     } else {
       const float* input_tensor_buffer = input_tensor->data.f;
-      float* local_tensor_buffer = interpreter_->typed_input_tensor<float>(i);
+      float* local_tensor_buffer = interpreter->typed_input_tensor<float>(i);
       std::memcpy(local_tensor_buffer, input_tensor_buffer,
                   input_tensor->bytes);
     }
@@ -587,12 +681,12 @@ bool ShouldUseGpu(CC* cc) {
 }
 
 ::mediapipe::Status TfLiteInferenceCalculator::ProcessOutputsCpu(
-    CalculatorContext* cc,
+    CalculatorContext* cc, tflite::Interpreter* interpreter,
     std::unique_ptr<std::vector<TfLiteTensor>> output_tensors_cpu) {
   // Output result tensors (CPU).
-  const auto& tensor_indexes = interpreter_->outputs();
+  const auto& tensor_indexes = interpreter->outputs();
   for (int i = 0; i < tensor_indexes.size(); ++i) {
-    TfLiteTensor* tensor = interpreter_->tensor(tensor_indexes[i]);
+    TfLiteTensor* tensor = interpreter->tensor(tensor_indexes[i]);
     output_tensors_cpu->emplace_back(*tensor);
   }
   cc->Outputs()
@@ -673,6 +767,250 @@ bool ShouldUseGpu(CC* cc) {
   return ::mediapipe::OkStatus();
 }
 
+bool TfLiteInferenceCalculator::ShouldUseInterpreterPool(
+    CalculatorContext* cc) {
+#if defined(MEDIAPIPE_EDGE_TPU)
+  return false;
+#else
+  if (!cc->Service(kTfLiteInterpreterPoolService).IsAvailable() ||
+      gpu_inference_ || max_batch_size_ > 1) {
+    return false;
+  }
+#if defined(MEDIAPIPE_ANDROID)
+  const auto& options =
+      cc->Options<::mediapipe::TfLiteInferenceCalculatorOptions>();
+  // NNAPI delegates are not shared.
+  if (options.has_delegate() ? options.delegate().has_nnapi()
+                             : options.use_nnapi()) {
+    return false;
+  }
+#endif  // MEDIAPIPE_ANDROID
+  return true;
+#endif  // MEDIAPIPE_EDGE_TPU
+}
+
+::mediapipe::Status TfLiteInferenceCalculator::InitInterpreterPool(
+    CalculatorContext* cc) {
+  const auto& options =
+      cc->Options<::mediapipe::TfLiteInferenceCalculatorOptions>();
+  interpreter_pool_ = &cc->Service(kTfLiteInterpreterPoolService).GetObject();
+
+  // Share the model with all calculators that use the same one.
+  ASSIGN_OR_RETURN(Packet model_packet, GetModelAsPacket(*cc));
+  model_packet_ = interpreter_pool_->ShareModel(model_packet);
+
+  tflite::ops::builtin::BuiltinOpResolver op_resolver;
+  std::string op_resolver_key = "builtin";
+  if (cc->InputSidePackets().HasTag("CUSTOM_OP_RESOLVER")) {
+    const Packet& op_resolver_packet =
+        cc->InputSidePackets().Tag("CUSTOM_OP_RESOLVER");
+    op_resolver =
+        op_resolver_packet.Get<tflite::ops::builtin::BuiltinOpResolver>();
+    // Only share interpreters built with the same custom op resolver.
+    op_resolver_key = absl::StrCat(
+        "custom@", reinterpret_cast<uintptr_t>(
+                       &op_resolver_packet
+                            .Get<tflite::ops::builtin::BuiltinOpResolver>()));
+  }
+#if defined(__EMSCRIPTEN__)
+  const int num_threads = 1;
+#else
+  const int num_threads = options.cpu_num_thread();
+#endif  // __EMSCRIPTEN__
+  // The XNNPACK delegate is only loaded on these platforms, as in Open().
+#if defined(__EMSCRIPTEN__) || defined(MEDIAPIPE_ANDROID) || \
+    defined(MEDIAPIPE_IOS)
+  const bool use_xnnpack =
+      !(options.has_delegate() && options.delegate().has_tflite()) &&
+      XnnpackRequested(options);
+#else
+  const bool use_xnnpack = false;
+#endif  // __EMSCRIPTEN__ || MEDIAPIPE_ANDROID || MEDIAPIPE_IOS
+
+  interpreter_pool_key_ = absl::StrCat(
+      TfLiteInterpreterPool::ModelKey(*model_packet_.Get<TfLiteModelPtr>()),
+      "/", op_resolver_key, "/threads:", num_threads,
+      use_xnnpack ? "/xnnpack" : "");
+  TfLiteInterpreterPool* pool = interpreter_pool_;
+  interpreter_factory_ =
+      [op_resolver, num_threads, use_xnnpack,
+       pool](const tflite::FlatBufferModel& model)
+      -> ::mediapipe::StatusOr<std::unique_ptr<tflite::Interpreter>> {
+    std::unique_ptr<tflite::Interpreter> interpreter;
+    tflite::InterpreterBuilder(model, op_resolver)(&interpreter);
+    RET_CHECK(interpreter);
+    interpreter->SetNumThreads(num_threads);
+    RET_CHECK_EQ(interpreter->AllocateTensors(), kTfLiteOk);
+    if (use_xnnpack) {
+      RET_CHECK_EQ(
+          interpreter->ModifyGraphWithDelegate(pool->XnnpackDelegate()),
+          kTfLiteOk);
+    }
+    return interpreter;
+  };
+
+  // Check out the first interpreter, which checks that the model loads.
+  ASSIGN_OR_RETURN(TfLiteInterpreterPool::InterpreterPtr interpreter,
+                   interpreter_pool_->Acquire(model_packet_,
+                                              interpreter_pool_key_,
+                                              interpreter_factory_));
+  use_quantized_tensors_ =
+      interpreter->tensor(interpreter->inputs()[0])->quantization.type ==
+      kTfLiteAffineQuantization;
+  absl::MutexLock lock(&idle_interpreters_mutex_);
+  idle_interpreters_.push_back(std::move(interpreter));
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status TfLiteInferenceCalculator::ProcessPooled(
+    CalculatorContext* cc) {
+  TfLiteInterpreterPool::InterpreterPtr interpreter;
+  {
+    absl::MutexLock lock(&idle_interpreters_mutex_);
+    if (!idle_interpreters_.empty()) {
+      interpreter = std::move(idle_interpreters_.back());
+      idle_interpreters_.pop_back();
+    }
+  }
+  if (!interpreter) {
+    // Another Process() call is using each of our interpreters.
+    ASSIGN_OR_RETURN(interpreter, interpreter_pool_->Acquire(
+                                      model_packet_, interpreter_pool_key_,
+                                      interpreter_factory_));
+  }
+
+  ::mediapipe::Status status = [this, cc,
+                                &interpreter]() -> ::mediapipe::Status {
+    auto output_tensors_cpu = absl::make_unique<std::vector<TfLiteTensor>>();
+    MP_RETURN_IF_ERROR(
+        ProcessInputsCpu(cc, interpreter.get(), output_tensors_cpu.get()));
+    RET_CHECK_EQ(interpreter->Invoke(), kTfLiteOk);
+    return ProcessOutputsCpu(cc, interpreter.get(),
+                             std::move(output_tensors_cpu));
+  }();
+
+  absl::MutexLock lock(&idle_interpreters_mutex_);
+  idle_interpreters_.push_back(std::move(interpreter));
+  return status;
+}
+
+::mediapipe::Status TfLiteInferenceCalculator::InitBatching() {
+  RET_CHECK(!gpu_inference_)
+      << "max_batch_size > 1 is only supported for CPU inference.";
+
+  // Resize the batch dimension once, so that batches of any size up to
+  // max_batch_size_ run without reallocating the tensors.
+  for (int index : interpreter_->inputs()) {
+    const TfLiteIntArray* dims = interpreter_->tensor(index)->dims;
+    RET_CHECK(dims->size > 0 && dims->data[0] == 1)
+        << "max_batch_size > 1 requires input tensors with a leading batch "
+           "dimension of 1.";
+    std::vector<int> batch_dims(dims->data, dims->data + dims->size);
+    batch_dims[0] = max_batch_size_;
+    RET_CHECK_EQ(interpreter_->ResizeInputTensor(index, batch_dims),
+                 kTfLiteOk);
+  }
+  RET_CHECK_EQ(interpreter_->AllocateTensors(), kTfLiteOk);
+
+  // Allocate the output tensors of each batch entry.
+  const auto& output_indices = interpreter_->outputs();
+  const int num_outputs = output_indices.size();
+  batch_outputs_ = absl::make_unique<tflite::Interpreter>();
+  batch_outputs_->AddTensors(max_batch_size_ * num_outputs);
+  std::vector<int> indices(max_batch_size_ * num_outputs);
+  for (int i = 0; i < indices.size(); ++i) indices[i] = i;
+  batch_outputs_->SetInputs(indices);
+  for (int i = 0; i < num_outputs; ++i) {
+    const TfLiteTensor* tensor = interpreter_->tensor(output_indices[i]);
+    RET_CHECK(tensor->dims->size > 0 &&
+              tensor->dims->data[0] == max_batch_size_)
+        << "max_batch_size > 1 requires output tensors with a leading batch "
+           "dimension.";
+    std::vector<int> entry_dims(tensor->dims->data,
+                                tensor->dims->data + tensor->dims->size);
+    entry_dims[0] = 1;
+    for (int b = 0; b < max_batch_size_; ++b) {
+      RET_CHECK_EQ(batch_outputs_->SetTensorParametersReadWrite(
+                       b * num_outputs + i, tensor->type, "", entry_dims,
+                       tensor->params),
+                   kTfLiteOk);
+    }
+  }
+  RET_CHECK_EQ(batch_outputs_->AllocateTensors(), kTfLiteOk);
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status TfLiteInferenceCalculator::ProcessBatched(
+    CalculatorContext* cc) {
+  const InputStream& input = cc->Inputs().Tag(kTensorsTag);
+  const Packet& packet = input.Value();
+  if (packet.IsEmpty()) {
+    // The input timestamp bound advanced without a packet, e.g. because an
+    // upstream calculator dropped one, so the next packet may be arbitrarily
+    // late. The partial batch runs now instead of waiting for it.
+    if (!pending_inputs_.empty()) {
+      MP_RETURN_IF_ERROR(RunBatch(cc));
+    }
+    if (!input.IsDone()) {
+      cc->Outputs().Tag(kTensorsTag).SetNextTimestampBound(
+          cc->InputTimestamp().NextAllowedInStream());
+    }
+    return ::mediapipe::OkStatus();
+  }
+  const absl::Time now = absl::Now();
+  if (pending_inputs_.empty()) {
+    oldest_pending_time_ = now;
+  }
+  pending_inputs_.push_back(packet);
+  if (pending_inputs_.size() >= max_batch_size_ ||
+      (batch_timeout_ > absl::ZeroDuration() &&
+       now - oldest_pending_time_ >= batch_timeout_)) {
+    return RunBatch(cc);
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status TfLiteInferenceCalculator::RunBatch(CalculatorContext* cc) {
+  // 1. Copy each pending input into its entry of the batched input tensors.
+  // The entries past pending_inputs_.size() are left as they are.
+  const auto& input_indices = interpreter_->inputs();
+  for (int b = 0; b < pending_inputs_.size(); ++b) {
+    const auto& input_tensors =
+        pending_inputs_[b].Get<std::vector<TfLiteTensor>>();
+    RET_CHECK_EQ(input_tensors.size(), input_indices.size());
+    for (int i = 0; i < input_tensors.size(); ++i) {
+      TfLiteTensor* tensor = interpreter_->tensor(input_indices[i]);
+      const size_t entry_bytes = tensor->bytes / max_batch_size_;
+      RET_CHECK(input_tensors[i].data.raw);
+      RET_CHECK_EQ(input_tensors[i].bytes, entry_bytes);
+      std::memcpy(tensor->data.raw + b * entry_bytes, input_tensors[i].data.raw,
+                  entry_bytes);
+    }
+  }
+
+  // 2. Run inference once for the whole batch.
+  RET_CHECK_EQ(interpreter_->Invoke(), kTfLiteOk);
+
+  // 3. Split the outputs back into one packet per input timestamp.
+  const auto& output_indices = interpreter_->outputs();
+  const int num_outputs = output_indices.size();
+  for (int b = 0; b < pending_inputs_.size(); ++b) {
+    auto output_tensors = absl::make_unique<std::vector<TfLiteTensor>>();
+    for (int i = 0; i < num_outputs; ++i) {
+      const TfLiteTensor* tensor = interpreter_->tensor(output_indices[i]);
+      TfLiteTensor* entry = batch_outputs_->tensor(b * num_outputs + i);
+      std::memcpy(entry->data.raw, tensor->data.raw + b * entry->bytes,
+                  entry->bytes);
+      output_tensors->emplace_back(*entry);
+    }
+    cc->Outputs()
+        .Tag(kTensorsTag)
+        .Add(output_tensors.release(), pending_inputs_[b].Timestamp());
+  }
+  pending_inputs_.clear();
+  return ::mediapipe::OkStatus();
+}
+
 ::mediapipe::Status TfLiteInferenceCalculator::ReadKernelsFromFile() {
 #if MEDIAPIPE_TFLITE_GL_INFERENCE && defined(MEDIAPIPE_ANDROID)
   if (use_kernel_caching_) {
@@ -798,6 +1136,10 @@ bool ShouldUseGpu(CC* cc) {
     if (use_quantized_tensors_) gpu_inference_ = false;
   }
 
+  if (max_batch_size_ > 1) {
+    MP_RETURN_IF_ERROR(InitBatching());
+  }
+
   return ::mediapipe::OkStatus();
 }
 
@@ -853,12 +1195,7 @@ bool ShouldUseGpu(CC* cc) {
     }
 #endif  // MEDIAPIPE_ANDROID
 
-#if defined(__EMSCRIPTEN__)
-    const bool xnnpack_requested = true;
-#else
-    const bool xnnpack_requested = calculator_opts.has_delegate() &&
-                                   calculator_opts.delegate().has_xnnpack();
-#endif  // __EMSCRIPTEN__
+    const bool xnnpack_requested = XnnpackRequested(calculator_opts);
 
 #if !defined(MEDIAPIPE_EDGE_TPU)
     if (xnnpack_requested) {
@@ -12,22 +12,30 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "absl/strings/str_replace.h"
 #include "absl/strings/string_view.h"
+#include "absl/strings/substitute.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
 #include "mediapipe/calculators/tflite/tflite_inference_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/calculator_runner.h"
 #include "mediapipe/framework/deps/file_path.h"
+#include "mediapipe/framework/port/benchmark.h"
 #include "mediapipe/framework/port/gmock.h"
 #include "mediapipe/framework/port/gtest.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/parse_text_proto.h"
 #include "mediapipe/framework/port/status_matchers.h"  // NOLINT
 #include "mediapipe/framework/tool/validate_type.h"
+#include "mediapipe/util/tflite/tflite_interpreter_pool.h"
 #include "tensorflow/lite/error_reporter.h"
 #include "tensorflow/lite/interpreter.h"
 #include "tensorflow/lite/kernels/register.h"
@@ -41,7 +49,8 @@ namespace mediapipe {
 
 using ::tflite::Interpreter;
 
-void DoSmokeTest(const std::string& graph_proto) {
+void DoSmokeTest(const std::string& graph_proto,
+                 std::shared_ptr<TfLiteInterpreterPool> pool = nullptr) {
   const int width = 8;
   const int height = 8;
   const int channels = 3;
@@ -74,7 +83,11 @@ void DoSmokeTest(const std::string& graph_proto) {
       ParseTextProtoOrDie<CalculatorGraphConfig>(graph_proto);
   std::vector<Packet> output_packets;
   tool::AddVectorSink("tensor_out", &graph_config, &output_packets);
-  CalculatorGraph graph(graph_config);
+  CalculatorGraph graph;
+  if (pool) {
+    MP_ASSERT_OK(graph.SetServiceObject(kTfLiteInterpreterPoolService, pool));
+  }
+  MP_ASSERT_OK(graph.Initialize(graph_config));
   MP_ASSERT_OK(graph.StartRun({}));
 
   // Push the tensor into the graph.
@@ -170,4 +183,314 @@ TEST(TfLiteInferenceCalculatorTest, SmokeTest_ModelAsInputSidePacket) {
   DoSmokeTest(graph_proto);
 }
 
+// Tests that graphs share the interpreters of a TfLiteInterpreterPool.
+TEST(TfLiteInferenceCalculatorTest, InterpreterPool) {
+  std::string graph_proto = R"(
+    input_stream: "tensor_in"
+    node {
+      calculator: "TfLiteInferenceCalculator"
+      input_stream: "TENSORS:tensor_in"
+      output_stream: "TENSORS:tensor_out"
+      max_in_flight: 2
+      options {
+        [mediapipe.TfLiteInferenceCalculatorOptions.ext] {
+          model_path: "mediapipe/calculators/tflite/testdata/add.bin"
+        }
+      }
+    }
+  )";
+  auto pool = TfLiteInterpreterPool::Create({});
+  DoSmokeTest(graph_proto, pool);
+  DoSmokeTest(graph_proto, pool);
+  EXPECT_EQ(1, pool->interpreters_built());
+}
+
+// Returns a tensor vector holding one tensor of the given shape, filled with
+// value. The tensor is owned by interpreter.
+std::unique_ptr<std::vector<TfLiteTensor>> MakeInputTensors(
+    const std::vector<int>& shape, float value, Interpreter* interpreter) {
+  interpreter->AddTensors(1);
+  interpreter->SetInputs({0});
+  interpreter->SetTensorParametersReadWrite(0, kTfLiteFloat32, "", shape,
+                                            TfLiteQuantization());
+  interpreter->AllocateTensors();
+  TfLiteTensor* tensor = interpreter->tensor(0);
+  for (int i = 0; i < tensor->bytes / sizeof(float); ++i) {
+    tensor->data.f[i] = value;
+  }
+  auto input_vec = absl::make_unique<std::vector<TfLiteTensor>>();
+  input_vec->emplace_back(*tensor);
+  return input_vec;
+}
+
+// Tests that batched inputs are split back into one output per timestamp.
+// The batching tests use DefaultInputStreamHandler, since the default
+// FixedSizeInputStreamHandler drops packets queued faster than they run.
+TEST(TfLiteInferenceCalculatorTest, MaxBatchSize) {
+  CalculatorGraphConfig graph_config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "tensor_in"
+        node {
+          calculator: "TfLiteInferenceCalculator"
+          input_stream: "TENSORS:tensor_in"
+          output_stream: "TENSORS:tensor_out"
+          input_stream_handler {
+            input_stream_handler: "DefaultInputStreamHandler"
+          }
+          options {
+            [mediapipe.TfLiteInferenceCalculatorOptions.ext] {
+              model_path: "mediapipe/calculators/tflite/testdata/add.bin"
+              max_batch_size: 2
+            }
+          }
+        }
+      )");
+  std::vector<Packet> output_packets;
+  tool::AddVectorSink("tensor_out", &graph_config, &output_packets);
+  CalculatorGraph graph(graph_config);
+  MP_ASSERT_OK(graph.StartRun({}));
+
+  std::vector<std::unique_ptr<Interpreter>> input_interpreters;
+  for (int t = 0; t < 3; ++t) {
+    input_interpreters.push_back(absl::make_unique<Interpreter>());
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "tensor_in", Adopt(MakeInputTensors({8, 8, 3}, t + 1,
+                                            input_interpreters.back().get())
+                               .release())
+                         .At(Timestamp(t))));
+  }
+  // The first two packets run as one batch, and the third one waits for
+  // another packet.
+  MP_ASSERT_OK(graph.WaitUntilIdle());
+  ASSERT_EQ(2, output_packets.size());
+  for (int t = 0; t < 2; ++t) {
+    EXPECT_EQ(Timestamp(t), output_packets[t].Timestamp());
+    const auto& result_vec = output_packets[t].Get<std::vector<TfLiteTensor>>();
+    ASSERT_EQ(1, result_vec.size());
+    EXPECT_EQ(1, result_vec[0].dims->data[0]);
+    EXPECT_EQ(8 * 8 * 3 * sizeof(float), result_vec[0].bytes);
+    for (int i = 0; i < 8 * 8 * 3; ++i) {
+      ASSERT_EQ(3 * (t + 1), result_vec[0].data.f[i]);
+    }
+  }
+
+  // The partial batch runs when the input stream closes.
+  MP_ASSERT_OK(graph.CloseInputStream("tensor_in"));
+  MP_ASSERT_OK(graph.WaitUntilDone());
+  ASSERT_EQ(3, output_packets.size());
+  EXPECT_EQ(Timestamp(2), output_packets[2].Timestamp());
+}
+
+// Tests that a partial batch runs once its oldest packet has waited for
+// batch_timeout_us.
+TEST(TfLiteInferenceCalculatorTest, BatchTimeout) {
+  CalculatorGraphConfig graph_config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "tensor_in"
+        node {
+          calculator: "TfLiteInferenceCalculator"
+          input_stream: "TENSORS:tensor_in"
+          output_stream: "TENSORS:tensor_out"
+          input_stream_handler {
+            input_stream_handler: "DefaultInputStreamHandler"
+          }
+          options {
+            [mediapipe.TfLiteInferenceCalculatorOptions.ext] {
+              model_path: "mediapipe/calculators/tflite/testdata/add.bin"
+              max_batch_size: 4
+              batch_timeout_us: 1000
+            }
+          }
+        }
+      )");
+  std::vector<Packet> output_packets;
+  tool::AddVectorSink("tensor_out", &graph_config, &output_packets);
+  CalculatorGraph graph(graph_config);
+  MP_ASSERT_OK(graph.StartRun({}));
+
+  std::vector<std::unique_ptr<Interpreter>> input_interpreters;
+  for (int t = 0; t < 2; ++t) {
+    input_interpreters.push_back(absl::make_unique<Interpreter>());
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "tensor_in", Adopt(MakeInputTensors({8, 8, 3}, t + 1,
+                                            input_interpreters.back().get())
+                               .release())
+                         .At(Timestamp(t))));
+    MP_ASSERT_OK(graph.WaitUntilIdle());
+    if (t == 0) {
+      EXPECT_EQ(0, output_packets.size());
+      absl::SleepFor(absl::Milliseconds(10));
+    }
+  }
+  ASSERT_EQ(2, output_packets.size());
+  EXPECT_EQ(Timestamp(0), output_packets[0].Timestamp());
+  EXPECT_EQ(Timestamp(1), output_packets[1].Timestamp());
+
+  MP_ASSERT_OK(graph.CloseInputStream("tensor_in"));
+  MP_ASSERT_OK(graph.WaitUntilDone());
+}
+
+// Tests that a partial batch runs when the input timestamp bound advances
+// without a packet, even if no packet follows.
+TEST(TfLiteInferenceCalculatorTest, BatchRunsOnTimestampBound) {
+  CalculatorGraphConfig graph_config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "tensor_in"
+        input_stream: "allow"
+        node {
+          calculator: "GateCalculator"
+          input_stream: "tensor_in"
+          input_stream: "ALLOW:allow"
+          output_stream: "gated_tensor"
+        }
+        node {
+          calculator: "TfLiteInferenceCalculator"
+          input_stream: "TENSORS:gated_tensor"
+          output_stream: "TENSORS:tensor_out"
+          input_stream_handler {
+            input_stream_handler: "DefaultInputStreamHandler"
+          }
+          options {
+            [mediapipe.TfLiteInferenceCalculatorOptions.ext] {
+              model_path: "mediapipe/calculators/tflite/testdata/add.bin"
+              max_batch_size: 4
+              batch_timeout_us: 1000
+            }
+          }
+        }
+      )");
+  std::vector<Packet> output_packets;
+  tool::AddVectorSink("tensor_out", &graph_config, &output_packets);
+  CalculatorGraph graph(graph_config);
+  MP_ASSERT_OK(graph.StartRun({}));
+
+  // The packet at timestamp 1 is dropped by the gate.
+  std::vector<std::unique_ptr<Interpreter>> input_interpreters;
+  for (int t = 0; t < 2; ++t) {
+    input_interpreters.push_back(absl::make_unique<Interpreter>());
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "tensor_in", Adopt(MakeInputTensors({8, 8, 3}, t + 1,
+                                            input_interpreters.back().get())
+                               .release())
+                         .At(Timestamp(t))));
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "allow", MakePacket<bool>(t == 0).At(Timestamp(t))));
+  }
+  MP_ASSERT_OK(graph.WaitUntilIdle());
+  ASSERT_EQ(1, output_packets.size());
+  EXPECT_EQ(Timestamp(0), output_packets[0].Timestamp());
+  const auto& result_vec = output_packets[0].Get<std::vector<TfLiteTensor>>();
+  ASSERT_EQ(1, result_vec.size());
+  for (int i = 0; i < 8 * 8 * 3; ++i) {
+    ASSERT_EQ(3, result_vec[0].data.f[i]);
+  }
+
+  MP_ASSERT_OK(graph.CloseAllInputStreams());
+  MP_ASSERT_OK(graph.WaitUntilDone());
+  EXPECT_EQ(1, output_packets.size());
+}
+
+// Tests that batching is rejected for a calculator running in parallel.
+TEST(TfLiteInferenceCalculatorTest, MaxBatchSizeRequiresMaxInFlightOne) {
+  CalculatorGraphConfig graph_config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "tensor_in"
+        node {
+          calculator: "TfLiteInferenceCalculator"
+          input_stream: "TENSORS:tensor_in"
+          output_stream: "TENSORS:tensor_out"
+          max_in_flight: 2
+          options {
+            [mediapipe.TfLiteInferenceCalculatorOptions.ext] {
+              model_path: "mediapipe/calculators/tflite/testdata/add.bin"
+              max_batch_size: 2
+            }
+          }
+        }
+      )");
+  CalculatorGraph graph(graph_config);
+  ::mediapipe::Status status = graph.StartRun({});
+  if (status.ok()) {
+    status = graph.WaitUntilDone();
+  }
+  EXPECT_THAT(status.message(),
+              testing::HasSubstr("requires max_in_flight == 1"));
+}
+
+// Measures the throughput and the latency of face detection with batches of
+// up to state.range(0) frames. The frames are sent as fast as the graph
+// accepts them, and the latency is measured from sending each frame to
+// receiving its output.
+void BM_FaceDetectionMaxBatchSize(benchmark::State& state) {
+  constexpr int kFramesPerIteration = 16;
+  CalculatorGraphConfig graph_config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(absl::Substitute(
+          R"(
+            input_stream: "tensor_in"
+            output_stream: "tensor_out"
+            node {
+              calculator: "TfLiteInferenceCalculator"
+              input_stream: "TENSORS:tensor_in"
+              output_stream: "TENSORS:tensor_out"
+              input_stream_handler {
+                input_stream_handler: "DefaultInputStreamHandler"
+              }
+              options {
+                [mediapipe.TfLiteInferenceCalculatorOptions.ext] {
+                  model_path: "mediapipe/models/face_detection_front.tflite"
+                  max_batch_size: $0
+                }
+              }
+            }
+          )",
+          state.range(0)));
+  CalculatorGraph graph;
+  absl::Mutex mutex;
+  std::map<Timestamp, absl::Time> send_times;
+  absl::Duration total_latency;
+  int64 num_outputs = 0;
+  ::mediapipe::Status status = graph.Initialize(graph_config);
+  if (status.ok()) {
+    status = graph.ObserveOutputStream("tensor_out", [&](const Packet& p) {
+      absl::MutexLock lock(&mutex);
+      total_latency += absl::Now() - send_times[p.Timestamp()];
+      ++num_outputs;
+      return ::mediapipe::OkStatus();
+    });
+  }
+  if (status.ok()) {
+    status = graph.StartRun({});
+  }
+  if (!status.ok()) {
+    state.SkipWithError(status.ToString().c_str());
+    return;
+  }
+
+  Interpreter input_interpreter;
+  Packet input_packet = Adopt(
+      MakeInputTensors({1, 128, 128, 3}, 0.5f, &input_interpreter).release());
+  int64 timestamp = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < kFramesPerIteration; ++i) {
+      {
+        absl::MutexLock lock(&mutex);
+        send_times[Timestamp(timestamp)] = absl::Now();
+      }
+      CHECK(graph
+                .AddPacketToInputStream("tensor_in",
+                                        input_packet.At(Timestamp(timestamp)))
+                .ok());
+      ++timestamp;
+    }
+    CHECK(graph.WaitUntilIdle().ok());
+  }
+  CHECK(graph.CloseAllPacketSources().ok());
+  CHECK(graph.WaitUntilDone().ok());
+
+  state.SetItemsProcessed(num_outputs);
+  state.counters["latency_us"] = absl::ToDoubleMicroseconds(total_latency) /
+                                 std::max<int64>(num_outputs, 1);
+}
+BENCHMARK(BM_FaceDetectionMaxBatchSize)->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+
 }  // namespace mediapipe
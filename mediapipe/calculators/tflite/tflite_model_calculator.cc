@@ -19,6 +19,7 @@
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/packet.h"
 #include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/util/tflite/tflite_interpreter_pool.h"
 #include "tensorflow/lite/model.h"
 
 namespace mediapipe {
@@ -37,6 +38,11 @@ namespace mediapipe {
 //   MODEL - TfLite model. (std::unique_ptr<tflite::FlatBufferModel,
 //           std::function<void(tflite::FlatBufferModel*)>>)
 //
+// When a TfLiteInterpreterPool is provided through
+// kTfLiteInterpreterPoolService, graphs that load the same model blob share
+// one model, and the TfLiteInferenceCalculators that use it can share
+// interpreters.
+//
 // Example use:
 //
 // node {
@@ -54,6 +60,7 @@ class TfLiteModelCalculator : public CalculatorBase {
   static ::mediapipe::Status GetContract(CalculatorContract* cc) {
     cc->InputSidePackets().Tag("MODEL_BLOB").Set<std::string>();
     cc->OutputSidePackets().Tag("MODEL").Set<TfLiteModelPtr>();
+    cc->UseService(kTfLiteInterpreterPoolService).Optional();
     return ::mediapipe::OkStatus();
   }
 
@@ -65,14 +72,19 @@ class TfLiteModelCalculator : public CalculatorBase {
                                                  model_blob.size());
     RET_CHECK(model) << "Failed to load TfLite model from blob.";
 
-    cc->OutputSidePackets().Tag("MODEL").Set(
-        MakePacket<TfLiteModelPtr>(TfLiteModelPtr(
-            model.release(), [model_packet](tflite::FlatBufferModel* model) {
-              // Keeping model_packet in order to keep underlying model blob
-              // which can be released only after TfLite model is not needed
-              // anymore (deleted).
-              delete model;
-            })));
+    Packet output_packet = MakePacket<TfLiteModelPtr>(TfLiteModelPtr(
+        model.release(), [model_packet](tflite::FlatBufferModel* model) {
+          // Keeping model_packet in order to keep underlying model blob
+          // which can be released only after TfLite model is not needed
+          // anymore (deleted).
+          delete model;
+        }));
+    if (cc->Service(kTfLiteInterpreterPoolService).IsAvailable()) {
+      output_packet = cc->Service(kTfLiteInterpreterPoolService)
+                          .GetObject()
+                          .ShareModel(output_packet);
+    }
+    cc->OutputSidePackets().Tag("MODEL").Set(output_packet);
 
     return ::mediapipe::OkStatus();
   }
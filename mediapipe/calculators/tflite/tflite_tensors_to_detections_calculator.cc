@@ -12,6 +12,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <unordered_map>
 #include <vector>
 
@@ -27,6 +30,13 @@
 #include "mediapipe/util/tflite/config.h"
 #include "tensorflow/lite/interpreter.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MEDIAPIPE_TENSORS_TO_DETECTIONS_NEON 1
+#endif
+
 #if MEDIAPIPE_TFLITE_GL_INFERENCE
 #include "mediapipe/gpu/gl_calculator_helper.h"
 #include "tensorflow/lite/delegates/gpu/gl/gl_buffer.h"
@@ -78,19 +88,6 @@ struct GPUData {
 };
 #endif  // MEDIAPIPE_TFLITE_GPU_SUPPORTED
 
-void ConvertRawValuesToAnchors(const float* raw_anchors, int num_boxes,
-                               std::vector<Anchor>* anchors) {
-  anchors->clear();
-  for (int i = 0; i < num_boxes; ++i) {
-    Anchor new_anchor;
-    new_anchor.set_y_center(raw_anchors[i * kNumCoordsPerBox + 0]);
-    new_anchor.set_x_center(raw_anchors[i * kNumCoordsPerBox + 1]);
-    new_anchor.set_h(raw_anchors[i * kNumCoordsPerBox + 2]);
-    new_anchor.set_w(raw_anchors[i * kNumCoordsPerBox + 3]);
-    anchors->push_back(new_anchor);
-  }
-}
-
 void ConvertAnchorsToRawValues(const std::vector<Anchor>& anchors,
                                int num_boxes, float* raw_anchors) {
   CHECK_EQ(anchors.size(), num_boxes);
@@ -104,6 +101,65 @@ void ConvertAnchorsToRawValues(const std::vector<Anchor>& anchors,
   }
 }
 
+// The boxes whose top score passes the score threshold, decoded in SoA
+// layout.
+struct CandidateBoxes {
+  void Clear() {
+    box_indices.clear();
+    scores.clear();
+    classes.clear();
+  }
+
+  std::vector<int> box_indices;
+  std::vector<float> scores;
+  std::vector<int> classes;
+  std::vector<float> ymin;
+  std::vector<float> xmin;
+  std::vector<float> ymax;
+  std::vector<float> xmax;
+  // The (x, y) values of the keypoints of each box.
+  std::vector<float> keypoints;
+};
+
+// Appends the indices of the values that are not less than threshold.
+void FindValuesAboveThreshold(const float* values, int count, float threshold,
+                              std::vector<int>* indices) {
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128 threshold4 = _mm_set1_ps(threshold);
+  for (; i + 4 <= count; i += 4) {
+    const int mask =
+        _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(values + i), threshold4));
+    if (mask == 0) {
+      continue;
+    }
+    for (int lane = 0; lane < 4; ++lane) {
+      if (mask & (1 << lane)) {
+        indices->push_back(i + lane);
+      }
+    }
+  }
+#elif defined(MEDIAPIPE_TENSORS_TO_DETECTIONS_NEON)
+  const float32x4_t threshold4 = vdupq_n_f32(threshold);
+  for (; i + 4 <= count; i += 4) {
+    const uint32x4_t mask = vcgeq_f32(vld1q_f32(values + i), threshold4);
+    if (vget_lane_u64(vreinterpret_u64_u16(vmovn_u32(mask)), 0) == 0) {
+      continue;
+    }
+    for (int lane = 0; lane < 4; ++lane) {
+      if (values[i + lane] >= threshold) {
+        indices->push_back(i + lane);
+      }
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    if (values[i] >= threshold) {
+      indices->push_back(i);
+    }
+  }
+}
+
 }  // namespace
 
 // Convert result TFLite tensors from object detection models into MediaPipe
@@ -157,9 +213,14 @@ class TfLiteTensorsToDetectionsCalculator : public CalculatorBase {
 
   ::mediapipe::Status LoadOptions(CalculatorContext* cc);
   ::mediapipe::Status GpuInit(CalculatorContext* cc);
-  ::mediapipe::Status DecodeBoxes(const float* raw_boxes,
-                                  const std::vector<Anchor>& anchors,
-                                  std::vector<float>* boxes);
+  // Finds the candidate boxes, whose top score passes min_score_thresh. The
+  // boxes are filtered by their raw scores, so that sigmoid_score only
+  // applies to the boxes that are likely to pass.
+  void FilterBoxesByScore(const float* raw_scores);
+  // Decodes the boxes and keypoints of the candidate boxes.
+  void DecodeCandidateBoxes(const float* raw_boxes);
+  void ConvertCandidatesToDetections(
+      std::vector<Detection>* output_detections);
   ::mediapipe::Status ConvertToDetections(
       const float* detection_boxes, const float* detection_scores,
       const int* detection_classes, std::vector<Detection>* output_detections);
@@ -171,10 +232,17 @@ class TfLiteTensorsToDetectionsCalculator : public CalculatorBase {
   int num_boxes_ = 0;
   int num_coords_ = 0;
   std::set<int> ignore_classes_;
+  // The classes that are not ignored.
+  std::vector<int> active_classes_;
+  // The boxes whose raw top score is less than this are known not to pass
+  // min_score_thresh.
+  float raw_score_thresh_ = -std::numeric_limits<float>::infinity();
 
   ::mediapipe::TfLiteTensorsToDetectionsCalculatorOptions options_;
-  std::vector<Anchor> anchors_;
+  // The [y_center, x_center, h, w] values of each anchor.
+  std::vector<float> anchor_values_;
   bool side_packet_anchors_{};
+  CandidateBoxes candidates_;
 
 #if MEDIAPIPE_TFLITE_GL_INFERENCE
   mediapipe::GlCalculatorHelper gpu_helper_;
@@ -307,54 +375,22 @@ REGISTER_CALCULATOR(TfLiteTensorsToDetectionsCalculator);
         CHECK_EQ(anchor_tensor->dims->data[0], num_boxes_);
         CHECK_EQ(anchor_tensor->dims->data[1], kNumCoordsPerBox);
         const float* raw_anchors = anchor_tensor->data.f;
-        ConvertRawValuesToAnchors(raw_anchors, num_boxes_, &anchors_);
+        anchor_values_.assign(raw_anchors,
+                              raw_anchors + num_boxes_ * kNumCoordsPerBox);
       } else if (side_packet_anchors_) {
         CHECK(!cc->InputSidePackets().Tag("ANCHORS").IsEmpty());
-        anchors_ =
+        const auto& anchors =
             cc->InputSidePackets().Tag("ANCHORS").Get<std::vector<Anchor>>();
+        anchor_values_.resize(num_boxes_ * kNumCoordsPerBox);
+        ConvertAnchorsToRawValues(anchors, num_boxes_, anchor_values_.data());
       } else {
         return ::mediapipe::UnavailableError("No anchor data available.");
       }
       anchors_init_ = true;
     }
-    std::vector<float> boxes(num_boxes_ * num_coords_);
-    MP_RETURN_IF_ERROR(DecodeBoxes(raw_boxes, anchors_, &boxes));
-
-    std::vector<float> detection_scores(num_boxes_);
-    std::vector<int> detection_classes(num_boxes_);
-
-    // Filter classes by scores.
-    for (int i = 0; i < num_boxes_; ++i) {
-      int class_id = -1;
-      float max_score = -std::numeric_limits<float>::max();
-      // Find the top score for box i.
-      for (int score_idx = 0; score_idx < num_classes_; ++score_idx) {
-        if (ignore_classes_.find(score_idx) == ignore_classes_.end()) {
-          auto score = raw_scores[i * num_classes_ + score_idx];
-          if (options_.sigmoid_score()) {
-            if (options_.has_score_clipping_thresh()) {
-              score = score < -options_.score_clipping_thresh()
-                          ? -options_.score_clipping_thresh()
-                          : score;
-              score = score > options_.score_clipping_thresh()
-                          ? options_.score_clipping_thresh()
-                          : score;
-            }
-            score = 1.0f / (1.0f + std::exp(-score));
-          }
-          if (max_score < score) {
-            max_score = score;
-            class_id = score_idx;
-          }
-        }
-      }
-      detection_scores[i] = max_score;
-      detection_classes[i] = class_id;
-    }
-
-    MP_RETURN_IF_ERROR(
-        ConvertToDetections(boxes.data(), detection_scores.data(),
-                            detection_classes.data(), output_detections));
+    FilterBoxesByScore(raw_scores);
+    DecodeCandidateBoxes(raw_boxes);
+    ConvertCandidatesToDetections(output_detections);
   } else {
     // Postprocessing on CPU with postprocessing op (e.g. anchor decoding and
     // non-maximum suppression) within the model.
@@ -578,72 +614,229 @@ REGISTER_CALCULATOR(TfLiteTensorsToDetectionsCalculator);
   for (int i = 0; i < options_.ignore_classes_size(); ++i) {
     ignore_classes_.insert(options_.ignore_classes(i));
   }
+  for (int i = 0; i < num_classes_; ++i) {
+    if (ignore_classes_.find(i) == ignore_classes_.end()) {
+      active_classes_.push_back(i);
+    }
+  }
+
+  if (options_.has_min_score_thresh()) {
+    if (!options_.sigmoid_score()) {
+      raw_score_thresh_ = options_.min_score_thresh();
+    } else {
+      // Use the inverse sigmoid of a slightly lower threshold, so that float
+      // rounding never filters out a box whose computed sigmoid passes. The
+      // float sigmoid reaches 1 for raw scores above 16, so the threshold is
+      // at most 15.
+      const double min_score = options_.min_score_thresh() - 1e-6;
+      if (min_score >= 1.0) {
+        raw_score_thresh_ = 15.0f;
+      } else if (min_score > 0.0) {
+        raw_score_thresh_ = static_cast<float>(
+            std::min(std::log(min_score / (1.0 - min_score)), 15.0));
+      }
+      // Clipped raw scores are at least -score_clipping_thresh.
+      if (options_.has_score_clipping_thresh() &&
+          raw_score_thresh_ <= -options_.score_clipping_thresh()) {
+        raw_score_thresh_ = -std::numeric_limits<float>::infinity();
+      }
+    }
+  }
 
   return ::mediapipe::OkStatus();
 }
 
-::mediapipe::Status TfLiteTensorsToDetectionsCalculator::DecodeBoxes(
-    const float* raw_boxes, const std::vector<Anchor>& anchors,
-    std::vector<float>* boxes) {
-  for (int i = 0; i < num_boxes_; ++i) {
-    const int box_offset = i * num_coords_ + options_.box_coord_offset();
-
-    float y_center = raw_boxes[box_offset];
-    float x_center = raw_boxes[box_offset + 1];
-    float h = raw_boxes[box_offset + 2];
-    float w = raw_boxes[box_offset + 3];
-    if (options_.reverse_output_order()) {
-      x_center = raw_boxes[box_offset];
-      y_center = raw_boxes[box_offset + 1];
-      w = raw_boxes[box_offset + 2];
-      h = raw_boxes[box_offset + 3];
+void TfLiteTensorsToDetectionsCalculator::FilterBoxesByScore(
+    const float* raw_scores) {
+  candidates_.Clear();
+  if (num_classes_ == 1 && active_classes_.size() == 1) {
+    FindValuesAboveThreshold(raw_scores, num_boxes_, raw_score_thresh_,
+                             &candidates_.box_indices);
+    for (int box : candidates_.box_indices) {
+      candidates_.scores.push_back(raw_scores[box]);
+      candidates_.classes.push_back(0);
     }
+  } else {
+    // Scores are clipped before they are compared, so that clipped ties go
+    // to the lowest class index as well.
+    const bool clip_scores =
+        options_.sigmoid_score() && options_.has_score_clipping_thresh();
+    const float clip_thresh = options_.score_clipping_thresh();
+    for (int i = 0; i < num_boxes_; ++i) {
+      const float* box_scores = raw_scores + i * num_classes_;
+      int class_id = -1;
+      float max_score = -std::numeric_limits<float>::max();
+      // Find the top clipped score for box i. The sigmoid preserves the
+      // order of the scores, so it applies to the top score only. Ties it
+      // introduces are resolved below.
+      for (int score_idx : active_classes_) {
+        float score = box_scores[score_idx];
+        if (clip_scores) {
+          score = std::min(std::max(score, -clip_thresh), clip_thresh);
+        }
+        if (max_score < score) {
+          max_score = score;
+          class_id = score_idx;
+        }
+      }
+      if (class_id == -1 || max_score >= raw_score_thresh_) {
+        candidates_.box_indices.push_back(i);
+        candidates_.scores.push_back(max_score);
+        candidates_.classes.push_back(class_id);
+      }
+    }
+  }
 
-    x_center =
-        x_center / options_.x_scale() * anchors[i].w() + anchors[i].x_center();
-    y_center =
-        y_center / options_.y_scale() * anchors[i].h() + anchors[i].y_center();
+  // Compute the final scores, and drop the boxes that do not pass.
+  int num_candidates = 0;
+  for (int k = 0; k < candidates_.box_indices.size(); ++k) {
+    float score = candidates_.scores[k];
+    if (options_.sigmoid_score() && candidates_.classes[k] != -1) {
+      if (options_.has_score_clipping_thresh()) {
+        score = score < -options_.score_clipping_thresh()
+                    ? -options_.score_clipping_thresh()
+                    : score;
+        score = score > options_.score_clipping_thresh()
+                    ? options_.score_clipping_thresh()
+                    : score;
+      }
+      score = 1.0f / (1.0f + std::exp(-score));
+    }
+    if (options_.has_min_score_thresh() &&
+        score < options_.min_score_thresh()) {
+      continue;
+    }
+    int class_id = candidates_.classes[k];
+    if (options_.sigmoid_score() && class_id != -1 &&
+        active_classes_.size() > 1) {
+      // The float sigmoid maps distinct raw scores to the same value, e.g.
+      // all scores above ~17 to 1. The top score then belongs to the lowest
+      // class index with that value, as when comparing sigmoid scores.
+      const float* box_scores =
+          raw_scores + candidates_.box_indices[k] * num_classes_;
+      for (int score_idx : active_classes_) {
+        if (score_idx >= class_id) {
+          break;
+        }
+        float class_score = box_scores[score_idx];
+        if (options_.has_score_clipping_thresh()) {
+          class_score =
+              std::min(std::max(class_score, -options_.score_clipping_thresh()),
+                       options_.score_clipping_thresh());
+        }
+        if (1.0f / (1.0f + std::exp(-class_score)) == score) {
+          class_id = score_idx;
+          break;
+        }
+      }
+    }
+    candidates_.box_indices[num_candidates] = candidates_.box_indices[k];
+    candidates_.scores[num_candidates] = score;
+    candidates_.classes[num_candidates] = class_id;
+    ++num_candidates;
+  }
+  candidates_.box_indices.resize(num_candidates);
+  candidates_.scores.resize(num_candidates);
+  candidates_.classes.resize(num_candidates);
+}
 
+void TfLiteTensorsToDetectionsCalculator::DecodeCandidateBoxes(
+    const float* raw_boxes) {
+  const int num_candidates = candidates_.box_indices.size();
+  std::vector<float>& ymin = candidates_.ymin;
+  std::vector<float>& xmin = candidates_.xmin;
+  std::vector<float>& ymax = candidates_.ymax;
+  std::vector<float>& xmax = candidates_.xmax;
+  ymin.resize(num_candidates);
+  xmin.resize(num_candidates);
+  ymax.resize(num_candidates);
+  xmax.resize(num_candidates);
+
+  // Gather the raw boxes into ymin (y_center), xmin (x_center), ymax (h) and
+  // xmax (w), which are then decoded in place, one coordinate at a time.
+  const int y_index = options_.reverse_output_order() ? 1 : 0;
+  const int x_index = 1 - y_index;
+  for (int k = 0; k < num_candidates; ++k) {
+    const float* raw_box = raw_boxes +
+                           candidates_.box_indices[k] * num_coords_ +
+                           options_.box_coord_offset();
+    ymin[k] = raw_box[y_index];
+    xmin[k] = raw_box[x_index];
+    ymax[k] = raw_box[2 + y_index];
+    xmax[k] = raw_box[2 + x_index];
+  }
+  for (int k = 0; k < num_candidates; ++k) {
+    const float* anchor =
+        anchor_values_.data() + candidates_.box_indices[k] * kNumCoordsPerBox;
+    const float anchor_y_center = anchor[0];
+    const float anchor_x_center = anchor[1];
+    const float anchor_h = anchor[2];
+    const float anchor_w = anchor[3];
+
+    const float x_center =
+        xmin[k] / options_.x_scale() * anchor_w + anchor_x_center;
+    const float y_center =
+        ymin[k] / options_.y_scale() * anchor_h + anchor_y_center;
+    float h;
+    float w;
     if (options_.apply_exponential_on_box_size()) {
-      h = std::exp(h / options_.h_scale()) * anchors[i].h();
-      w = std::exp(w / options_.w_scale()) * anchors[i].w();
+      h = std::exp(ymax[k] / options_.h_scale()) * anchor_h;
+      w = std::exp(xmax[k] / options_.w_scale()) * anchor_w;
     } else {
-      h = h / options_.h_scale() * anchors[i].h();
-      w = w / options_.w_scale() * anchors[i].w();
+      h = ymax[k] / options_.h_scale() * anchor_h;
+      w = xmax[k] / options_.w_scale() * anchor_w;
     }
 
-    const float ymin = y_center - h / 2.f;
-    const float xmin = x_center - w / 2.f;
-    const float ymax = y_center + h / 2.f;
-    const float xmax = x_center + w / 2.f;
-
-    (*boxes)[i * num_coords_ + 0] = ymin;
-    (*boxes)[i * num_coords_ + 1] = xmin;
-    (*boxes)[i * num_coords_ + 2] = ymax;
-    (*boxes)[i * num_coords_ + 3] = xmax;
-
-    if (options_.num_keypoints()) {
-      for (int k = 0; k < options_.num_keypoints(); ++k) {
-        const int offset = i * num_coords_ + options_.keypoint_coord_offset() +
-                           k * options_.num_values_per_keypoint();
-
-        float keypoint_y = raw_boxes[offset];
-        float keypoint_x = raw_boxes[offset + 1];
-        if (options_.reverse_output_order()) {
-          keypoint_x = raw_boxes[offset];
-          keypoint_y = raw_boxes[offset + 1];
-        }
+    ymin[k] = y_center - h / 2.f;
+    xmin[k] = x_center - w / 2.f;
+    ymax[k] = y_center + h / 2.f;
+    xmax[k] = x_center + w / 2.f;
+  }
 
-        (*boxes)[offset] = keypoint_x / options_.x_scale() * anchors[i].w() +
-                           anchors[i].x_center();
-        (*boxes)[offset + 1] =
-            keypoint_y / options_.y_scale() * anchors[i].h() +
-            anchors[i].y_center();
-      }
+  const int num_keypoints = options_.num_keypoints();
+  candidates_.keypoints.resize(num_candidates * num_keypoints * 2);
+  for (int k = 0; k < num_candidates; ++k) {
+    const int box = candidates_.box_indices[k];
+    const float* anchor = anchor_values_.data() + box * kNumCoordsPerBox;
+    float* keypoints = candidates_.keypoints.data() + k * num_keypoints * 2;
+    for (int kp = 0; kp < num_keypoints; ++kp) {
+      const float* raw_keypoint = raw_boxes + box * num_coords_ +
+                                  options_.keypoint_coord_offset() +
+                                  kp * options_.num_values_per_keypoint();
+      const float keypoint_y = raw_keypoint[y_index];
+      const float keypoint_x = raw_keypoint[x_index];
+      keypoints[kp * 2] =
+          keypoint_x / options_.x_scale() * anchor[3] + anchor[1];
+      keypoints[kp * 2 + 1] =
+          keypoint_y / options_.y_scale() * anchor[2] + anchor[0];
     }
   }
+}
 
-  return ::mediapipe::OkStatus();
+void TfLiteTensorsToDetectionsCalculator::ConvertCandidatesToDetections(
+    std::vector<Detection>* output_detections) {
+  const int num_candidates = candidates_.box_indices.size();
+  const int num_keypoints = options_.num_keypoints();
+  output_detections->reserve(output_detections->size() + num_candidates);
+  for (int k = 0; k < num_candidates; ++k) {
+    Detection detection = ConvertToDetection(
+        candidates_.ymin[k], candidates_.xmin[k], candidates_.ymax[k],
+        candidates_.xmax[k], candidates_.scores[k], candidates_.classes[k],
+        options_.flip_vertically());
+    if (num_keypoints > 0) {
+      auto* location_data = detection.mutable_location_data();
+      const float* keypoints =
+          candidates_.keypoints.data() + k * num_keypoints * 2;
+      for (int kp = 0; kp < num_keypoints; ++kp) {
+        auto keypoint = location_data->add_relative_keypoints();
+        keypoint->set_x(keypoints[kp * 2]);
+        keypoint->set_y(options_.flip_vertically()
+                            ? 1.f - keypoints[kp * 2 + 1]
+                            : keypoints[kp * 2 + 1]);
+      }
+    }
+    output_detections->emplace_back(std::move(detection));
+  }
 }
 
 ::mediapipe::Status TfLiteTensorsToDetectionsCalculator::ConvertToDetections(
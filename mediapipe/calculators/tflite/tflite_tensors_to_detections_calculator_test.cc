@@ -0,0 +1,275 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/substitute.h"
+#include "mediapipe/calculators/tflite/tflite_tensors_to_detections_calculator.pb.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/calculator_runner.h"
+#include "mediapipe/framework/formats/detection.pb.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"  // NOLINT
+#include "tensorflow/lite/interpreter.h"
+
+namespace mediapipe {
+namespace {
+
+using ::tflite::Interpreter;
+
+// Returns the raw box, raw score and anchor tensors, whose data is owned by
+// interpreter.
+std::unique_ptr<std::vector<TfLiteTensor>> MakeInputTensors(
+    int num_boxes, int num_coords, int num_classes,
+    const std::vector<float>& raw_boxes, const std::vector<float>& raw_scores,
+    const std::vector<float>& anchors, Interpreter* interpreter) {
+  CHECK_EQ(raw_boxes.size(), num_boxes * num_coords);
+  CHECK_EQ(raw_scores.size(), num_boxes * num_classes);
+  CHECK_EQ(anchors.size(), num_boxes * 4);
+  interpreter->AddTensors(3);
+  interpreter->SetInputs({0, 1, 2});
+  interpreter->SetTensorParametersReadWrite(
+      0, kTfLiteFloat32, "", {1, num_boxes, num_coords}, TfLiteQuantization());
+  interpreter->SetTensorParametersReadWrite(
+      1, kTfLiteFloat32, "", {1, num_boxes, num_classes}, TfLiteQuantization());
+  interpreter->SetTensorParametersReadWrite(
+      2, kTfLiteFloat32, "", {num_boxes, 4}, TfLiteQuantization());
+  interpreter->AllocateTensors();
+  std::copy(raw_boxes.begin(), raw_boxes.end(), interpreter->tensor(0)->data.f);
+  std::copy(raw_scores.begin(), raw_scores.end(),
+            interpreter->tensor(1)->data.f);
+  std::copy(anchors.begin(), anchors.end(), interpreter->tensor(2)->data.f);
+  auto tensors = absl::make_unique<std::vector<TfLiteTensor>>();
+  for (int i = 0; i < 3; ++i) {
+    tensors->emplace_back(*interpreter->tensor(i));
+  }
+  return tensors;
+}
+
+// Runs the calculator with the given options on one set of tensors.
+std::vector<Detection> RunCalculator(const std::string& options,
+                                     std::unique_ptr<std::vector<TfLiteTensor>>
+                                         tensors) {
+  CalculatorRunner runner(ParseTextProtoOrDie<CalculatorGraphConfig::Node>(
+      absl::Substitute(R"(
+        calculator: "TfLiteTensorsToDetectionsCalculator"
+        input_stream: "TENSORS:tensors"
+        output_stream: "DETECTIONS:detections"
+        options {
+          [mediapipe.TfLiteTensorsToDetectionsCalculatorOptions.ext] {
+            $0
+          }
+        }
+      )",
+                       options)));
+  runner.MutableInputs()->Tag("TENSORS").packets.push_back(
+      Adopt(tensors.release()).At(Timestamp(0)));
+  MEDIAPIPE_CHECK_OK(runner.Run());
+  const auto& packets = runner.Outputs().Tag("DETECTIONS").packets;
+  CHECK_EQ(packets.size(), 1);
+  return packets[0].Get<std::vector<Detection>>();
+}
+
+TEST(TfLiteTensorsToDetectionsCalculatorTest, SigmoidScoreThreshold) {
+  Interpreter interpreter;
+  std::vector<float> raw_boxes(4 * 4, 0.f);
+  raw_boxes[8] = 0.1f;
+  raw_boxes[9] = 0.2f;
+  raw_boxes[10] = 0.5f;
+  raw_boxes[11] = 0.25f;
+  std::vector<float> anchors;
+  for (int i = 0; i < 4; ++i) {
+    anchors.insert(anchors.end(), {0.5f, 0.5f, 0.2f, 0.4f});
+  }
+  const std::vector<Detection> detections = RunCalculator(
+      R"(num_classes: 1 num_boxes: 4 num_coords: 4
+         x_scale: 1 y_scale: 1 w_scale: 1 h_scale: 1
+         sigmoid_score: true min_score_thresh: 0.5)",
+      MakeInputTensors(4, 4, 1, raw_boxes, {-1.f, 0.f, 2.f, 0.5f}, anchors,
+                       &interpreter));
+
+  // A raw score of 0 has a score of exactly 0.5, which passes.
+  ASSERT_EQ(3, detections.size());
+  EXPECT_EQ(0.5f, detections[0].score(0));
+  EXPECT_FLOAT_EQ(1.f / (1.f + std::exp(-2.f)), detections[1].score(0));
+  EXPECT_FLOAT_EQ(1.f / (1.f + std::exp(-0.5f)), detections[2].score(0));
+  EXPECT_EQ(0, detections[1].label_id(0));
+  const auto& box = detections[1].location_data().relative_bounding_box();
+  EXPECT_FLOAT_EQ(0.53f, box.xmin());
+  EXPECT_FLOAT_EQ(0.47f, box.ymin());
+  EXPECT_FLOAT_EQ(0.1f, box.width());
+  EXPECT_FLOAT_EQ(0.1f, box.height());
+}
+
+TEST(TfLiteTensorsToDetectionsCalculatorTest, ScoreClipping) {
+  Interpreter interpreter;
+  // The scores are clipped to -1, whose sigmoid passes the threshold.
+  const std::vector<Detection> detections = RunCalculator(
+      R"(num_classes: 1 num_boxes: 2 num_coords: 4
+         x_scale: 1 y_scale: 1 w_scale: 1 h_scale: 1
+         sigmoid_score: true score_clipping_thresh: 1
+         min_score_thresh: 0.25)",
+      MakeInputTensors(2, 4, 1, std::vector<float>(8, 0.f), {-5.f, -3.f},
+                       std::vector<float>(8, 0.5f), &interpreter));
+  ASSERT_EQ(2, detections.size());
+  EXPECT_FLOAT_EQ(1.f / (1.f + std::exp(1.f)), detections[0].score(0));
+}
+
+TEST(TfLiteTensorsToDetectionsCalculatorTest, IgnoreClasses) {
+  Interpreter interpreter;
+  const std::vector<Detection> detections = RunCalculator(
+      R"(num_classes: 3 num_boxes: 2 num_coords: 4
+         x_scale: 1 y_scale: 1 w_scale: 1 h_scale: 1
+         ignore_classes: 0 min_score_thresh: 0)",
+      MakeInputTensors(2, 4, 3, std::vector<float>(8, 0.f),
+                       {5.f, 1.f, 2.f, 9.f, -1.f, -3.f},
+                       std::vector<float>(8, 0.5f), &interpreter));
+  ASSERT_EQ(1, detections.size());
+  EXPECT_EQ(2, detections[0].label_id(0));
+  EXPECT_EQ(2.f, detections[0].score(0));
+}
+
+TEST(TfLiteTensorsToDetectionsCalculatorTest, TiedScoresGoToLowestClass) {
+  Interpreter interpreter;
+  // In box 0, classes 1 and 2 are clipped to 10. In box 1, the sigmoid of
+  // classes 1 and 2 is exactly 1.
+  const std::vector<Detection> clipped_detections = RunCalculator(
+      R"(num_classes: 3 num_boxes: 2 num_coords: 4
+         x_scale: 1 y_scale: 1 w_scale: 1 h_scale: 1
+         sigmoid_score: true score_clipping_thresh: 10
+         min_score_thresh: 0.5)",
+      MakeInputTensors(2, 4, 3, std::vector<float>(8, 0.f),
+                       {1.f, 12.f, 15.f, 0.f, 5.f, 6.f},
+                       std::vector<float>(8, 0.5f), &interpreter));
+  ASSERT_EQ(2, clipped_detections.size());
+  EXPECT_EQ(1, clipped_detections[0].label_id(0));
+  EXPECT_EQ(1.f / (1.f + std::exp(-10.f)), clipped_detections[0].score(0));
+  EXPECT_EQ(2, clipped_detections[1].label_id(0));
+
+  Interpreter saturated_interpreter;
+  const std::vector<Detection> saturated_detections = RunCalculator(
+      R"(num_classes: 3 num_boxes: 2 num_coords: 4
+         x_scale: 1 y_scale: 1 w_scale: 1 h_scale: 1
+         sigmoid_score: true min_score_thresh: 0.5)",
+      MakeInputTensors(2, 4, 3, std::vector<float>(8, 0.f),
+                       {1.f, 12.f, 15.f, 0.f, 18.f, 20.f},
+                       std::vector<float>(8, 0.5f), &saturated_interpreter));
+  ASSERT_EQ(2, saturated_detections.size());
+  EXPECT_EQ(2, saturated_detections[0].label_id(0));
+  EXPECT_EQ(1, saturated_detections[1].label_id(0));
+  EXPECT_EQ(1.f, saturated_detections[1].score(0));
+}
+
+TEST(TfLiteTensorsToDetectionsCalculatorTest, KeypointsInReverseOrder) {
+  Interpreter interpreter;
+  const std::vector<Detection> detections = RunCalculator(
+      R"(num_classes: 1 num_boxes: 1 num_coords: 8
+         num_keypoints: 2 keypoint_coord_offset: 4
+         x_scale: 2 y_scale: 2 w_scale: 2 h_scale: 2
+         apply_exponential_on_box_size: true reverse_output_order: true)",
+      MakeInputTensors(1, 8, 1, {0.2f, 0.4f, 0.f, 0.f, 1.f, -1.f, 0.f, 0.5f},
+                       {0.f}, {0.5f, 0.5f, 0.2f, 0.4f}, &interpreter));
+  ASSERT_EQ(1, detections.size());
+  const auto& location_data = detections[0].location_data();
+  EXPECT_FLOAT_EQ(0.34f, location_data.relative_bounding_box().xmin());
+  EXPECT_FLOAT_EQ(0.44f, location_data.relative_bounding_box().ymin());
+  EXPECT_FLOAT_EQ(0.4f, location_data.relative_bounding_box().width());
+  EXPECT_FLOAT_EQ(0.2f, location_data.relative_bounding_box().height());
+  ASSERT_EQ(2, location_data.relative_keypoints_size());
+  EXPECT_FLOAT_EQ(0.7f, location_data.relative_keypoints(0).x());
+  EXPECT_FLOAT_EQ(0.4f, location_data.relative_keypoints(0).y());
+  EXPECT_FLOAT_EQ(0.5f, location_data.relative_keypoints(1).x());
+  EXPECT_FLOAT_EQ(0.55f, location_data.relative_keypoints(1).y());
+}
+
+// Measures decoding the outputs of a BlazeFace-like model, with 2944 anchors
+// of which one in every state.range(0) passes the score threshold.
+void BM_DecodeDetections(benchmark::State& state) {
+  constexpr int kNumBoxes = 2944;
+  constexpr int kNumCoords = 16;
+  constexpr int kPacketsPerIteration = 16;
+  std::vector<float> raw_boxes(kNumBoxes * kNumCoords);
+  std::vector<float> raw_scores(kNumBoxes);
+  std::vector<float> anchors(kNumBoxes * 4);
+  for (int i = 0; i < kNumBoxes; ++i) {
+    for (int j = 0; j < kNumCoords; ++j) {
+      raw_boxes[i * kNumCoords + j] = (i + j) % 7 - 3.f;
+    }
+    raw_scores[i] = i % state.range(0) == 0 ? 3.f : -3.f;
+    anchors[i * 4 + 0] = (i % 64) / 64.f;
+    anchors[i * 4 + 1] = (i / 64) / 46.f;
+    anchors[i * 4 + 2] = 1.f;
+    anchors[i * 4 + 3] = 1.f;
+  }
+  Interpreter interpreter;
+  Packet tensors =
+      Adopt(MakeInputTensors(kNumBoxes, kNumCoords, 1, raw_boxes, raw_scores,
+                             anchors, &interpreter)
+                .release());
+
+  CalculatorGraphConfig graph_config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "tensors"
+        node {
+          calculator: "TfLiteTensorsToDetectionsCalculator"
+          input_stream: "TENSORS:tensors"
+          output_stream: "DETECTIONS:detections"
+          options {
+            [mediapipe.TfLiteTensorsToDetectionsCalculatorOptions.ext] {
+              num_classes: 1
+              num_boxes: 2944
+              num_coords: 16
+              box_coord_offset: 0
+              keypoint_coord_offset: 4
+              num_keypoints: 6
+              num_values_per_keypoint: 2
+              sigmoid_score: true
+              score_clipping_thresh: 100.0
+              reverse_output_order: true
+              x_scale: 256.0
+              y_scale: 256.0
+              h_scale: 256.0
+              w_scale: 256.0
+              min_score_thresh: 0.75
+            }
+          }
+        }
+      )");
+  CalculatorGraph graph;
+  CHECK(graph.Initialize(graph_config).ok());
+  CHECK(graph.StartRun({}).ok());
+  int64 timestamp = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < kPacketsPerIteration; ++i) {
+      CHECK(graph
+                .AddPacketToInputStream("tensors",
+                                        tensors.At(Timestamp(timestamp++)))
+                .ok());
+    }
+    CHECK(graph.WaitUntilIdle().ok());
+  }
+  CHECK(graph.CloseAllPacketSources().ok());
+  CHECK(graph.WaitUntilDone().ok());
+  state.SetItemsProcessed(timestamp);
+}
+BENCHMARK(BM_DecodeDetections)->Arg(1)->Arg(100);
+
+}  // namespace
+}  // namespace mediapipe
@@ -15,6 +15,7 @@
 #include <algorithm>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -25,12 +26,13 @@
 #include "mediapipe/framework/formats/location.h"
 #include "mediapipe/framework/port/logging.h"
 #include "mediapipe/framework/port/rectangle.h"
+#include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/status.h"
+#include "mediapipe/util/non_max_suppression.h"
 
 namespace mediapipe {
 
 typedef std::vector<Detection> Detections;
-typedef std::vector<std::pair<int, float>> IndexedScores;
 
 namespace {
 
@@ -72,51 +74,20 @@ bool RetainMaxScoringLabelOnly(Detection* detection) {
   return true;
 }
 
-// Computes an overlap similarity between two rectangles. Similarity measure is
-// defined by overlap_type parameter.
-float OverlapSimilarity(
-    const NonMaxSuppressionCalculatorOptions::OverlapType overlap_type,
-    const Rectangle_f& rect1, const Rectangle_f& rect2) {
-  if (!rect1.Intersects(rect2)) return 0.0f;
-  const float intersection_area = Rectangle_f(rect1).Intersect(rect2).Area();
-  float normalization;
+// Returns the NonMaxSuppressor overlap type matching overlap_type.
+NonMaxSuppressor::OverlapType GetOverlapType(
+    NonMaxSuppressionCalculatorOptions::OverlapType overlap_type) {
   switch (overlap_type) {
     case NonMaxSuppressionCalculatorOptions::JACCARD:
-      normalization = Rectangle_f(rect1).Union(rect2).Area();
-      break;
+      return NonMaxSuppressor::OverlapType::kJaccard;
     case NonMaxSuppressionCalculatorOptions::MODIFIED_JACCARD:
-      normalization = rect2.Area();
-      break;
+      return NonMaxSuppressor::OverlapType::kModifiedJaccard;
     case NonMaxSuppressionCalculatorOptions::INTERSECTION_OVER_UNION:
-      normalization = rect1.Area() + rect2.Area() - intersection_area;
-      break;
+      return NonMaxSuppressor::OverlapType::kIntersectionOverUnion;
     default:
       LOG(FATAL) << "Unrecognized overlap type: " << overlap_type;
+      return NonMaxSuppressor::OverlapType::kJaccard;
   }
-  return normalization > 0.0f ? intersection_area / normalization : 0.0f;
-}
-
-// Computes an overlap similarity between two locations by first extracting the
-// relative box (dimension normalized by frame width/height) from the location.
-float OverlapSimilarity(
-    const int frame_width, const int frame_height,
-    const NonMaxSuppressionCalculatorOptions::OverlapType overlap_type,
-    const Location& location1, const Location& location2) {
-  const auto rect1 = location1.ConvertToRelativeBBox(frame_width, frame_height);
-  const auto rect2 = location2.ConvertToRelativeBBox(frame_width, frame_height);
-  return OverlapSimilarity(overlap_type, rect1, rect2);
-}
-
-// Computes an overlap similarity between two locations by first extracting the
-// relative box from the location. It assumes that a relative-box representation
-// is already available in the location, and therefore frame width and height
-// are not needed for further normalization.
-float OverlapSimilarity(
-    const NonMaxSuppressionCalculatorOptions::OverlapType overlap_type,
-    const Location& location1, const Location& location2) {
-  const auto rect1 = location1.GetRelativeBBox();
-  const auto rect2 = location2.GetRelativeBBox();
-  return OverlapSimilarity(overlap_type, rect1, rect2);
 }
 
 }  // namespace
@@ -176,6 +147,12 @@ class NonMaxSuppressionCalculator : public CalculatorBase {
         << "max_num_detections=0 is not a valid value. Please choose a "
         << "positive number of you want to limit the number of output "
         << "detections, or set -1 if you do not want any limit.";
+    nms_options_.overlap_type = GetOverlapType(options_.overlap_type());
+    nms_options_.min_suppression_threshold =
+        options_.min_suppression_threshold();
+    nms_options_.min_score_threshold = options_.min_score_threshold();
+    nms_options_.max_num_boxes = options_.max_num_detections();
+    nms_options_.per_class = options_.suppress_per_label();
     return ::mediapipe::OkStatus();
   }
 
@@ -209,37 +186,56 @@ class NonMaxSuppressionCalculator : public CalculatorBase {
     pruned_detections.reserve(input_detections.size());
     for (auto& detection : input_detections) {
       if (RetainMaxScoringLabelOnly(&detection)) {
-        pruned_detections.push_back(detection);
+        pruned_detections.push_back(std::move(detection));
       }
     }
 
-    // Copy all the scores (there is a single score in each detection after
-    // the above pruning) to an indexed vector for sorting. The first value is
-    // the index of the detection in the original vector from which the score
-    // stems, while the second is the actual score.
-    IndexedScores indexed_scores;
-    indexed_scores.reserve(pruned_detections.size());
-    for (int index = 0; index < pruned_detections.size(); ++index) {
-      indexed_scores.push_back(
-          std::make_pair(index, pruned_detections[index].score(0)));
+    // Copy the relative box and the score of each detection (there is a
+    // single score in each detection after the above pruning) to the
+    // suppressor. The weighted algorithm always uses the relative box.
+    const bool weighted =
+        options_.algorithm() == NonMaxSuppressionCalculatorOptions::WEIGHTED;
+    const ImageFrame* frame = nullptr;
+    if (!weighted && cc->Inputs().HasTag(kImageTag) &&
+        !cc->Inputs().Tag(kImageTag).IsEmpty()) {
+      frame = &cc->Inputs().Tag(kImageTag).Get<ImageFrame>();
+    }
+    nms_.Clear();
+    nms_.Reserve(pruned_detections.size());
+    label_classes_.clear();
+    for (const auto& detection : pruned_detections) {
+      Rectangle_f rect;
+      if (frame) {
+        rect = Location(detection.location_data())
+                   .ConvertToRelativeBBox(frame->Width(), frame->Height());
+      } else {
+        const auto& location_data = detection.location_data();
+        RET_CHECK_EQ(LocationData::RELATIVE_BOUNDING_BOX,
+                     location_data.format());
+        const auto& box = location_data.relative_bounding_box();
+        rect = Rectangle_f(box.xmin(), box.ymin(), box.width(), box.height());
+      }
+      nms_.AddBox(rect.xmin(), rect.ymin(), rect.xmax(), rect.ymax(),
+                  detection.score(0),
+                  options_.suppress_per_label() ? GetLabelClass(detection)
+                                                : 0);
     }
-    std::sort(indexed_scores.begin(), indexed_scores.end(), SortBySecond);
 
     const int max_num_detections =
         (options_.max_num_detections() > -1)
             ? options_.max_num_detections()
-            : static_cast<int>(indexed_scores.size());
-    // A set of detections and locations, wrapping the location data from each
-    // detection, which are retained after the non-maximum suppression.
+            : static_cast<int>(pruned_detections.size());
+    // The detections which are retained after the non-maximum suppression.
     auto* retained_detections = new Detections();
     retained_detections->reserve(max_num_detections);
 
-    if (options_.algorithm() == NonMaxSuppressionCalculatorOptions::WEIGHTED) {
-      WeightedNonMaxSuppression(indexed_scores, pruned_detections,
-                                max_num_detections, cc, retained_detections);
+    if (weighted) {
+      WeightedNonMaxSuppression(pruned_detections, retained_detections);
     } else {
-      NonMaxSuppression(indexed_scores, pruned_detections, max_num_detections,
-                        cc, retained_detections);
+      nms_.Suppress(nms_options_, &retained_indices_);
+      for (int index : retained_indices_) {
+        retained_detections->push_back(std::move(pruned_detections[index]));
+      }
     }
 
     cc->Outputs().Index(0).Add(retained_detections, cc->InputTimestamp());
@@ -248,106 +244,51 @@ class NonMaxSuppressionCalculator : public CalculatorBase {
   }
 
  private:
-  void NonMaxSuppression(const IndexedScores& indexed_scores,
-                         const Detections& detections, int max_num_detections,
-                         CalculatorContext* cc, Detections* output_detections) {
-    std::vector<Location> retained_locations;
-    retained_locations.reserve(max_num_detections);
-    // We traverse the detections by decreasing score.
-    for (const auto& indexed_score : indexed_scores) {
-      const auto& detection = detections[indexed_score.first];
-      if (options_.min_score_threshold() > 0 &&
-          detection.score(0) < options_.min_score_threshold()) {
-        break;
-      }
-      const Location location(detection.location_data());
-      bool suppressed = false;
-      // The current detection is suppressed iff there exists a retained
-      // detection, whose location overlaps more than the specified
-      // threshold with the location of the current detection.
-      for (const auto& retained_location : retained_locations) {
-        float similarity;
-        if (cc->Inputs().HasTag(kImageTag)) {
-          const auto& frame = cc->Inputs().Tag(kImageTag).Get<ImageFrame>();
-          similarity = OverlapSimilarity(frame.Width(), frame.Height(),
-                                         options_.overlap_type(),
-                                         retained_location, location);
-        } else {
-          similarity = OverlapSimilarity(options_.overlap_type(),
-                                         retained_location, location);
-        }
-        if (similarity > options_.min_suppression_threshold()) {
-          suppressed = true;
-          break;
-        }
-      }
-      if (!suppressed) {
-        output_detections->push_back(detection);
-        retained_locations.push_back(location);
-      }
-      if (output_detections->size() >= max_num_detections) {
-        break;
-      }
+  // Returns the class of the detection for per-label suppression. The string
+  // labels are numbered from -1 downwards, apart from the label ids.
+  int GetLabelClass(const Detection& detection) {
+    if (detection.label_id_size() > 0) {
+      return detection.label_id(0);
     }
+    const int next_class = -1 - static_cast<int>(label_classes_.size());
+    return label_classes_.emplace(detection.label(0), next_class).first->second;
   }
 
-  void WeightedNonMaxSuppression(const IndexedScores& indexed_scores,
-                                 const Detections& detections,
-                                 int max_num_detections, CalculatorContext* cc,
+  // Replaces each cluster of overlapping detections with a copy of its
+  // highest scoring detection, whose box and keypoints are averaged over the
+  // cluster, weighted by score.
+  void WeightedNonMaxSuppression(const Detections& detections,
                                  Detections* output_detections) {
-    IndexedScores remained_indexed_scores;
-    remained_indexed_scores.assign(indexed_scores.begin(),
-                                   indexed_scores.end());
-
-    IndexedScores remained;
-    IndexedScores candidates;
-    output_detections->clear();
-    while (!remained_indexed_scores.empty()) {
-      const int original_indexed_scores_size = remained_indexed_scores.size();
-      const auto& detection = detections[remained_indexed_scores[0].first];
-      if (options_.min_score_threshold() > 0 &&
-          detection.score(0) < options_.min_score_threshold()) {
-        break;
-      }
-      remained.clear();
-      candidates.clear();
-      const Location location(detection.location_data());
-      // This includes the first box.
-      for (const auto& indexed_score : remained_indexed_scores) {
-        Location rest_location(detections[indexed_score.first].location_data());
-        float similarity =
-            OverlapSimilarity(options_.overlap_type(), rest_location, location);
-        if (similarity > options_.min_suppression_threshold()) {
-          candidates.push_back(indexed_score);
-        } else {
-          remained.push_back(indexed_score);
-        }
-      }
+    nms_.Cluster(nms_options_, &clusters_);
+    for (int k = 0; k < clusters_.leaders.size(); ++k) {
+      const auto& detection = detections[clusters_.leaders[k]];
+      const int begin = clusters_.offsets[k];
+      const int end = clusters_.offsets[k + 1];
       auto weighted_detection = detection;
-      if (!candidates.empty()) {
+      if (begin != end) {
         const int num_keypoints =
             detection.location_data().relative_keypoints_size();
-        std::vector<float> keypoints(num_keypoints * 2);
+        keypoints_.assign(num_keypoints * 2, 0.0f);
         float w_xmin = 0.0f;
         float w_ymin = 0.0f;
         float w_xmax = 0.0f;
         float w_ymax = 0.0f;
         float total_score = 0.0f;
-        for (const auto& candidate : candidates) {
-          total_score += candidate.second;
-          const auto& location_data =
-              detections[candidate.first].location_data();
-          const auto& bbox = location_data.relative_bounding_box();
-          w_xmin += bbox.xmin() * candidate.second;
-          w_ymin += bbox.ymin() * candidate.second;
-          w_xmax += (bbox.xmin() + bbox.width()) * candidate.second;
-          w_ymax += (bbox.ymin() + bbox.height()) * candidate.second;
-
+        for (int m = begin; m < end; ++m) {
+          const int index = clusters_.members[m];
+          const float score = nms_.score(index);
+          total_score += score;
+          w_xmin += nms_.xmin(index) * score;
+          w_ymin += nms_.ymin(index) * score;
+          w_xmax += nms_.xmax(index) * score;
+          w_ymax += nms_.ymax(index) * score;
+
+          const auto& location_data = detections[index].location_data();
           for (int i = 0; i < num_keypoints; ++i) {
-            keypoints[i * 2] +=
-                location_data.relative_keypoints(i).x() * candidate.second;
-            keypoints[i * 2 + 1] +=
-                location_data.relative_keypoints(i).y() * candidate.second;
+            keypoints_[i * 2] +=
+                location_data.relative_keypoints(i).x() * score;
+            keypoints_[i * 2 + 1] +=
+                location_data.relative_keypoints(i).y() * score;
           }
         }
         auto* weighted_location = weighted_detection.mutable_location_data()
@@ -361,23 +302,22 @@ class NonMaxSuppressionCalculator : public CalculatorBase {
         for (int i = 0; i < num_keypoints; ++i) {
           auto* keypoint = weighted_detection.mutable_location_data()
                                ->mutable_relative_keypoints(i);
-          keypoint->set_x(keypoints[i * 2] / total_score);
-          keypoint->set_y(keypoints[i * 2 + 1] / total_score);
+          keypoint->set_x(keypoints_[i * 2] / total_score);
+          keypoint->set_y(keypoints_[i * 2 + 1] / total_score);
         }
       }
-
-      output_detections->push_back(weighted_detection);
-      // Breaks the loop if the size of indexed scores doesn't change after an
-      // iteration.
-      if (original_indexed_scores_size == remained.size()) {
-        break;
-      } else {
-        remained_indexed_scores = std::move(remained);
-      }
+      output_detections->push_back(std::move(weighted_detection));
     }
   }
 
   NonMaxSuppressionCalculatorOptions options_;
+  NonMaxSuppressor::Options nms_options_;
+  // Buffers reused between calls to Process().
+  NonMaxSuppressor nms_;
+  std::vector<int> retained_indices_;
+  NonMaxSuppressor::Clusters clusters_;
+  std::vector<float> keypoints_;
+  std::unordered_map<std::string, int> label_classes_;
 };
 REGISTER_CALCULATOR(NonMaxSuppressionCalculator);
 
@@ -0,0 +1,126 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/substitute.h"
+#include "mediapipe/calculators/util/non_max_suppression_calculator.pb.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/calculator_runner.h"
+#include "mediapipe/framework/formats/detection.pb.h"
+#include "mediapipe/framework/formats/location_data.pb.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace {
+
+Detection CreateDetection(int label_id, float score, float xmin, float ymin,
+                          float width, float height) {
+  Detection detection;
+  detection.add_label_id(label_id);
+  detection.add_score(score);
+  LocationData* location_data = detection.mutable_location_data();
+  location_data->set_format(LocationData::RELATIVE_BOUNDING_BOX);
+  location_data->mutable_relative_bounding_box()->set_xmin(xmin);
+  location_data->mutable_relative_bounding_box()->set_ymin(ymin);
+  location_data->mutable_relative_bounding_box()->set_width(width);
+  location_data->mutable_relative_bounding_box()->set_height(height);
+  return detection;
+}
+
+void AddKeypoint(float x, float y, Detection* detection) {
+  auto* keypoint = detection->mutable_location_data()->add_relative_keypoints();
+  keypoint->set_x(x);
+  keypoint->set_y(y);
+}
+
+std::vector<Detection> RunCalculator(const std::string& options,
+                                     const std::vector<Detection>& input) {
+  CalculatorRunner runner(ParseTextProtoOrDie<CalculatorGraphConfig::Node>(
+      absl::Substitute(R"(
+        calculator: "NonMaxSuppressionCalculator"
+        input_stream: "detections"
+        output_stream: "retained_detections"
+        options {
+          [mediapipe.NonMaxSuppressionCalculatorOptions.ext] {
+            $0
+          }
+        }
+      )",
+                       options)));
+  runner.MutableInputs()->Index(0).packets.push_back(
+      MakePacket<std::vector<Detection>>(input).At(Timestamp(0)));
+  MP_EXPECT_OK(runner.Run());
+  const auto& packets = runner.Outputs().Index(0).packets;
+  if (packets.size() != 1) {
+    ADD_FAILURE() << "Expected one output packet, got " << packets.size();
+    return {};
+  }
+  return packets[0].Get<std::vector<Detection>>();
+}
+
+TEST(NonMaxSuppressionCalculatorTest, SuppressesOverlappingDetections) {
+  const std::vector<Detection> detections = RunCalculator(
+      R"(min_suppression_threshold: 0.3 overlap_type: INTERSECTION_OVER_UNION)",
+      {CreateDetection(0, 0.8f, 0.0f, 0.0f, 0.4f, 0.4f),
+       CreateDetection(0, 0.9f, 0.1f, 0.1f, 0.4f, 0.4f),
+       CreateDetection(0, 0.7f, 0.6f, 0.6f, 0.3f, 0.3f)});
+  ASSERT_EQ(2, detections.size());
+  EXPECT_EQ(0.9f, detections[0].score(0));
+  EXPECT_EQ(0.7f, detections[1].score(0));
+}
+
+TEST(NonMaxSuppressionCalculatorTest, SuppressesPerLabel) {
+  const std::vector<Detection> input = {
+      CreateDetection(1, 0.8f, 0.0f, 0.0f, 0.4f, 0.4f),
+      CreateDetection(2, 0.9f, 0.0f, 0.0f, 0.4f, 0.4f),
+      CreateDetection(2, 0.7f, 0.0f, 0.0f, 0.4f, 0.4f)};
+  EXPECT_EQ(1, RunCalculator("min_suppression_threshold: 0.5", input).size());
+  const std::vector<Detection> detections = RunCalculator(
+      "min_suppression_threshold: 0.5 suppress_per_label: true", input);
+  ASSERT_EQ(2, detections.size());
+  EXPECT_EQ(2, detections[0].label_id(0));
+  EXPECT_EQ(1, detections[1].label_id(0));
+}
+
+TEST(NonMaxSuppressionCalculatorTest, AveragesWeightedDetections) {
+  Detection first = CreateDetection(0, 0.75f, 0.0f, 0.0f, 0.4f, 0.4f);
+  AddKeypoint(0.2f, 0.2f, &first);
+  Detection second = CreateDetection(0, 0.25f, 0.1f, 0.1f, 0.4f, 0.4f);
+  AddKeypoint(0.6f, 0.4f, &second);
+  Detection apart = CreateDetection(0, 0.5f, 0.6f, 0.6f, 0.3f, 0.3f);
+  AddKeypoint(0.7f, 0.7f, &apart);
+  const std::vector<Detection> detections = RunCalculator(
+      R"(min_suppression_threshold: 0.3 overlap_type: INTERSECTION_OVER_UNION
+         algorithm: WEIGHTED)",
+      {first, second, apart});
+  ASSERT_EQ(2, detections.size());
+  EXPECT_EQ(0.75f, detections[0].score(0));
+  const auto& location_data = detections[0].location_data();
+  EXPECT_FLOAT_EQ(0.025f, location_data.relative_bounding_box().xmin());
+  EXPECT_FLOAT_EQ(0.025f, location_data.relative_bounding_box().ymin());
+  EXPECT_FLOAT_EQ(0.4f, location_data.relative_bounding_box().width());
+  EXPECT_FLOAT_EQ(0.4f, location_data.relative_bounding_box().height());
+  EXPECT_FLOAT_EQ(0.3f, location_data.relative_keypoints(0).x());
+  EXPECT_FLOAT_EQ(0.25f, location_data.relative_keypoints(0).y());
+  EXPECT_EQ(apart.location_data().relative_bounding_box().xmin(),
+            detections[1].location_data().relative_bounding_box().xmin());
+}
+
+}  // namespace
+}  // namespace mediapipe
@@ -35,6 +35,7 @@
 #include "mediapipe/util/tracking/box_tracker.h"
 #include "mediapipe/util/tracking/box_tracker.pb.h"
 #include "mediapipe/util/tracking/flow_packager.pb.h"
+#include "mediapipe/util/tracking/frame_analysis.h"
 #include "mediapipe/util/tracking/tracking.h"
 #include "mediapipe/util/tracking/tracking_visualization_utilities.h"
 
@@ -54,6 +55,9 @@ namespace mediapipe {
 //             descriptors.
 //   VIDEO:    Optional input video stream tracked boxes are rendered over
 //             (Required if VIZ is specified).
+//   FRAME_ANALYSIS: Optional FrameAnalysis (see FrameAnalysisCalculator) of
+//             the input frames. If present, features are extracted from it
+//             instead of VIDEO, sharing them with other calculators.
 //   FEATURES: Input feature points (std::vector<cv::KeyPoint>) in the original
 //             pixel space.
 //   DESCRIPTORS: Input feature descriptors (std::vector<float>). Actual feature
@@ -122,6 +126,10 @@ REGISTER_CALCULATOR(BoxDetectorCalculator);
     cc->Inputs().Tag("VIDEO").Set<ImageFrame>();
   }
 
+  if (cc->Inputs().HasTag("FRAME_ANALYSIS")) {
+    cc->Inputs().Tag("FRAME_ANALYSIS").Set<FrameAnalysis>();
+  }
+
   if (cc->Inputs().HasTag("FEATURES")) {
     RET_CHECK(cc->Inputs().HasTag("DESCRIPTORS"))
         << "FEATURES and DESCRIPTORS need to be specified together.";
@@ -254,6 +262,10 @@ REGISTER_CALCULATOR(BoxDetectorCalculator);
                                   : nullptr;
   InputStream* video_stream =
       cc->Inputs().HasTag("VIDEO") ? &(cc->Inputs().Tag("VIDEO")) : nullptr;
+  InputStream* frame_analysis_stream =
+      cc->Inputs().HasTag("FRAME_ANALYSIS")
+          ? &(cc->Inputs().Tag("FRAME_ANALYSIS"))
+          : nullptr;
   InputStream* feature_stream = cc->Inputs().HasTag("FEATURES")
                                     ? &(cc->Inputs().Tag("FEATURES"))
                                     : nullptr;
@@ -262,6 +274,7 @@ REGISTER_CALCULATOR(BoxDetectorCalculator);
                                        : nullptr;
 
   CHECK(track_stream != nullptr || video_stream != nullptr ||
+        frame_analysis_stream != nullptr ||
         (feature_stream != nullptr && descriptor_stream != nullptr))
       << "One and only one of {tracking_data, input image frame, "
          "feature/descriptor} need to be valid.";
@@ -286,6 +299,20 @@ REGISTER_CALCULATOR(BoxDetectorCalculator);
 
     box_detector_->DetectAndAddBox(tracking_data, tracked_boxes, timestamp_msec,
                                    detected_boxes.get());
+  } else if (frame_analysis_stream != nullptr) {
+    // Detect from the shared analysis of the input frame.
+    if (frame_analysis_stream->IsEmpty()) {
+      return ::mediapipe::OkStatus();
+    }
+
+    TimedBoxProtoList tracked_boxes;
+    if (tracked_boxes_stream != nullptr && !tracked_boxes_stream->IsEmpty()) {
+      tracked_boxes = tracked_boxes_stream->Get<TimedBoxProtoList>();
+    }
+
+    box_detector_->DetectAndAddBox(frame_analysis_stream->Get<FrameAnalysis>(),
+                                   tracked_boxes, timestamp_msec,
+                                   detected_boxes.get());
   } else if (video_stream != nullptr) {
     // Detect from input frame
     if (video_stream->IsEmpty()) {
@@ -0,0 +1,103 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/image_frame_allocator.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/util/tracking/frame_analysis.h"
+
+namespace mediapipe {
+
+// Wraps each input frame in a FrameAnalysis, so that calculators consuming
+// the same frame, e.g. MotionAnalysisCalculator, FeatureDetectorCalculator and
+// BoxDetectorCalculator, share its grayscale frame, pyramids and ORB features
+// instead of each computing its own. Nothing is computed here; results are
+// computed on first request by a consumer.
+//
+// The input frame is retained by the FrameAnalysis without a copy. Computed
+// frames are drawn from kImageFrameAllocatorService if available.
+//
+// Inputs:
+//   IMAGE: An ImageFrame in SRGB, SRGBA or GRAY8 format.
+// Outputs:
+//   FRAME_ANALYSIS: The FrameAnalysis of the input frame.
+// Example config:
+//   node {
+//     calculator: "FrameAnalysisCalculator"
+//     input_stream: "IMAGE:input_video"
+//     output_stream: "FRAME_ANALYSIS:frame_analysis"
+//   }
+//   node {
+//     calculator: "MotionAnalysisCalculator"
+//     input_stream: "VIDEO:input_video"
+//     input_stream: "FRAME_ANALYSIS:frame_analysis"
+//     ...
+//   }
+class FrameAnalysisCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc);
+
+  ::mediapipe::Status Open(CalculatorContext* cc) override;
+  ::mediapipe::Status Process(CalculatorContext* cc) override;
+};
+
+REGISTER_CALCULATOR(FrameAnalysisCalculator);
+
+::mediapipe::Status FrameAnalysisCalculator::GetContract(
+    CalculatorContract* cc) {
+  cc->Inputs().Tag("IMAGE").Set<ImageFrame>();
+  cc->Outputs().Tag("FRAME_ANALYSIS").Set<FrameAnalysis>();
+  cc->UseService(kImageFrameAllocatorService).Optional();
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status FrameAnalysisCalculator::Open(CalculatorContext* cc) {
+  cc->SetOffset(TimestampDiff(0));
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status FrameAnalysisCalculator::Process(CalculatorContext* cc) {
+  const Packet& input = cc->Inputs().Tag("IMAGE").Value();
+  if (input.IsEmpty()) {
+    return ::mediapipe::OkStatus();
+  }
+
+  const ImageFormat::Format format = input.Get<ImageFrame>().Format();
+  RET_CHECK(format == ImageFormat::SRGB || format == ImageFormat::SRGBA ||
+            format == ImageFormat::GRAY8)
+      << "Unsupported image format: " << format;
+
+  // The frame is kept alive by a copy of its packet.
+  auto holder = std::make_shared<Packet>(input);
+  std::shared_ptr<const ImageFrame> frame(holder, &holder->Get<ImageFrame>());
+
+  std::shared_ptr<ImageFrameAllocator> allocator;
+  if (cc->Service(kImageFrameAllocatorService).IsAvailable()) {
+    allocator = cc->Service(kImageFrameAllocatorService)
+                    .GetObject()
+                    .shared_from_this();
+  }
+
+  cc->Outputs()
+      .Tag("FRAME_ANALYSIS")
+      .Add(new FrameAnalysis(std::move(frame), std::move(allocator)),
+           cc->InputTimestamp());
+  return ::mediapipe::OkStatus();
+}
+
+}  // namespace mediapipe
@@ -30,10 +30,12 @@
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/util/tracking/camera_motion.h"
 #include "mediapipe/util/tracking/camera_motion.pb.h"
+#include "mediapipe/util/tracking/frame_analysis.h"
 #include "mediapipe/util/tracking/frame_selection.pb.h"
 #include "mediapipe/util/tracking/motion_analysis.h"
 #include "mediapipe/util/tracking/motion_estimation.h"
 #include "mediapipe/util/tracking/motion_models.h"
+#include "mediapipe/util/tracking/parallel_invoker.h"
 #include "mediapipe/util/tracking/region_flow.pb.h"
 
 namespace mediapipe {
@@ -62,6 +64,10 @@ const char kOptionsTag[] = "OPTIONS";
 //   SELECTION: Optional input stream to perform analysis only on selected
 //              frames. If present needs to contain camera motion
 //              and features.
+//   FRAME_ANALYSIS: Optional FrameAnalysis of the VIDEO frames, see
+//              FrameAnalysisCalculator. Unless the analysis requires color
+//              frames, its shared grayscale frame is analyzed instead of
+//              converting VIDEO again. Requires VIDEO to be present.
 //
 // Input side packets:
 //   CSV_FILE:  Read motion models as homographies from CSV file. Expected
@@ -88,6 +94,9 @@ const char kOptionsTag[] = "OPTIONS";
 //              VIDEO at the selected frames. Required VIDEO to be present.
 //   GRAY_VIDEO_OUT: Optional output stream for downsampled, grayscale video.
 //                   Requires VIDEO to be present and SELECTION to not be used.
+//
+// If the graph provides kParallelForExecutorService, region flow computation
+// and motion estimation run their parallel loops on that executor.
 class MotionAnalysisCalculator : public CalculatorBase {
   // TODO: Activate once leakr approval is ready.
   // typedef com::google::android::libraries::micro::proto::Data HomographyData;
@@ -106,6 +115,10 @@ class MotionAnalysisCalculator : public CalculatorBase {
   // Otherwise no-op. Set flush to true to force output of all buffered data.
   void OutputMotionAnalyzedFrames(bool flush, CalculatorContext* cc);
 
+  // Returns the frame to analyze, i.e. the grayscale frame of FRAME_ANALYSIS
+  // if used, otherwise the VIDEO frame.
+  cv::Mat AnalysisFrame(CalculatorContext* cc) const;
+
   // Lazy init function to be called on Process.
   ::mediapipe::Status InitOnProcess(InputStream* video_stream,
                                     InputStream* selection_stream);
@@ -152,6 +165,10 @@ class MotionAnalysisCalculator : public CalculatorBase {
   // Input indicators for each stream.
   bool selection_input_ = false;
   bool video_input_ = false;
+  bool frame_analysis_input_ = false;
+
+  // Set if the grayscale frames of FRAME_ANALYSIS are analyzed.
+  bool use_frame_analysis_ = false;
 
   // Output indicators for each stream.
   bool region_flow_feature_output_ = false;
@@ -203,6 +220,12 @@ REGISTER_CALCULATOR(MotionAnalysisCalculator);
   RET_CHECK(cc->Inputs().HasTag("VIDEO") || cc->Inputs().HasTag("SELECTION"))
       << "Either VIDEO, SELECTION must be specified.";
 
+  if (cc->Inputs().HasTag("FRAME_ANALYSIS")) {
+    RET_CHECK(cc->Inputs().HasTag("VIDEO"))
+        << "FRAME_ANALYSIS requires VIDEO to be present.";
+    cc->Inputs().Tag("FRAME_ANALYSIS").Set<FrameAnalysis>();
+  }
+
   if (cc->Outputs().HasTag("FLOW")) {
     cc->Outputs().Tag("FLOW").Set<RegionFlowFeatureList>();
   }
@@ -246,6 +269,8 @@ REGISTER_CALCULATOR(MotionAnalysisCalculator);
     cc->InputSidePackets().Tag(kOptionsTag).Set<CalculatorOptions>();
   }
 
+  cc->UseService(kParallelForExecutorService).Optional();
+
   return ::mediapipe::OkStatus();
 }
 
@@ -255,6 +280,7 @@ REGISTER_CALCULATOR(MotionAnalysisCalculator);
                             cc->InputSidePackets(), kOptionsTag);
 
   video_input_ = cc->Inputs().HasTag("VIDEO");
+  frame_analysis_input_ = cc->Inputs().HasTag("FRAME_ANALYSIS");
   selection_input_ = cc->Inputs().HasTag("SELECTION");
   region_flow_feature_output_ = cc->Outputs().HasTag("FLOW");
   camera_motion_output_ = cc->Outputs().HasTag("CAMERA");
@@ -448,6 +474,10 @@ REGISTER_CALCULATOR(MotionAnalysisCalculator);
     // We do not need MotionAnalysis when using just metadata.
     motion_analysis_.reset(new MotionAnalysis(options_.analysis_options(),
                                               frame_width_, frame_height_));
+    if (cc->Service(kParallelForExecutorService).IsAvailable()) {
+      motion_analysis_->SetExecutor(
+          &cc->Service(kParallelForExecutorService).GetObject());
+    }
   }
 
   std::unique_ptr<FrameSelectionResult> frame_selection_result;
@@ -495,9 +525,12 @@ REGISTER_CALCULATOR(MotionAnalysisCalculator);
   }
 
   if (use_frame) {
+    if (use_frame_analysis_) {
+      RET_CHECK(!cc->Inputs().Tag("FRAME_ANALYSIS").IsEmpty())
+          << "Missing FRAME_ANALYSIS at " << timestamp;
+    }
     if (!selection_input_) {
-      const cv::Mat input_view =
-          formats::MatView(&video_stream->Get<ImageFrame>());
+      const cv::Mat input_view = AnalysisFrame(cc);
       if (hybrid_meta_analysis_) {
         // Seed with meta homography.
         RET_CHECK(hybrid_meta_offset_ < meta_motions_.size())
@@ -528,8 +561,7 @@ REGISTER_CALCULATOR(MotionAnalysisCalculator);
           break;
 
         case MotionAnalysisCalculatorOptions::ANALYSIS_RECOMPUTE: {
-          const cv::Mat input_view =
-              formats::MatView(&video_stream->Get<ImageFrame>());
+          const cv::Mat input_view = AnalysisFrame(cc);
           motion_analysis_->AddFrame(input_view, timestamp.Value());
           break;
         }
@@ -538,8 +570,7 @@ REGISTER_CALCULATOR(MotionAnalysisCalculator);
           Homography homography;
           CameraMotionToHomography(frame_selection_result->camera_motion(),
                                    &homography);
-          const cv::Mat input_view =
-              formats::MatView(&video_stream->Get<ImageFrame>());
+          const cv::Mat input_view = AnalysisFrame(cc);
           motion_analysis_->AddFrameGeneric(input_view, timestamp.Value(),
                                             homography, &homography);
           break;
@@ -688,6 +719,13 @@ void MotionAnalysisCalculator::OutputMotionAnalyzedFrames(
   }
 }
 
+cv::Mat MotionAnalysisCalculator::AnalysisFrame(CalculatorContext* cc) const {
+  if (use_frame_analysis_) {
+    return cc->Inputs().Tag("FRAME_ANALYSIS").Get<FrameAnalysis>().Grayscale();
+  }
+  return formats::MatView(&cc->Inputs().Tag("VIDEO").Get<ImageFrame>());
+}
+
 ::mediapipe::Status MotionAnalysisCalculator::InitOnProcess(
     InputStream* video_stream, InputStream* selection_stream) {
   if (video_stream) {
@@ -720,6 +758,18 @@ void MotionAnalysisCalculator::OutputMotionAnalyzedFrames(
       default:
         RET_CHECK(false) << "Unsupported image format.";
     }
+    if (frame_analysis_input_) {
+      use_frame_analysis_ =
+          !MotionAnalysis::RequiresColorFrames(options_.analysis_options());
+      if (use_frame_analysis_) {
+        image_format = image_format2 =
+            RegionFlowComputationOptions::FORMAT_GRAYSCALE;
+        region_options->set_image_format(image_format);
+      } else {
+        LOG(WARNING) << "Motion analysis requires color frames, analyzing "
+                     << "VIDEO instead of FRAME_ANALYSIS.";
+      }
+    }
     if (region_options->image_format() != image_format &&
         region_options->image_format() != image_format2) {
       LOG(WARNING) << "Requested image format in RegionFlowComputation "
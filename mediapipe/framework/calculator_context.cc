@@ -36,6 +36,11 @@ int CalculatorContext::NodeId() const {
   return calculator_state_->NodeId();
 }
 
+int CalculatorContext::MaxInFlight() const {
+  CHECK(calculator_state_);
+  return calculator_state_->MaxInFlight();
+}
+
 Counter* CalculatorContext::GetCounter(const std::string& name) {
   CHECK(calculator_state_);
   return calculator_state_->GetCounter(name);
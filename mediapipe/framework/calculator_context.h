@@ -56,6 +56,9 @@ class CalculatorContext {
   const std::string& NodeName() const;
   int NodeId() const;
   const std::string& CalculatorType() const;
+  // Returns the maximum number of Process() calls of this calculator that may
+  // run in parallel.
+  int MaxInFlight() const;
   // Returns the options given to this calculator. The Calculator or
   // CalculatorBase implementation may get its options by calling
   // GetExtension() on the result.
@@ -37,6 +37,7 @@
 #include "mediapipe/framework/counter_factory.h"
 #include "mediapipe/framework/delegating_executor.h"
 #include "mediapipe/framework/input_stream_manager.h"
+#include "mediapipe/framework/mediapipe_options.pb.h"
 #include "mediapipe/framework/mediapipe_profiling.h"
 #include "mediapipe/framework/packet_generator.h"
 #include "mediapipe/framework/packet_generator.pb.h"
@@ -267,21 +268,29 @@ CalculatorGraph::~CalculatorGraph() {
   return ::mediapipe::OkStatus();
 }
 
-::mediapipe::Status CalculatorGraph::InitializeExecutors() {
+namespace internal {
+
+::mediapipe::Status CreateConfiguredExecutors(
+    const CalculatorGraphConfig& config, const std::string& owner,
+    const std::map<std::string, std::shared_ptr<Executor>>& executors,
+    const std::function<::mediapipe::Status(const std::string& name,
+                                            std::shared_ptr<Executor>)>&
+        add_executor,
+    const ThreadPoolExecutorOptions** default_executor_options,
+    bool* use_application_thread) {
   // If the ExecutorConfig for the default executor leaves the executor type
   // unspecified, default_executor_options points to the
   // ThreadPoolExecutorOptions in that ExecutorConfig. Otherwise,
   // default_executor_options is null.
-  const ThreadPoolExecutorOptions* default_executor_options = nullptr;
-  bool use_application_thread = false;
-  for (const ExecutorConfig& executor_config :
-       validated_graph_->Config().executor()) {
-    if (::mediapipe::ContainsKey(executors_, executor_config.name())) {
+  *default_executor_options = nullptr;
+  *use_application_thread = false;
+  for (const ExecutorConfig& executor_config : config.executor()) {
+    if (::mediapipe::ContainsKey(executors, executor_config.name())) {
       if (!executor_config.type().empty()) {
         return ::mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
                << "ExecutorConfig for \"" << executor_config.name()
-               << "\" has a \"type\" field but is also provided to the graph "
-                  "with a CalculatorGraph::SetExecutor() call.";
+               << "\" has a \"type\" field but is also provided with a "
+               << owner << "::SetExecutor() call.";
       }
       continue;
     }
@@ -290,14 +299,14 @@ CalculatorGraph::~CalculatorGraph() {
       if (executor_config.type().empty()) {
         // For the default executor, an unspecified type means letting the
         // framework choose an appropriate executor type.
-        default_executor_options = &executor_config.options().GetExtension(
+        *default_executor_options = &executor_config.options().GetExtension(
             ThreadPoolExecutorOptions::ext);
         continue;
       }
       if (executor_config.type() == kApplicationThreadExecutorType) {
         // For the default executor, the type "ApplicationThreadExecutor" means
         // running synchronously on the calling thread.
-        use_application_thread = true;
+        *use_application_thread = true;
         continue;
       }
     }
@@ -306,18 +315,49 @@ CalculatorGraph::~CalculatorGraph() {
              << "ExecutorConfig for \"" << executor_config.name()
              << "\" does not have a \"type\" field. The executor \""
              << executor_config.name()
-             << "\" must be provided to the graph with a "
-                "CalculatorGraph::SetExecutor() call.";
+             << "\" must be provided with a " << owner
+             << "::SetExecutor() call.";
     }
     // clang-format off
     ASSIGN_OR_RETURN(Executor* executor,
                      ExecutorRegistry::CreateByNameInNamespace(
-                         validated_graph_->Package(),
+                         config.package(),
                          executor_config.type(), executor_config.options()));
     // clang-format on
-    MEDIAPIPE_CHECK_OK(SetExecutorInternal(
-        executor_config.name(), std::shared_ptr<Executor>(executor)));
+    MP_RETURN_IF_ERROR(add_executor(executor_config.name(),
+                                    std::shared_ptr<Executor>(executor)));
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::StatusOr<std::shared_ptr<Executor>> CreateDefaultThreadPool(
+    const ThreadPoolExecutorOptions* default_executor_options,
+    int num_threads) {
+  MediaPipeOptions extendable_options;
+  ThreadPoolExecutorOptions* options =
+      extendable_options.MutableExtension(ThreadPoolExecutorOptions::ext);
+  if (default_executor_options != nullptr) {
+    options->CopyFrom(*default_executor_options);
   }
+  options->set_num_threads(num_threads);
+  // clang-format off
+  ASSIGN_OR_RETURN(Executor* executor,
+                   ThreadPoolExecutor::Create(extendable_options));
+  // clang-format on
+  return std::shared_ptr<Executor>(executor);
+}
+
+}  // namespace internal
+
+::mediapipe::Status CalculatorGraph::InitializeExecutors() {
+  const ThreadPoolExecutorOptions* default_executor_options;
+  bool use_application_thread;
+  MP_RETURN_IF_ERROR(internal::CreateConfiguredExecutors(
+      validated_graph_->Config(), "CalculatorGraph", executors_,
+      [this](const std::string& name, std::shared_ptr<Executor> executor) {
+        return SetExecutorInternal(name, std::move(executor));
+      },
+      &default_executor_options, &use_application_thread));
 
   if (!::mediapipe::ContainsKey(executors_, "")) {
     MP_RETURN_IF_ERROR(InitializeDefaultExecutor(default_executor_options,
@@ -363,11 +403,11 @@ CalculatorGraph::~CalculatorGraph() {
 }
 
 ::mediapipe::Status CalculatorGraph::Initialize(
-    std::unique_ptr<ValidatedGraphConfig> validated_graph,
+    std::shared_ptr<const ValidatedGraphConfig> validated_graph,
     const std::map<std::string, Packet>& side_packets) {
   RET_CHECK(!initialized_).SetNoLogging()
       << "CalculatorGraph can be initialized only once.";
-  RET_CHECK(validated_graph->Initialized()).SetNoLogging()
+  RET_CHECK(validated_graph && validated_graph->Initialized()).SetNoLogging()
       << "validated_graph is not initialized.";
   validated_graph_ = std::move(validated_graph);
 
@@ -424,12 +464,19 @@ CalculatorGraph::~CalculatorGraph() {
   MP_RETURN_IF_ERROR(observer->Initialize(
       stream_name, &any_packet_type_, std::move(packet_callback),
       &output_stream_managers_[output_stream_index]));
+  TrackGraphOutputLatency(output_stream_index, observer.get());
   graph_output_streams_.push_back(std::move(observer));
   return ::mediapipe::OkStatus();
 }
 
 ::mediapipe::StatusOr<OutputStreamPoller>
 CalculatorGraph::AddOutputStreamPoller(const std::string& stream_name) {
+  return AddOutputStreamPoller(stream_name, OutputStreamPollerOptions());
+}
+
+::mediapipe::StatusOr<OutputStreamPoller>
+CalculatorGraph::AddOutputStreamPoller(
+    const std::string& stream_name, const OutputStreamPollerOptions& options) {
   RET_CHECK(initialized_).SetNoLogging()
       << "CalculatorGraph is not initialized.";
   int output_stream_index = validated_graph_->OutputStreamIndex(stream_name);
@@ -444,11 +491,32 @@ CalculatorGraph::AddOutputStreamPoller(const std::string& stream_name) {
       std::bind(&CalculatorGraph::UpdateThrottledNodes, this,
                 std::placeholders::_1, std::placeholders::_2),
       &output_stream_managers_[output_stream_index]));
+  if (options.ring_capacity > 0) {
+    internal_poller->UseRing(options.ring_capacity, options.spin_iterations);
+  }
+  TrackGraphOutputLatency(output_stream_index, internal_poller.get());
   OutputStreamPoller poller(internal_poller);
   graph_output_streams_.push_back(std::move(internal_poller));
   return std::move(poller);
 }
 
+void CalculatorGraph::TrackGraphOutputLatency(
+    int output_stream_index, internal::GraphOutputStream* graph_output) {
+  if (!validated_graph_->Config().profiler_config().enable_graph_latency()) {
+    return;
+  }
+  const std::string* stream_id =
+      &output_stream_managers_[output_stream_index].Name();
+  graph_output->SetPacketDeliveredCallback(
+      [this, stream_id](const Packet& packet) {
+        profiler_->LogEvent(TraceEvent(TraceEvent::PACKET_DELIVERED)
+                                .set_input_ts(packet.Timestamp())
+                                .set_stream_id(stream_id)
+                                .set_packet_ts(packet.Timestamp())
+                                .set_packet_data_id(&packet));
+      });
+}
+
 ::mediapipe::StatusOr<Packet> CalculatorGraph::GetOutputSidePacket(
     const std::string& packet_name) {
   int side_packet_index = validated_graph_->OutputSidePacketIndex(packet_name);
@@ -1218,18 +1286,10 @@ Packet CalculatorGraph::GetServicePacket(const GraphServiceBase& service) {
 ::mediapipe::Status CalculatorGraph::CreateDefaultThreadPool(
     const ThreadPoolExecutorOptions* default_executor_options,
     int num_threads) {
-  MediaPipeOptions extendable_options;
-  ThreadPoolExecutorOptions* options =
-      extendable_options.MutableExtension(ThreadPoolExecutorOptions::ext);
-  if (default_executor_options != nullptr) {
-    options->CopyFrom(*default_executor_options);
-  }
-  options->set_num_threads(num_threads);
-  // clang-format off
-  ASSIGN_OR_RETURN(Executor* executor,
-                   ThreadPoolExecutor::Create(extendable_options));
-  // clang-format on
-  return SetExecutorInternal("", std::shared_ptr<Executor>(executor));
+  ASSIGN_OR_RETURN(std::shared_ptr<Executor> executor,
+                   internal::CreateDefaultThreadPool(default_executor_options,
+                                                     num_threads));
+  return SetExecutorInternal("", std::move(executor));
 }
 
 // static
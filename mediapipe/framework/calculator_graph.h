@@ -50,6 +50,7 @@
 #include "mediapipe/framework/port.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/statusor.h"
 #include "mediapipe/framework/scheduler.h"
 #include "mediapipe/framework/thread_pool_executor.pb.h"
 
@@ -64,6 +65,35 @@ namespace mediapipe {
 
 typedef ::mediapipe::StatusOr<OutputStreamPoller> StatusOrPoller;
 
+namespace internal {
+
+// Creates the executors declared by the ExecutorConfigs of |config| and passes
+// each one to |add_executor|.  An ExecutorConfig whose name is already in
+// |executors| must not have a "type" field, since that executor was provided
+// with |owner|::SetExecutor().  The default executor is not created here:
+// |default_executor_options| is set to its ThreadPoolExecutorOptions if its
+// type is unspecified, and |use_application_thread| is set if its type is
+// "ApplicationThreadExecutor".
+//
+// Shared by CalculatorGraph and CalculatorGraphHost.
+::mediapipe::Status CreateConfiguredExecutors(
+    const CalculatorGraphConfig& config, const std::string& owner,
+    const std::map<std::string, std::shared_ptr<Executor>>& executors,
+    const std::function<::mediapipe::Status(const std::string& name,
+                                            std::shared_ptr<Executor>)>&
+        add_executor,
+    const ThreadPoolExecutorOptions** default_executor_options,
+    bool* use_application_thread);
+
+// Creates a thread pool to be used as the default executor.  The num_threads
+// argument overrides the num_threads field in default_executor_options, which
+// may be null.
+::mediapipe::StatusOr<std::shared_ptr<Executor>> CreateDefaultThreadPool(
+    const ThreadPoolExecutorOptions* default_executor_options,
+    int num_threads);
+
+}  // namespace internal
+
 // The class representing a DAG of calculator nodes.
 //
 // CalculatorGraph is the primary API for the MediaPipe Framework.
@@ -146,6 +176,15 @@ class CalculatorGraph {
       const std::string& graph_type = "",
       const Subgraph::SubgraphOptions* options = nullptr);
 
+  // Initializes the graph from an initialized ValidatedGraphConfig.  The
+  // ValidatedGraphConfig can be shared by several graphs, which then skip
+  // validating and canonicalizing the same config each.  See
+  // ValidatedGraphConfigCache for reusing ValidatedGraphConfigs, and
+  // CalculatorGraphHost for serving many instances of a graph.
+  ::mediapipe::Status Initialize(
+      std::shared_ptr<const ValidatedGraphConfig> validated_graph,
+      const std::map<std::string, Packet>& side_packets);
+
   // Returns the canonicalized CalculatorGraphConfig for this graph.
   const CalculatorGraphConfig& Config() const {
     return validated_graph_->Config();
@@ -162,8 +201,12 @@ class CalculatorGraph {
   // Adds an OutputStreamPoller for a stream. This provides a synchronous,
   // polling API for accessing a stream's output. Should only be called before
   // Run() or StartRun(). For asynchronous output, use ObserveOutputStream. See
-  // also the helpers in tool/sink.h.
+  // also the helpers in tool/sink.h.  The options select how the packets are
+  // handed over to the poller, see OutputStreamPollerOptions.
   StatusOrPoller AddOutputStreamPoller(const std::string& stream_name);
+  StatusOrPoller AddOutputStreamPoller(
+      const std::string& stream_name,
+      const OutputStreamPollerOptions& options);
 
   // Gets output side packet by name after the graph is done. However, base
   // packets (generated by PacketGenerators) can be retrieved before
@@ -447,11 +490,6 @@ class CalculatorGraph {
     OutputStreamShard shard_;
   };
 
-  // Initializes the graph from a ValidatedGraphConfig object.
-  ::mediapipe::Status Initialize(
-      std::unique_ptr<ValidatedGraphConfig> validated_graph,
-      const std::map<std::string, Packet>& side_packets);
-
   // AddPacketToInputStreamInternal template is called by either
   // AddPacketToInputStream(Packet&& packet) or
   // AddPacketToInputStream(const Packet& packet).
@@ -532,6 +570,11 @@ class CalculatorGraph {
   // status before taking any action.
   void UpdateThrottledNodes(InputStreamManager* stream, bool* stream_was_full);
 
+  // Logs the delivery of each packet from a graph output stream to the
+  // profiler, if ProfilerConfig.enable_graph_latency is set.
+  void TrackGraphOutputLatency(int output_stream_index,
+                               internal::GraphOutputStream* graph_output);
+
   Packet GetServicePacket(const GraphServiceBase& service);
 #ifndef MEDIAPIPE_DISABLE_GPU
   // Owns the legacy GpuSharedData if we need to create one for backwards
@@ -546,7 +589,8 @@ class CalculatorGraph {
   PacketType any_packet_type_;
 
   // The ValidatedGraphConfig object defining this CalculatorGraph.
-  std::unique_ptr<ValidatedGraphConfig> validated_graph_;
+  // It may be shared with other graphs.
+  std::shared_ptr<const ValidatedGraphConfig> validated_graph_;
 
   // The PacketGeneratorGraph to use to generate all the input side packets.
   PacketGeneratorGraph packet_generator_graph_;
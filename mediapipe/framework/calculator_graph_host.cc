@@ -0,0 +1,141 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/calculator_graph_host.h"
+
+#include <set>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/port/canonical_errors.h"
+#include "mediapipe/framework/port/map_util.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status_builder.h"
+#include "mediapipe/framework/thread_pool_executor.pb.h"
+#include "mediapipe/util/cpu_util.h"
+
+namespace mediapipe {
+
+CalculatorGraphHost::CalculatorGraphHost() {}
+
+CalculatorGraphHost::~CalculatorGraphHost() {}
+
+::mediapipe::Status CalculatorGraphHost::SetExecutor(
+    const std::string& name, std::shared_ptr<Executor> executor) {
+  RET_CHECK(!initialized_)
+      << "SetExecutor can only be called before Initialize()";
+  if (ValidatedGraphConfig::IsReservedExecutorName(name)) {
+    return ::mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
+           << "\"" << name << "\" is a reserved executor name.";
+  }
+  if (!executors_.emplace(name, std::move(executor)).second) {
+    return ::mediapipe::AlreadyExistsErrorBuilder(MEDIAPIPE_LOC)
+           << "SetExecutor must be called only once for the executor \"" << name
+           << "\"";
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status CalculatorGraphHost::SetServicePacket(
+    const GraphServiceBase& service, Packet p) {
+  RET_CHECK(!initialized_)
+      << "SetServicePacket can only be called before Initialize()";
+  service_packets_[service.key] = std::move(p);
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status CalculatorGraphHost::CreateSharedExecutors(
+    CalculatorGraphConfig* config) {
+  const ThreadPoolExecutorOptions* default_executor_options;
+  bool use_application_thread;
+  std::set<std::string> created;
+  MP_RETURN_IF_ERROR(internal::CreateConfiguredExecutors(
+      *config, "CalculatorGraphHost", executors_,
+      [this, &created](const std::string& name,
+                       std::shared_ptr<Executor> executor) {
+        executors_[name] = std::move(executor);
+        created.insert(name);
+        return ::mediapipe::OkStatus();
+      },
+      &default_executor_options, &use_application_thread));
+
+#ifdef __EMSCRIPTEN__
+  use_application_thread = true;
+#endif  // __EMSCRIPTEN__
+  if (!::mediapipe::ContainsKey(executors_, "") && !use_application_thread) {
+    // The graph-level num_threads field is converted into the default
+    // ExecutorConfig only during validation.
+    int num_threads = default_executor_options == nullptr
+                          ? config->num_threads()
+                          : default_executor_options->num_threads();
+    // The default executor runs the nodes of every graph, so it has one
+    // thread per core rather than one per node.
+    if (num_threads == 0 || num_threads == -1) {
+      num_threads = mediapipe::NumCPUCores();
+    }
+    ASSIGN_OR_RETURN(executors_[""],
+                     internal::CreateDefaultThreadPool(
+                         default_executor_options, num_threads));
+  }
+
+  // Each graph receives the shared executors through
+  // CalculatorGraph::SetExecutor(), which requires an ExecutorConfig without
+  // a "type" field.
+  for (ExecutorConfig& executor_config : *config->mutable_executor()) {
+    if (::mediapipe::ContainsKey(created, executor_config.name())) {
+      executor_config.clear_type();
+      executor_config.clear_options();
+    }
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status CalculatorGraphHost::Initialize(
+    const CalculatorGraphConfig& config,
+    const std::map<std::string, Packet>& side_packets) {
+  RET_CHECK(!initialized_).SetNoLogging()
+      << "CalculatorGraphHost can be initialized only once.";
+  CalculatorGraphConfig shared_config = config;
+  MP_RETURN_IF_ERROR(CreateSharedExecutors(&shared_config));
+  auto validated_graph = absl::make_unique<ValidatedGraphConfig>();
+  MP_RETURN_IF_ERROR(validated_graph->Initialize(shared_config));
+  validated_graph_ = std::move(validated_graph);
+  side_packets_ = side_packets;
+  initialized_ = true;
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status CalculatorGraphHost::Initialize(
+    const CalculatorGraphConfig& config) {
+  return Initialize(config, {});
+}
+
+::mediapipe::StatusOr<std::unique_ptr<CalculatorGraph>>
+CalculatorGraphHost::CreateGraph() const {
+  RET_CHECK(initialized_).SetNoLogging()
+      << "CalculatorGraphHost is not initialized.";
+  auto graph = absl::make_unique<CalculatorGraph>();
+  for (const auto& name_executor : executors_) {
+    MP_RETURN_IF_ERROR(
+        graph->SetExecutor(name_executor.first, name_executor.second));
+  }
+  for (const auto& key_packet : service_packets_) {
+    MP_RETURN_IF_ERROR(graph->SetServicePacket(
+        GraphServiceBase(key_packet.first.c_str()), key_packet.second));
+  }
+  MP_RETURN_IF_ERROR(graph->Initialize(validated_graph_, side_packets_));
+  return std::move(graph);
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,125 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_CALCULATOR_GRAPH_HOST_H_
+#define MEDIAPIPE_FRAMEWORK_CALCULATOR_GRAPH_HOST_H_
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "mediapipe/framework/calculator.pb.h"
+#include "mediapipe/framework/calculator_graph.h"
+#include "mediapipe/framework/executor.h"
+#include "mediapipe/framework/graph_service.h"
+#include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/framework/validated_graph_config.h"
+
+namespace mediapipe {
+
+// Serves many instances of the same graph in one process, such as one
+// instance per client stream.  The host validates the graph config once, and
+// owns the executors, the graph services and the input side packets shared by
+// all instances.  Each instance created by the host runs independently, but
+// initializes without validating the config or starting threads of its own.
+//
+// The executors declared by the config with a "type" field are created once
+// by the host.  The default executor, unless it is provided with
+// SetExecutor() or declared as "ApplicationThreadExecutor", is a single
+// ThreadPoolExecutor with one thread per CPU core by default, since it runs
+// the nodes of all instances.  Likewise, the GpuResources can be shared by
+// setting mediapipe::kGpuService with SetServiceObject().
+//
+// Example:
+//   CalculatorGraphHost host;
+//   MP_RETURN_IF_ERROR(host.SetServiceObject(kGpuService, gpu_resources));
+//   MP_RETURN_IF_ERROR(host.Initialize(config, {{"model", model_packet}}));
+//
+//   // For each client stream.
+//   ASSIGN_OR_RETURN(std::unique_ptr<CalculatorGraph> graph,
+//                    host.CreateGraph());
+//   MP_RETURN_IF_ERROR(graph->StartRun({}));
+class CalculatorGraphHost {
+ public:
+  CalculatorGraphHost();
+  CalculatorGraphHost(const CalculatorGraphHost&) = delete;
+  CalculatorGraphHost& operator=(const CalculatorGraphHost&) = delete;
+  ~CalculatorGraphHost();
+
+  // Sets the executor shared by the graphs for the nodes assigned to the
+  // executor named |name|.  If |name| is empty, this sets the default
+  // executor.  Must be called before Initialize().
+  ::mediapipe::Status SetExecutor(const std::string& name,
+                                  std::shared_ptr<Executor> executor);
+
+  // Sets a service object shared by the graphs.  Must be called before
+  // Initialize().
+  template <typename T>
+  ::mediapipe::Status SetServiceObject(const GraphService<T>& service,
+                                       std::shared_ptr<T> object) {
+    return SetServicePacket(service,
+                            MakePacket<std::shared_ptr<T>>(std::move(object)));
+  }
+
+  ::mediapipe::Status SetServicePacket(const GraphServiceBase& service,
+                                       Packet p);
+
+  // Validates the graph config and creates the shared executors.
+  // |side_packets| are passed to CalculatorGraph::Initialize() for every
+  // graph, and are therefore shared by all instances.  The side packets
+  // specific to an instance can be passed to CalculatorGraph::StartRun().
+  ::mediapipe::Status Initialize(
+      const CalculatorGraphConfig& config,
+      const std::map<std::string, Packet>& side_packets);
+
+  // Convenience version which does not take side packets.
+  ::mediapipe::Status Initialize(const CalculatorGraphConfig& config);
+
+  // Returns a new initialized instance of the graph.  Can be called
+  // concurrently from several threads.
+  ::mediapipe::StatusOr<std::unique_ptr<CalculatorGraph>> CreateGraph() const;
+
+  // Returns the canonicalized CalculatorGraphConfig shared by the graphs.
+  // In this config, the executors created by the host have no "type" field,
+  // because they are provided to each graph with SetExecutor().
+  const CalculatorGraphConfig& Config() const {
+    return validated_graph_->Config();
+  }
+
+ private:
+  // Creates the executors declared by |config| that can be shared, and
+  // clears their types from |config|.
+  ::mediapipe::Status CreateSharedExecutors(CalculatorGraphConfig* config);
+
+  // True if the host was initialized.
+  bool initialized_ = false;
+
+  // The ValidatedGraphConfig shared by the graphs.
+  std::shared_ptr<const ValidatedGraphConfig> validated_graph_;
+
+  // The executors shared by the graphs, keyed by executor name.
+  std::map<std::string, std::shared_ptr<Executor>> executors_;
+
+  // The service packets shared by the graphs, keyed by service key.
+  std::map<std::string, Packet> service_packets_;
+
+  // The input side packets shared by the graphs.
+  std::map<std::string, Packet> side_packets_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_CALCULATOR_GRAPH_HOST_H_
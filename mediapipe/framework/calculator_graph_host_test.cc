@@ -0,0 +1,219 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/calculator_graph_host.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/executor.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/test_service.h"
+#include "mediapipe/framework/thread_pool_executor.h"
+
+namespace mediapipe {
+namespace {
+
+using ::testing::HasSubstr;
+
+// A ThreadPoolExecutor that counts its instances.
+class CountedExecutor : public ThreadPoolExecutor {
+ public:
+  static ::mediapipe::StatusOr<Executor*> Create(
+      const MediaPipeOptions& extendable_options) {
+    ++num_created_;
+    return new CountedExecutor();
+  }
+
+  CountedExecutor() : ThreadPoolExecutor(1) {}
+
+  static std::atomic<int> num_created_;
+};
+std::atomic<int> CountedExecutor::num_created_(0);
+REGISTER_EXECUTOR(CountedExecutor);
+
+// Creates a graph instance, or crashes.
+std::unique_ptr<CalculatorGraph> CreateGraphOrDie(
+    const CalculatorGraphHost& host) {
+  auto graph_or = host.CreateGraph();
+  MEDIAPIPE_CHECK_OK(graph_or.status());
+  return std::move(graph_or.ValueOrDie());
+}
+
+// Runs a graph to completion, and returns the packets of its output stream
+// "out".
+std::vector<Packet> RunGraph(CalculatorGraph* graph,
+                             const std::vector<int>& inputs) {
+  std::vector<Packet> output_packets;
+  MEDIAPIPE_CHECK_OK(
+      graph->ObserveOutputStream("out", [&](const Packet& packet) {
+        output_packets.push_back(packet);
+        return ::mediapipe::OkStatus();
+      }));
+  MEDIAPIPE_CHECK_OK(graph->StartRun({}));
+  for (int i = 0; i < inputs.size(); ++i) {
+    MEDIAPIPE_CHECK_OK(graph->AddPacketToInputStream(
+        "in", MakePacket<int>(inputs[i]).At(Timestamp(i))));
+  }
+  MEDIAPIPE_CHECK_OK(graph->CloseAllInputStreams());
+  MEDIAPIPE_CHECK_OK(graph->WaitUntilDone());
+  return output_packets;
+}
+
+// The graphs share the validated config and the input side packets.
+TEST(CalculatorGraphHostTest, SharesConfigAndSidePackets) {
+  CalculatorGraphConfig config =
+      ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        node {
+          calculator: "SidePacketToOutputPacketCalculator"
+          input_side_packet: "model"
+          output_stream: "out"
+        }
+      )");
+  Packet model = MakePacket<int>(7);
+  CalculatorGraphHost host;
+  MP_ASSERT_OK(host.Initialize(config, {{"model", model}}));
+
+  std::vector<std::unique_ptr<CalculatorGraph>> graphs;
+  for (int i = 0; i < 3; ++i) {
+    std::unique_ptr<CalculatorGraph> graph = CreateGraphOrDie(host);
+    EXPECT_EQ(&host.Config(), &graph->Config());
+    graphs.push_back(std::move(graph));
+  }
+  for (auto& graph : graphs) {
+    std::vector<Packet> output_packets = RunGraph(graph.get(), {});
+    ASSERT_EQ(1, output_packets.size());
+    EXPECT_EQ(&model.Get<int>(), &output_packets[0].Get<int>());
+  }
+}
+
+// The executors declared with a type are created once for all graphs.
+TEST(CalculatorGraphHostTest, SharesExecutors) {
+  CalculatorGraphConfig config =
+      ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "in"
+        executor { name: "counted" type: "CountedExecutor" }
+        node {
+          calculator: "DoubleIntCalculator"
+          input_stream: "in"
+          output_stream: "out"
+          executor: "counted"
+        }
+      )");
+  CountedExecutor::num_created_ = 0;
+  CalculatorGraphHost host;
+  MP_ASSERT_OK(host.Initialize(config));
+  EXPECT_EQ(1, CountedExecutor::num_created_);
+  EXPECT_TRUE(host.Config().executor(0).type().empty());
+
+  for (int i = 0; i < 3; ++i) {
+    std::unique_ptr<CalculatorGraph> graph = CreateGraphOrDie(host);
+    std::vector<Packet> output_packets = RunGraph(graph.get(), {i, i + 1});
+    ASSERT_EQ(2, output_packets.size());
+    EXPECT_EQ(2 * i, output_packets[0].Get<int>());
+    EXPECT_EQ(2 * i + 2, output_packets[1].Get<int>());
+  }
+  EXPECT_EQ(1, CountedExecutor::num_created_);
+}
+
+// The executors set on the host replace the ones in the config.
+TEST(CalculatorGraphHostTest, SetExecutor) {
+  CalculatorGraphConfig config =
+      ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "in"
+        executor { name: "counted" }
+        node {
+          calculator: "DoubleIntCalculator"
+          input_stream: "in"
+          output_stream: "out"
+          executor: "counted"
+        }
+      )");
+  CountedExecutor::num_created_ = 0;
+  CalculatorGraphHost host;
+  MP_ASSERT_OK(
+      host.SetExecutor("counted", std::make_shared<CountedExecutor>()));
+  MP_ASSERT_OK(host.SetExecutor("", std::make_shared<CountedExecutor>()));
+  MP_ASSERT_OK(host.Initialize(config));
+  EXPECT_EQ(0, CountedExecutor::num_created_);
+
+  std::unique_ptr<CalculatorGraph> graph = CreateGraphOrDie(host);
+  std::vector<Packet> output_packets = RunGraph(graph.get(), {3});
+  ASSERT_EQ(1, output_packets.size());
+  EXPECT_EQ(6, output_packets[0].Get<int>());
+}
+
+// The graphs share the service objects set on the host.
+TEST(CalculatorGraphHostTest, SharesServices) {
+  CalculatorGraphConfig config =
+      ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "in"
+        node {
+          calculator: "TestServiceCalculator"
+          input_stream: "in"
+          output_stream: "out"
+        }
+      )");
+  auto service_object = std::make_shared<TestServiceObject>(
+      TestServiceObject{{"delta", 5}, {"count", 0}});
+  CalculatorGraphHost host;
+  MP_ASSERT_OK(host.SetServiceObject(kTestService, service_object));
+  MP_ASSERT_OK(host.Initialize(config));
+
+  for (int i = 0; i < 2; ++i) {
+    std::unique_ptr<CalculatorGraph> graph = CreateGraphOrDie(host);
+    EXPECT_EQ(service_object, graph->GetServiceObject(kTestService));
+    std::vector<Packet> output_packets = RunGraph(graph.get(), {3});
+    ASSERT_EQ(1, output_packets.size());
+    EXPECT_EQ(8, output_packets[0].Get<int>());
+  }
+  EXPECT_EQ(2, (*service_object)["count"]);
+}
+
+TEST(CalculatorGraphHostTest, Errors) {
+  CalculatorGraphConfig config =
+      ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "in"
+        executor { name: "counted" type: "CountedExecutor" }
+        node {
+          calculator: "DoubleIntCalculator"
+          input_stream: "in"
+          output_stream: "out"
+          executor: "counted"
+        }
+      )");
+  CalculatorGraphHost host;
+  EXPECT_FALSE(host.CreateGraph().ok());
+  EXPECT_FALSE(host.SetExecutor("__gpu", std::make_shared<CountedExecutor>())
+                   .ok());
+  MP_ASSERT_OK(
+      host.SetExecutor("counted", std::make_shared<CountedExecutor>()));
+  ::mediapipe::Status status = host.Initialize(config);
+  EXPECT_THAT(status.message(), HasSubstr("has a \"type\" field"));
+
+  CalculatorGraphHost other_host;
+  MP_ASSERT_OK(other_host.Initialize(config));
+  EXPECT_FALSE(other_host.Initialize(config).ok());
+  EXPECT_FALSE(
+      other_host.SetExecutor("", std::make_shared<CountedExecutor>()).ok());
+}
+
+}  // namespace
+}  // namespace mediapipe
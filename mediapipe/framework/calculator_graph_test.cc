@@ -60,6 +60,7 @@
 #include "mediapipe/framework/tool/sink.h"
 #include "mediapipe/framework/tool/status_util.h"
 #include "mediapipe/framework/type_map.h"
+#include "mediapipe/util/cpu_util.h"
 
 namespace mediapipe {
 
@@ -1598,6 +1599,80 @@ TEST(CalculatorGraph, RunsCorrectlyWithMultipleExecutors) {
   RunComprehensiveTest(&graph, proto, /*define_node_5=*/true);
 }
 
+TEST(CalculatorGraph, RunsCorrectlyWithWorkStealingExecutors) {
+  CalculatorGraph graph;
+  CalculatorGraphConfig proto = GetConfig();
+  // Replace the default executor and add executor "second".
+  for (const std::string& name : {"", "second"}) {
+    ExecutorConfig* executor = proto.add_executor();
+    executor->set_name(name);
+    executor->set_type("WorkStealingExecutor");
+    executor->mutable_options()
+        ->MutableExtension(ThreadPoolExecutorOptions::ext)
+        ->set_num_threads(2);
+  }
+  for (int i = 1; i < proto.node_size(); i += 2) {
+    proto.mutable_node(i)->set_executor("second");
+  }
+  RunComprehensiveTest(&graph, proto, /*define_node_5=*/true);
+}
+
+#if defined(__linux__)
+TEST(CalculatorGraph, RunsCorrectlyWithPinnedExecutors) {
+  CalculatorGraph graph;
+  CalculatorGraphConfig proto = GetConfig();
+  // Pin the default executor per core, and executor "second" per NUMA node on
+  // node 0, which exists whenever the NUMA topology is available.
+  ExecutorConfig* executor = proto.add_executor();
+  executor->set_type("ThreadPoolExecutor");
+  ThreadPoolExecutorOptions* options =
+      executor->mutable_options()->MutableExtension(
+          ThreadPoolExecutorOptions::ext);
+  options->set_num_threads(2);
+  options->set_thread_affinity(ThreadPoolExecutorOptions::PER_CORE);
+  executor = proto.add_executor();
+  executor->set_name("second");
+  executor->set_type("WorkStealingExecutor");
+  options = executor->mutable_options()->MutableExtension(
+      ThreadPoolExecutorOptions::ext);
+  options->set_num_threads(2);
+  options->set_thread_affinity(ThreadPoolExecutorOptions::PER_NUMA_NODE);
+  if (IsNumaTopologyAvailable()) {
+    options->add_numa_node(0);
+  }
+  for (int i = 1; i < proto.node_size(); i += 2) {
+    proto.mutable_node(i)->set_executor("second");
+  }
+  RunComprehensiveTest(&graph, proto, /*define_node_5=*/true);
+}
+#endif  // __linux__
+
+TEST(CalculatorGraph, RejectsUnknownNumaNode) {
+  CalculatorGraphConfig config =
+      ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        executor {
+          type: "ThreadPoolExecutor"
+          options {
+            [mediapipe.ThreadPoolExecutorOptions.ext] {
+              num_threads: 2
+              numa_node: 4096
+            }
+          }
+        }
+        node { calculator: 'PthreadSelfSourceCalculator' output_stream: 'out' }
+      )");
+  CalculatorGraph graph;
+  ::mediapipe::Status status = graph.Initialize(config);
+  EXPECT_THAT(status.message(), testing::HasSubstr("numa_node"));
+#if defined(__linux__)
+  if (IsNumaTopologyAvailable()) {
+    EXPECT_EQ(::mediapipe::StatusCode::kInvalidArgument, status.code());
+    return;
+  }
+#endif
+  EXPECT_EQ(::mediapipe::StatusCode::kUnimplemented, status.code());
+}
+
 // Packet generator for an arbitrary unit64 packet.
 class Uint64PacketGenerator : public PacketGenerator {
  public:
@@ -4242,7 +4317,8 @@ TEST(CalculatorGraph, RunWithNumThreadsInExecutorConfig) {
     bool use_app_thread_is_expected;
   } cases[] = {{"ApplicationThreadExecutor", 0, true},
                {"<None>", 0, false},
-               {"ThreadPoolExecutor", 1, false}};
+               {"ThreadPoolExecutor", 1, false},
+               {"WorkStealingExecutor", 1, false}};
 
   CalculatorGraphConfig config =
       ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
@@ -4502,6 +4578,208 @@ TEST(CalculatorGraph, TestPollPacketsFromMultipleStreams) {
   EXPECT_EQ(kDefaultMaxCount, num_packets2);
 }
 
+// Polls the packets through a ring with various capacities, queue sizes and
+// spin counts, including rings that overflow into the regular queue.
+TEST(CalculatorGraph, TestPollPacketsThroughRing) {
+  CalculatorGraphConfig config;
+  CalculatorGraphConfig::Node* node = config.add_node();
+  node->set_calculator("CountingSourceCalculator");
+  node->add_output_stream("output");
+  node->add_input_side_packet("MAX_COUNT:max_count");
+
+  for (int ring_capacity : {1, 4, 1024}) {
+    for (int queue_size : {-1, 1, 8}) {
+      for (int spin_iterations : {0, 100}) {
+        CalculatorGraph graph;
+        MP_ASSERT_OK(graph.Initialize(config));
+        OutputStreamPollerOptions options;
+        options.ring_capacity = ring_capacity;
+        options.spin_iterations = spin_iterations;
+        auto status_or_poller = graph.AddOutputStreamPoller("output", options);
+        ASSERT_TRUE(status_or_poller.ok());
+        OutputStreamPoller poller = std::move(status_or_poller.ValueOrDie());
+        poller.SetMaxQueueSize(queue_size);
+        MP_ASSERT_OK(graph.StartRun(
+            {{"max_count", MakePacket<int>(kDefaultMaxCount)}}));
+        Packet packet;
+        int num_packets = 0;
+        while (poller.Next(&packet)) {
+          EXPECT_EQ(num_packets, packet.Get<int>());
+          ++num_packets;
+        }
+        MP_ASSERT_OK(graph.CloseAllPacketSources());
+        MP_ASSERT_OK(graph.WaitUntilDone());
+        EXPECT_FALSE(poller.Next(&packet));
+        EXPECT_FALSE(poller.TryNext(&packet));
+        EXPECT_EQ(kDefaultMaxCount, num_packets);
+      }
+    }
+  }
+}
+
+// The packets held in the ring count towards the maximum queue size.
+TEST(CalculatorGraph, TestPollPacketsThroughRingThrottles) {
+  CalculatorGraphConfig config;
+  CalculatorGraphConfig::Node* node = config.add_node();
+  node->set_calculator("CountingSourceCalculator");
+  node->add_output_stream("output");
+  node->add_input_side_packet("MAX_COUNT:max_count");
+
+  for (int queue_size : {2, 5, 8}) {
+    CalculatorGraph graph;
+    MP_ASSERT_OK(graph.Initialize(config));
+    OutputStreamPollerOptions options;
+    options.ring_capacity = 16;
+    auto status_or_poller = graph.AddOutputStreamPoller("output", options);
+    ASSERT_TRUE(status_or_poller.ok());
+    OutputStreamPoller poller = std::move(status_or_poller.ValueOrDie());
+    poller.SetMaxQueueSize(queue_size);
+    MP_ASSERT_OK(
+        graph.StartRun({{"max_count", MakePacket<int>(kDefaultMaxCount)}}));
+    MP_ASSERT_OK(graph.WaitUntilIdle());
+    EXPECT_EQ(queue_size, poller.QueueSize());
+    Packet packet;
+    int num_packets = 0;
+    while (poller.Next(&packet)) {
+      EXPECT_EQ(num_packets, packet.Get<int>());
+      ++num_packets;
+    }
+    MP_ASSERT_OK(graph.CloseAllPacketSources());
+    MP_ASSERT_OK(graph.WaitUntilDone());
+    EXPECT_EQ(kDefaultMaxCount, num_packets);
+  }
+}
+
+TEST(CalculatorGraph, TestPollPacketBatches) {
+  CalculatorGraphConfig config;
+  CalculatorGraphConfig::Node* node = config.add_node();
+  node->set_calculator("CountingSourceCalculator");
+  node->add_output_stream("output");
+  node->add_input_side_packet("MAX_COUNT:max_count");
+
+  for (int ring_capacity : {0, 16}) {
+    CalculatorGraph graph;
+    MP_ASSERT_OK(graph.Initialize(config));
+    OutputStreamPollerOptions options;
+    options.ring_capacity = ring_capacity;
+    auto status_or_poller = graph.AddOutputStreamPoller("output", options);
+    ASSERT_TRUE(status_or_poller.ok());
+    OutputStreamPoller poller = std::move(status_or_poller.ValueOrDie());
+    MP_ASSERT_OK(
+        graph.StartRun({{"max_count", MakePacket<int>(kDefaultMaxCount)}}));
+    std::vector<Packet> packets;
+    int num_batches = 0;
+    while (poller.NextBatch(&packets, 8)) {
+      ++num_batches;
+      ASSERT_LE(packets.size(), 8 * num_batches);
+    }
+    MP_ASSERT_OK(graph.CloseAllPacketSources());
+    MP_ASSERT_OK(graph.WaitUntilDone());
+    ASSERT_EQ(kDefaultMaxCount, packets.size());
+    for (int i = 0; i < kDefaultMaxCount; ++i) {
+      EXPECT_EQ(i, packets[i].Get<int>());
+    }
+    EXPECT_GE(num_batches, kDefaultMaxCount / 8);
+  }
+}
+
+TEST(CalculatorGraph, TestTryNextPacket) {
+  CalculatorGraphConfig config =
+      ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "input"
+        node {
+          calculator: "PassThroughCalculator"
+          input_stream: "input"
+          output_stream: "output"
+        }
+      )");
+  for (int ring_capacity : {0, 4}) {
+    CalculatorGraph graph;
+    MP_ASSERT_OK(graph.Initialize(config));
+    OutputStreamPollerOptions options;
+    options.ring_capacity = ring_capacity;
+    auto status_or_poller = graph.AddOutputStreamPoller("output", options);
+    ASSERT_TRUE(status_or_poller.ok());
+    OutputStreamPoller poller = std::move(status_or_poller.ValueOrDie());
+    MP_ASSERT_OK(graph.StartRun({}));
+    Packet packet;
+    EXPECT_FALSE(poller.TryNext(&packet));
+    for (int i = 0; i < 6; ++i) {
+      MP_ASSERT_OK(graph.AddPacketToInputStream(
+          "input", MakePacket<int>(i).At(Timestamp(i))));
+    }
+    MP_ASSERT_OK(graph.WaitUntilIdle());
+    EXPECT_EQ(6, poller.QueueSize());
+    for (int i = 0; i < 6; ++i) {
+      ASSERT_TRUE(poller.TryNext(&packet));
+      EXPECT_EQ(i, packet.Get<int>());
+      EXPECT_EQ(Timestamp(i), packet.Timestamp());
+    }
+    EXPECT_FALSE(poller.TryNext(&packet));
+    MP_ASSERT_OK(graph.CloseAllPacketSources());
+    MP_ASSERT_OK(graph.WaitUntilDone());
+    EXPECT_FALSE(poller.Next(&packet));
+  }
+}
+
+TEST(CalculatorGraph, TestPollPacketThroughRingAfterError) {
+  CalculatorGraphConfig config;
+  CalculatorGraphConfig::Node* node = config.add_node();
+  node->set_calculator("FailingSourceCalculator");
+  node->add_output_stream("output");
+
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.Initialize(config));
+  OutputStreamPollerOptions options;
+  options.ring_capacity = 4;
+  auto status_or_poller = graph.AddOutputStreamPoller("output", options);
+  ASSERT_TRUE(status_or_poller.ok());
+  OutputStreamPoller poller = std::move(status_or_poller.ValueOrDie());
+  MP_ASSERT_OK(graph.StartRun({}));
+  Packet packet;
+  EXPECT_FALSE(poller.Next(&packet));
+  EXPECT_FALSE(graph.WaitUntilDone().ok());
+}
+
+// After an error, the poller delivers the packets left in the ring and in
+// the input stream before Next() returns false.
+TEST(CalculatorGraph, TestPollPacketsThroughRingDrainsAfterError) {
+  CalculatorGraphConfig config =
+      ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "input"
+        node {
+          calculator: "PassThroughCalculator"
+          input_stream: "input"
+          output_stream: "output"
+        }
+      )");
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.Initialize(config));
+  OutputStreamPollerOptions options;
+  options.ring_capacity = 1;
+  auto status_or_poller = graph.AddOutputStreamPoller("output", options);
+  ASSERT_TRUE(status_or_poller.ok());
+  OutputStreamPoller poller = std::move(status_or_poller.ValueOrDie());
+  MP_ASSERT_OK(graph.StartRun({}));
+  for (int i = 0; i < 6; ++i) {
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "input", MakePacket<int>(i).At(Timestamp(i))));
+  }
+  MP_ASSERT_OK(graph.WaitUntilIdle());
+  // A packet behind the timestamp bound fails the graph.
+  graph.AddPacketToInputStream("input", MakePacket<int>(0).At(Timestamp(0)))
+      .IgnoreError();
+
+  // The ring holds one packet, and the input stream of the poller the others.
+  Packet packet;
+  for (int i = 0; i < 6; ++i) {
+    ASSERT_TRUE(poller.Next(&packet));
+    EXPECT_EQ(i, packet.Get<int>());
+  }
+  EXPECT_FALSE(poller.Next(&packet));
+  EXPECT_FALSE(graph.WaitUntilDone().ok());
+}
+
 // Ensure that when a custom input stream handler is used to handle packets from
 // input streams, an error message is outputted with the appropriate link to
 // resolve the issue when the calculator doesn't handle inputs in monotonically
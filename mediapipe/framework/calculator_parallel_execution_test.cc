@@ -19,22 +19,27 @@
 //
 // TODO: Add more tests to verify the correctness of parallel execution.
 
+#include <atomic>
 #include <memory>
 #include <random>
 #include <string>
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
 #include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/executor.h"
+#include "mediapipe/framework/port/benchmark.h"
 #include "mediapipe/framework/port/gmock.h"
 #include "mediapipe/framework/port/gtest.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/parse_text_proto.h"
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/thread_pool_executor.h"
 
 namespace mediapipe {
 
@@ -153,5 +158,162 @@ TEST_F(ParallelExecutionTest, SlowPlusOneCalculatorsTest) {
   }
 }
 
+class PlusOneCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc) {
+    cc->Inputs().Index(0).Set<int>();
+    cc->Outputs().Index(0).Set<int>();
+    return ::mediapipe::OkStatus();
+  }
+
+  ::mediapipe::Status Process(CalculatorContext* cc) override {
+    cc->Outputs().Index(0).Add(new int(cc->Inputs().Index(0).Get<int>() + 1),
+                               cc->InputTimestamp());
+    return ::mediapipe::OkStatus();
+  }
+};
+
+REGISTER_CALCULATOR(PlusOneCalculator);
+
+// A ThreadPoolExecutor that counts the calls which lock its task queue and
+// signal its workers. If "batched" is false, AddTasks() falls back to one
+// AddTask() call per task. If "always_idle" is true, it claims to have idle
+// threads at all times.
+class CountingExecutor : public Executor {
+ public:
+  CountingExecutor(int num_threads, bool batched, bool always_idle = false)
+      : executor_(num_threads), batched_(batched), always_idle_(always_idle) {}
+
+  void AddTask(TaskQueue* task_queue) override {
+    ++num_calls_;
+    ++num_tasks_;
+    executor_.AddTask(task_queue);
+  }
+
+  void AddTasks(TaskQueue* task_queue, int count) override {
+    if (!batched_) {
+      Executor::AddTasks(task_queue, count);
+      return;
+    }
+    ++num_calls_;
+    num_tasks_ += count;
+    executor_.AddTasks(task_queue, count);
+  }
+
+  void Schedule(std::function<void()> task) override {
+    ++num_calls_;
+    executor_.Schedule(std::move(task));
+  }
+
+  bool HasIdleThreads() const override {
+    return always_idle_ || executor_.HasIdleThreads();
+  }
+
+  int64 num_calls() const { return num_calls_; }
+  int64 num_tasks() const { return num_tasks_; }
+
+ private:
+  ThreadPoolExecutor executor_;
+  const bool batched_;
+  const bool always_idle_;
+  std::atomic<int64> num_calls_{0};
+  std::atomic<int64> num_tasks_{0};
+};
+
+// A graph in which "fan_out" nodes consume the output of a single node.
+CalculatorGraphConfig FanOutGraphConfig(int fan_out) {
+  CalculatorGraphConfig config;
+  config.add_input_stream("input");
+  CalculatorGraphConfig::Node* node = config.add_node();
+  node->set_calculator("PlusOneCalculator");
+  node->add_input_stream("input");
+  node->add_output_stream("fan_out");
+  for (int i = 0; i < fan_out; ++i) {
+    node = config.add_node();
+    node->set_calculator("PlusOneCalculator");
+    node->add_input_stream("fan_out");
+    node->add_output_stream(absl::StrCat("output_", i));
+  }
+  return config;
+}
+
+// Sends "num_packets" packets through a graph built by FanOutGraphConfig.
+::mediapipe::Status RunFanOutGraph(CalculatorGraph* graph, int num_packets) {
+  MP_RETURN_IF_ERROR(graph->StartRun({}));
+  for (int i = 0; i < num_packets; ++i) {
+    MP_RETURN_IF_ERROR(graph->AddPacketToInputStream(
+        "input", MakePacket<int>(i).At(Timestamp(i))));
+  }
+  MP_RETURN_IF_ERROR(graph->CloseInputStream("input"));
+  return graph->WaitUntilDone();
+}
+
+// The nodes made ready by a running node are submitted to the executor with
+// one AddTasks() call when no thread is idle.
+TEST(BatchedTaskSubmissionTest, FanOutIsSubmittedInBatches) {
+  constexpr int kFanOut = 8;
+  constexpr int kNumPackets = 20;
+  auto executor = std::make_shared<CountingExecutor>(/*num_threads=*/2,
+                                                     /*batched=*/true);
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.SetExecutor("", executor));
+  MP_ASSERT_OK(graph.Initialize(FanOutGraphConfig(kFanOut)));
+  std::atomic<int> num_outputs(0);
+  for (int i = 0; i < kFanOut; ++i) {
+    MP_ASSERT_OK(graph.ObserveOutputStream(
+        absl::StrCat("output_", i), [&num_outputs](const Packet& packet) {
+          ++num_outputs;
+          return ::mediapipe::OkStatus();
+        }));
+  }
+  MP_ASSERT_OK(RunFanOutGraph(&graph, kNumPackets));
+  EXPECT_EQ(kFanOut * kNumPackets, num_outputs.load());
+  EXPECT_GE(executor->num_tasks(), (kFanOut + 1) * kNumPackets);
+  EXPECT_LT(executor->num_calls(), executor->num_tasks() / 2);
+}
+
+// While the executor has idle threads, each node made ready by a running node
+// is submitted right away instead of when the running node is done. Only the
+// OpenNode() tasks added before the run starts are submitted together.
+TEST(BatchedTaskSubmissionTest, IdleThreadsGetTasksImmediately) {
+  constexpr int kFanOut = 8;
+  constexpr int kNumPackets = 20;
+  auto executor = std::make_shared<CountingExecutor>(
+      /*num_threads=*/2, /*batched=*/true, /*always_idle=*/true);
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.SetExecutor("", executor));
+  MP_ASSERT_OK(graph.Initialize(FanOutGraphConfig(kFanOut)));
+  MP_ASSERT_OK(RunFanOutGraph(&graph, kNumPackets));
+  EXPECT_GE(executor->num_tasks(), (kFanOut + 1) * kNumPackets);
+  EXPECT_GE(executor->num_calls(), executor->num_tasks() - kFanOut);
+}
+
+// Reports the executor calls, each of which takes the thread pool lock and
+// signals its condition variable, per packet sent through the graph.
+void BM_FanOutGraph(benchmark::State& state, bool batched) {
+  constexpr int kNumPackets = 100;
+  auto executor = std::make_shared<CountingExecutor>(/*num_threads=*/4,
+                                                     batched);
+  CalculatorGraph graph;
+  CHECK(graph.SetExecutor("", executor).ok());
+  CHECK(graph.Initialize(FanOutGraphConfig(state.range(0))).ok());
+  for (auto _ : state) {
+    CHECK(RunFanOutGraph(&graph, kNumPackets).ok());
+  }
+  const double num_packets = state.iterations() * kNumPackets;
+  state.counters["executor_calls_per_packet"] =
+      executor->num_calls() / num_packets;
+  state.counters["tasks_per_packet"] = executor->num_tasks() / num_packets;
+  state.SetItemsProcessed(state.iterations() * kNumPackets);
+}
+BENCHMARK_CAPTURE(BM_FanOutGraph, PerTask, false)
+    ->RangeMultiplier(4)
+    ->Range(4, 64)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_FanOutGraph, Batched, true)
+    ->RangeMultiplier(4)
+    ->Range(4, 64)
+    ->UseRealTime();
+
 }  // namespace
 }  // namespace mediapipe
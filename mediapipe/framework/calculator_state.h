@@ -75,6 +75,11 @@ class CalculatorState {
   }
   const std::string& NodeName() const { return node_name_; }
   const int& NodeId() const { return node_id_; }
+  // Returns the maximum number of Process() calls of the node that may run in
+  // parallel, as set by CalculatorGraphConfig::Node::max_in_flight.
+  int MaxInFlight() const {
+    return node_config_.max_in_flight() ? node_config_.max_in_flight() : 1;
+  }
 
   ////////////////////////////////////////
   // Interface for Calculator.
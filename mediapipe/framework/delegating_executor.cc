@@ -23,5 +23,17 @@ void DelegatingExecutor::Schedule(std::function<void()> task) {
   callback_(std::move(task));
 }
 
+void DelegatingExecutor::AddTasks(TaskQueue* task_queue, int count) {
+  if (count == 1) {
+    AddTask(task_queue);
+    return;
+  }
+  callback_([task_queue, count] {
+    for (int i = 0; i < count; ++i) {
+      task_queue->RunNextTask();
+    }
+  });
+}
+
 }  // namespace internal
 }  // namespace mediapipe
@@ -27,6 +27,11 @@ class DelegatingExecutor : public Executor {
       std::function<void(std::function<void()>)> callback)
       : callback_(std::move(callback)) {}
   void Schedule(std::function<void()> task) override;
+  // The delegate runs its tasks one at a time, so the batch is handed over as
+  // a single task that runs "count" tasks from the queue.
+  void AddTasks(TaskQueue* task_queue, int count) override;
+  // The delegate has no threads of its own waiting for tasks.
+  bool HasIdleThreads() const override { return false; }
 
  private:
   std::function<void(std::function<void()>)> callback_;
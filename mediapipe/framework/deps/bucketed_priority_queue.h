@@ -0,0 +1,155 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_DEPS_BUCKETED_PRIORITY_QUEUE_H_
+#define MEDIAPIPE_DEPS_BUCKETED_PRIORITY_QUEUE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <utility>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
+
+namespace mediapipe {
+
+// A concurrent priority queue for a small, fixed range of integer priorities.
+//
+// Each priority has its own FIFO bucket with its own mutex, and an atomic
+// bitmap records which buckets are non-empty. Push() only locks the target
+// bucket; Pop() scans the bitmap from the highest priority down and only
+// locks buckets that appear to be non-empty. Threads pushing or popping
+// different priorities therefore do not contend with each other.
+//
+// Pop() takes an item of the highest priority that was non-empty during its
+// scan. Under concurrent pushes this is a linearizable "some item of maximal
+// priority at some point during the call", not a strict global order.
+template <typename T>
+class BucketedPriorityQueue {
+ public:
+  explicit BucketedPriorityQueue(int num_buckets = 0) { Resize(num_buckets); }
+  BucketedPriorityQueue(const BucketedPriorityQueue&) = delete;
+  BucketedPriorityQueue& operator=(const BucketedPriorityQueue&) = delete;
+
+  // Changes the range of priorities to [0, num_buckets).
+  // Not thread-safe. REQUIRES: the queue is empty.
+  void Resize(int num_buckets) {
+    num_buckets_ = num_buckets;
+    num_masks_ = (num_buckets + kBitsPerMask - 1) / kBitsPerMask;
+    buckets_.reset(num_buckets > 0 ? new Bucket[num_buckets] : nullptr);
+    masks_.reset(num_masks_ > 0 ? new std::atomic<uint64_t>[num_masks_]
+                                : nullptr);
+    for (int i = 0; i < num_masks_; ++i) {
+      masks_[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  int num_buckets() const { return num_buckets_; }
+
+  // Adds "item" with the given priority. Higher priorities are popped first.
+  // Items of equal priority are popped in FIFO order.
+  // REQUIRES: 0 <= priority < num_buckets().
+  void Push(int priority, T item) {
+    // Count the item before it becomes visible, so that size() never
+    // under-reports.
+    size_.fetch_add(1, std::memory_order_relaxed);
+    Bucket& bucket = buckets_[priority];
+    absl::MutexLock lock(&bucket.mutex);
+    bucket.items.push_back(std::move(item));
+    if (bucket.items.size() == 1) {
+      masks_[priority / kBitsPerMask].fetch_or(
+          uint64_t{1} << (priority % kBitsPerMask), std::memory_order_release);
+    }
+  }
+
+  // Removes and returns an item of the highest priority, or nullopt if all
+  // buckets were seen empty.
+  absl::optional<T> Pop() {
+    for (int m = num_masks_ - 1; m >= 0; --m) {
+      uint64_t mask = masks_[m].load(std::memory_order_acquire);
+      while (mask != 0) {
+        const int bit = HighestBit(mask);
+        mask &= ~(uint64_t{1} << bit);
+        Bucket& bucket = buckets_[m * kBitsPerMask + bit];
+        absl::MutexLock lock(&bucket.mutex);
+        if (bucket.items.empty()) {
+          // Another thread emptied the bucket after we read the mask.
+          continue;
+        }
+        absl::optional<T> item(std::move(bucket.items.front()));
+        bucket.items.pop_front();
+        if (bucket.items.empty()) {
+          masks_[m].fetch_and(~(uint64_t{1} << bit),
+                              std::memory_order_relaxed);
+        }
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        return item;
+      }
+    }
+    return absl::nullopt;
+  }
+
+  // Returns the number of items. May over-report while a Push() or Pop() is
+  // in progress on another thread.
+  int size() const { return size_.load(std::memory_order_relaxed); }
+
+  bool empty() const { return size() == 0; }
+
+  // Removes all items. Not thread-safe.
+  void Clear() {
+    for (int i = 0; i < num_buckets_; ++i) {
+      absl::MutexLock lock(&buckets_[i].mutex);
+      buckets_[i].items.clear();
+    }
+    for (int i = 0; i < num_masks_; ++i) {
+      masks_[i].store(0, std::memory_order_relaxed);
+    }
+    size_.store(0, std::memory_order_relaxed);
+  }
+
+ private:
+  static constexpr int kBitsPerMask = 64;
+
+  // Buckets are cache-line aligned so that their mutexes do not share lines.
+  struct alignas(64) Bucket {
+    absl::Mutex mutex;
+    std::deque<T> items ABSL_GUARDED_BY(mutex);
+  };
+
+  // Returns the index of the most significant set bit. REQUIRES: x != 0.
+  static int HighestBit(uint64_t x) {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(x);
+#else
+    int bit = 0;
+    while (x >>= 1) ++bit;
+    return bit;
+#endif
+  }
+
+  int num_buckets_ = 0;
+  int num_masks_ = 0;
+  std::unique_ptr<Bucket[]> buckets_;
+  // Bit i of masks_[m] is set iff bucket m * kBitsPerMask + i is non-empty.
+  // Only changed while holding that bucket's mutex.
+  std::unique_ptr<std::atomic<uint64_t>[]> masks_;
+  std::atomic<int> size_{0};
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_DEPS_BUCKETED_PRIORITY_QUEUE_H_
@@ -0,0 +1,162 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/deps/bucketed_priority_queue.h"
+
+#include <atomic>
+#include <queue>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+
+namespace mediapipe {
+namespace {
+
+TEST(BucketedPriorityQueueTest, PopsHighestPriorityFirst) {
+  BucketedPriorityQueue<int> queue(130);
+  EXPECT_TRUE(queue.empty());
+  queue.Push(3, 30);
+  queue.Push(129, 1290);
+  queue.Push(64, 640);
+  queue.Push(0, 0);
+  queue.Push(63, 630);
+  EXPECT_EQ(5, queue.size());
+  EXPECT_EQ(1290, queue.Pop().value());
+  EXPECT_EQ(640, queue.Pop().value());
+  EXPECT_EQ(630, queue.Pop().value());
+  EXPECT_EQ(30, queue.Pop().value());
+  EXPECT_EQ(0, queue.Pop().value());
+  EXPECT_FALSE(queue.Pop().has_value());
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(BucketedPriorityQueueTest, EqualPrioritiesAreFifo) {
+  BucketedPriorityQueue<int> queue(4);
+  queue.Push(2, 1);
+  queue.Push(2, 2);
+  queue.Push(1, 3);
+  queue.Push(2, 4);
+  EXPECT_EQ(1, queue.Pop().value());
+  EXPECT_EQ(2, queue.Pop().value());
+  EXPECT_EQ(4, queue.Pop().value());
+  EXPECT_EQ(3, queue.Pop().value());
+}
+
+TEST(BucketedPriorityQueueTest, ResizeAndClear) {
+  BucketedPriorityQueue<int> queue;
+  EXPECT_EQ(0, queue.num_buckets());
+  EXPECT_FALSE(queue.Pop().has_value());
+  queue.Resize(70);
+  EXPECT_EQ(70, queue.num_buckets());
+  queue.Push(69, 1);
+  queue.Push(1, 2);
+  queue.Clear();
+  EXPECT_TRUE(queue.empty());
+  EXPECT_FALSE(queue.Pop().has_value());
+}
+
+// Every pushed item is popped exactly once when producers and consumers run
+// concurrently.
+TEST(BucketedPriorityQueueTest, ConcurrentPushPop) {
+  constexpr int kNumThreads = 8;
+  constexpr int kItemsPerThread = 10000;
+  BucketedPriorityQueue<int> queue(200);
+  std::vector<std::atomic<int>> popped(kNumThreads * kItemsPerThread);
+  for (auto& count : popped) count.store(0);
+  std::atomic<int> num_popped(0);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < kItemsPerThread; ++i) {
+        const int item = t * kItemsPerThread + i;
+        queue.Push(item % 200, item);
+        if (absl::optional<int> p = queue.Pop()) {
+          popped[*p].fetch_add(1);
+          num_popped.fetch_add(1);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+  while (absl::optional<int> p = queue.Pop()) {
+    popped[*p].fetch_add(1);
+    num_popped.fetch_add(1);
+  }
+  EXPECT_EQ(kNumThreads * kItemsPerThread, num_popped.load());
+  for (const auto& count : popped) {
+    ASSERT_EQ(1, count.load());
+  }
+  EXPECT_TRUE(queue.empty());
+}
+
+// A single std::priority_queue under one mutex, as previously used by the
+// SchedulerQueue, for comparison.
+class MutexPriorityQueue {
+ public:
+  explicit MutexPriorityQueue(int num_buckets) {}
+
+  void Push(int priority, int item) {
+    absl::MutexLock lock(&mutex_);
+    queue_.emplace(priority, item);
+  }
+
+  absl::optional<int> Pop() {
+    absl::MutexLock lock(&mutex_);
+    if (queue_.empty()) return absl::nullopt;
+    int item = queue_.top().second;
+    queue_.pop();
+    return item;
+  }
+
+ private:
+  absl::Mutex mutex_;
+  std::priority_queue<std::pair<int, int>> queue_ ABSL_GUARDED_BY(mutex_);
+};
+
+// Models scheduler traffic for a graph with kNumNodes nodes: each task adds
+// the context of some node and runs the highest priority one.
+constexpr int kNumNodes = 128;
+
+template <typename Queue>
+void BM_AddAndRunTask(benchmark::State& state) {
+  static Queue* queue = nullptr;
+  if (state.thread_index() == 0) {
+    queue = new Queue(kNumNodes);
+  }
+  uint32_t node = state.thread_index() * 7919;
+  for (auto _ : state) {
+    node = node * 1103515245 + 12345;
+    queue->Push(node % kNumNodes, node);
+    benchmark::DoNotOptimize(queue->Pop());
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (state.thread_index() == 0) {
+    delete queue;
+    queue = nullptr;
+  }
+}
+BENCHMARK_TEMPLATE(BM_AddAndRunTask, MutexPriorityQueue)
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_AddAndRunTask, BucketedPriorityQueue<int>)
+    ->ThreadRange(1, 64)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace mediapipe
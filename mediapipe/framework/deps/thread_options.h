@@ -19,6 +19,7 @@
 
 #include <set>
 #include <string>
+#include <vector>
 
 namespace mediapipe {
 
@@ -46,6 +47,15 @@ class ThreadOptions {
     return *this;
   }
 
+  // Binds each worker thread of a pool to its own CPU set: worker i uses
+  // worker_cpu_sets[i % worker_cpu_sets.size()]. Overrides cpu_set if
+  // non-empty.
+  ThreadOptions& set_worker_cpu_sets(
+      const std::vector<std::set<int>>& worker_cpu_sets) {
+    worker_cpu_sets_ = worker_cpu_sets;
+    return *this;
+  }
+
   ThreadOptions& set_name_prefix(const std::string& name_prefix) {
     name_prefix_ = name_prefix;
     return *this;
@@ -57,12 +67,25 @@ class ThreadOptions {
 
   const std::set<int>& cpu_set() const { return cpu_set_; }
 
+  const std::vector<std::set<int>>& worker_cpu_sets() const {
+    return worker_cpu_sets_;
+  }
+
+  // Returns the CPU set for worker thread "worker_index" of a pool.
+  const std::set<int>& cpu_set_for_worker(int worker_index) const {
+    if (worker_cpu_sets_.empty()) {
+      return cpu_set_;
+    }
+    return worker_cpu_sets_[worker_index % worker_cpu_sets_.size()];
+  }
+
   std::string name_prefix() const { return name_prefix_; }
 
  private:
   size_t stack_size_;        // Size of thread stack
   int nice_priority_level_;  // Nice priority level of the workers
   std::set<int> cpu_set_;    // CPU set for affinity setting
+  std::vector<std::set<int>> worker_cpu_sets_;  // Per-worker CPU sets
   std::string name_prefix_;  // Name of the thread
 };
 
@@ -15,6 +15,7 @@
 #ifndef MEDIAPIPE_DEPS_THREADPOOL_H_
 #define MEDIAPIPE_DEPS_THREADPOOL_H_
 
+#include <atomic>
 #include <deque>
 #include <functional>
 #include <string>
@@ -77,15 +78,30 @@ class ThreadPool {
   // thread will pull this callback off the queue and execute it.
   void Schedule(std::function<void()> callback);
 
+  // REQUIRES: StartWorkers has been called
+  // Add "count" copies of the specified callback to the queue of pending
+  // callbacks. Takes the queue lock once and wakes up at most "count" idle
+  // threads.
+  void ScheduleBatch(int count, const std::function<void()>& callback);
+
   // Provided for debugging and testing only.
   int num_threads() const;
 
+  // Returns the number of waiting worker threads that no queued callback is
+  // left for. Does not lock the queue, so the result may already be out of
+  // date.
+  int num_idle_threads() const {
+    return num_idle_threads_.load(std::memory_order_relaxed);
+  }
+
   // Standard thread options.  Use this accessor to get them.
   const ThreadOptions& thread_options() const;
 
  private:
   class WorkerThread;
   void RunWorker();
+  // Updates num_idle_threads_ after tasks_ or num_waiting_threads_ changed.
+  void UpdateNumIdleThreads() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   std::string name_prefix_;
   std::vector<WorkerThread*> threads_;
@@ -95,6 +111,10 @@ class ThreadPool {
   absl::CondVar condition_;
   bool stopped_ ABSL_GUARDED_BY(mutex_) = false;
   std::deque<std::function<void()>> tasks_ ABSL_GUARDED_BY(mutex_);
+  // The number of threads waiting on condition_.
+  int num_waiting_threads_ ABSL_GUARDED_BY(mutex_) = 0;
+  // num_waiting_threads_ minus the size of tasks_, or 0. Read without locking.
+  std::atomic<int> num_idle_threads_{0};
 
   ThreadOptions thread_options_;
 };
@@ -18,6 +18,8 @@
 #include <sys/syscall.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "mediapipe/framework/deps/threadpool.h"
@@ -27,8 +29,9 @@ namespace mediapipe {
 
 class ThreadPool::WorkerThread {
  public:
-  // Creates and starts a thread that runs pool->RunWorker().
-  WorkerThread(ThreadPool* pool, const std::string& name_prefix);
+  // Creates and starts a thread that runs pool->RunWorker(). "index" is the
+  // position of the thread in the pool.
+  WorkerThread(ThreadPool* pool, int index, const std::string& name_prefix);
 
   // REQUIRES: Join() must have been called.
   ~WorkerThread();
@@ -40,13 +43,14 @@ class ThreadPool::WorkerThread {
   static void* ThreadBody(void* arg);
 
   ThreadPool* pool_;
+  int index_;
   std::string name_prefix_;
   pthread_t thread_;
 };
 
-ThreadPool::WorkerThread::WorkerThread(ThreadPool* pool,
+ThreadPool::WorkerThread::WorkerThread(ThreadPool* pool, int index,
                                        const std::string& name_prefix)
-    : pool_(pool), name_prefix_(name_prefix) {
+    : pool_(pool), index_(index), name_prefix_(name_prefix) {
   int res = pthread_create(&thread_, nullptr, ThreadBody, this);
   CHECK_EQ(res, 0) << "pthread_create failed";
 }
@@ -59,7 +63,8 @@ void* ThreadPool::WorkerThread::ThreadBody(void* arg) {
   auto thread = reinterpret_cast<WorkerThread*>(arg);
   int nice_priority_level =
       thread->pool_->thread_options().nice_priority_level();
-  const std::set<int> selected_cpus = thread->pool_->thread_options().cpu_set();
+  const std::set<int> selected_cpus =
+      thread->pool_->thread_options().cpu_set_for_worker(thread->index_);
 #if defined(__linux__)
   const std::string name =
       internal::CreateThreadName(thread->name_prefix_, syscall(SYS_gettid));
@@ -143,25 +148,51 @@ ThreadPool::~ThreadPool() {
 
 void ThreadPool::StartWorkers() {
   for (int i = 0; i < num_threads_; ++i) {
-    threads_.push_back(new WorkerThread(this, name_prefix_));
+    threads_.push_back(new WorkerThread(this, i, name_prefix_));
   }
 }
 
 void ThreadPool::Schedule(std::function<void()> callback) {
   mutex_.Lock();
   tasks_.push_back(std::move(callback));
+  UpdateNumIdleThreads();
   condition_.Signal();
   mutex_.Unlock();
 }
 
+void ThreadPool::ScheduleBatch(int count,
+                               const std::function<void()>& callback) {
+  if (count <= 0) return;
+  mutex_.Lock();
+  for (int i = 0; i < count; ++i) {
+    tasks_.push_back(callback);
+  }
+  UpdateNumIdleThreads();
+  if (count >= num_waiting_threads_) {
+    condition_.SignalAll();
+  } else {
+    for (int i = 0; i < count; ++i) {
+      condition_.Signal();
+    }
+  }
+  mutex_.Unlock();
+}
+
 int ThreadPool::num_threads() const { return num_threads_; }
 
+void ThreadPool::UpdateNumIdleThreads() {
+  num_idle_threads_.store(
+      std::max(0, num_waiting_threads_ - static_cast<int>(tasks_.size())),
+      std::memory_order_relaxed);
+}
+
 void ThreadPool::RunWorker() {
   mutex_.Lock();
   while (true) {
     if (!tasks_.empty()) {
       std::function<void()> task = std::move(tasks_.front());
       tasks_.pop_front();
+      UpdateNumIdleThreads();
       mutex_.Unlock();
       task();
       mutex_.Lock();
@@ -169,7 +200,11 @@ void ThreadPool::RunWorker() {
       if (stopped_) {
         break;
       } else {
+        ++num_waiting_threads_;
+        UpdateNumIdleThreads();
         condition_.Wait(&mutex_);
+        --num_waiting_threads_;
+        UpdateNumIdleThreads();
       }
     }
   }
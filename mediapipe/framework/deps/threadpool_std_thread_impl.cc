@@ -15,6 +15,7 @@
 #include <errno.h>
 #include <string.h>
 
+#include <algorithm>
 #include <thread>  // NOLINT(build/c++11)
 
 #include "mediapipe/framework/deps/threadpool.h"
@@ -34,8 +35,9 @@ namespace mediapipe {
 
 class ThreadPool::WorkerThread {
  public:
-  // Creates and starts a thread that runs pool->RunWorker().
-  WorkerThread(ThreadPool* pool, const std::string& name_prefix);
+  // Creates and starts a thread that runs pool->RunWorker(). "index" is the
+  // position of the thread in the pool.
+  WorkerThread(ThreadPool* pool, int index, const std::string& name_prefix);
 
   // REQUIRES: Join() must have been called.
   ~WorkerThread();
@@ -47,13 +49,14 @@ class ThreadPool::WorkerThread {
   static void* ThreadBody(void* arg);
 
   ThreadPool* pool_;
+  int index_;
   std::string name_prefix_;
   std::thread thread_;
 };
 
-ThreadPool::WorkerThread::WorkerThread(ThreadPool* pool,
+ThreadPool::WorkerThread::WorkerThread(ThreadPool* pool, int index,
                                        const std::string& name_prefix)
-    : pool_(pool), name_prefix_(name_prefix) {
+    : pool_(pool), index_(index), name_prefix_(name_prefix) {
   thread_ = std::thread(ThreadBody, this);
 }
 
@@ -65,7 +68,8 @@ void* ThreadPool::WorkerThread::ThreadBody(void* arg) {
   auto thread = reinterpret_cast<WorkerThread*>(arg);
   int nice_priority_level =
       thread->pool_->thread_options().nice_priority_level();
-  const std::set<int> selected_cpus = thread->pool_->thread_options().cpu_set();
+  const std::set<int> selected_cpus =
+      thread->pool_->thread_options().cpu_set_for_worker(thread->index_);
   if (nice_priority_level != 0 || !selected_cpus.empty()) {
     LOG(ERROR) << "Thread priority and processor affinity feature aren't "
                   "supported by the std::thread threadpool implementation.";
@@ -105,25 +109,51 @@ ThreadPool::~ThreadPool() {
 
 void ThreadPool::StartWorkers() {
   for (int i = 0; i < num_threads_; ++i) {
-    threads_.push_back(new WorkerThread(this, name_prefix_));
+    threads_.push_back(new WorkerThread(this, i, name_prefix_));
   }
 }
 
 void ThreadPool::Schedule(std::function<void()> callback) {
   mutex_.Lock();
   tasks_.push_back(std::move(callback));
+  UpdateNumIdleThreads();
   condition_.Signal();
   mutex_.Unlock();
 }
 
+void ThreadPool::ScheduleBatch(int count,
+                               const std::function<void()>& callback) {
+  if (count <= 0) return;
+  mutex_.Lock();
+  for (int i = 0; i < count; ++i) {
+    tasks_.push_back(callback);
+  }
+  UpdateNumIdleThreads();
+  if (count >= num_waiting_threads_) {
+    condition_.SignalAll();
+  } else {
+    for (int i = 0; i < count; ++i) {
+      condition_.Signal();
+    }
+  }
+  mutex_.Unlock();
+}
+
 int ThreadPool::num_threads() const { return num_threads_; }
 
+void ThreadPool::UpdateNumIdleThreads() {
+  num_idle_threads_.store(
+      std::max(0, num_waiting_threads_ - static_cast<int>(tasks_.size())),
+      std::memory_order_relaxed);
+}
+
 void ThreadPool::RunWorker() {
   mutex_.Lock();
   while (true) {
     if (!tasks_.empty()) {
       std::function<void()> task = std::move(tasks_.front());
       tasks_.pop_front();
+      UpdateNumIdleThreads();
       mutex_.Unlock();
       task();
       mutex_.Lock();
@@ -131,7 +161,11 @@ void ThreadPool::RunWorker() {
       if (stopped_) {
         break;
       } else {
+        ++num_waiting_threads_;
+        UpdateNumIdleThreads();
         condition_.Wait(&mutex_);
+        --num_waiting_threads_;
+        UpdateNumIdleThreads();
       }
     }
   }
@@ -69,6 +69,24 @@ TEST(ThreadPoolTest, MultiThreads) {
   EXPECT_EQ(0, n);
 }
 
+TEST(ThreadPoolTest, ScheduleBatch) {
+  absl::Mutex mu;
+  int n = 100;
+  {
+    ThreadPool thread_pool("testpool", 10);
+    thread_pool.StartWorkers();
+    thread_pool.ScheduleBatch(0, [] {});
+    for (int i = 0; i < 10; ++i) {
+      thread_pool.ScheduleBatch(10, [&n, &mu]() {
+        absl::MutexLock l(&mu);
+        --n;
+      });
+    }
+  }
+
+  EXPECT_EQ(0, n);
+}
+
 TEST(ThreadPoolTest, CreateWithThreadOptions) {
   ThreadPool thread_pool(ThreadOptions(), "testpool", 10);
   ASSERT_EQ(10, thread_pool.num_threads());
@@ -91,6 +109,30 @@ TEST(ThreadPoolTest, CreateWithCPUAffinity) {
   thread_pool.StartWorkers();
 }
 
+TEST(ThreadPoolTest, CreateWithPerWorkerCPUAffinity) {
+  ThreadOptions thread_options =
+      ThreadOptions().set_cpu_set({0, 1}).set_worker_cpu_sets({{0}, {1}});
+  EXPECT_EQ(std::set<int>({0}), thread_options.cpu_set_for_worker(0));
+  EXPECT_EQ(std::set<int>({1}), thread_options.cpu_set_for_worker(1));
+  EXPECT_EQ(std::set<int>({0}), thread_options.cpu_set_for_worker(4));
+  EXPECT_EQ(std::set<int>({0, 1}),
+            ThreadOptions().set_cpu_set({0, 1}).cpu_set_for_worker(3));
+
+  absl::Mutex mu;
+  int n = 100;
+  {
+    ThreadPool thread_pool(thread_options, "testpool", 4);
+    thread_pool.StartWorkers();
+    for (int i = 0; i < 100; ++i) {
+      thread_pool.Schedule([&n, &mu]() mutable {
+        absl::MutexLock l(&mu);
+        --n;
+      });
+    }
+  }
+  EXPECT_EQ(0, n);
+}
+
 TEST(ThreadPoolTest, CreateThreadName) {
   ASSERT_EQ("name_prefix/123", internal::CreateThreadName("name_prefix", 1234));
   ASSERT_EQ("name_prefix/123",
@@ -0,0 +1,135 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_DEPS_WORK_STEALING_DEQUE_H_
+#define MEDIAPIPE_DEPS_WORK_STEALING_DEQUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+
+namespace mediapipe {
+
+// A bounded, lock-free, single-owner/multi-thief deque of pointers, after
+// Chase and Lev, "Dynamic Circular Work-Stealing Deque" (SPAA 2005) with the
+// memory orderings of Le et al., "Correct and Efficient Work-Stealing for
+// Weak Memory Models" (PPoPP 2013).
+//
+// Only the owning thread may call Push() and Pop(), which operate on the
+// bottom of the deque. Any thread may call Steal(), which takes from the top.
+// The capacity is fixed; Push() returns false when the deque is full and the
+// caller is expected to fall back to some other queue.
+//
+// The deque does not own the pointed-to objects.
+template <typename T>
+class WorkStealingDeque {
+ public:
+  // "capacity" is rounded up to a power of two.
+  explicit WorkStealingDeque(size_t capacity)
+      : capacity_(RoundUpToPowerOfTwo(capacity)),
+        mask_(capacity_ - 1),
+        buffer_(new std::atomic<T*>[capacity_]) {
+    for (size_t i = 0; i < capacity_; ++i) {
+      buffer_[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+  WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+  // Owner only. Pushes "item" onto the bottom of the deque. Returns false if
+  // the deque is full.
+  bool Push(T* item) {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    int64_t top = top_.load(std::memory_order_acquire);
+    if (bottom - top >= static_cast<int64_t>(capacity_)) {
+      return false;
+    }
+    buffer_[bottom & mask_].store(item, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Owner only. Pops the most recently pushed item, or returns nullptr if the
+  // deque is empty.
+  T* Pop() {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+    if (top > bottom) {
+      // The deque was already empty.
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    T* item = buffer_[bottom & mask_].load(std::memory_order_relaxed);
+    if (top == bottom) {
+      // Last item: race against thieves for it.
+      if (!top_.compare_exchange_strong(top, top + 1,
+                                        std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        item = nullptr;
+      }
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return item;
+  }
+
+  // Any thread. Takes the least recently pushed item, or returns nullptr if
+  // the deque is empty or another thread won the race for the item.
+  T* Steal() {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = bottom_.load(std::memory_order_acquire);
+    if (top >= bottom) {
+      return nullptr;
+    }
+    T* item = buffer_[top & mask_].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return item;
+  }
+
+  // Any thread. A snapshot that may be stale by the time it is returned.
+  bool IsEmpty() const {
+    int64_t top = top_.load(std::memory_order_acquire);
+    int64_t bottom = bottom_.load(std::memory_order_acquire);
+    return top >= bottom;
+  }
+
+  size_t capacity() const { return capacity_; }
+
+ private:
+  static size_t RoundUpToPowerOfTwo(size_t n) {
+    size_t result = 1;
+    while (result < n) result <<= 1;
+    return result;
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<std::atomic<T*>[]> buffer_;
+  // top_ and bottom_ are written by different threads, so keep them on
+  // separate cache lines.
+  alignas(64) std::atomic<int64_t> top_{0};
+  alignas(64) std::atomic<int64_t> bottom_{0};
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_DEPS_WORK_STEALING_DEQUE_H_
@@ -0,0 +1,209 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/deps/work_stealing_threadpool.h"
+
+#include <utility>
+
+#include "absl/memory/memory.h"
+
+namespace mediapipe {
+
+namespace {
+
+// The pool and worker index of the current thread, if it is a worker thread
+// of some WorkStealingThreadPool.
+thread_local const void* current_pool = nullptr;
+thread_local int current_worker_index = -1;
+
+}  // namespace
+
+constexpr int WorkStealingThreadPool::kDefaultLocalQueueCapacity;
+
+WorkStealingThreadPool::WorkStealingThreadPool(const std::string& name_prefix,
+                                               int num_threads)
+    : WorkStealingThreadPool(ThreadOptions(), name_prefix, num_threads) {}
+
+WorkStealingThreadPool::WorkStealingThreadPool(
+    const ThreadOptions& thread_options, const std::string& name_prefix,
+    int num_threads)
+    : threads_(thread_options, name_prefix, num_threads) {
+  for (int i = 0; i < threads_.num_threads(); ++i) {
+    workers_.push_back(absl::make_unique<Worker>(kDefaultLocalQueueCapacity));
+    // Any non-zero seed works for xorshift.
+    workers_.back()->rng_state = 2654435761u * (i + 1);
+  }
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+  {
+    absl::MutexLock lock(&mutex_);
+    stopped_ = true;
+    condition_.SignalAll();
+  }
+  // threads_ is destroyed first and joins the workers, which drain all
+  // remaining tasks before exiting.
+}
+
+void WorkStealingThreadPool::StartWorkers() {
+  threads_.StartWorkers();
+  for (int i = 0; i < threads_.num_threads(); ++i) {
+    threads_.Schedule([this, i] { RunWorker(i); });
+  }
+}
+
+void WorkStealingThreadPool::Schedule(std::function<void()> callback) {
+  Task* task = new Task(std::move(callback));
+  if (current_pool == this &&
+      workers_[current_worker_index]->tasks.Push(task)) {
+    // Pairs with the fence in HasPendingTasks(): either a worker going to
+    // sleep sees the new task, or we see that worker's sleeping count.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (num_sleeping_workers_.load(std::memory_order_relaxed) > 0) {
+      WakeWorkers(1);
+    }
+    return;
+  }
+  absl::MutexLock lock(&mutex_);
+  injected_tasks_.push_back(task);
+  num_injected_tasks_.fetch_add(1, std::memory_order_relaxed);
+  condition_.Signal();
+}
+
+void WorkStealingThreadPool::ScheduleBatch(
+    int count, const std::function<void()>& callback) {
+  if (count <= 0) return;
+  int num_pushed = 0;
+  std::unique_ptr<Task> task;
+  if (current_pool == this) {
+    Worker* self = workers_[current_worker_index].get();
+    while (num_pushed < count) {
+      task = absl::make_unique<Task>(callback);
+      if (!self->tasks.Push(task.get())) break;
+      task.release();
+      ++num_pushed;
+    }
+    if (num_pushed > 0) {
+      // See Schedule().
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (num_sleeping_workers_.load(std::memory_order_relaxed) > 0) {
+        WakeWorkers(num_pushed);
+      }
+    }
+    if (num_pushed == count) {
+      return;
+    }
+  }
+  // The remaining tasks, including one that did not fit into a full local
+  // deque, go to the injection queue.
+  const int num_injected = count - num_pushed;
+  absl::MutexLock lock(&mutex_);
+  if (task) {
+    injected_tasks_.push_back(task.release());
+    ++num_pushed;
+  }
+  for (; num_pushed < count; ++num_pushed) {
+    injected_tasks_.push_back(new Task(callback));
+  }
+  num_injected_tasks_.fetch_add(num_injected, std::memory_order_relaxed);
+  SignalWorkers(num_injected);
+}
+
+void WorkStealingThreadPool::WakeWorkers(int count) {
+  absl::MutexLock lock(&mutex_);
+  SignalWorkers(count);
+}
+
+void WorkStealingThreadPool::SignalWorkers(int count) {
+  if (count >= num_sleeping_workers_.load(std::memory_order_relaxed)) {
+    condition_.SignalAll();
+  } else {
+    for (int i = 0; i < count; ++i) {
+      condition_.Signal();
+    }
+  }
+}
+
+WorkStealingThreadPool::Task* WorkStealingThreadPool::FindTask(int index) {
+  Worker* self = workers_[index].get();
+  if (Task* task = self->tasks.Pop()) {
+    return task;
+  }
+  if (num_injected_tasks_.load(std::memory_order_relaxed) > 0) {
+    absl::MutexLock lock(&mutex_);
+    if (!injected_tasks_.empty()) {
+      Task* task = injected_tasks_.front();
+      injected_tasks_.pop_front();
+      num_injected_tasks_.fetch_sub(1, std::memory_order_relaxed);
+      return task;
+    }
+  }
+  const int num_workers = workers_.size();
+  if (num_workers == 1) {
+    return nullptr;
+  }
+  // Start stealing at a random victim so that thieves spread out.
+  uint32_t x = self->rng_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  self->rng_state = x;
+  const int start = x % num_workers;
+  for (int i = 0; i < num_workers; ++i) {
+    const int victim = (start + i) % num_workers;
+    if (victim == index) continue;
+    if (Task* task = workers_[victim]->tasks.Steal()) {
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+bool WorkStealingThreadPool::HasPendingTasks() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!injected_tasks_.empty()) {
+    return true;
+  }
+  for (const auto& worker : workers_) {
+    if (!worker->tasks.IsEmpty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingThreadPool::RunWorker(int index) {
+  current_pool = this;
+  current_worker_index = index;
+  while (true) {
+    if (Task* task = FindTask(index)) {
+      (*task)();
+      delete task;
+      continue;
+    }
+    absl::MutexLock lock(&mutex_);
+    num_sleeping_workers_.fetch_add(1, std::memory_order_seq_cst);
+    while (!stopped_ && !HasPendingTasks()) {
+      condition_.Wait(&mutex_);
+    }
+    num_sleeping_workers_.fetch_sub(1, std::memory_order_relaxed);
+    if (stopped_ && !HasPendingTasks()) {
+      break;
+    }
+  }
+  current_pool = nullptr;
+  current_worker_index = -1;
+}
+
+}  // namespace mediapipe
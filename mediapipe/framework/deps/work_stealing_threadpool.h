@@ -0,0 +1,133 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_DEPS_WORK_STEALING_THREADPOOL_H_
+#define MEDIAPIPE_DEPS_WORK_STEALING_THREADPOOL_H_
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/deps/thread_options.h"
+#include "mediapipe/framework/deps/threadpool.h"
+#include "mediapipe/framework/deps/work_stealing_deque.h"
+
+namespace mediapipe {
+
+// A thread pool in which every worker owns a lock-free task deque.
+//
+// Callbacks scheduled from one of the pool's own worker threads are pushed
+// onto that worker's deque without taking any lock. Callbacks scheduled from
+// any other thread go to a shared, mutex-guarded injection queue. A worker
+// runs its own tasks first, then the injection queue, then steals from the
+// other workers; it only blocks on the pool mutex when all of them are empty.
+//
+// Unlike ThreadPool, callbacks are not run in FIFO order, even with a single
+// thread. The interface otherwise mirrors ThreadPool.
+class WorkStealingThreadPool {
+ public:
+  // Capacity of each worker's deque. Tasks that do not fit spill over into
+  // the injection queue.
+  static constexpr int kDefaultLocalQueueCapacity = 1024;
+
+  WorkStealingThreadPool(const std::string& name_prefix, int num_threads);
+  WorkStealingThreadPool(const ThreadOptions& thread_options,
+                         const std::string& name_prefix, int num_threads);
+  WorkStealingThreadPool(const WorkStealingThreadPool&) = delete;
+  WorkStealingThreadPool& operator=(const WorkStealingThreadPool&) = delete;
+
+  // Waits for closures (if any) to complete. May be called without
+  // having called StartWorkers().
+  ~WorkStealingThreadPool();
+
+  // REQUIRES: StartWorkers has not been called
+  // Actually start the worker threads.
+  void StartWorkers();
+
+  // REQUIRES: StartWorkers has been called
+  // Add specified callback to the calling worker's deque, or to the shared
+  // injection queue if the caller is not one of this pool's workers.
+  void Schedule(std::function<void()> callback);
+
+  // REQUIRES: StartWorkers has been called
+  // Add "count" copies of the specified callback, like Schedule(). Tasks that
+  // go to the injection queue are added under one lock, and at most "count"
+  // sleeping workers are woken up.
+  void ScheduleBatch(int count, const std::function<void()>& callback);
+
+  // Provided for debugging and testing only.
+  int num_threads() const { return threads_.num_threads(); }
+
+  // Returns the number of workers waiting for callbacks, which may already be
+  // out of date.
+  int num_idle_threads() const {
+    return num_sleeping_workers_.load(std::memory_order_relaxed);
+  }
+
+  // Standard thread options.  Use this accessor to get them.
+  const ThreadOptions& thread_options() const {
+    return threads_.thread_options();
+  }
+
+ private:
+  using Task = std::function<void()>;
+
+  struct Worker {
+    explicit Worker(size_t capacity) : tasks(capacity) {}
+    WorkStealingDeque<Task> tasks;
+    // State of the xorshift generator used to pick steal victims.
+    uint32_t rng_state = 0;
+  };
+
+  // Body of worker thread "index". Returns once the pool is stopped and no
+  // tasks remain.
+  void RunWorker(int index);
+
+  // Returns the next task for worker "index", or nullptr if none was found.
+  Task* FindTask(int index);
+
+  // Returns true if any queue appears to be non-empty.
+  bool HasPendingTasks() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Wakes up "count" sleeping workers, or all of them if there are fewer.
+  void WakeWorkers(int count);
+
+  // Signals "count" workers blocked on condition_.
+  void SignalWorkers(int count) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  absl::Mutex mutex_;
+  absl::CondVar condition_;
+  bool stopped_ ABSL_GUARDED_BY(mutex_) = false;
+  std::deque<Task*> injected_tasks_ ABSL_GUARDED_BY(mutex_);
+  // Mirrors injected_tasks_.size() so that workers can skip the mutex when
+  // the injection queue is empty.
+  std::atomic<int> num_injected_tasks_{0};
+  // The number of workers blocked (or about to block) on condition_.
+  std::atomic<int> num_sleeping_workers_{0};
+
+  // Hosts one long-running RunWorker() loop per thread, and takes care of
+  // thread naming, priority and affinity. Declared last so that its
+  // destructor joins the worker threads before the state above goes away.
+  ThreadPool threads_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_DEPS_WORK_STEALING_THREADPOOL_H_
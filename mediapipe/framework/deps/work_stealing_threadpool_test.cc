@@ -0,0 +1,247 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/deps/work_stealing_threadpool.h"
+
+#include <atomic>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/synchronization/blocking_counter.h"
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/deps/threadpool.h"
+#include "mediapipe/framework/deps/work_stealing_deque.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+
+namespace mediapipe {
+namespace {
+
+TEST(WorkStealingDequeTest, PushPopIsLifo) {
+  int items[3] = {0, 1, 2};
+  WorkStealingDeque<int> deque(4);
+  EXPECT_TRUE(deque.IsEmpty());
+  for (int& item : items) {
+    ASSERT_TRUE(deque.Push(&item));
+  }
+  EXPECT_EQ(&items[2], deque.Pop());
+  EXPECT_EQ(&items[1], deque.Pop());
+  EXPECT_EQ(&items[0], deque.Pop());
+  EXPECT_EQ(nullptr, deque.Pop());
+  EXPECT_TRUE(deque.IsEmpty());
+}
+
+TEST(WorkStealingDequeTest, StealIsFifo) {
+  int items[3] = {0, 1, 2};
+  WorkStealingDeque<int> deque(4);
+  for (int& item : items) {
+    ASSERT_TRUE(deque.Push(&item));
+  }
+  EXPECT_EQ(&items[0], deque.Steal());
+  EXPECT_EQ(&items[2], deque.Pop());
+  EXPECT_EQ(&items[1], deque.Steal());
+  EXPECT_EQ(nullptr, deque.Steal());
+}
+
+TEST(WorkStealingDequeTest, PushFailsWhenFull) {
+  int items[5] = {0, 1, 2, 3, 4};
+  WorkStealingDeque<int> deque(3);
+  ASSERT_EQ(4, deque.capacity());
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(deque.Push(&items[i]));
+  }
+  EXPECT_FALSE(deque.Push(&items[4]));
+  EXPECT_EQ(&items[0], deque.Steal());
+  EXPECT_TRUE(deque.Push(&items[4]));
+}
+
+// Every pushed item must be taken exactly once, by either the owner or one of
+// the thieves.
+TEST(WorkStealingDequeTest, ConcurrentStealTakesEachItemOnce) {
+  constexpr int kNumItems = 100000;
+  constexpr int kNumThieves = 4;
+  std::vector<int> items(kNumItems);
+  std::vector<std::atomic<int>> taken(kNumItems);
+  for (auto& count : taken) count.store(0);
+  WorkStealingDeque<int> deque(256);
+  std::atomic<bool> done(false);
+
+  std::vector<std::thread> thieves;
+  for (int t = 0; t < kNumThieves; ++t) {
+    thieves.emplace_back([&] {
+      while (!done.load() || !deque.IsEmpty()) {
+        if (int* item = deque.Steal()) {
+          taken[item - items.data()].fetch_add(1);
+        }
+      }
+    });
+  }
+  for (int i = 0; i < kNumItems; ++i) {
+    while (!deque.Push(&items[i])) {
+      if (int* item = deque.Pop()) {
+        taken[item - items.data()].fetch_add(1);
+      }
+    }
+    if (i % 3 == 0) {
+      if (int* item = deque.Pop()) {
+        taken[item - items.data()].fetch_add(1);
+      }
+    }
+  }
+  done.store(true);
+  for (auto& thief : thieves) thief.join();
+  while (int* item = deque.Pop()) {
+    taken[item - items.data()].fetch_add(1);
+  }
+  for (int i = 0; i < kNumItems; ++i) {
+    ASSERT_EQ(1, taken[i].load()) << "item " << i;
+  }
+}
+
+TEST(WorkStealingThreadPoolTest, DestroyWithoutStart) {
+  WorkStealingThreadPool thread_pool("testpool", 10);
+}
+
+TEST(WorkStealingThreadPoolTest, EmptyThread) {
+  WorkStealingThreadPool thread_pool("testpool", 0);
+  ASSERT_EQ(1, thread_pool.num_threads());
+  thread_pool.StartWorkers();
+}
+
+TEST(WorkStealingThreadPoolTest, SingleThread) {
+  absl::Mutex mu;
+  int n = 100;
+  {
+    WorkStealingThreadPool thread_pool("testpool", 1);
+    ASSERT_EQ(1, thread_pool.num_threads());
+    thread_pool.StartWorkers();
+
+    for (int i = 0; i < 100; ++i) {
+      thread_pool.Schedule([&n, &mu]() mutable {
+        absl::MutexLock l(&mu);
+        --n;
+      });
+    }
+  }
+
+  EXPECT_EQ(0, n);
+}
+
+TEST(WorkStealingThreadPoolTest, MultiThreads) {
+  absl::Mutex mu;
+  int n = 100;
+  {
+    WorkStealingThreadPool thread_pool("testpool", 10);
+    ASSERT_EQ(10, thread_pool.num_threads());
+    thread_pool.StartWorkers();
+
+    for (int i = 0; i < 100; ++i) {
+      thread_pool.Schedule([&n, &mu]() mutable {
+        absl::MutexLock l(&mu);
+        --n;
+      });
+    }
+  }
+
+  EXPECT_EQ(0, n);
+}
+
+// Tasks scheduled from worker threads go to the local deques, including ones
+// that overflow them, and must all run before the pool is destroyed.
+TEST(WorkStealingThreadPoolTest, ScheduleFromWorkers) {
+  constexpr int kFanOut = 4 * WorkStealingThreadPool::kDefaultLocalQueueCapacity;
+  std::atomic<int> n(0);
+  {
+    WorkStealingThreadPool thread_pool("testpool", 4);
+    thread_pool.StartWorkers();
+    for (int i = 0; i < 8; ++i) {
+      thread_pool.Schedule([&thread_pool, &n]() {
+        for (int j = 0; j < kFanOut; ++j) {
+          thread_pool.Schedule([&n]() { n.fetch_add(1); });
+        }
+      });
+    }
+  }
+  EXPECT_EQ(8 * kFanOut, n.load());
+}
+
+// Batches scheduled from worker threads overflow the local deques, and ones
+// scheduled from other threads go to the injection queue.
+TEST(WorkStealingThreadPoolTest, ScheduleBatch) {
+  constexpr int kBatchSize =
+      3 * WorkStealingThreadPool::kDefaultLocalQueueCapacity / 2;
+  std::atomic<int> n(0);
+  {
+    WorkStealingThreadPool thread_pool("testpool", 4);
+    thread_pool.StartWorkers();
+    thread_pool.ScheduleBatch(0, [] {});
+    thread_pool.ScheduleBatch(8, [&thread_pool, &n]() {
+      thread_pool.ScheduleBatch(kBatchSize, [&n]() { n.fetch_add(1); });
+    });
+  }
+  EXPECT_EQ(8 * kBatchSize, n.load());
+}
+
+TEST(WorkStealingThreadPoolTest, CreateWithThreadOptions) {
+  ThreadOptions thread_options = ThreadOptions().set_nice_priority_level(-10);
+  WorkStealingThreadPool thread_pool(thread_options, "testpool", 10);
+  ASSERT_EQ(10, thread_pool.num_threads());
+  ASSERT_EQ(-10, thread_pool.thread_options().nice_priority_level());
+  thread_pool.StartWorkers();
+}
+
+// Models the scheduler: each task run on a worker submits follow-up tasks
+// from that worker, until a fixed number of tasks has run.
+template <typename Pool>
+void RunFanOut(Pool* pool, int num_roots, int depth,
+               absl::BlockingCounter* counter) {
+  std::function<void(int)> task = [&](int level) {
+    if (level < depth) {
+      pool->Schedule([&task, level] { task(level + 1); });
+      pool->Schedule([&task, level] { task(level + 1); });
+    } else {
+      counter->DecrementCount();
+    }
+  };
+  for (int i = 0; i < num_roots; ++i) {
+    pool->Schedule([&task] { task(0); });
+  }
+  counter->Wait();
+}
+
+template <typename Pool>
+void BM_FanOut(benchmark::State& state) {
+  constexpr int kNumRoots = 16;
+  constexpr int kDepth = 8;
+  Pool pool("bench", state.range(0));
+  pool.StartWorkers();
+  for (auto _ : state) {
+    absl::BlockingCounter counter(kNumRoots << kDepth);
+    RunFanOut(&pool, kNumRoots, kDepth, &counter);
+  }
+  // Each root spawns a full binary tree of tasks.
+  state.SetItemsProcessed(state.iterations() * kNumRoots *
+                          ((2 << kDepth) - 1));
+}
+BENCHMARK_TEMPLATE(BM_FanOut, ThreadPool)
+    ->RangeMultiplier(2)
+    ->Range(1, 32)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_FanOut, WorkStealingThreadPool)
+    ->RangeMultiplier(2)
+    ->Range(1, 32)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace mediapipe
@@ -35,8 +35,8 @@ class TaskQueue {
   virtual ~TaskQueue();
 
   // Runs the next ready task in the current thread. Should be invoked by the
-  // executor. This method should be called exactly as many times as AddTask
-  // was called on the executor.
+  // executor. This method should be called exactly as many times as tasks
+  // were added with AddTask and AddTasks on the executor.
   virtual void RunNextTask() = 0;
 };
 
@@ -61,6 +61,24 @@ class Executor {
     Schedule([task_queue] { task_queue->RunNextTask(); });
   }
 
+  // Like calling AddTask "count" times. The scheduler queue calls this method
+  // when several nodes become ready at once. Executors with a shared task
+  // queue should override it to enqueue all the tasks under one lock and wake
+  // up no more idle threads than needed.
+  virtual void AddTasks(TaskQueue* task_queue, int count) {
+    for (int i = 0; i < count; ++i) {
+      AddTask(task_queue);
+    }
+  }
+
+  // Returns true if some of the executor's threads are waiting for tasks.
+  // While a node runs, the scheduler queue submits the tasks of the nodes it
+  // makes ready right away if this is true, so that idle threads start on
+  // them immediately. Otherwise it defers them and submits them with one
+  // AddTasks call once the node is done. Executors that cannot tell return
+  // true, so that no task is deferred.
+  virtual bool HasIdleThreads() const { return true; }
+
   // Schedule the specified "task" for execution in this executor.
   virtual void Schedule(std::function<void()> task) = 0;
 };
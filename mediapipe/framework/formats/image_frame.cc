@@ -126,7 +126,7 @@ void ImageFrame::AdoptPixelData(ImageFormat::Format format, int width,
   CHECK_NE(ImageFormat::UNKNOWN, format_);
   CHECK_GE(width_step_, width * NumberOfChannels() * ByteDepth());
 
-  pixel_data_ = {pixel_data, deleter};
+  pixel_data_ = {pixel_data, std::move(deleter)};
 }
 
 std::unique_ptr<uint8[], ImageFrame::Deleter> ImageFrame::Release() {
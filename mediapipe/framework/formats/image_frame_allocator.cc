@@ -0,0 +1,311 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/formats/image_frame_allocator.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "mediapipe/framework/port/aligned_malloc_and_free.h"
+#include "mediapipe/framework/port/logging.h"
+
+namespace mediapipe {
+
+namespace {
+
+// Returns the index of the highest set bit of a positive value.
+inline int Log2Floor(uint64 value) {
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll(value);
+#else
+  int result = 0;
+  while (value >>= 1) {
+    ++result;
+  }
+  return result;
+#endif
+}
+
+// A counter that reads one of the Stats of an ImageFrameAllocator.
+class StatsCounter : public Counter {
+ public:
+  StatsCounter(std::weak_ptr<const ImageFrameAllocator> allocator,
+               int64 ImageFrameAllocator::Stats::*statistic)
+      : allocator_(std::move(allocator)), statistic_(statistic) {}
+
+  void Increment() override {}
+  void IncrementBy(int amount) override {}
+  int64 Get() override {
+    auto allocator = allocator_.lock();
+    return allocator ? allocator->GetStats().*statistic_ : 0;
+  }
+
+ private:
+  const std::weak_ptr<const ImageFrameAllocator> allocator_;
+  int64 ImageFrameAllocator::Stats::*const statistic_;
+};
+
+// Raises peak to at least value.
+void UpdatePeak(std::atomic<int64>* peak, int64 value) {
+  int64 current = peak->load(std::memory_order_relaxed);
+  while (value > current &&
+         !peak->compare_exchange_weak(current, value,
+                                      std::memory_order_relaxed)) {
+  }
+}
+
+}  // namespace
+
+const GraphService<ImageFrameAllocator> kImageFrameAllocatorService(
+    "kImageFrameAllocatorService");
+
+constexpr int ImageFrameAllocator::kSizeClassBits;
+constexpr int64 ImageFrameAllocator::kMinSizeClassBytes;
+constexpr uint32 ImageFrameAllocator::kBufferAlignment;
+constexpr int ImageFrameAllocator::kShardCacheCount;
+constexpr int ImageFrameAllocator::kNumShards;
+constexpr int64 ImageFrameAllocator::kHighWaterWindow;
+
+ImageFrameAllocator::ImageFrameAllocator(const Options& options)
+    : options_(options) {}
+
+ImageFrameAllocator::~ImageFrameAllocator() { Flush(); }
+
+std::unique_ptr<ImageFrame> ImageFrameAllocator::NewImageFrame(
+    ImageFormat::Format format, int width, int height,
+    uint32 alignment_boundary) {
+  auto frame = absl::make_unique<ImageFrame>();
+  Reset(frame.get(), format, width, height, alignment_boundary);
+  return frame;
+}
+
+void ImageFrameAllocator::Reset(ImageFrame* frame, ImageFormat::Format format,
+                                int width, int height,
+                                uint32 alignment_boundary) {
+  CHECK_NE(ImageFormat::UNKNOWN, format);
+  CHECK(alignment_boundary > 0 &&
+        (alignment_boundary & (alignment_boundary - 1)) == 0)
+      << "Invalid alignment boundary: " << alignment_boundary;
+  // Release the current pixel data, so that it can be reused right away.
+  *frame = ImageFrame();
+  if (alignment_boundary > kBufferAlignment) {
+    frame->Reset(format, width, height, alignment_boundary);
+    return;
+  }
+  int width_step = width * ImageFrame::NumberOfChannelsForFormat(format) *
+                   ImageFrame::ByteDepthForFormat(format);
+  if (alignment_boundary > 1) {
+    // Round up to a multiple of alignment_boundary, as in ImageFrame::Reset.
+    width_step = ((width_step - 1) | (alignment_boundary - 1)) + 1;
+  }
+  const int64 capacity = SizeClassBytes(int64{height} * width_step);
+  uint8* data = GetBuffer(capacity);
+  std::weak_ptr<ImageFrameAllocator> weak_allocator(shared_from_this());
+  frame->AdoptPixelData(format, width, height, width_step, data,
+                        [weak_allocator, capacity](uint8* data) {
+                          auto allocator = weak_allocator.lock();
+                          if (allocator) {
+                            allocator->Release(data, capacity);
+                          } else {
+                            aligned_free(data);
+                          }
+                        });
+}
+
+uint8* ImageFrameAllocator::GetBuffer(int64 capacity) {
+  UpdatePeak(&window_peak_bytes_,
+             in_use_bytes_.fetch_add(capacity, std::memory_order_relaxed) +
+                 capacity);
+  uint8* data = nullptr;
+  {
+    Shard* shard = CurrentShard();
+    absl::MutexLock lock(&shard->mutex);
+    auto iter = shard->buffers.find(capacity);
+    if (iter != shard->buffers.end() && !iter->second.empty()) {
+      data = iter->second.back();
+      iter->second.pop_back();
+    }
+  }
+  if (!data) {
+    absl::MutexLock lock(&mutex_);
+    auto iter = buffers_.find(capacity);
+    if (iter != buffers_.end()) {
+      // Reuse the most recently used buffer, which is the most likely to be
+      // still cached by the CPU.
+      data = iter->second.back().data;
+      iter->second.pop_back();
+      if (iter->second.empty()) {
+        buffers_.erase(iter);
+      }
+    }
+  }
+  if (data) {
+    cached_bytes_.fetch_sub(capacity, std::memory_order_relaxed);
+    reuse_count_.fetch_add(1, std::memory_order_relaxed);
+    return data;
+  }
+  data = reinterpret_cast<uint8*>(aligned_malloc(capacity, kBufferAlignment));
+  CHECK(data) << "Failed to allocate " << capacity << " bytes.";
+  allocation_count_.fetch_add(1, std::memory_order_relaxed);
+  return data;
+}
+
+void ImageFrameAllocator::Release(uint8* data, int64 capacity) {
+  const int64 in_use =
+      in_use_bytes_.fetch_sub(capacity, std::memory_order_relaxed) - capacity;
+  const int64 cached_bytes =
+      cached_bytes_.fetch_add(capacity, std::memory_order_relaxed) + capacity;
+  const int64 release_tick =
+      release_count_.fetch_add(1, std::memory_order_relaxed) + 1;
+  const bool new_window = release_tick % kHighWaterWindow == 0;
+  if (new_window) {
+    // Start a new window, which forgets the peak of the window before last.
+    last_window_peak_bytes_.store(
+        window_peak_bytes_.exchange(in_use, std::memory_order_relaxed),
+        std::memory_order_relaxed);
+  }
+  bool cached_in_shard = false;
+  if (cached_bytes <= options_.max_cached_bytes) {
+    Shard* shard = CurrentShard();
+    absl::MutexLock lock(&shard->mutex);
+    std::vector<uint8*>& cached = shard->buffers[capacity];
+    if (cached.size() < kShardCacheCount) {
+      cached.push_back(data);
+      cached_in_shard = true;
+    }
+  }
+  // The central buffers are also trimmed when the high-water mark may have
+  // dropped, even if no buffers are released to them.
+  if (cached_in_shard && !new_window) {
+    return;
+  }
+  std::vector<uint8*> trimmed;
+  {
+    absl::MutexLock lock(&mutex_);
+    if (!cached_in_shard) {
+      buffers_[capacity].push_back({data, release_tick});
+    }
+    Trim(&trimmed);
+  }
+  // The trimmed buffers are freed without holding the lock.
+  for (uint8* buffer : trimmed) {
+    aligned_free(buffer);
+  }
+  trim_count_.fetch_add(trimmed.size(), std::memory_order_relaxed);
+}
+
+ImageFrameAllocator::Shard* ImageFrameAllocator::CurrentShard() {
+  return &shards_[std::hash<std::thread::id>()(std::this_thread::get_id()) %
+                  kNumShards];
+}
+
+int64 ImageFrameAllocator::HighWaterBytes() const {
+  return std::max(window_peak_bytes_.load(std::memory_order_relaxed),
+                  last_window_peak_bytes_.load(std::memory_order_relaxed));
+}
+
+void ImageFrameAllocator::Trim(std::vector<uint8*>* trimmed) {
+  const int64 limit = std::min(
+      options_.max_cached_bytes,
+      std::max<int64>(HighWaterBytes() -
+                          in_use_bytes_.load(std::memory_order_relaxed),
+                      0));
+  while (cached_bytes_.load(std::memory_order_relaxed) > limit &&
+         !buffers_.empty()) {
+    // Find the size class holding the least recently used buffer.
+    auto lru = buffers_.begin();
+    for (auto iter = buffers_.begin(); iter != buffers_.end(); ++iter) {
+      if (iter->second.front().release_tick <
+          lru->second.front().release_tick) {
+        lru = iter;
+      }
+    }
+    trimmed->push_back(lru->second.front().data);
+    lru->second.pop_front();
+    cached_bytes_.fetch_sub(lru->first, std::memory_order_relaxed);
+    if (lru->second.empty()) {
+      buffers_.erase(lru);
+    }
+  }
+}
+
+void ImageFrameAllocator::Flush() {
+  std::vector<uint8*> flushed;
+  int64 flushed_bytes = 0;
+  for (Shard& shard : shards_) {
+    absl::MutexLock lock(&shard.mutex);
+    for (auto& entry : shard.buffers) {
+      flushed.insert(flushed.end(), entry.second.begin(), entry.second.end());
+      flushed_bytes += entry.first * entry.second.size();
+    }
+    shard.buffers.clear();
+  }
+  {
+    absl::MutexLock lock(&mutex_);
+    for (auto& entry : buffers_) {
+      for (const CachedBuffer& buffer : entry.second) {
+        flushed.push_back(buffer.data);
+      }
+      flushed_bytes += entry.first * entry.second.size();
+    }
+    buffers_.clear();
+  }
+  for (uint8* buffer : flushed) {
+    aligned_free(buffer);
+  }
+  cached_bytes_.fetch_sub(flushed_bytes, std::memory_order_relaxed);
+  trim_count_.fetch_add(flushed.size(), std::memory_order_relaxed);
+}
+
+ImageFrameAllocator::Stats ImageFrameAllocator::GetStats() const {
+  Stats stats;
+  stats.allocation_count = allocation_count_.load(std::memory_order_relaxed);
+  stats.reuse_count = reuse_count_.load(std::memory_order_relaxed);
+  stats.trim_count = trim_count_.load(std::memory_order_relaxed);
+  stats.in_use_bytes = in_use_bytes_.load(std::memory_order_relaxed);
+  stats.cached_bytes = cached_bytes_.load(std::memory_order_relaxed);
+  stats.high_water_bytes = HighWaterBytes();
+  return stats;
+}
+
+int64 ImageFrameAllocator::SizeClassBytes(int64 size) {
+  if (size <= kMinSizeClassBytes) {
+    return kMinSizeClassBytes;
+  }
+  const int shift = Log2Floor(size - 1) - kSizeClassBits;
+  return (((size - 1) >> shift) + 1) << shift;
+}
+
+void ImageFrameAllocator::RegisterCounters(CounterFactory* counter_factory) {
+  const std::pair<const char*, int64 Stats::*> statistics[] = {
+      {"Allocations", &Stats::allocation_count},
+      {"Reuses", &Stats::reuse_count},
+      {"Trims", &Stats::trim_count},
+      {"In Use Bytes", &Stats::in_use_bytes},
+      {"Cached Bytes", &Stats::cached_bytes},
+      {"High Water Bytes", &Stats::high_water_bytes},
+  };
+  std::weak_ptr<const ImageFrameAllocator> weak_allocator(shared_from_this());
+  for (const auto& statistic : statistics) {
+    counter_factory->GetCounterSet()->Emplace<StatsCounter>(
+        absl::StrCat("ImageFrameAllocator ", statistic.first), weak_allocator,
+        statistic.second);
+  }
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,192 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// This class lets all calculators of a graph allocate ImageFrames of various
+// sizes from one set of cached pixel buffers. Unlike ImageFramePool, which
+// serves one width, height and format, buffers are grouped into size classes
+// by their byte size, so a buffer freed by one resolution or format can be
+// reused by any other frame in the same size class.
+//
+// The allocator is shared through kImageFrameAllocatorService:
+//
+//   auto allocator = ImageFrameAllocator::Create(options);
+//   allocator->RegisterCounters(graph.GetCounterFactory());
+//   graph.SetServiceObject(kImageFrameAllocatorService, allocator);
+//
+// and a calculator that declares cc->UseService(kImageFrameAllocatorService)
+// .Optional() draws its output frames from it when it is available:
+//
+//   if (cc->Service(kImageFrameAllocatorService).IsAvailable()) {
+//     output = cc->Service(kImageFrameAllocatorService).GetObject()
+//                  .NewImageFrame(format, width, height);
+//   }
+
+#ifndef MEDIAPIPE_FRAMEWORK_FORMATS_IMAGE_FRAME_ALLOCATOR_H_
+#define MEDIAPIPE_FRAMEWORK_FORMATS_IMAGE_FRAME_ALLOCATOR_H_
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/counter_factory.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/graph_service.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+class ImageFrameAllocator
+    : public std::enable_shared_from_this<ImageFrameAllocator> {
+ public:
+  struct Options {
+    // The most bytes of unused buffers kept for reuse. Below this limit, the
+    // allocator keeps as many unused bytes as were in use at the recent
+    // high-water mark, less the bytes in use now.
+    int64 max_cached_bytes = int64{256} << 20;
+  };
+
+  // Allocation statistics, which can also be read as graph counters through
+  // RegisterCounters().
+  struct Stats {
+    // Buffers allocated from the system.
+    int64 allocation_count = 0;
+    // Buffers reused from the cache.
+    int64 reuse_count = 0;
+    // Cached buffers released to the system.
+    int64 trim_count = 0;
+    // Bytes in frames that have not been destroyed yet.
+    int64 in_use_bytes = 0;
+    // Bytes in unused buffers kept for reuse.
+    int64 cached_bytes = 0;
+    // The recent high-water mark of in_use_bytes.
+    int64 high_water_bytes = 0;
+  };
+
+  // Creates an allocator.
+  // We enforce creation as a shared_ptr so that we can use a weak reference in
+  // the buffers' deleters.
+  static std::shared_ptr<ImageFrameAllocator> Create(const Options& options) {
+    return std::shared_ptr<ImageFrameAllocator>(
+        new ImageFrameAllocator(options));
+  }
+
+  ~ImageFrameAllocator();
+
+  ImageFrameAllocator(const ImageFrameAllocator&) = delete;
+  ImageFrameAllocator& operator=(const ImageFrameAllocator&) = delete;
+
+  // Returns a frame of the given format and size, whose pixel data is
+  // reused if possible. See the ImageFrame constructor with the same
+  // arguments. The pixel data is not cleared.
+  std::unique_ptr<ImageFrame> NewImageFrame(
+      ImageFormat::Format format, int width, int height,
+      uint32 alignment_boundary = ImageFrame::kDefaultAlignmentBoundary);
+
+  // Like ImageFrame::Reset(), but reuses pixel data if possible. The previous
+  // pixel data of frame is released first, so that it can be reused.
+  void Reset(ImageFrame* frame, ImageFormat::Format format, int width,
+             int height, uint32 alignment_boundary);
+
+  // Releases all cached buffers to the system.
+  void Flush();
+
+  Stats GetStats() const;
+
+  // Adds counters named "ImageFrameAllocator <statistic>" to counter_factory,
+  // such as graph.GetCounterFactory(), which read the current Stats. The
+  // counters hold only a weak reference to the allocator, so the allocator
+  // and the counters can be destroyed in either order.
+  void RegisterCounters(CounterFactory* counter_factory);
+
+  // Returns the capacity of the buffers used for size bytes.
+  static int64 SizeClassBytes(int64 size);
+
+ private:
+  // Each size class spans 1/2^kSizeClassBits of a power of two, so a buffer
+  // wastes less than 1/2^kSizeClassBits of its capacity.
+  static constexpr int kSizeClassBits = 3;
+  // Smaller frames use buffers of this capacity.
+  static constexpr int64 kMinSizeClassBytes = 4096;
+  // Every buffer is aligned to this boundary, which serves all the
+  // alignment boundaries requested by ImageFrames of up to this size.
+  static constexpr uint32 kBufferAlignment = 64;
+  // The number of buffers per size class cached by each shard.
+  static constexpr int kShardCacheCount = 2;
+  // The number of shards, which are selected by thread.
+  static constexpr int kNumShards = 8;
+  // The high-water mark covers the in-use bytes over the last one or two
+  // windows of this many buffer releases.
+  static constexpr int64 kHighWaterWindow = 128;
+
+  // A small cache for the threads mapped to one shard, which avoids the
+  // central lock for frames released and reallocated on the same thread.
+  struct Shard {
+    absl::Mutex mutex;
+    std::unordered_map<int64, std::vector<uint8*>> buffers
+        ABSL_GUARDED_BY(mutex);
+  };
+
+  struct CachedBuffer {
+    uint8* data;
+    // The release_count_ when the buffer was released, which orders the
+    // buffers from least to most recently used.
+    int64 release_tick;
+  };
+
+  explicit ImageFrameAllocator(const Options& options);
+
+  // Returns a buffer of capacity bytes, which may be reused.
+  uint8* GetBuffer(int64 capacity);
+  // Returns a buffer of capacity bytes to the cache.
+  void Release(uint8* data, int64 capacity);
+  // Returns the shard of the calling thread.
+  Shard* CurrentShard();
+
+  // Returns the recent high-water mark of the in-use bytes.
+  int64 HighWaterBytes() const;
+
+  // Releases the least recently used central buffers until the cached bytes
+  // are within the high-water limit.
+  void Trim(std::vector<uint8*>* trimmed) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const Options options_;
+
+  std::atomic<int64> allocation_count_{0};
+  std::atomic<int64> reuse_count_{0};
+  std::atomic<int64> trim_count_{0};
+  std::atomic<int64> in_use_bytes_{0};
+  std::atomic<int64> cached_bytes_{0};
+  std::atomic<int64> release_count_{0};
+  // The peak in-use bytes in the current and the previous window.
+  std::atomic<int64> window_peak_bytes_{0};
+  std::atomic<int64> last_window_peak_bytes_{0};
+
+  Shard shards_[kNumShards];
+
+  absl::Mutex mutex_;
+  // The buffers cached centrally, indexed by capacity, from least to most
+  // recently used.
+  std::map<int64, std::deque<CachedBuffer>> buffers_ ABSL_GUARDED_BY(mutex_);
+};
+
+// The graph service that shares an ImageFrameAllocator among calculators.
+extern const GraphService<ImageFrameAllocator> kImageFrameAllocatorService;
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_FORMATS_IMAGE_FRAME_ALLOCATOR_H_
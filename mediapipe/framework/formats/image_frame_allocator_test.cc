@@ -0,0 +1,197 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/formats/image_frame_allocator.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/counter_factory.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/threadpool.h"
+
+namespace mediapipe {
+namespace {
+
+TEST(ImageFrameAllocatorTest, SizeClassBytes) {
+  EXPECT_EQ(ImageFrameAllocator::SizeClassBytes(1), 4096);
+  EXPECT_EQ(ImageFrameAllocator::SizeClassBytes(4096), 4096);
+  EXPECT_EQ(ImageFrameAllocator::SizeClassBytes(4097), 4608);
+  EXPECT_EQ(ImageFrameAllocator::SizeClassBytes(8192), 8192);
+  EXPECT_EQ(ImageFrameAllocator::SizeClassBytes(8193), 9216);
+  // Each size class wastes less than 1/8 of its capacity.
+  for (int64 size = 4096; size < 1 << 22; size += 997) {
+    int64 capacity = ImageFrameAllocator::SizeClassBytes(size);
+    EXPECT_GE(capacity, size);
+    EXPECT_LT(capacity - size, capacity / 8);
+  }
+}
+
+TEST(ImageFrameAllocatorTest, NewImageFrame) {
+  auto allocator = ImageFrameAllocator::Create({});
+  std::unique_ptr<ImageFrame> frame =
+      allocator->NewImageFrame(ImageFormat::SRGB, 101, 50);
+  EXPECT_EQ(frame->Format(), ImageFormat::SRGB);
+  EXPECT_EQ(frame->Width(), 101);
+  EXPECT_EQ(frame->Height(), 50);
+  EXPECT_EQ(frame->WidthStep(), 304);
+  EXPECT_TRUE(frame->IsAligned(ImageFrame::kDefaultAlignmentBoundary));
+
+  frame = allocator->NewImageFrame(ImageFormat::GRAY8, 101, 50, 1);
+  EXPECT_EQ(frame->WidthStep(), 101);
+  EXPECT_TRUE(frame->IsContiguous());
+}
+
+TEST(ImageFrameAllocatorTest, ReusesBuffersAcrossResolutions) {
+  auto allocator = ImageFrameAllocator::Create({});
+  std::unique_ptr<ImageFrame> frame =
+      allocator->NewImageFrame(ImageFormat::SRGB, 640, 480);
+  const uint8* pixel_data = frame->PixelData();
+  frame = nullptr;
+  EXPECT_EQ(allocator->GetStats().in_use_bytes, 0);
+  EXPECT_GT(allocator->GetStats().cached_bytes, 0);
+
+  // A frame of the same byte size but another resolution and format reuses
+  // the buffer.
+  frame = allocator->NewImageFrame(ImageFormat::GRAY8, 1280, 720);
+  EXPECT_EQ(frame->PixelData(), pixel_data);
+
+  // ImageFrameAllocator::Reset releases the current buffer before reusing it.
+  allocator->Reset(frame.get(), ImageFormat::SRGBA, 480, 480,
+                   ImageFrame::kDefaultAlignmentBoundary);
+  EXPECT_EQ(frame->PixelData(), pixel_data);
+  EXPECT_EQ(frame->Format(), ImageFormat::SRGBA);
+
+  ImageFrameAllocator::Stats stats = allocator->GetStats();
+  EXPECT_EQ(stats.allocation_count, 1);
+  EXPECT_EQ(stats.reuse_count, 2);
+  EXPECT_EQ(stats.cached_bytes, 0);
+  EXPECT_EQ(stats.in_use_bytes,
+            ImageFrameAllocator::SizeClassBytes(640 * 480 * 3));
+}
+
+TEST(ImageFrameAllocatorTest, TrimsToHighWaterMark) {
+  auto allocator = ImageFrameAllocator::Create({});
+  const int64 capacity = ImageFrameAllocator::SizeClassBytes(64 * 64 * 4);
+  std::vector<std::unique_ptr<ImageFrame>> frames;
+  for (int i = 0; i < 8; ++i) {
+    frames.push_back(allocator->NewImageFrame(ImageFormat::SRGBA, 64, 64));
+  }
+  frames.clear();
+  // All buffers are kept while they are within the high-water mark.
+  EXPECT_EQ(allocator->GetStats().cached_bytes, 8 * capacity);
+  EXPECT_EQ(allocator->GetStats().high_water_bytes, 8 * capacity);
+
+  // Once the demand drops to one frame at a time, the excess buffers are
+  // released.
+  for (int i = 0; i < 1000; ++i) {
+    allocator->NewImageFrame(ImageFormat::SRGBA, 64, 64);
+  }
+  ImageFrameAllocator::Stats stats = allocator->GetStats();
+  EXPECT_EQ(stats.allocation_count, 8);
+  EXPECT_EQ(stats.high_water_bytes, capacity);
+  EXPECT_LE(stats.cached_bytes, 2 * capacity);
+  EXPECT_GE(stats.trim_count, 6);
+}
+
+TEST(ImageFrameAllocatorTest, MaxCachedBytes) {
+  ImageFrameAllocator::Options options;
+  options.max_cached_bytes = 0;
+  auto allocator = ImageFrameAllocator::Create(options);
+  allocator->NewImageFrame(ImageFormat::SRGBA, 64, 64);
+  allocator->NewImageFrame(ImageFormat::SRGBA, 64, 64);
+  ImageFrameAllocator::Stats stats = allocator->GetStats();
+  EXPECT_EQ(stats.allocation_count, 2);
+  EXPECT_EQ(stats.trim_count, 2);
+  EXPECT_EQ(stats.cached_bytes, 0);
+}
+
+TEST(ImageFrameAllocatorTest, RegistersCounters) {
+  BasicCounterFactory counter_factory;
+  auto allocator = ImageFrameAllocator::Create({});
+  allocator->RegisterCounters(&counter_factory);
+  allocator->NewImageFrame(ImageFormat::SRGBA, 64, 64);
+  allocator->NewImageFrame(ImageFormat::SRGBA, 64, 64);
+  allocator->Flush();
+  std::map<std::string, int64> values =
+      counter_factory.GetCounterSet()->GetCountersValues();
+  EXPECT_EQ(values["ImageFrameAllocator Allocations"], 1);
+  EXPECT_EQ(values["ImageFrameAllocator Reuses"], 1);
+  EXPECT_EQ(values["ImageFrameAllocator Trims"], 1);
+  EXPECT_EQ(values["ImageFrameAllocator Cached Bytes"], 0);
+
+  // The counters can outlive the allocator.
+  allocator = nullptr;
+  EXPECT_EQ(counter_factory.GetCounterSet()
+                ->Get("ImageFrameAllocator Allocations")
+                ->Get(),
+            0);
+}
+
+TEST(ImageFrameAllocatorTest, FrameOutlivesAllocator) {
+  auto allocator = ImageFrameAllocator::Create({});
+  std::unique_ptr<ImageFrame> frame =
+      allocator->NewImageFrame(ImageFormat::SRGBA, 64, 64);
+  allocator = nullptr;
+  frame->SetToZero();
+  frame = nullptr;
+}
+
+TEST(ImageFrameAllocatorTest, ParallelFrames) {
+  const int kNumThreads = 4;
+  const int kNumFrames = 1000;
+  auto allocator = ImageFrameAllocator::Create({});
+  {
+    ::mediapipe::ThreadPool pool(kNumThreads);
+    pool.StartWorkers();
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&allocator, t]() {
+        for (int i = 0; i < kNumFrames; ++i) {
+          auto frame = allocator->NewImageFrame(ImageFormat::SRGB,
+                                                64 + (i + t) % 3, 64);
+          frame->SetToZero();
+        }
+      });
+    }
+  }
+  ImageFrameAllocator::Stats stats = allocator->GetStats();
+  EXPECT_EQ(stats.allocation_count + stats.reuse_count,
+            kNumThreads * kNumFrames);
+  EXPECT_EQ(stats.in_use_bytes, 0);
+}
+
+void BM_NewImageFrame(benchmark::State& state) {
+  for (auto _ : state) {
+    auto frame = absl::make_unique<ImageFrame>(ImageFormat::SRGB, 1280, 720);
+    benchmark::DoNotOptimize(frame->MutablePixelData());
+  }
+}
+BENCHMARK(BM_NewImageFrame);
+
+void BM_NewImageFrameFromAllocator(benchmark::State& state) {
+  auto allocator = ImageFrameAllocator::Create({});
+  for (auto _ : state) {
+    auto frame = allocator->NewImageFrame(ImageFormat::SRGB, 1280, 720);
+    benchmark::DoNotOptimize(frame->MutablePixelData());
+  }
+}
+BENCHMARK(BM_NewImageFrameFromAllocator);
+
+}  // namespace
+}  // namespace mediapipe
@@ -14,7 +14,10 @@
 
 #include "mediapipe/framework/formats/image_frame_pool.h"
 
+#include <algorithm>
+
 #include "absl/synchronization/mutex.h"
+#include "mediapipe/util/cpu_util.h"
 
 namespace mediapipe {
 
@@ -23,21 +26,31 @@ ImageFramePool::ImageFramePool(int width, int height,
     : width_(width),
       height_(height),
       format_(format),
-      keep_count_(keep_count) {}
+      keep_count_(keep_count),
+      available_(GetNumaNodeCpuIds().size()) {}
 
 ImageFrameSharedPtr ImageFramePool::GetBuffer() {
+  return GetBufferOnNumaNode(GetCurrentNumaNode());
+}
+
+ImageFrameSharedPtr ImageFramePool::GetBufferOnNumaNode(int numa_node) {
+  if (numa_node < 0 || numa_node >= available_.size()) {
+    numa_node = 0;
+  }
   std::unique_ptr<ImageFrame> buffer;
 
   {
     absl::MutexLock lock(&mutex_);
-    if (available_.empty()) {
+    auto& available = available_[numa_node];
+    if (available.empty()) {
       // Fix alignment at 4 for best compatability with OpenGL.
       buffer = std::make_unique<ImageFrame>(
           format_, width_, height_, ImageFrame::kGlDefaultAlignmentBoundary);
       if (!buffer) return nullptr;
     } else {
-      buffer = std::move(available_.back());
-      available_.pop_back();
+      buffer = std::move(available.back());
+      available.pop_back();
+      --available_count_;
     }
 
     ++in_use_count_;
@@ -47,10 +60,10 @@ ImageFrameSharedPtr ImageFramePool::GetBuffer() {
   // to our available list.
   std::weak_ptr<ImageFramePool> weak_pool(shared_from_this());
   return std::shared_ptr<ImageFrame>(buffer.release(),
-                                     [weak_pool](ImageFrame* buf) {
+                                     [weak_pool, numa_node](ImageFrame* buf) {
                                        auto pool = weak_pool.lock();
                                        if (pool) {
-                                         pool->Return(buf);
+                                         pool->Return(buf, numa_node);
                                        } else {
                                          delete buf;
                                        }
@@ -59,15 +72,16 @@ ImageFrameSharedPtr ImageFramePool::GetBuffer() {
 
 std::pair<int, int> ImageFramePool::GetInUseAndAvailableCounts() {
   absl::MutexLock lock(&mutex_);
-  return {in_use_count_, available_.size()};
+  return {in_use_count_, available_count_};
 }
 
-void ImageFramePool::Return(ImageFrame* buf) {
+void ImageFramePool::Return(ImageFrame* buf, int numa_node) {
   std::vector<std::unique_ptr<ImageFrame>> trimmed;
   {
     absl::MutexLock lock(&mutex_);
     --in_use_count_;
-    available_.emplace_back(buf);
+    available_[numa_node].emplace_back(buf);
+    ++available_count_;
     TrimAvailable(&trimmed);
   }
   // The trimmed buffers will be released without holding the lock.
@@ -76,12 +90,18 @@ void ImageFramePool::Return(ImageFrame* buf) {
 void ImageFramePool::TrimAvailable(
     std::vector<std::unique_ptr<ImageFrame>>* trimmed) {
   int keep = std::max(keep_count_ - in_use_count_, 0);
-  if (available_.size() > keep) {
-    auto trim_it = std::next(available_.begin(), keep);
+  while (available_count_ > keep) {
+    auto& available = *std::max_element(
+        available_.begin(), available_.end(),
+        [](const std::vector<std::unique_ptr<ImageFrame>>& a,
+           const std::vector<std::unique_ptr<ImageFrame>>& b) {
+          return a.size() < b.size();
+        });
     if (trimmed) {
-      std::move(trim_it, available_.end(), std::back_inserter(*trimmed));
+      trimmed->push_back(std::move(available.back()));
     }
-    available_.erase(trim_it, available_.end());
+    available.pop_back();
+    --available_count_;
   }
 }
 
@@ -42,8 +42,13 @@ class ImageFramePool : public std::enable_shared_from_this<ImageFramePool> {
   }
 
   // Obtains a buffers. May either be reused or created anew.
+  // Reuses a buffer that was allocated on the NUMA node of the calling
+  // thread, if there is one.
   ImageFrameSharedPtr GetBuffer();
 
+  // Like GetBuffer(), but for a caller running on NUMA node "numa_node".
+  ImageFrameSharedPtr GetBufferOnNumaNode(int numa_node);
+
   int width() const { return width_; }
   int height() const { return height_; }
   ImageFormat::Format format() const { return format_; }
@@ -55,11 +60,13 @@ class ImageFramePool : public std::enable_shared_from_this<ImageFramePool> {
   ImageFramePool(int width, int height, ImageFormat::Format format,
                  int keep_count);
 
-  // Return a buffer to the pool.
-  void Return(ImageFrame* buf);
+  // Return a buffer, which was allocated on NUMA node "numa_node", to the
+  // pool.
+  void Return(ImageFrame* buf, int numa_node);
 
   // If the total number of buffers is greater than keep_count, destroys any
-  // surplus buffers that are no longer in use.
+  // surplus buffers that are no longer in use, starting with the NUMA nodes
+  // that hold the most of them.
   void TrimAvailable(std::vector<std::unique_ptr<ImageFrame>>* trimmed)
       ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
@@ -70,7 +77,12 @@ class ImageFramePool : public std::enable_shared_from_this<ImageFramePool> {
 
   absl::Mutex mutex_;
   int in_use_count_ ABSL_GUARDED_BY(mutex_) = 0;
-  std::vector<std::unique_ptr<ImageFrame>> available_ ABSL_GUARDED_BY(mutex_);
+  int available_count_ ABSL_GUARDED_BY(mutex_) = 0;
+  // The buffers available for reuse, indexed by the NUMA node that their
+  // memory was first touched on. Reusing buffers on the same node avoids
+  // cross-node memory traffic.
+  std::vector<std::vector<std::unique_ptr<ImageFrame>>> available_
+      ABSL_GUARDED_BY(mutex_);
 };
 
 }  // namespace mediapipe
@@ -92,6 +92,18 @@ TEST_F(ImageFramePoolTest, DeleteNotLast) {
   EXPECT_EQ(Pair(kKeepCount - 1, 1), pool_->GetInUseAndAvailableCounts());
 }
 
+TEST_F(ImageFramePoolTest, ReusesBuffersOnSameNumaNode) {
+  auto buffer = pool_->GetBufferOnNumaNode(0);
+  ImageFrame* node_0_frame = buffer.get();
+  buffer = nullptr;
+  EXPECT_EQ(Pair(0, 1), pool_->GetInUseAndAvailableCounts());
+
+  // Unknown nodes fall back to node 0.
+  buffer = pool_->GetBufferOnNumaNode(-1);
+  EXPECT_EQ(node_0_frame, buffer.get());
+  EXPECT_EQ(Pair(1, 0), pool_->GetInUseAndAvailableCounts());
+}
+
 TEST(ImageFrameBufferPoolStaticTest, BufferCanOutlivePool) {
   auto pool = ImageFramePool::Create(kWidth, kHeight, kFormat, kKeepCount);
   auto buffer = pool->GetBuffer();
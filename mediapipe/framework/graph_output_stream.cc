@@ -14,10 +14,86 @@
 
 #include "mediapipe/framework/graph_output_stream.h"
 
+#include <algorithm>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+
 namespace mediapipe {
 
 namespace internal {
 
+namespace {
+
+// Checks in debug builds that a ring has a single consumer, for the duration
+// of one Next() or TryNext() call.
+class SingleConsumerCheck {
+ public:
+  explicit SingleConsumerCheck(std::atomic<bool>* consumer_active)
+      : consumer_active_(consumer_active) {
+    DCHECK(!consumer_active_->exchange(true, std::memory_order_acquire))
+        << "Next(), NextBatch() and TryNext() of a poller using a ring must "
+           "not be called concurrently.";
+  }
+  ~SingleConsumerCheck() {
+    consumer_active_->store(false, std::memory_order_release);
+  }
+
+ private:
+  std::atomic<bool>* consumer_active_;
+};
+
+}  // namespace
+
+PacketRing::PacketRing(int capacity) : head_(0), tail_(0) {
+  size_t size = 1;
+  while (size < static_cast<size_t>(capacity)) {
+    size *= 2;
+  }
+  slots_.resize(size);
+  mask_ = size - 1;
+}
+
+bool PacketRing::Push(Packet packet) {
+  const size_t tail = tail_.load(std::memory_order_relaxed);
+  if (tail - head_.load(std::memory_order_acquire) == slots_.size()) {
+    return false;
+  }
+  slots_[tail & mask_] = std::move(packet);
+  tail_.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+bool PacketRing::Pop(Packet* packet) {
+  const size_t head = head_.load(std::memory_order_relaxed);
+  if (head == tail_.load(std::memory_order_acquire)) {
+    return false;
+  }
+  // Moving the packet out releases the ring's reference to its payload.
+  *packet = std::move(slots_[head & mask_]);
+  head_.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+bool PacketRing::IsFull() const {
+  return static_cast<size_t>(Size()) == slots_.size();
+}
+
+bool PacketRing::IsEmpty() const { return Size() == 0; }
+
+int PacketRing::Size() const {
+  // Reads head_ first, so that the size is never negative.
+  const size_t head = head_.load(std::memory_order_acquire);
+  return static_cast<int>(tail_.load(std::memory_order_acquire) - head);
+}
+
+void PacketRing::Clear() {
+  for (Packet& slot : slots_) {
+    slot = Packet();
+  }
+  head_.store(0);
+  tail_.store(0);
+}
+
 ::mediapipe::Status GraphOutputStream::Initialize(
     const std::string& stream_name, const PacketType* packet_type,
     OutputStreamManager* output_stream_manager) {
@@ -74,6 +150,9 @@ void GraphOutputStream::PrepareForRun(
     RET_CHECK_EQ(num_packets_dropped, 0).SetNoLogging()
         << absl::Substitute("Dropped $0 packet(s) on input stream \"$1\".",
                             num_packets_dropped, input_stream_->Name());
+    if (packet_delivered_callback_) {
+      packet_delivered_callback_(packet);
+    }
     MP_RETURN_IF_ERROR(packet_callback_(packet));
   }
   return ::mediapipe::OkStatus();
@@ -99,6 +178,7 @@ void OutputStreamPollerImpl::PrepareForRun(
   mutex_.Lock();
   graph_has_error_ = false;
   mutex_.Unlock();
+  ClearRing();
 }
 
 void OutputStreamPollerImpl::Reset() {
@@ -106,17 +186,61 @@ void OutputStreamPollerImpl::Reset() {
   graph_has_error_ = false;
   input_stream_->PrepareForRun();
   mutex_.Unlock();
+  ClearRing();
 }
 
 void OutputStreamPollerImpl::SetMaxQueueSize(int queue_size) {
   CHECK(queue_size >= -1)
       << "Max queue size must be either -1 or non-negative.";
+  if (ring_) {
+    // The input stream throttles the graph once the ring is at its limit and
+    // the input stream holds the remaining packets.  The ring takes at most
+    // half, so that the input stream does not report itself full whenever a
+    // packet arrives before Notify() moves it into the ring.
+    int ring_limit = ring_->Capacity();
+    if (queue_size != -1) {
+      ring_limit = std::min(ring_limit, std::max(queue_size / 2, 1));
+      queue_size = std::max(queue_size - ring_limit, 1);
+    }
+    ring_limit_.store(ring_limit);
+    // Moves the packets allowed by a higher limit into the ring.
+    ring_overflow_.store(true);
+  }
   input_stream_handler_->SetMaxQueueSize(queue_size);
 }
 
-int OutputStreamPollerImpl::QueueSize() { return input_stream_->QueueSize(); }
+void OutputStreamPollerImpl::ClearRing() {
+  if (ring_) {
+    // Takes over filling the ring, so that no packets are pushed meanwhile.
+    int no_requests = 0;
+    while (!fill_requests_.compare_exchange_weak(no_requests, 1)) {
+      no_requests = 0;
+      std::this_thread::yield();
+    }
+    ring_->Clear();
+    ring_overflow_ = false;
+    ring_done_ = false;
+    ring_has_error_ = false;
+    ServeFillRequests();
+  }
+}
+
+void OutputStreamPollerImpl::UseRing(int ring_capacity, int spin_iterations) {
+  CHECK_GT(ring_capacity, 0) << "The ring capacity must be positive.";
+  ring_ = absl::make_unique<PacketRing>(ring_capacity);
+  ring_limit_ = ring_->Capacity();
+  spin_iterations_ = spin_iterations;
+}
+
+int OutputStreamPollerImpl::QueueSize() {
+  return input_stream_->QueueSize() + (ring_ ? ring_->Size() : 0);
+}
 
 ::mediapipe::Status OutputStreamPollerImpl::Notify() {
+  if (ring_) {
+    RequestFill();
+    return ::mediapipe::OkStatus();
+  }
   mutex_.Lock();
   handler_condvar_.Signal();
   mutex_.Unlock();
@@ -124,14 +248,150 @@ int OutputStreamPollerImpl::QueueSize() { return input_stream_->QueueSize(); }
 }
 
 void OutputStreamPollerImpl::NotifyError() {
+  ring_has_error_ = true;
   mutex_.Lock();
   graph_has_error_ = true;
   handler_condvar_.Signal();
   mutex_.Unlock();
 }
 
+void OutputStreamPollerImpl::PopPacket(Timestamp min_timestamp,
+                                       Packet* packet) {
+  int num_packets_dropped = 0;
+  bool stream_is_done = false;
+  *packet = input_stream_->PopPacketAtTimestamp(
+      min_timestamp, &num_packets_dropped, &stream_is_done);
+  CHECK_EQ(num_packets_dropped, 0)
+      << absl::Substitute("Dropped $0 packet(s) on input stream \"$1\".",
+                          num_packets_dropped, input_stream_->Name());
+}
+
+void OutputStreamPollerImpl::RequestFill() {
+  if (fill_requests_.fetch_add(1, std::memory_order_acq_rel) == 0) {
+    ServeFillRequests();
+  }
+}
+
+void OutputStreamPollerImpl::ServeFillRequests() {
+  bool filled = false;
+  while (true) {
+    // The requests raised while the ring is filled are served by another
+    // pass, since their packets may have been added after the input stream
+    // was checked.
+    const int requests = fill_requests_.load(std::memory_order_acquire);
+    filled |= FillRing();
+    if (fill_requests_.fetch_sub(requests, std::memory_order_acq_rel) ==
+        requests) {
+      break;
+    }
+  }
+  if (filled) {
+    WakeWaitingCaller();
+  }
+}
+
+bool OutputStreamPollerImpl::FillRing() {
+  const int ring_limit = ring_limit_.load(std::memory_order_relaxed);
+  bool filled = false;
+  while (true) {
+    bool empty;
+    Timestamp min_timestamp = input_stream_->MinTimestampOrBound(&empty);
+    if (empty) {
+      if (min_timestamp == Timestamp::Done() &&
+          !ring_done_.load(std::memory_order_relaxed)) {
+        ring_done_.store(true, std::memory_order_release);
+        filled = true;
+      }
+      return filled;
+    }
+    if (ring_->Size() >= ring_limit) {
+      // The packets left in the input stream count towards its maximum queue
+      // size, which throttles the graph as in the default mode.
+      ring_overflow_.store(true, std::memory_order_release);
+      return filled;
+    }
+    Packet packet;
+    PopPacket(min_timestamp, &packet);
+    ring_->Push(std::move(packet));
+    filled = true;
+  }
+}
+
+bool OutputStreamPollerImpl::PopFromRing(Packet* packet) {
+  bool popped = ring_->Pop(packet);
+  if (ring_overflow_.load(std::memory_order_acquire) &&
+      ring_overflow_.exchange(false)) {
+    RequestFill();
+  }
+  if (!popped && !ring_->Pop(packet)) {
+    return false;
+  }
+  if (packet_delivered_callback_) {
+    packet_delivered_callback_(*packet);
+  }
+  return true;
+}
+
+bool OutputStreamPollerImpl::DrainRing(Packet* packet) {
+  while (true) {
+    if (PopFromRing(packet)) {
+      return true;
+    }
+    // After an error, packets may be left in the input stream when the ring
+    // overflowed, so they are moved into the ring until both are empty.
+    if (input_stream_->IsEmpty()) {
+      // Pops the packets pushed after the ring was found empty.
+      return PopFromRing(packet);
+    }
+    RequestFill();
+    if (ring_->IsEmpty()) {
+      // Another thread is filling the ring.
+      std::this_thread::yield();
+    }
+  }
+}
+
+bool OutputStreamPollerImpl::NextFromRing(Packet* packet) {
+  for (int i = 0;; ++i) {
+    if (PopFromRing(packet)) {
+      return true;
+    }
+    if (ring_done_.load(std::memory_order_acquire) ||
+        ring_has_error_.load(std::memory_order_acquire)) {
+      return DrainRing(packet);
+    }
+    if (i < spin_iterations_) {
+      std::this_thread::yield();
+      continue;
+    }
+    absl::MutexLock lock(&mutex_);
+    caller_waiting_.store(true);
+    // Pairs with the fence in WakeWaitingCaller, so that either the caller
+    // sees the pushed packets, or the producer sees caller_waiting_.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (ring_->IsEmpty() && !ring_overflow_.load() && !ring_done_.load() &&
+           !ring_has_error_.load()) {
+      handler_condvar_.Wait(&mutex_);
+    }
+    caller_waiting_.store(false);
+  }
+}
+
+void OutputStreamPollerImpl::WakeWaitingCaller() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (caller_waiting_.load(std::memory_order_relaxed)) {
+    mutex_.Lock();
+    handler_condvar_.Signal();
+    mutex_.Unlock();
+  }
+}
+
 bool OutputStreamPollerImpl::Next(Packet* packet) {
   CHECK(packet);
+  if (ring_) {
+    SingleConsumerCheck check(&consumer_active_);
+    return NextFromRing(packet);
+  }
   bool empty_queue = true;
   Timestamp min_timestamp = Timestamp::Unset();
   mutex_.Lock();
@@ -152,13 +412,43 @@ bool OutputStreamPollerImpl::Next(Packet* packet) {
   if (min_timestamp == Timestamp::Done()) {
     return false;
   }
-  int num_packets_dropped = 0;
-  bool stream_is_done = false;
-  *packet = input_stream_->PopPacketAtTimestamp(
-      min_timestamp, &num_packets_dropped, &stream_is_done);
-  CHECK_EQ(num_packets_dropped, 0)
-      << absl::Substitute("Dropped $0 packet(s) on input stream \"$1\".",
-                          num_packets_dropped, input_stream_->Name());
+  PopPacket(min_timestamp, packet);
+  if (packet_delivered_callback_) {
+    packet_delivered_callback_(*packet);
+  }
+  return true;
+}
+
+bool OutputStreamPollerImpl::NextBatch(std::vector<Packet>* packets,
+                                       int max_packets) {
+  CHECK(packets);
+  CHECK_GT(max_packets, 0);
+  Packet packet;
+  if (!Next(&packet)) {
+    return false;
+  }
+  packets->push_back(std::move(packet));
+  for (int i = 1; i < max_packets && TryNext(&packet); ++i) {
+    packets->push_back(std::move(packet));
+  }
+  return true;
+}
+
+bool OutputStreamPollerImpl::TryNext(Packet* packet) {
+  CHECK(packet);
+  if (ring_) {
+    SingleConsumerCheck check(&consumer_active_);
+    return PopFromRing(packet);
+  }
+  bool empty_queue = true;
+  Timestamp min_timestamp = input_stream_->MinTimestampOrBound(&empty_queue);
+  if (empty_queue) {
+    return false;
+  }
+  PopPacket(min_timestamp, packet);
+  if (packet_delivered_callback_) {
+    packet_delivered_callback_(*packet);
+  }
   return true;
 }
 
@@ -15,6 +15,7 @@
 #ifndef MEDIAPIPE_FRAMEWORK_GRAPH_OUTPUT_STREAM_H_
 #define MEDIAPIPE_FRAMEWORK_GRAPH_OUTPUT_STREAM_H_
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <string>
@@ -68,6 +69,13 @@ class GraphOutputStream {
 
   InputStreamManager* input_stream() { return input_stream_.get(); }
 
+  // Installs a callback invoked with each packet as it is delivered to the
+  // client, which is used to profile the graph output latency.
+  void SetPacketDeliveredCallback(
+      std::function<void(const Packet&)> packet_delivered_callback) {
+    packet_delivered_callback_ = std::move(packet_delivered_callback);
+  }
+
  protected:
   // A simple input stream handler that manages one input stream. The input
   // stream is only for observation/polling purpose and should never be used
@@ -102,6 +110,7 @@ class GraphOutputStream {
 
   std::unique_ptr<InputStreamHandler> input_stream_handler_;
   std::unique_ptr<InputStreamManager> input_stream_;
+  std::function<void(const Packet&)> packet_delivered_callback_;
 };
 
 // OutputStreamObserver that observes the output stream and passes packets to
@@ -127,6 +136,39 @@ class OutputStreamObserver : public GraphOutputStream {
   std::function<::mediapipe::Status(const Packet&)> packet_callback_;
 };
 
+// A bounded queue of packets between one producer thread and one consumer
+// thread, which push and pop packets without locking.  Push() must not be
+// called concurrently with Push(), nor Pop() with Pop().
+class PacketRing {
+ public:
+  // Creates a ring holding up to capacity packets, rounded up to a power of 2.
+  explicit PacketRing(int capacity);
+
+  // Appends a packet.  Returns false if the ring is full.
+  bool Push(Packet packet);
+
+  // Removes the oldest packet.  Returns false if the ring is empty.
+  bool Pop(Packet* packet);
+
+  bool IsFull() const;
+  bool IsEmpty() const;
+  int Size() const;
+  int Capacity() const { return static_cast<int>(slots_.size()); }
+
+  // Removes all packets.  Must not be called concurrently with Push or Pop.
+  void Clear();
+
+ private:
+  std::vector<Packet> slots_;
+  size_t mask_;
+  // The index of the next packet to pop, only written by the consumer.
+  std::atomic<size_t> head_;
+  // Keeps head_ and tail_ on separate cache lines.
+  char padding_[64];
+  // The index of the next packet to push, only written by the producer.
+  std::atomic<size_t> tail_;
+};
+
 // OutputStreamPollerImpl that returns packets to the caller via
 // Next()/NextBatch().
 class OutputStreamPollerImpl : public GraphOutputStream {
@@ -146,8 +188,20 @@ class OutputStreamPollerImpl : public GraphOutputStream {
   // Resets graph_has_error_ and cleans the internal packet queue.
   void Reset();
 
+  // Sets the number of packets waiting for the caller at which the graph is
+  // throttled.  In ring mode, the packets in the ring count towards it.  The
+  // ring then holds up to half of them, and the input stream the rest, so
+  // the bound is at least 2.
   void SetMaxQueueSize(int queue_size);
 
+  // Hands the packets over to the caller through a PacketRing of
+  // ring_capacity packets, so that Notify() and Next() only lock when the
+  // caller waits for packets.  Next() checks the ring spin_iterations times
+  // before it waits.  Must be called before SetMaxQueueSize() and before the
+  // graph starts running.  The ring has a single consumer, so Next(),
+  // NextBatch() and TryNext() must then not be called concurrently.
+  void UseRing(int ring_capacity, int spin_iterations);
+
   // Returns the number of packets in the queue.
   int QueueSize();
 
@@ -161,10 +215,72 @@ class OutputStreamPollerImpl : public GraphOutputStream {
   // done).  Returns true if successful.
   ABSL_MUST_USE_RESULT bool Next(Packet* packet);
 
+  // Gets the next packets, up to max_packets of them (block until at least
+  // one is available or the stream is done).  Appends them to packets, and
+  // returns true if successful.
+  ABSL_MUST_USE_RESULT bool NextBatch(std::vector<Packet>* packets,
+                                      int max_packets);
+
+  // Gets the next packet if it is available, without blocking.  Returns true
+  // if successful.
+  ABSL_MUST_USE_RESULT bool TryNext(Packet* packet);
+
  private:
+  // Pops the packet at min_timestamp from the input stream.
+  void PopPacket(Timestamp min_timestamp, Packet* packet);
+
+  // Empties the ring, if any, and resets its state.
+  void ClearRing();
+
+  // Fills the ring, or leaves the request to the thread filling it already,
+  // so that the ring has a single producer without locking.  Wakes up the
+  // caller if it waits for the packets.
+  void RequestFill();
+
+  // Serves the fill requests until there are none left.  Must only be called
+  // by the thread that raised fill_requests_ from 0.
+  void ServeFillRequests();
+
+  // Moves the packets from the input stream to the ring, until the ring
+  // holds ring_limit_ packets, and records whether the stream is done.
+  // Returns true if it pushed packets or found the stream done.
+  bool FillRing();
+
+  // Pops a packet from the ring, refilling it if it had overflowed.
+  bool PopFromRing(Packet* packet);
+
+  // Implements Next() in ring mode.
+  bool NextFromRing(Packet* packet);
+
+  // Pops a packet once the stream is done or the graph has an error.  Returns
+  // false only when both the ring and the input stream are empty.
+  bool DrainRing(Packet* packet);
+
+  // Wakes up the caller if it waits in NextFromRing().
+  void WakeWaitingCaller();
+
   absl::Mutex mutex_;
   absl::CondVar handler_condvar_ ABSL_GUARDED_BY(mutex_);
   bool graph_has_error_ ABSL_GUARDED_BY(mutex_);
+
+  // The ring, or nullptr if the packets are popped from the input stream.
+  std::unique_ptr<PacketRing> ring_;
+  int spin_iterations_ = 0;
+  // The number of packets the ring may hold, see SetMaxQueueSize().
+  std::atomic<int> ring_limit_{0};
+  // The pending fill requests.  The thread that raises it from 0 fills the
+  // ring until it drops back to 0.
+  std::atomic<int> fill_requests_{0};
+  // Set when packets are left in the input stream because the ring is full.
+  std::atomic<bool> ring_overflow_{false};
+  // Set when all the packets of a done stream are pushed into the ring.
+  std::atomic<bool> ring_done_{false};
+  std::atomic<bool> ring_has_error_{false};
+  // Set while the caller waits on handler_condvar_ in NextFromRing().
+  std::atomic<bool> caller_waiting_{false};
+  // Set during Next() and TryNext() in debug builds, which check that the
+  // ring has a single consumer.
+  std::atomic<bool> consumer_active_{false};
 };
 
 }  // namespace internal
@@ -239,18 +239,22 @@ CalculatorContext* GetCalculatorContext(CalculatorContextManager* manager) {
 
 // Logs the current queue size of an input stream.
 void LogQueuedPackets(CalculatorContext* context, InputStreamManager* stream,
-                      Packet queue_tail) {
-  if (context) {
+                      Timestamp queue_tail) {
+  // PACKET_QUEUED events are only recorded by the GraphTracer.  Skip them
+  // otherwise, since reading the queue size and head locks the input stream
+  // once more for every mirror of every output packet.
+  ProfilingContext* profiling_context =
+      context ? context->GetProfilingContext() : nullptr;
+  if (profiling_context && profiling_context->tracer()) {
     TraceEvent event = TraceEvent(TraceEvent::PACKET_QUEUED)
                            .set_node_id(context->NodeId())
-                           .set_input_ts(queue_tail.Timestamp())
+                           .set_input_ts(queue_tail)
                            .set_stream_id(&stream->Name())
                            .set_event_data(stream->QueueSize() + 1);
-    ::mediapipe::LogEvent(context->GetProfilingContext(),
-                          event.set_packet_ts(queue_tail.Timestamp()));
+    ::mediapipe::LogEvent(profiling_context, event.set_packet_ts(queue_tail));
     Packet queue_head = stream->QueueHead();
     if (!queue_head.IsEmpty()) {
-      ::mediapipe::LogEvent(context->GetProfilingContext(),
+      ::mediapipe::LogEvent(profiling_context,
                             event.set_packet_ts(queue_head.Timestamp()));
     }
   }
@@ -259,7 +263,8 @@ void LogQueuedPackets(CalculatorContext* context, InputStreamManager* stream,
 void InputStreamHandler::AddPackets(CollectionItemId id,
                                     const std::list<Packet>& packets) {
   LogQueuedPackets(GetCalculatorContext(calculator_context_manager_),
-                   input_stream_managers_.Get(id), packets.back());
+                   input_stream_managers_.Get(id),
+                   packets.back().Timestamp());
   bool notify = false;
   ::mediapipe::Status result =
       input_stream_managers_.Get(id)->AddPackets(packets, &notify);
@@ -274,7 +279,8 @@ void InputStreamHandler::AddPackets(CollectionItemId id,
 void InputStreamHandler::MovePackets(CollectionItemId id,
                                      std::list<Packet>* packets) {
   LogQueuedPackets(GetCalculatorContext(calculator_context_manager_),
-                   input_stream_managers_.Get(id), packets->back());
+                   input_stream_managers_.Get(id),
+                   packets->back().Timestamp());
   bool notify = false;
   ::mediapipe::Status result =
       input_stream_managers_.Get(id)->MovePackets(packets, &notify);
@@ -286,6 +292,22 @@ void InputStreamHandler::MovePackets(CollectionItemId id,
   }
 }
 
+void InputStreamHandler::AddPacketBatch(CollectionItemId id,
+                                        PacketBatchRing::Batch* batch) {
+  LogQueuedPackets(GetCalculatorContext(calculator_context_manager_),
+                   input_stream_managers_.Get(id),
+                   batch->packet(batch->size() - 1).Timestamp());
+  bool notify = false;
+  ::mediapipe::Status result =
+      input_stream_managers_.Get(id)->AddPacketBatch(batch, &notify);
+  if (!result.ok()) {
+    error_callback_(result);
+  }
+  if (notify) {
+    notification_();
+  }
+}
+
 void InputStreamHandler::SetNextTimestampBound(CollectionItemId id,
                                                Timestamp bound) {
   bool notify = false;
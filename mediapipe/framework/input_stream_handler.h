@@ -33,6 +33,7 @@
 #include "mediapipe/framework/input_stream_shard.h"
 #include "mediapipe/framework/mediapipe_options.pb.h"
 #include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/packet_batch_ring.h"
 #include "mediapipe/framework/packet_set.h"
 #include "mediapipe/framework/packet_type.h"
 #include "mediapipe/framework/port/status.h"
@@ -138,6 +139,17 @@ class InputStreamHandler {
   // Moves packets into a particular stream.
   virtual void MovePackets(CollectionItemId id, std::list<Packet>* packets);
 
+  // Returns true if the input streams read the packets of their output
+  // streams from a PacketBatchRing, which keeps one copy of each packet for
+  // all mirrors of an output stream.  The packets then arrive through
+  // AddPacketBatch() instead of AddPackets() or MovePackets(), so subclasses
+  // that override those must return false.
+  virtual bool ReadsPacketBatches() const { return false; }
+
+  // Adds the packets of a batch published to the PacketBatchRing of a
+  // particular stream.
+  void AddPacketBatch(CollectionItemId id, PacketBatchRing::Batch* batch);
+
   // Sets next timestamp bound in a particular stream.
   void SetNextTimestampBound(CollectionItemId id, Timestamp bound);
 
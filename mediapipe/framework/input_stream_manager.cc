@@ -48,6 +48,10 @@ void InputStreamManager::SetQueueSizeCallbacks(
 void InputStreamManager::PrepareForRun() {
   absl::MutexLock stream_lock(&stream_mutex_);
   queue_.clear();
+  if (ring_) {
+    reader_.Reset(*ring_);
+  }
+  rejected_batch_ = false;
   last_reported_stream_full_ = false;
   num_packets_added_ = 0;
   next_timestamp_bound_ = Timestamp::PreStream();
@@ -58,15 +62,44 @@ void InputStreamManager::PrepareForRun() {
 
 bool InputStreamManager::IsEmpty() const {
   absl::MutexLock stream_lock(&stream_mutex_);
-  return queue_.empty();
+  return QueueIsEmpty();
 }
 
 Packet InputStreamManager::QueueHead() const {
   absl::MutexLock stream_lock(&stream_mutex_);
-  if (queue_.empty()) {
+  if (QueueIsEmpty()) {
     return Packet();
   }
-  return queue_.front();
+  return QueueFront();
+}
+
+bool InputStreamManager::QueueIsEmpty() const {
+  if (ring_) {
+    // Close() drops the packets of the reader, and ignores the ones the
+    // producer appends afterwards.
+    return closed_ || reader_.IsEmpty();
+  }
+  return queue_.empty();
+}
+
+int InputStreamManager::QueueSizeHelper() const {
+  if (ring_) {
+    return closed_ ? 0 : static_cast<int>(reader_.Size());
+  }
+  return static_cast<int>(queue_.size());
+}
+
+const Packet& InputStreamManager::QueueFront() const {
+  return ring_ ? reader_.Front() : queue_.front();
+}
+
+Packet InputStreamManager::PopQueueFront() {
+  if (ring_) {
+    return reader_.PopFront();
+  }
+  Packet packet = std::move(queue_.front());
+  queue_.pop_front();
+  return packet;
 }
 
 ::mediapipe::Status InputStreamManager::SetHeader(const Packet& header) {
@@ -92,6 +125,7 @@ Packet InputStreamManager::QueueHead() const {
 template <typename Container>
 ::mediapipe::Status InputStreamManager::AddOrMovePacketsInternal(
     Container container, bool* notify) {
+  DCHECK(!ring_) << "Stream \"" << name_ << "\" reads packet batches.";
   *notify = false;
   bool queue_became_non_empty = false;
   bool queue_became_full = false;
@@ -101,53 +135,15 @@ template <typename Container>
     if (closed_) {
       return ::mediapipe::OkStatus();
     }
+    const int max_queue_size = max_queue_size_;
     // Check if the queue was full before packets came in.
     bool was_queue_full =
-        (max_queue_size_ != -1 && queue_.size() >= max_queue_size_);
+        (max_queue_size != -1 && queue_.size() >= max_queue_size);
     // Check if the queue becomes non-empty.
     queue_became_non_empty = queue_.empty() && !container.empty();
     for (auto& packet : container) {
-      ::mediapipe::Status result = packet_type_->Validate(packet);
-      if (!result.ok()) {
-        return tool::AddStatusPrefix(
-            absl::StrCat(
-                "Packet type mismatch on a calculator receiving from stream \"",
-                name_, "\": "),
-            result);
-      }
-
-      const Timestamp timestamp = packet.Timestamp();
-      if (!timestamp.IsAllowedInStream()) {
-        return ::mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
-               << "In stream \"" << name_
-               << "\", timestamp not specified or set to illegal value: "
-               << timestamp.DebugString();
-      }
-      if (enable_timestamps_) {
-        // Check that PostStream(), if used, is the only timestamp used.  This
-        // is also true for PreStream() but doesn't need to be checked because
-        // Timestamp::PreStream().NextAllowedInStream() is
-        // Timestamp::OneOverPostStream().
-        if (timestamp == Timestamp::PostStream() && num_packets_added_ > 0) {
-          return ::mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
-                 << "In stream \"" << name_
-                 << "\", a packet at Timestamp::PostStream() must be the only "
-                    "Packet in an InputStream.";
-        }
-        if (timestamp < next_timestamp_bound_) {
-          return ::mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
-                 << "Packet timestamp mismatch on a calculator receiving from "
-                    "stream \""
-                 << name_ << "\". Current minimum expected timestamp is "
-                 << next_timestamp_bound_.DebugString() << " but received "
-                 << timestamp.DebugString()
-                 << ". Are you using a custom InputStreamHandler? Note that "
-                    "some InputStreamHandlers allow timestamps that are not "
-                    "strictly monotonically increasing. See for example the "
-                    "ImmediateInputStreamHandler class comment.";
-        }
-      }
-      next_timestamp_bound_ = timestamp.NextAllowedInStream();
+      MP_RETURN_IF_ERROR(ValidatePacket(packet, next_timestamp_bound_));
+      next_timestamp_bound_ = packet.Timestamp().NextAllowedInStream();
 
       // If the caller is MovePackets(), packet's underlying holder should be
       // transferred into queue_. Otherwise, queue_ keeps a copy of the packet.
@@ -161,8 +157,8 @@ template <typename Container>
         queue_.emplace_back(std::move(packet));
       }
     }
-    queue_became_full = (!was_queue_full && max_queue_size_ != -1 &&
-                         queue_.size() >= max_queue_size_);
+    queue_became_full = (!was_queue_full && max_queue_size != -1 &&
+                         queue_.size() >= max_queue_size);
     VLOG_IF(3, queue_.size() > 1)
         << "Queue size greater than 1: stream name: " << name_
         << " queue_size: " << queue_.size();
@@ -178,9 +174,135 @@ template <typename Container>
   return ::mediapipe::OkStatus();
 }
 
+::mediapipe::Status InputStreamManager::ValidatePacket(
+    const Packet& packet, Timestamp next_timestamp_bound) const {
+  ::mediapipe::Status result = packet_type_->Validate(packet);
+  if (!result.ok()) {
+    return tool::AddStatusPrefix(
+        absl::StrCat(
+            "Packet type mismatch on a calculator receiving from stream \"",
+            name_, "\": "),
+        result);
+  }
+
+  const Timestamp timestamp = packet.Timestamp();
+  if (!timestamp.IsAllowedInStream()) {
+    return ::mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
+           << "In stream \"" << name_
+           << "\", timestamp not specified or set to illegal value: "
+           << timestamp.DebugString();
+  }
+  if (enable_timestamps_) {
+    // Check that PostStream(), if used, is the only timestamp used.  This
+    // is also true for PreStream() but doesn't need to be checked because
+    // Timestamp::PreStream().NextAllowedInStream() is
+    // Timestamp::OneOverPostStream().
+    if (timestamp == Timestamp::PostStream() && num_packets_added_ > 0) {
+      return ::mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
+             << "In stream \"" << name_
+             << "\", a packet at Timestamp::PostStream() must be the only "
+                "Packet in an InputStream.";
+    }
+    if (timestamp < next_timestamp_bound) {
+      return ::mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
+             << "Packet timestamp mismatch on a calculator receiving from "
+                "stream \""
+             << name_ << "\". Current minimum expected timestamp is "
+             << next_timestamp_bound.DebugString() << " but received "
+             << timestamp.DebugString()
+             << ". Are you using a custom InputStreamHandler? Note that "
+                "some InputStreamHandlers allow timestamps that are not "
+                "strictly monotonically increasing. See for example the "
+                "ImmediateInputStreamHandler class comment.";
+    }
+  }
+  return ::mediapipe::OkStatus();
+}
+
+void InputStreamManager::ReadPacketBatchesFrom(const PacketBatchRing* ring) {
+  CHECK(ring);
+  absl::MutexLock stream_lock(&stream_mutex_);
+  CHECK(queue_.empty());
+  ring_ = ring;
+  reader_.Reset(*ring_);
+}
+
+::mediapipe::Status InputStreamManager::AddPacketBatch(
+    PacketBatchRing::Batch* batch, bool* notify) {
+  DCHECK(ring_);
+  *notify = false;
+  if (closed_ || rejected_batch_) {
+    return ::mediapipe::OkStatus();
+  }
+  // The consumer may pop packets concurrently.  The queue size callbacks
+  // check IsFull() again, so they tolerate a stale was_queue_full.
+  const int max_queue_size = max_queue_size_;
+  const bool was_queue_full =
+      (max_queue_size != -1 && QueueSizeHelper() >= max_queue_size);
+  Timestamp bound = next_timestamp_bound_;
+  for (int i = 0; i < batch->size(); ++i) {
+    const Packet& packet = batch->packet(i);
+    ::mediapipe::Status result = ValidatePacket(packet, bound);
+    if (!result.ok()) {
+      rejected_batch_ = true;
+      return result;
+    }
+    bound = packet.Timestamp().NextAllowedInStream();
+    ++num_packets_added_;
+  }
+  const bool queue_became_non_empty = reader_.Append(batch);
+  // The bound is raised after the packets are appended, since the consumer
+  // would otherwise see an empty queue up to the bound, and skip them.
+  if (enable_timestamps_) {
+    RaiseNextTimestampBound(bound);
+  } else {
+    // Untimed packets set the bound even if it decreases, as in
+    // AddOrMovePacketsInternal().
+    next_timestamp_bound_ = bound;
+  }
+  VLOG(3) << "Input stream:" << name_ << " has added " << batch->size()
+          << " packets from its output stream.";
+  if (!was_queue_full && max_queue_size != -1 &&
+      QueueSizeHelper() >= max_queue_size) {
+    VLOG(3) << "Queue became full: " << Name();
+    becomes_full_callback_(this, &last_reported_stream_full_);
+  }
+  *notify = queue_became_non_empty && batch->size() > 0;
+  return ::mediapipe::OkStatus();
+}
+
+bool InputStreamManager::RaiseNextTimestampBound(Timestamp bound) {
+  Timestamp current = next_timestamp_bound_;
+  while (current < bound) {
+    if (next_timestamp_bound_.compare_exchange_weak(current, bound)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 ::mediapipe::Status InputStreamManager::SetNextTimestampBound(
     const Timestamp bound, bool* notify) {
   *notify = false;
+  if (ring_) {
+    if (closed_) {
+      return ::mediapipe::OkStatus();
+    }
+    const Timestamp current_bound = next_timestamp_bound_;
+    if (enable_timestamps_ && bound < current_bound) {
+      return ::mediapipe::UnknownErrorBuilder(MEDIAPIPE_LOC)
+             << "SetNextTimestampBound must be called with a timestamp greater "
+                "than or equal to the current bound. In stream \""
+             << name_ << "\". Current minimum expected timestamp is "
+             << current_bound.DebugString() << " but received "
+             << bound.DebugString();
+    }
+    // The queue is checked after the bound is raised, so that either this
+    // notifies the consumer or the consumer sees the new bound once it has
+    // emptied the queue.
+    *notify = RaiseNextTimestampBound(bound) && reader_.IsEmpty();
+    return ::mediapipe::OkStatus();
+  }
   {
     // Scope to prevent locking the stream when notification is called.
     absl::MutexLock stream_lock(&stream_mutex_);
@@ -193,7 +315,7 @@ template <typename Container>
              << "SetNextTimestampBound must be called with a timestamp greater "
                 "than or equal to the current bound. In stream \""
              << name_ << "\". Current minimum expected timestamp is "
-             << next_timestamp_bound_.DebugString() << " but received "
+             << next_timestamp_bound_.load().DebugString() << " but received "
              << bound.DebugString();
     }
 
@@ -222,19 +344,30 @@ void InputStreamManager::Close() {
   next_timestamp_bound_ = Timestamp::Done();
   last_select_timestamp_ = Timestamp::Done();
   closed_ = true;
+  if (ring_) {
+    // Releases the packets right away, since the other mirrors keep
+    // consuming the ring.
+    reader_.Clear();
+  }
 }
 
 Timestamp InputStreamManager::MinTimestampOrBound(bool* is_empty) const {
   absl::MutexLock stream_lock(&stream_mutex_);
+  // Reads the bound before the queue.  The producer of a stream reading
+  // packet batches raises the bound after it appends the packets below it, so
+  // an empty queue is never older than the bound.
+  const Timestamp bound = next_timestamp_bound_;
+  const bool empty = QueueIsEmpty();
   if (is_empty) {
-    *is_empty = queue_.empty();
+    *is_empty = empty;
   }
-  return MinTimestampOrBoundHelper();
+  return empty ? bound : QueueFront().Timestamp();
 }
 
 Timestamp InputStreamManager::MinTimestampOrBoundHelper() const
     ABSL_EXCLUSIVE_LOCKS_REQUIRED(stream_mutex_) {
-  return queue_.empty() ? next_timestamp_bound_ : queue_.front().Timestamp();
+  const Timestamp bound = next_timestamp_bound_;
+  return QueueIsEmpty() ? bound : QueueFront().Timestamp();
 }
 
 Packet InputStreamManager::PopPacketAtTimestamp(Timestamp timestamp,
@@ -253,24 +386,22 @@ Packet InputStreamManager::PopPacketAtTimestamp(Timestamp timestamp,
 
     // Make sure AddPacket and SetNextTimestampBound are not called with
     // timestamps we have already passed.
-    if (next_timestamp_bound_ <= timestamp) {
-      next_timestamp_bound_ = timestamp.NextAllowedInStream();
-    }
+    RaiseNextTimestampBound(timestamp.NextAllowedInStream());
 
     VLOG(3) << "Input stream " << name_
             << " selecting at timestamp:" << timestamp.Value()
-            << " next timestamp bound: " << next_timestamp_bound_;
+            << " next timestamp bound: " << next_timestamp_bound_.load();
 
     // Advances time to timestamp.
     Timestamp current_timestamp = Timestamp::Unset();
 
     // Checks if queue is full.
+    const int max_queue_size = max_queue_size_;
     bool was_queue_full =
-        (max_queue_size_ != -1 && queue_.size() >= max_queue_size_);
+        (max_queue_size != -1 && QueueSizeHelper() >= max_queue_size);
 
-    while (!queue_.empty() && queue_.front().Timestamp() <= timestamp) {
-      packet = std::move(queue_.front());
-      queue_.pop_front();
+    while (!QueueIsEmpty() && QueueFront().Timestamp() <= timestamp) {
+      packet = PopQueueFront();
       current_timestamp = packet.Timestamp();
       ++(*num_packets_dropped);
     }
@@ -283,8 +414,9 @@ Packet InputStreamManager::PopPacketAtTimestamp(Timestamp timestamp,
     }
 
     VLOG(3) << "Input stream removed packets:" << name_
-            << " Size:" << queue_.size();
-    queue_became_non_full = (was_queue_full && queue_.size() < max_queue_size_);
+            << " Size:" << QueueSizeHelper();
+    queue_became_non_full =
+        (was_queue_full && QueueSizeHelper() < max_queue_size);
     *stream_is_done = IsDone();
   }
   if (queue_became_non_full) {
@@ -305,19 +437,20 @@ Packet InputStreamManager::PopQueueHead(bool* stream_is_done) {
     VLOG(3) << "Input stream " << name_ << " selecting at queue head";
 
     // Check if queue is full.
+    const int max_queue_size = max_queue_size_;
     bool was_queue_full =
-        (max_queue_size_ != -1 && queue_.size() >= max_queue_size_);
+        (max_queue_size != -1 && QueueSizeHelper() >= max_queue_size);
 
-    if (!queue_.empty()) {
-      packet = std::move(queue_.front());
-      queue_.pop_front();
+    if (!QueueIsEmpty()) {
+      packet = PopQueueFront();
     } else {
       packet = Packet();
     }
 
     VLOG(3) << "Input stream removed a packet:" << name_
-            << " Size:" << queue_.size();
-    queue_became_non_full = (was_queue_full && queue_.size() < max_queue_size_);
+            << " Size:" << QueueSizeHelper();
+    queue_became_non_full =
+        (was_queue_full && QueueSizeHelper() < max_queue_size);
     *stream_is_done = IsDone();
   }
   if (queue_became_non_full) {
@@ -328,23 +461,25 @@ Packet InputStreamManager::PopQueueHead(bool* stream_is_done) {
 }
 
 int InputStreamManager::QueueSize() const {
+  if (ring_) {
+    return QueueSizeHelper();
+  }
   absl::MutexLock lock(&stream_mutex_);
-  return static_cast<int>(queue_.size());
+  return QueueSizeHelper();
 }
 
-int InputStreamManager::MaxQueueSize() const {
-  absl::MutexLock lock(&stream_mutex_);
-  return max_queue_size_;
-}
+int InputStreamManager::MaxQueueSize() const { return max_queue_size_; }
 
 void InputStreamManager::SetMaxQueueSize(int max_queue_size) {
   bool was_full;
   bool is_full;
   {
     absl::MutexLock lock(&stream_mutex_);
-    was_full = (max_queue_size_ != -1 && queue_.size() >= max_queue_size_);
+    const int old_max_queue_size = max_queue_size_;
+    was_full = (old_max_queue_size != -1 &&
+                QueueSizeHelper() >= old_max_queue_size);
     max_queue_size_ = max_queue_size;
-    is_full = (max_queue_size_ != -1 && queue_.size() >= max_queue_size_);
+    is_full = (max_queue_size != -1 && QueueSizeHelper() >= max_queue_size);
   }
 
   // QueueSizeCallback is called with no mutexes held.
@@ -358,11 +493,12 @@ void InputStreamManager::SetMaxQueueSize(int max_queue_size) {
 }
 
 bool InputStreamManager::IsFull() const {
-  absl::MutexLock lock(&stream_mutex_);
-  return max_queue_size_ != -1 && queue_.size() >= max_queue_size_;
+  const int max_queue_size = max_queue_size_;
+  return max_queue_size != -1 && QueueSize() >= max_queue_size;
 }
 
 Timestamp InputStreamManager::GetMinTimestampAmongNLatest(int n) const {
+  DCHECK(!ring_) << "Stream \"" << name_ << "\" reads packet batches.";
   absl::MutexLock lock(&stream_mutex_);
   if (queue_.empty()) {
     return Timestamp::Unset();
@@ -371,12 +507,14 @@ Timestamp InputStreamManager::GetMinTimestampAmongNLatest(int n) const {
 }
 
 void InputStreamManager::ErasePacketsEarlierThan(Timestamp timestamp) {
+  DCHECK(!ring_) << "Stream \"" << name_ << "\" reads packet batches.";
   bool queue_became_non_full = false;
   {
     absl::MutexLock lock(&stream_mutex_);
     // Checks if queue is full.
+    const int max_queue_size = max_queue_size_;
     bool was_queue_full =
-        (max_queue_size_ != -1 && queue_.size() >= max_queue_size_);
+        (max_queue_size != -1 && queue_.size() >= max_queue_size);
 
     while (!queue_.empty() && queue_.front().Timestamp() < timestamp) {
       queue_.pop_front();
@@ -384,7 +522,7 @@ void InputStreamManager::ErasePacketsEarlierThan(Timestamp timestamp) {
 
     VLOG(3) << "Input stream removed packets:" << name_
             << " Size:" << queue_.size();
-    queue_became_non_full = (was_queue_full && queue_.size() < max_queue_size_);
+    queue_became_non_full = (was_queue_full && queue_.size() < max_queue_size);
   }
   if (queue_became_non_full) {
     VLOG(3) << "Queue became non-full: " << Name();
@@ -393,7 +531,9 @@ void InputStreamManager::ErasePacketsEarlierThan(Timestamp timestamp) {
 }
 
 bool InputStreamManager::IsDone() const {
-  return queue_.empty() && next_timestamp_bound_ == Timestamp::Done();
+  // Reads the bound first, for the reason given in MinTimestampOrBound().
+  const Timestamp bound = next_timestamp_bound_;
+  return bound == Timestamp::Done() && QueueIsEmpty();
 }
 
 }  // namespace mediapipe
@@ -15,6 +15,7 @@
 #ifndef MEDIAPIPE_FRAMEWORK_INPUT_STREAM_MANAGER_H_
 #define MEDIAPIPE_FRAMEWORK_INPUT_STREAM_MANAGER_H_
 
+#include <atomic>
 #include <deque>
 #include <functional>
 #include <list>
@@ -23,6 +24,7 @@
 #include "absl/base/thread_annotations.h"
 #include "absl/synchronization/mutex.h"
 #include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/packet_batch_ring.h"
 #include "mediapipe/framework/packet_type.h"
 #include "mediapipe/framework/port.h"
 #include "mediapipe/framework/port/integral_types.h"
@@ -43,6 +45,14 @@ namespace mediapipe {
 // An input stream is written to by exactly one output stream and is read by a
 // single node. None of its methods should hold a lock when they invoke a
 // callback in the scheduler.
+//
+// By default the InputStreamManager keeps its own packet queue, which the
+// producer and the consumer both access under stream_mutex_. After
+// ReadPacketBatchesFrom(), it instead reads the packets from the
+// PacketBatchRing of its output stream, which holds one copy of each packet
+// for all the mirrors of the stream. The producer then adds packets and
+// timestamp bounds without locking, and stream_mutex_ only serializes the
+// calls of the consumer.
 class InputStreamManager {
  public:
   // Function type for becomes_full_callback and becomes_not_full_callback.
@@ -95,6 +105,24 @@ class InputStreamManager {
   // move, all packets in the container must be empty.
   ::mediapipe::Status MovePackets(std::list<Packet>* container, bool* notify);
 
+  // Makes the stream read its packets from the given ring, which must outlive
+  // it, instead of from a queue of its own. The packets are then added with
+  // AddPacketBatch() rather than AddPackets() or MovePackets(), and Close()
+  // drops the queued packets. Does not support GetMinTimestampAmongNLatest()
+  // or ErasePacketsEarlierThan().
+  void ReadPacketBatchesFrom(const PacketBatchRing* ring)
+      ABSL_LOCKS_EXCLUDED(stream_mutex_);
+
+  // Returns true if the stream reads its packets from a PacketBatchRing.
+  bool ReadsPacketBatches() const { return ring_ != nullptr; }
+
+  // Adds the packets of a batch published to the ring. Sets "notify" to true
+  // if the queue becomes non-empty. Does nothing if the input stream is
+  // closed. The packets must meet the requirements of AddPackets(). If they do
+  // not, none of them is added, and neither are the packets of later batches.
+  ::mediapipe::Status AddPacketBatch(PacketBatchRing::Batch* batch,
+                                     bool* notify);
+
   // Closes the input stream.  This function can be called multiple times.
   void Close() ABSL_LOCKS_EXCLUDED(stream_mutex_);
 
@@ -186,22 +214,47 @@ class InputStreamManager {
                                                bool* notify)
       ABSL_LOCKS_EXCLUDED(stream_mutex_);
 
+  // Checks a packet before it is added to the stream.
+  ::mediapipe::Status ValidatePacket(const Packet& packet,
+                                     Timestamp next_timestamp_bound) const;
+
+  // Raises next_timestamp_bound_ to bound. Returns false if it was already
+  // at least as large.
+  bool RaiseNextTimestampBound(Timestamp bound);
+
   // Returns true if the next timestamp bound reaches Timestamp::Done().
   bool IsDone() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(stream_mutex_);
 
   // Returns the smallest timestamp at which this stream might see an input.
   Timestamp MinTimestampOrBoundHelper() const;
 
+  // Accessors for the packet queue, which is either queue_ or reader_.
+  bool QueueIsEmpty() const;
+  int QueueSizeHelper() const;
+  const Packet& QueueFront() const;
+  Packet PopQueueFront();
+
   mutable absl::Mutex stream_mutex_;
   std::deque<Packet> queue_ ABSL_GUARDED_BY(stream_mutex_);
-  // The number of packets added to queue_.  Used to verify a packet at
-  // Timestamp::PostStream() is the only Packet in the stream.
-  int64 num_packets_added_ ABSL_GUARDED_BY(stream_mutex_);
-  Timestamp next_timestamp_bound_ ABSL_GUARDED_BY(stream_mutex_);
+  // The ring the packets are read from if ReadPacketBatchesFrom() was called,
+  // and the unread packets there.
+  const PacketBatchRing* ring_ = nullptr;
+  PacketBatchRing::Reader reader_;
+  // Set when a packet batch fails AddPacketBatch(), since the reader cannot
+  // skip it and take the next one.
+  bool rejected_batch_ = false;
+  // The number of packets added to the stream.  Used to verify a packet at
+  // Timestamp::PostStream() is the only Packet in the stream.  Only accessed
+  // by the producer.
+  int64 num_packets_added_;
   // The |timestamp| argument passed to the last SelectAtTimestamp() call.
   // Ignored if enable_timestamps_ is false.
   Timestamp last_select_timestamp_ ABSL_GUARDED_BY(stream_mutex_);
-  bool closed_ ABSL_GUARDED_BY(stream_mutex_);
+  // The next timestamp bound and the closed state are atomic, since the
+  // producer of a stream reading packet batches updates them without holding
+  // stream_mutex_.
+  std::atomic<Timestamp> next_timestamp_bound_;
+  std::atomic<bool> closed_;
   // True if packet timestamps are used.
   bool enable_timestamps_ = true;
   std::string name_;
@@ -210,8 +263,9 @@ class InputStreamManager {
   // The header packet of the input stream.
   Packet header_;
 
-  // The maximum queue size for this stream if set.
-  int max_queue_size_ ABSL_GUARDED_BY(stream_mutex_) = -1;
+  // The maximum queue size for this stream if set.  Atomic for the same
+  // reason as next_timestamp_bound_.
+  std::atomic<int> max_queue_size_{-1};
 
   // Callback to notify the framework that we have hit the maximum queue size.
   QueueSizeCallback becomes_full_callback_;
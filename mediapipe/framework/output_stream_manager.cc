@@ -81,7 +81,13 @@ void OutputStreamManager::PropagateHeader() {
 void OutputStreamManager::AddMirror(InputStreamHandler* input_stream_handler,
                                     CollectionItemId id) {
   CHECK(input_stream_handler);
-  mirrors_.emplace_back(input_stream_handler, id);
+  const bool reads_packet_batches = input_stream_handler->ReadsPacketBatches();
+  if (reads_packet_batches) {
+    input_stream_handler->GetInputStreamManager(id)->ReadPacketBatchesFrom(
+        &ring_);
+    ++num_batch_readers_;
+  }
+  mirrors_.emplace_back(input_stream_handler, id, reads_packet_batches);
 }
 
 void OutputStreamManager::SetMaxQueueSize(int max_queue_size) {
@@ -183,12 +189,30 @@ void OutputStreamManager::PropagateUpdatesToMirrors(
        packets_to_propagate->back().Timestamp().NextAllowedInStream() !=
            next_timestamp_bound);
   int mirror_count = mirrors_.size();
+  // The mirrors reading packet batches share a single copy of the packets.
+  // It takes them from output_queue_ unless another mirror needs them.
+  PacketBatchRing::Batch batch;
+  int last_queue_mirror = -1;
+  if (add_packets) {
+    for (int idx = 0; idx < mirror_count; ++idx) {
+      if (!mirrors_[idx].reads_packet_batches) {
+        last_queue_mirror = idx;
+      }
+    }
+    if (num_batch_readers_ > 0) {
+      batch = last_queue_mirror == -1
+                  ? ring_.Publish(packets_to_propagate, num_batch_readers_)
+                  : ring_.Publish(*packets_to_propagate, num_batch_readers_);
+    }
+  }
   for (int idx = 0; idx < mirror_count; ++idx) {
     const Mirror& mirror = mirrors_[idx];
     if (add_packets) {
-      // If the stream is the last element in mirrors_, moves packets from
-      // output_queue_. Otherwise, copies the packets.
-      if (idx == mirror_count - 1) {
+      if (mirror.reads_packet_batches) {
+        mirror.input_stream_handler->AddPacketBatch(mirror.id, &batch);
+      } else if (idx == last_queue_mirror) {
+        // The last mirror keeping a queue of its own moves packets from
+        // output_queue_. The others copy the packets.
         mirror.input_stream_handler->MovePackets(mirror.id,
                                                  packets_to_propagate);
       } else {
@@ -201,6 +225,9 @@ void OutputStreamManager::PropagateUpdatesToMirrors(
                                                          next_timestamp_bound);
     }
   }
+  if (add_packets && num_batch_readers_ > 0) {
+    ring_.Finish(&batch);
+  }
   // Clear out the packets.
   packets_to_propagate->clear();
 }
@@ -22,6 +22,7 @@
 #include "absl/synchronization/mutex.h"
 #include "mediapipe/framework/output_stream_shard.h"
 #include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/packet_batch_ring.h"
 #include "mediapipe/framework/packet_type.h"
 #include "mediapipe/framework/port.h"
 #include "mediapipe/framework/port/status.h"
@@ -75,6 +76,8 @@ class OutputStreamManager {
   // Adds an InputStreamImpl, which is represented as a pointer to an
   // InputStreamHandler and a CollectionItemId, to mirrors_.
   // The caller retains the ownership of the InputStreamHandler.
+  // If the handler reads packet batches, the input stream reads the packets
+  // from ring_ from then on.
   void AddMirror(InputStreamHandler* input_stream_handler, CollectionItemId id);
 
   // Sets the maximum queue size on all mirrors.
@@ -94,7 +97,9 @@ class OutputStreamManager {
       Timestamp input_timestamp) const;
 
   // Propagates the updates to the mirrors and clears the packet queue in
-  // the OutputStreamShard afterwards.
+  // the OutputStreamShard afterwards. The packets are published to ring_ once
+  // for all the mirrors reading packet batches, so this must not be called
+  // concurrently for the same stream.
   void PropagateUpdatesToMirrors(Timestamp next_timestamp_bound,
                                  OutputStreamShard* output_stream_shard);
 
@@ -105,17 +110,25 @@ class OutputStreamManager {
  private:
   // The necessary information to locate an InputStreamImpl.
   struct Mirror {
-    Mirror(InputStreamHandler* input_stream_handler, const CollectionItemId& id)
-        : input_stream_handler(input_stream_handler), id(id) {}
+    Mirror(InputStreamHandler* input_stream_handler, const CollectionItemId& id,
+           bool reads_packet_batches)
+        : input_stream_handler(input_stream_handler),
+          id(id),
+          reads_packet_batches(reads_packet_batches) {}
 
     InputStreamHandler* const input_stream_handler;
     const CollectionItemId id;
+    const bool reads_packet_batches;
   };
 
   // The output stream spec shared across all output stream shards and the
   // output stream manager.
   OutputStreamSpec output_stream_spec_;
   std::vector<Mirror> mirrors_;
+  // The packets sent to the mirrors reading packet batches, and the number of
+  // those mirrors.
+  PacketBatchRing ring_;
+  int num_batch_readers_ = 0;
 
   mutable absl::Mutex stream_mutex_;
   Timestamp next_timestamp_bound_ ABSL_GUARDED_BY(stream_mutex_);
@@ -15,14 +15,19 @@
 #include "mediapipe/framework/output_stream_manager.h"
 
 #include <memory>
+#include <vector>
 
 #include "absl/memory/memory.h"
+#include "mediapipe/framework/calculator_context_manager.h"
+#include "mediapipe/framework/calculator_state.h"
 #include "mediapipe/framework/input_stream_handler.h"
 #include "mediapipe/framework/input_stream_manager.h"
 #include "mediapipe/framework/output_stream_shard.h"
 #include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/port/benchmark.h"
 #include "mediapipe/framework/port/gmock.h"
 #include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/status_matchers.h"
 #include "mediapipe/framework/tool/tag_map_helper.h"
 
@@ -690,5 +695,94 @@ TEST_F(OutputStreamManagerTest, AddPacketAndMovePacket) {
   EXPECT_TRUE(errors_.empty());
 }
 
+// A downstream node with a single input stream, which mirrors an output stream.
+struct MirrorNode {
+  MirrorNode(int node_id, const PacketType* packet_type,
+             OutputStreamManager* output_stream_manager) {
+    std::shared_ptr<tool::TagMap> tag_map = tool::CreateTagMap(1).ValueOrDie();
+    calculator_state = absl::make_unique<CalculatorState>(
+        "Node", node_id, "Calculator", CalculatorGraphConfig::Node(), nullptr);
+    cc_manager.Initialize(calculator_state.get(), tag_map,
+                          /*output_tag_map=*/tool::CreateTagMap(0).ValueOrDie(),
+                          /*calculator_run_in_parallel=*/false);
+    input_stream_handler =
+        InputStreamHandlerRegistry::CreateByName(
+            "DefaultInputStreamHandler", tag_map, &cc_manager,
+            MediaPipeOptions(), /*calculator_run_in_parallel=*/false)
+            .ValueOrDie();
+    MEDIAPIPE_CHECK_OK(input_stream_manager.Initialize("input", packet_type,
+                                                       /*back_edge=*/false));
+    MEDIAPIPE_CHECK_OK(input_stream_handler->InitializeInputStreamManagers(
+        &input_stream_manager));
+    MEDIAPIPE_CHECK_OK(cc_manager.PrepareForRun(
+        [](CalculatorContext*) { return ::mediapipe::OkStatus(); }));
+    input_stream_handler->PrepareForRun(
+        [] {}, [] {}, [](CalculatorContext*) {},
+        [](::mediapipe::Status status) { MEDIAPIPE_CHECK_OK(status); });
+    input_stream_handler->SetQueueSizeCallbacks(
+        [](InputStreamManager*, bool*) {}, [](InputStreamManager*, bool*) {});
+    output_stream_manager->AddMirror(input_stream_handler.get(),
+                                     tag_map->BeginId());
+  }
+
+  std::unique_ptr<CalculatorState> calculator_state;
+  CalculatorContextManager cc_manager;
+  std::unique_ptr<InputStreamHandler> input_stream_handler;
+  InputStreamManager input_stream_manager;
+};
+
+TEST_F(OutputStreamManagerTest, PropagatesToManyMirrors) {
+  std::vector<std::unique_ptr<MirrorNode>> nodes;
+  for (int i = 0; i < 3; ++i) {
+    nodes.push_back(absl::make_unique<MirrorNode>(i, &packet_type_,
+                                                  output_stream_manager_.get()));
+  }
+  Packet packet = MakePacket<std::string>("packet").At(Timestamp(10));
+  output_stream_shard_.AddPacket(packet);
+  EXPECT_EQ(Timestamp(11), ComputeBoundAndPropagateUpdates(Timestamp(10)));
+  EXPECT_EQ(packet, input_stream_manager_.QueueHead());
+  for (auto& node : nodes) {
+    // All mirrors share the packet's data.
+    EXPECT_EQ(packet, node->input_stream_manager.QueueHead());
+  }
+  EXPECT_TRUE(errors_.empty());
+}
+
+// Fans out an output stream to state.range(0) default input stream handlers,
+// each of which then pops the packet as its node would.
+void BM_PropagateUpdatesToMirrors(benchmark::State& state) {
+  PacketType packet_type;
+  packet_type.Set<int>();
+  OutputStreamManager output_stream_manager;
+  MEDIAPIPE_CHECK_OK(output_stream_manager.Initialize("output", &packet_type));
+  output_stream_manager.PrepareForRun(
+      [](::mediapipe::Status status) { MEDIAPIPE_CHECK_OK(status); });
+  OutputStreamShard output_stream_shard;
+  output_stream_shard.SetSpec(output_stream_manager.Spec());
+  std::vector<std::unique_ptr<MirrorNode>> nodes;
+  for (int i = 0; i < state.range(0); ++i) {
+    nodes.push_back(
+        absl::make_unique<MirrorNode>(i, &packet_type, &output_stream_manager));
+  }
+
+  int64 timestamp = 0;
+  for (auto _ : state) {
+    output_stream_manager.ResetShard(&output_stream_shard);
+    output_stream_shard.AddPacket(
+        MakePacket<int>(timestamp).At(Timestamp(timestamp)));
+    output_stream_manager.PropagateUpdatesToMirrors(Timestamp(timestamp + 1),
+                                                    &output_stream_shard);
+    for (auto& node : nodes) {
+      int num_packets_dropped;
+      bool stream_is_done;
+      benchmark::DoNotOptimize(node->input_stream_manager.PopPacketAtTimestamp(
+          Timestamp(timestamp), &num_packets_dropped, &stream_is_done));
+    }
+    ++timestamp;
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PropagateUpdatesToMirrors)->Range(1, 64);
+
 }  // namespace
 }  // namespace mediapipe
@@ -16,11 +16,29 @@
 #define MEDIAPIPE_FRAMEWORK_OUTPUT_STREAM_POLLER_H_
 
 #include <memory>
+#include <vector>
 
 #include "mediapipe/framework/graph_output_stream.h"
 
 namespace mediapipe {
 
+// Options for CalculatorGraph::AddOutputStreamPoller.
+struct OutputStreamPollerOptions {
+  // If positive, the packets are handed over to the poller through a
+  // lock-free single-producer, single-consumer ring holding this many packets,
+  // rounded up to a power of 2.  The graph then only wakes up a poller that
+  // waits in Next(), which saves a mutex and a condition variable signal per
+  // packet.  The packets that do not fit in the ring wait in the regular
+  // queue.  Both count towards the maximum queue size, see
+  // OutputStreamPoller::SetMaxQueueSize.  Since the ring has a single
+  // consumer, Next(), NextBatch() and TryNext() must not be called
+  // concurrently.
+  int ring_capacity = 0;
+  // With a ring, the number of times Next() checks for a packet before it
+  // waits for the graph to wake it up.
+  int spin_iterations = 0;
+};
+
 // The public interface of output stream poller.
 class OutputStreamPoller {
  public:
@@ -48,6 +66,30 @@ class OutputStreamPoller {
     return poller->Next(packet);
   }
 
+  // Gets the next packets, up to max_packets of them (block until at least
+  // one is available or the stream is done).  Appends them to packets, and
+  // returns true if successful.
+  ABSL_MUST_USE_RESULT bool NextBatch(std::vector<Packet>* packets,
+                                      int max_packets) {
+    auto poller = internal_poller_impl_.lock();
+    if (!poller) {
+      return false;
+    }
+    return poller->NextBatch(packets, max_packets);
+  }
+
+  // Gets the next packet if it is available, without blocking.  Returns true
+  // if successful.
+  ABSL_MUST_USE_RESULT bool TryNext(Packet* packet) {
+    auto poller = internal_poller_impl_.lock();
+    if (!poller) {
+      return false;
+    }
+    return poller->TryNext(packet);
+  }
+
+  // Sets the number of packets waiting for Next() at which the graph is
+  // throttled, or -1 for no limit.  With a ring, the bound is at least 2.
   void SetMaxQueueSize(int queue_size) {
     auto poller = internal_poller_impl_.lock();
     CHECK(poller) << "OutputStreamPollerImpl is already destroyed.";
@@ -25,22 +25,104 @@
 namespace mediapipe {
 namespace packet_internal {
 
+namespace {
+
+// Holder allocations are rounded up to a multiple of kSizeClassBytes, and
+// those up to kNumSizeClasses * kSizeClassBytes are pooled.  This covers
+// Holder<T> and InlineHolder<T> for every inline payload.
+constexpr size_t kSizeClassBytes = 32;
+constexpr int kNumSizeClasses = 2;
+// The maximum number of free blocks cached per thread and size class.
+constexpr int kMaxFreeBlocks = 1024;
+
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+// The free lists of the current thread.  This is trivially destructible, so
+// that holders destroyed late in thread shutdown can still check shut_down.
+struct FreeLists {
+  FreeBlock* head[kNumSizeClasses];
+  int length[kNumSizeClasses];
+  bool registered;
+  bool shut_down;
+};
+thread_local FreeLists free_lists;
+
+// Returns the cached blocks of the current thread to the global allocator
+// when the thread exits.
+struct FreeListsReleaser {
+  ~FreeListsReleaser() {
+    for (int i = 0; i < kNumSizeClasses; ++i) {
+      while (FreeBlock* block = free_lists.head[i]) {
+        free_lists.head[i] = block->next;
+        ::operator delete(block);
+      }
+      free_lists.length[i] = 0;
+    }
+    free_lists.shut_down = true;
+  }
+};
+
+// Returns the size class for an allocation of size bytes, or -1 if such
+// allocations are not pooled.
+int SizeClass(size_t size) {
+  int size_class = static_cast<int>((size - 1) / kSizeClassBytes);
+  return size_class < kNumSizeClasses ? size_class : -1;
+}
+
+}  // namespace
+
 HolderBase::~HolderBase() {}
 
+void* HolderBase::operator new(size_t size) {
+  int size_class = SizeClass(size);
+  if (size_class < 0) {
+    return ::operator new(size);
+  }
+  FreeLists& lists = free_lists;
+  if (FreeBlock* block = lists.head[size_class]) {
+    lists.head[size_class] = block->next;
+    --lists.length[size_class];
+    return block;
+  }
+  // Allocate the full size class, so that the block can be reused for any
+  // holder of the same class.
+  return ::operator new((size_class + 1) * kSizeClassBytes);
+}
+
+void HolderBase::operator delete(void* ptr, size_t size) {
+  int size_class = SizeClass(size);
+  FreeLists& lists = free_lists;
+  if (size_class < 0 || lists.shut_down ||
+      lists.length[size_class] >= kMaxFreeBlocks) {
+    ::operator delete(ptr);
+    return;
+  }
+  if (!lists.registered) {
+    static thread_local FreeListsReleaser releaser;
+    lists.registered = true;
+  }
+  FreeBlock* block = static_cast<FreeBlock*>(ptr);
+  block->next = lists.head[size_class];
+  lists.head[size_class] = block;
+  ++lists.length[size_class];
+}
+
 Packet Create(HolderBase* holder) {
   Packet result;
-  result.holder_.reset(holder);
+  result.holder_ = HolderPtr(holder);
   return result;
 }
 
 Packet Create(HolderBase* holder, Timestamp timestamp) {
   Packet result;
-  result.holder_.reset(holder);
+  result.holder_ = HolderPtr(holder);
   result.timestamp_ = timestamp;
   return result;
 }
 
-Packet Create(std::shared_ptr<HolderBase> holder, Timestamp timestamp) {
+Packet Create(HolderPtr holder, Timestamp timestamp) {
   Packet result;
   result.holder_ = std::move(holder);
   result.timestamp_ = timestamp;
@@ -119,7 +201,7 @@ std::string Packet::DebugString() const {
 }
 
 const proto_ns::MessageLite& Packet::GetProtoMessageLite() const {
-  CHECK(holder_ != nullptr) << "The packet is empty.";
+  CHECK(holder_) << "The packet is empty.";
   const proto_ns::MessageLite* proto = holder_->GetProtoMessageLite();
   CHECK(proto != nullptr) << "The Packet stores '" << holder_->DebugTypeName()
                           << "', it cannot be converted to MessageLite type.";
@@ -128,7 +210,7 @@ const proto_ns::MessageLite& Packet::GetProtoMessageLite() const {
 
 StatusOr<std::vector<const proto_ns::MessageLite*>>
 Packet::GetVectorOfProtoMessageLitePtrs() {
-  if (holder_ == nullptr) {
+  if (!holder_) {
     return ::mediapipe::InternalError("Packet is empty.");
   }
   return holder_->GetVectorOfProtoMessageLite();
@@ -17,6 +17,7 @@
 #ifndef MEDIAPIPE_FRAMEWORK_PACKET_H_
 #define MEDIAPIPE_FRAMEWORK_PACKET_H_
 
+#include <atomic>
 #include <cstddef>
 #include <memory>
 #include <string>
@@ -47,14 +48,59 @@ class Packet;
 
 namespace packet_internal {
 class HolderBase;
+class HolderPtr;
+template <typename T>
+class InlineHolder;
+
+// The largest payload MakePacket stores inside the holder itself.
+constexpr size_t kMaxInlinePayloadSize = 32;
+
+// True for payloads that MakePacket stores inside the holder instead of in a
+// separate heap allocation: small, trivially copyable, non-array objects.
+template <typename T>
+struct is_inline_payload
+    : public std::integral_constant<
+          bool, !std::is_array<T>::value &&
+                    std::is_trivially_copyable<T>::value &&
+                    sizeof(T) <= kMaxInlinePayloadSize &&
+                    alignof(T) <= alignof(std::max_align_t)> {};
 
 Packet Create(HolderBase* holder);
 Packet Create(HolderBase* holder, Timestamp timestamp);
-Packet Create(std::shared_ptr<HolderBase> holder, Timestamp timestamp);
+Packet Create(HolderPtr holder, Timestamp timestamp);
 const HolderBase* GetHolder(const Packet& packet);
-const std::shared_ptr<HolderBase>& GetHolderShared(const Packet& packet);
+const HolderPtr& GetHolderShared(const Packet& packet);
 ::mediapipe::StatusOr<Packet> PacketFromDynamicProto(
     const std::string& type_name, const std::string& serialized);
+
+// An intrusive reference-counted pointer to a HolderBase.  Unlike
+// std::shared_ptr, it needs no separately allocated control block: the
+// reference count lives in the HolderBase itself.
+class HolderPtr {
+ public:
+  HolderPtr() = default;
+  // Adopts the initial reference of a newly allocated holder.
+  explicit HolderPtr(HolderBase* holder) : holder_(holder) {}
+  HolderPtr(const HolderPtr& other);
+  HolderPtr& operator=(const HolderPtr& other);
+  HolderPtr(HolderPtr&& other) : holder_(other.holder_) {
+    other.holder_ = nullptr;
+  }
+  HolderPtr& operator=(HolderPtr&& other);
+  ~HolderPtr() { reset(); }
+
+  HolderBase* get() const { return holder_; }
+  HolderBase* operator->() const { return holder_; }
+  explicit operator bool() const { return holder_ != nullptr; }
+  // Returns true if this is the only reference to the holder.
+  bool unique() const;
+  // Drops the reference to the holder, if any.
+  void reset();
+
+ private:
+  HolderBase* holder_ = nullptr;
+};
+
 }  // namespace packet_internal
 
 // A generic container class which can hold data of any type.  The type of
@@ -207,15 +253,14 @@ class Packet {
   friend Packet packet_internal::Create(packet_internal::HolderBase* holder);
   friend Packet packet_internal::Create(packet_internal::HolderBase* holder,
                                         class Timestamp timestamp);
-  friend Packet packet_internal::Create(
-      std::shared_ptr<packet_internal::HolderBase> holder,
-      class Timestamp timestamp);
+  friend Packet packet_internal::Create(packet_internal::HolderPtr holder,
+                                        class Timestamp timestamp);
   friend const packet_internal::HolderBase* packet_internal::GetHolder(
       const Packet& packet);
-  friend const std::shared_ptr<packet_internal::HolderBase>&
-  packet_internal::GetHolderShared(const Packet& packet);
+  friend const packet_internal::HolderPtr& packet_internal::GetHolderShared(
+      const Packet& packet);
 
-  std::shared_ptr<packet_internal::HolderBase> holder_;
+  packet_internal::HolderPtr holder_;
   class Timestamp timestamp_;
 };
 
@@ -298,12 +343,25 @@ Packet AdoptAsSyncedPacket(const T* ptr) {
 //
 // Version for scalars.
 template <typename T,
-          typename std::enable_if<!std::is_array<T>::value>::type* = nullptr,
+          typename std::enable_if<
+              !std::is_array<T>::value &&
+              !packet_internal::is_inline_payload<T>::value>::type* = nullptr,
           typename... Args>
 Packet MakePacket(Args&&... args) {  // NOLINT(build/c++11)
   return Adopt(new T(std::forward<Args>(args)...));
 }
 
+// Version for small trivially copyable scalars, which are stored inside the
+// packet's holder so that creating the packet takes a single allocation.
+template <typename T,
+          typename std::enable_if<
+              packet_internal::is_inline_payload<T>::value>::type* = nullptr,
+          typename... Args>
+Packet MakePacket(Args&&... args) {  // NOLINT(build/c++11)
+  return packet_internal::Create(
+      new packet_internal::InlineHolder<T>(std::forward<Args>(args)...));
+}
+
 // Version for arrays. We have to use reinterpret_cast because new T[N]
 // returns a T* instead of a T(*)[N] (i.e. a pointer to the first element
 // instead of a pointer to the array itself - they have the same value, but
@@ -340,6 +398,10 @@ class HolderBase {
   HolderBase(const HolderBase&) = delete;
   HolderBase& operator=(const HolderBase&) = delete;
   virtual ~HolderBase();
+  // Holders are small and short-lived, so they are recycled through a
+  // per-thread free list instead of going to the global allocator each time.
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr, size_t size);
   template <typename T>
   void SetHolderTypeId() {
     type_id_ = tool::GetTypeHash<T>();
@@ -375,8 +437,20 @@ class HolderBase {
   virtual StatusOr<std::vector<const proto_ns::MessageLite*>>
   GetVectorOfProtoMessageLite() = 0;
 
+  // Returns true if the data is stored inside the holder itself.
+  bool HasInlineData() const { return has_inline_data_; }
+
+ protected:
+  void SetHasInlineData() { has_inline_data_ = true; }
+
  private:
+  friend class HolderPtr;
+
   size_t type_id_;
+  // The number of HolderPtrs referring to this holder.  A new holder starts
+  // with the reference that is adopted by its first HolderPtr.
+  mutable std::atomic<int> ref_count_{1};
+  bool has_inline_data_ = false;
 };
 
 // Two helper functions to get the proto base pointers.
@@ -500,6 +574,10 @@ class Holder : public HolderBase {
       return InternalError(
           "Foreign holder can't release data ptr without ownership.");
     }
+    // Inline data is destroyed along with the holder, so hand out a copy.
+    if (HasInlineData()) {
+      return CopyInlineData();
+    }
     // Casts away constness to make the data mutable after the release.
     std::unique_ptr<T> data_ptr(const_cast<T*>(ptr_));
     ptr_ = nullptr;
@@ -545,6 +623,18 @@ class Holder : public HolderBase {
   }
 
  private:
+  // Only non-array types are stored inline, see is_inline_payload.
+  template <typename U = T>
+  std::unique_ptr<T> CopyInlineData(
+      typename std::enable_if<!std::is_array<U>::value>::type* = 0) const {
+    return absl::make_unique<T>(*ptr_);
+  }
+  template <typename U = T>
+  std::unique_ptr<T> CopyInlineData(
+      typename std::enable_if<std::is_array<U>::value>::type* = 0) const {
+    return nullptr;
+  }
+
   // Call delete[] if T is an array, delete otherwise.
   template <typename U = T>
   inline void delete_helper(
@@ -581,6 +671,62 @@ class ForeignHolder : public Holder<T> {
   }
 };
 
+// Like Holder, but stores a small, trivially copyable object inside the holder
+// itself rather than owning a separately allocated one.
+template <typename T>
+class InlineHolder : public Holder<T> {
+ public:
+  template <typename... Args>
+  explicit InlineHolder(Args&&... args)
+      : Holder<T>(nullptr), data_(std::forward<Args>(args)...) {
+    this->ptr_ = &data_;
+    this->SetHasInlineData();
+  }
+  ~InlineHolder() override {
+    // Null out ptr_ so it doesn't get deleted by ~Holder.
+    this->ptr_ = nullptr;
+  }
+
+ private:
+  T data_;
+};
+
+inline HolderPtr::HolderPtr(const HolderPtr& other) : holder_(other.holder_) {
+  if (holder_) {
+    holder_->ref_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+inline HolderPtr& HolderPtr::operator=(const HolderPtr& other) {
+  if (other.holder_) {
+    other.holder_->ref_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+  reset();
+  holder_ = other.holder_;
+  return *this;
+}
+
+inline HolderPtr& HolderPtr::operator=(HolderPtr&& other) {
+  if (this != &other) {
+    reset();
+    holder_ = other.holder_;
+    other.holder_ = nullptr;
+  }
+  return *this;
+}
+
+inline bool HolderPtr::unique() const {
+  return holder_ && holder_->ref_count_.load(std::memory_order_acquire) == 1;
+}
+
+inline void HolderPtr::reset() {
+  if (holder_ &&
+      holder_->ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete holder_;
+  }
+  holder_ = nullptr;
+}
+
 template <typename T>
 Holder<T>* HolderBase::As() {
   if (HolderIsOfType<Holder<T>>() || HolderIsOfType<ForeignHolder<T>>()) {
@@ -729,7 +875,7 @@ inline Packet& Packet::operator=(Packet&& packet) {
   return *this;
 }
 
-inline bool Packet::IsEmpty() const { return holder_ == nullptr; }
+inline bool Packet::IsEmpty() const { return !holder_; }
 
 inline size_t Packet::GetTypeId() const {
   CHECK(holder_);
@@ -786,8 +932,7 @@ inline bool operator!=(const Packet& p1, const Packet& p2) {
 
 namespace packet_internal {
 
-inline const std::shared_ptr<HolderBase>& GetHolderShared(
-    const Packet& packet) {
+inline const HolderPtr& GetHolderShared(const Packet& packet) {
   return packet.holder_;
 }
 
@@ -0,0 +1,185 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/packet_batch_ring.h"
+
+#include <type_traits>
+#include <utility>
+
+#include "mediapipe/framework/port/logging.h"
+
+namespace mediapipe {
+
+struct PacketBatchRing::Segment {
+  ~Segment() {
+    // Frees the chain of segments that only this one refers to iteratively,
+    // so that a long queue does not recurse once per segment.
+    std::shared_ptr<Segment> segment = std::move(next);
+    while (segment && segment.use_count() == 1) {
+      segment = std::move(segment->next);
+    }
+  }
+
+  Packet packets[kSegmentSize];
+  // The number of readers that have yet to consume each slot.
+  std::atomic<int> readers_left[kSegmentSize];
+  // Set by the producer before it publishes the first slot of the next
+  // segment.
+  std::shared_ptr<Segment> next;
+};
+
+namespace {
+
+// Drops one reader's reference to a slot.  The last reader releases the
+// packet.
+void ReleaseSlot(PacketBatchRing::Segment* segment, int index) {
+  if (segment->readers_left[index].fetch_sub(1, std::memory_order_acq_rel) ==
+      1) {
+    segment->packets[index] = Packet();
+  }
+}
+
+}  // namespace
+
+const Packet& PacketBatchRing::Batch::packet(int i) const {
+  DCHECK_LT(i, size_);
+  const Segment* segment = segment_.get();
+  int index = index_ + i;
+  while (index >= kSegmentSize) {
+    segment = segment->next.get();
+    index -= kSegmentSize;
+  }
+  return segment->packets[index];
+}
+
+PacketBatchRing::PacketBatchRing() : tail_(std::make_shared<Segment>()) {}
+
+PacketBatchRing::Batch PacketBatchRing::Publish(
+    const std::list<Packet>& packets, int num_readers) {
+  return PublishInternal<const std::list<Packet>&>(packets, num_readers);
+}
+
+PacketBatchRing::Batch PacketBatchRing::Publish(std::list<Packet>* packets,
+                                                int num_readers) {
+  return PublishInternal<std::list<Packet>&>(*packets, num_readers);
+}
+
+template <typename Container>
+PacketBatchRing::Batch PacketBatchRing::PublishInternal(Container packets,
+                                                        int num_readers) {
+  Batch batch;
+  batch.num_readers_ = num_readers;
+  for (auto& packet : packets) {
+    if (tail_size_ == kSegmentSize) {
+      tail_->next = std::make_shared<Segment>();
+      tail_ = tail_->next;
+      tail_size_ = 0;
+    }
+    if (batch.size_ == 0) {
+      batch.segment_ = tail_;
+      batch.index_ = tail_size_;
+    }
+    if (std::is_const<
+            typename std::remove_reference<Container>::type>::value) {
+      tail_->packets[tail_size_] = packet;
+    } else {
+      tail_->packets[tail_size_] = std::move(packet);
+    }
+    tail_->readers_left[tail_size_].store(num_readers,
+                                          std::memory_order_relaxed);
+    ++tail_size_;
+    ++batch.size_;
+  }
+  return batch;
+}
+
+void PacketBatchRing::Finish(Batch* batch) {
+  const int num_skipped = batch->num_readers_ - batch->num_appended_;
+  CHECK_GE(num_skipped, 0);
+  if (num_skipped > 0) {
+    Segment* segment = batch->segment_.get();
+    int index = batch->index_;
+    for (int i = 0; i < batch->size_; ++i, ++index) {
+      if (index == kSegmentSize) {
+        segment = segment->next.get();
+        index = 0;
+      }
+      if (segment->readers_left[index].fetch_sub(
+              num_skipped, std::memory_order_acq_rel) == num_skipped) {
+        segment->packets[index] = Packet();
+      }
+    }
+  }
+  batch->segment_.reset();
+}
+
+PacketBatchRing::Reader::~Reader() { Clear(); }
+
+void PacketBatchRing::Reader::Reset(const PacketBatchRing& ring) {
+  Clear();
+  segment_ = ring.tail_;
+  index_ = ring.tail_size_;
+  available_.store(0);
+  consumed_.store(0);
+}
+
+void PacketBatchRing::Reader::Clear() {
+  if (!segment_) {
+    return;
+  }
+  const int64 available = available_.load();
+  while (consumed_.load(std::memory_order_relaxed) < available) {
+    PopFront();
+  }
+  segment_.reset();
+}
+
+const Packet& PacketBatchRing::Reader::Front() const {
+  DCHECK(!IsEmpty());
+  if (index_ == kSegmentSize) {
+    return segment_->next->packets[0];
+  }
+  return segment_->packets[index_];
+}
+
+Packet PacketBatchRing::Reader::PopFront() {
+  DCHECK(!IsEmpty());
+  if (index_ == kSegmentSize) {
+    segment_ = segment_->next;
+    index_ = 0;
+  }
+  Packet packet;
+  std::atomic<int>& readers_left = segment_->readers_left[index_];
+  if (readers_left.load(std::memory_order_acquire) == 1) {
+    // No other reader refers to the slot any more, so its packet can be moved
+    // out without touching the reference count.
+    readers_left.store(0, std::memory_order_relaxed);
+    packet = std::move(segment_->packets[index_]);
+  } else {
+    packet = segment_->packets[index_];
+    ReleaseSlot(segment_.get(), index_);
+  }
+  ++index_;
+  consumed_.fetch_add(1);
+  return packet;
+}
+
+bool PacketBatchRing::Reader::Append(Batch* batch) {
+  ++batch->num_appended_;
+  CHECK_LE(batch->num_appended_, batch->num_readers_);
+  const int64 available = available_.fetch_add(batch->size_);
+  return consumed_.load() == available;
+}
+
+}  // namespace mediapipe
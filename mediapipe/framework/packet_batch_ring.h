@@ -0,0 +1,147 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_PACKET_BATCH_RING_H_
+#define MEDIAPIPE_FRAMEWORK_PACKET_BATCH_RING_H_
+
+#include <atomic>
+#include <list>
+#include <memory>
+
+#include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+// A single-producer, multi-consumer ring holding the packets that an output
+// stream sends to the input streams mirroring it.  Every packet is stored
+// once: each Publish() call writes one read-only batch of consecutive slots,
+// and every mirror that takes the batch reads it through its own Reader.  The
+// last reader of a slot releases its packet.
+//
+// Input queues are unbounded, so the ring is made of fixed-size segments, and
+// the producer links a new segment when the last one is full.  A segment is
+// freed once neither the producer nor any reader refers to it.
+//
+// Publish() and Finish() must be called by one thread at a time, and so must
+// the consumer methods of a particular Reader.  Reader::Size() and
+// Reader::IsEmpty() may be called from any thread.
+class PacketBatchRing {
+ public:
+  static constexpr int kSegmentSize = 16;
+
+  struct Segment;
+  class Reader;
+
+  // The slots written by one Publish() call.
+  class Batch {
+   public:
+    // Returns the number of packets in the batch.
+    int size() const { return size_; }
+
+    // Returns the i-th packet of the batch.
+    const Packet& packet(int i) const;
+
+   private:
+    friend class PacketBatchRing;
+
+    std::shared_ptr<Segment> segment_;
+    int index_ = 0;
+    int size_ = 0;
+    // The number of readers the slots were published for.
+    int num_readers_ = 0;
+    // The number of readers that took the batch through Reader::Append().
+    int num_appended_ = 0;
+  };
+
+  PacketBatchRing();
+  PacketBatchRing(const PacketBatchRing&) = delete;
+  PacketBatchRing& operator=(const PacketBatchRing&) = delete;
+
+  // Copies the packets into the slots after the last batch, for up to
+  // num_readers readers.  The readers get the batch through Reader::Append(),
+  // and the producer must call Finish() once it has offered the batch to all
+  // of them.
+  Batch Publish(const std::list<Packet>& packets, int num_readers);
+
+  // Like the above, but moves the packets into the ring.
+  Batch Publish(std::list<Packet>* packets, int num_readers);
+
+  // Releases the slots of the readers that did not take the batch.
+  void Finish(Batch* batch);
+
+ private:
+  template <typename Container>
+  Batch PublishInternal(Container packets, int num_readers);
+
+  // The segment receiving the next batch, and the number of its used slots.
+  std::shared_ptr<Segment> tail_;
+  int tail_size_ = 0;
+};
+
+// One input stream's view of a PacketBatchRing: the batches appended to it
+// that the input stream has not consumed yet.
+class PacketBatchRing::Reader {
+ public:
+  Reader() = default;
+  Reader(const Reader&) = delete;
+  Reader& operator=(const Reader&) = delete;
+  ~Reader();
+
+  // Consumer side.
+
+  // Drops the unread packets and moves the reader to the end of the ring, so
+  // that it reads the next batch published.  Must not be called concurrently
+  // with Publish().
+  void Reset(const PacketBatchRing& ring);
+
+  // Drops the unread packets and stops reading the ring until the next
+  // Reset().  Batches appended in the meantime are never read.
+  void Clear();
+
+  // Returns the oldest unread packet.  The reader must not be empty.
+  const Packet& Front() const;
+
+  // Removes and returns the oldest unread packet.  The reader must not be
+  // empty.
+  Packet PopFront();
+
+  // Returns the number of unread packets.
+  int64 Size() const {
+    // Loads consumed_ first, so that the result is never negative.
+    const int64 consumed = consumed_.load();
+    return available_.load() - consumed;
+  }
+  bool IsEmpty() const { return Size() == 0; }
+
+  // Producer side.
+
+  // Makes the packets of the batch readable.  Each reader must take all
+  // batches published after its Reset(), up to the point where it stops
+  // taking any.  Returns true if the reader had no unread packets.
+  bool Append(Batch* batch);
+
+ private:
+  // The segment holding the oldest unread packet, and its index there.  The
+  // index is kSegmentSize when the next packet has not been published yet.
+  std::shared_ptr<Segment> segment_;
+  int index_ = 0;
+  // The number of packets appended and consumed since Reset().
+  std::atomic<int64> available_{0};
+  std::atomic<int64> consumed_{0};
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_PACKET_BATCH_RING_H_
@@ -0,0 +1,191 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/packet_batch_ring.h"
+
+#include <algorithm>
+#include <list>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "mediapipe/framework/lifetime_tracker.h"
+#include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/port/gtest.h"
+
+namespace mediapipe {
+namespace {
+
+std::list<Packet> MakeIntPackets(int begin, int end) {
+  std::list<Packet> packets;
+  for (int i = begin; i < end; ++i) {
+    packets.push_back(MakePacket<int>(i).At(Timestamp(i)));
+  }
+  return packets;
+}
+
+// Publishes the packets to the ring for the readers, and appends the batch to
+// each of them.
+void PublishToAll(PacketBatchRing* ring,
+                  const std::vector<PacketBatchRing::Reader*>& readers,
+                  std::list<Packet> packets) {
+  PacketBatchRing::Batch batch = ring->Publish(&packets, readers.size());
+  for (PacketBatchRing::Reader* reader : readers) {
+    reader->Append(&batch);
+  }
+  ring->Finish(&batch);
+}
+
+TEST(PacketBatchRingTest, ReadersSeeAllPacketsInOrder) {
+  PacketBatchRing ring;
+  PacketBatchRing::Reader reader1;
+  PacketBatchRing::Reader reader2;
+  reader1.Reset(ring);
+  reader2.Reset(ring);
+
+  // Spans several segments.
+  const int kNumPackets = 3 * PacketBatchRing::kSegmentSize + 5;
+  for (int i = 0; i < kNumPackets; i += 7) {
+    PublishToAll(&ring, {&reader1, &reader2},
+                 MakeIntPackets(i, std::min(i + 7, kNumPackets)));
+  }
+  EXPECT_EQ(kNumPackets, reader1.Size());
+  EXPECT_EQ(kNumPackets, reader2.Size());
+
+  for (int i = 0; i < kNumPackets; ++i) {
+    ASSERT_FALSE(reader1.IsEmpty());
+    EXPECT_EQ(i, reader1.Front().Get<int>());
+    EXPECT_EQ(Timestamp(i), reader1.PopFront().Timestamp());
+  }
+  EXPECT_TRUE(reader1.IsEmpty());
+  for (int i = 0; i < kNumPackets; ++i) {
+    EXPECT_EQ(i, reader2.PopFront().Get<int>());
+  }
+  EXPECT_TRUE(reader2.IsEmpty());
+}
+
+TEST(PacketBatchRingTest, BatchExposesItsPackets) {
+  PacketBatchRing ring;
+  // Starts the batch near the end of a segment.
+  std::list<Packet> filler =
+      MakeIntPackets(0, PacketBatchRing::kSegmentSize - 2);
+  PacketBatchRing::Batch first = ring.Publish(filler, 0);
+  ring.Finish(&first);
+
+  std::list<Packet> packets = MakeIntPackets(100, 105);
+  PacketBatchRing::Batch batch = ring.Publish(packets, 0);
+  ASSERT_EQ(5, batch.size());
+  for (int i = 0; i < batch.size(); ++i) {
+    EXPECT_EQ(100 + i, batch.packet(i).Get<int>());
+  }
+  ring.Finish(&batch);
+  // Publish() copies a const list.
+  EXPECT_EQ(5, packets.size());
+  EXPECT_FALSE(packets.front().IsEmpty());
+}
+
+TEST(PacketBatchRingTest, AppendReportsEmptyReader) {
+  PacketBatchRing ring;
+  PacketBatchRing::Reader reader;
+  reader.Reset(ring);
+
+  std::list<Packet> packets = MakeIntPackets(0, 2);
+  PacketBatchRing::Batch batch = ring.Publish(packets, 1);
+  EXPECT_TRUE(reader.Append(&batch));
+  ring.Finish(&batch);
+
+  packets = MakeIntPackets(2, 4);
+  batch = ring.Publish(packets, 1);
+  EXPECT_FALSE(reader.Append(&batch));
+  ring.Finish(&batch);
+}
+
+TEST(PacketBatchRingTest, LastReaderReleasesPackets) {
+  LifetimeTracker tracker;
+  PacketBatchRing ring;
+  PacketBatchRing::Reader reader1;
+  PacketBatchRing::Reader reader2;
+  PacketBatchRing::Reader skipping_reader;
+  reader1.Reset(ring);
+  reader2.Reset(ring);
+  skipping_reader.Reset(ring);
+
+  std::list<Packet> packets;
+  packets.push_back(Adopt(tracker.MakeObject().release()).At(Timestamp(0)));
+  packets.push_back(Adopt(tracker.MakeObject().release()).At(Timestamp(1)));
+  PacketBatchRing::Batch batch = ring.Publish(&packets, 3);
+  reader1.Append(&batch);
+  reader2.Append(&batch);
+  // skipping_reader does not take the batch.
+  ring.Finish(&batch);
+  EXPECT_EQ(2, tracker.live_count());
+
+  reader1.PopFront();
+  reader1.PopFront();
+  EXPECT_EQ(2, tracker.live_count());
+  Packet packet = reader2.PopFront();
+  EXPECT_EQ(2, tracker.live_count());
+  packet = Packet();
+  EXPECT_EQ(1, tracker.live_count());
+
+  // Clear() releases the unread packets.
+  reader2.Clear();
+  EXPECT_EQ(0, tracker.live_count());
+}
+
+TEST(PacketBatchRingTest, ResetSkipsEarlierBatches) {
+  PacketBatchRing ring;
+  PacketBatchRing::Reader reader;
+  reader.Reset(ring);
+  PublishToAll(&ring, {&reader}, MakeIntPackets(0, 3));
+
+  reader.Reset(ring);
+  EXPECT_TRUE(reader.IsEmpty());
+  PublishToAll(&ring, {&reader}, MakeIntPackets(3, 4));
+  ASSERT_EQ(1, reader.Size());
+  EXPECT_EQ(3, reader.PopFront().Get<int>());
+}
+
+// The producer publishes while the readers consume on other threads.
+TEST(PacketBatchRingTest, ConcurrentReaders) {
+  PacketBatchRing ring;
+  PacketBatchRing::Reader reader1;
+  PacketBatchRing::Reader reader2;
+  reader1.Reset(ring);
+  reader2.Reset(ring);
+
+  const int kNumPackets = 10000;
+  auto consume = [kNumPackets](PacketBatchRing::Reader* reader) {
+    for (int i = 0; i < kNumPackets;) {
+      if (reader->IsEmpty()) {
+        std::this_thread::yield();
+        continue;
+      }
+      EXPECT_EQ(i, reader->PopFront().Get<int>());
+      ++i;
+    }
+  };
+  std::thread thread1(consume, &reader1);
+  std::thread thread2(consume, &reader2);
+  for (int i = 0; i < kNumPackets; i += 3) {
+    PublishToAll(&ring, {&reader1, &reader2},
+                 MakeIntPackets(i, std::min(i + 3, kNumPackets)));
+  }
+  thread1.join();
+  thread2.join();
+  EXPECT_TRUE(reader1.IsEmpty());
+  EXPECT_TRUE(reader2.IsEmpty());
+}
+
+}  // namespace
+}  // namespace mediapipe
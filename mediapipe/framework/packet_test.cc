@@ -17,11 +17,13 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 #include <vector>
 
 #include "absl/strings/str_cat.h"
 #include "mediapipe/framework/packet_test.pb.h"
+#include "mediapipe/framework/port/benchmark.h"
 #include "mediapipe/framework/port/core_proto_inc.h"
 #include "mediapipe/framework/port/gmock.h"
 #include "mediapipe/framework/port/gtest.h"
@@ -492,5 +494,75 @@ TEST(PacketTest, PacketFromSerializedProto) {
   EXPECT_FALSE(packet.ValidateAsType<::mediapipe::PacketTestProto>().ok());
 }
 
+TEST(PacketTest, StoresSmallTriviallyCopyablePayloadsInline) {
+  Packet int_packet = MakePacket<int>(7);
+  Packet timestamp_packet = MakePacket<Timestamp>(Timestamp(5));
+  Packet vector_packet = MakePacket<std::vector<float>>(3, 1.0f);
+  Packet adopted_packet = Adopt(new int(8));
+  EXPECT_TRUE(packet_internal::GetHolder(int_packet)->HasInlineData());
+  EXPECT_TRUE(packet_internal::GetHolder(timestamp_packet)->HasInlineData());
+  EXPECT_FALSE(packet_internal::GetHolder(vector_packet)->HasInlineData());
+  EXPECT_FALSE(packet_internal::GetHolder(adopted_packet)->HasInlineData());
+
+  EXPECT_EQ(7, int_packet.Get<int>());
+  EXPECT_EQ(Timestamp(5), timestamp_packet.Get<Timestamp>());
+  // Copies share the inline data.
+  Packet int_copy = int_packet;
+  EXPECT_EQ(&int_packet.Get<int>(), &int_copy.Get<int>());
+  MP_EXPECT_OK(int_packet.ValidateAsType<int>());
+  EXPECT_FALSE(int_packet.ValidateAsType<float>().ok());
+
+  // Consuming inline data hands out a copy of it.
+  int_copy = Packet();
+  ::mediapipe::StatusOr<std::unique_ptr<int>> result = int_packet.Consume<int>();
+  MP_ASSERT_OK(result);
+  EXPECT_EQ(7, *result.ValueOrDie());
+  EXPECT_TRUE(int_packet.IsEmpty());
+}
+
+// Holders created on one thread can be released on another.
+TEST(PacketTest, DestroysPacketsOnAnotherThread) {
+  constexpr int kNumPackets = 10000;
+  std::vector<Packet> packets;
+  for (int i = 0; i < kNumPackets; ++i) {
+    packets.push_back(i % 2 ? MakePacket<int>(i)
+                            : MakePacket<std::string>(absl::StrCat(i)));
+  }
+  std::thread consumer([&packets] {
+    for (int i = 0; i < kNumPackets; ++i) {
+      if (i % 2) {
+        EXPECT_EQ(i, packets[i].Get<int>());
+      } else {
+        EXPECT_EQ(absl::StrCat(i), packets[i].Get<std::string>());
+      }
+    }
+    packets.clear();
+  });
+  consumer.join();
+  for (int i = 0; i < kNumPackets; ++i) {
+    packets.push_back(MakePacket<int>(i));
+  }
+  EXPECT_EQ(kNumPackets - 1, packets.back().Get<int>());
+}
+
+// Creates a packet, copies it once as an output stream would when fanning
+// out to an input stream, and destroys both.
+template <typename T>
+void BM_CreateCopyDestroyPacket(benchmark::State& state) {
+  for (auto _ : state) {
+    Packet packet = MakePacket<T>();
+    Packet copy = packet;
+    benchmark::DoNotOptimize(copy);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_CreateCopyDestroyPacket, int)->ThreadRange(1, 8);
+BENCHMARK_TEMPLATE(BM_CreateCopyDestroyPacket, float)->ThreadRange(1, 8);
+BENCHMARK_TEMPLATE(BM_CreateCopyDestroyPacket, Timestamp)->ThreadRange(1, 8);
+BENCHMARK_TEMPLATE(BM_CreateCopyDestroyPacket, std::vector<float>)
+    ->ThreadRange(1, 8);
+BENCHMARK_TEMPLATE(BM_CreateCopyDestroyPacket, std::string)
+    ->ThreadRange(1, 8);
+
 }  // namespace
 }  // namespace mediapipe
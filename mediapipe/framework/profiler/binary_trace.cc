@@ -0,0 +1,367 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/binary_trace.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/calculator_profile.pb.h"
+#include "mediapipe/framework/port/canonical_errors.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/ret_check.h"
+
+namespace mediapipe {
+
+constexpr int BinaryTraceRecord::kMaxNameChunk;
+
+namespace {
+
+// The initial size of a binary trace file, which doubles as needed.
+constexpr size_t kInitialFileSize = 1 << 20;
+
+::mediapipe::Status ErrnoError(const std::string& message,
+                               const std::string& path) {
+  return ::mediapipe::InternalError(
+      absl::StrCat(message, ": ", path, ": ", std::strerror(errno)));
+}
+
+// Appends a chunk of a node or stream name.
+::mediapipe::Status AppendName(const BinaryTraceRecord& record,
+                               std::vector<std::string>* names) {
+  RET_CHECK_GE(record.id, 0);
+  RET_CHECK_LE(record.name_size, BinaryTraceRecord::kMaxNameChunk);
+  if (record.id >= names->size()) {
+    names->resize(record.id + 1);
+  }
+  (*names)[record.id].append(record.name, record.name_size);
+  return ::mediapipe::OkStatus();
+}
+
+// Returns |str| as a quoted JSON string.
+std::string JsonString(absl::string_view str) {
+  std::string result = "\"";
+  for (char c : str) {
+    switch (c) {
+      case '"':
+        result += "\\\"";
+        break;
+      case '\\':
+        result += "\\\\";
+        break;
+      case '\n':
+        result += "\\n";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          absl::StrAppend(&result, "\\u",
+                          absl::Hex(static_cast<int>(c), absl::kZeroPad4));
+        } else {
+          result += c;
+        }
+    }
+  }
+  result += "\"";
+  return result;
+}
+
+// Returns a duration in nanoseconds as the microseconds used by Chrome.
+std::string JsonMicros(int64 nanos) {
+  return absl::StrCat(nanos / 1000, ".",
+                      absl::Dec(nanos % 1000, absl::kZeroPad3));
+}
+
+// Returns the display name of a calculator node.
+std::string NodeName(const BinaryTrace& trace, int32 node_id) {
+  if (node_id >= 0 && node_id < trace.node_names.size() &&
+      !trace.node_names[node_id].empty()) {
+    return trace.node_names[node_id];
+  }
+  return absl::StrCat("node ", node_id);
+}
+
+// Returns the name of a stream, or "" for no stream.
+std::string StreamName(const BinaryTrace& trace, int32 stream_id) {
+  if (stream_id > 0 && stream_id < trace.stream_names.size()) {
+    return trace.stream_names[stream_id];
+  }
+  return "";
+}
+
+// Start and finish events are matched by node_id, event_type, and input_ts,
+// the same way TraceBuilder identifies calculator tasks.
+using TaskKey = std::tuple<int32, uint8, int64>;
+
+// The earliest start and finish of a calculator task.
+struct TaskSpan {
+  const BinaryTraceRecord* start = nullptr;
+  const BinaryTraceRecord* finish = nullptr;
+  bool written = false;
+};
+
+TaskKey GetTaskKey(const BinaryTraceRecord& record) {
+  return TaskKey(record.event.node_id, record.event_type,
+                 record.event.input_ts);
+}
+
+}  // namespace
+
+BinaryTraceWriter::BinaryTraceWriter(int fd, const std::string& path)
+    : fd_(fd), path_(path) {}
+
+BinaryTraceWriter::~BinaryTraceWriter() { Close().IgnoreError(); }
+
+::mediapipe::StatusOr<std::unique_ptr<BinaryTraceWriter>>
+BinaryTraceWriter::Create(const std::string& path) {
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return ErrnoError("Could not open binary trace file", path);
+  }
+  std::unique_ptr<BinaryTraceWriter> writer(new BinaryTraceWriter(fd, path));
+  MP_RETURN_IF_ERROR(writer->MapFile(kInitialFileSize));
+  BinaryTraceHeader* header = writer->header();
+  std::memcpy(header->magic, kBinaryTraceMagic, sizeof(header->magic));
+  header->version = kBinaryTraceVersion;
+  header->record_size = sizeof(BinaryTraceRecord);
+  return std::move(writer);
+}
+
+::mediapipe::Status BinaryTraceWriter::MapFile(size_t size) {
+  if (data_ != nullptr) {
+    munmap(data_, mapped_size_);
+    data_ = nullptr;
+    mapped_size_ = 0;
+  }
+  if (ftruncate(fd_, size) != 0) {
+    return ErrnoError("Could not resize binary trace file", path_);
+  }
+  void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (data == MAP_FAILED) {
+    return ErrnoError("Could not map binary trace file", path_);
+  }
+  data_ = static_cast<char*>(data);
+  mapped_size_ = size;
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::StatusOr<BinaryTraceRecord*> BinaryTraceWriter::NextRecord() {
+  RET_CHECK(data_) << "Binary trace file is closed: " << path_;
+  size_t offset =
+      sizeof(BinaryTraceHeader) + num_records_ * sizeof(BinaryTraceRecord);
+  if (offset + sizeof(BinaryTraceRecord) > mapped_size_) {
+    MP_RETURN_IF_ERROR(MapFile(mapped_size_ * 2));
+  }
+  ++num_records_;
+  // The file is extended with zeros, so the record starts out UNUSED.
+  return reinterpret_cast<BinaryTraceRecord*>(data_ + offset);
+}
+
+::mediapipe::Status BinaryTraceWriter::WriteName(
+    BinaryTraceRecord::RecordType record_type, int32 id,
+    const std::string& name) {
+  size_t offset = 0;
+  do {
+    size_t size =
+        std::min(name.size() - offset,
+                 static_cast<size_t>(BinaryTraceRecord::kMaxNameChunk));
+    ASSIGN_OR_RETURN(BinaryTraceRecord * record, NextRecord());
+    record->record_type = record_type;
+    record->id = id;
+    record->name_size = size;
+    std::memcpy(record->name, name.data() + offset, size);
+    offset += size;
+  } while (offset < name.size());
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status BinaryTraceWriter::WriteNodeName(int32 node_id,
+                                                     const std::string& name) {
+  return WriteName(BinaryTraceRecord::NODE_NAME, node_id, name);
+}
+
+::mediapipe::Status BinaryTraceWriter::WriteEvent(const TraceEvent& event) {
+  int32 stream_id = 0;
+  if (event.stream_id != nullptr) {
+    auto iter = stream_ids_.find(event.stream_id);
+    if (iter != stream_ids_.end()) {
+      stream_id = iter->second;
+    } else {
+      // Id 0 is reserved to indicate no stream.
+      stream_id = stream_ids_.size() + 1;
+      stream_ids_[event.stream_id] = stream_id;
+      MP_RETURN_IF_ERROR(WriteName(BinaryTraceRecord::STREAM_NAME, stream_id,
+                                   *event.stream_id));
+    }
+  }
+  ASSIGN_OR_RETURN(BinaryTraceRecord * record, NextRecord());
+  record->record_type = BinaryTraceRecord::EVENT;
+  record->event_type = event.event_type;
+  record->is_finish = event.is_finish;
+  record->id = event.thread_id;
+  record->event.event_time = absl::ToUnixNanos(event.event_time);
+  record->event.input_ts = event.input_ts.Value();
+  record->event.packet_ts = event.packet_ts.Value();
+  record->event.event_data = event.event_data;
+  record->event.node_id = event.node_id;
+  record->event.stream_id = stream_id;
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status BinaryTraceWriter::Flush(int64 dropped_events) {
+  RET_CHECK(data_) << "Binary trace file is closed: " << path_;
+  // The mapping is shared, so the records are visible to readers of the file
+  // as soon as the header counts them.
+  header()->dropped_events = dropped_events;
+  header()->num_records = num_records_;
+  dropped_events_ = dropped_events;
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status BinaryTraceWriter::Close() {
+  if (fd_ < 0) {
+    return ::mediapipe::OkStatus();
+  }
+  ::mediapipe::Status status;
+  if (data_ != nullptr) {
+    status.Update(Flush(dropped_events_));
+    munmap(data_, mapped_size_);
+    data_ = nullptr;
+  }
+  size_t size =
+      sizeof(BinaryTraceHeader) + num_records_ * sizeof(BinaryTraceRecord);
+  if (ftruncate(fd_, size) != 0) {
+    status.Update(ErrnoError("Could not resize binary trace file", path_));
+  }
+  close(fd_);
+  fd_ = -1;
+  return status;
+}
+
+::mediapipe::Status ReadBinaryTrace(const std::string& path,
+                                    BinaryTrace* trace) {
+  std::string contents;
+  MP_RETURN_IF_ERROR(file::GetContents(path, &contents));
+  BinaryTraceHeader header;
+  RET_CHECK_GE(contents.size(), sizeof(header))
+      << "Binary trace file is truncated: " << path;
+  std::memcpy(&header, contents.data(), sizeof(header));
+  RET_CHECK_EQ(
+      std::memcmp(header.magic, kBinaryTraceMagic, sizeof(header.magic)), 0)
+      << "Not a binary trace file: " << path;
+  RET_CHECK_EQ(header.version, kBinaryTraceVersion);
+  RET_CHECK_EQ(header.record_size, sizeof(BinaryTraceRecord));
+  int64 num_records = (contents.size() - sizeof(header)) / header.record_size;
+  RET_CHECK_LE(header.num_records, num_records)
+      << "Binary trace file is truncated: " << path;
+
+  *trace = BinaryTrace();
+  trace->dropped_events = header.dropped_events;
+  const char* data = contents.data() + sizeof(header);
+  for (int64 i = 0; i < header.num_records; ++i) {
+    BinaryTraceRecord record;
+    std::memcpy(&record, data + i * sizeof(record), sizeof(record));
+    switch (record.record_type) {
+      case BinaryTraceRecord::EVENT:
+        trace->events.push_back(record);
+        break;
+      case BinaryTraceRecord::NODE_NAME:
+        MP_RETURN_IF_ERROR(AppendName(record, &trace->node_names));
+        break;
+      case BinaryTraceRecord::STREAM_NAME:
+        MP_RETURN_IF_ERROR(AppendName(record, &trace->stream_names));
+        break;
+      default:
+        return ::mediapipe::InvalidArgumentError(
+            absl::StrCat("Unknown binary trace record type ",
+                         record.record_type, " in: ", path));
+    }
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status ConvertBinaryTraceToChromeJson(const BinaryTrace& trace,
+                                                   std::string* json) {
+  std::vector<const BinaryTraceRecord*> events;
+  events.reserve(trace.events.size());
+  for (const BinaryTraceRecord& record : trace.events) {
+    events.push_back(&record);
+  }
+  // Events from different threads are exported interleaved.
+  std::stable_sort(events.begin(), events.end(),
+                   [](const BinaryTraceRecord* a, const BinaryTraceRecord* b) {
+                     return a->event.event_time < b->event.event_time;
+                   });
+  int64 base_time = events.empty() ? 0 : events.front()->event.event_time;
+
+  // Find the earliest start and finish of each calculator task.
+  std::map<TaskKey, TaskSpan> tasks;
+  for (const BinaryTraceRecord* event : events) {
+    TaskSpan& task = tasks[GetTaskKey(*event)];
+    const BinaryTraceRecord*& first =
+        event->is_finish ? task.finish : task.start;
+    if (first == nullptr) {
+      first = event;
+    }
+  }
+
+  json->clear();
+  absl::StrAppend(json, "{\"traceEvents\":[");
+  const char* separator = "\n";
+  for (const BinaryTraceRecord* event : events) {
+    TaskSpan& task = tasks[GetTaskKey(*event)];
+    bool is_complete = task.start && task.finish &&
+                       task.start->event.event_time <=
+                           task.finish->event.event_time;
+    if (is_complete && task.written) {
+      continue;
+    }
+    const BinaryTraceRecord& first = is_complete ? *task.start : *event;
+    absl::StrAppend(
+        json, separator, "{\"name\":",
+        JsonString(NodeName(trace, first.event.node_id)), ",\"cat\":",
+        JsonString(GraphTrace::EventType_Name(
+            static_cast<GraphTrace::EventType>(first.event_type))),
+        ",\"pid\":0,\"tid\":", first.id,
+        ",\"ts\":", JsonMicros(first.event.event_time - base_time));
+    if (is_complete) {
+      absl::StrAppend(json, ",\"ph\":\"X\",\"dur\":",
+                      JsonMicros(task.finish->event.event_time -
+                                 task.start->event.event_time),
+                      ",\"args\":{\"input_ts\":", first.event.input_ts, "}}");
+      task.written = true;
+    } else {
+      absl::StrAppend(
+          json, ",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"input_ts\":",
+          first.event.input_ts, ",\"packet_ts\":", first.event.packet_ts,
+          ",\"stream\":", JsonString(StreamName(trace, first.event.stream_id)),
+          ",\"event_data\":", first.event.event_data, "}}");
+    }
+    separator = ",\n";
+  }
+  absl::StrAppend(json, "\n],\"otherData\":{\"dropped_events\":\"",
+                  trace.dropped_events, "\"}}\n");
+  return ::mediapipe::OkStatus();
+}
+
+}  // namespace mediapipe
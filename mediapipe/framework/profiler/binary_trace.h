@@ -0,0 +1,173 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_PROFILER_BINARY_TRACE_H_
+#define MEDIAPIPE_FRAMEWORK_PROFILER_BINARY_TRACE_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/framework/profiler/trace_buffer.h"
+
+namespace mediapipe {
+
+// The binary trace log format.
+//
+// A binary trace file holds a BinaryTraceHeader followed by fixed-size
+// BinaryTraceRecords.  Each record is either one TraceEvent, or a chunk of
+// the name of a calculator node or stream.  The name of a stream is written
+// before the first event referring to it, so a binary trace can be written
+// incrementally without a separate index.
+struct BinaryTraceHeader {
+  // kBinaryTraceMagic.
+  char magic[8];
+  // kBinaryTraceVersion.
+  uint32 version;
+  // sizeof(BinaryTraceRecord).
+  uint32 record_size;
+  // The number of records following the header.
+  int64 num_records;
+  // The number of events dropped because a trace ring was full.
+  int64 dropped_events;
+  char reserved[32];
+};
+
+// The timing and packet details of one TraceEvent.
+struct BinaryTraceEvent {
+  // The event time in nanoseconds since the unix epoch.
+  int64 event_time;
+  // The input Timestamp value of the node.
+  int64 input_ts;
+  // The Timestamp value of the packet.
+  int64 packet_ts;
+  int64 event_data;
+  int32 node_id;
+  // The id of the stream name, or 0 for no stream.
+  int32 stream_id;
+};
+
+// One record in a binary trace file.
+struct BinaryTraceRecord {
+  enum RecordType : uint8 {
+    UNUSED = 0,
+    EVENT = 1,
+    NODE_NAME = 2,
+    STREAM_NAME = 3,
+  };
+  static constexpr int kMaxNameChunk = sizeof(BinaryTraceEvent);
+
+  RecordType record_type;
+  // The GraphTrace::EventType of an EVENT record.
+  uint8 event_type;
+  uint8 is_finish;
+  // The number of name characters in a NODE_NAME or STREAM_NAME record.
+  uint8 name_size;
+  // The thread id of an EVENT record, or the node or stream id of a
+  // NODE_NAME or STREAM_NAME record.
+  int32 id;
+  union {
+    BinaryTraceEvent event;
+    char name[kMaxNameChunk];
+  };
+};
+
+static_assert(sizeof(BinaryTraceHeader) == 64, "Unexpected header size");
+static_assert(sizeof(BinaryTraceRecord) == 48, "Unexpected record size");
+
+constexpr char kBinaryTraceMagic[8] = "MPTRACE";
+constexpr uint32 kBinaryTraceVersion = 1;
+
+// Streams TraceEvents into a memory-mapped binary trace file.
+//
+// Records are copied straight into the mapped file, and the record count in
+// the header is updated by Flush, so the file written so far can be read at
+// any time, even if the process exits without closing the writer.
+// BinaryTraceWriter is not thread-safe.
+class BinaryTraceWriter {
+ public:
+  // Creates or truncates the binary trace file at |path|.
+  static ::mediapipe::StatusOr<std::unique_ptr<BinaryTraceWriter>> Create(
+      const std::string& path);
+
+  ~BinaryTraceWriter();
+
+  // Records the name of a calculator node.
+  ::mediapipe::Status WriteNodeName(int32 node_id, const std::string& name);
+
+  // Appends one TraceEvent, preceded by its stream name on first use.
+  ::mediapipe::Status WriteEvent(const TraceEvent& event);
+
+  // Publishes the records written so far in the file header.
+  ::mediapipe::Status Flush(int64 dropped_events);
+
+  // Flushes, truncates the file to the records written, and unmaps it.
+  ::mediapipe::Status Close();
+
+ private:
+  BinaryTraceWriter(int fd, const std::string& path);
+
+  // Appends the name of a node or stream, in chunks of kMaxNameChunk.
+  ::mediapipe::Status WriteName(BinaryTraceRecord::RecordType record_type,
+                                int32 id, const std::string& name);
+
+  // Returns the next unused record, growing the file as needed.
+  ::mediapipe::StatusOr<BinaryTraceRecord*> NextRecord();
+
+  // Resizes the file and maps |size| bytes of it.
+  ::mediapipe::Status MapFile(size_t size);
+
+  BinaryTraceHeader* header() {
+    return reinterpret_cast<BinaryTraceHeader*>(data_);
+  }
+
+  int fd_;
+  std::string path_;
+  char* data_ = nullptr;
+  size_t mapped_size_ = 0;
+  int64 num_records_ = 0;
+  int64 dropped_events_ = 0;
+  // The ids assigned to stream names, by address.
+  std::unordered_map<const std::string*, int32> stream_ids_;
+};
+
+// The contents of a binary trace file.
+struct BinaryTrace {
+  // The names of calculator nodes, indexed by node id.
+  std::vector<std::string> node_names;
+  // The names of streams, indexed by stream id.
+  std::vector<std::string> stream_names;
+  // The EVENT records, in the order written.
+  std::vector<BinaryTraceRecord> events;
+  int64 dropped_events = 0;
+};
+
+// Reads a binary trace file written by BinaryTraceWriter.
+::mediapipe::Status ReadBinaryTrace(const std::string& path,
+                                    BinaryTrace* trace);
+
+// Converts a binary trace to the Chrome trace event JSON format, which is
+// displayed by chrome://tracing and by the Perfetto UI.  Each matching pair
+// of start and finish events becomes one complete event, and every other
+// event becomes an instant event.
+::mediapipe::Status ConvertBinaryTraceToChromeJson(const BinaryTrace& trace,
+                                                   std::string* json);
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_PROFILER_BINARY_TRACE_H_
@@ -0,0 +1,213 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/binary_trace.h"
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/calculator.pb.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/port/threadpool.h"
+#include "mediapipe/framework/profiler/graph_tracer.h"
+#include "mediapipe/framework/timestamp.h"
+
+namespace mediapipe {
+namespace {
+
+std::string TestFilePath(const std::string& name) {
+  return absl::StrCat(getenv("TEST_TMPDIR"), "/", name);
+}
+
+absl::Time TestTime(int64 usec) {
+  return absl::FromUnixMicros(1544086800000000 + usec);
+}
+
+TEST(BinaryTraceTest, WritesAndReadsEvents) {
+  std::string path = TestFilePath("events.mptrace");
+  std::string stream_1 = "input_frames";
+  std::string stream_2 = "a_stream_name_that_is_longer_than_one_record_chunk";
+  {
+    auto writer_or = BinaryTraceWriter::Create(path);
+    MP_ASSERT_OK(writer_or.status());
+    std::unique_ptr<BinaryTraceWriter> writer =
+        std::move(writer_or).ValueOrDie();
+    MP_EXPECT_OK(writer->WriteNodeName(0, "FrameSource"));
+    MP_EXPECT_OK(
+        writer->WriteNodeName(1, "ObjectDetectionSubgraph__Inference"));
+    MP_EXPECT_OK(writer->WriteEvent(TraceEvent(TraceEvent::PROCESS)
+                                        .set_event_time(TestTime(10))
+                                        .set_node_id(1)
+                                        .set_input_ts(Timestamp(100))
+                                        .set_packet_ts(Timestamp(100))
+                                        .set_stream_id(&stream_1)
+                                        .set_thread_id(3)));
+    MP_EXPECT_OK(writer->WriteEvent(TraceEvent(TraceEvent::PROCESS)
+                                        .set_event_time(TestTime(25))
+                                        .set_is_finish(true)
+                                        .set_node_id(1)
+                                        .set_input_ts(Timestamp(100))
+                                        .set_packet_ts(Timestamp(100))
+                                        .set_stream_id(&stream_2)
+                                        .set_thread_id(3)));
+    MP_EXPECT_OK(writer->WriteEvent(TraceEvent(TraceEvent::PROCESS)
+                                        .set_event_time(TestTime(30))
+                                        .set_node_id(1)
+                                        .set_input_ts(Timestamp(200))
+                                        .set_stream_id(&stream_1)));
+    MP_EXPECT_OK(writer->Flush(7));
+
+    // The flushed events can be read before the writer is closed.
+    BinaryTrace trace;
+    MP_ASSERT_OK(ReadBinaryTrace(path, &trace));
+    EXPECT_EQ(3, trace.events.size());
+  }
+
+  BinaryTrace trace;
+  MP_ASSERT_OK(ReadBinaryTrace(path, &trace));
+  EXPECT_THAT(trace.node_names,
+              ::testing::ElementsAre("FrameSource",
+                                     "ObjectDetectionSubgraph__Inference"));
+  EXPECT_THAT(trace.stream_names,
+              ::testing::ElementsAre("", stream_1, stream_2));
+  EXPECT_EQ(7, trace.dropped_events);
+  ASSERT_EQ(3, trace.events.size());
+  const BinaryTraceRecord& finish = trace.events[1];
+  EXPECT_EQ(TraceEvent::PROCESS, finish.event_type);
+  EXPECT_TRUE(finish.is_finish);
+  EXPECT_EQ(3, finish.id);
+  EXPECT_EQ(absl::ToUnixNanos(TestTime(25)), finish.event.event_time);
+  EXPECT_EQ(100, finish.event.input_ts);
+  EXPECT_EQ(100, finish.event.packet_ts);
+  EXPECT_EQ(1, finish.event.node_id);
+  EXPECT_EQ(2, finish.event.stream_id);
+  EXPECT_EQ(1, trace.events[2].event.stream_id);
+}
+
+TEST(BinaryTraceTest, GrowsTheFile) {
+  std::string path = TestFilePath("large.mptrace");
+  std::string stream = "input";
+  const int kNumEvents = 100000;
+  {
+    auto writer = BinaryTraceWriter::Create(path).ValueOrDie();
+    for (int i = 0; i < kNumEvents; ++i) {
+      MP_ASSERT_OK(writer->WriteEvent(TraceEvent(TraceEvent::PACKET_QUEUED)
+                                          .set_event_time(TestTime(i))
+                                          .set_packet_ts(Timestamp(i))
+                                          .set_stream_id(&stream)));
+    }
+  }
+  BinaryTrace trace;
+  MP_ASSERT_OK(ReadBinaryTrace(path, &trace));
+  ASSERT_EQ(kNumEvents, trace.events.size());
+  EXPECT_EQ(kNumEvents - 1, trace.events.back().event.packet_ts);
+}
+
+TEST(BinaryTraceTest, RejectsOtherFiles) {
+  std::string path = TestFilePath("not_a_trace.mptrace");
+  MP_ASSERT_OK(file::SetContents(path, std::string(100, 'x')));
+  BinaryTrace trace;
+  EXPECT_FALSE(ReadBinaryTrace(path, &trace).ok());
+}
+
+TEST(BinaryTraceTest, ConvertsToChromeJson) {
+  BinaryTrace trace;
+  trace.node_names = {"FrameSource", "Detector"};
+  trace.stream_names = {"", "frames"};
+  auto add_event = [&trace](GraphTrace::EventType event_type, bool is_finish,
+                            int64 time_usec, int64 input_ts) {
+    BinaryTraceRecord record = {};
+    record.record_type = BinaryTraceRecord::EVENT;
+    record.event_type = event_type;
+    record.is_finish = is_finish;
+    record.id = 2;
+    record.event.event_time = 1000000000 + time_usec * 1000;
+    record.event.input_ts = input_ts;
+    record.event.packet_ts = input_ts;
+    record.event.node_id = 1;
+    record.event.stream_id = 1;
+    trace.events.push_back(record);
+  };
+  add_event(GraphTrace::PROCESS, false, 0, 100);
+  add_event(GraphTrace::PACKET_QUEUED, false, 1, 200);
+  add_event(GraphTrace::PROCESS, true, 5, 100);
+  add_event(GraphTrace::PROCESS, true, 5, 100);
+
+  std::string json;
+  MP_ASSERT_OK(ConvertBinaryTraceToChromeJson(trace, &json));
+  EXPECT_EQ(json,
+            "{\"traceEvents\":[\n"
+            "{\"name\":\"Detector\",\"cat\":\"PROCESS\",\"pid\":0,\"tid\":2,"
+            "\"ts\":0.000,\"ph\":\"X\",\"dur\":5.000,"
+            "\"args\":{\"input_ts\":100}},\n"
+            "{\"name\":\"Detector\",\"cat\":\"PACKET_QUEUED\",\"pid\":0,"
+            "\"tid\":2,\"ts\":1.000,\"ph\":\"i\",\"s\":\"t\","
+            "\"args\":{\"input_ts\":200,\"packet_ts\":200,"
+            "\"stream\":\"frames\",\"event_data\":0}}\n"
+            "],\"otherData\":{\"dropped_events\":\"0\"}}\n");
+}
+
+TEST(BinaryTraceTest, GraphTracerWritesBinaryTrace) {
+  ProfilerConfig profiler_config;
+  profiler_config.set_trace_enabled(true);
+  profiler_config.set_trace_log_binary(true);
+  const int kNumThreads = 4;
+  const int kNumEvents = 500;
+  // One thread may run several writers, so each ring can hold all events.
+  profiler_config.set_trace_log_capacity(kNumThreads * kNumEvents);
+  GraphTracer tracer(profiler_config);
+  ASSERT_TRUE(tracer.IsBinaryTraceEnabled());
+  std::string stream = "input";
+  {
+    ::mediapipe::ThreadPool pool(kNumThreads);
+    pool.StartWorkers();
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&tracer, &stream, t]() {
+        for (int i = 0; i < kNumEvents; ++i) {
+          tracer.LogEvent(TraceEvent(TraceEvent::PACKET_QUEUED)
+                              .set_event_time(TestTime(i))
+                              .set_node_id(t)
+                              .set_packet_ts(Timestamp(i))
+                              .set_stream_id(&stream));
+        }
+      });
+    }
+  }
+  GraphTrace graph_trace;
+  tracer.GetLog(absl::InfinitePast(), absl::InfiniteFuture(), &graph_trace);
+  EXPECT_EQ(0, graph_trace.calculator_trace_size());
+
+  std::string path = TestFilePath("tracer.mptrace");
+  auto writer = BinaryTraceWriter::Create(path).ValueOrDie();
+  MP_ASSERT_OK(tracer.WriteBinaryTrace(writer.get()));
+  BinaryTrace trace;
+  MP_ASSERT_OK(ReadBinaryTrace(path, &trace));
+  EXPECT_EQ(kNumThreads * kNumEvents, trace.events.size());
+  EXPECT_EQ(0, trace.dropped_events);
+
+  // Events are removed from the rings once written.
+  MP_ASSERT_OK(tracer.WriteBinaryTrace(writer.get()));
+  MP_ASSERT_OK(ReadBinaryTrace(path, &trace));
+  EXPECT_EQ(kNumThreads * kNumEvents, trace.events.size());
+}
+
+}  // namespace
+}  // namespace mediapipe
@@ -0,0 +1,51 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Converts a binary trace file written with ProfilerConfig.trace_log_binary
+// to Chrome trace JSON, for viewing in chrome://tracing or the Perfetto UI.
+#include <cstdlib>
+#include <string>
+
+#include "mediapipe/framework/port/commandlineflags.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/profiler/binary_trace.h"
+
+DEFINE_string(input_file, "", "The binary trace file to convert.");
+DEFINE_string(output_file, "", "The Chrome trace JSON file to write.");
+
+::mediapipe::Status ConvertBinaryTrace() {
+  RET_CHECK(!FLAGS_input_file.empty() && !FLAGS_output_file.empty())
+      << "--input_file and --output_file must be specified.";
+  ::mediapipe::BinaryTrace trace;
+  MP_RETURN_IF_ERROR(::mediapipe::ReadBinaryTrace(FLAGS_input_file, &trace));
+  std::string json;
+  MP_RETURN_IF_ERROR(::mediapipe::ConvertBinaryTraceToChromeJson(trace, &json));
+  LOG(INFO) << "Converted " << trace.events.size() << " events, "
+            << trace.dropped_events << " events were dropped.";
+  return ::mediapipe::file::SetContents(FLAGS_output_file, json);
+}
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  ::mediapipe::Status status = ConvertBinaryTrace();
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to convert the binary trace: " << status.message();
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -14,6 +14,7 @@
 
 #include "mediapipe/framework/profiler/graph_profiler.h"
 
+#include <algorithm>
 #include <fstream>
 #include <list>
 
@@ -30,6 +31,7 @@
 #include "mediapipe/framework/tool/name_util.h"
 #include "mediapipe/framework/tool/tag_map.h"
 #include "mediapipe/framework/tool/validate_name.h"
+#include "mediapipe/util/cpu_util.h"
 
 namespace mediapipe {
 
@@ -40,10 +42,18 @@ namespace {
 const int kDefaultLogIntervalCount = 10;
 const int kDefaultLogFileCount = 2;
 const char kDefaultLogFilePrefix[] = "mediapipe_trace_";
+const char kBinaryTraceFileExtension[] = ".mptrace";
 
 // The number of recent timestamps tracked for each input stream.
 const int kPacketInfoRecentCount = 100;
 
+// The number of recent graph input timestamps tracked for graph latency.
+const int kGraphInputRecentCount = 1000;
+
+// The log-linear histogram bits for graph latency, unless
+// histogram_log_linear_bits is specified.
+const int kDefaultGraphLatencyBits = 7;
+
 std::string PacketIdToString(const PacketId& packet_id) {
   return absl::Substitute("stream_name: $0, timestamp_usec: $1",
                           packet_id.stream_name, packet_id.timestamp_usec);
@@ -65,6 +75,14 @@ bool IsProfilerEnabled(const ProfilerConfig& profiler_config) {
   return profiler_config.enable_profiler();
 }
 
+// Returns the log-linear histogram bits for graph latency.
+int GetGraphLatencyBits(const ProfilerConfig& profiler_config) {
+  return profiler_config.histogram_log_linear_bits() > 0
+             ? std::min(profiler_config.histogram_log_linear_bits(),
+                        LogLinearTimeHistogram::kMaxBits)
+             : kDefaultGraphLatencyBits;
+}
+
 // Returns true if trace events are recorded.
 bool IsTracerEnabled(const ProfilerConfig& profiler_config) {
   return profiler_config.trace_enabled();
@@ -131,8 +149,9 @@ void GraphProfiler::Initialize(
   if (IsTracerEnabled(profiler_config_)) {
     packet_tracer_ = absl::make_unique<GraphTracer>(profiler_config_);
   }
-  for (int node_id = 0;
-       node_id < validated_graph_config.CalculatorInfos().size(); ++node_id) {
+  const int num_nodes = validated_graph_config.CalculatorInfos().size();
+  calculator_histograms_.resize(num_nodes);
+  for (int node_id = 0; node_id < num_nodes; ++node_id) {
     std::string node_name =
         tool::CanonicalNodeName(validated_graph_config.Config(), node_id);
     CalculatorProfile profile;
@@ -151,6 +170,14 @@ void GraphProfiler::Initialize(
       InitializeInputStreams(node_config, interval_size_usec, num_intervals,
                              &profile);
     }
+    if (profiler_config_.enable_numa_node_stats()) {
+      for (int node = 0; node < GetNumaNodeCpuIds().size(); ++node) {
+        profile.add_numa_node_profiles()->set_numa_node(node);
+      }
+    }
+    if (profiler_config_.histogram_log_linear_bits() > 0) {
+      InitializeCalculatorHistograms(node_id, &profile);
+    }
 
     auto iter = calculator_profiles_.insert({node_name, profile});
     CHECK(iter.second) << absl::Substitute(
@@ -195,6 +222,29 @@ void GraphProfiler::Reset() {
          *(calculator_profile->mutable_input_stream_profiles())) {
       ResetTimeHistogram(input_stream_profile.mutable_latency());
     }
+    for (auto& numa_node_profile :
+         *(calculator_profile->mutable_numa_node_profiles())) {
+      numa_node_profile.set_process_count(0);
+      numa_node_profile.set_process_runtime(0);
+    }
+  }
+  {
+    absl::MutexLock latency_lock(&graph_latency_mutex_);
+    graph_input_times_.clear();
+    graph_output_latencies_.clear();
+  }
+  for (CalculatorHistograms& histograms : calculator_histograms_) {
+    for (LogLinearTimeHistogram* histogram :
+         {histograms.process_runtime.get(),
+          histograms.process_input_latency.get(),
+          histograms.process_output_latency.get()}) {
+      if (histogram) {
+        histogram->Reset();
+      }
+    }
+    for (auto& input_stream_latency : histograms.input_stream_latency) {
+      input_stream_latency->Reset();
+    }
   }
 }
 
@@ -247,6 +297,9 @@ void GraphProfiler::LogEvent(const TraceEvent& event) {
   if (event.event_type == GraphTrace::PROCESS && event.node_id == -1) {
     AddPacketInfo(event);
   }
+  if (event.event_type == GraphTrace::PACKET_DELIVERED) {
+    AddGraphOutputLatency(event);
+  }
 }
 
 void GraphProfiler::AddPacketInfo(const TraceEvent& packet_info) {
@@ -258,6 +311,10 @@ void GraphProfiler::AddPacketInfo(const TraceEvent& packet_info) {
   Timestamp packet_timestamp = packet_info.input_ts;
   std::string stream_name = *packet_info.stream_id;
 
+  if (profiler_config_.enable_graph_latency() &&
+      packet_timestamp.IsRangeValue()) {
+    AddGraphInputTime(packet_timestamp.Value(), TimeNowUsec());
+  }
   if (!profiler_config_.enable_stream_latency()) {
     return;
   }
@@ -284,6 +341,87 @@ void GraphProfiler::AddPacketInfo(const TraceEvent& packet_info) {
       << "GetCalculatorProfiles can only be called after Initialize()";
   for (auto& entry : calculator_profiles_) {
     profiles->push_back(entry.second);
+    WriteCalculatorHistograms(&profiles->back());
+  }
+  return ::mediapipe::OkStatus();
+}
+
+void GraphProfiler::AddGraphInputTime(int64 timestamp_usec, int64 time_usec) {
+  absl::MutexLock lock(&graph_latency_mutex_);
+  graph_input_times_.insert({timestamp_usec, time_usec});
+  while (graph_input_times_.size() > kGraphInputRecentCount) {
+    graph_input_times_.erase(graph_input_times_.begin());
+  }
+}
+
+void GraphProfiler::AddGraphOutputLatency(const TraceEvent& packet_info) {
+  absl::ReaderMutexLock lock(&profiler_mutex_);
+  if (!is_profiling_ || !profiler_config_.enable_graph_latency()) {
+    return;
+  }
+  int64 time_usec = TimeNowUsec();
+  absl::MutexLock latency_lock(&graph_latency_mutex_);
+  auto input_time = graph_input_times_.find(packet_info.packet_ts.Value());
+  if (input_time == graph_input_times_.end()) {
+    // No graph input packet was added at this timestamp.
+    return;
+  }
+  GraphOutputLatencies& latencies =
+      graph_output_latencies_[*packet_info.stream_id];
+  if (!latencies.histogram) {
+    latencies.histogram = absl::make_unique<LogLinearTimeHistogram>(
+        GetGraphLatencyBits(profiler_config_));
+  }
+  latencies.histogram->AddTimeSample(input_time->second, time_usec);
+  latencies.recent.push_back(
+      {packet_info.packet_ts.Value(), time_usec - input_time->second});
+  while (latencies.recent.size() > kPacketInfoRecentCount) {
+    latencies.recent.pop_front();
+  }
+}
+
+::mediapipe::Status GraphProfiler::GetGraphOutputLatencies(
+    std::vector<GraphOutputLatency>* latencies) const {
+  absl::MutexLock lock(&graph_latency_mutex_);
+  for (const auto& entry : graph_output_latencies_) {
+    latencies->emplace_back();
+    latencies->back().set_stream_name(entry.first);
+    entry.second.histogram->WriteTo(latencies->back().mutable_latency());
+  }
+  return ::mediapipe::OkStatus();
+}
+
+::mediapipe::Status GraphProfiler::GetPacketLatency(
+    const std::string& stream_name, Timestamp timestamp,
+    PacketLatency* latency) {
+  latency->Clear();
+  {
+    absl::MutexLock lock(&graph_latency_mutex_);
+    auto entry = graph_output_latencies_.find(stream_name);
+    if (entry != graph_output_latencies_.end()) {
+      const auto& recent = entry->second.recent;
+      for (auto iter = recent.rbegin(); iter != recent.rend(); ++iter) {
+        if (iter->first == timestamp.Value()) {
+          latency->set_latency_usec(iter->second);
+          break;
+        }
+      }
+    }
+  }
+  if (!latency->has_latency_usec()) {
+    return ::mediapipe::NotFoundError(absl::Substitute(
+        "No recent latency for stream \"$0\" at timestamp $1.", stream_name,
+        timestamp.DebugString()));
+  }
+  latency->set_stream_name(stream_name);
+  latency->set_timestamp(timestamp.Value());
+  GraphTracer* packet_tracer = tracer();
+  if (packet_tracer && !packet_tracer->IsBinaryTraceEnabled()) {
+    packet_tracer->GetCriticalPath(stream_name, timestamp, latency);
+    for (auto& node_latency : *latency->mutable_critical_path()) {
+      node_latency.set_node_name(tool::CanonicalNodeName(
+          validated_graph_->Config(), node_latency.node_id()));
+    }
   }
   return ::mediapipe::OkStatus();
 }
@@ -297,6 +435,59 @@ void GraphProfiler::InitializeTimeHistogram(int64 interval_size_usec,
   ResetTimeHistogram(histogram);
 }
 
+void GraphProfiler::InitializeCalculatorHistograms(
+    int node_id, CalculatorProfile* calculator_profile) {
+  const int bits = std::min(profiler_config_.histogram_log_linear_bits(),
+                            LogLinearTimeHistogram::kMaxBits);
+  CalculatorHistograms& histograms = calculator_histograms_[node_id];
+  histograms.process_runtime = absl::make_unique<LogLinearTimeHistogram>(bits);
+  if (profiler_config_.enable_stream_latency()) {
+    histograms.process_input_latency =
+        absl::make_unique<LogLinearTimeHistogram>(bits);
+    histograms.process_output_latency =
+        absl::make_unique<LogLinearTimeHistogram>(bits);
+    for (int i = 0; i < calculator_profile->input_stream_profiles_size(); ++i) {
+      histograms.input_stream_latency.push_back(
+          absl::make_unique<LogLinearTimeHistogram>(bits));
+    }
+  }
+  calculator_histogram_ids_[calculator_profile->name()] = node_id;
+  WriteCalculatorHistograms(calculator_profile);
+}
+
+GraphProfiler::CalculatorHistograms* GraphProfiler::GetCalculatorHistograms(
+    const CalculatorContext& calculator_context) {
+  const int node_id = calculator_context.NodeId();
+  if (node_id < 0 || node_id >= calculator_histograms_.size() ||
+      !calculator_histograms_[node_id].process_runtime) {
+    return nullptr;
+  }
+  return &calculator_histograms_[node_id];
+}
+
+void GraphProfiler::WriteCalculatorHistograms(
+    CalculatorProfile* calculator_profile) const {
+  auto id_iter = calculator_histogram_ids_.find(calculator_profile->name());
+  if (id_iter == calculator_histogram_ids_.end()) {
+    return;
+  }
+  const CalculatorHistograms& histograms =
+      calculator_histograms_[id_iter->second];
+  histograms.process_runtime->WriteTo(
+      calculator_profile->mutable_process_runtime());
+  if (histograms.process_input_latency) {
+    histograms.process_input_latency->WriteTo(
+        calculator_profile->mutable_process_input_latency());
+    histograms.process_output_latency->WriteTo(
+        calculator_profile->mutable_process_output_latency());
+  }
+  for (int i = 0; i < histograms.input_stream_latency.size(); ++i) {
+    histograms.input_stream_latency[i]->WriteTo(
+        calculator_profile->mutable_input_stream_profiles(i)
+            ->mutable_latency());
+  }
+}
+
 void GraphProfiler::InitializeOutputStreams(
     const CalculatorGraphConfig::Node& node_config) {}
 
@@ -371,10 +562,11 @@ void GraphProfiler::AddPacketInfoForOutputPackets(
 
 int64 GraphProfiler::AddStreamLatencies(
     const CalculatorContext& calculator_context, int64 start_time_usec,
-    int64 end_time_usec, CalculatorProfile* calculator_profile) {
+    int64 end_time_usec, CalculatorProfile* calculator_profile,
+    CalculatorHistograms* histograms) {
   // Update input streams profiles.
   int64 min_source_process_start_usec = AddInputStreamTimeSamples(
-      calculator_context, start_time_usec, calculator_profile);
+      calculator_context, start_time_usec, calculator_profile, histograms);
 
   // Update output production times.
   AddPacketInfoForOutputPackets(calculator_context.Outputs(), end_time_usec,
@@ -400,7 +592,8 @@ void GraphProfiler::SetOpenRuntime(const CalculatorContext& calculator_context,
 
   if (profiler_config_.enable_stream_latency()) {
     AddStreamLatencies(calculator_context, start_time_usec, end_time_usec,
-                       calculator_profile);
+                       calculator_profile,
+                       GetCalculatorHistograms(calculator_context));
   }
 }
 
@@ -422,7 +615,8 @@ void GraphProfiler::SetCloseRuntime(const CalculatorContext& calculator_context,
 
   if (profiler_config_.enable_stream_latency()) {
     AddStreamLatencies(calculator_context, start_time_usec, end_time_usec,
-                       calculator_profile);
+                       calculator_profile,
+                       GetCalculatorHistograms(calculator_context));
   }
 }
 
@@ -446,7 +640,7 @@ void GraphProfiler::AddTimeSample(int64 start_time_usec, int64 end_time_usec,
 
 int64 GraphProfiler::AddInputStreamTimeSamples(
     const CalculatorContext& calculator_context, int64 start_time_usec,
-    CalculatorProfile* calculator_profile) {
+    CalculatorProfile* calculator_profile, CalculatorHistograms* histograms) {
   int64 input_timestamp_usec = calculator_context.InputTimestamp().Value();
   int64 min_source_process_start_usec = start_time_usec;
   int64 input_stream_counter = -1;
@@ -470,10 +664,15 @@ int64 GraphProfiler::AddInputStreamTimeSamples(
                                 << PacketIdToString(packet_id);
       continue;
     }
-    AddTimeSample(
-        packet_info->production_time_usec, start_time_usec,
-        calculator_profile->mutable_input_stream_profiles(input_stream_counter)
-            ->mutable_latency());
+    if (histograms) {
+      histograms->input_stream_latency[input_stream_counter]->AddTimeSample(
+          packet_info->production_time_usec, start_time_usec);
+    } else {
+      AddTimeSample(packet_info->production_time_usec, start_time_usec,
+                    calculator_profile
+                        ->mutable_input_stream_profiles(input_stream_counter)
+                        ->mutable_latency());
+    }
 
     min_source_process_start_usec = std::min(
         min_source_process_start_usec, packet_info->source_process_start_usec);
@@ -490,6 +689,19 @@ void GraphProfiler::AddProcessSample(
     return;
   }
 
+  // Log-linear histograms are updated without locking the calculator profile,
+  // which is then needed only for the NUMA node stats and stream latencies.
+  CalculatorHistograms* histograms =
+      GetCalculatorHistograms(calculator_context);
+  if (histograms) {
+    histograms->process_runtime->AddTimeSample(start_time_usec,
+                                               end_time_usec);
+    if (!profiler_config_.enable_numa_node_stats() &&
+        !profiler_config_.enable_stream_latency()) {
+      return;
+    }
+  }
+
   const std::string& node_name = calculator_context.NodeName();
   auto profile_iter = calculator_profiles_.find(node_name);
   CHECK(profile_iter != calculator_profiles_.end()) << absl::Substitute(
@@ -498,17 +710,42 @@ void GraphProfiler::AddProcessSample(
   CalculatorProfile* calculator_profile = &profile_iter->second;
 
   // Update Process() runtime.
-  AddTimeSample(start_time_usec, end_time_usec,
-                calculator_profile->mutable_process_runtime());
+  if (!histograms) {
+    AddTimeSample(start_time_usec, end_time_usec,
+                  calculator_profile->mutable_process_runtime());
+  }
+
+  // The scope ends on the thread that ran Process(). Finding its NUMA node
+  // costs a getcpu call, so it is only done if the stats are requested.
+  if (profiler_config_.enable_numa_node_stats()) {
+    const int numa_node = GetCurrentNumaNode();
+    if (numa_node < calculator_profile->numa_node_profiles_size()) {
+      NumaNodeProfile* numa_node_profile =
+          calculator_profile->mutable_numa_node_profiles(numa_node);
+      numa_node_profile->set_process_count(
+          numa_node_profile->process_count() + 1);
+      numa_node_profile->set_process_runtime(
+          numa_node_profile->process_runtime() +
+          std::max<int64>(end_time_usec - start_time_usec, 0));
+    }
+  }
 
   if (profiler_config_.enable_stream_latency()) {
-    int64 min_source_process_start_usec = AddStreamLatencies(
-        calculator_context, start_time_usec, end_time_usec, calculator_profile);
+    int64 min_source_process_start_usec =
+        AddStreamLatencies(calculator_context, start_time_usec, end_time_usec,
+                           calculator_profile, histograms);
     // Update input and output trace latencies.
-    AddTimeSample(min_source_process_start_usec, start_time_usec,
-                  calculator_profile->mutable_process_input_latency());
-    AddTimeSample(min_source_process_start_usec, end_time_usec,
-                  calculator_profile->mutable_process_output_latency());
+    if (histograms) {
+      histograms->process_input_latency->AddTimeSample(
+          min_source_process_start_usec, start_time_usec);
+      histograms->process_output_latency->AddTimeSample(
+          min_source_process_start_usec, end_time_usec);
+    } else {
+      AddTimeSample(min_source_process_start_usec, start_time_usec,
+                    calculator_profile->mutable_process_input_latency());
+      AddTimeSample(min_source_process_start_usec, end_time_usec,
+                    calculator_profile->mutable_process_output_latency());
+    }
   }
 }
 
@@ -585,6 +822,9 @@ void AssignNodeNames(GraphProfile* profile) {
   ASSIGN_OR_RETURN(std::string trace_log_path, GetTraceLogPath());
   // Inform the user via logging the path to the trace logs.
   LOG(INFO) << "trace_log_path: " << trace_log_path;
+  if (tracer()->IsBinaryTraceEnabled()) {
+    return WriteBinaryTrace(trace_log_path);
+  }
   int log_interval_count = GetLogIntervalCount(profiler_config_);
   int log_file_count = GetLogFileCount(profiler_config_);
 
@@ -639,4 +879,36 @@ void AssignNodeNames(GraphProfile* profile) {
   return status;
 }
 
+::mediapipe::Status GraphProfiler::WriteBinaryTrace(
+    const std::string& trace_log_path) {
+  absl::MutexLock lock(&binary_trace_mutex_);
+  int log_interval_count = GetLogIntervalCount(profiler_config_);
+  int log_file_count = GetLogFileCount(profiler_config_);
+
+  // Like the GraphProfile logs, the binary trace moves to the next of
+  // log_file_count files every log_interval_count writes, and overwrites the
+  // oldest file, so that the trace does not grow without bound.  The files
+  // are rotated across graph runs.
+  ++binary_trace_log_index_;
+  if (!binary_trace_writer_ ||
+      binary_trace_log_index_ % log_interval_count == 0) {
+    if (binary_trace_writer_) {
+      MP_RETURN_IF_ERROR(binary_trace_writer_->Close());
+      binary_trace_writer_.reset();
+    }
+    int log_index =
+        binary_trace_log_index_ / log_interval_count % log_file_count;
+    std::string log_path =
+        absl::StrCat(trace_log_path, log_index, kBinaryTraceFileExtension);
+    ASSIGN_OR_RETURN(binary_trace_writer_, BinaryTraceWriter::Create(log_path));
+    // Each file names the nodes, so that it can be read on its own.
+    const CalculatorGraphConfig& config = validated_graph_->Config();
+    for (int node_id = 0; node_id < config.node_size(); ++node_id) {
+      MP_RETURN_IF_ERROR(binary_trace_writer_->WriteNodeName(
+          node_id, tool::CanonicalNodeName(config, node_id)));
+    }
+  }
+  return tracer()->WriteBinaryTrace(binary_trace_writer_.get());
+}
+
 }  // namespace mediapipe
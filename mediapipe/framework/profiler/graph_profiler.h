@@ -17,11 +17,15 @@
 
 #include <atomic>
 #include <cstddef>
+#include <list>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "mediapipe/framework/calculator.pb.h"
 #include "mediapipe/framework/calculator_context.h"
@@ -30,8 +34,10 @@
 #include "mediapipe/framework/deps/monotonic_clock.h"
 #include "mediapipe/framework/executor.h"
 #include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/profiler/binary_trace.h"
 #include "mediapipe/framework/profiler/graph_tracer.h"
 #include "mediapipe/framework/profiler/sharded_map.h"
+#include "mediapipe/framework/profiler/time_histogram.h"
 #include "mediapipe/framework/validated_graph_config.h"
 
 namespace mediapipe {
@@ -153,6 +159,22 @@ class GraphProfiler : public std::enable_shared_from_this<ProfilingContext> {
   ::mediapipe::Status GetCalculatorProfiles(std::vector<CalculatorProfile>*)
       const ABSL_LOCKS_EXCLUDED(profiler_mutex_);
 
+  // Collects the end-to-end latency of the packets delivered from each graph
+  // output stream.  Requires ProfilerConfig.enable_graph_latency.
+  ::mediapipe::Status GetGraphOutputLatencies(
+      std::vector<GraphOutputLatency>* latencies) const
+      ABSL_LOCKS_EXCLUDED(graph_latency_mutex_);
+
+  // Returns the end-to-end latency of a recent packet delivered from the graph
+  // output stream |stream_name| at |timestamp|.  If ProfilerConfig
+  // trace_enabled is also set, the latency is broken down along the critical
+  // path of the packet.  Returns NotFoundError for a packet that is unknown
+  // or no longer recent.
+  ::mediapipe::Status GetPacketLatency(const std::string& stream_name,
+                                       Timestamp timestamp,
+                                       PacketLatency* latency)
+      ABSL_LOCKS_EXCLUDED(graph_latency_mutex_);
+
   // Writes recent profiling and tracing data to a file specified in the
   // ProfilerConfig.  Includes events since the previous call to WriteProfile.
   ::mediapipe::Status WriteProfile();
@@ -266,10 +288,35 @@ class GraphProfiler : public std::enable_shared_from_this<ProfilingContext> {
       const OutputStreamShardSet& output_stream_shard_set,
       int64 production_time_usec, int64 source_process_start_usec);
 
+  // The log-linear histograms of one calculator, which are recorded without
+  // locking the calculator profile and merged into it when it is read.
+  struct CalculatorHistograms {
+    std::unique_ptr<LogLinearTimeHistogram> process_runtime;
+    std::unique_ptr<LogLinearTimeHistogram> process_input_latency;
+    std::unique_ptr<LogLinearTimeHistogram> process_output_latency;
+    // Indexed like CalculatorProfile.input_stream_profiles.
+    std::vector<std::unique_ptr<LogLinearTimeHistogram>> input_stream_latency;
+  };
+
+  // Returns the log-linear histograms of a calculator, or nullptr if the
+  // histograms are linear.
+  CalculatorHistograms* GetCalculatorHistograms(
+      const CalculatorContext& calculator_context);
+
+  // Creates the log-linear histograms of a calculator and writes their
+  // initial state to |calculator_profile|.
+  void InitializeCalculatorHistograms(int node_id,
+                                      CalculatorProfile* calculator_profile);
+
+  // Copies the log-linear histograms of a calculator into its profile.
+  void WriteCalculatorHistograms(CalculatorProfile* calculator_profile) const;
+
   // Updates the production time for outputs and the stream profile for inputs.
+  // Input stream latencies are added to |histograms| if it is not null.
   int64 AddStreamLatencies(const CalculatorContext& calculator_context,
                            int64 start_time_usec, int64 end_time_usec,
-                           CalculatorProfile* calculator_profile);
+                           CalculatorProfile* calculator_profile,
+                           CalculatorHistograms* histograms);
 
   void SetOpenRuntime(const CalculatorContext& calculator_context,
                       int64 start_time_usec, int64 end_time_usec)
@@ -281,9 +328,11 @@ class GraphProfiler : public std::enable_shared_from_this<ProfilingContext> {
   // Updates the input streams profiles for the calculator and returns the
   // minimum |source_process_start_usec| of all input packets, excluding empty
   // packets and back-edge packets. Returns -1 if there is no input packets.
+  // Input stream latencies are added to |histograms| if it is not null.
   int64 AddInputStreamTimeSamples(const CalculatorContext& calculator_context,
                                   int64 start_time_usec,
-                                  CalculatorProfile* calculator_profile);
+                                  CalculatorProfile* calculator_profile,
+                                  CalculatorHistograms* histograms);
 
   // Updates the Process() data for calculator.
   // Requires ReaderLock for is_profiling_.
@@ -291,11 +340,25 @@ class GraphProfiler : public std::enable_shared_from_this<ProfilingContext> {
                         int64 start_time_usec, int64 end_time_usec)
       ABSL_LOCKS_EXCLUDED(profiler_mutex_);
 
+  // Records the time at which a graph input packet was added, if it is the
+  // first graph input packet at its timestamp.
+  void AddGraphInputTime(int64 timestamp_usec, int64 time_usec)
+      ABSL_LOCKS_EXCLUDED(graph_latency_mutex_);
+
+  // Records the end-to-end latency of a packet delivered from a graph output
+  // stream.
+  void AddGraphOutputLatency(const TraceEvent& packet_info)
+      ABSL_LOCKS_EXCLUDED(profiler_mutex_, graph_latency_mutex_);
+
   // Helper method to get trace_log_path.  If the trace_log_path is empty and
   // tracing is enabled, this function returns a default platform dependent
   // trace_log_path.
   ::mediapipe::StatusOr<std::string> GetTraceLogPath();
 
+  // Writes the trace events since the previous call to the binary trace file.
+  ::mediapipe::Status WriteBinaryTrace(const std::string& trace_log_path)
+      ABSL_LOCKS_EXCLUDED(binary_trace_mutex_);
+
   // Helper method to get the clock time in microsecond.
   int64 TimeNowUsec() { return ToUnixMicros(clock_->TimeNow()); }
 
@@ -319,6 +382,12 @@ class GraphProfiler : public std::enable_shared_from_this<ProfilingContext> {
   using PacketInfoMap =
       ShardedMap<std::string, std::list<std::pair<int64, PacketInfo>>>;
   PacketInfoMap packets_info_;
+  // The log-linear histograms of each calculator, indexed by node id, if
+  // ProfilerConfig.histogram_log_linear_bits is set.  These are created in
+  // Initialize() and only updated through atomic counters afterwards.
+  std::vector<CalculatorHistograms> calculator_histograms_;
+  // The node ids of the calculators with log-linear histograms, by name.
+  std::unordered_map<std::string, int> calculator_histogram_ids_;
 
   // Global mutex for the profiler.
   mutable absl::Mutex profiler_mutex_;
@@ -338,6 +407,29 @@ class GraphProfiler : public std::enable_shared_from_this<ProfilingContext> {
   // The index number of the previous output log.
   int previous_log_index_;
 
+  // The end-to-end latencies of the packets from one graph output stream.
+  struct GraphOutputLatencies {
+    std::unique_ptr<LogLinearTimeHistogram> histogram;
+    // The latencies of recent packets, by packet timestamp.
+    std::list<std::pair<int64, int64>> recent;
+  };
+
+  // The end-to-end latencies, if ProfilerConfig.enable_graph_latency is set.
+  mutable absl::Mutex graph_latency_mutex_;
+  // The time of the first graph input packet at each recent timestamp.
+  std::map<int64, int64> graph_input_times_
+      ABSL_GUARDED_BY(graph_latency_mutex_);
+  // The latencies of each graph output stream, by stream name.
+  std::map<std::string, GraphOutputLatencies> graph_output_latencies_
+      ABSL_GUARDED_BY(graph_latency_mutex_);
+
+  // The binary trace output file, if ProfilerConfig.trace_log_binary is set.
+  absl::Mutex binary_trace_mutex_;
+  std::unique_ptr<BinaryTraceWriter> binary_trace_writer_
+      ABSL_GUARDED_BY(binary_trace_mutex_);
+  // The index number of the previous binary trace write.
+  int binary_trace_log_index_ ABSL_GUARDED_BY(binary_trace_mutex_) = -1;
+
   // The configuration for the graph being profiled.
   const ValidatedGraphConfig* validated_graph_;
 
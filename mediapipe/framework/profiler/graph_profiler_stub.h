@@ -22,12 +22,16 @@ namespace mediapipe {
 class CalculatorProfile;
 class GraphTrace;
 class GraphProfile;
+class GraphOutputLatency;
+class PacketLatency;
 }  // namespace mediapipe
 
 namespace mediapipe {
 using mediapipe::CalculatorProfile;
+using mediapipe::GraphOutputLatency;
 using mediapipe::GraphProfile;
 using mediapipe::GraphTrace;
+using mediapipe::PacketLatency;
 
 class ValidatedGraphConfig;
 class Executor;
@@ -55,6 +59,8 @@ class TraceEvent {
     TPU_TASK,
     GPU_CALIBRATION,
     PACKET_QUEUED,
+    PACKET_DELIVERED,
+    PACKET_DROPPED,
   };
   TraceEvent(const EventType& event_type) {}
   TraceEvent() {}
@@ -85,6 +91,16 @@ class GraphProfilerStub {
       std::vector<CalculatorProfile>*) const {
     return mediapipe::OkStatus();
   }
+  inline ::mediapipe::Status GetGraphOutputLatencies(
+      std::vector<GraphOutputLatency>*) const {
+    return mediapipe::OkStatus();
+  }
+  inline ::mediapipe::Status GetPacketLatency(const std::string& stream_name,
+                                              Timestamp timestamp,
+                                              PacketLatency* latency) {
+    return ::mediapipe::Status(::mediapipe::StatusCode::kUnavailable,
+                               "The graph profiler is not available.");
+  }
   inline void Pause() {}
   inline void Resume() {}
   inline void Reset() {}
@@ -24,8 +24,10 @@
 #include "mediapipe/framework/port/status_matchers.h"
 #include "mediapipe/framework/port/statusor.h"
 #include "mediapipe/framework/profiler/test_context_builder.h"
+#include "mediapipe/framework/profiler/time_histogram.h"
 #include "mediapipe/framework/tool/simulation_clock.h"
 #include "mediapipe/framework/tool/tag_map_helper.h"
+#include "mediapipe/util/cpu_util.h"
 
 using ::testing::EqualsProto;
 using ::testing::proto::Partially;
@@ -1017,6 +1019,109 @@ TEST_F(GraphProfilerTestPeer, AddProcessSample) {
   ASSERT_EQ(GetPacketsInfoMap()->size(), 0);
 }
 
+// Tests that AddProcessSample() attributes the Process() call to the NUMA node
+// of the calling thread when NUMA node stats are enabled.
+TEST_F(GraphProfilerTestPeer, AddProcessSampleWithNumaNodeStats) {
+  InitializeProfilerWithGraphConfig(R"(
+    profiler_config {
+      enable_profiler: true
+      enable_numa_node_stats: true
+    }
+    input_stream: "input_stream"
+    node {
+      calculator: "DummyTestCalculator"
+      input_stream: "input_stream"
+      output_stream: "output_stream"
+    })");
+  std::shared_ptr<mediapipe::SimulationClock> simulation_clock(
+      new SimulationClock());
+  simulation_clock->ThreadStart();
+  profiler_.SetClock(simulation_clock);
+
+  TestContextBuilder context(kDummyTestCalculatorName, /*node_id=*/0,
+                             {"input_stream"}, {"output_stream"});
+  context.AddInputs({MakePacket<std::string>("5").At(Timestamp(100))});
+  context.AddOutputs({{MakePacket<std::string>("15").At(Timestamp(100))}});
+
+  {
+    GraphProfiler::Scope profiler_scope(GraphTrace::PROCESS, context.get(),
+                                        &profiler_);
+    simulation_clock->Sleep(absl::Microseconds(150));
+  }
+
+  std::vector<CalculatorProfile> profiles = Profiles();
+  simulation_clock->ThreadFinish();
+
+  ASSERT_EQ(profiles.size(), 1);
+  ASSERT_EQ(profiles[0].numa_node_profiles_size(), GetNumaNodeCpuIds().size());
+  int64 process_count = 0;
+  int64 process_runtime = 0;
+  for (int node = 0; node < profiles[0].numa_node_profiles_size(); ++node) {
+    const NumaNodeProfile& numa_node_profile =
+        profiles[0].numa_node_profiles(node);
+    EXPECT_EQ(numa_node_profile.numa_node(), node);
+    process_count += numa_node_profile.process_count();
+    process_runtime += numa_node_profile.process_runtime();
+  }
+  EXPECT_EQ(process_count, 1);
+  EXPECT_EQ(process_runtime, 150);
+
+  profiler_.Reset();
+  for (const NumaNodeProfile& numa_node_profile :
+       Profiles()[0].numa_node_profiles()) {
+    EXPECT_EQ(numa_node_profile.process_count(), 0);
+  }
+}
+
+// Tests that AddProcessSample() records Process() runtimes in a log-linear
+// histogram, from which GetCalculatorProfiles() reports tail percentiles.
+TEST_F(GraphProfilerTestPeer, AddProcessSampleWithLogLinearHistogram) {
+  InitializeProfilerWithGraphConfig(R"(
+    profiler_config {
+      enable_profiler: true
+      histogram_log_linear_bits: 4
+    }
+    input_stream: "input_stream"
+    node {
+      calculator: "DummyTestCalculator"
+      input_stream: "input_stream"
+      output_stream: "output_stream"
+    })");
+  std::shared_ptr<mediapipe::SimulationClock> simulation_clock(
+      new SimulationClock());
+  simulation_clock->ThreadStart();
+  profiler_.SetClock(simulation_clock);
+
+  TestContextBuilder context(kDummyTestCalculatorName, /*node_id=*/0,
+                             {"input_stream"}, {"output_stream"});
+  context.AddInputs({MakePacket<std::string>("5").At(Timestamp(100))});
+  // 99 short Process() calls and one long one.
+  for (int i = 0; i < 100; ++i) {
+    GraphProfiler::Scope profiler_scope(GraphTrace::PROCESS, context.get(),
+                                        &profiler_);
+    simulation_clock->Sleep(absl::Microseconds(i < 99 ? 150 : 20000));
+  }
+
+  std::vector<CalculatorProfile> profiles = Profiles();
+  simulation_clock->ThreadFinish();
+
+  ASSERT_EQ(profiles.size(), 1);
+  const TimeHistogram& process_runtime = profiles[0].process_runtime();
+  EXPECT_EQ(process_runtime.log_linear_bits(), 4);
+  EXPECT_EQ(process_runtime.total(), 99 * 150 + 20000);
+  EXPECT_EQ(process_runtime.count(LogLinearTimeHistogram::IntervalIndex(
+                4, 150)),
+            99);
+  EXPECT_EQ(process_runtime.count(LogLinearTimeHistogram::IntervalIndex(
+                4, 20000)),
+            1);
+  EXPECT_EQ(GetTimeHistogramPercentile(process_runtime, 99), 152);
+  EXPECT_EQ(GetTimeHistogramPercentile(process_runtime, 99.9), 20480);
+
+  profiler_.Reset();
+  EXPECT_EQ(Profiles()[0].process_runtime().total(), 0);
+}
+
 // Tests that AddProcessSample() updates |process_runtime| and also updates the
 // packet info map when stream latency is enabled.
 TEST_F(GraphProfilerTestPeer, AddProcessSampleWithStreamLatency) {
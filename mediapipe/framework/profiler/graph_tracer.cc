@@ -14,12 +14,14 @@
 
 #include "mediapipe/framework/profiler/graph_tracer.h"
 
+#include "absl/memory/memory.h"
 #include "absl/time/time.h"
 #include "mediapipe/framework/calculator_context.h"
 #include "mediapipe/framework/calculator_profile.pb.h"
 #include "mediapipe/framework/input_stream_shard.h"
 #include "mediapipe/framework/output_stream_shard.h"
 #include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/profiler/trace_builder.h"
 #include "mediapipe/framework/timestamp.h"
 
@@ -52,7 +54,15 @@ int64 GraphTracer::GetTraceLogCapacity() {
 }
 
 GraphTracer::GraphTracer(const ProfilerConfig& profiler_config)
-    : profiler_config_(profiler_config), trace_buffer_(GetTraceLogCapacity()) {
+    : profiler_config_(profiler_config),
+      // The TraceBuffer stays empty in binary trace mode, but it still needs
+      // a nonzero capacity, since CircularBuffer indexes modulo its size.
+      trace_buffer_(
+          profiler_config.trace_log_binary() ? 1 : GetTraceLogCapacity()) {
+  if (profiler_config_.trace_log_binary()) {
+    trace_rings_ = absl::make_unique<PerThreadTraceRings<TraceEvent>>(
+        GetTraceLogCapacity());
+  }
   for (int disabled : profiler_config_.trace_event_types_disabled()) {
     EventType event_type = static_cast<EventType>(disabled);
     (*trace_event_registry())[event_type].set_enabled(false);
@@ -68,6 +78,10 @@ void GraphTracer::LogEvent(TraceEvent event) {
     return;
   }
   event.set_thread_id(GetCurrentThreadId());
+  if (trace_rings_) {
+    trace_rings_->push_back(event);
+    return;
+  }
   trace_buffer_.push_back(event);
 }
 
@@ -131,6 +145,24 @@ void GraphTracer::GetLog(absl::Time begin_time, absl::Time end_time,
 
 const TraceBuffer& GraphTracer::GetTraceBuffer() { return trace_buffer_; }
 
+void GraphTracer::GetCriticalPath(const std::string& stream_name,
+                                  Timestamp packet_ts, PacketLatency* result) {
+  TraceBuilder::CreateCriticalPath(trace_buffer_, stream_name, packet_ts,
+                                   result);
+}
+
+::mediapipe::Status GraphTracer::WriteBinaryTrace(BinaryTraceWriter* writer) {
+  RET_CHECK(trace_rings_) << "Binary trace output is not enabled.";
+  ::mediapipe::Status status;
+  trace_rings_->PopAll([&](const TraceEvent& event) {
+    if (status.ok()) {
+      status = writer->WriteEvent(event);
+    }
+  });
+  MP_RETURN_IF_ERROR(status);
+  return writer->Flush(trace_rings_->dropped());
+}
+
 Timestamp GraphTracer::GetOutputTimestamp(const CalculatorContext* context) {
   for (const OutputStreamShard& out_stream : context->Outputs()) {
     for (const Packet& packet : *out_stream.OutputQueue()) {
@@ -15,13 +15,17 @@
 #ifndef MEDIAPIPE_FRAMEWORK_PROFILER_GRAPH_TRACER_H_
 #define MEDIAPIPE_FRAMEWORK_PROFILER_GRAPH_TRACER_H_
 
+#include <memory>
 #include <string>
 
 #include "mediapipe/framework/calculator.pb.h"
 #include "mediapipe/framework/calculator_context.h"
 #include "mediapipe/framework/calculator_profile.pb.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/profiler/binary_trace.h"
 #include "mediapipe/framework/profiler/trace_buffer.h"
 #include "mediapipe/framework/profiler/trace_builder.h"
+#include "mediapipe/framework/profiler/trace_ring.h"
 
 namespace mediapipe {
 
@@ -44,6 +48,10 @@ namespace mediapipe {
 //
 //   end_time = current_time - max_packet_latency
 //
+// If ProfilerConfig.trace_log_binary is set, events are instead buffered in a
+// TraceRing for each logging thread, and are removed from the rings by
+// WriteBinaryTrace.  GetTrace and GetLog return no events in this mode.
+//
 class GraphTracer {
  public:
   // Returns the interval between trace log output.
@@ -81,6 +89,17 @@ class GraphTracer {
   // Returns the logged TraceEvents.
   const TraceBuffer& GetTraceBuffer();
 
+  // Fills in the critical path of the packet at |packet_ts| on |stream_name|
+  // from the buffered TraceEvents.
+  void GetCriticalPath(const std::string& stream_name, Timestamp packet_ts,
+                       PacketLatency* result);
+
+  // Returns true if events are buffered for WriteBinaryTrace.
+  bool IsBinaryTraceEnabled() const { return trace_rings_ != nullptr; }
+
+  // Moves the events logged since the previous call into a binary trace.
+  ::mediapipe::Status WriteBinaryTrace(BinaryTraceWriter* writer);
+
  private:
   // Returns the timestamp of the first output packet.
   Timestamp GetOutputTimestamp(const CalculatorContext* context);
@@ -91,6 +110,9 @@ class GraphTracer {
   // The circular buffer of TraceEvents.
   TraceBuffer trace_buffer_;
 
+  // The per-thread TraceEvent rings, used for binary trace output.
+  std::unique_ptr<PerThreadTraceRings<TraceEvent>> trace_rings_;
+
   // The builder for the GraphTrace protobuf.
   TraceBuilder trace_builder_;
 };
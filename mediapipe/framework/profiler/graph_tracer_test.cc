@@ -36,6 +36,7 @@
 #include "mediapipe/framework/port/parse_text_proto.h"
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/profiler/binary_trace.h"
 #include "mediapipe/framework/profiler/graph_profiler.h"
 #include "mediapipe/framework/profiler/test_context_builder.h"
 #include "mediapipe/framework/tool/simulation_clock.h"
@@ -648,6 +649,42 @@ TEST_F(GraphTracerE2ETest, PassThroughGraphProfile) {
             2);
 }
 
+TEST_F(GraphTracerE2ETest, PassThroughGraphLatency) {
+  SetUpPassThroughGraph();
+  graph_config_.mutable_profiler_config()->set_enable_profiler(true);
+  graph_config_.mutable_profiler_config()->set_enable_graph_latency(true);
+  graph_config_.mutable_profiler_config()->set_trace_log_disabled(true);
+  RunPassThroughGraph();
+
+  std::vector<GraphOutputLatency> latencies;
+  MP_ASSERT_OK(graph_.profiler()->GetGraphOutputLatencies(&latencies));
+  ASSERT_EQ(1, latencies.size());
+  EXPECT_EQ("output_0", latencies[0].stream_name());
+  int64 num_samples = 0;
+  for (int64 count : latencies[0].latency().count()) {
+    num_samples += count;
+  }
+  EXPECT_EQ(6, num_samples);
+  EXPECT_EQ(20001 + 35001 + 50001 + 65001 + 80001 + 95001,
+            latencies[0].latency().total());
+
+  // The last packet waits 75000 usec for the LambdaCalculator.
+  PacketLatency latency;
+  MP_ASSERT_OK(graph_.profiler()->GetPacketLatency("output_0",
+                                                   Timestamp(60000), &latency));
+  EXPECT_EQ(95001, latency.latency_usec());
+  ASSERT_EQ(1, latency.critical_path_size());
+  EXPECT_EQ("LambdaCalculator", latency.critical_path(0).node_name());
+  EXPECT_EQ(60000, latency.critical_path(0).input_timestamp());
+  EXPECT_EQ(75000, latency.critical_path(0).wait_usec());
+  EXPECT_EQ(20001, latency.critical_path(0).process_usec());
+  EXPECT_EQ(0, latency.delivery_wait_usec());
+
+  EXPECT_FALSE(graph_.profiler()
+                   ->GetPacketLatency("output_0", Timestamp(65000), &latency)
+                   .ok());
+}
+
 TEST_F(GraphTracerE2ETest, DemuxGraphLog) {
   SetUpDemuxInFlightGraph();
   RunDemuxInFlightGraph();
@@ -1008,6 +1045,48 @@ TEST_F(GraphTracerE2ETest, DemuxGraphLogFile) {
   EXPECT_EQ(111, profile.graph_trace(0).calculator_trace().size());
 }
 
+TEST_F(GraphTracerE2ETest, DemuxGraphBinaryLogFile) {
+  std::string log_path = absl::StrCat(getenv("TEST_TMPDIR"), "/binary_log_");
+  SetUpDemuxInFlightGraph();
+  graph_config_.mutable_profiler_config()->set_trace_log_path(log_path);
+  graph_config_.mutable_profiler_config()->set_trace_log_interval_usec(-1);
+  graph_config_.mutable_profiler_config()->set_trace_log_binary(true);
+  RunDemuxInFlightGraph();
+  BinaryTrace trace;
+  MP_ASSERT_OK(
+      ReadBinaryTrace(absl::StrCat(log_path, 0, ".mptrace"), &trace));
+  EXPECT_EQ(graph_config_.node_size(), trace.node_names.size());
+  EXPECT_FALSE(trace.events.empty());
+  EXPECT_EQ(0, trace.dropped_events);
+  std::string json;
+  MP_ASSERT_OK(ConvertBinaryTraceToChromeJson(trace, &json));
+  EXPECT_THAT(json,
+              testing::HasSubstr("\"name\":\"RoundRobinDemuxCalculator\""));
+}
+
+// The binary trace rotates through trace_log_count files.
+TEST_F(GraphTracerE2ETest, DemuxGraphBinaryLogFiles) {
+  std::string log_path =
+      absl::StrCat(getenv("TEST_TMPDIR"), "/binary_log_files_");
+  SetUpDemuxInFlightGraph();
+  graph_config_.mutable_profiler_config()->set_trace_log_path(log_path);
+  graph_config_.mutable_profiler_config()->set_trace_log_binary(true);
+  graph_config_.mutable_profiler_config()->set_trace_log_count(2);
+  graph_config_.mutable_profiler_config()->set_trace_log_interval_count(1);
+  graph_config_.mutable_profiler_config()->set_trace_log_interval_usec(2500);
+  RunDemuxInFlightGraph();
+  for (int i = 0; i < 2; ++i) {
+    BinaryTrace trace;
+    MP_ASSERT_OK(
+        ReadBinaryTrace(absl::StrCat(log_path, i, ".mptrace"), &trace));
+    // Every file names the nodes.
+    EXPECT_EQ(graph_config_.node_size(), trace.node_names.size());
+  }
+  BinaryTrace trace;
+  EXPECT_FALSE(
+      ReadBinaryTrace(absl::StrCat(log_path, 2, ".mptrace"), &trace).ok());
+}
+
 TEST_F(GraphTracerE2ETest, DemuxGraphLogFiles) {
   std::string log_path = absl::StrCat(getenv("TEST_TMPDIR"), "/log_files_");
   SetUpDemuxInFlightGraph();
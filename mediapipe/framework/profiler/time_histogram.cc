@@ -0,0 +1,141 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/time_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "absl/strings/substitute.h"
+#include "mediapipe/framework/port/logging.h"
+
+namespace mediapipe {
+
+namespace {
+
+// Returns the index of the highest set bit of a positive value.
+inline int Log2Floor(uint64 value) {
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll(value);
+#else
+  int result = 0;
+  while (value >>= 1) {
+    ++result;
+  }
+  return result;
+#endif
+}
+
+}  // namespace
+
+constexpr int LogLinearTimeHistogram::kMaxExponent;
+constexpr int LogLinearTimeHistogram::kMaxBits;
+
+LogLinearTimeHistogram::LogLinearTimeHistogram(int bits)
+    : bits_(bits), total_(0) {
+  CHECK(0 < bits && bits <= kMaxBits)
+      << "Unsupported log-linear histogram bits: " << bits;
+  counts_ = std::vector<std::atomic<int64>>(NumIntervals(bits));
+  Reset();
+}
+
+void LogLinearTimeHistogram::AddTimeSample(int64 start_time_usec,
+                                           int64 end_time_usec) {
+  if (end_time_usec < start_time_usec) {
+    LOG(ERROR) << absl::Substitute(
+        "end_time_usec ($0) is < start_time_usec ($1)", end_time_usec,
+        start_time_usec);
+    return;
+  }
+  int64 time_usec = end_time_usec - start_time_usec;
+  total_.fetch_add(time_usec, std::memory_order_relaxed);
+  counts_[IntervalIndex(bits_, time_usec)].fetch_add(
+      1, std::memory_order_relaxed);
+}
+
+void LogLinearTimeHistogram::Reset() {
+  total_.store(0, std::memory_order_relaxed);
+  for (auto& count : counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+}
+
+void LogLinearTimeHistogram::WriteTo(TimeHistogram* histogram) const {
+  histogram->set_total(total_.load(std::memory_order_relaxed));
+  histogram->set_num_intervals(counts_.size());
+  histogram->set_log_linear_bits(bits_);
+  histogram->mutable_count()->Resize(counts_.size(), /*value=*/0);
+  for (int i = 0; i < counts_.size(); ++i) {
+    histogram->set_count(i, counts_[i].load(std::memory_order_relaxed));
+  }
+}
+
+int64 LogLinearTimeHistogram::NumIntervals(int bits) {
+  return static_cast<int64>(kMaxExponent - bits + 1) << bits;
+}
+
+int64 LogLinearTimeHistogram::IntervalIndex(int bits, int64 time_usec) {
+  const int64 sub_intervals = int64{1} << bits;
+  if (time_usec < sub_intervals) {
+    return std::max<int64>(time_usec, 0);
+  }
+  const int exponent = Log2Floor(time_usec);
+  if (exponent >= kMaxExponent) {
+    return NumIntervals(bits) - 1;
+  }
+  const int shift = exponent - bits;
+  return (static_cast<int64>(shift + 1) << bits) +
+         ((time_usec >> shift) - sub_intervals);
+}
+
+int64 LogLinearTimeHistogram::IntervalLowerBound(int bits, int64 index) {
+  const int64 sub_intervals = int64{1} << bits;
+  if (index < sub_intervals) {
+    return index;
+  }
+  const int shift = (index >> bits) - 1;
+  return (sub_intervals + (index & (sub_intervals - 1))) << shift;
+}
+
+int64 GetTimeHistogramPercentile(const TimeHistogram& histogram,
+                                 double percentile) {
+  int64 num_samples = 0;
+  for (int64 count : histogram.count()) {
+    num_samples += count;
+  }
+  if (num_samples == 0) {
+    return 0;
+  }
+  // The 1-based rank of the sample at the percentile.  The small offset keeps
+  // rounding errors from moving exact ranks, such as 99.9% of 1000, up by one.
+  int64 rank = std::ceil(percentile / 100.0 * num_samples - 1e-9);
+  rank = std::max<int64>(1, std::min(rank, num_samples));
+  auto lower_bound = [&histogram](int64 index) {
+    return histogram.log_linear_bits()
+               ? LogLinearTimeHistogram::IntervalLowerBound(
+                     histogram.log_linear_bits(), index)
+               : index * histogram.interval_size_usec();
+  };
+  const int last_interval = histogram.count_size() - 1;
+  int64 cumulative_count = 0;
+  for (int i = 0; i < last_interval; ++i) {
+    cumulative_count += histogram.count(i);
+    if (cumulative_count >= rank) {
+      return lower_bound(i + 1);
+    }
+  }
+  return lower_bound(last_interval);
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,87 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_PROFILER_TIME_HISTOGRAM_H_
+#define MEDIAPIPE_FRAMEWORK_PROFILER_TIME_HISTOGRAM_H_
+
+#include <atomic>
+#include <vector>
+
+#include "mediapipe/framework/calculator_profile.pb.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+// A histogram of times with log-linear intervals, in the style of
+// HdrHistogram.  Each power-of-two range of times [2^k, 2^(k+1)) usec is
+// split into 2^bits equal intervals, so any time read from the histogram is
+// within a relative error of 2^-bits.  Times below 2^bits usec fall into
+// 1 usec intervals, and times of 2^kMaxExponent usec or more fall into the
+// last interval.
+//
+// Samples are counted with relaxed atomic increments, so AddTimeSample can be
+// called from many threads without locking.  WriteTo and Reset may run
+// concurrently with AddTimeSample, but then see some of the concurrent
+// samples and not others.
+class LogLinearTimeHistogram {
+ public:
+  // The highest power of two of the times with separate intervals.
+  static constexpr int kMaxExponent = 40;
+  // The highest supported number of bits.
+  static constexpr int kMaxBits = 10;
+
+  // Creates a histogram with 2^bits intervals per power of two.
+  // Requires 0 < bits <= kMaxBits.
+  explicit LogLinearTimeHistogram(int bits);
+
+  LogLinearTimeHistogram(const LogLinearTimeHistogram&) = delete;
+  LogLinearTimeHistogram& operator=(const LogLinearTimeHistogram&) = delete;
+
+  // Adds one sample of end_time_usec - start_time_usec.
+  void AddTimeSample(int64 start_time_usec, int64 end_time_usec);
+
+  // Clears all samples.
+  void Reset();
+
+  // Writes the counts to |histogram|, including log_linear_bits.
+  void WriteTo(TimeHistogram* histogram) const;
+
+  int bits() const { return bits_; }
+  int64 num_intervals() const { return counts_.size(); }
+
+  // Returns the number of intervals of a histogram with |bits|.
+  static int64 NumIntervals(int bits);
+  // Returns the index of the interval containing |time_usec|.
+  static int64 IntervalIndex(int bits, int64 time_usec);
+  // Returns the lowest time in the interval at |index|.
+  static int64 IntervalLowerBound(int bits, int64 index);
+
+ private:
+  const int bits_;
+  std::atomic<int64> total_;
+  std::vector<std::atomic<int64>> counts_;
+};
+
+// Returns the time in usec below which |percentile| percent of the samples in
+// |histogram| fall, for either linear or log-linear intervals.  The result is
+// the upper bound of the interval containing the percentile, or the lower
+// bound if it is the last interval, which has no upper bound.  Returns 0 for
+// an empty histogram.  For example, the 99th percentile is
+// GetTimeHistogramPercentile(histogram, 99).
+int64 GetTimeHistogramPercentile(const TimeHistogram& histogram,
+                                 double percentile);
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_PROFILER_TIME_HISTOGRAM_H_
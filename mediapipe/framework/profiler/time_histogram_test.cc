@@ -0,0 +1,152 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/time_histogram.h"
+
+#include "mediapipe/framework/calculator_profile.pb.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/threadpool.h"
+
+namespace mediapipe {
+namespace {
+
+TEST(LogLinearTimeHistogramTest, IntervalBounds) {
+  // With 2 bits, each power of two has 4 intervals.
+  EXPECT_EQ(LogLinearTimeHistogram::IntervalIndex(2, 0), 0);
+  EXPECT_EQ(LogLinearTimeHistogram::IntervalIndex(2, 3), 3);
+  EXPECT_EQ(LogLinearTimeHistogram::IntervalIndex(2, 4), 4);
+  EXPECT_EQ(LogLinearTimeHistogram::IntervalIndex(2, 7), 7);
+  EXPECT_EQ(LogLinearTimeHistogram::IntervalIndex(2, 8), 8);
+  EXPECT_EQ(LogLinearTimeHistogram::IntervalIndex(2, 9), 8);
+  EXPECT_EQ(LogLinearTimeHistogram::IntervalIndex(2, 10), 9);
+  EXPECT_EQ(LogLinearTimeHistogram::IntervalIndex(2, 1000), 35);
+  EXPECT_EQ(LogLinearTimeHistogram::IntervalLowerBound(2, 35), 896);
+  EXPECT_EQ(LogLinearTimeHistogram::IntervalLowerBound(2, 36), 1024);
+
+  // Every interval starts where the previous one ends.
+  for (int bits = 1; bits <= 4; ++bits) {
+    const int64 num_intervals = LogLinearTimeHistogram::NumIntervals(bits);
+    for (int64 i = 1; i < num_intervals; ++i) {
+      int64 lower_bound = LogLinearTimeHistogram::IntervalLowerBound(bits, i);
+      EXPECT_EQ(LogLinearTimeHistogram::IntervalIndex(bits, lower_bound), i);
+      EXPECT_EQ(
+          LogLinearTimeHistogram::IntervalIndex(bits, lower_bound - 1), i - 1);
+    }
+  }
+}
+
+TEST(LogLinearTimeHistogramTest, LastIntervalIsOpen) {
+  const int64 last_interval = LogLinearTimeHistogram::NumIntervals(3) - 1;
+  EXPECT_EQ(LogLinearTimeHistogram::IntervalIndex(
+                3, int64{1} << LogLinearTimeHistogram::kMaxExponent),
+            last_interval);
+  EXPECT_EQ(LogLinearTimeHistogram::IntervalIndex(3, kint64max),
+            last_interval);
+}
+
+TEST(LogLinearTimeHistogramTest, WritesTimeHistogram) {
+  LogLinearTimeHistogram histogram(3);
+  histogram.AddTimeSample(100, 105);
+  histogram.AddTimeSample(100, 1100);
+  histogram.AddTimeSample(100, 1100);
+  // Samples ending before they start are ignored.
+  histogram.AddTimeSample(100, 50);
+
+  TimeHistogram proto;
+  histogram.WriteTo(&proto);
+  EXPECT_EQ(proto.total(), 2005);
+  EXPECT_EQ(proto.log_linear_bits(), 3);
+  EXPECT_EQ(proto.num_intervals(), LogLinearTimeHistogram::NumIntervals(3));
+  ASSERT_EQ(proto.count_size(), proto.num_intervals());
+  EXPECT_EQ(proto.count(5), 1);
+  EXPECT_EQ(proto.count(LogLinearTimeHistogram::IntervalIndex(3, 1000)), 2);
+
+  histogram.Reset();
+  histogram.WriteTo(&proto);
+  EXPECT_EQ(proto.total(), 0);
+  for (int64 count : proto.count()) {
+    EXPECT_EQ(count, 0);
+  }
+}
+
+TEST(LogLinearTimeHistogramTest, ParallelSamplesAreCounted) {
+  const int kNumThreads = 4;
+  const int kNumSamples = 10000;
+  LogLinearTimeHistogram histogram(4);
+  {
+    ::mediapipe::ThreadPool pool(kNumThreads);
+    pool.StartWorkers();
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([&histogram]() {
+        for (int i = 0; i < kNumSamples; ++i) {
+          histogram.AddTimeSample(0, i);
+        }
+      });
+    }
+  }
+  TimeHistogram proto;
+  histogram.WriteTo(&proto);
+  int64 num_samples = 0;
+  for (int64 count : proto.count()) {
+    num_samples += count;
+  }
+  EXPECT_EQ(num_samples, kNumThreads * kNumSamples);
+  EXPECT_EQ(proto.total(),
+            int64{kNumThreads} * kNumSamples * (kNumSamples - 1) / 2);
+}
+
+TEST(TimeHistogramPercentileTest, LogLinearPercentiles) {
+  LogLinearTimeHistogram histogram(7);
+  for (int i = 1; i <= 1000; ++i) {
+    histogram.AddTimeSample(0, 1000 * i);
+  }
+  TimeHistogram proto;
+  histogram.WriteTo(&proto);
+  // Each percentile is within the relative error of 2^-7.
+  EXPECT_NEAR(GetTimeHistogramPercentile(proto, 50), 500000, 500000 / 128);
+  EXPECT_NEAR(GetTimeHistogramPercentile(proto, 99), 990000, 990000 / 128);
+  EXPECT_NEAR(GetTimeHistogramPercentile(proto, 99.9), 999000, 999000 / 128);
+  EXPECT_GE(GetTimeHistogramPercentile(proto, 99.9), 999000);
+  EXPECT_NEAR(GetTimeHistogramPercentile(proto, 100), 1000000, 1000000 / 128);
+}
+
+TEST(TimeHistogramPercentileTest, LinearPercentiles) {
+  TimeHistogram proto;
+  proto.set_interval_size_usec(1000);
+  proto.set_num_intervals(3);
+  proto.add_count(90);
+  proto.add_count(9);
+  proto.add_count(1);
+  EXPECT_EQ(GetTimeHistogramPercentile(proto, 50), 1000);
+  EXPECT_EQ(GetTimeHistogramPercentile(proto, 90), 1000);
+  EXPECT_EQ(GetTimeHistogramPercentile(proto, 99), 2000);
+  // The last interval has no upper bound.
+  EXPECT_EQ(GetTimeHistogramPercentile(proto, 99.9), 2000);
+  EXPECT_EQ(GetTimeHistogramPercentile(TimeHistogram(), 99), 0);
+}
+
+void BM_AddLogLinearTimeSample(benchmark::State& state) {
+  static LogLinearTimeHistogram* histogram = new LogLinearTimeHistogram(7);
+  int64 time_usec = 0;
+  for (auto _ : state) {
+    histogram->AddTimeSample(0, time_usec);
+    time_usec = (time_usec + 7919) & 0xfffff;
+  }
+}
+BENCHMARK(BM_AddLogLinearTimeSample)->ThreadRange(1, 8);
+
+}  // namespace
+}  // namespace mediapipe
@@ -109,6 +109,8 @@ struct TraceEvent {
   static constexpr EventType TPU_TASK = GraphTrace::TPU_TASK;
   static constexpr EventType GPU_CALIBRATION = GraphTrace::GPU_CALIBRATION;
   static constexpr EventType PACKET_QUEUED = GraphTrace::PACKET_QUEUED;
+  static constexpr EventType PACKET_DELIVERED = GraphTrace::PACKET_DELIVERED;
+  static constexpr EventType PACKET_DROPPED = GraphTrace::PACKET_DROPPED;
 };
 
 // Packet trace log buffer.
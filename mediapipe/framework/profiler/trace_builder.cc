@@ -17,6 +17,7 @@
 #include <algorithm>
 #include <cstddef>
 #include <functional>
+#include <map>
 #include <memory>
 #include <type_traits>
 #include <unordered_map>
@@ -84,6 +85,11 @@ void BasicTraceEventTypes(TraceEventRegistry* result) {
        "A time measured by GPU clock and by CPU clock.", true, false},
       {TraceEvent::PACKET_QUEUED, "An input queue size when a packet arrives.",
        true, true, false},
+      {TraceEvent::PACKET_DELIVERED,
+       "A packet delivered from a graph output stream.", true, true},
+      {TraceEvent::PACKET_DROPPED,
+       "The number of stale packets dropped from an input queue.", true, true,
+       false},
   };
   for (TraceEventType t : basic_types) {
     (*result)[t.event_type()] = t;
@@ -179,6 +185,84 @@ class TraceBuilder::Impl {
     return max_ts + 1;
   }
 
+  static void CreateCriticalPath(const TraceBuffer& buffer,
+                                 const std::string& stream_name,
+                                 Timestamp packet_ts, PacketLatency* result) {
+    // Index the Process() output and input events, and the packet deliveries.
+    using PacketKey = std::pair<std::string, int64>;
+    using TaskKey = std::pair<int, int64>;
+    std::map<PacketKey, TraceEvent> output_events;
+    std::map<PacketKey, TraceEvent> delivery_events;
+    std::map<TaskKey, absl::Time> task_start_times;
+    std::map<TaskKey, std::vector<TraceEvent>> task_input_events;
+    TraceBuffer::iterator buffer_end = buffer.end();
+    for (auto iter = buffer.begin(); iter < buffer_end; ++iter) {
+      TraceEvent event = *iter;
+      if (event.stream_id == nullptr) {
+        continue;
+      }
+      PacketKey packet_key{*event.stream_id, event.packet_ts.Value()};
+      TaskKey task_key{event.node_id, event.input_ts.Value()};
+      if (event.event_type == TraceEvent::PACKET_DELIVERED) {
+        delivery_events.emplace(packet_key, event);
+      } else if (event.event_type != TraceEvent::PROCESS) {
+        continue;
+      } else if (event.is_finish) {
+        output_events.emplace(packet_key, event);
+      } else {
+        auto start = task_start_times.emplace(task_key, event.event_time);
+        start.first->second = std::min(start.first->second, event.event_time);
+        task_input_events[task_key].push_back(event);
+      }
+    }
+
+    // Walk back from the output packet, one Process() call at a time.
+    result->clear_critical_path();
+    PacketKey packet_key{stream_name, packet_ts.Value()};
+    auto delivery = delivery_events.find(packet_key);
+    for (int i = 0; i < output_events.size(); ++i) {
+      auto output = output_events.find(packet_key);
+      if (output == output_events.end() || output->second.node_id < 0) {
+        break;
+      }
+      const TraceEvent& output_event = output->second;
+      if (i == 0 && delivery != delivery_events.end()) {
+        result->set_delivery_wait_usec(absl::ToInt64Microseconds(
+            delivery->second.event_time - output_event.event_time));
+      }
+      TaskKey task_key{output_event.node_id, output_event.input_ts.Value()};
+      auto start = task_start_times.find(task_key);
+      absl::Time start_time = start != task_start_times.end()
+                                  ? start->second
+                                  : output_event.event_time;
+      PacketLatency::NodeLatency* node_latency = result->add_critical_path();
+      node_latency->set_node_id(output_event.node_id);
+      node_latency->set_input_timestamp(output_event.input_ts.Value());
+      node_latency->set_process_usec(
+          absl::ToInt64Microseconds(output_event.event_time - start_time));
+
+      // Find the input packet that was output last.
+      const TraceEvent* last_output = nullptr;
+      for (const TraceEvent& input_event : task_input_events[task_key]) {
+        auto input_output = output_events.find(
+            {*input_event.stream_id, input_event.packet_ts.Value()});
+        if (input_output != output_events.end() &&
+            (!last_output ||
+             input_output->second.event_time > last_output->event_time)) {
+          last_output = &input_output->second;
+        }
+      }
+      if (!last_output) {
+        break;
+      }
+      node_latency->set_wait_usec(
+          absl::ToInt64Microseconds(start_time - last_output->event_time));
+      packet_key = {*last_output->stream_id, last_output->packet_ts.Value()};
+    }
+    std::reverse(result->mutable_critical_path()->begin(),
+                 result->mutable_critical_path()->end());
+  }
+
   void CreateTrace(const TraceBuffer& buffer, absl::Time begin_time,
                    absl::Time end_time, GraphTrace* result) {
     // Snapshot recent TraceEvents
@@ -410,6 +494,12 @@ void TraceBuilder::CreateLog(const TraceBuffer& buffer, absl::Time begin_time,
                              absl::Time end_time, GraphTrace* result) {
   impl_->CreateLog(buffer, begin_time, end_time, result);
 }
+void TraceBuilder::CreateCriticalPath(const TraceBuffer& buffer,
+                                      const std::string& stream_name,
+                                      Timestamp packet_ts,
+                                      PacketLatency* result) {
+  Impl::CreateCriticalPath(buffer, stream_name, packet_ts, result);
+}
 void TraceBuilder::Clear() { impl_->Clear(); }
 
 // Defined here since constexpr requires out-of-class definition until C++17.
@@ -429,6 +519,8 @@ const TraceEvent::EventType         //
     TraceEvent::DSP_TASK,           //
     TraceEvent::TPU_TASK,           //
     TraceEvent::GPU_CALIBRATION,    //
-    TraceEvent::PACKET_QUEUED;
+    TraceEvent::PACKET_QUEUED,      //
+    TraceEvent::PACKET_DELIVERED,   //
+    TraceEvent::PACKET_DROPPED;
 
 }  // namespace mediapipe
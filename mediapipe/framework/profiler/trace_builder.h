@@ -43,6 +43,15 @@ class TraceBuilder {
   void CreateLog(const TraceBuffer& buffer, absl::Time begin_time,
                  absl::Time end_time, GraphTrace* result);
 
+  // Fills in the critical path and delivery_wait_usec of a PacketLatency for
+  // the packet at |packet_ts| on |stream_name|.  Starting from the Process()
+  // call that output the packet, the critical path follows the input packet
+  // that arrived last at each Process() call, back to a graph input packet or
+  // a source calculator.  Node names are left unset.
+  static void CreateCriticalPath(const TraceBuffer& buffer,
+                                 const std::string& stream_name,
+                                 Timestamp packet_ts, PacketLatency* result);
+
   // Resets the TraceBuilder to begin building a new trace.
   void Clear();
 
@@ -0,0 +1,214 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_PROFILER_TRACE_RING_H_
+#define MEDIAPIPE_FRAMEWORK_PROFILER_TRACE_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <unordered_map>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+// A bounded single-producer single-consumer ring for trace events.
+// Only one thread appends using "push_back", and only one thread at a time
+// removes events using "PopAll".  Neither side blocks or waits for the other:
+// when the ring is full the new event is dropped and counted.
+template <typename T>
+class TraceRing {
+ public:
+  // Create a ring to hold up to |capacity| events, rounded up to a power of 2.
+  explicit TraceRing(size_t capacity);
+
+  // Appends one event to the ring.
+  // Returns false if the ring is full and the event is dropped.
+  inline bool push_back(const T& event);
+
+  // Removes all events appended so far, in order, passing each to |fn|.
+  // Returns the number of events removed.
+  template <typename Fn>
+  int64 PopAll(Fn&& fn);
+
+  // Returns the number of events dropped because the ring was full.
+  int64 dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+  std::vector<T> buffer_;
+  size_t mask_;
+
+  // The producer and consumer indices are kept on separate cache lines,
+  // so that they are written without contention.
+  char padding_0_[64];
+  std::atomic<size_t> head_{0};
+  std::atomic<int64> dropped_{0};
+  size_t cached_tail_ = 0;
+  char padding_1_[64];
+  std::atomic<size_t> tail_{0};
+  char padding_2_[64];
+};
+
+// A set of TraceRings, one for each thread that logs events.
+// A thread finds its own ring without locking as long as it keeps logging to
+// the same PerThreadTraceRings, so threads do not contend while logging.
+template <typename T>
+class PerThreadTraceRings {
+ public:
+  // Create rings holding up to |capacity| events for each thread.
+  explicit PerThreadTraceRings(size_t capacity);
+
+  // Appends one event to the ring of the calling thread.
+  // Returns false if that ring is full and the event is dropped.
+  inline bool push_back(const T& event) {
+    return GetThreadRing()->push_back(event);
+  }
+
+  // Removes all events appended so far, passing each to |fn|.  Events from
+  // each thread stay in order, but events from different threads interleave
+  // arbitrarily.  Returns the number of events removed.
+  template <typename Fn>
+  int64 PopAll(Fn&& fn);
+
+  // Returns the number of events dropped because a ring was full.
+  int64 dropped() const;
+
+ private:
+  // Returns the ring of the calling thread, creating it on first use.
+  inline TraceRing<T>* GetThreadRing();
+
+  // Looks up or creates the ring of the calling thread.
+  TraceRing<T>* FindThreadRing();
+
+  // Returns a distinct id for each PerThreadTraceRings.
+  static uint64 NextRingsId() {
+    static std::atomic<uint64> next_rings_id(1);
+    return next_rings_id++;
+  }
+
+  // The ring most recently used by a thread, and the rings it belongs to.
+  // The rings_id_ is never reused, so a stale entry never matches.
+  struct ThreadRingCache {
+    uint64 rings_id = 0;
+    TraceRing<T>* ring = nullptr;
+  };
+
+  const uint64 rings_id_;
+  const size_t capacity_;
+  mutable absl::Mutex mutex_;
+  std::unordered_map<std::thread::id, std::unique_ptr<TraceRing<T>>> rings_
+      ABSL_GUARDED_BY(mutex_);
+  // Serializes the consumers of all rings.
+  absl::Mutex pop_mutex_;
+};
+
+template <typename T>
+TraceRing<T>::TraceRing(size_t capacity) {
+  size_t size = 1;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  buffer_.resize(size);
+  mask_ = size - 1;
+}
+
+template <typename T>
+bool TraceRing<T>::push_back(const T& event) {
+  size_t head = head_.load(std::memory_order_relaxed);
+  if (head - cached_tail_ >= buffer_.size()) {
+    cached_tail_ = tail_.load(std::memory_order_acquire);
+    if (head - cached_tail_ >= buffer_.size()) {
+      dropped_.store(dropped_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+      return false;
+    }
+  }
+  buffer_[head & mask_] = event;
+  head_.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+template <typename T>
+template <typename Fn>
+int64 TraceRing<T>::PopAll(Fn&& fn) {
+  size_t tail = tail_.load(std::memory_order_relaxed);
+  size_t head = head_.load(std::memory_order_acquire);
+  for (size_t i = tail; i != head; ++i) {
+    fn(buffer_[i & mask_]);
+  }
+  tail_.store(head, std::memory_order_release);
+  return head - tail;
+}
+
+template <typename T>
+PerThreadTraceRings<T>::PerThreadTraceRings(size_t capacity)
+    : rings_id_(NextRingsId()), capacity_(capacity) {}
+
+template <typename T>
+TraceRing<T>* PerThreadTraceRings<T>::GetThreadRing() {
+  static thread_local ThreadRingCache cache;
+  if (cache.rings_id != rings_id_) {
+    cache.ring = FindThreadRing();
+    cache.rings_id = rings_id_;
+  }
+  return cache.ring;
+}
+
+template <typename T>
+TraceRing<T>* PerThreadTraceRings<T>::FindThreadRing() {
+  absl::MutexLock lock(&mutex_);
+  std::unique_ptr<TraceRing<T>>& ring = rings_[std::this_thread::get_id()];
+  if (!ring) {
+    ring = absl::make_unique<TraceRing<T>>(capacity_);
+  }
+  return ring.get();
+}
+
+template <typename T>
+template <typename Fn>
+int64 PerThreadTraceRings<T>::PopAll(Fn&& fn) {
+  absl::MutexLock pop_lock(&pop_mutex_);
+  // Rings are never removed, so they can be drained outside of mutex_.
+  std::vector<TraceRing<T>*> rings;
+  {
+    absl::MutexLock lock(&mutex_);
+    for (auto& entry : rings_) {
+      rings.push_back(entry.second.get());
+    }
+  }
+  int64 count = 0;
+  for (TraceRing<T>* ring : rings) {
+    count += ring->PopAll(fn);
+  }
+  return count;
+}
+
+template <typename T>
+int64 PerThreadTraceRings<T>::dropped() const {
+  absl::MutexLock lock(&mutex_);
+  int64 result = 0;
+  for (auto& entry : rings_) {
+    result += entry.second->dropped();
+  }
+  return result;
+}
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_PROFILER_TRACE_RING_H_
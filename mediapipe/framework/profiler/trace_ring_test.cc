@@ -0,0 +1,133 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/trace_ring.h"
+
+#include <vector>
+
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/threadpool.h"
+#include "mediapipe/framework/profiler/circular_buffer.h"
+#include "mediapipe/framework/profiler/trace_buffer.h"
+
+namespace mediapipe {
+namespace {
+
+TEST(TraceRingTest, SequentialWriteAndRead) {
+  TraceRing<int> ring(4);
+  EXPECT_TRUE(ring.push_back(1));
+  EXPECT_TRUE(ring.push_back(2));
+  std::vector<int> popped;
+  EXPECT_EQ(2, ring.PopAll([&](int i) { popped.push_back(i); }));
+  EXPECT_TRUE(ring.push_back(3));
+  EXPECT_EQ(1, ring.PopAll([&](int i) { popped.push_back(i); }));
+  EXPECT_EQ(0, ring.PopAll([&](int i) { popped.push_back(i); }));
+  EXPECT_EQ(popped, std::vector<int>({1, 2, 3}));
+  EXPECT_EQ(0, ring.dropped());
+}
+
+TEST(TraceRingTest, DropsEventsWhenFull) {
+  // The capacity is rounded up to 4.
+  TraceRing<int> ring(3);
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_EQ(i < 4, ring.push_back(i));
+  }
+  EXPECT_EQ(2, ring.dropped());
+  std::vector<int> popped;
+  ring.PopAll([&](int i) { popped.push_back(i); });
+  EXPECT_EQ(popped, std::vector<int>({0, 1, 2, 3}));
+  EXPECT_TRUE(ring.push_back(6));
+}
+
+TEST(TraceRingTest, ParallelWritersKeepTheirOrder) {
+  const int kNumWriters = 6;
+  const int kNumEvents = 10000;
+  // One thread may run several writers, so each ring can hold all events.
+  PerThreadTraceRings<std::pair<int, int>> rings(kNumWriters * kNumEvents);
+  std::vector<std::vector<int>> popped(kNumWriters);
+  auto pop_all = [&]() {
+    rings.PopAll([&](const std::pair<int, int>& event) {
+      popped[event.first].push_back(event.second);
+    });
+  };
+  {
+    ::mediapipe::ThreadPool pool(kNumWriters + 1);
+    pool.StartWorkers();
+    for (int w = 0; w < kNumWriters; ++w) {
+      pool.Schedule([&rings, w]() {
+        for (int i = 0; i < kNumEvents; ++i) {
+          rings.push_back({w, i});
+        }
+      });
+    }
+    // Drain the rings concurrently with the writers.
+    pool.Schedule([&]() {
+      for (int i = 0; i < 100; ++i) {
+        pop_all();
+      }
+    });
+  }
+  pop_all();
+  EXPECT_EQ(0, rings.dropped());
+  for (int w = 0; w < kNumWriters; ++w) {
+    ASSERT_EQ(kNumEvents, popped[w].size());
+    for (int i = 0; i < kNumEvents; ++i) {
+      EXPECT_EQ(i, popped[w][i]);
+    }
+  }
+}
+
+TEST(TraceRingTest, SeparateRingsPerOwner) {
+  PerThreadTraceRings<int> rings_1(4);
+  PerThreadTraceRings<int> rings_2(4);
+  rings_1.push_back(1);
+  rings_2.push_back(2);
+  rings_1.push_back(3);
+  std::vector<int> popped_1, popped_2;
+  rings_1.PopAll([&](int i) { popped_1.push_back(i); });
+  rings_2.PopAll([&](int i) { popped_2.push_back(i); });
+  EXPECT_EQ(popped_1, std::vector<int>({1, 3}));
+  EXPECT_EQ(popped_2, std::vector<int>({2}));
+}
+
+// The number of events logged between reads of the trace buffer.
+constexpr int kEventsPerRead = 4096;
+
+void BM_LogToCircularBuffer(benchmark::State& state) {
+  static TraceBuffer* buffer = new TraceBuffer(20000);
+  TraceEvent event(TraceEvent::PROCESS);
+  for (auto _ : state) {
+    buffer->push_back(event);
+  }
+}
+BENCHMARK(BM_LogToCircularBuffer)->ThreadRange(1, 8);
+
+void BM_LogToPerThreadTraceRings(benchmark::State& state) {
+  static PerThreadTraceRings<TraceEvent>* rings =
+      new PerThreadTraceRings<TraceEvent>(20000);
+  TraceEvent event(TraceEvent::PROCESS);
+  int64 count = 0;
+  for (auto _ : state) {
+    rings->push_back(event);
+    if (++count % kEventsPerRead == 0) {
+      rings->PopAll([](const TraceEvent& e) { benchmark::DoNotOptimize(e); });
+    }
+  }
+}
+BENCHMARK(BM_LogToPerThreadTraceRings)->ThreadRange(1, 8);
+
+}  // namespace
+}  // namespace mediapipe
@@ -446,6 +446,7 @@ void Scheduler::AssignNodeToSchedulerQueue(CalculatorNode* node) {
   } else {
     queue = &default_queue_;
   }
+  queue->RegisterNode(*node);
   node->SetSchedulerQueue(queue);
 }
 
@@ -19,6 +19,7 @@
 #include <utility>
 
 #include "absl/synchronization/mutex.h"
+#include "absl/types/optional.h"
 #include "mediapipe/framework/calculator_node.h"
 #include "mediapipe/framework/executor.h"
 #include "mediapipe/framework/port/canonical_errors.h"
@@ -34,6 +35,20 @@
 namespace mediapipe {
 namespace internal {
 
+namespace {
+
+// Tasks for nodes that were added to "queue" while the current thread was
+// running a task from it and the executor had no idle threads. They are
+// submitted together once that task ends.
+struct PendingTasks {
+  const SchedulerQueue* queue;
+  int count;
+};
+
+thread_local PendingTasks* pending_tasks = nullptr;
+
+}  // namespace
+
 SchedulerQueue::Item::Item(CalculatorNode* node, CalculatorContext* cc)
     : node_(node), cc_(cc) {
   CHECK(node);
@@ -88,23 +103,24 @@ bool SchedulerQueue::Item::operator<(const SchedulerQueue::Item& that) const {
 
 void SchedulerQueue::Reset() {
   absl::MutexLock lock(&mutex_);
-  num_pending_tasks_ = 0;
+  num_active_ = non_source_queue_.size() + queue_.size();
   num_tasks_to_add_ = 0;
   running_count_ = 0;
 }
 
-void SchedulerQueue::SetExecutor(Executor* executor) { executor_ = executor; }
-
-bool SchedulerQueue::IsIdle() {
-  VLOG(3) << "Scheduler queue empty: " << queue_.empty()
-          << ", # of pending tasks: " << num_pending_tasks_;
-  return queue_.empty() && num_pending_tasks_ == 0;
+void SchedulerQueue::RegisterNode(const CalculatorNode& node) {
+  if (node.Id() >= non_source_queue_.num_buckets()) {
+    CHECK(non_source_queue_.empty());
+    non_source_queue_.Resize(node.Id() + 1);
+  }
 }
 
+void SchedulerQueue::SetExecutor(Executor* executor) { executor_ = executor; }
+
 void SchedulerQueue::SetRunning(bool running) {
-  absl::MutexLock lock(&mutex_);
-  running_count_ += running ? 1 : -1;
-  DCHECK_LE(running_count_, 1);
+  const int delta = running ? 1 : -1;
+  int running_count = running_count_.fetch_add(delta) + delta;
+  DCHECK_LE(running_count, 1);
 }
 
 void SchedulerQueue::AddNode(CalculatorNode* node, CalculatorContext* cc) {
@@ -132,18 +148,38 @@ void SchedulerQueue::AddNodeForOpen(CalculatorNode* node) {
 
 void SchedulerQueue::AddItemToQueue(Item&& item) {
   const CalculatorNode* node = item.Node();
-  bool was_idle;
-  int tasks_to_add = 0;
-  {
+  // If the queue is running, count the task for this item together with the
+  // item, so that the task cannot be claimed by another thread that is
+  // submitting waiting tasks. See the comments on SetIdleCallback.
+  const bool running = running_count_.load() > 0;
+  const bool was_idle = AddToNumActive(running ? 2 : 1) == 0;
+  if (item.IsOpenNode() || item.IsSource()) {
     absl::MutexLock lock(&mutex_);
-    was_idle = IsIdle();
-    queue_.push(item);
-    ++num_tasks_to_add_;
-    VLOG(4) << node->DebugName() << " was added to the scheduler queue.";
+    if (item.IsOpenNode()) {
+      ++num_open_items_;
+    }
+    queue_.push(std::move(item));
+  } else {
+    non_source_queue_.Push(node->Id(), std::move(item));
+  }
+  VLOG(4) << node->DebugName() << " was added to the scheduler queue.";
 
-    // Now grab the tasks to execute while still holding the lock. This will
-    // gather any waiting tasks, in addition to the one we just added.
-    if (running_count_ > 0) {
+  int tasks_to_add = 0;
+  if (running) {
+    if (pending_tasks != nullptr && pending_tasks->queue == this &&
+        !executor_->HasIdleThreads()) {
+      // Typically a node made ready by the outputs of the running node. No
+      // thread could start on it now, so RunNextTask submits it together with
+      // any others. Otherwise it is submitted right away.
+      ++pending_tasks->count;
+    } else {
+      tasks_to_add = 1;
+    }
+  } else {
+    ++num_tasks_to_add_;
+    // The queue may have started running after we checked. Submit any
+    // waiting tasks, including this one, if so.
+    if (running_count_.load() > 0) {
       tasks_to_add = GetTasksToSubmitToExecutor();
     }
   }
@@ -155,16 +191,14 @@ void SchedulerQueue::AddItemToQueue(Item&& item) {
   // This ensures that we never get an idle_callback_(true) that is not
   // preceded by the corresponding idle_callback_(false). See the comments on
   // SetIdleCallback for details.
-  while (tasks_to_add > 0) {
-    executor_->AddTask(this);
-    --tasks_to_add;
-  }
+  SubmitTasksToExecutor(tasks_to_add);
 }
 
 int SchedulerQueue::GetTasksToSubmitToExecutor() {
-  int tasks_to_add = num_tasks_to_add_;
-  num_tasks_to_add_ = 0;
-  num_pending_tasks_ += tasks_to_add;
+  int tasks_to_add = num_tasks_to_add_.exchange(0);
+  if (tasks_to_add > 0) {
+    AddToNumActive(tasks_to_add);
+  }
   return tasks_to_add;
 }
 
@@ -173,42 +207,66 @@ void SchedulerQueue::SubmitWaitingTasksToExecutor() {
   // we do not immediately submit tasks to the executor. Here we check for any
   // such waiting tasks, and submit them.
   int tasks_to_add = 0;
-  {
-    absl::MutexLock lock(&mutex_);
-    if (running_count_ > 0) {
-      tasks_to_add = GetTasksToSubmitToExecutor();
-    }
+  if (running_count_.load() > 0) {
+    tasks_to_add = GetTasksToSubmitToExecutor();
   }
-  while (tasks_to_add > 0) {
+  SubmitTasksToExecutor(tasks_to_add);
+}
+
+void SchedulerQueue::SubmitTasksToExecutor(int count) {
+  if (count == 1) {
     executor_->AddTask(this);
-    --tasks_to_add;
+  } else if (count > 1) {
+    executor_->AddTasks(this, count);
   }
 }
 
-void SchedulerQueue::RunNextTask() {
-  CalculatorNode* node;
-  CalculatorContext* calculator_context;
-  bool is_open_node;
-  {
+SchedulerQueue::Item SchedulerQueue::TakeNextItem() {
+  while (true) {
+    // OpenNode() items run before all others, and non-sources run before
+    // sources.
+    if (num_open_items_.load() == 0) {
+      absl::optional<Item> item = non_source_queue_.Pop();
+      if (item) {
+        return *std::move(item);
+      }
+    }
     absl::MutexLock lock(&mutex_);
-
-    CHECK(!queue_.empty()) << "Called RunNextTask when the queue is empty. "
-                              "This should not happen.";
-
-    node = queue_.top().Node();
-    calculator_context = queue_.top().Context();
-    is_open_node = queue_.top().IsOpenNode();
-    queue_.pop();
-
-    CHECK(!node->Closed())
-        << "Scheduled a node that was closed. This should not happen.";
+    if (!queue_.empty()) {
+      Item item = queue_.top();
+      queue_.pop();
+      if (item.IsOpenNode()) {
+        --num_open_items_;
+      }
+      return item;
+    }
+    // Since a task was submitted for an item that we have not taken yet, at
+    // least one item is queued. If non_source_queue_ is not empty either,
+    // its items were taken by other threads during our scan; retry.
+    CHECK(!non_source_queue_.empty())
+        << "Called RunNextTask when the queue is empty. "
+           "This should not happen.";
   }
+}
+
+void SchedulerQueue::RunNextTask() {
+  Item item = TakeNextItem();
+  CalculatorNode* node = item.Node();
+  CalculatorContext* calculator_context = item.Context();
+  bool is_open_node = item.IsOpenNode();
+  // The item is no longer queued.
+  AddToNumActive(-1);
+  CHECK(!node->Closed())
+      << "Scheduled a node that was closed. This should not happen.";
 
   // On iOS, calculators may rely on the existence of an autorelease pool
   // (either directly, or because system code they call does). We do not
   // want to rely on executors setting up an autorelease pool for us (e.g.
   // an executor creating standard pthread will not, by default), so we
   // do it here to ensure all executors are covered.
+  PendingTasks tasks_added_by_node = {this, 0};
+  PendingTasks* outer_pending_tasks = pending_tasks;
+  pending_tasks = &tasks_added_by_node;
   AUTORELEASEPOOL {
     if (is_open_node) {
       DCHECK(!calculator_context);
@@ -217,15 +275,16 @@ void SchedulerQueue::RunNextTask() {
       RunCalculatorNode(node, calculator_context);
     }
   }
+  pending_tasks = outer_pending_tasks;
+  // The tasks are already counted in num_active_, so this queue cannot
+  // become idle before they are submitted.
+  SubmitTasksToExecutor(tasks_added_by_node.count);
 
-  bool is_idle;
-  {
-    absl::MutexLock lock(&mutex_);
-    DCHECK_GT(num_pending_tasks_, 0);
-    --num_pending_tasks_;
-    is_idle = IsIdle();
-  }
-  if (is_idle && idle_callback_) {
+  // The task is complete.
+  const int num_active = AddToNumActive(-1) - 1;
+  DCHECK_GE(num_active, 0);
+  VLOG(3) << "Scheduler queue active items and tasks: " << num_active;
+  if (num_active == 0 && idle_callback_) {
     // Became idle.
     idle_callback_(true);
   }
@@ -298,10 +357,16 @@ void SchedulerQueue::CleanupAfterRun() {
   bool was_idle;
   {
     absl::MutexLock lock(&mutex_);
-    was_idle = IsIdle();
-    CHECK_EQ(num_pending_tasks_, 0);
-    CHECK_EQ(num_tasks_to_add_, queue_.size());
+    const int num_queued = non_source_queue_.size() + queue_.size();
+    was_idle = num_active_.load() == 0;
+    // All tasks must be complete, and none may have been submitted for the
+    // items that remain.
+    CHECK_EQ(num_active_.load(), num_queued);
+    CHECK_EQ(num_tasks_to_add_.load(), num_queued);
     num_tasks_to_add_ = 0;
+    num_active_ = 0;
+    num_open_items_ = 0;
+    non_source_queue_.Clear();
     while (!queue_.empty()) {
       queue_.pop();
     }
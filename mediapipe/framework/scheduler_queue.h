@@ -24,6 +24,7 @@
 #include "absl/base/macros.h"
 #include "absl/synchronization/mutex.h"
 #include "mediapipe/framework/calculator_context.h"
+#include "mediapipe/framework/deps/bucketed_priority_queue.h"
 #include "mediapipe/framework/executor.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/scheduler_shared.h"
@@ -35,6 +36,13 @@ class CalculatorNode;
 namespace internal {
 
 // Manages a priority queue of nodes to be run on the associated executor.
+//
+// Ready non-source nodes, which make up most of the traffic, are kept in a
+// BucketedPriorityQueue indexed by node id, so that adding and running them
+// only locks the bucket of the node involved. OpenNode() tasks and source
+// nodes, whose order depends on more than the node id, are kept in a
+// mutex-guarded std::priority_queue. The bookkeeping that decides when tasks
+// are submitted and when the queue is idle uses atomic counters.
 class SchedulerQueue : public TaskQueue {
  public:
   // Callback to be invoked when the queue's idle state changes.
@@ -55,6 +63,8 @@ class SchedulerQueue : public TaskQueue {
 
     bool IsOpenNode() const { return is_open_node_; }
 
+    bool IsSource() const { return is_source_; }
+
     // This comparison is meant to be used with a std::priority_queue. Since
     // the priority queue returns higher priority items first, this function
     // means "this is lower priority than that", i.e. "this runs after that".
@@ -99,23 +109,30 @@ class SchedulerQueue : public TaskQueue {
   // Resets the data members at the beginning of each graph run.
   void Reset();
 
+  // Prepares the queue to hold ready contexts of "node". Must be called for
+  // every node assigned to this queue, while the queue is idle.
+  void RegisterNode(const CalculatorNode& node);
+
   // Implements the TaskQueue interface.
   void RunNextTask() override;
 
   // NOTE: After calling SetRunning(true), the caller must call
   // SubmitWaitingTasksToExecutor since tasks may have been added while the
   // queue was not running.
-  void SetRunning(bool running) ABSL_LOCKS_EXCLUDED(mutex_);
+  void SetRunning(bool running);
 
   // Gets the number of tasks that need to be submitted to the executor, and
-  // updates num_pending_tasks_. If this method is called and returns a
-  // non-zero value, the executor's AddTask method *must* be called for each
-  // task returned, but it can be called without holding the lock.
-  int GetTasksToSubmitToExecutor() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // counts them as pending. If this method returns a non-zero value, the
+  // returned number of tasks *must* be submitted with SubmitTasksToExecutor.
+  int GetTasksToSubmitToExecutor();
+
+  // Adds "count" tasks to the executor, with a single AddTasks call if
+  // count > 1.
+  void SubmitTasksToExecutor(int count);
 
   // Submits tasks that are waiting (e.g. that were added while the queue was
   // not running) if the queue is running. The caller must not hold any mutex.
-  void SubmitWaitingTasksToExecutor() ABSL_LOCKS_EXCLUDED(mutex_);
+  void SubmitWaitingTasksToExecutor();
 
   // Adds a node and a calculator context to the scheduler queue if the node is
   // not already running. Note that if the node was running, then it will be
@@ -127,7 +144,7 @@ class SchedulerQueue : public TaskQueue {
   // Adds a node to the scheduler queue for an OpenNode() call.
   void AddNodeForOpen(CalculatorNode* node) ABSL_LOCKS_EXCLUDED(mutex_);
 
-  // Adds an Item to queue_.
+  // Adds an Item to non_source_queue_ or queue_.
   void AddItemToQueue(Item&& item);
 
   void CleanupAfterRun() ABSL_LOCKS_EXCLUDED(mutex_);
@@ -142,8 +159,14 @@ class SchedulerQueue : public TaskQueue {
   // CheckIfBecameReady.
   void OpenCalculatorNode(CalculatorNode* node) ABSL_LOCKS_EXCLUDED(mutex_);
 
-  // Checks whether the queue has no queued nodes or pending tasks.
-  bool IsIdle() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Removes and returns the highest priority item. A task must have been
+  // submitted for the item, which guarantees that the queue is not empty.
+  Item TakeNextItem() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Adds "delta" to num_active_ and returns its previous value.
+  int AddToNumActive(int delta) {
+    return num_active_.fetch_add(delta, std::memory_order_acq_rel);
+  }
 
   Executor* executor_ = nullptr;
 
@@ -154,15 +177,24 @@ class SchedulerQueue : public TaskQueue {
   // decrements it. The queue is running if running_count_ > 0. A running
   // queue will submit tasks to the executor.
   // Invariant: running_count_ <= 1.
-  int running_count_ ABSL_GUARDED_BY(mutex_) = 0;
+  std::atomic<int> running_count_{0};
 
-  // Number of tasks added to the Executor and not yet complete.
-  int num_pending_tasks_ ABSL_GUARDED_BY(mutex_);
+  // The number of queued items plus the number of tasks added to the
+  // Executor and not yet complete. The queue is idle iff this is 0.
+  // An item is counted before it is queued, and a task is counted before it
+  // is added to the Executor, so this never drops to 0 while work remains.
+  std::atomic<int> num_active_{0};
 
   // Number of tasks that need to be added to the Executor.
-  int num_tasks_to_add_ ABSL_GUARDED_BY(mutex_);
+  std::atomic<int> num_tasks_to_add_{0};
+
+  // Number of OpenNode() items in queue_. These run before anything else.
+  std::atomic<int> num_open_items_{0};
+
+  // Ready contexts of non-source nodes, prioritized by node id.
+  BucketedPriorityQueue<Item> non_source_queue_;
 
-  // Queue of nodes that need to be run.
+  // OpenNode() items and source nodes that need to be run.
   std::priority_queue<Item> queue_ ABSL_GUARDED_BY(mutex_);
 
   SchedulerShared* const shared_;
@@ -34,6 +34,10 @@ class DefaultInputStreamHandler : public InputStreamHandler {
                             const MediaPipeOptions& options,
                             bool calculator_run_in_parallel);
 
+  // The handler only consumes packets from the head of each queue, so the
+  // queues can be read from the PacketBatchRing of each output stream.
+  bool ReadsPacketBatches() const override { return true; }
+
  protected:
   // Reinitializes this InputStreamHandler before each CalculatorGraph run.
   void PrepareForRun(
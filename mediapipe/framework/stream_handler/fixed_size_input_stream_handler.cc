@@ -182,6 +182,10 @@ class FixedSizeInputStreamHandler : public DefaultInputStreamHandler {
     return result;
   }
 
+  // Surplus packets are erased from the queues in AddPackets() and
+  // MovePackets(), so the streams keep their own queues.
+  bool ReadsPacketBatches() const override { return false; }
+
   void AddPackets(CollectionItemId id,
                   const std::list<Packet>& packets) override {
     InputStreamHandler::AddPackets(id, packets);
@@ -0,0 +1,294 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <deque>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/deps/clock.h"
+#include "mediapipe/framework/mediapipe_profiling.h"
+#include "mediapipe/framework/stream_handler/default_input_stream_handler.h"
+#include "mediapipe/framework/stream_handler/max_age_input_stream_handler.pb.h"
+#include "mediapipe/framework/tool/validate_name.h"
+
+namespace mediapipe {
+
+// Input stream handler that discards the packets that have waited in an input
+// queue for longer than a maximum age, so that a node falling behind its
+// inputs processes recent packets rather than a growing backlog.  The age of a
+// packet is measured from its arrival at the input queue, using the clock of
+// the graph profiler.  When a timestamp is dropped from a stream, it is
+// dropped from all others as well, so that each processed timestamp delivers
+// the same packets as DefaultInputStreamHandler.  Dropping packets never
+// changes the timestamp bounds of the input streams.
+//
+// For example, the following node never processes a video frame that arrived
+// more than 50 ms earlier, while its audio input is never dropped on account
+// of its own age:
+//
+// node {
+//   calculator: "SlowAudioVideoCalculator"
+//   input_stream: "VIDEO:video_frames"
+//   input_stream: "AUDIO:audio_frames"
+//   input_stream_handler {
+//     input_stream_handler: "MaxAgeInputStreamHandler"
+//     options {
+//       [mediapipe.MaxAgeInputStreamHandlerOptions.ext] {
+//         stream_max_age { tag_index: "VIDEO" max_age_usec: 50000 }
+//       }
+//     }
+//   }
+// }
+//
+// The ages are checked whenever the node is notified of a change in its input
+// streams, which includes the completion of each Process call.  Each drop is
+// reported to the graph profiler as a PACKET_DROPPED trace event holding the
+// number of packets dropped from a stream.
+class MaxAgeInputStreamHandler : public DefaultInputStreamHandler {
+ public:
+  MaxAgeInputStreamHandler() = delete;
+  MaxAgeInputStreamHandler(std::shared_ptr<tool::TagMap> tag_map,
+                           CalculatorContextManager* cc_manager,
+                           const MediaPipeOptions& options,
+                           bool calculator_run_in_parallel)
+      : DefaultInputStreamHandler(std::move(tag_map), cc_manager, options,
+                                  calculator_run_in_parallel) {
+    const auto& ext =
+        options.GetExtension(MaxAgeInputStreamHandlerOptions::ext);
+    max_age_usec_.assign(input_stream_managers_.NumEntries(),
+                         ext.max_age_usec());
+    for (const auto& stream_max_age : ext.stream_max_age()) {
+      std::string tag;
+      int index;
+      MEDIAPIPE_CHECK_OK(
+          tool::ParseTagIndex(stream_max_age.tag_index(), &tag, &index));
+      CollectionItemId id = input_stream_managers_.GetId(tag, index);
+      CHECK(id.IsValid()) << "stream \"" << stream_max_age.tag_index()
+                          << "\" is not found.";
+      max_age_usec_[id.value()] = stream_max_age.max_age_usec();
+    }
+    arrivals_.resize(input_stream_managers_.NumEntries());
+    pending_ = false;
+    kept_timestamp_ = Timestamp::Unset();
+  }
+
+ protected:
+  void PrepareForRun(
+      std::function<void()> headers_ready_callback,
+      std::function<void()> notification_callback,
+      std::function<void(CalculatorContext*)> schedule_callback,
+      std::function<void(::mediapipe::Status)> error_callback) override {
+    {
+      absl::MutexLock lock(&erase_mutex_);
+      for (auto& arrivals : arrivals_) {
+        arrivals.clear();
+      }
+      pending_ = false;
+      kept_timestamp_ = Timestamp::Unset();
+      profiler_clock_.reset();
+      clock_ = nullptr;
+    }
+    DefaultInputStreamHandler::PrepareForRun(
+        std::move(headers_ready_callback), std::move(notification_callback),
+        std::move(schedule_callback), std::move(error_callback));
+  }
+
+ private:
+  // Returns the default CalculatorContext, or nullptr before it is created.
+  CalculatorContext* GetDefaultContext() const {
+    return calculator_context_manager_->HasDefaultCalculatorContext()
+               ? calculator_context_manager_->GetDefaultCalculatorContext()
+               : nullptr;
+  }
+
+  // Returns the current time in microseconds, read from the profiler clock
+  // so that tests and replays can control it.
+  int64 NowUsec() ABSL_EXCLUSIVE_LOCKS_REQUIRED(erase_mutex_) {
+    if (!clock_) {
+      CalculatorContext* context = GetDefaultContext();
+      ProfilingContext* profiling_context =
+          context ? context->GetProfilingContext() : nullptr;
+      if (profiling_context) {
+        profiler_clock_ = profiling_context->GetClock();
+      }
+      clock_ = profiler_clock_ ? profiler_clock_.get() : Clock::RealClock();
+    }
+    return absl::ToUnixMicros(clock_->TimeNow());
+  }
+
+  // Records the arrival time of packets about to be added to a stream.
+  void RecordArrivals(CollectionItemId id, const std::list<Packet>& packets)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(erase_mutex_) {
+    if (max_age_usec_[id.value()] <= 0) {
+      return;
+    }
+    const int64 now_usec = NowUsec();
+    auto& arrivals = arrivals_[id.value()];
+    for (const Packet& packet : packets) {
+      arrivals.emplace_back(packet.Timestamp(), now_usec);
+    }
+  }
+
+  // Advances kept_timestamp_ past every packet older than its stream's
+  // maximum age, and discards the packets earlier than kept_timestamp_ from
+  // all streams.
+  void EraseStalePackets() ABSL_EXCLUSIVE_LOCKS_REQUIRED(erase_mutex_) {
+    int64 now_usec = -1;
+    for (CollectionItemId id = input_stream_managers_.BeginId();
+         id < input_stream_managers_.EndId(); ++id) {
+      auto& arrivals = arrivals_[id.value()];
+      if (arrivals.empty()) {
+        continue;
+      }
+      // Forget the packets that have been processed or dropped.  The arrivals
+      // are recorded before the packets are queued, so a packet that is not
+      // yet queued is at or above the stream bound, and is kept.
+      const Timestamp queue_head = std::max(
+          input_stream_managers_.Get(id)->MinTimestampOrBound(nullptr),
+          kept_timestamp_);
+      while (!arrivals.empty() && arrivals.front().first < queue_head) {
+        arrivals.pop_front();
+      }
+      if (arrivals.empty()) {
+        continue;
+      }
+      if (now_usec < 0) {
+        now_usec = NowUsec();
+      }
+      const int64 max_age_usec = max_age_usec_[id.value()];
+      while (!arrivals.empty() &&
+             now_usec - arrivals.front().second > max_age_usec) {
+        kept_timestamp_ = std::max(
+            kept_timestamp_, arrivals.front().first.NextAllowedInStream());
+        arrivals.pop_front();
+      }
+    }
+    if (kept_timestamp_ == Timestamp::Unset()) {
+      return;
+    }
+    for (auto& stream : input_stream_managers_) {
+      bool empty;
+      const Timestamp queue_head = stream->MinTimestampOrBound(&empty);
+      if (empty || queue_head >= kept_timestamp_) {
+        continue;
+      }
+      const int queue_size = stream->QueueSize();
+      stream->ErasePacketsEarlierThan(kept_timestamp_);
+      LogDroppedPackets(stream, queue_head,
+                        queue_size - stream->QueueSize());
+    }
+  }
+
+  // Reports packets dropped from a stream to the graph profiler.
+  void LogDroppedPackets(InputStreamManager* stream, Timestamp queue_head,
+                         int num_dropped)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(erase_mutex_) {
+    CalculatorContext* context = GetDefaultContext();
+    if (!context || num_dropped <= 0) {
+      return;
+    }
+    VLOG(2) << "Dropped " << num_dropped << " packets older than "
+            << kept_timestamp_ << " from stream: " << stream->Name();
+    ::mediapipe::LogEvent(context->GetProfilingContext(),
+                          TraceEvent(TraceEvent::PACKET_DROPPED)
+                              .set_node_id(context->NodeId())
+                              .set_input_ts(kept_timestamp_)
+                              .set_stream_id(&stream->Name())
+                              .set_packet_ts(queue_head)
+                              .set_event_data(num_dropped));
+  }
+
+  NodeReadiness GetNodeReadiness(Timestamp* min_stream_timestamp) override {
+    DCHECK(min_stream_timestamp);
+    absl::MutexLock lock(&erase_mutex_);
+    // As in FixedSizeInputStreamHandler, kReadyForProcess is returned only
+    // once until FillInputSet completes, and no packets are dropped meanwhile,
+    // so that the promised input set is delivered intact.
+    if (pending_) {
+      return NodeReadiness::kNotReady;
+    }
+    EraseStalePackets();
+    NodeReadiness result =
+        DefaultInputStreamHandler::GetNodeReadiness(min_stream_timestamp);
+    pending_ = (result == NodeReadiness::kReadyForProcess);
+    return result;
+  }
+
+  // The arrivals are recorded in AddPackets() and MovePackets(), and stale
+  // packets are erased from the queues, so the streams keep their own queues.
+  bool ReadsPacketBatches() const override { return false; }
+
+  void AddPackets(CollectionItemId id,
+                  const std::list<Packet>& packets) override {
+    {
+      absl::MutexLock lock(&erase_mutex_);
+      RecordArrivals(id, packets);
+    }
+    InputStreamHandler::AddPackets(id, packets);
+    absl::MutexLock lock(&erase_mutex_);
+    if (!pending_) {
+      EraseStalePackets();
+    }
+  }
+
+  void MovePackets(CollectionItemId id, std::list<Packet>* packets) override {
+    {
+      absl::MutexLock lock(&erase_mutex_);
+      RecordArrivals(id, *packets);
+    }
+    InputStreamHandler::MovePackets(id, packets);
+    absl::MutexLock lock(&erase_mutex_);
+    if (!pending_) {
+      EraseStalePackets();
+    }
+  }
+
+  void FillInputSet(Timestamp input_timestamp,
+                    InputStreamShardSet* input_set) override {
+    CHECK(input_set);
+    absl::MutexLock lock(&erase_mutex_);
+    if (!pending_) {
+      LOG(ERROR) << "FillInputSet called without GetNodeReadiness.";
+    }
+    DefaultInputStreamHandler::FillInputSet(input_timestamp, input_set);
+    pending_ = false;
+  }
+
+  // The maximum age of the packets in each stream, or zero for no limit.
+  std::vector<int64> max_age_usec_;
+  // The timestamp and arrival time of the packets queued in each stream, for
+  // the streams with a maximum age.
+  std::vector<std::deque<std::pair<Timestamp, int64>>> arrivals_
+      ABSL_GUARDED_BY(erase_mutex_);
+  // Indicates that GetNodeReadiness has returned kReadyForProcess once, and
+  // the corresponding call to FillInputSet has not yet completed.
+  bool pending_ ABSL_GUARDED_BY(erase_mutex_);
+  // The timestamp used to truncate all input streams.
+  Timestamp kept_timestamp_ ABSL_GUARDED_BY(erase_mutex_);
+  // The clock measuring arrival times.  The profiler clock is held, because
+  // the profiler may replace it.
+  std::shared_ptr<Clock> profiler_clock_ ABSL_GUARDED_BY(erase_mutex_);
+  Clock* clock_ ABSL_GUARDED_BY(erase_mutex_) = nullptr;
+  absl::Mutex erase_mutex_;
+};
+
+REGISTER_INPUT_STREAM_HANDLER(MaxAgeInputStreamHandler);
+
+}  // namespace mediapipe
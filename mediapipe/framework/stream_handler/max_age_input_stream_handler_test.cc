@@ -0,0 +1,241 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/deps/clock.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/profiler/graph_tracer.h"
+
+namespace mediapipe {
+namespace {
+
+// A clock that only advances when told to.
+class ManualClock : public Clock {
+ public:
+  absl::Time TimeNow() override {
+    absl::MutexLock lock(&mutex_);
+    return time_;
+  }
+  void Sleep(absl::Duration d) override { SleepUntil(TimeNow() + d); }
+  void SleepUntil(absl::Time wakeup_time) override {
+    absl::MutexLock lock(&mutex_);
+    time_ = std::max(time_, wakeup_time);
+  }
+
+ private:
+  absl::Mutex mutex_;
+  absl::Time time_ = absl::UnixEpoch();
+};
+
+// Holds TestGatedCalculator in Process until the gate is opened.
+ABSL_CONST_INIT absl::Mutex g_gate_mutex(absl::kConstInit);
+bool g_gate_open ABSL_GUARDED_BY(g_gate_mutex);
+int g_num_blocked ABSL_GUARDED_BY(g_gate_mutex);
+
+void SetGateOpen(bool open) {
+  absl::MutexLock lock(&g_gate_mutex);
+  g_gate_open = open;
+}
+
+// Waits until TestGatedCalculator is blocked in Process.
+void WaitUntilBlocked() {
+  absl::MutexLock lock(&g_gate_mutex);
+  g_gate_mutex.Await(absl::Condition(
+      +[](int* num_blocked) { return *num_blocked > 0; }, &g_num_blocked));
+}
+
+// Passes through the packets of all input streams, waiting for the gate to
+// open before each Process call returns.
+class TestGatedCalculator : public CalculatorBase {
+ public:
+  static ::mediapipe::Status GetContract(CalculatorContract* cc) {
+    for (CollectionItemId id = cc->Inputs().BeginId();
+         id < cc->Inputs().EndId(); ++id) {
+      cc->Inputs().Get(id).SetAny();
+      cc->Outputs().Get(id).SetSameAs(&cc->Inputs().Get(id));
+    }
+    return ::mediapipe::OkStatus();
+  }
+  ::mediapipe::Status Process(CalculatorContext* cc) override {
+    for (CollectionItemId id = cc->Inputs().BeginId();
+         id < cc->Inputs().EndId(); ++id) {
+      if (!cc->Inputs().Get(id).IsEmpty()) {
+        cc->Outputs().Get(id).AddPacket(cc->Inputs().Get(id).Value());
+      }
+    }
+    absl::MutexLock lock(&g_gate_mutex);
+    ++g_num_blocked;
+    g_gate_mutex.Await(absl::Condition(&g_gate_open));
+    --g_num_blocked;
+    return ::mediapipe::OkStatus();
+  }
+};
+REGISTER_CALCULATOR(TestGatedCalculator);
+
+// Returns the values of the timestamps of a vector of Packets.
+std::vector<int64> TimestampValues(const std::vector<Packet>& packets) {
+  std::vector<int64> result;
+  for (const Packet& p : packets) {
+    result.push_back(p.Timestamp().Value());
+  }
+  return result;
+}
+
+class MaxAgeInputStreamHandlerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    absl::MutexLock lock(&g_gate_mutex);
+    g_gate_open = false;
+    g_num_blocked = 0;
+  }
+
+  // Starts a graph running TestGatedCalculator on input streams "a" and "b",
+  // with the given MaxAgeInputStreamHandlerOptions.
+  void StartGraph(const std::string& handler_options) {
+    CalculatorGraphConfig config =
+        ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+          input_stream: "a_in"
+          input_stream: "b_in"
+          profiler_config { trace_enabled: true trace_log_disabled: true }
+          node {
+            calculator: "TestGatedCalculator"
+            input_stream: "A:a_in"
+            input_stream: "B:b_in"
+            output_stream: "A:a_out"
+            output_stream: "B:b_out"
+            input_stream_handler {
+              input_stream_handler: "MaxAgeInputStreamHandler"
+            }
+          }
+        )");
+    config.mutable_node(0)
+        ->mutable_input_stream_handler()
+        ->mutable_options()
+        ->MergeFrom(ParseTextProtoOrDie<MediaPipeOptions>(handler_options));
+    tool::AddVectorSink("a_out", &config, &a_out_);
+    tool::AddVectorSink("b_out", &config, &b_out_);
+    MP_ASSERT_OK(graph_.Initialize(config));
+    clock_ = std::make_shared<ManualClock>();
+    graph_.profiler()->SetClock(clock_);
+    MP_ASSERT_OK(graph_.StartRun({}));
+  }
+
+  void AddPackets(int64 timestamp) {
+    MP_EXPECT_OK(graph_.AddPacketToInputStream(
+        "a_in", MakePacket<int>(0).At(Timestamp(timestamp))));
+    MP_EXPECT_OK(graph_.AddPacketToInputStream(
+        "b_in", MakePacket<int>(0).At(Timestamp(timestamp))));
+  }
+
+  void Finish() {
+    SetGateOpen(true);
+    MP_ASSERT_OK(graph_.CloseAllInputStreams());
+    MP_ASSERT_OK(graph_.WaitUntilDone());
+  }
+
+  // Returns the number of packets dropped from each input stream, as reported
+  // to the graph tracer.
+  std::map<std::string, int64> DroppedPacketCounts() {
+    std::map<std::string, int64> result;
+    for (const TraceEvent& event :
+         graph_.profiler()->tracer()->GetTraceBuffer()) {
+      if (event.event_type == TraceEvent::PACKET_DROPPED) {
+        result[*event.stream_id] += event.event_data;
+      }
+    }
+    return result;
+  }
+
+  CalculatorGraph graph_;
+  std::shared_ptr<ManualClock> clock_;
+  std::vector<Packet> a_out_;
+  std::vector<Packet> b_out_;
+};
+
+// Without a maximum age, all packets are processed.
+TEST_F(MaxAgeInputStreamHandlerTest, KeepsAllPacketsWithoutMaxAge) {
+  StartGraph("");
+  AddPackets(0);
+  WaitUntilBlocked();
+  for (int64 t = 1; t < 5; ++t) {
+    clock_->Sleep(absl::Seconds(1));
+    AddPackets(t);
+  }
+  Finish();
+  EXPECT_THAT(TimestampValues(a_out_), testing::ElementsAre(0, 1, 2, 3, 4));
+  EXPECT_THAT(TimestampValues(b_out_), testing::ElementsAre(0, 1, 2, 3, 4));
+  EXPECT_TRUE(DroppedPacketCounts().empty());
+}
+
+// The packets waiting for longer than the maximum age are dropped when the
+// node becomes ready again.
+TEST_F(MaxAgeInputStreamHandlerTest, DropsStalePackets) {
+  StartGraph(R"([mediapipe.MaxAgeInputStreamHandlerOptions.ext] {
+                  max_age_usec: 25000
+                })");
+  AddPackets(0);
+  WaitUntilBlocked();
+  for (int64 t = 1; t < 5; ++t) {
+    clock_->Sleep(absl::Milliseconds(10));
+    AddPackets(t);
+  }
+  // When the node finishes, the packets at 1 and 2 are 45 and 35 ms old.
+  clock_->Sleep(absl::Milliseconds(15));
+  Finish();
+  EXPECT_THAT(TimestampValues(a_out_), testing::ElementsAre(0, 3, 4));
+  EXPECT_THAT(TimestampValues(b_out_), testing::ElementsAre(0, 3, 4));
+  EXPECT_THAT(DroppedPacketCounts(),
+              testing::ElementsAre(testing::Pair("a_in", 2),
+                                   testing::Pair("b_in", 2)));
+}
+
+// A timestamp dropped from one stream is dropped from all others, so that
+// the processed timestamps still deliver complete input sets.
+TEST_F(MaxAgeInputStreamHandlerTest, DropsTimestampsFromAllStreams) {
+  StartGraph(R"([mediapipe.MaxAgeInputStreamHandlerOptions.ext] {
+                  stream_max_age { tag_index: "A" max_age_usec: 25000 }
+                })");
+  AddPackets(0);
+  WaitUntilBlocked();
+  for (int64 t = 1; t < 4; ++t) {
+    MP_EXPECT_OK(graph_.AddPacketToInputStream(
+        "a_in", MakePacket<int>(0).At(Timestamp(t))));
+  }
+  clock_->Sleep(absl::Milliseconds(30));
+  MP_EXPECT_OK(graph_.AddPacketToInputStream(
+      "a_in", MakePacket<int>(0).At(Timestamp(4))));
+  // The packets on stream "B" arrive late, but are not stale themselves.
+  for (int64 t = 1; t < 5; ++t) {
+    MP_EXPECT_OK(graph_.AddPacketToInputStream(
+        "b_in", MakePacket<int>(0).At(Timestamp(t))));
+  }
+  Finish();
+  EXPECT_THAT(TimestampValues(a_out_), testing::ElementsAre(0, 4));
+  EXPECT_THAT(TimestampValues(b_out_), testing::ElementsAre(0, 4));
+}
+
+}  // namespace
+}  // namespace mediapipe
@@ -14,21 +14,93 @@
 
 #include "mediapipe/framework/thread_pool_executor.h"
 
+#include <set>
 #include <utility>
+#include <vector>
 
 #include "mediapipe/framework/port/canonical_errors.h"
 #include "mediapipe/framework/port/logging.h"
 #include "mediapipe/framework/port/status_builder.h"
+#include "mediapipe/framework/port/status_macros.h"
 #include "mediapipe/framework/thread_pool_executor.pb.h"
 #include "mediapipe/util/cpu_util.h"
 
 namespace mediapipe {
 
-// static
-::mediapipe::StatusOr<Executor*> ThreadPoolExecutor::Create(
-    const MediaPipeOptions& extendable_options) {
-  auto& options =
-      extendable_options.GetExtension(ThreadPoolExecutorOptions::ext);
+namespace {
+
+// Restricts the processors in "thread_options" to the NUMA nodes listed in
+// "options", and binds the workers to them as specified by thread_affinity.
+::mediapipe::Status SetThreadAffinity(const ThreadPoolExecutorOptions& options,
+                                      ThreadOptions* thread_options) {
+  if (options.numa_node_size() > 0 && !IsNumaTopologyAvailable()) {
+    return ::mediapipe::UnimplementedError(
+        "The numa_node field in ThreadPoolExecutorOptions is set, but the NUMA "
+        "topology of this system is not available.");
+  }
+  const std::vector<std::set<int>>& numa_node_cpus = GetNumaNodeCpuIds();
+  // The processors available to the workers, grouped by NUMA node.
+  std::vector<std::set<int>> node_cpus;
+  if (options.numa_node_size() > 0) {
+    for (int node : options.numa_node()) {
+      if (node < 0 || node >= numa_node_cpus.size() ||
+          numa_node_cpus[node].empty()) {
+        return ::mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
+               << "The numa_node field in ThreadPoolExecutorOptions contains "
+               << node << ", which is not a NUMA node with processors.";
+      }
+      node_cpus.push_back(numa_node_cpus[node]);
+    }
+  } else {
+    node_cpus = numa_node_cpus;
+  }
+  const std::set<int>& allowed_cpus = thread_options->cpu_set();
+  std::vector<std::set<int>> selected_node_cpus;
+  std::set<int> selected_cpus;
+  for (const std::set<int>& cpus : node_cpus) {
+    std::set<int> selected;
+    for (int cpu : cpus) {
+      if (allowed_cpus.empty() || allowed_cpus.count(cpu)) {
+        selected.insert(cpu);
+      }
+    }
+    if (!selected.empty()) {
+      selected_cpus.insert(selected.begin(), selected.end());
+      selected_node_cpus.push_back(std::move(selected));
+    }
+  }
+  if (selected_cpus.empty()) {
+    return ::mediapipe::InvalidArgumentError(
+        "No processor matches both require_processor_performance and "
+        "numa_node in ThreadPoolExecutorOptions.");
+  }
+
+  switch (options.thread_affinity()) {
+    case ThreadPoolExecutorOptions::PER_CORE: {
+      std::vector<std::set<int>> core_cpus;
+      for (const std::set<int>& cpus : selected_node_cpus) {
+        for (int cpu : cpus) {
+          core_cpus.push_back({cpu});
+        }
+      }
+      thread_options->set_worker_cpu_sets(core_cpus);
+      break;
+    }
+    case ThreadPoolExecutorOptions::PER_NUMA_NODE:
+      thread_options->set_worker_cpu_sets(selected_node_cpus);
+      break;
+    default:
+      break;
+  }
+  if (options.numa_node_size() > 0) {
+    thread_options->set_cpu_set(selected_cpus);
+  }
+  return ::mediapipe::OkStatus();
+}
+
+// Validates "options" and converts them into ThreadOptions.
+::mediapipe::StatusOr<ThreadOptions> GetThreadOptions(
+    const ThreadPoolExecutorOptions& options) {
   if (!options.has_num_threads()) {
     return ::mediapipe::InvalidArgumentError(
         "num_threads is not specified in ThreadPoolExecutorOptions.");
@@ -70,7 +142,29 @@ namespace mediapipe {
     default:
       break;
   }
+  if (options.thread_affinity() != ThreadPoolExecutorOptions::NO_AFFINITY ||
+      options.numa_node_size() > 0) {
+    MP_RETURN_IF_ERROR(SetThreadAffinity(options, &thread_options));
+  }
+#else
+  if (options.thread_affinity() != ThreadPoolExecutorOptions::NO_AFFINITY ||
+      options.numa_node_size() > 0) {
+    return ::mediapipe::UnimplementedError(
+        "The thread_affinity and numa_node fields in ThreadPoolExecutorOptions "
+        "are only supported on Linux.");
+  }
 #endif
+  return thread_options;
+}
+
+}  // namespace
+
+// static
+::mediapipe::StatusOr<Executor*> ThreadPoolExecutor::Create(
+    const MediaPipeOptions& extendable_options) {
+  auto& options =
+      extendable_options.GetExtension(ThreadPoolExecutorOptions::ext);
+  ASSIGN_OR_RETURN(ThreadOptions thread_options, GetThreadOptions(options));
   return new ThreadPoolExecutor(thread_options, options.num_threads());
 }
 
@@ -97,6 +191,11 @@ void ThreadPoolExecutor::Schedule(std::function<void()> task) {
   thread_pool_.Schedule(std::move(task));
 }
 
+void ThreadPoolExecutor::AddTasks(TaskQueue* task_queue, int count) {
+  thread_pool_.ScheduleBatch(count,
+                             [task_queue] { task_queue->RunNextTask(); });
+}
+
 void ThreadPoolExecutor::Start() {
   stack_size_ = thread_pool_.thread_options().stack_size();
   thread_pool_.StartWorkers();
@@ -106,4 +205,45 @@ void ThreadPoolExecutor::Start() {
 
 REGISTER_EXECUTOR(ThreadPoolExecutor);
 
+// static
+::mediapipe::StatusOr<Executor*> WorkStealingExecutor::Create(
+    const MediaPipeOptions& extendable_options) {
+  auto& options =
+      extendable_options.GetExtension(ThreadPoolExecutorOptions::ext);
+  ASSIGN_OR_RETURN(ThreadOptions thread_options, GetThreadOptions(options));
+  return new WorkStealingExecutor(thread_options, options.num_threads());
+}
+
+WorkStealingExecutor::WorkStealingExecutor(int num_threads)
+    : thread_pool_("mediapipe", num_threads) {
+  thread_pool_.StartWorkers();
+}
+
+WorkStealingExecutor::WorkStealingExecutor(const ThreadOptions& thread_options,
+                                           int num_threads)
+    : thread_pool_(thread_options,
+                   thread_options.name_prefix().empty()
+                       ? "mediapipe"
+                       : thread_options.name_prefix(),
+                   num_threads) {
+  thread_pool_.StartWorkers();
+  VLOG(2) << "Started work-stealing thread pool with "
+          << thread_pool_.num_threads() << " threads.";
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+  VLOG(2) << "Terminating work-stealing thread pool.";
+}
+
+void WorkStealingExecutor::Schedule(std::function<void()> task) {
+  thread_pool_.Schedule(std::move(task));
+}
+
+void WorkStealingExecutor::AddTasks(TaskQueue* task_queue, int count) {
+  thread_pool_.ScheduleBatch(count,
+                             [task_queue] { task_queue->RunNextTask(); });
+}
+
+REGISTER_EXECUTOR(WorkStealingExecutor);
+
 }  // namespace mediapipe
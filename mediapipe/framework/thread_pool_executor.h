@@ -16,6 +16,7 @@
 #define MEDIAPIPE_FRAMEWORK_THREAD_POOL_EXECUTOR_H_
 
 #include "mediapipe/framework/deps/thread_options.h"
+#include "mediapipe/framework/deps/work_stealing_threadpool.h"
 #include "mediapipe/framework/executor.h"
 #include "mediapipe/framework/port/statusor.h"
 #include "mediapipe/framework/port/threadpool.h"
@@ -31,6 +32,10 @@ class ThreadPoolExecutor : public Executor {
   explicit ThreadPoolExecutor(int num_threads);
   ~ThreadPoolExecutor() override;
   void Schedule(std::function<void()> task) override;
+  void AddTasks(TaskQueue* task_queue, int count) override;
+  bool HasIdleThreads() const override {
+    return thread_pool_.num_idle_threads() > 0;
+  }
 
   // For testing.
   int num_threads() const { return thread_pool_.num_threads(); }
@@ -58,6 +63,36 @@ class ThreadPoolExecutor : public Executor {
   size_t stack_size_ = 0;
 };
 
+// A multithreaded executor based on a work-stealing thread pool.
+//
+// Tasks added from one of the executor's own threads, which is how the
+// scheduler queue submits follow-up tasks from a running calculator, are
+// queued on that thread without locking and stolen by idle threads. This
+// avoids contention on a single task queue when many threads are busy.
+// Takes the same ThreadPoolExecutorOptions as ThreadPoolExecutor. Select it
+// with type: "WorkStealingExecutor" in the ExecutorConfig.
+class WorkStealingExecutor : public Executor {
+ public:
+  static ::mediapipe::StatusOr<Executor*> Create(
+      const MediaPipeOptions& extendable_options);
+
+  explicit WorkStealingExecutor(int num_threads);
+  ~WorkStealingExecutor() override;
+  void Schedule(std::function<void()> task) override;
+  void AddTasks(TaskQueue* task_queue, int count) override;
+  bool HasIdleThreads() const override {
+    return thread_pool_.num_idle_threads() > 0;
+  }
+
+  // For testing.
+  int num_threads() const { return thread_pool_.num_threads(); }
+
+ private:
+  WorkStealingExecutor(const ThreadOptions& thread_options, int num_threads);
+
+  ::mediapipe::WorkStealingThreadPool thread_pool_;
+};
+
 }  // namespace mediapipe
 
 #endif  // MEDIAPIPE_FRAMEWORK_THREAD_POOL_EXECUTOR_H_
@@ -94,9 +94,13 @@ const TypeInfo& TypeId() {
 // Note that std::type_info may still generate the same hash code for different
 // types, although the c++ standard recommends that implementations avoid this
 // as much as possible.
+// The hash is cached, since std::type_info::hash_code() may hash the type
+// name on every call and packet type checks run for every packet delivered to
+// every input stream.
 template <typename T>
 size_t GetTypeHash() {
-  return TypeId<T>().hash_code();
+  static const size_t type_hash = TypeId<T>().hash_code();
+  return type_hash;
 }
 
 }  // namespace tool
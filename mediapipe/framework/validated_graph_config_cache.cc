@@ -0,0 +1,195 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/validated_graph_config_cache.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <functional>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_format.h"
+#include "mediapipe/framework/deps/file_path.h"
+#include "mediapipe/framework/port/advanced_proto_lite_inc.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/validated_graph_config_cache.pb.h"
+
+namespace mediapipe {
+
+namespace {
+
+// Serializes |config| with map entries in key order, so that equal configs
+// have equal keys.  SerializeAsString() does not order map entries.
+std::string SerializeDeterministically(const CalculatorGraphConfig& config) {
+  std::string result;
+  {
+    proto_ns::io::StringOutputStream string_stream(&result);
+    proto_ns::io::CodedOutputStream coded_stream(&string_stream);
+    coded_stream.SetSerializationDeterministic(true);
+    config.SerializeToCodedStream(&coded_stream);
+  }
+  return result;
+}
+
+}  // namespace
+
+constexpr int ValidatedGraphConfigCache::kDefaultCapacity;
+
+ValidatedGraphConfigCache::ValidatedGraphConfigCache(int capacity)
+    : capacity_(capacity) {}
+
+ValidatedGraphConfigCache::ValidatedGraphConfigCache(
+    const std::string& directory, int capacity)
+    : directory_(directory), capacity_(capacity) {}
+
+ValidatedGraphConfigCache::~ValidatedGraphConfigCache() {}
+
+::mediapipe::StatusOr<std::shared_ptr<const ValidatedGraphConfig>>
+ValidatedGraphConfigCache::Get(const CalculatorGraphConfig& config,
+                               const GraphRegistry* graph_registry) {
+  std::string source_config = SerializeDeterministically(config);
+  {
+    absl::MutexLock lock(&mutex_);
+    auto validated_graph = LookupMutexHeld(Key(graph_registry, source_config));
+    if (validated_graph) {
+      return validated_graph;
+    }
+  }
+
+  // The config is validated without holding the lock, so that different
+  // configs can be validated concurrently.
+  const bool use_stored_configs =
+      !directory_.empty() && graph_registry == nullptr;
+  std::unique_ptr<ValidatedGraphConfig> validated_graph;
+  if (use_stored_configs) {
+    validated_graph = LoadStoredConfig(source_config);
+  }
+  if (!validated_graph) {
+    validated_graph = absl::make_unique<ValidatedGraphConfig>();
+    MP_RETURN_IF_ERROR(validated_graph->Initialize(config, graph_registry));
+    if (use_stored_configs) {
+      StoreConfig(source_config, *validated_graph);
+    }
+  }
+
+  std::shared_ptr<const ValidatedGraphConfig> result =
+      std::move(validated_graph);
+  if (capacity_ <= 0) {
+    return result;
+  }
+  // The evicted configs are released after the lock.
+  std::vector<Entry> evicted;
+  absl::MutexLock lock(&mutex_);
+  // If another thread has validated the same config meanwhile, its
+  // ValidatedGraphConfig is kept.
+  auto cached = LookupMutexHeld(Key(graph_registry, source_config));
+  if (cached) {
+    return cached;
+  }
+  lru_.push_front({graph_registry, std::move(source_config), result});
+  entries_[Key(graph_registry, lru_.front().source_config)] = lru_.begin();
+  while (static_cast<int>(lru_.size()) > capacity_) {
+    entries_.erase(
+        Key(lru_.back().graph_registry, lru_.back().source_config));
+    evicted.push_back(std::move(lru_.back()));
+    lru_.pop_back();
+  }
+  return result;
+}
+
+std::shared_ptr<const ValidatedGraphConfig>
+ValidatedGraphConfigCache::LookupMutexHeld(const Key& key) {
+  auto entry = entries_.find(key);
+  if (entry == entries_.end()) {
+    return nullptr;
+  }
+  lru_.splice(lru_.begin(), lru_, entry->second);
+  return entry->second->validated_graph;
+}
+
+void ValidatedGraphConfigCache::Clear() {
+  LruList evicted;
+  absl::MutexLock lock(&mutex_);
+  entries_.clear();
+  evicted.swap(lru_);
+}
+
+int ValidatedGraphConfigCache::size() const {
+  absl::MutexLock lock(&mutex_);
+  return lru_.size();
+}
+
+std::string ValidatedGraphConfigCache::StoredConfigPath(
+    const std::string& source_config) const {
+  // The file content identifies the source config, so a hash collision only
+  // causes a cache miss.
+  return file::JoinPath(
+      directory_,
+      absl::StrFormat("%016x.binarypb", std::hash<std::string>()(
+                                            source_config)));
+}
+
+std::unique_ptr<ValidatedGraphConfig>
+ValidatedGraphConfigCache::LoadStoredConfig(
+    const std::string& source_config) const {
+  const std::string path = StoredConfigPath(source_config);
+  std::string contents;
+  if (!file::Exists(path).ok() || !file::GetContents(path, &contents).ok()) {
+    return nullptr;
+  }
+  ExpandedGraphConfig expanded;
+  if (!expanded.ParseFromString(contents) ||
+      expanded.source_config() != source_config) {
+    return nullptr;
+  }
+  // The expanded config contains no subgraphs, so validating it skips
+  // subgraph expansion.
+  auto validated_graph = absl::make_unique<ValidatedGraphConfig>();
+  ::mediapipe::Status status = validated_graph->Initialize(expanded.config());
+  if (!status.ok()) {
+    LOG(WARNING) << "Ignoring invalid stored graph config " << path << ": "
+                 << status;
+    return nullptr;
+  }
+  return validated_graph;
+}
+
+void ValidatedGraphConfigCache::StoreConfig(
+    const std::string& source_config,
+    const ValidatedGraphConfig& validated_graph) const {
+  ExpandedGraphConfig expanded;
+  expanded.set_source_config(source_config);
+  *expanded.mutable_config() = validated_graph.Config();
+  const std::string path = StoredConfigPath(source_config);
+  // The file is written under a temporary name and then renamed, so that
+  // other processes never read a partial file.
+  const std::string temp_path =
+      absl::StrFormat("%s.%d.%p.tmp", path, getpid(), &validated_graph);
+  ::mediapipe::Status status = file::RecursivelyCreateDir(directory_);
+  if (status.ok()) {
+    status = file::SetContents(temp_path, expanded.SerializeAsString());
+  }
+  if (status.ok() && rename(temp_path.c_str(), path.c_str()) != 0) {
+    status = ::mediapipe::UnavailableError("Failed to rename " + temp_path);
+  }
+  if (!status.ok()) {
+    LOG(WARNING) << "Failed to store graph config " << path << ": " << status;
+  }
+}
+
+}  // namespace mediapipe
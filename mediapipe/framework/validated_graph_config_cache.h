@@ -0,0 +1,130 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_VALIDATED_GRAPH_CONFIG_CACHE_H_
+#define MEDIAPIPE_FRAMEWORK_VALIDATED_GRAPH_CONFIG_CACHE_H_
+
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/calculator.pb.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/framework/subgraph.h"
+#include "mediapipe/framework/validated_graph_config.h"
+
+namespace mediapipe {
+
+// Caches the ValidatedGraphConfigs built from CalculatorGraphConfigs, keyed by
+// the content of the configs, so that graphs created repeatedly from the same
+// config skip subgraph expansion and validation.  Up to a fixed number of the
+// most recently used ValidatedGraphConfigs are held in memory.
+//
+// The cache can also store the expanded configs in a directory, so that a
+// new process only validates the expanded config of a graph, without
+// expanding its subgraphs.  The stored configs depend on the subgraphs
+// registered in the binary, so the directory should be specific to a build.
+//
+// Example:
+//   static ValidatedGraphConfigCache* cache = new ValidatedGraphConfigCache;
+//   ASSIGN_OR_RETURN(auto validated_graph, cache->Get(config));
+//   MP_RETURN_IF_ERROR(graph.Initialize(validated_graph, side_packets));
+//
+// This class is thread-safe.
+class ValidatedGraphConfigCache {
+ public:
+  // The default number of ValidatedGraphConfigs held in memory.
+  static constexpr int kDefaultCapacity = 64;
+
+  // Creates a cache held in memory only, retaining up to |capacity|
+  // ValidatedGraphConfigs.  A capacity of zero disables caching in memory.
+  explicit ValidatedGraphConfigCache(int capacity = kDefaultCapacity);
+
+  // Creates a cache that also stores the expanded configs as files in
+  // |directory|, which is created if needed.
+  explicit ValidatedGraphConfigCache(const std::string& directory,
+                                     int capacity = kDefaultCapacity);
+
+  ValidatedGraphConfigCache(const ValidatedGraphConfigCache&) = delete;
+  ValidatedGraphConfigCache& operator=(const ValidatedGraphConfigCache&) =
+      delete;
+  ~ValidatedGraphConfigCache();
+
+  // Returns the ValidatedGraphConfig for |config|, with subgraphs taken from
+  // |graph_registry| or from the global graph registry.  The config is
+  // validated only the first time it is requested.  The stored configs are
+  // used for the global graph registry only.
+  ::mediapipe::StatusOr<std::shared_ptr<const ValidatedGraphConfig>> Get(
+      const CalculatorGraphConfig& config,
+      const GraphRegistry* graph_registry = nullptr);
+
+  // Removes all the ValidatedGraphConfigs held in memory.  The stored
+  // configs are kept.  ValidatedGraphConfigs still used by graphs remain
+  // valid.
+  void Clear();
+
+  // Returns the number of ValidatedGraphConfigs held in memory.
+  int size() const;
+
+ private:
+  // A cached ValidatedGraphConfig with the graph registry and serialized
+  // config identifying it.
+  struct Entry {
+    const GraphRegistry* graph_registry;
+    std::string source_config;
+    std::shared_ptr<const ValidatedGraphConfig> validated_graph;
+  };
+  typedef std::list<Entry> LruList;
+
+  // Identifies a config by graph registry and serialized config.  The
+  // serialized config is held by the Entry in lru_.
+  using Key = std::pair<const GraphRegistry*, absl::string_view>;
+
+  // Returns the cached ValidatedGraphConfig and marks it as most recently
+  // used, or returns null.
+  std::shared_ptr<const ValidatedGraphConfig> LookupMutexHeld(const Key& key)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Returns the path of the file storing the expanded config for
+  // |source_config|.
+  std::string StoredConfigPath(const std::string& source_config) const;
+
+  // Validates the stored expanded config for |source_config|, if any.
+  std::unique_ptr<ValidatedGraphConfig> LoadStoredConfig(
+      const std::string& source_config) const;
+
+  // Stores the expanded config of |validated_graph| for |source_config|.
+  void StoreConfig(const std::string& source_config,
+                   const ValidatedGraphConfig& validated_graph) const;
+
+  // The directory storing the expanded configs, or empty for none.
+  const std::string directory_;
+
+  // The maximum number of ValidatedGraphConfigs held in memory.
+  const int capacity_;
+
+  mutable absl::Mutex mutex_;
+  // Cached configs, most recently used first.
+  LruList lru_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<Key, LruList::iterator> entries_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_VALIDATED_GRAPH_CONFIG_CACHE_H_
@@ -0,0 +1,263 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/validated_graph_config_cache.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/deps/file_path.h"
+#include "mediapipe/framework/deps/message_matchers.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/subgraph.h"
+
+namespace mediapipe {
+namespace {
+
+// A subgraph quadrupling its input, which counts its expansions.
+class CountingQuadSubgraph : public Subgraph {
+ public:
+  ::mediapipe::StatusOr<CalculatorGraphConfig> GetConfig(
+      const SubgraphOptions& options) override {
+    ++num_expansions_;
+    return ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+      input_stream: "INTS:ints"
+      output_stream: "QUADS:quadrupled"
+      node {
+        calculator: "DoubleIntCalculator"
+        input_stream: "ints"
+        output_stream: "doubled"
+      }
+      node {
+        calculator: "DoubleIntCalculator"
+        input_stream: "doubled"
+        output_stream: "quadrupled"
+      }
+    )");
+  }
+
+  static std::atomic<int> num_expansions_;
+};
+std::atomic<int> CountingQuadSubgraph::num_expansions_(0);
+REGISTER_MEDIAPIPE_GRAPH(CountingQuadSubgraph);
+
+// Returns a graph raising its input to the 16th power through subgraphs.
+CalculatorGraphConfig GetConfig() {
+  return ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+    input_stream: "in"
+    node {
+      calculator: "CountingQuadSubgraph"
+      input_stream: "INTS:in"
+      output_stream: "QUADS:quad"
+    }
+    node {
+      calculator: "CountingQuadSubgraph"
+      input_stream: "INTS:quad"
+      output_stream: "QUADS:out"
+    }
+  )");
+}
+
+// Returns a new directory for storing configs.
+std::string GetTestDirectory(const std::string& name) {
+  return file::JoinPath(std::getenv("TEST_TMPDIR"),
+                        absl::StrCat("validated_graph_config_cache_", name));
+}
+
+// Runs a graph initialized from |validated_graph| on |value|.
+int RunGraph(std::shared_ptr<const ValidatedGraphConfig> validated_graph,
+             int value) {
+  CalculatorGraph graph;
+  MEDIAPIPE_CHECK_OK(graph.Initialize(validated_graph, {}));
+  std::vector<Packet> output_packets;
+  MEDIAPIPE_CHECK_OK(graph.ObserveOutputStream("out", [&](const Packet& p) {
+    output_packets.push_back(p);
+    return ::mediapipe::OkStatus();
+  }));
+  MEDIAPIPE_CHECK_OK(graph.StartRun({}));
+  MEDIAPIPE_CHECK_OK(graph.AddPacketToInputStream(
+      "in", MakePacket<int>(value).At(Timestamp(0))));
+  MEDIAPIPE_CHECK_OK(graph.CloseAllInputStreams());
+  MEDIAPIPE_CHECK_OK(graph.WaitUntilDone());
+  CHECK_EQ(1, output_packets.size());
+  return output_packets[0].Get<int>();
+}
+
+TEST(ValidatedGraphConfigCacheTest, ValidatesEachConfigOnce) {
+  ValidatedGraphConfigCache cache;
+  CountingQuadSubgraph::num_expansions_ = 0;
+  auto first = cache.Get(GetConfig());
+  MP_ASSERT_OK(first.status());
+  EXPECT_EQ(2, CountingQuadSubgraph::num_expansions_);
+  auto second = cache.Get(GetConfig());
+  MP_ASSERT_OK(second.status());
+  EXPECT_EQ(2, CountingQuadSubgraph::num_expansions_);
+  EXPECT_EQ(first.ValueOrDie(), second.ValueOrDie());
+  EXPECT_EQ(1, cache.size());
+  EXPECT_EQ(16 * 3, RunGraph(second.ValueOrDie(), 3));
+
+  // A different config is validated separately.
+  CalculatorGraphConfig other_config = GetConfig();
+  other_config.set_max_queue_size(5);
+  auto other = cache.Get(other_config);
+  MP_ASSERT_OK(other.status());
+  EXPECT_NE(first.ValueOrDie(), other.ValueOrDie());
+  EXPECT_EQ(2, cache.size());
+  EXPECT_EQ(4, CountingQuadSubgraph::num_expansions_);
+
+  cache.Clear();
+  EXPECT_EQ(0, cache.size());
+}
+
+TEST(ValidatedGraphConfigCacheTest, KeysByGraphRegistry) {
+  ValidatedGraphConfigCache cache;
+  GraphRegistry graph_registry;
+  graph_registry.Register(
+      "CountingQuadSubgraph",
+      ::mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "INTS:ints"
+        output_stream: "QUADS:doubled"
+        node {
+          calculator: "DoubleIntCalculator"
+          input_stream: "ints"
+          output_stream: "doubled"
+        }
+      )"));
+  auto global = cache.Get(GetConfig());
+  auto local = cache.Get(GetConfig(), &graph_registry);
+  MP_ASSERT_OK(global.status());
+  MP_ASSERT_OK(local.status());
+  EXPECT_EQ(16 * 3, RunGraph(global.ValueOrDie(), 3));
+  EXPECT_EQ(4 * 3, RunGraph(local.ValueOrDie(), 3));
+}
+
+TEST(ValidatedGraphConfigCacheTest, ReturnsValidationErrors) {
+  ValidatedGraphConfigCache cache;
+  CalculatorGraphConfig config = GetConfig();
+  config.mutable_node(1)->set_calculator("UnknownSubgraph");
+  EXPECT_FALSE(cache.Get(config).ok());
+  EXPECT_EQ(0, cache.size());
+}
+
+TEST(ValidatedGraphConfigCacheTest, EvictsLeastRecentlyUsedConfigs) {
+  ValidatedGraphConfigCache cache(2);
+  std::vector<CalculatorGraphConfig> configs(3, GetConfig());
+  for (int i = 0; i < configs.size(); ++i) {
+    configs[i].set_max_queue_size(i + 1);
+  }
+  auto first = cache.Get(configs[0]);
+  MP_ASSERT_OK(first.status());
+  MP_ASSERT_OK(cache.Get(configs[1]).status());
+  // Using the first config makes the second one the least recently used.
+  EXPECT_EQ(first.ValueOrDie(), cache.Get(configs[0]).ValueOrDie());
+  MP_ASSERT_OK(cache.Get(configs[2]).status());
+  EXPECT_EQ(2, cache.size());
+
+  CountingQuadSubgraph::num_expansions_ = 0;
+  EXPECT_EQ(first.ValueOrDie(), cache.Get(configs[0]).ValueOrDie());
+  EXPECT_EQ(0, CountingQuadSubgraph::num_expansions_);
+  MP_ASSERT_OK(cache.Get(configs[1]).status());
+  EXPECT_EQ(2, CountingQuadSubgraph::num_expansions_);
+  EXPECT_EQ(2, cache.size());
+
+  // The evicted configs remain usable.
+  EXPECT_EQ(16 * 3, RunGraph(first.ValueOrDie(), 3));
+}
+
+TEST(ValidatedGraphConfigCacheTest, StoresExpandedConfigs) {
+  const std::string directory = GetTestDirectory("stores");
+  std::shared_ptr<const ValidatedGraphConfig> expanded;
+  {
+    ValidatedGraphConfigCache cache(directory);
+    auto validated_graph = cache.Get(GetConfig());
+    MP_ASSERT_OK(validated_graph.status());
+    expanded = validated_graph.ValueOrDie();
+  }
+
+  // A new cache reads the expanded config instead of expanding subgraphs.
+  CountingQuadSubgraph::num_expansions_ = 0;
+  ValidatedGraphConfigCache cache(directory);
+  auto validated_graph = cache.Get(GetConfig());
+  MP_ASSERT_OK(validated_graph.status());
+  EXPECT_EQ(0, CountingQuadSubgraph::num_expansions_);
+  EXPECT_THAT(validated_graph.ValueOrDie()->Config(),
+              mediapipe::EqualsProto(expanded->Config()));
+  EXPECT_EQ(16 * 3, RunGraph(validated_graph.ValueOrDie(), 3));
+
+  // Other configs are still expanded.
+  CalculatorGraphConfig other_config = GetConfig();
+  other_config.set_max_queue_size(5);
+  MP_ASSERT_OK(cache.Get(other_config).status());
+  EXPECT_EQ(2, CountingQuadSubgraph::num_expansions_);
+}
+
+// Returns a graph made of a chain of |num_subgraphs| subgraphs.
+CalculatorGraphConfig GetChainConfig(int num_subgraphs) {
+  CalculatorGraphConfig config;
+  config.add_input_stream("s0");
+  for (int i = 0; i < num_subgraphs; ++i) {
+    CalculatorGraphConfig::Node* node = config.add_node();
+    node->set_calculator("CountingQuadSubgraph");
+    node->add_input_stream(absl::StrCat("INTS:s", i));
+    node->add_output_stream(absl::StrCat("QUADS:s", i + 1));
+  }
+  return config;
+}
+
+// Measures the validation of a graph made of subgraphs, with and without the
+// cache.
+void BM_ValidateGraph(benchmark::State& state) {
+  CalculatorGraphConfig config = GetChainConfig(state.range(0));
+  for (auto _ : state) {
+    ValidatedGraphConfig validated_graph;
+    MEDIAPIPE_CHECK_OK(validated_graph.Initialize(config));
+  }
+}
+BENCHMARK(BM_ValidateGraph)->Arg(10)->Arg(100);
+
+void BM_ValidateGraphCached(benchmark::State& state) {
+  CalculatorGraphConfig config = GetChainConfig(state.range(0));
+  ValidatedGraphConfigCache cache;
+  for (auto _ : state) {
+    MEDIAPIPE_CHECK_OK(cache.Get(config).status());
+  }
+}
+BENCHMARK(BM_ValidateGraphCached)->Arg(10)->Arg(100);
+
+// Measures the validation of a graph in a new process, from its stored
+// expanded config.
+void BM_ValidateGraphStored(benchmark::State& state) {
+  CalculatorGraphConfig config = GetChainConfig(state.range(0));
+  const std::string directory = GetTestDirectory("benchmark");
+  MEDIAPIPE_CHECK_OK(
+      ValidatedGraphConfigCache(directory).Get(config).status());
+  for (auto _ : state) {
+    ValidatedGraphConfigCache cache(directory);
+    MEDIAPIPE_CHECK_OK(cache.Get(config).status());
+  }
+}
+BENCHMARK(BM_ValidateGraphStored)->Arg(10)->Arg(100);
+
+}  // namespace
+}  // namespace mediapipe
@@ -0,0 +1,126 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Measures the startup cost of the CPU module graphs, whose subgraphs are
+// nested several levels deep, with and without ValidatedGraphConfigCache.
+
+#include <cstdlib>
+#include <string>
+
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/deps/file_path.h"
+#include "mediapipe/framework/deps/message_matchers.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/subgraph.h"
+#include "mediapipe/framework/validated_graph_config_cache.h"
+
+namespace mediapipe {
+namespace {
+
+constexpr const char* kModuleGraphs[] = {
+    "FaceDetectionFrontCpu",       "FaceLandmarkFrontCpu",
+    "IrisLandmarkLeftAndRightCpu", "PoseDetectionCpu",
+    "PoseLandmarkUpperBodyCpu",
+};
+constexpr int kNumModuleGraphs =
+    sizeof(kModuleGraphs) / sizeof(kModuleGraphs[0]);
+
+// Returns the config of a registered module graph, with its subgraphs not
+// yet expanded.
+CalculatorGraphConfig GetModuleConfig(const std::string& graph_type) {
+  auto config_or =
+      GraphRegistry::global_graph_registry.CreateByName("", graph_type);
+  MEDIAPIPE_CHECK_OK(config_or.status());
+  return config_or.ValueOrDie();
+}
+
+// Returns the directory storing the expanded module configs.
+std::string GetStoredConfigDirectory() {
+  return file::JoinPath(std::getenv("TEST_TMPDIR"), "module_graph_configs");
+}
+
+// The cached and stored configs validate to the same canonical configs.
+TEST(ModuleGraphStartupTest, CachedConfigsMatch) {
+  ValidatedGraphConfigCache cache(GetStoredConfigDirectory());
+  for (const char* graph_type : kModuleGraphs) {
+    CalculatorGraphConfig config = GetModuleConfig(graph_type);
+    ValidatedGraphConfig validated_graph;
+    MP_ASSERT_OK(validated_graph.Initialize(config));
+
+    auto cached = cache.Get(config);
+    MP_ASSERT_OK(cached.status());
+    EXPECT_THAT(cached.ValueOrDie()->Config(),
+                mediapipe::EqualsProto(validated_graph.Config()));
+
+    ValidatedGraphConfigCache new_cache(GetStoredConfigDirectory());
+    auto stored = new_cache.Get(config);
+    MP_ASSERT_OK(stored.status());
+    EXPECT_THAT(stored.ValueOrDie()->Config(),
+                mediapipe::EqualsProto(validated_graph.Config()));
+  }
+}
+
+// Initializes a graph from its unexpanded config.
+void BM_InitializeModuleGraph(benchmark::State& state) {
+  const char* graph_type = kModuleGraphs[state.range(0)];
+  CalculatorGraphConfig config = GetModuleConfig(graph_type);
+  for (auto _ : state) {
+    CalculatorGraph graph;
+    MEDIAPIPE_CHECK_OK(graph.Initialize(config));
+  }
+  state.SetLabel(graph_type);
+}
+BENCHMARK(BM_InitializeModuleGraph)->DenseRange(0, kNumModuleGraphs - 1);
+
+// Initializes a graph from a ValidatedGraphConfig held in memory.
+void BM_InitializeModuleGraphCached(benchmark::State& state) {
+  const char* graph_type = kModuleGraphs[state.range(0)];
+  CalculatorGraphConfig config = GetModuleConfig(graph_type);
+  ValidatedGraphConfigCache cache;
+  for (auto _ : state) {
+    auto validated_graph = cache.Get(config);
+    MEDIAPIPE_CHECK_OK(validated_graph.status());
+    CalculatorGraph graph;
+    MEDIAPIPE_CHECK_OK(graph.Initialize(validated_graph.ValueOrDie(), {}));
+  }
+  state.SetLabel(graph_type);
+}
+BENCHMARK(BM_InitializeModuleGraphCached)
+    ->DenseRange(0, kNumModuleGraphs - 1);
+
+// Initializes a graph from its stored expanded config, as on a cold start.
+void BM_InitializeModuleGraphStored(benchmark::State& state) {
+  const char* graph_type = kModuleGraphs[state.range(0)];
+  CalculatorGraphConfig config = GetModuleConfig(graph_type);
+  MEDIAPIPE_CHECK_OK(ValidatedGraphConfigCache(GetStoredConfigDirectory())
+                         .Get(config)
+                         .status());
+  for (auto _ : state) {
+    ValidatedGraphConfigCache cache(GetStoredConfigDirectory());
+    auto validated_graph = cache.Get(config);
+    MEDIAPIPE_CHECK_OK(validated_graph.status());
+    CalculatorGraph graph;
+    MEDIAPIPE_CHECK_OK(graph.Initialize(validated_graph.ValueOrDie(), {}));
+  }
+  state.SetLabel(graph_type);
+}
+BENCHMARK(BM_InitializeModuleGraphStored)
+    ->DenseRange(0, kNumModuleGraphs - 1);
+
+}  // namespace
+}  // namespace mediapipe
@@ -23,11 +23,18 @@
 #else
 #include <unistd.h>
 #endif
+#if defined(__linux__)
+#include <sched.h>
+#endif
 #include <fstream>
+#include <string>
+#include <utility>
 
 #include "absl/algorithm/container.h"
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
 #include "absl/strings/substitute.h"
 #include "mediapipe/framework/port/canonical_errors.h"
 #include "mediapipe/framework/port/integral_types.h"
@@ -37,6 +44,7 @@ namespace mediapipe {
 namespace {
 
 constexpr uint32 kBufferLength = 64;
+constexpr char kNumaNodePath[] = "/sys/devices/system/node";
 
 ::mediapipe::StatusOr<std::string> GetFilePath(int cpu) {
   return absl::Substitute(
@@ -103,6 +111,68 @@ std::set<int> InferLowerOrHigherCoreIds(bool lower) {
     return inferred_cores;
   }
 }
+
+::mediapipe::StatusOr<std::string> ReadFirstLine(const std::string& path) {
+  std::ifstream file(path);
+  std::string line;
+  if (!file.is_open() || !std::getline(file, line)) {
+    return mediapipe::NotFoundError(absl::StrCat("Couldn't read ", path));
+  }
+  return line;
+}
+
+// Parses a Linux CPU or node list, such as "0-3,8,10-11".
+std::set<int> ParseIdList(absl::string_view list) {
+  std::set<int> ids;
+  for (absl::string_view range :
+       absl::StrSplit(list, ',', absl::SkipWhitespace())) {
+    std::pair<absl::string_view, absl::string_view> bounds =
+        absl::StrSplit(range, absl::MaxSplits('-', 1));
+    int first, last;
+    if (!absl::SimpleAtoi(bounds.first, &first)) {
+      continue;
+    }
+    if (bounds.second.empty()) {
+      last = first;
+    } else if (!absl::SimpleAtoi(bounds.second, &last)) {
+      continue;
+    }
+    for (int id = first; id <= last; ++id) {
+      ids.insert(id);
+    }
+  }
+  return ids;
+}
+
+// Returns the CPU ids of each NUMA node, or an empty vector if the NUMA
+// topology is not available.
+std::vector<std::set<int>> ReadNumaNodeCpuIds() {
+  std::vector<std::set<int>> nodes;
+#if defined(__linux__)
+  auto online_or_status = ReadFirstLine(absl::StrCat(kNumaNodePath, "/online"));
+  if (online_or_status.ok()) {
+    for (int node : ParseIdList(online_or_status.ValueOrDie())) {
+      auto cpus_or_status = ReadFirstLine(
+          absl::Substitute("$0/node$1/cpulist", kNumaNodePath, node));
+      if (!cpus_or_status.ok()) {
+        continue;
+      }
+      if (node >= nodes.size()) {
+        nodes.resize(node + 1);
+      }
+      nodes[node] = ParseIdList(cpus_or_status.ValueOrDie());
+    }
+  }
+#endif
+  return nodes;
+}
+
+// Returns the result of ReadNumaNodeCpuIds(), read once.
+const std::vector<std::set<int>>& NumaTopology() {
+  static const auto* nodes =
+      new std::vector<std::set<int>>(ReadNumaNodeCpuIds());
+  return *nodes;
+}
 }  // namespace
 
 int NumCPUCores() {
@@ -125,4 +195,52 @@ std::set<int> InferHigherCoreIds() {
   return InferLowerOrHigherCoreIds(/* lower= */ false);
 }
 
+const std::vector<std::set<int>>& GetNumaNodeCpuIds() {
+  static const auto* nodes = [] {
+    auto* nodes = new std::vector<std::set<int>>(NumaTopology());
+    if (nodes->empty()) {
+      std::set<int> all_cpus;
+      for (int cpu = 0; cpu < NumCPUCores(); ++cpu) {
+        all_cpus.insert(cpu);
+      }
+      nodes->push_back(std::move(all_cpus));
+    }
+    return nodes;
+  }();
+  return *nodes;
+}
+
+bool IsNumaTopologyAvailable() { return !NumaTopology().empty(); }
+
+int GetCurrentNumaNode() {
+#if defined(__linux__)
+  // Maps each CPU id to its NUMA node. Empty if there is only one node.
+  static const auto* cpu_nodes = [] {
+    auto* cpu_nodes = new std::vector<int>();
+    const auto& nodes = GetNumaNodeCpuIds();
+    if (nodes.size() > 1) {
+      for (int node = 0; node < nodes.size(); ++node) {
+        for (int cpu : nodes[node]) {
+          if (cpu >= cpu_nodes->size()) {
+            cpu_nodes->resize(cpu + 1, 0);
+          }
+          (*cpu_nodes)[cpu] = node;
+        }
+      }
+    }
+    return cpu_nodes;
+  }();
+  if (cpu_nodes->empty()) {
+    return 0;
+  }
+  const int cpu = sched_getcpu();
+  if (cpu < 0 || cpu >= cpu_nodes->size()) {
+    return 0;
+  }
+  return (*cpu_nodes)[cpu];
+#else
+  return 0;
+#endif
+}
+
 }  // namespace mediapipe.
@@ -16,6 +16,7 @@
 #define MEDIAPIPE_UTIL_CPU_UTIL_H_
 
 #include <set>
+#include <vector>
 
 namespace mediapipe {
 // Returns the number of CPU cores. Compatible with Android.
@@ -24,6 +25,15 @@ int NumCPUCores();
 std::set<int> InferLowerCoreIds();
 // Returns a set of inferred CPU ids of higher cores.
 std::set<int> InferHigherCoreIds();
+// Returns the CPU ids of each NUMA node, indexed by node id. Returns a single
+// node holding all CPU cores if the NUMA topology is not available.
+const std::vector<std::set<int>>& GetNumaNodeCpuIds();
+// Returns true if GetNumaNodeCpuIds() reports the NUMA topology of the system
+// rather than a single node holding all CPU cores.
+bool IsNumaTopologyAvailable();
+// Returns the NUMA node of the CPU that the calling thread is running on, or 0
+// if it is not available.
+int GetCurrentNumaNode();
 }  // namespace mediapipe
 
 #endif  // MEDIAPIPE_UTIL_CPU_UTIL_H_
@@ -0,0 +1,505 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/non_max_suppression.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define MEDIAPIPE_NON_MAX_SUPPRESSION_SIMD 1
+#elif defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define MEDIAPIPE_NON_MAX_SUPPRESSION_NEON 1
+#define MEDIAPIPE_NON_MAX_SUPPRESSION_SIMD 1
+#endif
+
+namespace mediapipe {
+
+namespace {
+
+using OverlapType = NonMaxSuppressor::OverlapType;
+
+// The maximum number of grid cells along each axis.
+constexpr int kMaxGridSize = 64;
+
+struct QueryBox {
+  float xmin;
+  float ymin;
+  float xmax;
+  float ymax;
+  float area;
+};
+
+// Computes the overlap of an indexed box with the query box, with the same
+// operations as OverlapSimilarity() on Rectangle_f in the
+// NonMaxSuppressionCalculator, where the query box is the second rectangle.
+inline float OverlapSimilarity(OverlapType overlap_type, float xmin,
+                               float ymin, float xmax, float ymax, float area,
+                               const QueryBox& query) {
+  const float intersection_xmin = std::max(xmin, query.xmin);
+  const float intersection_ymin = std::max(ymin, query.ymin);
+  const float intersection_xmax = std::min(xmax, query.xmax);
+  const float intersection_ymax = std::min(ymax, query.ymax);
+  // This is false if either box is empty.
+  if (!(intersection_xmin <= intersection_xmax &&
+        intersection_ymin <= intersection_ymax)) {
+    return 0.0f;
+  }
+  const float intersection_area = (intersection_xmax - intersection_xmin) *
+                                  (intersection_ymax - intersection_ymin);
+  float normalization;
+  switch (overlap_type) {
+    case OverlapType::kJaccard:
+      normalization =
+          (std::max(xmax, query.xmax) - std::min(xmin, query.xmin)) *
+          (std::max(ymax, query.ymax) - std::min(ymin, query.ymin));
+      break;
+    case OverlapType::kModifiedJaccard:
+      normalization = query.area;
+      break;
+    case OverlapType::kIntersectionOverUnion:
+    default:
+      normalization = area + query.area - intersection_area;
+      break;
+  }
+  return normalization > 0.0f ? intersection_area / normalization : 0.0f;
+}
+
+#if defined(MEDIAPIPE_NON_MAX_SUPPRESSION_SIMD)
+// Returns a mask whose bit k is set iff the overlap of indexed box k of the
+// four boxes at the given pointers with the query box exceeds threshold.
+// Computes the same values as OverlapSimilarity().
+inline int OverlapMask4(OverlapType overlap_type, const float* xmin,
+                        const float* ymin, const float* xmax,
+                        const float* ymax, const float* area,
+                        const QueryBox& query, float threshold) {
+#if defined(MEDIAPIPE_NON_MAX_SUPPRESSION_NEON)
+  const float32x4_t x0 = vld1q_f32(xmin);
+  const float32x4_t y0 = vld1q_f32(ymin);
+  const float32x4_t x1 = vld1q_f32(xmax);
+  const float32x4_t y1 = vld1q_f32(ymax);
+  const float32x4_t query_x0 = vdupq_n_f32(query.xmin);
+  const float32x4_t query_y0 = vdupq_n_f32(query.ymin);
+  const float32x4_t query_x1 = vdupq_n_f32(query.xmax);
+  const float32x4_t query_y1 = vdupq_n_f32(query.ymax);
+  const float32x4_t intersection_x0 = vmaxq_f32(x0, query_x0);
+  const float32x4_t intersection_y0 = vmaxq_f32(y0, query_y0);
+  const float32x4_t intersection_x1 = vminq_f32(x1, query_x1);
+  const float32x4_t intersection_y1 = vminq_f32(y1, query_y1);
+  const uint32x4_t intersects =
+      vandq_u32(vcleq_f32(intersection_x0, intersection_x1),
+                vcleq_f32(intersection_y0, intersection_y1));
+  const float32x4_t intersection_area =
+      vmulq_f32(vsubq_f32(intersection_x1, intersection_x0),
+                vsubq_f32(intersection_y1, intersection_y0));
+  float32x4_t normalization;
+  switch (overlap_type) {
+    case OverlapType::kJaccard:
+      normalization = vmulq_f32(
+          vsubq_f32(vmaxq_f32(x1, query_x1), vminq_f32(x0, query_x0)),
+          vsubq_f32(vmaxq_f32(y1, query_y1), vminq_f32(y0, query_y0)));
+      break;
+    case OverlapType::kModifiedJaccard:
+      normalization = vdupq_n_f32(query.area);
+      break;
+    case OverlapType::kIntersectionOverUnion:
+    default:
+      normalization =
+          vsubq_f32(vaddq_f32(vld1q_f32(area), vdupq_n_f32(query.area)),
+                    intersection_area);
+      break;
+  }
+  const uint32x4_t valid =
+      vandq_u32(intersects, vcgtq_f32(normalization, vdupq_n_f32(0.0f)));
+  const float32x4_t similarity = vreinterpretq_f32_u32(
+      vandq_u32(valid, vreinterpretq_u32_f32(
+                           vdivq_f32(intersection_area, normalization))));
+  const uint32x4_t above = vcgtq_f32(similarity, vdupq_n_f32(threshold));
+  const uint32_t kLaneBits[4] = {1, 2, 4, 8};
+  return static_cast<int>(vaddvq_u32(vandq_u32(above, vld1q_u32(kLaneBits))));
+#else
+  const __m128 x0 = _mm_loadu_ps(xmin);
+  const __m128 y0 = _mm_loadu_ps(ymin);
+  const __m128 x1 = _mm_loadu_ps(xmax);
+  const __m128 y1 = _mm_loadu_ps(ymax);
+  const __m128 query_x0 = _mm_set1_ps(query.xmin);
+  const __m128 query_y0 = _mm_set1_ps(query.ymin);
+  const __m128 query_x1 = _mm_set1_ps(query.xmax);
+  const __m128 query_y1 = _mm_set1_ps(query.ymax);
+  const __m128 intersection_x0 = _mm_max_ps(x0, query_x0);
+  const __m128 intersection_y0 = _mm_max_ps(y0, query_y0);
+  const __m128 intersection_x1 = _mm_min_ps(x1, query_x1);
+  const __m128 intersection_y1 = _mm_min_ps(y1, query_y1);
+  const __m128 intersects =
+      _mm_and_ps(_mm_cmple_ps(intersection_x0, intersection_x1),
+                 _mm_cmple_ps(intersection_y0, intersection_y1));
+  const __m128 intersection_area =
+      _mm_mul_ps(_mm_sub_ps(intersection_x1, intersection_x0),
+                 _mm_sub_ps(intersection_y1, intersection_y0));
+  __m128 normalization;
+  switch (overlap_type) {
+    case OverlapType::kJaccard:
+      normalization = _mm_mul_ps(
+          _mm_sub_ps(_mm_max_ps(x1, query_x1), _mm_min_ps(x0, query_x0)),
+          _mm_sub_ps(_mm_max_ps(y1, query_y1), _mm_min_ps(y0, query_y0)));
+      break;
+    case OverlapType::kModifiedJaccard:
+      normalization = _mm_set1_ps(query.area);
+      break;
+    case OverlapType::kIntersectionOverUnion:
+    default:
+      normalization =
+          _mm_sub_ps(_mm_add_ps(_mm_loadu_ps(area), _mm_set1_ps(query.area)),
+                     intersection_area);
+      break;
+  }
+  const __m128 valid =
+      _mm_and_ps(intersects, _mm_cmpgt_ps(normalization, _mm_setzero_ps()));
+  const __m128 similarity =
+      _mm_and_ps(valid, _mm_div_ps(intersection_area, normalization));
+  return _mm_movemask_ps(_mm_cmpgt_ps(similarity, _mm_set1_ps(threshold)));
+#endif
+}
+#endif  // MEDIAPIPE_NON_MAX_SUPPRESSION_SIMD
+
+// Calls visit(k) for each box k of the cell that overlaps the query box by
+// more than threshold, in order, until visit returns true. Returns true iff
+// visit returned true.
+template <typename CellType, typename Visitor>
+bool VisitOverlapping(const CellType& cell, OverlapType overlap_type,
+                      const QueryBox& query, float threshold,
+                      const Visitor& visit) {
+  const int size = static_cast<int>(cell.rank.size());
+  int k = 0;
+#if defined(MEDIAPIPE_NON_MAX_SUPPRESSION_SIMD)
+  for (; k + 4 <= size; k += 4) {
+    const int mask =
+        OverlapMask4(overlap_type, &cell.xmin[k], &cell.ymin[k],
+                     &cell.xmax[k], &cell.ymax[k], &cell.area[k], query,
+                     threshold);
+    if (mask == 0) continue;
+    for (int lane = 0; lane < 4; ++lane) {
+      if ((mask & (1 << lane)) && visit(k + lane)) return true;
+    }
+  }
+#endif  // MEDIAPIPE_NON_MAX_SUPPRESSION_SIMD
+  for (; k < size; ++k) {
+    if (OverlapSimilarity(overlap_type, cell.xmin[k], cell.ymin[k],
+                          cell.xmax[k], cell.ymax[k], cell.area[k],
+                          query) > threshold &&
+        visit(k)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns the cell along an axis of size cells that contains a point, given
+// the offset of the point from the grid origin in cell units.
+inline int GridCoordinate(float scaled_offset, int size) {
+  return static_cast<int>(
+      std::min(std::max(scaled_offset, 0.0f), static_cast<float>(size - 1)));
+}
+
+bool SortBySecond(const std::pair<int, float>& indexed_score_0,
+                  const std::pair<int, float>& indexed_score_1) {
+  return (indexed_score_0.second > indexed_score_1.second);
+}
+
+}  // namespace
+
+void NonMaxSuppressor::Cell::Clear() {
+  xmin.clear();
+  ymin.clear();
+  xmax.clear();
+  ymax.clear();
+  area.clear();
+  rank.clear();
+}
+
+void NonMaxSuppressor::Cell::Add(const NonMaxSuppressor& nms, int index,
+                                 int rank) {
+  xmin.push_back(nms.xmin_[index]);
+  ymin.push_back(nms.ymin_[index]);
+  xmax.push_back(nms.xmax_[index]);
+  ymax.push_back(nms.ymax_[index]);
+  area.push_back(nms.area_[index]);
+  this->rank.push_back(rank);
+}
+
+void NonMaxSuppressor::Clear() {
+  xmin_.clear();
+  ymin_.clear();
+  xmax_.clear();
+  ymax_.clear();
+  area_.clear();
+  scores_.clear();
+  class_ids_.clear();
+}
+
+void NonMaxSuppressor::Reserve(int num_boxes) {
+  xmin_.reserve(num_boxes);
+  ymin_.reserve(num_boxes);
+  xmax_.reserve(num_boxes);
+  ymax_.reserve(num_boxes);
+  area_.reserve(num_boxes);
+  scores_.reserve(num_boxes);
+  class_ids_.reserve(num_boxes);
+}
+
+int NonMaxSuppressor::AddBox(float xmin, float ymin, float xmax, float ymax,
+                             float score, int class_id) {
+  xmin_.push_back(xmin);
+  ymin_.push_back(ymin);
+  xmax_.push_back(xmax);
+  ymax_.push_back(ymax);
+  area_.push_back((xmax - xmin) * (ymax - ymin));
+  scores_.push_back(score);
+  class_ids_.push_back(class_id);
+  return num_boxes() - 1;
+}
+
+void NonMaxSuppressor::SortByScore() {
+  order_.clear();
+  order_.reserve(num_boxes());
+  for (int i = 0; i < num_boxes(); ++i) {
+    order_.emplace_back(i, scores_[i]);
+  }
+  // This is the same sort as in the NonMaxSuppressionCalculator, so that
+  // boxes of equal scores are visited in the same order.
+  std::sort(order_.begin(), order_.end(), SortBySecond);
+}
+
+void NonMaxSuppressor::ResetGrid(const Options& options) {
+  // Boxes only overlap by more than a negative threshold if they do not
+  // intersect, in which case each box is compared with all others.
+  index_all_boxes_ = options.min_suppression_threshold < 0.0f;
+
+  int num_layers = 1;
+  if (options.per_class) {
+    class_id_scratch_ = class_ids_;
+    std::sort(class_id_scratch_.begin(), class_id_scratch_.end());
+    class_id_scratch_.erase(
+        std::unique(class_id_scratch_.begin(), class_id_scratch_.end()),
+        class_id_scratch_.end());
+    num_layers = std::max(1, static_cast<int>(class_id_scratch_.size()));
+    layers_.resize(num_boxes());
+    for (int i = 0; i < num_boxes(); ++i) {
+      layers_[i] = std::lower_bound(class_id_scratch_.begin(),
+                                    class_id_scratch_.end(), class_ids_[i]) -
+                   class_id_scratch_.begin();
+    }
+  }
+
+  // Sizes the cells to twice the mean box size, so that most boxes span at
+  // most two cells along each axis, within the limits of the grid.
+  float x0 = 0.0f;
+  float y0 = 0.0f;
+  float x1 = 0.0f;
+  float y1 = 0.0f;
+  double sum_width = 0.0;
+  double sum_height = 0.0;
+  int count = 0;
+  for (int i = 0; i < num_boxes(); ++i) {
+    if (!(xmin_[i] <= xmax_[i] && ymin_[i] <= ymax_[i])) continue;
+    if (count == 0) {
+      x0 = xmin_[i];
+      y0 = ymin_[i];
+      x1 = xmax_[i];
+      y1 = ymax_[i];
+    } else {
+      x0 = std::min(x0, xmin_[i]);
+      y0 = std::min(y0, ymin_[i]);
+      x1 = std::max(x1, xmax_[i]);
+      y1 = std::max(y1, ymax_[i]);
+    }
+    sum_width += xmax_[i] - xmin_[i];
+    sum_height += ymax_[i] - ymin_[i];
+    ++count;
+  }
+  const float extent_width = x1 - x0;
+  const float extent_height = y1 - y0;
+  grid_width_ = 1;
+  grid_height_ = 1;
+  if (!index_all_boxes_ && count > 1 && std::isfinite(extent_width) &&
+      std::isfinite(extent_height)) {
+    const auto grid_size = [count](float extent, double sum) {
+      const double cells = extent * count / std::max(2.0 * sum, 1e-12);
+      return static_cast<int>(std::min<double>(std::max(cells, 1.0),
+                                               kMaxGridSize));
+    };
+    grid_width_ = grid_size(extent_width, sum_width);
+    grid_height_ = grid_size(extent_height, sum_height);
+    // Keeps about one cell per box.
+    const int max_cells_per_layer = std::max(1, count / num_layers);
+    while (grid_width_ * grid_height_ > max_cells_per_layer) {
+      if (grid_width_ >= grid_height_) {
+        grid_width_ = (grid_width_ + 1) / 2;
+      } else {
+        grid_height_ = (grid_height_ + 1) / 2;
+      }
+    }
+  }
+  grid_x_ = x0;
+  grid_y_ = y0;
+  grid_x_scale_ = extent_width > 0.0f ? grid_width_ / extent_width : 0.0f;
+  grid_y_scale_ = extent_height > 0.0f ? grid_height_ / extent_height : 0.0f;
+
+  num_cells_ = grid_width_ * grid_height_ * num_layers;
+  if (static_cast<int>(cells_.size()) < num_cells_) {
+    cells_.resize(num_cells_);
+  }
+  for (int i = 0; i < num_cells_; ++i) {
+    cells_[i].Clear();
+  }
+}
+
+bool NonMaxSuppressor::GetCellRange(int index, int* x0, int* y0, int* x1,
+                                    int* y1) const {
+  if (!index_all_boxes_ &&
+      !(xmin_[index] <= xmax_[index] && ymin_[index] <= ymax_[index])) {
+    return false;
+  }
+  if (grid_width_ == 1 && grid_height_ == 1) {
+    *x0 = *y0 = *x1 = *y1 = 0;
+    return true;
+  }
+  // The grid coordinates are monotonic, so intersecting boxes share a cell.
+  *x0 = GridCoordinate((xmin_[index] - grid_x_) * grid_x_scale_, grid_width_);
+  *y0 = GridCoordinate((ymin_[index] - grid_y_) * grid_y_scale_, grid_height_);
+  *x1 = GridCoordinate((xmax_[index] - grid_x_) * grid_x_scale_, grid_width_);
+  *y1 = GridCoordinate((ymax_[index] - grid_y_) * grid_y_scale_, grid_height_);
+  return true;
+}
+
+void NonMaxSuppressor::InsertIntoGrid(int index, int rank) {
+  int x0, y0, x1, y1;
+  if (!GetCellRange(index, &x0, &y0, &x1, &y1)) return;
+  const int layer_offset =
+      layers_.empty() ? 0 : layers_[index] * grid_width_ * grid_height_;
+  for (int y = y0; y <= y1; ++y) {
+    for (int x = x0; x <= x1; ++x) {
+      cells_[layer_offset + y * grid_width_ + x].Add(*this, index, rank);
+    }
+  }
+}
+
+bool NonMaxSuppressor::IsSuppressed(int index, const Options& options) const {
+  int x0, y0, x1, y1;
+  if (!GetCellRange(index, &x0, &y0, &x1, &y1)) return false;
+  const QueryBox query = {xmin_[index], ymin_[index], xmax_[index],
+                          ymax_[index], area_[index]};
+  const int layer_offset =
+      layers_.empty() ? 0 : layers_[index] * grid_width_ * grid_height_;
+  for (int y = y0; y <= y1; ++y) {
+    for (int x = x0; x <= x1; ++x) {
+      if (VisitOverlapping(cells_[layer_offset + y * grid_width_ + x],
+                           options.overlap_type, query,
+                           options.min_suppression_threshold,
+                           [](int) { return true; })) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void NonMaxSuppressor::FindOverlapping(int index, const Options& options,
+                                       std::vector<int>* ranks) {
+  int x0, y0, x1, y1;
+  if (!GetCellRange(index, &x0, &y0, &x1, &y1)) return;
+  const QueryBox query = {xmin_[index], ymin_[index], xmax_[index],
+                          ymax_[index], area_[index]};
+  const int layer_offset =
+      layers_.empty() ? 0 : layers_[index] * grid_width_ * grid_height_;
+  ++query_;
+  for (int y = y0; y <= y1; ++y) {
+    for (int x = x0; x <= x1; ++x) {
+      const Cell& cell = cells_[layer_offset + y * grid_width_ + x];
+      VisitOverlapping(cell, options.overlap_type, query,
+                       options.min_suppression_threshold, [&](int k) {
+                         const int rank = cell.rank[k];
+                         if (!clustered_[rank] && visited_[rank] != query_) {
+                           visited_[rank] = query_;
+                           ranks->push_back(rank);
+                         }
+                         return false;
+                       });
+    }
+  }
+}
+
+void NonMaxSuppressor::Suppress(const Options& options,
+                                std::vector<int>* retained) {
+  retained->clear();
+  if (!options.per_class) layers_.clear();
+  SortByScore();
+  ResetGrid(options);
+  for (int rank = 0; rank < order_.size(); ++rank) {
+    if (options.min_score_threshold > 0 &&
+        order_[rank].second < options.min_score_threshold) {
+      break;
+    }
+    const int index = order_[rank].first;
+    if (!IsSuppressed(index, options)) {
+      retained->push_back(index);
+      InsertIntoGrid(index, rank);
+    }
+    if (options.max_num_boxes > -1 &&
+        retained->size() >= options.max_num_boxes) {
+      break;
+    }
+  }
+}
+
+void NonMaxSuppressor::Cluster(const Options& options, Clusters* clusters) {
+  clusters->leaders.clear();
+  clusters->offsets.assign(1, 0);
+  clusters->members.clear();
+  if (!options.per_class) layers_.clear();
+  SortByScore();
+  ResetGrid(options);
+  const int num_ranks = static_cast<int>(order_.size());
+  for (int rank = 0; rank < num_ranks; ++rank) {
+    InsertIntoGrid(order_[rank].first, rank);
+  }
+  clustered_.assign(num_ranks, false);
+  visited_.assign(num_ranks, 0);
+  query_ = 0;
+
+  std::vector<int>& members = clusters->members;
+  for (int rank = 0; rank < num_ranks; ++rank) {
+    if (clustered_[rank]) continue;
+    if (options.min_score_threshold > 0 &&
+        order_[rank].second < options.min_score_threshold) {
+      break;
+    }
+    const int leader = order_[rank].first;
+    const int begin = static_cast<int>(members.size());
+    FindOverlapping(leader, options, &members);
+    std::sort(members.begin() + begin, members.end());
+    for (int i = begin; i < members.size(); ++i) {
+      clustered_[members[i]] = true;
+      members[i] = order_[members[i]].first;
+    }
+    clusters->leaders.push_back(leader);
+    clusters->offsets.push_back(static_cast<int>(members.size()));
+    // The remaining boxes do not change if the leader does not overlap itself.
+    if (members.size() == begin) break;
+  }
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,181 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_UTIL_NON_MAX_SUPPRESSION_H_
+#define MEDIAPIPE_UTIL_NON_MAX_SUPPRESSION_H_
+
+#include <utility>
+#include <vector>
+
+namespace mediapipe {
+
+// Performs non-maximum suppression on a set of scored, axis-aligned boxes.
+//
+// The boxes are stored as one array per coordinate. Overlap candidates are
+// found through a uniform grid over the boxes, so that each box is only
+// compared with the boxes sharing a grid cell with it, and the overlaps are
+// computed four boxes at a time with SSE2 or NEON when available. The results
+// are identical to comparing every pair of boxes with Rectangle_f.
+//
+// The buffers are kept between runs, so a NonMaxSuppressor is meant to be
+// reused, e.g. as a calculator member. It is not thread-safe.
+//
+// Example:
+//   NonMaxSuppressor nms;
+//   for (const auto& box : boxes) {
+//     nms.AddBox(box.xmin, box.ymin, box.xmax, box.ymax, box.score);
+//   }
+//   std::vector<int> retained;
+//   nms.Suppress(options, &retained);
+class NonMaxSuppressor {
+ public:
+  // How the overlap between a box and a higher scoring box is measured. These
+  // match NonMaxSuppressionCalculatorOptions::OverlapType.
+  enum class OverlapType {
+    // Intersection over the area of the bounding box of both boxes.
+    kJaccard,
+    // Intersection over the area of the box checked for suppression by
+    // Suppress(), or of the cluster leader by Cluster().
+    kModifiedJaccard,
+    // Intersection over the area of the union of both boxes.
+    kIntersectionOverUnion,
+  };
+
+  struct Options {
+    OverlapType overlap_type = OverlapType::kJaccard;
+    // A box suppresses the lower scoring boxes whose overlap with it is
+    // greater than this.
+    float min_suppression_threshold = 1.0f;
+    // If positive, the boxes scoring less than this are dropped.
+    float min_score_threshold = -1.0f;
+    // Maximum number of boxes retained by Suppress(), or -1 for no limit.
+    int max_num_boxes = -1;
+    // If true, boxes only suppress the boxes of the same class. This batches
+    // the suppression of several classes into one pass.
+    bool per_class = false;
+  };
+
+  // The result of weighted non-maximum suppression. Cluster k is led by box
+  // leaders[k], and holds the boxes members[offsets[k]] to
+  // members[offsets[k + 1] - 1], in decreasing score order. A cluster holds
+  // its leader unless the leader does not overlap itself, in which case the
+  // cluster is empty and it is the last one.
+  struct Clusters {
+    std::vector<int> leaders;
+    std::vector<int> offsets;
+    std::vector<int> members;
+  };
+
+  NonMaxSuppressor() = default;
+  NonMaxSuppressor(const NonMaxSuppressor&) = delete;
+  NonMaxSuppressor& operator=(const NonMaxSuppressor&) = delete;
+
+  // Removes all boxes.
+  void Clear();
+
+  // Reserves space for num_boxes boxes.
+  void Reserve(int num_boxes);
+
+  // Adds the box spanning [xmin, xmax] x [ymin, ymax], and returns its index.
+  // A box with xmax < xmin or ymax < ymin is empty and overlaps nothing.
+  int AddBox(float xmin, float ymin, float xmax, float ymax, float score,
+             int class_id = 0);
+
+  int num_boxes() const { return static_cast<int>(scores_.size()); }
+  float xmin(int index) const { return xmin_[index]; }
+  float ymin(int index) const { return ymin_[index]; }
+  float xmax(int index) const { return xmax_[index]; }
+  float ymax(int index) const { return ymax_[index]; }
+  float score(int index) const { return scores_[index]; }
+
+  // Visits the boxes by decreasing score, and retains each box that no
+  // previously retained box overlaps by more than the suppression threshold.
+  // Writes the indices of the retained boxes to retained, by decreasing score.
+  void Suppress(const Options& options, std::vector<int>* retained);
+
+  // Repeatedly takes the highest scoring remaining box as a cluster leader,
+  // and moves all remaining boxes that overlap it by more than the
+  // suppression threshold, including the leader itself, to its cluster.
+  // Ignores options.max_num_boxes.
+  void Cluster(const Options& options, Clusters* clusters);
+
+ private:
+  // The boxes indexed by one grid cell, in the order they were inserted.
+  struct Cell {
+    std::vector<float> xmin;
+    std::vector<float> ymin;
+    std::vector<float> xmax;
+    std::vector<float> ymax;
+    std::vector<float> area;
+    std::vector<int> rank;
+
+    void Clear();
+    void Add(const NonMaxSuppressor& nms, int index, int rank);
+  };
+
+  // Sorts the boxes by decreasing score into order_.
+  void SortByScore();
+  // Sizes the grid for the boxes and options, and empties its cells.
+  void ResetGrid(const Options& options);
+  // Computes the range of grid cells spanned by a box. Returns false if the
+  // box is not indexed by any cell.
+  bool GetCellRange(int index, int* x0, int* y0, int* x1, int* y1) const;
+  // Inserts a box, whose position in order_ is rank, into the grid.
+  void InsertIntoGrid(int index, int rank);
+  // Returns true if the box is overlapped by more than the threshold by a box
+  // in the grid.
+  bool IsSuppressed(int index, const Options& options) const;
+  // Appends to ranks the ranks of the boxes in the grid that overlap the box
+  // by more than the threshold, and are not yet clustered.
+  void FindOverlapping(int index, const Options& options,
+                       std::vector<int>* ranks);
+
+  // The boxes.
+  std::vector<float> xmin_;
+  std::vector<float> ymin_;
+  std::vector<float> xmax_;
+  std::vector<float> ymax_;
+  std::vector<float> area_;
+  std::vector<float> scores_;
+  std::vector<int> class_ids_;
+
+  // The (index, score) pairs of the boxes, by decreasing score.
+  std::vector<std::pair<int, float>> order_;
+
+  // The grid, with one layer of grid_width * grid_height cells per class.
+  // If index_all_boxes_ is set, the grid has a single cell per layer, which
+  // also indexes the empty boxes.
+  bool index_all_boxes_ = false;
+  float grid_x_ = 0.0f;
+  float grid_y_ = 0.0f;
+  float grid_x_scale_ = 0.0f;
+  float grid_y_scale_ = 0.0f;
+  int grid_width_ = 1;
+  int grid_height_ = 1;
+  int num_cells_ = 0;
+  std::vector<Cell> cells_;
+  // The layer of each box, if options.per_class is set.
+  std::vector<int> layers_;
+  std::vector<int> class_id_scratch_;
+
+  // For Cluster(), whether each rank has been clustered, and the last query
+  // that found it, to skip the boxes indexed by several cells.
+  std::vector<bool> clustered_;
+  std::vector<int> visited_;
+  int query_ = 0;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_NON_MAX_SUPPRESSION_H_
@@ -0,0 +1,336 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/non_max_suppression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/rectangle.h"
+
+namespace mediapipe {
+namespace {
+
+using OverlapType = NonMaxSuppressor::OverlapType;
+
+constexpr OverlapType kOverlapTypes[] = {
+    OverlapType::kJaccard, OverlapType::kModifiedJaccard,
+    OverlapType::kIntersectionOverUnion};
+
+struct TestBox {
+  Rectangle_f rect;
+  float score;
+  int class_id;
+};
+
+// Returns num_boxes boxes of the given mean size in the unit square. The
+// scores are quantized, so that some of them are equal.
+std::vector<TestBox> MakeBoxes(int num_boxes, float size, int num_classes,
+                               int seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> position(0.0f, 1.0f);
+  std::uniform_real_distribution<float> extent(0.5f * size, 1.5f * size);
+  std::uniform_int_distribution<int> score(0, 255);
+  std::uniform_int_distribution<int> class_id(0, num_classes - 1);
+  std::vector<TestBox> boxes;
+  for (int i = 0; i < num_boxes; ++i) {
+    boxes.push_back({Rectangle_f(position(rng), position(rng), extent(rng),
+                                 extent(rng)),
+                     score(rng) / 256.0f, class_id(rng)});
+  }
+  return boxes;
+}
+
+void AddBoxes(const std::vector<TestBox>& boxes, NonMaxSuppressor* nms) {
+  nms->Clear();
+  for (const TestBox& box : boxes) {
+    nms->AddBox(box.rect.xmin(), box.rect.ymin(), box.rect.xmax(),
+                box.rect.ymax(), box.score, box.class_id);
+  }
+}
+
+// The overlap computation of the NonMaxSuppressionCalculator.
+float ReferenceOverlap(OverlapType overlap_type, const Rectangle_f& rect1,
+                       const Rectangle_f& rect2) {
+  if (!rect1.Intersects(rect2)) return 0.0f;
+  const float intersection_area = Rectangle_f(rect1).Intersect(rect2).Area();
+  float normalization;
+  switch (overlap_type) {
+    case OverlapType::kJaccard:
+      normalization = Rectangle_f(rect1).Union(rect2).Area();
+      break;
+    case OverlapType::kModifiedJaccard:
+      normalization = rect2.Area();
+      break;
+    case OverlapType::kIntersectionOverUnion:
+    default:
+      normalization = rect1.Area() + rect2.Area() - intersection_area;
+      break;
+  }
+  return normalization > 0.0f ? intersection_area / normalization : 0.0f;
+}
+
+std::vector<std::pair<int, float>> ReferenceOrder(
+    const std::vector<TestBox>& boxes) {
+  std::vector<std::pair<int, float>> order;
+  for (int i = 0; i < boxes.size(); ++i) {
+    order.emplace_back(i, boxes[i].score);
+  }
+  std::sort(order.begin(), order.end(),
+            [](const std::pair<int, float>& a, const std::pair<int, float>& b) {
+              return a.second > b.second;
+            });
+  return order;
+}
+
+// Compares every box with every retained box.
+std::vector<int> ReferenceSuppress(const std::vector<TestBox>& boxes,
+                                   const NonMaxSuppressor::Options& options) {
+  std::vector<int> retained;
+  for (const auto& indexed_score : ReferenceOrder(boxes)) {
+    if (options.min_score_threshold > 0 &&
+        indexed_score.second < options.min_score_threshold) {
+      break;
+    }
+    const TestBox& box = boxes[indexed_score.first];
+    bool suppressed = false;
+    for (int index : retained) {
+      if ((!options.per_class || boxes[index].class_id == box.class_id) &&
+          ReferenceOverlap(options.overlap_type, boxes[index].rect,
+                           box.rect) > options.min_suppression_threshold) {
+        suppressed = true;
+        break;
+      }
+    }
+    if (!suppressed) retained.push_back(indexed_score.first);
+    if (options.max_num_boxes > -1 &&
+        retained.size() >= options.max_num_boxes) {
+      break;
+    }
+  }
+  return retained;
+}
+
+// Compares every remaining box with each cluster leader.
+NonMaxSuppressor::Clusters ReferenceCluster(
+    const std::vector<TestBox>& boxes,
+    const NonMaxSuppressor::Options& options) {
+  NonMaxSuppressor::Clusters clusters;
+  clusters.offsets.push_back(0);
+  std::vector<std::pair<int, float>> remained = ReferenceOrder(boxes);
+  while (!remained.empty()) {
+    const int leader = remained[0].first;
+    if (options.min_score_threshold > 0 &&
+        remained[0].second < options.min_score_threshold) {
+      break;
+    }
+    std::vector<std::pair<int, float>> rest;
+    for (const auto& indexed_score : remained) {
+      const TestBox& box = boxes[indexed_score.first];
+      if ((!options.per_class || boxes[leader].class_id == box.class_id) &&
+          ReferenceOverlap(options.overlap_type, box.rect,
+                           boxes[leader].rect) >
+              options.min_suppression_threshold) {
+        clusters.members.push_back(indexed_score.first);
+      } else {
+        rest.push_back(indexed_score);
+      }
+    }
+    clusters.leaders.push_back(leader);
+    clusters.offsets.push_back(clusters.members.size());
+    if (rest.size() == remained.size()) break;
+    remained = std::move(rest);
+  }
+  return clusters;
+}
+
+NonMaxSuppressor::Options MakeOptions(OverlapType overlap_type,
+                                      float threshold) {
+  NonMaxSuppressor::Options options;
+  options.overlap_type = overlap_type;
+  options.min_suppression_threshold = threshold;
+  return options;
+}
+
+TEST(NonMaxSuppressorTest, SuppressesOverlappingBoxes) {
+  NonMaxSuppressor nms;
+  nms.AddBox(0.0f, 0.0f, 0.4f, 0.4f, 0.8f);
+  nms.AddBox(0.1f, 0.1f, 0.5f, 0.5f, 0.9f);
+  nms.AddBox(0.6f, 0.6f, 0.9f, 0.9f, 0.7f);
+  nms.AddBox(0.6f, 0.6f, 0.5f, 0.9f, 1.0f);
+  std::vector<int> retained;
+  nms.Suppress(MakeOptions(OverlapType::kIntersectionOverUnion, 0.3f),
+               &retained);
+  // The empty box overlaps nothing, and is retained.
+  EXPECT_EQ(retained, (std::vector<int>{3, 1, 2}));
+
+  NonMaxSuppressor::Options options =
+      MakeOptions(OverlapType::kIntersectionOverUnion, 0.3f);
+  options.max_num_boxes = 2;
+  nms.Suppress(options, &retained);
+  EXPECT_EQ(retained, (std::vector<int>{3, 1}));
+
+  options.max_num_boxes = -1;
+  options.min_score_threshold = 0.85f;
+  nms.Suppress(options, &retained);
+  EXPECT_EQ(retained, (std::vector<int>{3, 1}));
+}
+
+TEST(NonMaxSuppressorTest, SuppressesPerClass) {
+  NonMaxSuppressor nms;
+  nms.AddBox(0.0f, 0.0f, 0.4f, 0.4f, 0.8f, /*class_id=*/7);
+  nms.AddBox(0.0f, 0.0f, 0.4f, 0.4f, 0.9f, /*class_id=*/3);
+  nms.AddBox(0.0f, 0.0f, 0.4f, 0.4f, 0.7f, /*class_id=*/3);
+  NonMaxSuppressor::Options options = MakeOptions(OverlapType::kJaccard, 0.5f);
+  std::vector<int> retained;
+  nms.Suppress(options, &retained);
+  EXPECT_EQ(retained, (std::vector<int>{1}));
+  options.per_class = true;
+  nms.Suppress(options, &retained);
+  EXPECT_EQ(retained, (std::vector<int>{1, 0}));
+}
+
+TEST(NonMaxSuppressorTest, NegativeThresholdSuppressesAllButOne) {
+  NonMaxSuppressor nms;
+  nms.AddBox(0.0f, 0.0f, 0.1f, 0.1f, 0.5f);
+  nms.AddBox(0.8f, 0.8f, 0.9f, 0.9f, 0.6f);
+  nms.AddBox(0.5f, 0.5f, 0.4f, 0.4f, 0.4f);
+  std::vector<int> retained;
+  nms.Suppress(MakeOptions(OverlapType::kJaccard, -0.5f), &retained);
+  EXPECT_EQ(retained, (std::vector<int>{1}));
+}
+
+TEST(NonMaxSuppressorTest, ClustersOverlappingBoxes) {
+  NonMaxSuppressor nms;
+  nms.AddBox(0.0f, 0.0f, 0.4f, 0.4f, 0.8f);
+  nms.AddBox(0.1f, 0.1f, 0.5f, 0.5f, 0.9f);
+  nms.AddBox(0.6f, 0.6f, 0.9f, 0.9f, 0.7f);
+  NonMaxSuppressor::Clusters clusters;
+  nms.Cluster(MakeOptions(OverlapType::kIntersectionOverUnion, 0.3f),
+              &clusters);
+  EXPECT_EQ(clusters.leaders, (std::vector<int>{1, 2}));
+  EXPECT_EQ(clusters.offsets, (std::vector<int>{0, 2, 3}));
+  EXPECT_EQ(clusters.members, (std::vector<int>{1, 0, 2}));
+
+  // No box overlaps itself by more than 1, so the first cluster is empty.
+  nms.Cluster(MakeOptions(OverlapType::kIntersectionOverUnion, 1.0f),
+              &clusters);
+  EXPECT_EQ(clusters.leaders, (std::vector<int>{1}));
+  EXPECT_EQ(clusters.offsets, (std::vector<int>{0, 0}));
+}
+
+TEST(NonMaxSuppressorTest, MatchesReference) {
+  NonMaxSuppressor nms;
+  std::vector<int> retained;
+  NonMaxSuppressor::Clusters clusters;
+  int seed = 0;
+  for (int num_boxes : {1, 2, 7, 100, 1000}) {
+    for (float size : {0.01f, 0.1f, 0.5f}) {
+      for (int num_classes : {1, 4}) {
+        const std::vector<TestBox> boxes =
+            MakeBoxes(num_boxes, size, num_classes, ++seed);
+        AddBoxes(boxes, &nms);
+        for (OverlapType overlap_type : kOverlapTypes) {
+          for (float threshold : {-0.1f, 0.0f, 0.3f, 0.7f}) {
+            NonMaxSuppressor::Options options =
+                MakeOptions(overlap_type, threshold);
+            options.per_class = num_classes > 1;
+            nms.Suppress(options, &retained);
+            EXPECT_EQ(retained, ReferenceSuppress(boxes, options))
+                << num_boxes << " boxes of size " << size << ", threshold "
+                << threshold;
+            nms.Cluster(options, &clusters);
+            const NonMaxSuppressor::Clusters expected =
+                ReferenceCluster(boxes, options);
+            EXPECT_EQ(clusters.leaders, expected.leaders);
+            EXPECT_EQ(clusters.offsets, expected.offsets);
+            EXPECT_EQ(clusters.members, expected.members);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Suppresses state.range(0) boxes, each overlapping a few others.
+void BM_Suppress(benchmark::State& state) {
+  const int num_boxes = state.range(0);
+  const std::vector<TestBox> boxes =
+      MakeBoxes(num_boxes, 2.0f / std::sqrt(num_boxes), 1, 1);
+  NonMaxSuppressor nms;
+  std::vector<int> retained;
+  const NonMaxSuppressor::Options options =
+      MakeOptions(OverlapType::kIntersectionOverUnion, 0.3f);
+  for (auto _ : state) {
+    AddBoxes(boxes, &nms);
+    nms.Suppress(options, &retained);
+  }
+  state.SetItemsProcessed(state.iterations() * num_boxes);
+}
+BENCHMARK(BM_Suppress)->Arg(100)->Arg(1000)->Arg(10000);
+
+void BM_SuppressPerClass(benchmark::State& state) {
+  const int num_boxes = state.range(0);
+  const std::vector<TestBox> boxes =
+      MakeBoxes(num_boxes, 4.0f / std::sqrt(num_boxes), 10, 1);
+  NonMaxSuppressor nms;
+  std::vector<int> retained;
+  NonMaxSuppressor::Options options =
+      MakeOptions(OverlapType::kIntersectionOverUnion, 0.3f);
+  options.per_class = true;
+  for (auto _ : state) {
+    AddBoxes(boxes, &nms);
+    nms.Suppress(options, &retained);
+  }
+  state.SetItemsProcessed(state.iterations() * num_boxes);
+}
+BENCHMARK(BM_SuppressPerClass)->Arg(100)->Arg(1000)->Arg(10000);
+
+void BM_Cluster(benchmark::State& state) {
+  const int num_boxes = state.range(0);
+  const std::vector<TestBox> boxes =
+      MakeBoxes(num_boxes, 2.0f / std::sqrt(num_boxes), 1, 1);
+  NonMaxSuppressor nms;
+  NonMaxSuppressor::Clusters clusters;
+  const NonMaxSuppressor::Options options =
+      MakeOptions(OverlapType::kIntersectionOverUnion, 0.3f);
+  for (auto _ : state) {
+    AddBoxes(boxes, &nms);
+    nms.Cluster(options, &clusters);
+  }
+  state.SetItemsProcessed(state.iterations() * num_boxes);
+}
+BENCHMARK(BM_Cluster)->Arg(100)->Arg(1000)->Arg(10000);
+
+// The pairwise comparisons of the NonMaxSuppressionCalculator, for reference.
+void BM_SuppressPairwise(benchmark::State& state) {
+  const int num_boxes = state.range(0);
+  const std::vector<TestBox> boxes =
+      MakeBoxes(num_boxes, 2.0f / std::sqrt(num_boxes), 1, 1);
+  const NonMaxSuppressor::Options options =
+      MakeOptions(OverlapType::kIntersectionOverUnion, 0.3f);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ReferenceSuppress(boxes, options));
+  }
+  state.SetItemsProcessed(state.iterations() * num_boxes);
+}
+BENCHMARK(BM_SuppressPairwise)->Arg(100)->Arg(1000)->Arg(10000);
+
+}  // namespace
+}  // namespace mediapipe
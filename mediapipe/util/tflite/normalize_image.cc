@@ -0,0 +1,303 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/tflite/normalize_image.h"
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MEDIAPIPE_NORMALIZE_IMAGE_NEON 1
+#endif
+
+namespace mediapipe {
+
+namespace {
+
+template <typename T>
+void NormalizeValues(const T* src, int count, float scale, float bias,
+                     float* dst) {
+  for (int i = 0; i < count; ++i) {
+    dst[i] = src[i] * scale + bias;
+  }
+}
+
+#if defined(__SSE2__)
+// Converts 4 uint8 values, stored in the low 32 bits of bytes, to floats.
+inline __m128 Uint8x4ToFloat(__m128i bytes) {
+  const __m128i zero = _mm_setzero_si128();
+  return _mm_cvtepi32_ps(
+      _mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero));
+}
+#endif  // __SSE2__
+
+#if defined(MEDIAPIPE_NORMALIZE_IMAGE_NEON)
+// Converts the low or high 4 values of 8 uint16 values to floats.
+inline float32x4_t LowToFloat(uint16x8_t values) {
+  return vcvtq_f32_u32(vmovl_u16(vget_low_u16(values)));
+}
+inline float32x4_t HighToFloat(uint16x8_t values) {
+  return vcvtq_f32_u32(vmovl_u16(vget_high_u16(values)));
+}
+#endif  // MEDIAPIPE_NORMALIZE_IMAGE_NEON
+
+// Normalizes count contiguous uint8 values.
+void NormalizeContiguous(const uint8* src, int count, float scale, float bias,
+                         float* dst) {
+  int i = 0;
+#if defined(__AVX2__)
+  const __m256 scale8 = _mm256_set1_ps(scale);
+  const __m256 bias8 = _mm256_set1_ps(bias);
+  for (; i + 8 <= count; i += 8) {
+    const __m256 values = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i))));
+    _mm256_storeu_ps(dst + i,
+                     _mm256_add_ps(_mm256_mul_ps(values, scale8), bias8));
+  }
+#elif defined(__SSE2__)
+  const __m128 scale4 = _mm_set1_ps(scale);
+  const __m128 bias4 = _mm_set1_ps(bias);
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= count; i += 16) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+    const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+    const __m128 values[4] = {
+        _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)),
+        _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)),
+        _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)),
+        _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero))};
+    for (int k = 0; k < 4; ++k) {
+      _mm_storeu_ps(dst + i + 4 * k,
+                    _mm_add_ps(_mm_mul_ps(values[k], scale4), bias4));
+    }
+  }
+#elif defined(MEDIAPIPE_NORMALIZE_IMAGE_NEON)
+  const float32x4_t scale4 = vdupq_n_f32(scale);
+  const float32x4_t bias4 = vdupq_n_f32(bias);
+  for (; i + 16 <= count; i += 16) {
+    const uint8x16_t bytes = vld1q_u8(src + i);
+    const uint16x8_t low = vmovl_u8(vget_low_u8(bytes));
+    const uint16x8_t high = vmovl_u8(vget_high_u8(bytes));
+    const float32x4_t values[4] = {LowToFloat(low), HighToFloat(low),
+                                   LowToFloat(high), HighToFloat(high)};
+    for (int k = 0; k < 4; ++k) {
+      vst1q_f32(dst + i + 4 * k,
+                vaddq_f32(vmulq_f32(values[k], scale4), bias4));
+    }
+  }
+#endif
+  NormalizeValues(src + i, count - i, scale, bias, dst + i);
+}
+
+// Normalizes count contiguous float values.
+void NormalizeContiguous(const float* src, int count, float scale, float bias,
+                         float* dst) {
+  int i = 0;
+#if defined(__AVX2__)
+  const __m256 scale8 = _mm256_set1_ps(scale);
+  const __m256 bias8 = _mm256_set1_ps(bias);
+  for (; i + 8 <= count; i += 8) {
+    _mm256_storeu_ps(
+        dst + i,
+        _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale8), bias8));
+  }
+#elif defined(__SSE2__)
+  const __m128 scale4 = _mm_set1_ps(scale);
+  const __m128 bias4 = _mm_set1_ps(bias);
+  for (; i + 4 <= count; i += 4) {
+    _mm_storeu_ps(dst + i,
+                  _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale4), bias4));
+  }
+#elif defined(MEDIAPIPE_NORMALIZE_IMAGE_NEON)
+  const float32x4_t scale4 = vdupq_n_f32(scale);
+  const float32x4_t bias4 = vdupq_n_f32(bias);
+  for (; i + 4 <= count; i += 4) {
+    vst1q_f32(dst + i, vaddq_f32(vmulq_f32(vld1q_f32(src + i), scale4), bias4));
+  }
+#endif
+  NormalizeValues(src + i, count - i, scale, bias, dst + i);
+}
+
+#if defined(__SSE2__) || defined(MEDIAPIPE_NORMALIZE_IMAGE_NEON)
+// Normalizes the RGB channels of width RGBA pixels. Returns the number of
+// pixels done, which leaves a tail of pixels for the scalar code.
+int NormalizeRgbaToRgb(const uint8* src, int width, float scale, float bias,
+                       float* dst) {
+  int j = 0;
+#if defined(__SSE2__)
+  // Each pixel is normalized with its alpha, and stored as 4 floats whose
+  // last one is overwritten by the next pixel. The last pixel of the row is
+  // left to the scalar code, so no store passes the end of the row.
+  const __m128 scale4 = _mm_set1_ps(scale);
+  const __m128 bias4 = _mm_set1_ps(bias);
+  for (; j + 4 < width; j += 4) {
+    __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * j));
+    for (int k = 0; k < 4; ++k) {
+      _mm_storeu_ps(dst + 3 * (j + k),
+                    _mm_add_ps(_mm_mul_ps(Uint8x4ToFloat(bytes), scale4),
+                               bias4));
+      bytes = _mm_srli_si128(bytes, 4);
+    }
+  }
+#elif defined(MEDIAPIPE_NORMALIZE_IMAGE_NEON)
+  const float32x4_t scale4 = vdupq_n_f32(scale);
+  const float32x4_t bias4 = vdupq_n_f32(bias);
+  for (; j + 16 <= width; j += 16) {
+    const uint8x16x4_t pixels = vld4q_u8(src + 4 * j);
+    float32x4_t rgb[3][4];
+    for (int c = 0; c < 3; ++c) {
+      const uint16x8_t low = vmovl_u8(vget_low_u8(pixels.val[c]));
+      const uint16x8_t high = vmovl_u8(vget_high_u8(pixels.val[c]));
+      rgb[c][0] = LowToFloat(low);
+      rgb[c][1] = HighToFloat(low);
+      rgb[c][2] = LowToFloat(high);
+      rgb[c][3] = HighToFloat(high);
+    }
+    for (int k = 0; k < 4; ++k) {
+      float32x4x3_t out;
+      for (int c = 0; c < 3; ++c) {
+        out.val[c] = vaddq_f32(vmulq_f32(rgb[c][k], scale4), bias4);
+      }
+      vst3q_f32(dst + 3 * (j + 4 * k), out);
+    }
+  }
+#endif
+  return j;
+}
+#endif  // __SSE2__ || MEDIAPIPE_NORMALIZE_IMAGE_NEON
+
+#if defined(__SSSE3__) || defined(MEDIAPIPE_NORMALIZE_IMAGE_NEON)
+// Packs the RGB channels of width RGBA pixels. Returns the number of pixels
+// done, which leaves a tail of pixels for the scalar code.
+int PackRgbaToRgb(const uint8* src, int width, uint8* dst) {
+  int j = 0;
+#if defined(__SSSE3__)
+  // Each 4 pixels are stored as 16 bytes, whose last 4 are overwritten by the
+  // next pixels, so the loop stops 2 pixels before the end of the row.
+  const __m128i shuffle =
+      _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  for (; j + 6 <= width; j += 4) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * j));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * j),
+                     _mm_shuffle_epi8(bytes, shuffle));
+  }
+#elif defined(MEDIAPIPE_NORMALIZE_IMAGE_NEON)
+  for (; j + 16 <= width; j += 16) {
+    const uint8x16x4_t pixels = vld4q_u8(src + 4 * j);
+    uint8x16x3_t out;
+    out.val[0] = pixels.val[0];
+    out.val[1] = pixels.val[1];
+    out.val[2] = pixels.val[2];
+    vst3q_u8(dst + 3 * j, out);
+  }
+#endif
+  return j;
+}
+#endif  // __SSSE3__ || MEDIAPIPE_NORMALIZE_IMAGE_NEON
+
+template <typename T>
+void NormalizeImageRowTail(const T* src, int width, int channels,
+                           int channels_preserved, float scale, float bias,
+                           float* dst) {
+  for (int j = 0; j < width; ++j) {
+    for (int c = 0; c < channels_preserved; ++c) {
+      *dst++ = *src++ * scale + bias;
+    }
+    src += channels - channels_preserved;
+  }
+}
+
+}  // namespace
+
+void NormalizeImageRow(const uint8* src, int width, int channels,
+                       int channels_preserved, float scale, float bias,
+                       float* dst) {
+  if (channels == channels_preserved) {
+    NormalizeContiguous(src, width * channels, scale, bias, dst);
+    return;
+  }
+  int done = 0;
+#if defined(__SSE2__) || defined(MEDIAPIPE_NORMALIZE_IMAGE_NEON)
+  if (channels == 4 && channels_preserved == 3) {
+    done = NormalizeRgbaToRgb(src, width, scale, bias, dst);
+  }
+#endif  // __SSE2__ || MEDIAPIPE_NORMALIZE_IMAGE_NEON
+  NormalizeImageRowTail(src + done * channels, width - done, channels,
+                        channels_preserved, scale, bias,
+                        dst + done * channels_preserved);
+}
+
+void NormalizeImageRow(const float* src, int width, int channels,
+                       int channels_preserved, float scale, float bias,
+                       float* dst) {
+  if (channels == channels_preserved) {
+    NormalizeContiguous(src, width * channels, scale, bias, dst);
+    return;
+  }
+  NormalizeImageRowTail(src, width, channels, channels_preserved, scale, bias,
+                        dst);
+}
+
+void PackImageRow(const uint8* src, int width, int channels,
+                  int channels_preserved, uint8* dst) {
+  if (channels == channels_preserved) {
+    std::memcpy(dst, src, width * channels);
+    return;
+  }
+  int done = 0;
+#if defined(__SSSE3__) || defined(MEDIAPIPE_NORMALIZE_IMAGE_NEON)
+  if (channels == 4 && channels_preserved == 3) {
+    done = PackRgbaToRgb(src, width, dst);
+  }
+#endif  // __SSSE3__ || MEDIAPIPE_NORMALIZE_IMAGE_NEON
+  PackImageRowScalar(src + done * channels, width - done, channels,
+                     channels_preserved, dst + done * channels_preserved);
+}
+
+void NormalizeImageRowScalar(const uint8* src, int width, int channels,
+                             int channels_preserved, float scale, float bias,
+                             float* dst) {
+  NormalizeImageRowTail(src, width, channels, channels_preserved, scale, bias,
+                        dst);
+}
+
+void NormalizeImageRowScalar(const float* src, int width, int channels,
+                             int channels_preserved, float scale, float bias,
+                             float* dst) {
+  NormalizeImageRowTail(src, width, channels, channels_preserved, scale, bias,
+                        dst);
+}
+
+void PackImageRowScalar(const uint8* src, int width, int channels,
+                        int channels_preserved, uint8* dst) {
+  for (int j = 0; j < width; ++j) {
+    for (int c = 0; c < channels_preserved; ++c) {
+      *dst++ = *src++;
+    }
+    src += channels - channels_preserved;
+  }
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,55 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Row kernels that pack interleaved image pixels into TfLite input tensors.
+// Each kernel reads one row of width pixels with channels interleaved
+// channels, keeps the first channels_preserved channels of each pixel, and
+// writes width * channels_preserved contiguous values.
+//
+// The kernels use AVX2, SSE2/SSSE3 or NEON when the target supports them,
+// and otherwise fall back to the scalar reference implementations, which
+// produce the same values.
+
+#ifndef MEDIAPIPE_UTIL_TFLITE_NORMALIZE_IMAGE_H_
+#define MEDIAPIPE_UTIL_TFLITE_NORMALIZE_IMAGE_H_
+
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+// Writes value * scale + bias for each preserved channel value of the row.
+void NormalizeImageRow(const uint8* src, int width, int channels,
+                       int channels_preserved, float scale, float bias,
+                       float* dst);
+void NormalizeImageRow(const float* src, int width, int channels,
+                       int channels_preserved, float scale, float bias,
+                       float* dst);
+
+// Copies each preserved channel value of the row.
+void PackImageRow(const uint8* src, int width, int channels,
+                  int channels_preserved, uint8* dst);
+
+// The scalar reference implementations of the kernels above.
+void NormalizeImageRowScalar(const uint8* src, int width, int channels,
+                             int channels_preserved, float scale, float bias,
+                             float* dst);
+void NormalizeImageRowScalar(const float* src, int width, int channels,
+                             int channels_preserved, float scale, float bias,
+                             float* dst);
+void PackImageRowScalar(const uint8* src, int width, int channels,
+                        int channels_preserved, uint8* dst);
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_TFLITE_NORMALIZE_IMAGE_H_
@@ -0,0 +1,173 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/tflite/normalize_image.h"
+
+#include <vector>
+
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+
+namespace mediapipe {
+namespace {
+
+struct ChannelLayout {
+  int channels;
+  int channels_preserved;
+};
+
+constexpr ChannelLayout kLayouts[] = {{1, 1}, {3, 3}, {4, 4}, {4, 3},
+                                      {3, 1}, {4, 1}, {4, 2}};
+
+// The widths cover the scalar tails of every vector loop.
+constexpr int kMaxWidth = 70;
+
+std::vector<uint8> MakeRow(int count) {
+  std::vector<uint8> row(count);
+  for (int i = 0; i < count; ++i) {
+    row[i] = static_cast<uint8>(i * 37 + 11);
+  }
+  return row;
+}
+
+TEST(NormalizeImageTest, NormalizeUint8MatchesScalar) {
+  for (const ChannelLayout& layout : kLayouts) {
+    for (int width = 1; width <= kMaxWidth; ++width) {
+      const std::vector<uint8> src = MakeRow(width * layout.channels);
+      // The extra value catches writes past the end of the row.
+      std::vector<float> expected(width * layout.channels_preserved + 1, -7.f);
+      std::vector<float> actual(expected.size(), -7.f);
+      NormalizeImageRowScalar(src.data(), width, layout.channels,
+                              layout.channels_preserved, 2.f / 255.f, -1.f,
+                              expected.data());
+      NormalizeImageRow(src.data(), width, layout.channels,
+                        layout.channels_preserved, 2.f / 255.f, -1.f,
+                        actual.data());
+      for (int i = 0; i < expected.size(); ++i) {
+        ASSERT_FLOAT_EQ(actual[i], expected[i])
+            << "channels " << layout.channels << " preserved "
+            << layout.channels_preserved << " width " << width << " index "
+            << i;
+      }
+    }
+  }
+}
+
+TEST(NormalizeImageTest, NormalizeFloatMatchesScalar) {
+  for (const ChannelLayout& layout : kLayouts) {
+    for (int width = 1; width <= kMaxWidth; ++width) {
+      std::vector<float> src(width * layout.channels);
+      for (int i = 0; i < src.size(); ++i) {
+        src[i] = i * 0.25f - 3.f;
+      }
+      std::vector<float> expected(width * layout.channels_preserved + 1, -7.f);
+      std::vector<float> actual(expected.size(), -7.f);
+      NormalizeImageRowScalar(src.data(), width, layout.channels,
+                              layout.channels_preserved, 0.5f, 0.25f,
+                              expected.data());
+      NormalizeImageRow(src.data(), width, layout.channels,
+                        layout.channels_preserved, 0.5f, 0.25f, actual.data());
+      for (int i = 0; i < expected.size(); ++i) {
+        ASSERT_FLOAT_EQ(actual[i], expected[i])
+            << "channels " << layout.channels << " preserved "
+            << layout.channels_preserved << " width " << width << " index "
+            << i;
+      }
+    }
+  }
+}
+
+TEST(NormalizeImageTest, PackMatchesScalar) {
+  for (const ChannelLayout& layout : kLayouts) {
+    for (int width = 1; width <= kMaxWidth; ++width) {
+      const std::vector<uint8> src = MakeRow(width * layout.channels);
+      std::vector<uint8> expected(width * layout.channels_preserved + 1, 7);
+      std::vector<uint8> actual(expected.size(), 7);
+      PackImageRowScalar(src.data(), width, layout.channels,
+                         layout.channels_preserved, expected.data());
+      PackImageRow(src.data(), width, layout.channels,
+                   layout.channels_preserved, actual.data());
+      ASSERT_EQ(actual, expected)
+          << "channels " << layout.channels << " preserved "
+          << layout.channels_preserved << " width " << width;
+    }
+  }
+}
+
+TEST(NormalizeImageTest, NormalizeRgbaToRgb) {
+  const uint8 src[] = {0, 51, 255, 9, 102, 153, 204, 9};
+  float dst[6];
+  NormalizeImageRow(src, 2, 4, 3, 1.f / 255.f, 0.f, dst);
+  EXPECT_FLOAT_EQ(dst[0], 0.f);
+  EXPECT_FLOAT_EQ(dst[1], 0.2f);
+  EXPECT_FLOAT_EQ(dst[2], 1.f);
+  EXPECT_FLOAT_EQ(dst[3], 0.4f);
+  EXPECT_FLOAT_EQ(dst[4], 0.6f);
+  EXPECT_FLOAT_EQ(dst[5], 0.8f);
+}
+
+// Benchmarks one 256x256 image, whose rows are normalized by the vectorized
+// kernel when use_simd is set, and by the scalar one otherwise.
+template <bool use_simd>
+void BM_NormalizeImage(benchmark::State& state) {
+  const int width = 256;
+  const int height = 256;
+  const int channels = state.range(0);
+  const int channels_preserved = state.range(1);
+  const std::vector<uint8> src = MakeRow(width * height * channels);
+  std::vector<float> dst(width * height * channels_preserved);
+  for (auto _ : state) {
+    for (int i = 0; i < height; ++i) {
+      const uint8* src_row = src.data() + i * width * channels;
+      float* dst_row = dst.data() + i * width * channels_preserved;
+      if (use_simd) {
+        NormalizeImageRow(src_row, width, channels, channels_preserved,
+                          2.f / 255.f, -1.f, dst_row);
+      } else {
+        NormalizeImageRowScalar(src_row, width, channels, channels_preserved,
+                                2.f / 255.f, -1.f, dst_row);
+      }
+    }
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetBytesProcessed(state.iterations() * src.size());
+}
+BENCHMARK_TEMPLATE(BM_NormalizeImage, false)->Args({3, 3})->Args({4, 3});
+BENCHMARK_TEMPLATE(BM_NormalizeImage, true)->Args({3, 3})->Args({4, 3});
+
+template <bool use_simd>
+void BM_PackImage(benchmark::State& state) {
+  const int width = 256;
+  const int height = 256;
+  const std::vector<uint8> src = MakeRow(width * height * 4);
+  std::vector<uint8> dst(width * height * 3);
+  for (auto _ : state) {
+    for (int i = 0; i < height; ++i) {
+      if (use_simd) {
+        PackImageRow(src.data() + i * width * 4, width, 4, 3,
+                     dst.data() + i * width * 3);
+      } else {
+        PackImageRowScalar(src.data() + i * width * 4, width, 4, 3,
+                           dst.data() + i * width * 3);
+      }
+    }
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetBytesProcessed(state.iterations() * src.size());
+}
+BENCHMARK_TEMPLATE(BM_PackImage, false);
+BENCHMARK_TEMPLATE(BM_PackImage, true);
+
+}  // namespace
+}  // namespace mediapipe
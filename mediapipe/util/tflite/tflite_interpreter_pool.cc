@@ -0,0 +1,141 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/tflite/tflite_interpreter_pool.h"
+
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+
+#include "absl/hash/hash.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status_macros.h"
+#include "tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
+
+namespace mediapipe {
+
+namespace {
+
+// Returns the serialized content of model.
+absl::string_view ModelContent(const tflite::FlatBufferModel& model) {
+  return absl::string_view(
+      reinterpret_cast<const char*>(model.allocation()->base()),
+      model.allocation()->bytes());
+}
+
+}  // namespace
+
+const GraphService<TfLiteInterpreterPool> kTfLiteInterpreterPoolService(
+    "kTfLiteInterpreterPoolService");
+
+TfLiteInterpreterPool::TfLiteInterpreterPool(const Options& options)
+    : options_(options), xnnpack_delegate_(nullptr, [](TfLiteDelegate*) {}) {}
+
+TfLiteInterpreterPool::~TfLiteInterpreterPool() {
+  // The interpreters must be destroyed before the delegate they use.
+  absl::MutexLock lock(&mutex_);
+  idle_interpreters_.clear();
+  xnnpack_delegate_.reset();
+}
+
+Packet TfLiteInterpreterPool::ShareModel(const Packet& model) {
+  const tflite::FlatBufferModel& flat_buffer_model =
+      *model.Get<TfLiteModelPtr>();
+  const std::string key = ModelKey(flat_buffer_model);
+  absl::MutexLock lock(&mutex_);
+  auto iter = models_.find(key);
+  if (iter == models_.end()) {
+    models_.emplace(key, model);
+    return model;
+  }
+  // Guard against hash collisions, which keep the given model unshared.
+  if (ModelContent(*iter->second.Get<TfLiteModelPtr>()) !=
+      ModelContent(flat_buffer_model)) {
+    return model;
+  }
+  return iter->second;
+}
+
+::mediapipe::StatusOr<TfLiteInterpreterPool::InterpreterPtr>
+TfLiteInterpreterPool::Acquire(const Packet& model, const std::string& key,
+                               const InterpreterFactory& factory) {
+  std::unique_ptr<tflite::Interpreter> interpreter;
+  Packet interpreter_model;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto iter = idle_interpreters_.find(key);
+    if (iter != idle_interpreters_.end() && !iter->second.empty()) {
+      interpreter = std::move(iter->second.back().interpreter);
+      interpreter_model = std::move(iter->second.back().model);
+      iter->second.pop_back();
+    }
+  }
+  if (!interpreter) {
+    // Build the interpreter without holding the lock, as the factory may
+    // call XnnpackDelegate().
+    ASSIGN_OR_RETURN(interpreter, factory(*model.Get<TfLiteModelPtr>()));
+    RET_CHECK(interpreter);
+    interpreter_model = model;
+    absl::MutexLock lock(&mutex_);
+    ++interpreters_built_;
+  }
+  std::shared_ptr<TfLiteInterpreterPool> pool = shared_from_this();
+  return InterpreterPtr(interpreter.release(),
+                        [pool, key, interpreter_model](
+                            tflite::Interpreter* interpreter) {
+                          pool->Release(key, interpreter_model, interpreter);
+                        });
+}
+
+void TfLiteInterpreterPool::Release(const std::string& key,
+                                    const Packet& model,
+                                    tflite::Interpreter* interpreter) {
+  std::unique_ptr<tflite::Interpreter> owned_interpreter(interpreter);
+  absl::MutexLock lock(&mutex_);
+  std::vector<IdleInterpreter>& idle = idle_interpreters_[key];
+  if (idle.size() < options_.max_idle_interpreters) {
+    idle.push_back({std::move(owned_interpreter), model});
+  }
+}
+
+TfLiteDelegate* TfLiteInterpreterPool::XnnpackDelegate() {
+  absl::MutexLock lock(&mutex_);
+  if (!xnnpack_delegate_) {
+    TfLiteXNNPackDelegateOptions xnnpack_opts{};
+    xnnpack_opts.num_threads =
+        options_.xnnpack_num_threads > 0
+            ? options_.xnnpack_num_threads
+            : static_cast<int>(std::thread::hardware_concurrency());
+    xnnpack_delegate_ =
+        std::unique_ptr<TfLiteDelegate, void (*)(TfLiteDelegate*)>(
+            TfLiteXNNPackDelegateCreate(&xnnpack_opts),
+            &TfLiteXNNPackDelegateDelete);
+  }
+  return xnnpack_delegate_.get();
+}
+
+int64 TfLiteInterpreterPool::interpreters_built() const {
+  absl::MutexLock lock(&mutex_);
+  return interpreters_built_;
+}
+
+std::string TfLiteInterpreterPool::ModelKey(
+    const tflite::FlatBufferModel& model) {
+  const absl::string_view content = ModelContent(model);
+  return absl::StrCat(content.size(), ":",
+                      absl::Hash<absl::string_view>()(content));
+}
+
+}  // namespace mediapipe
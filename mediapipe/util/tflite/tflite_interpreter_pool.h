@@ -0,0 +1,144 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// This class shares TfLite models and interpreters among the
+// TfLiteInferenceCalculators of one or more graphs. Models with the same
+// content are loaded once, idle interpreters are reused instead of being
+// rebuilt, and every interpreter that uses XNNPACK shares one delegate, and
+// thus one thread pool, so that parallel invocations do not oversubscribe
+// the cores.
+//
+// The pool is shared through kTfLiteInterpreterPoolService:
+//
+//   TfLiteInterpreterPool::Options options;
+//   options.xnnpack_num_threads = 4;
+//   auto pool = TfLiteInterpreterPool::Create(options);
+//   graph1.SetServiceObject(kTfLiteInterpreterPoolService, pool);
+//   graph2.SetServiceObject(kTfLiteInterpreterPoolService, pool);
+
+#ifndef MEDIAPIPE_UTIL_TFLITE_TFLITE_INTERPRETER_POOL_H_
+#define MEDIAPIPE_UTIL_TFLITE_TFLITE_INTERPRETER_POOL_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/graph_service.h"
+#include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "tensorflow/lite/interpreter.h"
+#include "tensorflow/lite/model.h"
+
+namespace mediapipe {
+
+class TfLiteInterpreterPool
+    : public std::enable_shared_from_this<TfLiteInterpreterPool> {
+ public:
+  using TfLiteModelPtr =
+      std::unique_ptr<tflite::FlatBufferModel,
+                      std::function<void(tflite::FlatBufferModel*)>>;
+  // A checked-out interpreter, which returns to the pool when it is
+  // destroyed.
+  using InterpreterPtr =
+      std::unique_ptr<tflite::Interpreter,
+                      std::function<void(tflite::Interpreter*)>>;
+  // Builds a new interpreter for a model.
+  using InterpreterFactory =
+      std::function<::mediapipe::StatusOr<std::unique_ptr<tflite::Interpreter>>(
+          const tflite::FlatBufferModel& model)>;
+
+  struct Options {
+    // The most idle interpreters kept for each key. More interpreters can be
+    // checked out at once, but the extra ones are destroyed when they are
+    // returned.
+    int max_idle_interpreters = 4;
+    // The number of threads of the shared XNNPACK delegate. When not
+    // positive, the number of hardware threads is used.
+    int xnnpack_num_threads = -1;
+  };
+
+  // Creates a pool.
+  // We enforce creation as a shared_ptr so that checked-out interpreters can
+  // keep the pool alive.
+  static std::shared_ptr<TfLiteInterpreterPool> Create(const Options& options) {
+    return std::shared_ptr<TfLiteInterpreterPool>(
+        new TfLiteInterpreterPool(options));
+  }
+
+  ~TfLiteInterpreterPool();
+
+  TfLiteInterpreterPool(const TfLiteInterpreterPool&) = delete;
+  TfLiteInterpreterPool& operator=(const TfLiteInterpreterPool&) = delete;
+
+  // Returns a model packet holding a TfLiteModelPtr with the same content as
+  // model, which is model itself unless the pool already holds an identical
+  // model. The pool keeps the returned model for as long as it lives.
+  Packet ShareModel(const Packet& model);
+
+  // Checks out an interpreter for model. Returns an idle interpreter checked
+  // out before with the same key if there is one, and otherwise one built by
+  // factory. The key must identify the model content, as returned by
+  // ModelKey(), and everything else factory configures, such as the op
+  // resolver and the delegate. The interpreter keeps model alive.
+  ::mediapipe::StatusOr<InterpreterPtr> Acquire(
+      const Packet& model, const std::string& key,
+      const InterpreterFactory& factory);
+
+  // Returns the XNNPACK delegate shared by all interpreters of the pool.
+  // Interpreters must be built by a factory passed to Acquire() to use it.
+  TfLiteDelegate* XnnpackDelegate();
+
+  // Returns the number of interpreters built by the factories.
+  int64 interpreters_built() const;
+
+  // Returns a string that identifies the content of model.
+  static std::string ModelKey(const tflite::FlatBufferModel& model);
+
+ private:
+  struct IdleInterpreter {
+    std::unique_ptr<tflite::Interpreter> interpreter;
+    // The model of interpreter, which must outlive it.
+    Packet model;
+  };
+
+  explicit TfLiteInterpreterPool(const Options& options);
+
+  // Returns an interpreter to the idle interpreters of key.
+  void Release(const std::string& key, const Packet& model,
+               tflite::Interpreter* interpreter);
+
+  const Options options_;
+
+  mutable absl::Mutex mutex_;
+  // The XNNPACK delegate is declared before the interpreters, so that it is
+  // destroyed after the interpreters that use it.
+  std::unique_ptr<TfLiteDelegate, void (*)(TfLiteDelegate*)>
+      xnnpack_delegate_ ABSL_GUARDED_BY(mutex_);
+  // The shared models by ModelKey().
+  std::map<std::string, Packet> models_ ABSL_GUARDED_BY(mutex_);
+  std::map<std::string, std::vector<IdleInterpreter>> idle_interpreters_
+      ABSL_GUARDED_BY(mutex_);
+  int64 interpreters_built_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+// The graph service that shares a TfLiteInterpreterPool among calculators.
+extern const GraphService<TfLiteInterpreterPool> kTfLiteInterpreterPoolService;
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_TFLITE_TFLITE_INTERPRETER_POOL_H_
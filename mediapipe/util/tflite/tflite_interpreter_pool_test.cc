@@ -0,0 +1,133 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/tflite/tflite_interpreter_pool.h"
+
+#include <memory>
+#include <string>
+
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status_macros.h"
+#include "tensorflow/lite/kernels/register.h"
+
+namespace mediapipe {
+namespace {
+
+constexpr char kModelPath[] = "mediapipe/models/face_detection_front.tflite";
+
+Packet LoadModel() {
+  auto model = tflite::FlatBufferModel::BuildFromFile(kModelPath);
+  CHECK(model) << "Failed to load " << kModelPath;
+  return MakePacket<TfLiteInterpreterPool::TfLiteModelPtr>(
+      TfLiteInterpreterPool::TfLiteModelPtr(
+          model.release(),
+          [](tflite::FlatBufferModel* model) { delete model; }));
+}
+
+::mediapipe::StatusOr<std::unique_ptr<tflite::Interpreter>> BuildInterpreter(
+    const tflite::FlatBufferModel& model) {
+  tflite::ops::builtin::BuiltinOpResolver op_resolver;
+  std::unique_ptr<tflite::Interpreter> interpreter;
+  tflite::InterpreterBuilder(model, op_resolver)(&interpreter);
+  RET_CHECK(interpreter);
+  RET_CHECK_EQ(interpreter->AllocateTensors(), kTfLiteOk);
+  return interpreter;
+}
+
+TfLiteInterpreterPool::InterpreterPtr AcquireOrDie(
+    TfLiteInterpreterPool* pool, const Packet& model, const std::string& key,
+    const TfLiteInterpreterPool::InterpreterFactory& factory) {
+  auto interpreter_or = pool->Acquire(model, key, factory);
+  MEDIAPIPE_CHECK_OK(interpreter_or.status());
+  return std::move(interpreter_or.ValueOrDie());
+}
+
+TEST(TfLiteInterpreterPoolTest, ShareModel) {
+  auto pool = TfLiteInterpreterPool::Create({});
+  Packet model1 = LoadModel();
+  Packet model2 = LoadModel();
+  EXPECT_EQ(TfLiteInterpreterPool::ModelKey(
+                *model1.Get<TfLiteInterpreterPool::TfLiteModelPtr>()),
+            TfLiteInterpreterPool::ModelKey(
+                *model2.Get<TfLiteInterpreterPool::TfLiteModelPtr>()));
+  Packet shared1 = pool->ShareModel(model1);
+  Packet shared2 = pool->ShareModel(model2);
+  EXPECT_EQ(&shared1.Get<TfLiteInterpreterPool::TfLiteModelPtr>(),
+            &model1.Get<TfLiteInterpreterPool::TfLiteModelPtr>());
+  EXPECT_EQ(&shared2.Get<TfLiteInterpreterPool::TfLiteModelPtr>(),
+            &model1.Get<TfLiteInterpreterPool::TfLiteModelPtr>());
+}
+
+TEST(TfLiteInterpreterPoolTest, ReusesIdleInterpreters) {
+  TfLiteInterpreterPool::Options options;
+  options.max_idle_interpreters = 1;
+  auto pool = TfLiteInterpreterPool::Create(options);
+  Packet model = LoadModel();
+  const std::string key = TfLiteInterpreterPool::ModelKey(
+      *model.Get<TfLiteInterpreterPool::TfLiteModelPtr>());
+
+  auto interpreter1 = AcquireOrDie(pool.get(), model, key, &BuildInterpreter);
+  auto interpreter2 = AcquireOrDie(pool.get(), model, key, &BuildInterpreter);
+  EXPECT_NE(interpreter1.get(), interpreter2.get());
+  EXPECT_EQ(pool->interpreters_built(), 2);
+
+  // Only one idle interpreter is kept.
+  tflite::Interpreter* idle = interpreter1.get();
+  interpreter1 = nullptr;
+  interpreter2 = nullptr;
+  interpreter1 = AcquireOrDie(pool.get(), model, key, &BuildInterpreter);
+  EXPECT_EQ(interpreter1.get(), idle);
+  interpreter2 = AcquireOrDie(pool.get(), model, key, &BuildInterpreter);
+  EXPECT_EQ(pool->interpreters_built(), 3);
+
+  // Interpreters are not shared across keys.
+  auto interpreter3 =
+      AcquireOrDie(pool.get(), model, key + "/other", &BuildInterpreter);
+  EXPECT_EQ(pool->interpreters_built(), 4);
+}
+
+TEST(TfLiteInterpreterPoolTest, InterpreterOutlivesPoolAndModel) {
+  auto pool = TfLiteInterpreterPool::Create({});
+  Packet model = LoadModel();
+  const std::string key = TfLiteInterpreterPool::ModelKey(
+      *model.Get<TfLiteInterpreterPool::TfLiteModelPtr>());
+  auto interpreter = AcquireOrDie(pool.get(), model, key, &BuildInterpreter);
+  pool = nullptr;
+  model = Packet();
+  EXPECT_EQ(interpreter->Invoke(), kTfLiteOk);
+}
+
+TEST(TfLiteInterpreterPoolTest, SharedXnnpackDelegate) {
+  TfLiteInterpreterPool::Options options;
+  options.xnnpack_num_threads = 2;
+  auto pool = TfLiteInterpreterPool::Create(options);
+  Packet model = LoadModel();
+  const std::string key = TfLiteInterpreterPool::ModelKey(
+      *model.Get<TfLiteInterpreterPool::TfLiteModelPtr>());
+  auto factory = [&pool](const tflite::FlatBufferModel& model)
+      -> ::mediapipe::StatusOr<std::unique_ptr<tflite::Interpreter>> {
+    ASSIGN_OR_RETURN(auto interpreter, BuildInterpreter(model));
+    RET_CHECK_EQ(interpreter->ModifyGraphWithDelegate(pool->XnnpackDelegate()),
+                 kTfLiteOk);
+    return interpreter;
+  };
+  auto interpreter1 = AcquireOrDie(pool.get(), model, key, factory);
+  auto interpreter2 = AcquireOrDie(pool.get(), model, key, factory);
+  EXPECT_EQ(interpreter1->Invoke(), kTfLiteOk);
+  EXPECT_EQ(interpreter2->Invoke(), kTfLiteOk);
+}
+
+}  // namespace
+}  // namespace mediapipe
@@ -0,0 +1,226 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/tracking/binary_descriptor_index.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <random>
+
+#include "mediapipe/framework/port/logging.h"
+
+// Popcounts of 64 bit words compile to a single instruction where the target
+// has one (e.g. -mpopcnt or -msse4.2 on x86). Otherwise, 16 bytes are counted
+// at once with a nibble lookup table on SSSE3, or with vcnt on NEON.
+#if defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define MEDIAPIPE_BINARY_DESCRIPTOR_INDEX_NEON 1
+#elif defined(__SSSE3__) && !defined(__POPCNT__)
+#include <tmmintrin.h>
+#define MEDIAPIPE_BINARY_DESCRIPTOR_INDEX_SSSE3 1
+#endif
+
+namespace mediapipe {
+
+namespace {
+
+inline int Popcount(uint64 word) { return __builtin_popcountll(word); }
+
+}  // namespace
+
+BinaryDescriptorIndex::BinaryDescriptorIndex(int descriptor_bytes,
+                                             const Options& options)
+    : descriptor_bytes_(descriptor_bytes),
+      num_words_((descriptor_bytes + 7) / 8),
+      options_(options),
+      tables_(options.num_hash_tables),
+      query_words_(num_words_) {
+  CHECK_GT(descriptor_bytes_, 0);
+  CHECK_GT(options_.num_hash_tables, 0);
+  CHECK_GT(options_.hash_key_bits, 0);
+  CHECK_LE(options_.hash_key_bits, 32);
+  const int descriptor_bits = descriptor_bytes_ * 8;
+  CHECK_LE(options_.hash_key_bits, descriptor_bits);
+
+  // Each table samples distinct bits, but tables may share bits.
+  std::mt19937 random(options_.seed);
+  std::vector<int> bits(descriptor_bits);
+  std::iota(bits.begin(), bits.end(), 0);
+  key_bit_positions_.reserve(options_.num_hash_tables *
+                             options_.hash_key_bits);
+  for (int t = 0; t < options_.num_hash_tables; ++t) {
+    for (int b = 0; b < options_.hash_key_bits; ++b) {
+      std::uniform_int_distribution<int> pick(b, descriptor_bits - 1);
+      std::swap(bits[b], bits[pick(random)]);
+      key_bit_positions_.push_back(bits[b]);
+    }
+  }
+}
+
+int BinaryDescriptorIndex::Add(const uint8* descriptor) {
+  const int id = num_descriptors_++;
+  descriptors_.resize(descriptors_.size() + num_words_);
+  uint64* words = &descriptors_[id * num_words_];
+  ToWords(descriptor, words);
+  for (int t = 0; t < tables_.size(); ++t) {
+    tables_[t][HashKey(words, t)].push_back(id);
+  }
+  visited_.push_back(0);
+  return id;
+}
+
+void BinaryDescriptorIndex::Clear() {
+  for (auto& table : tables_) {
+    table.clear();
+  }
+  num_descriptors_ = 0;
+  descriptors_.clear();
+  visited_.clear();
+  visit_stamp_ = 0;
+}
+
+void BinaryDescriptorIndex::Search(const uint8* query, int max_distance,
+                                   std::vector<Neighbor>* neighbors) {
+  CHECK(neighbors);
+  neighbors->clear();
+  if (num_descriptors_ == 0) {
+    return;
+  }
+
+  if (++visit_stamp_ == 0) {
+    // The stamp wrapped around, so older stamps would match again.
+    std::fill(visited_.begin(), visited_.end(), 0);
+    visit_stamp_ = 1;
+  }
+
+  ToWords(query, query_words_.data());
+  auto search_bucket = [this, max_distance, neighbors](
+                           const absl::flat_hash_map<uint32, std::vector<int>>&
+                               table,
+                           uint32 key) {
+    const auto bucket = table.find(key);
+    if (bucket == table.end()) {
+      return;
+    }
+    for (const int id : bucket->second) {
+      if (visited_[id] == visit_stamp_) {
+        continue;
+      }
+      visited_[id] = visit_stamp_;
+      const int distance =
+          WordsDistance(query_words_.data(), &descriptors_[id * num_words_]);
+      if (distance <= max_distance) {
+        neighbors->push_back({id, distance});
+      }
+    }
+  };
+
+  for (int t = 0; t < tables_.size(); ++t) {
+    const uint32 key = HashKey(query_words_.data(), t);
+    search_bucket(tables_[t], key);
+    if (options_.multi_probe) {
+      for (int b = 0; b < options_.hash_key_bits; ++b) {
+        search_bucket(tables_[t], key ^ (1u << b));
+      }
+    }
+  }
+}
+
+void BinaryDescriptorIndex::SearchExhaustive(
+    const uint8* query, int max_distance,
+    std::vector<Neighbor>* neighbors) const {
+  CHECK(neighbors);
+  neighbors->clear();
+  std::vector<uint64> query_words(num_words_);
+  ToWords(query, query_words.data());
+  for (int id = 0; id < num_descriptors_; ++id) {
+    const int distance =
+        WordsDistance(query_words.data(), &descriptors_[id * num_words_]);
+    if (distance <= max_distance) {
+      neighbors->push_back({id, distance});
+    }
+  }
+}
+
+int BinaryDescriptorIndex::HammingDistance(const uint8* a, const uint8* b,
+                                           int num_bytes) {
+  int distance = 0;
+  int i = 0;
+  for (; i + 8 <= num_bytes; i += 8) {
+    uint64 word_a, word_b;
+    memcpy(&word_a, a + i, 8);
+    memcpy(&word_b, b + i, 8);
+    distance += Popcount(word_a ^ word_b);
+  }
+  for (; i < num_bytes; ++i) {
+    distance += Popcount(a[i] ^ b[i]);
+  }
+  return distance;
+}
+
+void BinaryDescriptorIndex::ToWords(const uint8* descriptor,
+                                    uint64* words) const {
+  words[num_words_ - 1] = 0;
+  memcpy(words, descriptor, descriptor_bytes_);
+}
+
+uint32 BinaryDescriptorIndex::HashKey(const uint64* words, int table) const {
+  const int* positions = &key_bit_positions_[table * options_.hash_key_bits];
+  uint32 key = 0;
+  for (int b = 0; b < options_.hash_key_bits; ++b) {
+    const int position = positions[b];
+    key |= static_cast<uint32>((words[position >> 6] >> (position & 63)) & 1)
+           << b;
+  }
+  return key;
+}
+
+int BinaryDescriptorIndex::WordsDistance(const uint64* a,
+                                         const uint64* b) const {
+  int distance = 0;
+  int w = 0;
+#if defined(MEDIAPIPE_BINARY_DESCRIPTOR_INDEX_NEON)
+  for (; w + 2 <= num_words_; w += 2) {
+    const uint8x16_t diff =
+        veorq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(a + w)),
+                 vld1q_u8(reinterpret_cast<const uint8_t*>(b + w)));
+    // At most 128 bits are set, so the byte sum does not overflow.
+    distance += vaddvq_u8(vcntq_u8(diff));
+  }
+#elif defined(MEDIAPIPE_BINARY_DESCRIPTOR_INDEX_SSSE3)
+  const __m128i nibble_counts =
+      _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m128i low_nibbles = _mm_set1_epi8(0x0f);
+  __m128i sums = _mm_setzero_si128();
+  for (; w + 2 <= num_words_; w += 2) {
+    const __m128i diff = _mm_xor_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + w)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + w)));
+    const __m128i counts = _mm_add_epi8(
+        _mm_shuffle_epi8(nibble_counts, _mm_and_si128(diff, low_nibbles)),
+        _mm_shuffle_epi8(nibble_counts,
+                         _mm_and_si128(_mm_srli_epi16(diff, 4), low_nibbles)));
+    sums = _mm_add_epi64(sums, _mm_sad_epu8(counts, _mm_setzero_si128()));
+  }
+  distance += _mm_cvtsi128_si32(sums) +
+              _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums));
+#endif
+  for (; w < num_words_; ++w) {
+    distance += Popcount(a[w] ^ b[w]);
+  }
+  return distance;
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,126 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_UTIL_TRACKING_BINARY_DESCRIPTOR_INDEX_H_
+#define MEDIAPIPE_UTIL_TRACKING_BINARY_DESCRIPTOR_INDEX_H_
+
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+// Approximate nearest neighbor index over binary feature descriptors of a
+// fixed size (e.g. 32 byte ORB descriptors) under the Hamming distance.
+//
+// Uses locality-sensitive hashing by bit sampling: each hash table keys the
+// descriptors by a fixed random subset of their bits, so that descriptors
+// within a small Hamming distance likely share a bucket in at least one
+// table. With multi-probe enabled, the buckets whose key differs from the
+// query key by one bit are also searched, which raises recall for the same
+// number of tables. Only the descriptors found in the probed buckets are
+// compared with the query, so the search cost grows with the bucket sizes
+// instead of the number of indexed descriptors.
+//
+// This class is not thread-safe.
+class BinaryDescriptorIndex {
+ public:
+  struct Options {
+    // Number of hash tables. More tables raise recall, memory and search
+    // cost.
+    int num_hash_tables = 8;
+    // Number of descriptor bits sampled into each hash key, at most 32.
+    // Fewer bits raise recall and the number of compared descriptors.
+    int hash_key_bits = 16;
+    // Whether to also probe the buckets whose key differs by one bit.
+    bool multi_probe = true;
+    // Seed for sampling the key bits. Indexes built with the same seed and
+    // sizes hash descriptors identically.
+    uint32 seed = 0x9e3779b9;
+  };
+
+  struct Neighbor {
+    // Id of the indexed descriptor, as returned by Add().
+    int id;
+    // Hamming distance to the query descriptor.
+    int distance;
+  };
+
+  // Creates an index of descriptors of `descriptor_bytes` bytes.
+  BinaryDescriptorIndex(int descriptor_bytes, const Options& options);
+
+  BinaryDescriptorIndex(const BinaryDescriptorIndex&) = delete;
+  BinaryDescriptorIndex& operator=(const BinaryDescriptorIndex&) = delete;
+
+  int descriptor_bytes() const { return descriptor_bytes_; }
+
+  // Returns the number of indexed descriptors.
+  int size() const { return num_descriptors_; }
+
+  // Adds `descriptor` of descriptor_bytes() bytes to the index and returns
+  // its id. Ids are assigned consecutively from 0.
+  int Add(const uint8* descriptor);
+
+  // Removes all descriptors. Ids are assigned from 0 again.
+  void Clear();
+
+  // Returns in `neighbors` the indexed descriptors found in the buckets of
+  // `query` within `max_distance`, each one once, in no particular order.
+  void Search(const uint8* query, int max_distance,
+              std::vector<Neighbor>* neighbors);
+
+  // Same as Search(), but compares `query` with every indexed descriptor, so
+  // it returns all the descriptors within `max_distance`.
+  void SearchExhaustive(const uint8* query, int max_distance,
+                        std::vector<Neighbor>* neighbors) const;
+
+  // Returns the Hamming distance between the binary strings `a` and `b` of
+  // `num_bytes` bytes.
+  static int HammingDistance(const uint8* a, const uint8* b, int num_bytes);
+
+ private:
+  // Copies `descriptor` into `words`, zero-padded to num_words_ words.
+  void ToWords(const uint8* descriptor, uint64* words) const;
+
+  // Returns the key of the descriptor `words` in hash table `table`.
+  uint32 HashKey(const uint64* words, int table) const;
+
+  // Returns the Hamming distance between two padded descriptors.
+  int WordsDistance(const uint64* a, const uint64* b) const;
+
+  const int descriptor_bytes_;
+  // Number of 64 bit words holding a descriptor.
+  const int num_words_;
+  const Options options_;
+
+  // Bit positions sampled into the keys, hash_key_bits per table.
+  std::vector<int> key_bit_positions_;
+  // For each table, the ids of the descriptors in each bucket.
+  std::vector<absl::flat_hash_map<uint32, std::vector<int>>> tables_;
+
+  int num_descriptors_ = 0;
+  // The indexed descriptors, num_words_ words each, in id order.
+  std::vector<uint64> descriptors_;
+
+  // Scratch state of Search(). A descriptor has been compared with the
+  // current query iff its entry in visited_ equals visit_stamp_.
+  std::vector<uint32> visited_;
+  uint32 visit_stamp_ = 0;
+  std::vector<uint64> query_words_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_TRACKING_BINARY_DESCRIPTOR_INDEX_H_
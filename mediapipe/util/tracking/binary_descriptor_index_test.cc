@@ -0,0 +1,221 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/tracking/binary_descriptor_index.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+namespace {
+
+// Size of ORB descriptors.
+constexpr int kDescriptorBytes = 32;
+
+using Neighbor = BinaryDescriptorIndex::Neighbor;
+
+// Returns `num_descriptors` random descriptors of `num_bytes` bytes each,
+// concatenated.
+std::vector<uint8> RandomDescriptors(int num_descriptors, int num_bytes,
+                                     std::mt19937* random) {
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::vector<uint8> descriptors(num_descriptors * num_bytes);
+  for (auto& value : descriptors) {
+    value = byte(*random);
+  }
+  return descriptors;
+}
+
+// Returns a copy of `descriptor` with `num_flips` distinct bits flipped.
+std::vector<uint8> FlipBits(const uint8* descriptor, int num_flips,
+                            std::mt19937* random) {
+  std::vector<uint8> flipped(descriptor, descriptor + kDescriptorBytes);
+  std::vector<int> bits(kDescriptorBytes * 8);
+  for (int b = 0; b < bits.size(); ++b) bits[b] = b;
+  std::shuffle(bits.begin(), bits.end(), *random);
+  for (int f = 0; f < num_flips; ++f) {
+    flipped[bits[f] / 8] ^= 1 << (bits[f] % 8);
+  }
+  return flipped;
+}
+
+// Returns the id of the nearest neighbor, or -1 if there is none.
+int Nearest(const std::vector<Neighbor>& neighbors) {
+  int nearest = -1;
+  int nearest_distance = 0;
+  for (const Neighbor& neighbor : neighbors) {
+    if (nearest < 0 || neighbor.distance < nearest_distance) {
+      nearest = neighbor.id;
+      nearest_distance = neighbor.distance;
+    }
+  }
+  return nearest;
+}
+
+TEST(BinaryDescriptorIndexTest, HammingDistance) {
+  std::mt19937 random(1);
+  for (int num_bytes = 1; num_bytes <= 40; ++num_bytes) {
+    std::vector<uint8> a = RandomDescriptors(1, num_bytes, &random);
+    std::vector<uint8> b = RandomDescriptors(1, num_bytes, &random);
+    int expected = 0;
+    for (int i = 0; i < num_bytes; ++i) {
+      for (int bit = 0; bit < 8; ++bit) {
+        expected += ((a[i] ^ b[i]) >> bit) & 1;
+      }
+    }
+    EXPECT_EQ(expected, BinaryDescriptorIndex::HammingDistance(
+                            a.data(), b.data(), num_bytes));
+
+    // The index computes the same distances on its padded descriptors.
+    BinaryDescriptorIndex::Options options;
+    options.hash_key_bits = 8;
+    BinaryDescriptorIndex index(num_bytes, options);
+    index.Add(a.data());
+    std::vector<Neighbor> neighbors;
+    index.SearchExhaustive(b.data(), num_bytes * 8, &neighbors);
+    ASSERT_EQ(1, neighbors.size());
+    EXPECT_EQ(expected, neighbors[0].distance);
+  }
+}
+
+TEST(BinaryDescriptorIndexTest, FindsIndexedDescriptors) {
+  std::mt19937 random(2);
+  constexpr int kNumDescriptors = 1000;
+  std::vector<uint8> descriptors =
+      RandomDescriptors(kNumDescriptors, kDescriptorBytes, &random);
+  BinaryDescriptorIndex index(kDescriptorBytes, {});
+  for (int i = 0; i < kNumDescriptors; ++i) {
+    EXPECT_EQ(i, index.Add(&descriptors[i * kDescriptorBytes]));
+  }
+  EXPECT_EQ(kNumDescriptors, index.size());
+
+  std::vector<Neighbor> neighbors;
+  for (int i = 0; i < kNumDescriptors; ++i) {
+    index.Search(&descriptors[i * kDescriptorBytes], 0, &neighbors);
+    ASSERT_EQ(1, neighbors.size());
+    EXPECT_EQ(i, neighbors[0].id);
+    EXPECT_EQ(0, neighbors[0].distance);
+  }
+
+  index.Clear();
+  EXPECT_EQ(0, index.size());
+  index.Search(&descriptors[0], kDescriptorBytes * 8, &neighbors);
+  EXPECT_TRUE(neighbors.empty());
+  EXPECT_EQ(0, index.Add(&descriptors[kDescriptorBytes]));
+}
+
+// Search() returns a subset of the exhaustive search, each descriptor once,
+// and finds most nearest neighbors.
+TEST(BinaryDescriptorIndexTest, SearchRecall) {
+  std::mt19937 random(3);
+  constexpr int kNumDescriptors = 10000;
+  constexpr int kNumQueries = 1000;
+  constexpr int kNumFlips = 24;
+  constexpr int kMaxDistance = 64;
+  std::vector<uint8> descriptors =
+      RandomDescriptors(kNumDescriptors, kDescriptorBytes, &random);
+  BinaryDescriptorIndex index(kDescriptorBytes, {});
+  for (int i = 0; i < kNumDescriptors; ++i) {
+    index.Add(&descriptors[i * kDescriptorBytes]);
+  }
+
+  int num_found = 0;
+  std::vector<Neighbor> neighbors;
+  std::vector<Neighbor> exhaustive_neighbors;
+  for (int q = 0; q < kNumQueries; ++q) {
+    const int source = q * kNumDescriptors / kNumQueries;
+    std::vector<uint8> query =
+        FlipBits(&descriptors[source * kDescriptorBytes], kNumFlips, &random);
+    index.Search(query.data(), kMaxDistance, &neighbors);
+    index.SearchExhaustive(query.data(), kMaxDistance, &exhaustive_neighbors);
+
+    std::vector<int> ids;
+    for (const Neighbor& neighbor : neighbors) {
+      EXPECT_EQ(BinaryDescriptorIndex::HammingDistance(
+                    query.data(), &descriptors[neighbor.id * kDescriptorBytes],
+                    kDescriptorBytes),
+                neighbor.distance);
+      EXPECT_LE(neighbor.distance, kMaxDistance);
+      ids.push_back(neighbor.id);
+    }
+    std::sort(ids.begin(), ids.end());
+    EXPECT_TRUE(std::adjacent_find(ids.begin(), ids.end()) == ids.end());
+    EXPECT_LE(neighbors.size(), exhaustive_neighbors.size());
+
+    ASSERT_EQ(source, Nearest(exhaustive_neighbors));
+    if (Nearest(neighbors) == source) {
+      ++num_found;
+    }
+  }
+  EXPECT_GE(num_found, kNumQueries * 95 / 100);
+}
+
+// Measures the search of descriptors 24 bits away from an indexed one, as
+// brute force matching does, and with the index.
+void BM_SearchExhaustive(benchmark::State& state) {
+  std::mt19937 random(4);
+  const int num_descriptors = state.range(0);
+  std::vector<uint8> descriptors =
+      RandomDescriptors(num_descriptors, kDescriptorBytes, &random);
+  BinaryDescriptorIndex index(kDescriptorBytes, {});
+  for (int i = 0; i < num_descriptors; ++i) {
+    index.Add(&descriptors[i * kDescriptorBytes]);
+  }
+  std::vector<uint8> query = FlipBits(&descriptors[0], 24, &random);
+  std::vector<Neighbor> neighbors;
+  for (auto _ : state) {
+    index.SearchExhaustive(query.data(), 64, &neighbors);
+    benchmark::DoNotOptimize(neighbors.data());
+  }
+}
+BENCHMARK(BM_SearchExhaustive)->Arg(1000)->Arg(100000);
+
+void BM_Search(benchmark::State& state) {
+  std::mt19937 random(4);
+  const int num_descriptors = state.range(0);
+  std::vector<uint8> descriptors =
+      RandomDescriptors(num_descriptors, kDescriptorBytes, &random);
+  BinaryDescriptorIndex index(kDescriptorBytes, {});
+  for (int i = 0; i < num_descriptors; ++i) {
+    index.Add(&descriptors[i * kDescriptorBytes]);
+  }
+  constexpr int kNumQueries = 256;
+  std::vector<std::vector<uint8>> queries;
+  std::vector<int> sources;
+  for (int q = 0; q < kNumQueries; ++q) {
+    sources.push_back(q * num_descriptors / kNumQueries);
+    queries.push_back(
+        FlipBits(&descriptors[sources.back() * kDescriptorBytes], 24, &random));
+  }
+  std::vector<Neighbor> neighbors;
+  int q = 0;
+  int num_found = 0;
+  int num_searches = 0;
+  for (auto _ : state) {
+    index.Search(queries[q].data(), 64, &neighbors);
+    num_found += Nearest(neighbors) == sources[q];
+    ++num_searches;
+    q = (q + 1) % kNumQueries;
+  }
+  state.counters["recall"] = static_cast<double>(num_found) / num_searches;
+}
+BENCHMARK(BM_Search)->Arg(1000)->Arg(100000);
+
+}  // namespace
+}  // namespace mediapipe
@@ -14,12 +14,15 @@
 
 #include "mediapipe/util/tracking/box_detector.h"
 
+#include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
 #include "mediapipe/framework/port/opencv_calib3d_inc.h"
 #include "mediapipe/framework/port/opencv_imgproc_inc.h"
 #include "mediapipe/framework/port/opencv_video_inc.h"
+#include "mediapipe/util/tracking/binary_descriptor_index.h"
 #include "mediapipe/util/tracking/box_detector.pb.h"
 #include "mediapipe/util/tracking/box_tracker.h"
 #include "mediapipe/util/tracking/measure_time.h"
@@ -92,10 +95,44 @@ class BoxDetectorOpencvBfImpl : public BoxDetectorInterface {
   cv::BFMatcher bf_matcher_;
 };
 
+// Using multi-probe locality-sensitive hashing over the binary descriptors of
+// all the boxes, so that each frame feature is only compared with the indexed
+// features sharing a hash bucket with it. Matches are cross validated like in
+// BoxDetectorOpencvBfImpl.
+class BoxDetectorLshImpl : public BoxDetectorInterface {
+ public:
+  explicit BoxDetectorLshImpl(const BoxDetectorOptions &options);
+
+ private:
+  std::vector<FeatureCorrespondence> MatchFeatureDescriptors(
+      const std::vector<Vector2_f> &features, const cv::Mat &descriptors,
+      int box_idx) override;
+
+  std::vector<std::vector<FeatureCorrespondence>>
+  MatchFeatureDescriptorsForBoxes(const std::vector<Vector2_f> &features,
+                                  const cv::Mat &descriptors,
+                                  const std::vector<int> &box_indices) override;
+
+  void OnBoxRemovedFromIndex(int box_idx) override;
+
+  // Adds to descriptor_index_ the features added to the boxes since the last
+  // call.
+  void UpdateDescriptorIndex();
+
+  std::unique_ptr<BinaryDescriptorIndex> descriptor_index_;
+  // Box index and feature index within the box of each feature in
+  // descriptor_index_, by descriptor id.
+  std::vector<std::pair<int, int>> indexed_features_;
+  // Number of features of each box in descriptor_index_.
+  std::vector<int> num_indexed_features_;
+};
+
 std::unique_ptr<BoxDetectorInterface> BoxDetectorInterface::Create(
     const BoxDetectorOptions &options) {
   if (options.index_type() == BoxDetectorOptions::OPENCV_BF) {
     return absl::make_unique<BoxDetectorOpencvBfImpl>(options);
+  } else if (options.index_type() == BoxDetectorOptions::LSH_HAMMING) {
+    return absl::make_unique<BoxDetectorLshImpl>(options);
   } else {
     LOG(FATAL) << "index type undefined.";
   }
@@ -153,12 +190,24 @@ void BoxDetectorInterface::DetectAndAddBoxFromFeatures(
     }
   }
 
+  std::vector<int> detect_box_indices;
   for (int idx = 0; idx < size_before_add; ++idx) {
     if ((options_.has_detect_every_n_frame() > 0 &&
          cnt_detect_called_ % options_.detect_every_n_frame() == 0) ||
         !tracked[idx] ||
         (options_.detect_out_of_fov() && has_been_out_of_fov_[idx])) {
-      TimedBoxProtoList det = DetectBox(features, descriptors, idx);
+      detect_box_indices.push_back(idx);
+    }
+  }
+
+  if (!detect_box_indices.empty()) {
+    const std::vector<std::vector<FeatureCorrespondence>> matches =
+        MatchFeatureDescriptorsForBoxes(features, descriptors,
+                                        detect_box_indices);
+    for (int k = 0; k < detect_box_indices.size(); ++k) {
+      const int idx = detect_box_indices[k];
+      TimedBoxProtoList det =
+          FindBoxesFromFeatureCorrespondence(matches[k], idx);
       if (det.box_size() > 0) {
         det.mutable_box(0)->set_time_msec(timestamp_msec);
 
@@ -261,8 +310,6 @@ void BoxDetectorInterface::DetectAndAddBox(
     return;
   }
 
-  const auto &image_query_settings = options_.image_query_settings();
-
   cv::Mat grayscale;
   if (image.channels() == 3) {
     cv::cvtColor(image, grayscale, cv::COLOR_BGR2GRAY);
@@ -272,49 +319,57 @@ void BoxDetectorInterface::DetectAndAddBox(
     grayscale = image;
   }
 
-  cv::Mat resize_image;
-  const int longer_edge = std::max(grayscale.cols, grayscale.rows);
-  const float longer_edge_scaled = image_query_settings.pyramid_bottom_size();
-  if (longer_edge <= longer_edge_scaled) {
-    resize_image = grayscale;
-  } else {
-    float resize_scale = longer_edge_scaled / longer_edge;
-    cv::resize(
-        grayscale, resize_image,
-        cv::Size(resize_scale * grayscale.cols, resize_scale * grayscale.rows),
-        cv::INTER_AREA);
-  }
+  DetectAndAddBoxFromFrame(FrameAnalysis(grayscale), tracked_boxes,
+                           timestamp_msec, detected_boxes);
+}
 
-  // Use cv::ORB feature extractor for now since it provides better quality of
-  // detection results compared with manually constructing pyramid and then use
-  // OrbFeatureDescriptor.
-  // TODO: Tune OrbFeatureDescriptor to hit similar quality.
-  if (!orb_extractor_) {
-    orb_extractor_ =
-        cv::ORB::create(image_query_settings.max_features(),
-                        image_query_settings.pyramid_scale_factor(),
-                        image_query_settings.max_pyramid_levels());
+void BoxDetectorInterface::DetectAndAddBox(
+    const FrameAnalysis &frame_analysis, const TimedBoxProtoList &tracked_boxes,
+    int64 timestamp_msec, TimedBoxProtoList *detected_boxes) {
+  // Determine if we need execute feature extraction.
+  if (!CheckDetectAndAddBox(tracked_boxes)) {
+    return;
   }
 
-  std::vector<cv::KeyPoint> keypoints;
-  cv::Mat descriptors;
-  orb_extractor_->detect(resize_image, keypoints);
-  orb_extractor_->compute(resize_image, keypoints, descriptors);
+  DetectAndAddBoxFromFrame(frame_analysis, tracked_boxes, timestamp_msec,
+                           detected_boxes);
+}
 
-  CHECK_EQ(keypoints.size(), descriptors.rows);
+void BoxDetectorInterface::DetectAndAddBoxFromFrame(
+    const FrameAnalysis &frame_analysis, const TimedBoxProtoList &tracked_boxes,
+    int64 timestamp_msec, TimedBoxProtoList *detected_boxes) {
+  const auto &image_query_settings = options_.image_query_settings();
 
-  float inv_scale = 1.0f / std::max(resize_image.cols, resize_image.rows);
+  // Use cv::ORB feature extractor for now since it provides better quality of
+  // detection results compared with manually constructing pyramid and then use
+  // OrbFeatureDescriptor. Features are extracted from the frame downscaled to
+  // pyramid_bottom_size.
+  // TODO: Tune OrbFeatureDescriptor to hit similar quality.
+  FrameAnalysis::OrbSettings orb_settings;
+  orb_settings.max_features = image_query_settings.max_features();
+  orb_settings.scale_factor = image_query_settings.pyramid_scale_factor();
+  orb_settings.num_levels = image_query_settings.max_pyramid_levels();
+  orb_settings.max_size = image_query_settings.pyramid_bottom_size();
+  orb_settings.compute_descriptors = true;
+  const FrameAnalysis::OrbFeatures &orb_features =
+      frame_analysis.Orb(orb_settings);
+  const std::vector<cv::KeyPoint> &keypoints = orb_features.keypoints;
+
+  CHECK_EQ(keypoints.size(), orb_features.descriptors.rows);
+
+  float inv_scale = 1.0f / std::max(orb_features.width, orb_features.height);
   std::vector<Vector2_f> v_keypoints(keypoints.size());
   for (int j = 0; j < keypoints.size(); ++j) {
     v_keypoints[j] =
         Vector2_f(keypoints[j].pt.x * inv_scale, keypoints[j].pt.y * inv_scale);
   }
 
-  float scale_x = resize_image.cols * inv_scale;
-  float scale_y = resize_image.rows * inv_scale;
+  float scale_x = orb_features.width * inv_scale;
+  float scale_y = orb_features.height * inv_scale;
 
-  DetectAndAddBoxFromFeatures(v_keypoints, descriptors, tracked_boxes,
-                              timestamp_msec, scale_x, scale_y, detected_boxes);
+  DetectAndAddBoxFromFeatures(v_keypoints, orb_features.descriptors,
+                              tracked_boxes, timestamp_msec, scale_x, scale_y,
+                              detected_boxes);
 }
 
 TimedBoxProtoList BoxDetectorInterface::DetectBox(
@@ -324,6 +379,18 @@ TimedBoxProtoList BoxDetectorInterface::DetectBox(
       MatchFeatureDescriptors(features, descriptors, box_idx), box_idx);
 }
 
+std::vector<std::vector<FeatureCorrespondence>>
+BoxDetectorInterface::MatchFeatureDescriptorsForBoxes(
+    const std::vector<Vector2_f> &features, const cv::Mat &descriptors,
+    const std::vector<int> &box_indices) {
+  std::vector<std::vector<FeatureCorrespondence>> matches;
+  matches.reserve(box_indices.size());
+  for (const int box_idx : box_indices) {
+    matches.push_back(MatchFeatureDescriptors(features, descriptors, box_idx));
+  }
+  return matches;
+}
+
 TimedBoxProtoList BoxDetectorInterface::FindBoxesFromFeatureCorrespondence(
     const std::vector<FeatureCorrespondence> &matches, int box_idx) {
   int max_corr = -1;
@@ -640,6 +707,7 @@ void BoxDetectorInterface::CancelBoxDetection(int box_id) {
     for (int j = erase_idx; j < box_idx_to_id_.size(); ++j) {
       box_id_to_idx_[box_idx_to_id_[j]] = j;
     }
+    OnBoxRemovedFromIndex(erase_idx);
   }
 }
 
@@ -746,4 +814,153 @@ BoxDetectorOpencvBfImpl::MatchFeatureDescriptors(
   return correspondence_result;
 }
 
+BoxDetectorLshImpl::BoxDetectorLshImpl(const BoxDetectorOptions &options)
+    : BoxDetectorInterface(options) {}
+
+std::vector<FeatureCorrespondence> BoxDetectorLshImpl::MatchFeatureDescriptors(
+    const std::vector<Vector2_f> &features, const cv::Mat &descriptors,
+    int box_idx) {
+  return std::move(
+      MatchFeatureDescriptorsForBoxes(features, descriptors, {box_idx})[0]);
+}
+
+std::vector<std::vector<FeatureCorrespondence>>
+BoxDetectorLshImpl::MatchFeatureDescriptorsForBoxes(
+    const std::vector<Vector2_f> &features, const cv::Mat &descriptors,
+    const std::vector<int> &box_indices) {
+  CHECK_EQ(features.size(), descriptors.rows);
+
+  const int num_boxes = box_indices.size();
+  std::vector<std::vector<FeatureCorrespondence>> correspondence_result(
+      num_boxes);
+  // Slot of each box in `box_indices`, or -1 for the boxes not matched.
+  std::vector<int> box_slot(frame_box_.size(), -1);
+  for (int slot = 0; slot < num_boxes; ++slot) {
+    correspondence_result[slot].resize(frame_box_[box_indices[slot]].size());
+    box_slot[box_indices[slot]] = slot;
+  }
+  if (features.empty() || descriptors.rows == 0 || descriptors.cols == 0) {
+    return correspondence_result;
+  }
+
+  UpdateDescriptorIndex();
+  if (!descriptor_index_ || descriptor_index_->size() == 0) {
+    return correspondence_result;
+  }
+  CHECK_EQ(descriptors.cols, descriptor_index_->descriptor_bytes())
+      << "Frame and index descriptors differ in size.";
+
+  // Binary descriptors may be passed as floats holding the byte values.
+  cv::Mat frame_descriptors;
+  if (descriptors.type() == CV_8U) {
+    frame_descriptors = descriptors;
+  } else {
+    descriptors.convertTo(frame_descriptors, CV_8U);
+  }
+
+  struct Match {
+    int frame_feature;
+    int indexed_feature;
+    int distance;
+  };
+  // Best match of each frame feature within each box.
+  std::vector<Match> matches;
+  // Best match of each indexed feature among the frame features, for cross
+  // validation.
+  absl::flat_hash_map<int, Match> best_match_of_indexed_feature;
+  // Position in `matches` of the current frame feature's match in each slot.
+  std::vector<int> slot_match(num_boxes, -1);
+  std::vector<int> matched_slots;
+
+  const int max_distance =
+      options_.lsh_index_settings().max_hamming_distance();
+  std::vector<BinaryDescriptorIndex::Neighbor> neighbors;
+  for (int j = 0; j < frame_descriptors.rows; ++j) {
+    descriptor_index_->Search(frame_descriptors.ptr<uint8>(j), max_distance,
+                              &neighbors);
+    for (const auto &neighbor : neighbors) {
+      const int slot = box_slot[indexed_features_[neighbor.id].first];
+      if (slot < 0) continue;
+      const Match match = {j, neighbor.id, neighbor.distance};
+      auto best = best_match_of_indexed_feature.emplace(neighbor.id, match);
+      if (!best.second && match.distance < best.first->second.distance) {
+        best.first->second = match;
+      }
+      if (slot_match[slot] < 0) {
+        slot_match[slot] = matches.size();
+        matches.push_back(match);
+        matched_slots.push_back(slot);
+      } else if (match.distance < matches[slot_match[slot]].distance) {
+        matches[slot_match[slot]] = match;
+      }
+    }
+
+    for (const int slot : matched_slots) {
+      slot_match[slot] = -1;
+    }
+    matched_slots.clear();
+  }
+
+  for (const Match &match : matches) {
+    if (best_match_of_indexed_feature.at(match.indexed_feature)
+            .frame_feature != match.frame_feature) {
+      continue;
+    }
+
+    const int box_idx = indexed_features_[match.indexed_feature].first;
+    const int feature_idx = indexed_features_[match.indexed_feature].second;
+    const int frame_idx = feature_to_frame_[box_idx][feature_idx];
+    FeatureCorrespondence &correspondence =
+        correspondence_result[box_slot[box_idx]][frame_idx];
+    correspondence.points_frame.push_back(
+        cv::Point2f(features[match.frame_feature].x(),
+                    features[match.frame_feature].y()));
+    correspondence.points_index.push_back(
+        cv::Point2f(feature_keypoints_[box_idx][feature_idx].x(),
+                    feature_keypoints_[box_idx][feature_idx].y()));
+  }
+
+  return correspondence_result;
+}
+
+void BoxDetectorLshImpl::OnBoxRemovedFromIndex(int box_idx) {
+  // The features of the following boxes changed indices, so the search
+  // structure is rebuilt on the next match.
+  descriptor_index_.reset();
+  indexed_features_.clear();
+  num_indexed_features_.clear();
+}
+
+void BoxDetectorLshImpl::UpdateDescriptorIndex() {
+  // Features are only ever appended to the boxes, or appended as new boxes.
+  num_indexed_features_.resize(feature_descriptors_.size(), 0);
+  for (int box_idx = 0; box_idx < feature_descriptors_.size(); ++box_idx) {
+    const cv::Mat &box_descriptors = feature_descriptors_[box_idx];
+    const int num_indexed = num_indexed_features_[box_idx];
+    if (box_descriptors.rows == num_indexed) continue;
+
+    if (!descriptor_index_) {
+      const auto &settings = options_.lsh_index_settings();
+      BinaryDescriptorIndex::Options index_options;
+      index_options.num_hash_tables = settings.num_hash_tables();
+      index_options.hash_key_bits = settings.hash_key_bits();
+      index_options.multi_probe = settings.multi_probe();
+      descriptor_index_ = absl::make_unique<BinaryDescriptorIndex>(
+          box_descriptors.cols, index_options);
+    }
+    CHECK_EQ(box_descriptors.cols, descriptor_index_->descriptor_bytes())
+        << "Indexed descriptors differ in size.";
+
+    // The index stores the byte values of binary descriptors as floats.
+    cv::Mat new_descriptors;
+    box_descriptors.rowRange(num_indexed, box_descriptors.rows)
+        .convertTo(new_descriptors, CV_8U);
+    for (int j = 0; j < new_descriptors.rows; ++j) {
+      descriptor_index_->Add(new_descriptors.ptr<uint8>(j));
+      indexed_features_.emplace_back(box_idx, num_indexed + j);
+    }
+    num_indexed_features_[box_idx] = box_descriptors.rows;
+  }
+}
+
 }  // namespace mediapipe
@@ -22,6 +22,7 @@
 #include "mediapipe/util/tracking/box_detector.pb.h"
 #include "mediapipe/util/tracking/box_tracker.pb.h"
 #include "mediapipe/util/tracking/flow_packager.pb.h"
+#include "mediapipe/util/tracking/frame_analysis.h"
 #include "mediapipe/util/tracking/tracking.h"
 
 namespace mediapipe {
@@ -79,6 +80,12 @@ class BoxDetectorInterface {
                        const TimedBoxProtoList &tracked_boxes,
                        int64 timestamp_msec, TimedBoxProtoList *detected_boxes);
 
+  // Same as above, but obtains the features from `frame_analysis`, so that
+  // they are shared with other users of the same frame.
+  void DetectAndAddBox(const FrameAnalysis &frame_analysis,
+                       const TimedBoxProtoList &tracked_boxes,
+                       int64 timestamp_msec, TimedBoxProtoList *detected_boxes);
+
   // Stops detection of box with `box_id`.
   void CancelBoxDetection(int box_id);
 
@@ -114,6 +121,13 @@ class BoxDetectorInterface {
   // Check if add / detect action will be called based on input `tracked_boxes`.
   bool CheckDetectAndAddBox(const TimedBoxProtoList &tracked_boxes);
 
+  // Extracts ORB features from `frame_analysis` and detects and adds boxes
+  // from them, regardless of CheckDetectAndAddBox.
+  void DetectAndAddBoxFromFrame(const FrameAnalysis &frame_analysis,
+                                const TimedBoxProtoList &tracked_boxes,
+                                int64 timestamp_msec,
+                                TimedBoxProtoList *detected_boxes);
+
   // Returns feature indices that are within the given box. If the box size
   // isn't big enough to cover sufficient features to reacquire the box, this
   // function will try to iteratively enlarge the box size by roughly 5
@@ -136,6 +150,20 @@ class BoxDetectorInterface {
       const std::vector<Vector2_f> &features, const cv::Mat &descriptors,
       int box_idx) = 0;
 
+  // Matches features against each box in `box_indices`, and returns the
+  // correspondences of each box in the same order. The default implementation
+  // calls MatchFeatureDescriptors for each box; index types searching all the
+  // boxes at once override it.
+  virtual std::vector<std::vector<FeatureCorrespondence>>
+  MatchFeatureDescriptorsForBoxes(const std::vector<Vector2_f> &features,
+                                  const cv::Mat &descriptors,
+                                  const std::vector<int> &box_indices);
+
+  // Called after the box with `box_idx` has been removed from the index, and
+  // the following boxes moved down by one index. Implementations keeping
+  // their own search structure over the index update it here.
+  virtual void OnBoxRemovedFromIndex(int box_idx) {}
+
   // Specifies which box the correspondences come from with `box_id`, so that we
   // can figure out the transformation accordingly.
   TimedBoxProtoList FindBoxesFromFeatureCorrespondence(
@@ -152,7 +180,6 @@ class BoxDetectorInterface {
   std::vector<cv::Mat> feature_descriptors_;
   std::vector<bool> has_been_out_of_fov_;
   mutable absl::Mutex access_to_index_;
-  cv::Ptr<cv::ORB> orb_extractor_;
   BoxDetectorOptions options_;
 };
 
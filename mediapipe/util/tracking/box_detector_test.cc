@@ -0,0 +1,200 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/tracking/box_detector.h"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/opencv_core_inc.h"
+#include "mediapipe/util/tracking/box_detector.pb.h"
+#include "mediapipe/util/tracking/box_tracker.pb.h"
+
+namespace mediapipe {
+namespace {
+
+// Number of features per box, and size of their ORB descriptors.
+constexpr int kNumFeatures = 100;
+constexpr int kDescriptorBytes = 32;
+
+// Keypoints and binary descriptors, with the byte values of the descriptors
+// held in floats as in the detector's index.
+struct Features {
+  std::vector<Vector2_f> keypoints;
+  cv::Mat descriptors;
+};
+
+Features RandomFeatures(std::mt19937* random) {
+  std::uniform_real_distribution<float> position(0.1f, 0.9f);
+  std::uniform_int_distribution<int> byte(0, 255);
+  Features features;
+  features.descriptors.create(kNumFeatures, kDescriptorBytes, CV_32F);
+  for (int j = 0; j < kNumFeatures; ++j) {
+    const float x = position(*random);
+    const float y = position(*random);
+    features.keypoints.emplace_back(x, y);
+    for (int i = 0; i < kDescriptorBytes; ++i) {
+      features.descriptors.at<float>(j, i) = byte(*random);
+    }
+  }
+  return features;
+}
+
+// Returns an index with one appearance of each box in `boxes`, covering the
+// whole frame, with the box's position in `boxes` as id.
+BoxDetectorIndex MakeIndex(const std::vector<Features>& boxes) {
+  BoxDetectorIndex index;
+  for (int b = 0; b < boxes.size(); ++b) {
+    auto* frame_entry = index.add_box_entry()->add_frame_entry();
+    TimedBoxProto* box = frame_entry->mutable_box();
+    box->set_id(b);
+    box->set_left(0.0f);
+    box->set_top(0.0f);
+    box->set_right(1.0f);
+    box->set_bottom(1.0f);
+    box->set_reacquisition(true);
+    for (int j = 0; j < kNumFeatures; ++j) {
+      frame_entry->add_keypoints(boxes[b].keypoints[j].x());
+      frame_entry->add_keypoints(boxes[b].keypoints[j].y());
+      frame_entry->add_descriptors()->set_data(
+          static_cast<const void*>(boxes[b].descriptors.ptr<float>(j)),
+          kDescriptorBytes * sizeof(float));
+    }
+  }
+  return index;
+}
+
+// Returns the features of a frame showing `box`, with `num_flipped_bits` bits
+// of each descriptor flipped, among as many random features.
+Features FrameFeatures(const Features& box, int num_flipped_bits,
+                       std::mt19937* random) {
+  Features frame = box;
+  frame.descriptors = box.descriptors.clone();
+  std::uniform_int_distribution<int> bit(0, kDescriptorBytes * 8 - 1);
+  for (int j = 0; j < frame.descriptors.rows; ++j) {
+    for (int f = 0; f < num_flipped_bits; ++f) {
+      const int b = bit(*random);
+      float& value = frame.descriptors.at<float>(j, b / 8);
+      value = static_cast<int>(value) ^ (1 << (b % 8));
+    }
+  }
+  Features others = RandomFeatures(random);
+  frame.keypoints.insert(frame.keypoints.end(), others.keypoints.begin(),
+                         others.keypoints.end());
+  cv::vconcat(frame.descriptors, others.descriptors, frame.descriptors);
+  return frame;
+}
+
+// Detects the indexed boxes in a frame, none of them being tracked.
+TimedBoxProtoList Detect(BoxDetectorInterface* detector,
+                         const std::vector<Vector2_f>& keypoints,
+                         const cv::Mat& descriptors) {
+  TimedBoxProtoList detected_boxes;
+  detector->DetectAndAddBoxFromFeatures(keypoints, descriptors,
+                                        TimedBoxProtoList(), 0, 1.0f, 1.0f,
+                                        &detected_boxes);
+  return detected_boxes;
+}
+
+// Detects the indexed boxes in a frame of ORB descriptors.
+TimedBoxProtoList DetectBinary(BoxDetectorInterface* detector,
+                               const Features& frame) {
+  cv::Mat descriptors;
+  frame.descriptors.convertTo(descriptors, CV_8U);
+  return Detect(detector, frame.keypoints, descriptors);
+}
+
+TEST(BoxDetectorTest, LshHammingDetectsIndexedBoxes) {
+  std::mt19937 random(1);
+  std::vector<Features> boxes;
+  for (int b = 0; b < 20; ++b) {
+    boxes.push_back(RandomFeatures(&random));
+  }
+  BoxDetectorOptions options;
+  options.set_index_type(BoxDetectorOptions::LSH_HAMMING);
+  std::unique_ptr<BoxDetectorInterface> detector =
+      BoxDetectorInterface::Create(options);
+  detector->AddBoxDetectorIndex(MakeIndex(boxes));
+
+  TimedBoxProtoList detected_boxes =
+      DetectBinary(detector.get(), FrameFeatures(boxes[3], 16, &random));
+  ASSERT_EQ(1, detected_boxes.box_size());
+  EXPECT_EQ(3, detected_boxes.box(0).id());
+  EXPECT_NEAR(0.0f, detected_boxes.box(0).left(), 1e-3f);
+  EXPECT_NEAR(0.0f, detected_boxes.box(0).top(), 1e-3f);
+  EXPECT_NEAR(1.0f, detected_boxes.box(0).right(), 1e-3f);
+  EXPECT_NEAR(1.0f, detected_boxes.box(0).bottom(), 1e-3f);
+
+  // The obtained index builds a detector finding the same boxes.
+  std::unique_ptr<BoxDetectorInterface> other_detector =
+      BoxDetectorInterface::Create(options);
+  other_detector->AddBoxDetectorIndex(detector->ObtainBoxDetectorIndex());
+  detected_boxes =
+      DetectBinary(other_detector.get(), FrameFeatures(boxes[3], 16, &random));
+  ASSERT_EQ(1, detected_boxes.box_size());
+  EXPECT_EQ(3, detected_boxes.box(0).id());
+
+  // Canceled boxes are no longer detected, unlike the following ones.
+  detector->CancelBoxDetection(3);
+  EXPECT_EQ(0, DetectBinary(detector.get(), FrameFeatures(boxes[3], 16,
+                                                          &random))
+                   .box_size());
+  detected_boxes =
+      DetectBinary(detector.get(), FrameFeatures(boxes[7], 16, &random));
+  ASSERT_EQ(1, detected_boxes.box_size());
+  EXPECT_EQ(7, detected_boxes.box(0).id());
+}
+
+// Measures the detection of a box among range(0) indexed boxes, and reports
+// how often it is detected. The frame shows the indexed descriptors unchanged,
+// which both index types match.
+void BM_DetectBox(benchmark::State& state,
+                  BoxDetectorOptions::IndexType index_type) {
+  std::mt19937 random(2);
+  std::vector<Features> boxes;
+  for (int b = 0; b < state.range(0); ++b) {
+    boxes.push_back(RandomFeatures(&random));
+  }
+  BoxDetectorOptions options;
+  options.set_index_type(index_type);
+  std::unique_ptr<BoxDetectorInterface> detector =
+      BoxDetectorInterface::Create(options);
+  detector->AddBoxDetectorIndex(MakeIndex(boxes));
+  const Features frame = FrameFeatures(boxes[0], 0, &random);
+
+  int num_detected = 0;
+  int num_frames = 0;
+  for (auto _ : state) {
+    TimedBoxProtoList detected_boxes =
+        Detect(detector.get(), frame.keypoints, frame.descriptors);
+    num_detected += detected_boxes.box_size() == 1 &&
+                    detected_boxes.box(0).id() == 0;
+    ++num_frames;
+  }
+  state.counters["detected"] = static_cast<double>(num_detected) / num_frames;
+}
+BENCHMARK_CAPTURE(BM_DetectBox, OpencvBf, BoxDetectorOptions::OPENCV_BF)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000);
+BENCHMARK_CAPTURE(BM_DetectBox, LshHamming, BoxDetectorOptions::LSH_HAMMING)
+    ->Arg(10)
+    ->Arg(100)
+    ->Arg(1000);
+
+}  // namespace
+}  // namespace mediapipe
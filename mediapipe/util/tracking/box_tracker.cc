@@ -16,7 +16,6 @@
 
 #include <sys/stat.h>
 
-#include <fstream>
 #include <limits>
 
 #include "absl/strings/str_cat.h"
@@ -231,7 +230,9 @@ TimedBoxProto TimedBox::ToProto() const {
 
 BoxTracker::BoxTracker(const std::string& cache_dir,
                        const BoxTrackerOptions& options)
-    : options_(options), cache_dir_(cache_dir) {
+    : options_(options),
+      cache_dir_(cache_dir),
+      chunk_cache_(options.num_cached_chunks()) {
   tracking_workers_.reset(new ThreadPool(options_.num_tracking_workers()));
   tracking_workers_->StartWorkers();
 }
@@ -314,9 +315,9 @@ void BoxTracker::NewBoxTrackAsync(const TimedBox& initial_pos, int id,
 
   VLOG(1) << "Starting at chunk " << chunk_idx;
 
-  AugmentedChunkPtr tracking_chunk(ReadChunk(id, kInitCheckpoint, chunk_idx));
+  ChunkPtr tracking_chunk = ReadChunk(id, kInitCheckpoint, chunk_idx);
 
-  if (!tracking_chunk.first) {
+  if (!tracking_chunk) {
     absl::MutexLock lock(&status_mutex_);
     --track_status_[id][kInitCheckpoint].tracks_ongoing;
     LOG(ERROR) << "Could not read tracking chunk from file: " << chunk_idx
@@ -324,21 +325,15 @@ void BoxTracker::NewBoxTrackAsync(const TimedBox& initial_pos, int id,
     return;
   }
 
-  // Grab ownership here, to avoid any memory leaks due to early return.
-  std::unique_ptr<const TrackingDataChunk> chunk_owned;
-  if (tracking_chunk.second) {
-    chunk_owned.reset(tracking_chunk.first);
-  }
-
   const int start_frame =
-      ClosestFrameIndex(initial_pos.time_msec, *tracking_chunk.first);
+      ClosestFrameIndex(initial_pos.time_msec, *tracking_chunk);
 
   VLOG(1) << "Local start frame: " << start_frame;
 
   // Update starting position to coincide with a frame.
   TimedBox start_pos = initial_pos;
   start_pos.time_msec =
-      tracking_chunk.first->item(start_frame).timestamp_usec() / 1000;
+      tracking_chunk->item(start_frame).timestamp_usec() / 1000;
 
   VLOG(1) << "Request at " << initial_pos.time_msec << " revised to "
           << start_pos.time_msec;
@@ -375,27 +370,20 @@ void BoxTracker::NewBoxTrackAsync(const TimedBox& initial_pos, int id,
 
   VLOG(1) << "Starting tracking workers ... ";
 
-  AugmentedChunkPtr forward_chunk = tracking_chunk;
-  AugmentedChunkPtr backward_chunk = tracking_chunk;
-
-  if (tracking_chunk.second) {  // We have ownership, need a copy here.
-    forward_chunk = std::make_pair(new TrackingDataChunk(*chunk_owned), true);
-    backward_chunk = std::make_pair(chunk_owned.release(), true);
-  }
-
-  auto forward_operation = [this, forward_chunk, start_state, start_frame,
+  // Both directions share the read-only chunk.
+  auto forward_operation = [this, tracking_chunk, start_state, start_frame,
                             chunk_idx, id, checkpoint, min_msec, max_msec]() {
-    this->TrackingImpl(TrackingImplArgs(forward_chunk, start_state, start_frame,
-                                        chunk_idx, id, checkpoint, true, true,
-                                        min_msec, max_msec));
+    this->TrackingImpl(TrackingImplArgs(tracking_chunk, start_state,
+                                        start_frame, chunk_idx, id, checkpoint,
+                                        true, true, min_msec, max_msec));
   };
 
   tracking_workers_->Schedule(forward_operation);
 
   // Track backward.
-  auto backward_operation = [this, backward_chunk, start_state, start_frame,
+  auto backward_operation = [this, tracking_chunk, start_state, start_frame,
                              chunk_idx, id, checkpoint, min_msec, max_msec]() {
-    this->TrackingImpl(TrackingImplArgs(backward_chunk, start_state,
+    this->TrackingImpl(TrackingImplArgs(tracking_chunk, start_state,
                                         start_frame, chunk_idx, id, checkpoint,
                                         false, true, min_msec, max_msec));
   };
@@ -579,40 +567,34 @@ bool BoxTracker::IsTrackingOngoingMutexHeld() {
   return false;
 }
 
-BoxTracker::AugmentedChunkPtr BoxTracker::ReadChunk(int id, int checkpoint,
-                                                    int chunk_idx) {
+BoxTracker::ChunkPtr BoxTracker::ReadChunk(int id, int checkpoint,
+                                           int chunk_idx) {
   VLOG(1) << __FUNCTION__ << " id=" << id << " chunk_idx=" << chunk_idx;
   if (cache_dir_.empty() && !tracking_data_.empty()) {
     if (chunk_idx < tracking_data_.size()) {
-      return std::make_pair(tracking_data_[chunk_idx], false);
+      // Not owned, alias without control block.
+      return ChunkPtr(ChunkPtr(), tracking_data_[chunk_idx]);
     } else {
       LOG(ERROR) << "chunk_idx >= tracking_data_.size()";
-      return std::make_pair(nullptr, false);
+      return nullptr;
     }
   } else {
-    std::unique_ptr<TrackingDataChunk> chunk_data(
-        ReadChunkFromCache(id, checkpoint, chunk_idx));
-    return std::make_pair(chunk_data.release(), true);
+    return ReadChunkFromCache(id, checkpoint, chunk_idx);
   }
 }
 
-std::unique_ptr<TrackingDataChunk> BoxTracker::ReadChunkFromCache(
-    int id, int checkpoint, int chunk_idx) {
+BoxTracker::ChunkPtr BoxTracker::ReadChunkFromCache(int id, int checkpoint,
+                                                    int chunk_idx) {
   VLOG(1) << __FUNCTION__ << " id=" << id << " chunk_idx=" << chunk_idx;
 
-  auto format_runtime =
-      absl::ParsedFormat<'d'>::New(options_.cache_file_format());
-
-  std::string chunk_file;
-  if (format_runtime) {
-    chunk_file = cache_dir_ + "/" + absl::StrFormat(*format_runtime, chunk_idx);
-  } else {
-    LOG(ERROR) << "chache_file_format wrong. fall back to chunk_%04d.";
-    chunk_file = cache_dir_ + "/" + absl::StrFormat("chunk_%04d", chunk_idx);
+  ChunkPtr chunk_data = chunk_cache_.Lookup(chunk_idx);
+  if (chunk_data) {
+    VLOG(1) << "Chunk is cached";
+    return chunk_data;
   }
 
+  const std::string chunk_file = ChunkFile(chunk_idx);
   VLOG(1) << "Reading chunk from cache: " << chunk_file;
-  std::unique_ptr<TrackingDataChunk> chunk_data(new TrackingDataChunk());
 
   struct stat tmp;
   if (stat(chunk_file.c_str(), &tmp)) {
@@ -623,25 +605,45 @@ std::unique_ptr<TrackingDataChunk> BoxTracker::ReadChunkFromCache(
 
   VLOG(1) << "File exists, reading ...";
 
-  std::ifstream in(chunk_file, std::ios::in | std::ios::binary);
-  if (!in) {
+  chunk_data = chunk_cache_.GetOrLoad(chunk_idx, [&chunk_file]() -> ChunkPtr {
+    return ReadTrackingDataChunkFile(chunk_file);
+  });
+  if (!chunk_data) {
     LOG(ERROR) << "Could not read chunk file: " << chunk_file;
     return nullptr;
   }
 
-  std::string data;
-  in.seekg(0, std::ios::end);
-  data.resize(in.tellg());
-  in.seekg(0, std::ios::beg);
-  in.read(&data[0], data.size());
-  in.close();
-
-  chunk_data->ParseFromString(data);
-
   VLOG(1) << "Read success";
   return chunk_data;
 }
 
+std::string BoxTracker::ChunkFile(int chunk_idx) const {
+  auto format_runtime =
+      absl::ParsedFormat<'d'>::New(options_.cache_file_format());
+
+  if (format_runtime) {
+    return cache_dir_ + "/" + absl::StrFormat(*format_runtime, chunk_idx);
+  } else {
+    LOG(ERROR) << "chache_file_format wrong. fall back to chunk_%04d.";
+    return cache_dir_ + "/" + absl::StrFormat("chunk_%04d", chunk_idx);
+  }
+}
+
+void BoxTracker::PrefetchChunk(int chunk_idx) {
+  const std::string chunk_file = ChunkFile(chunk_idx);
+
+  // Chunks that are not written yet are waited for by tracking itself.
+  struct stat tmp;
+  if (stat(chunk_file.c_str(), &tmp)) {
+    return;
+  }
+
+  VLOG(1) << "Prefetching chunk: " << chunk_file;
+  chunk_cache_.GetOrLoad(chunk_idx, [&chunk_file]() -> ChunkPtr {
+    return ReadTrackingDataChunkFile(chunk_file);
+  });
+}
+
 bool BoxTracker::WaitForChunkFile(int id, int checkpoint,
                                   const std::string& chunk_file) {
   VLOG(1) << "Chunk no exists, waiting for file: " << chunk_file;
@@ -757,6 +759,28 @@ void BoxTracker::TrackingImpl(const TrackingImplArgs& a) {
           << chunk_data_size << " items";
   motion_box.ResetAtFrame(a.start_frame, a.start_state);
 
+  // Read the chunk tracking continues with while tracking this one, if
+  // tracking is not limited to this chunk.
+  if (!cache_dir_.empty() && options_.prefetch_chunks() &&
+      options_.num_cached_chunks() > 0) {
+    const int64 chunk_size_msec = options_.caching_chunk_size_msec();
+    int prefetch_idx = -1;
+    if (a.forward) {
+      if (!a.chunk_data->last_chunk() &&
+          a.max_msec / chunk_size_msec > a.chunk_idx) {
+        prefetch_idx = a.chunk_idx + 1;
+      }
+    } else if (!a.chunk_data->first_chunk() &&
+               a.min_msec / chunk_size_msec < a.chunk_idx) {
+      prefetch_idx = a.chunk_idx - 1;
+    }
+
+    if (prefetch_idx >= 0) {
+      tracking_workers_->Schedule(
+          [this, prefetch_idx]() { this->PrefetchChunk(prefetch_idx); });
+    }
+  }
+
   auto cleanup_func = [&a, this]() -> void {
     if (a.first_call) {
       // Signal we are done processing in this direction.
@@ -820,10 +844,9 @@ void BoxTracker::TrackingImpl(const TrackingImplArgs& a) {
 
       if (f + 2 == chunk_data_size && !a.chunk_data->last_chunk()) {
         // Last frame, successful track, continue;
-        AugmentedChunkPtr next_chunk(
-            ReadChunk(a.id, a.checkpoint, a.chunk_idx + 1));
+        ChunkPtr next_chunk = ReadChunk(a.id, a.checkpoint, a.chunk_idx + 1);
 
-        if (next_chunk.first != nullptr) {
+        if (next_chunk != nullptr) {
           TrackingImplArgs next_args(next_chunk, motion_box.StateAtFrame(f + 1),
                                      0, a.chunk_idx + 1, a.id, a.checkpoint,
                                      a.forward, false, a.min_msec, a.max_msec);
@@ -880,10 +903,9 @@ void BoxTracker::TrackingImpl(const TrackingImplArgs& a) {
         VLOG(1) << "Read next chunk: " << f << "==" << first_frame << " in "
                 << a.chunk_idx;
         // First frame, successful track, continue.
-        AugmentedChunkPtr prev_chunk(
-            ReadChunk(a.id, a.checkpoint, a.chunk_idx - 1));
-        if (prev_chunk.first != nullptr) {
-          const int last_frame = prev_chunk.first->item_size() - 1;
+        ChunkPtr prev_chunk = ReadChunk(a.id, a.checkpoint, a.chunk_idx - 1);
+        if (prev_chunk != nullptr) {
+          const int last_frame = prev_chunk->item_size() - 1;
           TrackingImplArgs prev_args(prev_chunk, motion_box.StateAtFrame(f - 1),
                                      last_frame, a.chunk_idx - 1, a.id,
                                      a.checkpoint, a.forward, false, a.min_msec,
@@ -1035,26 +1057,21 @@ bool BoxTracker::GetTrackingData(int id, int64 request_time_msec,
 
   int chunk_idx = ChunkIdxFromTime(request_time_msec);
 
-  AugmentedChunkPtr tracking_chunk(ReadChunk(id, kInitCheckpoint, chunk_idx));
-  if (!tracking_chunk.first) {
+  ChunkPtr tracking_chunk = ReadChunk(id, kInitCheckpoint, chunk_idx);
+  if (!tracking_chunk) {
     absl::MutexLock lock(&status_mutex_);
     --track_status_[id][kInitCheckpoint].tracks_ongoing;
     LOG(ERROR) << "Could not read tracking chunk from file.";
     return false;
   }
 
-  std::unique_ptr<const TrackingDataChunk> owned_chunk;
-  if (tracking_chunk.second) {
-    owned_chunk.reset(tracking_chunk.first);
-  }
-
   const int closest_frame =
-      ClosestFrameIndex(request_time_msec, *tracking_chunk.first);
+      ClosestFrameIndex(request_time_msec, *tracking_chunk);
 
-  *tracking_data = tracking_chunk.first->item(closest_frame).tracking_data();
+  *tracking_data = tracking_chunk->item(closest_frame).tracking_data();
   if (tracking_data_msec) {
     *tracking_data_msec =
-        tracking_chunk.first->item(closest_frame).timestamp_usec() / 1000;
+        tracking_chunk->item(closest_frame).timestamp_usec() / 1000;
   }
   return true;
 }
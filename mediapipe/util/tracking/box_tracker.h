@@ -18,6 +18,7 @@
 #include <inttypes.h>
 
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -28,6 +29,7 @@
 #include "mediapipe/util/tracking/flow_packager.pb.h"
 #include "mediapipe/util/tracking/tracking.h"
 #include "mediapipe/util/tracking/tracking.pb.h"
+#include "mediapipe/util/tracking/tracking_data_chunk_cache.h"
 
 namespace mediapipe {
 
@@ -127,6 +129,9 @@ bool TimedBoxAtTime(const PathSegment& segment, int64 time_msec, TimedBox* box,
 
 // Tracks timed boxes from cached TrackingDataChunks created by
 // FlowPackagerCalculator. For usage see accompanying test.
+// Chunks read from the caching directory are kept in a least recently used
+// cache, and the next chunk in tracking direction is read ahead of time (see
+// BoxTrackerOptions::num_cached_chunks and prefetch_chunks).
 class BoxTracker {
  public:
   // Initializes a new BoxTracker to work on cached TrackingData from a chunk
@@ -215,8 +220,8 @@ class BoxTracker {
       ABSL_LOCKS_EXCLUDED(status_mutex_);
 
   // Debug function to obtain raw TrackingData closest to the specified
-  // timestamp. This call will read from disk on every invocation so it is
-  // expensive.
+  // timestamp. This call will read from disk unless the chunk is cached so it
+  // is expensive.
   // To not interfere with other tracking requests it is recommended that you
   // use a unique id here.
   // Returns true on success.
@@ -230,19 +235,26 @@ class BoxTracker {
   void NewBoxTrackAsync(const TimedBox& initial_pos, int id, int64 min_msec,
                         int64 max_msec);
 
-  typedef std::pair<const TrackingDataChunk*, bool> AugmentedChunkPtr;
+  // Chunk shared by tracking requests. Chunks passed to the constructor or
+  // AddTrackingDataChunks without copy are not owned.
+  typedef std::shared_ptr<const TrackingDataChunk> ChunkPtr;
+
   // Attempts to read chunk at chunk_idx if it exists. Reads from cache
   // directory or from in memory cache.
-  // Important: 2nd part of return value indicates if returned tracking data
-  // will be owned by the caller (if true). In that case caller is responsible
-  // for releasing the returned chunk.
-  AugmentedChunkPtr ReadChunk(int id, int checkpoint, int chunk_idx);
+  // Returns nullptr if data could not be read.
+  ChunkPtr ReadChunk(int id, int checkpoint, int chunk_idx);
 
   // Attempts to read specified chunk from caching directory. Blocks and waits
   // until chunk is available or internal time out is reached.
   // Returns nullptr if data could not be read.
-  std::unique_ptr<TrackingDataChunk> ReadChunkFromCache(int id, int checkpoint,
-                                                        int chunk_idx);
+  ChunkPtr ReadChunkFromCache(int id, int checkpoint, int chunk_idx);
+
+  // Returns the chunk file for chunk_idx in the caching directory.
+  std::string ChunkFile(int chunk_idx) const;
+
+  // Reads specified chunk from caching directory into chunk_cache_, if it
+  // exists. Does not wait for the chunk.
+  void PrefetchChunk(int chunk_idx);
 
   // Waits with timeout for chunkfile to become available. Returns true on
   // success, false if waited till timeout or when canceled.
@@ -257,13 +269,13 @@ class BoxTracker {
                     const MotionBoxState& state);
 
   // Callback can only handle 5 args max.
-  // Set own_data to true for args to assume ownership.
   struct TrackingImplArgs {
-    TrackingImplArgs(AugmentedChunkPtr chunk_ptr,
-                     const MotionBoxState& start_state_, int start_frame_,
-                     int chunk_idx_, int id_, int checkpoint_, bool forward_,
-                     bool first_call_, int64 min_msec_, int64 max_msec_)
-        : start_state(start_state_),
+    TrackingImplArgs(ChunkPtr chunk_data_, const MotionBoxState& start_state_,
+                     int start_frame_, int chunk_idx_, int id_, int checkpoint_,
+                     bool forward_, bool first_call_, int64 min_msec_,
+                     int64 max_msec_)
+        : chunk_data(std::move(chunk_data_)),
+          start_state(start_state_),
           start_frame(start_frame_),
           chunk_idx(chunk_idx_),
           id(id_),
@@ -271,22 +283,12 @@ class BoxTracker {
           forward(forward_),
           first_call(first_call_),
           min_msec(min_msec_),
-          max_msec(max_msec_) {
-      if (chunk_ptr.second) {
-        chunk_data_buffer.reset(chunk_ptr.first);
-      }
-
-      chunk_data = chunk_ptr.first;
-    }
+          max_msec(max_msec_) {}
 
     TrackingImplArgs(const TrackingImplArgs&) = default;
 
-    // Storage for tracking data.
-    std::shared_ptr<const TrackingDataChunk> chunk_data_buffer;
-
-    // Pointer to the actual tracking data. Usually points to the buffer
-    // but can also point to external data for performance reasons.
-    const TrackingDataChunk* chunk_data;
+    // Tracking data, shared with other requests on the same chunk.
+    ChunkPtr chunk_data;
 
     MotionBoxState start_state;
     int start_frame;
@@ -364,6 +366,9 @@ class BoxTracker {
   // Buffer for tracking data in case we retain a deep copy.
   std::vector<std::unique_ptr<TrackingDataChunk>> tracking_data_buffer_;
 
+  // Recently read chunks from the caching directory.
+  TrackingDataChunkCache chunk_cache_;
+
   // Workers that run the tracking algorithm.
   std::unique_ptr<ThreadPool> tracking_workers_;
 };
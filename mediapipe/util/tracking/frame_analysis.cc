@@ -0,0 +1,147 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/tracking/frame_analysis.h"
+
+#include <algorithm>
+
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/formats/image_frame_opencv.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/opencv_imgproc_inc.h"
+
+namespace mediapipe {
+
+FrameAnalysis::FrameAnalysis(std::shared_ptr<const ImageFrame> frame,
+                             std::shared_ptr<ImageFrameAllocator> allocator)
+    : image_frame_(std::move(frame)), allocator_(std::move(allocator)) {
+  CHECK(image_frame_ != nullptr);
+  const ImageFormat::Format format = image_frame_->Format();
+  CHECK(format == ImageFormat::SRGB || format == ImageFormat::SRGBA ||
+        format == ImageFormat::GRAY8)
+      << "Unsupported image format: " << format;
+  frame_ = formats::MatView(image_frame_.get());
+  if (format == ImageFormat::GRAY8) {
+    grayscale_ = frame_;
+  }
+}
+
+FrameAnalysis::FrameAnalysis(const cv::Mat& grayscale)
+    : frame_(grayscale), grayscale_(grayscale) {
+  CHECK_EQ(CV_8UC1, grayscale.type());
+}
+
+const cv::Mat& FrameAnalysis::Grayscale() const {
+  absl::MutexLock lock(&grayscale_mutex_);
+  if (grayscale_.empty()) {
+    grayscale_ = NewGrayscaleFrame(frame_.cols, frame_.rows);
+    cv::cvtColor(frame_, grayscale_,
+                 frame_.channels() == 4 ? cv::COLOR_RGBA2GRAY
+                                        : cv::COLOR_RGB2GRAY);
+  }
+  return grayscale_;
+}
+
+const cv::Mat& FrameAnalysis::ScaledGrayscale(int max_size) const {
+  CHECK_GT(max_size, 0);
+  absl::MutexLock lock(&scaled_mutex_);
+  auto scaled_iter = scaled_.find(max_size);
+  if (scaled_iter != scaled_.end()) {
+    return scaled_iter->second;
+  }
+
+  const cv::Mat& grayscale = Grayscale();
+  cv::Mat& scaled = scaled_[max_size];
+  const int longer_edge = std::max(grayscale.cols, grayscale.rows);
+  if (longer_edge <= max_size) {
+    scaled = grayscale;
+  } else {
+    const float scale = static_cast<float>(max_size) / longer_edge;
+    scaled = NewGrayscaleFrame(static_cast<int>(scale * grayscale.cols),
+                               static_cast<int>(scale * grayscale.rows));
+    cv::resize(grayscale, scaled, scaled.size(), 0, 0, cv::INTER_AREA);
+  }
+  return scaled;
+}
+
+const std::vector<cv::Mat>& FrameAnalysis::Pyramid(float scale_factor,
+                                                   int num_levels) const {
+  absl::MutexLock lock(&pyramid_mutex_);
+  const auto key = std::make_pair(scale_factor, num_levels);
+  auto pyramid_iter = pyramids_.find(key);
+  if (pyramid_iter != pyramids_.end()) {
+    return pyramid_iter->second;
+  }
+
+  std::vector<cv::Mat>& pyramid = pyramids_[key];
+  if (num_levels > 0) {
+    pyramid.push_back(Grayscale());
+  }
+  // Each level is allocated with the dimensions cv::resize derives from the
+  // scale, so that it is filled in place.
+  const float inv_scale = 1.0f / scale_factor;
+  for (int level = 1; level < num_levels; ++level) {
+    const cv::Mat& prev_level = pyramid.back();
+    cv::Mat next_level =
+        NewGrayscaleFrame(cvRound(prev_level.cols * double{inv_scale}),
+                          cvRound(prev_level.rows * double{inv_scale}));
+    cv::resize(prev_level, next_level, cv::Size(), inv_scale, inv_scale);
+    pyramid.push_back(next_level);
+  }
+  return pyramid;
+}
+
+const FrameAnalysis::OrbFeatures& FrameAnalysis::Orb(
+    const OrbSettings& settings) const {
+  const OrbKey key(settings.max_features, settings.scale_factor,
+                   settings.num_levels, settings.edge_threshold,
+                   settings.patch_size, settings.fast_score,
+                   settings.max_size, settings.compute_descriptors);
+  absl::MutexLock lock(&orb_mutex_);
+  auto features_iter = orb_features_.find(key);
+  if (features_iter != orb_features_.end()) {
+    return features_iter->second;
+  }
+
+  const cv::Mat& image = settings.max_size > 0
+                             ? ScaledGrayscale(settings.max_size)
+                             : Grayscale();
+  cv::Ptr<cv::ORB> orb = cv::ORB::create(
+      settings.max_features, settings.scale_factor, settings.num_levels,
+      settings.edge_threshold, 0, 2,
+      settings.fast_score ? cv::ORB::FAST_SCORE : cv::ORB::HARRIS_SCORE,
+      settings.patch_size);
+
+  OrbFeatures& features = orb_features_[key];
+  orb->detect(image, features.keypoints);
+  if (settings.compute_descriptors) {
+    orb->compute(image, features.keypoints, features.descriptors);
+  }
+  features.width = image.cols;
+  features.height = image.rows;
+  return features;
+}
+
+cv::Mat FrameAnalysis::NewGrayscaleFrame(int width, int height) const {
+  std::unique_ptr<ImageFrame> frame =
+      allocator_ ? allocator_->NewImageFrame(ImageFormat::GRAY8, width, height)
+                 : absl::make_unique<ImageFrame>(ImageFormat::GRAY8, width,
+                                                 height);
+  cv::Mat view = formats::MatView(frame.get());
+  absl::MutexLock lock(&frames_mutex_);
+  frames_.push_back(std::move(frame));
+  return view;
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,140 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Image analysis of a single frame shared by all calculators processing it,
+// e.g. MotionAnalysisCalculator, FeatureDetectorCalculator and
+// BoxDetectorCalculator, so that the grayscale frame, its pyramids and its ORB
+// features are computed once per timestamp instead of once per calculator.
+//
+// Each result is computed on first request and retained for the lifetime of
+// the FrameAnalysis, usually that of its packet (see FrameAnalysisCalculator).
+// If an ImageFrameAllocator is specified, computed frames are drawn from it
+// and returned to it on destruction, so their memory is reused across
+// timestamps within the allocator's bounds.
+//
+// All methods are thread-safe. Concurrent requests for the same result wait
+// for a single computation. Returned references remain valid for the lifetime
+// of the FrameAnalysis.
+
+#ifndef MEDIAPIPE_UTIL_TRACKING_FRAME_ANALYSIS_H_
+#define MEDIAPIPE_UTIL_TRACKING_FRAME_ANALYSIS_H_
+
+#include <map>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/image_frame_allocator.h"
+#include "mediapipe/framework/port/opencv_core_inc.h"
+#include "mediapipe/framework/port/opencv_features2d_inc.h"
+
+namespace mediapipe {
+
+class FrameAnalysis {
+ public:
+  // Settings of the ORB feature extraction, see cv::ORB::create.
+  struct OrbSettings {
+    int max_features = 500;
+    float scale_factor = 1.2f;
+    int num_levels = 8;
+    int edge_threshold = 31;
+    int patch_size = 31;
+    // Ranks features by cv::ORB::FAST_SCORE instead of HARRIS_SCORE.
+    bool fast_score = false;
+    // If positive, features are extracted from ScaledGrayscale(max_size)
+    // instead of the grayscale frame.
+    int max_size = 0;
+    bool compute_descriptors = false;
+  };
+
+  struct OrbFeatures {
+    std::vector<cv::KeyPoint> keypoints;
+    // One row per keypoint. Empty unless compute_descriptors is set.
+    cv::Mat descriptors;
+    // Dimensions of the image the features were extracted from.
+    int width = 0;
+    int height = 0;
+  };
+
+  // Analyzes frame, which must be of format SRGB, SRGBA or GRAY8. Computed
+  // frames are drawn from allocator if not null.
+  FrameAnalysis(std::shared_ptr<const ImageFrame> frame,
+                std::shared_ptr<ImageFrameAllocator> allocator);
+
+  // Analyzes the grayscale (CV_8UC1) frame, whose pixel data must remain
+  // valid for the lifetime of this object.
+  explicit FrameAnalysis(const cv::Mat& grayscale);
+
+  FrameAnalysis(const FrameAnalysis&) = delete;
+  FrameAnalysis& operator=(const FrameAnalysis&) = delete;
+
+  int width() const { return frame_.cols; }
+  int height() const { return frame_.rows; }
+
+  // Returns the grayscale frame.
+  const cv::Mat& Grayscale() const;
+
+  // Returns the grayscale frame downscaled (cv::INTER_AREA) to a longer edge
+  // of max_size, or the grayscale frame itself if it is not larger.
+  const cv::Mat& ScaledGrayscale(int max_size) const;
+
+  // Returns num_levels pyramid levels of the grayscale frame, starting with
+  // the grayscale frame, each downscaled (cv::INTER_LINEAR) by 1 /
+  // scale_factor w.r.t. the previous level.
+  const std::vector<cv::Mat>& Pyramid(float scale_factor,
+                                      int num_levels) const;
+
+  // Returns the ORB features extracted with the specified settings.
+  const OrbFeatures& Orb(const OrbSettings& settings) const;
+
+ private:
+  typedef std::tuple<int, float, int, int, int, bool, int, bool> OrbKey;
+
+  // Returns a GRAY8 frame of the specified dimensions, which is retained
+  // until this object is destroyed.
+  cv::Mat NewGrayscaleFrame(int width, int height) const;
+
+  // The analyzed frame, a view of image_frame_ if set.
+  cv::Mat frame_;
+  std::shared_ptr<const ImageFrame> image_frame_;
+  std::shared_ptr<ImageFrameAllocator> allocator_;
+
+  // Each kind of result is computed with its own mutex held, so that e.g. the
+  // grayscale frame can be obtained while ORB features are being extracted.
+  mutable absl::Mutex grayscale_mutex_;
+  mutable cv::Mat grayscale_ ABSL_GUARDED_BY(grayscale_mutex_);
+
+  mutable absl::Mutex scaled_mutex_;
+  mutable std::map<int, cv::Mat> scaled_ ABSL_GUARDED_BY(scaled_mutex_);
+
+  mutable absl::Mutex pyramid_mutex_;
+  mutable std::map<std::pair<float, int>, std::vector<cv::Mat>> pyramids_
+      ABSL_GUARDED_BY(pyramid_mutex_);
+
+  mutable absl::Mutex orb_mutex_;
+  mutable std::map<OrbKey, OrbFeatures> orb_features_
+      ABSL_GUARDED_BY(orb_mutex_);
+
+  // Owns the pixel data of the computed frames.
+  mutable absl::Mutex frames_mutex_;
+  mutable std::vector<std::unique_ptr<ImageFrame>> frames_
+      ABSL_GUARDED_BY(frames_mutex_);
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_TRACKING_FRAME_ANALYSIS_H_
@@ -0,0 +1,182 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/tracking/frame_analysis.h"
+
+#include <memory>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/formats/image_frame_opencv.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/opencv_imgproc_inc.h"
+#include "mediapipe/framework/port/threadpool.h"
+
+namespace mediapipe {
+namespace {
+
+// Returns a frame of random pixels, smoothed so that it has features.
+std::shared_ptr<ImageFrame> RandomFrame(ImageFormat::Format format, int width,
+                                        int height) {
+  auto frame = std::make_shared<ImageFrame>(format, width, height);
+  cv::Mat view = formats::MatView(frame.get());
+  cv::randu(view, cv::Scalar::all(0), cv::Scalar::all(255));
+  cv::GaussianBlur(view, view, cv::Size(5, 5), 0);
+  return frame;
+}
+
+bool Equal(const cv::Mat& a, const cv::Mat& b) {
+  return a.size() == b.size() && a.type() == b.type() &&
+         cv::norm(a, b, cv::NORM_INF) == 0;
+}
+
+TEST(FrameAnalysisTest, Grayscale) {
+  std::shared_ptr<ImageFrame> frame = RandomFrame(ImageFormat::SRGB, 64, 48);
+  FrameAnalysis analysis(frame, nullptr);
+  EXPECT_EQ(64, analysis.width());
+  EXPECT_EQ(48, analysis.height());
+
+  cv::Mat expected;
+  cv::cvtColor(formats::MatView(frame.get()), expected, cv::COLOR_RGB2GRAY);
+  const cv::Mat& grayscale = analysis.Grayscale();
+  EXPECT_TRUE(Equal(expected, grayscale));
+  EXPECT_EQ(grayscale.data, analysis.Grayscale().data);
+
+  // Grayscale frames are not copied.
+  std::shared_ptr<ImageFrame> gray_frame =
+      RandomFrame(ImageFormat::GRAY8, 64, 48);
+  FrameAnalysis gray_analysis(gray_frame, nullptr);
+  EXPECT_EQ(gray_frame->PixelData(), gray_analysis.Grayscale().data);
+}
+
+TEST(FrameAnalysisTest, ScaledGrayscale) {
+  std::shared_ptr<ImageFrame> frame = RandomFrame(ImageFormat::SRGBA, 64, 48);
+  FrameAnalysis analysis(frame, nullptr);
+
+  cv::Mat expected;
+  cv::resize(analysis.Grayscale(), expected, cv::Size(32, 24), 0, 0,
+             cv::INTER_AREA);
+  EXPECT_TRUE(Equal(expected, analysis.ScaledGrayscale(32)));
+  EXPECT_EQ(analysis.Grayscale().data, analysis.ScaledGrayscale(64).data);
+}
+
+TEST(FrameAnalysisTest, Pyramid) {
+  std::shared_ptr<ImageFrame> frame = RandomFrame(ImageFormat::SRGB, 100, 75);
+  FrameAnalysis analysis(frame, nullptr);
+  const std::vector<cv::Mat>& pyramid = analysis.Pyramid(1.2f, 4);
+  ASSERT_EQ(4, pyramid.size());
+  EXPECT_EQ(&pyramid, &analysis.Pyramid(1.2f, 4));
+
+  cv::Mat expected = analysis.Grayscale();
+  for (int level = 0; level < 4; ++level) {
+    EXPECT_TRUE(Equal(expected, pyramid[level])) << level;
+    cv::Mat next_level;
+    cv::resize(expected, next_level, cv::Size(), 1.0f / 1.2f, 1.0f / 1.2f);
+    expected = next_level;
+  }
+}
+
+TEST(FrameAnalysisTest, Orb) {
+  std::shared_ptr<ImageFrame> frame =
+      RandomFrame(ImageFormat::SRGB, 320, 240);
+  FrameAnalysis analysis(frame, nullptr);
+  FrameAnalysis::OrbSettings settings;
+  settings.max_features = 100;
+  settings.max_size = 200;
+  settings.compute_descriptors = true;
+  const FrameAnalysis::OrbFeatures& features = analysis.Orb(settings);
+  EXPECT_EQ(&features, &analysis.Orb(settings));
+  EXPECT_EQ(200, features.width);
+  EXPECT_EQ(150, features.height);
+
+  cv::Ptr<cv::ORB> orb = cv::ORB::create(100);
+  std::vector<cv::KeyPoint> keypoints;
+  cv::Mat descriptors;
+  orb->detect(analysis.ScaledGrayscale(200), keypoints);
+  orb->compute(analysis.ScaledGrayscale(200), keypoints, descriptors);
+  ASSERT_GT(keypoints.size(), 0);
+  ASSERT_EQ(keypoints.size(), features.keypoints.size());
+  for (int k = 0; k < keypoints.size(); ++k) {
+    EXPECT_EQ(keypoints[k].pt, features.keypoints[k].pt);
+  }
+  EXPECT_TRUE(Equal(descriptors, features.descriptors));
+
+  // Different settings are extracted separately.
+  settings.compute_descriptors = false;
+  EXPECT_NE(&features, &analysis.Orb(settings));
+  EXPECT_TRUE(analysis.Orb(settings).descriptors.empty());
+}
+
+TEST(FrameAnalysisTest, ComputesOnceForConcurrentRequests) {
+  std::shared_ptr<ImageFrame> frame =
+      RandomFrame(ImageFormat::SRGB, 320, 240);
+  FrameAnalysis analysis(frame, nullptr);
+  constexpr int kNumRequests = 8;
+  std::vector<const cv::Mat*> grayscale(kNumRequests);
+  std::vector<const FrameAnalysis::OrbFeatures*> features(kNumRequests);
+  {
+    ThreadPool pool(4);
+    pool.StartWorkers();
+    for (int k = 0; k < kNumRequests; ++k) {
+      pool.Schedule([&analysis, &grayscale, &features, k]() {
+        features[k] = &analysis.Orb(FrameAnalysis::OrbSettings());
+        grayscale[k] = &analysis.Grayscale();
+      });
+    }
+  }
+  for (int k = 1; k < kNumRequests; ++k) {
+    EXPECT_EQ(grayscale[0], grayscale[k]);
+    EXPECT_EQ(features[0], features[k]);
+  }
+}
+
+TEST(FrameAnalysisTest, ReusesAllocatorFrames) {
+  std::shared_ptr<ImageFrameAllocator> allocator =
+      ImageFrameAllocator::Create(ImageFrameAllocator::Options());
+  std::shared_ptr<ImageFrame> frame = RandomFrame(ImageFormat::SRGB, 64, 48);
+  for (int k = 0; k < 2; ++k) {
+    FrameAnalysis analysis(frame, allocator);
+    analysis.Pyramid(2.0f, 3);
+  }
+  // The grayscale frame and two pyramid levels are reused by the second
+  // analysis.
+  const ImageFrameAllocator::Stats stats = allocator->GetStats();
+  EXPECT_EQ(3, stats.allocation_count);
+  EXPECT_EQ(3, stats.reuse_count);
+  EXPECT_EQ(0, stats.in_use_bytes);
+}
+
+// Measures three consumers obtaining the grayscale frame and a pyramid of
+// the same frame, from a shared analysis or each from its own.
+void BM_ThreeConsumers(benchmark::State& state) {
+  const bool shared = state.range(0);
+  std::shared_ptr<ImageFrameAllocator> allocator =
+      ImageFrameAllocator::Create(ImageFrameAllocator::Options());
+  std::shared_ptr<ImageFrame> frame =
+      RandomFrame(ImageFormat::SRGB, 640, 480);
+  for (auto _ : state) {
+    std::unique_ptr<FrameAnalysis> analysis;
+    for (int k = 0; k < 3; ++k) {
+      if (!analysis || !shared) {
+        analysis = absl::make_unique<FrameAnalysis>(frame, allocator);
+      }
+      benchmark::DoNotOptimize(analysis->Pyramid(1.2f, 4).back().data);
+    }
+  }
+}
+BENCHMARK(BM_ThreeConsumers)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace mediapipe
@@ -43,7 +43,7 @@ MotionAnalysis::MotionAnalysis(const MotionAnalysisOptions& options,
       frame_width_(frame_width),
       frame_height_(frame_height) {
   // Init options by policy.
-  InitPolicyOptions();
+  InitPolicyOptions(&options_);
   // Merge back in any overriden options.
   options_.MergeFrom(options);
 
@@ -76,20 +76,7 @@ MotionAnalysis::MotionAnalysis(const MotionAnalysisOptions& options,
   frame_num_ = 0;
 
   // Determine if feature descriptors need to be computed.
-  // Required for irls smoothing, overlay detection and mixture homographies.
-  const bool compute_mixtures =
-      options_.motion_options().mix_homography_estimation() !=
-      MotionEstimationOptions::ESTIMATION_HOMOG_MIX_NONE;
-
-  const bool use_spatial_bias =
-      options_.motion_options().estimation_policy() ==
-          MotionEstimationOptions::TEMPORAL_LONG_FEATURE_BIAS &&
-      options_.motion_options().long_feature_bias_options().use_spatial_bias();
-
-  compute_feature_descriptors_ =
-      options_.post_irls_smoothing() ||
-      options_.motion_options().overlay_detection() || compute_mixtures ||
-      use_spatial_bias;
+  compute_feature_descriptors_ = ComputeFeatureDescriptors(options_);
 
   if (compute_feature_descriptors_) {
     CHECK_EQ(RegionFlowComputationOptions::FORMAT_RGB,
@@ -116,10 +103,10 @@ MotionAnalysis::MotionAnalysis(const MotionAnalysisOptions& options,
       2 * overlap_size_));
 }
 
-void MotionAnalysis::InitPolicyOptions() {
-  auto* flow_options = options_.mutable_flow_options();
+void MotionAnalysis::InitPolicyOptions(MotionAnalysisOptions* options) {
+  auto* flow_options = options->mutable_flow_options();
   auto* tracking_options = flow_options->mutable_tracking_options();
-  auto* motion_options = options_.mutable_motion_options();
+  auto* motion_options = options->mutable_motion_options();
   auto* feature_bias_options =
       motion_options->mutable_long_feature_bias_options();
   auto* translation_bounds =
@@ -127,13 +114,13 @@ void MotionAnalysis::InitPolicyOptions() {
   auto* similarity_bounds = motion_options->mutable_stable_similarity_bounds();
   auto* homography_bounds = motion_options->mutable_stable_homography_bounds();
 
-  switch (options_.analysis_policy()) {
+  switch (options->analysis_policy()) {
     case MotionAnalysisOptions::ANALYSIS_POLICY_LEGACY:
       break;
 
     case MotionAnalysisOptions::ANALYSIS_POLICY_VIDEO:
       // Long track settings. Temporally consistent.
-      options_.set_estimation_clip_size(64);
+      options->set_estimation_clip_size(64);
 
       tracking_options->set_internal_tracking_direction(
           TrackingOptions::FORWARD);
@@ -169,7 +156,7 @@ void MotionAnalysis::InitPolicyOptions() {
 
     case MotionAnalysisOptions::ANALYSIS_POLICY_VIDEO_MOBILE:
       // Long track settings. Temporally consistent.
-      options_.set_estimation_clip_size(32);
+      options->set_estimation_clip_size(32);
       tracking_options->set_internal_tracking_direction(
           TrackingOptions::FORWARD);
       tracking_options->set_tracking_policy(
@@ -261,12 +248,12 @@ void MotionAnalysis::InitPolicyOptions() {
       motion_options->set_use_highest_accuracy_for_normal_equations(false);
 
       // Low latency.
-      options_.set_estimation_clip_size(1);
+      options->set_estimation_clip_size(1);
       break;
 
     case MotionAnalysisOptions::ANALYSIS_POLICY_HYPERLAPSE:
       // Long track settings. Temporally consistent.
-      options_.set_estimation_clip_size(64);
+      options->set_estimation_clip_size(64);
 
       tracking_options->set_internal_tracking_direction(
           TrackingOptions::FORWARD);
@@ -338,6 +325,30 @@ void MotionAnalysis::InitPolicyOptions() {
   }
 }
 
+bool MotionAnalysis::RequiresColorFrames(const MotionAnalysisOptions& options) {
+  MotionAnalysisOptions policy_options(options);
+  InitPolicyOptions(&policy_options);
+  policy_options.MergeFrom(options);
+  return ComputeFeatureDescriptors(policy_options);
+}
+
+bool MotionAnalysis::ComputeFeatureDescriptors(
+    const MotionAnalysisOptions& options) {
+  // Required for irls smoothing, overlay detection and mixture homographies.
+  const bool compute_mixtures =
+      options.motion_options().mix_homography_estimation() !=
+      MotionEstimationOptions::ESTIMATION_HOMOG_MIX_NONE;
+
+  const bool use_spatial_bias =
+      options.motion_options().estimation_policy() ==
+          MotionEstimationOptions::TEMPORAL_LONG_FEATURE_BIAS &&
+      options.motion_options().long_feature_bias_options().use_spatial_bias();
+
+  return options.post_irls_smoothing() ||
+         options.motion_options().overlay_detection() || compute_mixtures ||
+         use_spatial_bias;
+}
+
 bool MotionAnalysis::AddFrame(const cv::Mat& frame, int64 timestamp_usec,
                               RegionFlowFeatureList* feature_list) {
   return AddFrameWithSeed(frame, timestamp_usec, Homography(), feature_list);
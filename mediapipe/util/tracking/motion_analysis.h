@@ -82,6 +82,19 @@ class MotionAnalysis {
   MotionAnalysis(const MotionAnalysis&) = delete;
   MotionAnalysis& operator=(const MotionAnalysis&) = delete;
 
+  // Returns true if analysis with the specified options computes feature
+  // descriptors, which requires RGB frames. Otherwise frames may also be
+  // passed as grayscale (flow_options().image_format() FORMAT_GRAYSCALE).
+  static bool RequiresColorFrames(const MotionAnalysisOptions& options);
+
+  // Runs the parallel loops of region flow computation and motion estimation
+  // on executor if not null, e.g. the executor of the calculator graph.
+  // Executor must outlive this object.
+  void SetExecutor(Executor* executor) {
+    region_flow_computation_->SetExecutor(executor);
+    motion_estimation_->SetExecutor(executor);
+  }
+
   // Call with every frame. Timestamp is optional (set to zero if not needed).
   // Optionally outputs list of features extracted from this frame.
   // Returns true on success.
@@ -177,7 +190,12 @@ class MotionAnalysis {
   int NumFrames() const { return frame_num_; }
 
  private:
-  void InitPolicyOptions();
+  // Sets the defaults of options->analysis_policy() in options.
+  static void InitPolicyOptions(MotionAnalysisOptions* options);
+
+  // Returns true if feature descriptors are computed with the specified
+  // options, after the policy defaults have been applied.
+  static bool ComputeFeatureDescriptors(const MotionAnalysisOptions& options);
 
   // Compute saliency from buffered features and motions.
   void ComputeSaliency();
@@ -40,6 +40,7 @@
 #include "mediapipe/util/tracking/parallel_invoker.h"
 #include "mediapipe/util/tracking/region_flow.h"
 #include "mediapipe/util/tracking/region_flow.pb.h"
+#include "mediapipe/util/tracking/region_flow_feature_buffer.h"
 
 namespace mediapipe {
 
@@ -1033,7 +1034,8 @@ void MotionEstimation::EstimateMotionsParallelImpl(
                     CameraMotion::VALID, DefaultModelOptions(), this,
                     nullptr,  // No prior weights.
                     nullptr,  // No thread storage.
-                    clip_data.feature_lists, clip_data.camera_motions));
+                    clip_data.feature_lists, clip_data.camera_motions),
+                executor_);
   }
 
   // Order of estimation for motion models:
@@ -1237,7 +1239,8 @@ bool MotionEstimation::EstimateMotionModels(
                         last_round,  // Compute stability on last round.
                         max_unstable_type, model_options, this,
                         &clip_data.prior_weights, thread_storage,
-                        clip_data.feature_lists, clip_data.camera_motions));
+                        clip_data.feature_lists, clip_data.camera_motions),
+                    executor_);
       }
 
       if (options_.estimation_policy() ==
@@ -1746,22 +1749,14 @@ void MotionEstimation::IrlsInitialization(
                                     this, clip_data);
 
   if (frame == -1) {
-    // Function pointer to select between SerialFor and ParallelFor based on
-    // EstimationPolicy.
-    typedef void (*ForFunctionPtr)(size_t, size_t, size_t,
-                                   const IrlsInitializationInvoker&);
-
-    ForFunctionPtr for_function = &ParallelFor<IrlsInitializationInvoker>;
-
     // Inlier mask only used for translation or linear similarity.
     // In that case, initialization needs to proceed serially.
-    if (type == MODEL_TRANSLATION || type == MODEL_LINEAR_SIMILARITY) {
-      if (clip_data->inlier_mask != nullptr) {
-        for_function = &SerialFor<IrlsInitializationInvoker>;
-      }
+    if ((type == MODEL_TRANSLATION || type == MODEL_LINEAR_SIMILARITY) &&
+        clip_data->inlier_mask != nullptr) {
+      SerialFor(0, clip_data->num_frames(), 1, invoker);
+    } else {
+      ParallelFor(0, clip_data->num_frames(), 1, invoker, executor_);
     }
-
-    for_function(0, clip_data->num_frames(), 1, invoker);
   } else {
     CHECK_GE(frame, 0);
     CHECK_LT(frame, clip_data->num_frames());
@@ -2973,37 +2968,46 @@ float MotionEstimation::IRLSPriorWeight(int iteration, int irls_rounds) const {
 
 namespace {
 
-// Returns weighted translational model from feature_list.
-Vector2_f EstimateTranslationModelFloat(
-    const RegionFlowFeatureList& feature_list) {
-  Vector2_f mean_motion(0, 0);
-  float weight_sum = 0;
-  for (const auto& feature : feature_list.feature()) {
-    mean_motion += FeatureFlow(feature) * feature.irls_weight();
-    weight_sum += feature.irls_weight();
-  }
-
-  if (weight_sum > 0) {
-    mean_motion *= (1.0f / weight_sum);
-  }
-  return mean_motion;
-}
-
-Vector2_f EstimateTranslationModelDouble(
-    const RegionFlowFeatureList& feature_list) {
-  Vector2_d mean_motion(0, 0);
-  double weight_sum = 0;
-  for (const auto& feature : feature_list.feature()) {
-    mean_motion +=
-        Vector2_d::Cast(FeatureFlow(feature)) * feature.irls_weight();
-    weight_sum += feature.irls_weight();
+// Updates each non-zero irls weight from the residual norm r of its feature
+// to numerator / (r * residual_scale + eps) if use_l0_norm is set, and to
+// numerator / (sqrt(r * residual_scale) + eps) otherwise. The numerator is one,
+// or the feature's prior blended with one by alpha if alpha is non-zero.
+// Evaluated on whole arrays, so that the divisions and square roots are
+// vectorized.
+void UpdateIrlsWeights(const std::vector<float>& residuals,
+                       float residual_scale, bool use_l0_norm,
+                       const std::vector<float>* priors, float alpha,
+                       std::vector<float>* irls_weights) {
+  const int num_features = irls_weights->size();
+  CHECK_EQ(num_features, residuals.size());
+  Eigen::Map<Eigen::ArrayXf> weights(irls_weights->data(), num_features);
+  const Eigen::ArrayXf scaled_residuals =
+      Eigen::Map<const Eigen::ArrayXf>(residuals.data(), num_features) *
+      residual_scale;
+
+  Eigen::ArrayXf numerators;
+  if (alpha == 0.0f) {
+    numerators.setOnes(num_features);
+  } else {
+    CHECK(priors != nullptr);
+    numerators =
+        Eigen::Map<const Eigen::ArrayXf>(priors->data(), num_features) *
+            alpha +
+        (1.0f - alpha);
   }
 
-  if (weight_sum > 0) {
-    mean_motion *= (1.0 / weight_sum);
+  Eigen::ArrayXf updated_weights;
+  if (use_l0_norm) {
+    updated_weights = numerators / (scaled_residuals + kIrlsEps);
+  } else {
+    const double eps = kIrlsEps;
+    updated_weights = (numerators.cast<double>() /
+                       (scaled_residuals.cast<double>().sqrt() + eps))
+                          .cast<float>();
   }
 
-  return Vector2_f::Cast(mean_motion);
+  // Features with zero weight are ignored.
+  weights = (weights == 0.0f).select(weights, updated_weights);
 }
 
 }  // namespace.
@@ -3181,45 +3185,32 @@ void MotionEstimation::EstimateTranslationModelIRLS(
     irls_alphas = &prior_weights->alphas;
   }
 
+  RegionFlowFeatureBuffer features(*flow_feature_list);
+  const std::vector<float>& dx = features.dx();
+  const std::vector<float>& dy = features.dy();
+  std::vector<float> residuals(features.size());
+
   Vector2_f mean_motion;
   for (int i = 0; i < irls_rounds; ++i) {
     if (options_.use_highest_accuracy_for_normal_equations()) {
-      mean_motion = EstimateTranslationModelDouble(*flow_feature_list);
+      mean_motion = features.WeightedMeanFlow<double>();
     } else {
-      mean_motion = EstimateTranslationModelFloat(*flow_feature_list);
+      mean_motion = features.WeightedMeanFlow<float>();
     }
 
-    const float alpha = irls_alphas != nullptr ? (*irls_alphas)[i] : 0.0f;
-    const float one_minus_alpha = 1.0f - alpha;
-
     // Update irls weights.
-    const auto feature_start = flow_feature_list->mutable_feature()->begin();
-    for (auto feature = feature_start;
-         feature != flow_feature_list->mutable_feature()->end(); ++feature) {
-      if (feature->irls_weight() == 0.0f) {
-        continue;
-      }
-
+    for (int k = 0; k < features.size(); ++k) {
       // Express difference in original domain.
-      const Vector2_f diff = LinearSimilarityAdapter::TransformPoint(
-          irls_transform_, FeatureFlow(*feature) - mean_motion);
-
-      const float numerator =
-          alpha == 0.0f ? 1.0f
-                        : ((*irls_priors)[feature - feature_start] * alpha +
-                           one_minus_alpha);
-
-      if (irls_use_l0_norm) {
-        feature->set_irls_weight(
-            numerator / (diff.Norm() * irls_residual_scale + kIrlsEps));
-      } else {
-        feature->set_irls_weight(
-            numerator /
-            (std::sqrt(static_cast<double>(diff.Norm() * irls_residual_scale)) +
-             kIrlsEps));
-      }
+      residuals[k] = LinearSimilarityAdapter::TransformPoint(
+                         irls_transform_, Vector2_f(dx[k], dy[k]) - mean_motion)
+                         .Norm();
     }
+
+    const float alpha = irls_alphas != nullptr ? (*irls_alphas)[i] : 0.0f;
+    UpdateIrlsWeights(residuals, irls_residual_scale, irls_use_l0_norm,
+                      irls_priors, alpha, features.mutable_irls_weight());
   }
+  features.CopyIrlsWeightsTo(flow_feature_list);
 
   // De-normalize translation.
   Vector2_f translation = LinearSimilarityAdapter::TransformPoint(
@@ -3260,71 +3251,20 @@ float MotionEstimation::TranslationVariance(
 namespace {
 
 // Solves for the linear similarity via normal equations,
-// using only the positions specified by features from the feature list.
+// using only the positions specified by features from the feature buffer.
 // Input matrix is expected to be a 4x4 matrix of type T, rhs and solution are
 // both 4x1 vectors of type T.
 // Template class T specifies the desired accuracy, use float or double.
 template <class T>
 LinearSimilarityModel LinearSimilarityL2SolveSystem(
-    const RegionFlowFeatureList& feature_list, Eigen::Matrix<T, 4, 4>* matrix,
+    const RegionFlowFeatureBuffer& features, Eigen::Matrix<T, 4, 4>* matrix,
     Eigen::Matrix<T, 4, 1>* rhs, Eigen::Matrix<T, 4, 1>* solution,
     bool* success) {
   CHECK(matrix != nullptr);
   CHECK(rhs != nullptr);
   CHECK(solution != nullptr);
 
-  *matrix = Eigen::Matrix<T, 4, 4>::Zero();
-  *rhs = Eigen::Matrix<T, 4, 1>::Zero();
-
-  // Matrix multiplications are hand-coded for speed improvements vs.
-  // opencv's cvGEMM calls.
-  for (const auto& feature : feature_list.feature()) {
-    const T x = feature.x();
-    const T y = feature.y();
-    const T w = feature.irls_weight();
-
-    // double J[2 * 4] = {1, 0, x,  -y,
-    //                    0, 1, y,   x};
-    // Compute J^t * J * w = {1,  0,   x,    -y
-    //                        0,  1,   y,     x,
-    //                        x,  y,   xx+yy, 0,
-    //                        -y  x,   0,     xx+yy} * w;
-
-    const T x_w = x * w;
-    const T y_w = y * w;
-    const T xx_yy_w = (x * x + y * y) * w;
-
-    T* matrix_ptr = matrix->data();
-    matrix_ptr[0] += w;
-    matrix_ptr[2] += x_w;
-    matrix_ptr[3] += -y_w;
-
-    matrix_ptr += 4;
-    matrix_ptr[1] += w;
-    matrix_ptr[2] += y_w;
-    matrix_ptr[3] += x_w;
-
-    matrix_ptr += 4;
-    matrix_ptr[0] += x_w;
-    matrix_ptr[1] += y_w;
-    matrix_ptr[2] += xx_yy_w;
-
-    matrix_ptr += 4;
-    matrix_ptr[0] += -y_w;
-    matrix_ptr[1] += x_w;
-    matrix_ptr[3] += xx_yy_w;
-
-    T* rhs_ptr = rhs->data();
-
-    // Using identity parametrization below.
-    const T m_x = feature.dx() * w;
-    const T m_y = feature.dy() * w;
-
-    rhs_ptr[0] += m_x;
-    rhs_ptr[1] += m_y;
-    rhs_ptr[2] += x * m_x + y * m_y;
-    rhs_ptr[3] += -y * m_x + x * m_y;
-  }
+  features.LinearSimilarityNormalEquations(matrix, rhs);
 
   // Solution parameters p.
   *solution = matrix->colPivHouseholderQr().solve(*rhs);
@@ -3406,7 +3346,7 @@ bool MotionEstimation::GetSimilarityIrlsInitialization(
     ResetRegionFlowFeatureIRLSWeights(1.0f, &to_test);
     bool success = false;
     LinearSimilarityModel similarity = LinearSimilarityL2SolveSystem<float>(
-        to_test, &matrix, &rhs, &solution, &success);
+        RegionFlowFeatureBuffer(to_test), &matrix, &rhs, &solution, &success);
     if (!success) {
       continue;
     }
@@ -3562,57 +3502,49 @@ bool MotionEstimation::EstimateLinearSimilarityModelIRLS(
     irls_alphas = &prior_weights->alphas;
   }
 
+  RegionFlowFeatureBuffer features(*flow_feature_list);
+  const std::vector<float>& x = features.x();
+  const std::vector<float>& y = features.y();
+  const std::vector<float>& dx = features.dx();
+  const std::vector<float>& dy = features.dy();
+  std::vector<float> residuals(features.size());
+
   for (int i = 0; i < irls_rounds; ++i) {
     bool success;
     if (options_.use_highest_accuracy_for_normal_equations()) {
       *solved_model = LinearSimilarityL2SolveSystem<double>(
-          *flow_feature_list, &matrix_d, &rhs_d, &solution_d, &success);
+          features, &matrix_d, &rhs_d, &solution_d, &success);
     } else {
       *solved_model = LinearSimilarityL2SolveSystem<float>(
-          *flow_feature_list, &matrix_f, &rhs_f, &solution_f, &success);
+          features, &matrix_f, &rhs_f, &solution_f, &success);
     }
 
     if (!success) {
       VLOG(1) << "Linear similarity estimation failed.";
+      features.CopyIrlsWeightsTo(flow_feature_list);
       *camera_motion->mutable_linear_similarity() = LinearSimilarityModel();
       camera_motion->set_flags(camera_motion->flags() |
                                CameraMotion::FLAG_SINGULAR_ESTIMATION);
       return false;
     }
 
-    const float alpha = irls_alphas != nullptr ? (*irls_alphas)[i] : 0.0f;
-    const float one_minus_alpha = 1.0f - alpha;
-
-    const auto feature_start = flow_feature_list->mutable_feature()->begin();
-    for (auto feature = feature_start;
-         feature != flow_feature_list->mutable_feature()->end(); ++feature) {
-      if (feature->irls_weight() == 0.0f) {
-        continue;
-      }
-
-      const Vector2_f trans_location = LinearSimilarityAdapter::TransformPoint(
-          *solved_model, FeatureLocation(*feature));
-      const Vector2_f matched_location = FeatureMatchLocation(*feature);
+    for (int k = 0; k < features.size(); ++k) {
+      const Vector2_f location(x[k], y[k]);
+      const Vector2_f trans_location =
+          LinearSimilarityAdapter::TransformPoint(*solved_model, location);
+      const Vector2_f matched_location = location + Vector2_f(dx[k], dy[k]);
 
       // Express residual in frame coordinates.
-      const Vector2_f residual = LinearSimilarityAdapter::TransformPoint(
-          irls_transform_, trans_location - matched_location);
-      const float numerator =
-          alpha == 0.0f ? 1.0f
-                        : ((*irls_priors)[feature - feature_start] * alpha +
-                           one_minus_alpha);
-
-      if (irls_use_l0_norm) {
-        feature->set_irls_weight(
-            numerator / (residual.Norm() * irls_residual_scale + kIrlsEps));
-      } else {
-        feature->set_irls_weight(
-            numerator / (std::sqrt(static_cast<double>(residual.Norm() *
-                                                       irls_residual_scale)) +
-                         kIrlsEps));
-      }
+      residuals[k] = LinearSimilarityAdapter::TransformPoint(
+                         irls_transform_, trans_location - matched_location)
+                         .Norm();
     }
+
+    const float alpha = irls_alphas != nullptr ? (*irls_alphas)[i] : 0.0f;
+    UpdateIrlsWeights(residuals, irls_residual_scale, irls_use_l0_norm,
+                      irls_priors, alpha, features.mutable_irls_weight());
   }
+  features.CopyIrlsWeightsTo(flow_feature_list);
 
   // Undo pre_transform.
   *solved_model = ModelCompose3(inv_normalization_transform_, *solved_model,
@@ -3754,7 +3686,7 @@ bool MotionEstimation::EstimateAffineModelIRLS(
 // Returns false if system could not be solved for.
 template <class T>
 bool HomographyL2QRSolve(
-    const RegionFlowFeatureList& feature_list,
+    const RegionFlowFeatureBuffer& features,
     const Homography* prev_solution,  // optional.
     float perspective_regularizer,
     Eigen::Matrix<T, Eigen::Dynamic, 8>* matrix,  // tmp matrix
@@ -3763,7 +3695,7 @@ bool HomographyL2QRSolve(
   CHECK(solution);
   CHECK_EQ(8, matrix->cols());
   const int num_rows =
-      2 * feature_list.feature_size() + (perspective_regularizer == 0 ? 0 : 1);
+      2 * features.size() + (perspective_regularizer == 0 ? 0 : 1);
   CHECK_EQ(num_rows, matrix->rows());
   CHECK_EQ(1, solution->cols());
   CHECK_EQ(8, solution->rows());
@@ -3773,18 +3705,17 @@ bool HomographyL2QRSolve(
   Eigen::Matrix<T, Eigen::Dynamic, 1> rhs =
       Eigen::Matrix<T, Eigen::Dynamic, 1>::Zero(matrix->rows(), 1);
 
-  if (RegionFlowFeatureIRLSSum(feature_list) > kMaxCondition) {
+  if (features.IrlsWeightSum() > kMaxCondition) {
     return false;
   }
 
   // Create matrix and rhs (using h_33 = 1 constraint).
-  int feature_idx = 0;
-  for (auto feature = feature_list.feature().begin();
-       feature != feature_list.feature().end(); ++feature, ++feature_idx) {
+  for (int feature_idx = 0; feature_idx < features.size(); ++feature_idx) {
     int feature_row = 2 * feature_idx;
 
-    Vector2_f pt = FeatureLocation(*feature);
-    Vector2_f prev_pt = FeatureMatchLocation(*feature);
+    Vector2_f pt(features.x()[feature_idx], features.y()[feature_idx]);
+    Vector2_f prev_pt =
+        pt + Vector2_f(features.dx()[feature_idx], features.dy()[feature_idx]);
     // Weight per feature.
     double scale = 1.0;
     if (prev_solution) {
@@ -3797,7 +3728,7 @@ bool HomographyL2QRSolve(
       }
     }
 
-    const float w = feature->irls_weight() * scale;
+    const float w = features.irls_weight()[feature_idx] * scale;
 
     // Scale feature with weight;
     Vector2_f pt_w = pt * w;
@@ -3824,7 +3755,7 @@ bool HomographyL2QRSolve(
   }
 
   if (perspective_regularizer > 0) {
-    int last_row_idx = 2 * feature_list.feature_size();
+    int last_row_idx = 2 * features.size();
     (*matrix)(last_row_idx, 6) = (*matrix)(last_row_idx, 7) =
         perspective_regularizer;
   }
@@ -3835,7 +3766,7 @@ bool HomographyL2QRSolve(
 }
 
 // Same as function above, but solves for homography via normal equations,
-// using only the positions specified by features from the feature list.
+// using only the positions specified by features from the feature buffer.
 // Expects 8x8 matrix of type T and 8x1 rhs and solution vector of type T.
 // Optional parameter is prev_solution, in which case each row is scaled by
 // correct denominator (see derivation at function description
@@ -3843,7 +3774,7 @@ bool HomographyL2QRSolve(
 // Template class T specifies the desired accuracy, use float or double.
 template <class T>
 Homography HomographyL2NormalEquationSolve(
-    const RegionFlowFeatureList& feature_list,
+    const RegionFlowFeatureBuffer& features,
     const Homography* prev_solution,  // optional.
     float perspective_regularizer, Eigen::Matrix<T, 8, 8>* matrix,
     Eigen::Matrix<T, 8, 1>* rhs, Eigen::Matrix<T, 8, 1>* solution,
@@ -3852,133 +3783,26 @@ Homography HomographyL2NormalEquationSolve(
   CHECK(rhs != nullptr);
   CHECK(solution != nullptr);
 
-  *matrix = Eigen::Matrix<T, 8, 8>::Zero();
-  *rhs = Eigen::Matrix<T, 8, 1>::Zero();
-
-  // Matrix multiplications are hand-coded for speed improvements vs.
-  // opencv's cvGEMM calls.
-  for (const auto& feature : feature_list.feature()) {
-    T scale = 1.0;
-    if (prev_solution) {
-      const T denom = prev_solution->h_20() * feature.x() +
-                      prev_solution->h_21() * feature.y() + 1.0;
-      if (fabs(denom) > 1e-5) {
-        scale /= denom;
-      } else {
-        scale = 0;
-      }
-    }
-    const T w = feature.irls_weight() * scale;
-    const T x = feature.x();
-    const T y = feature.y();
-    const T xw = x * w;
-    const T yw = y * w;
-    const T xxw = x * x * w;
-    const T yyw = y * y * w;
-    const T xyw = x * y * w;
-    const T mx = feature.x() + feature.dx();
-    const T my = feature.y() + feature.dy();
-
-    const T mxxyy = mx * mx + my * my;
-    // Jacobian
-    // double J[2 * 8] = {x, y, 1,  0,  0,   0, -x * m_x, -y * m_x,
-    //                   {0, 0, 0,  x,  y,   1, -x * m_y, -y * m_y}
-    //
-    // // Compute J^t * J * w =
-    // ( xx        xy    x      0       0    0    -xx*mx  -xy*mx    )
-    // ( xy        yy    y      0       0    0    -xy*mx  -yy*mx    )
-    // ( x         y     1      0       0    0     -x*mx   -y*mx    )
-    // ( 0         0     0     xx      xy    x    -xx*my  -xy*my    )
-    // ( 0         0     0     xy      yy    y    -xy*my  -yy*my    )
-    // ( 0         0     0      x      y     1     -x*my   -y*my    )
-    // ( -xx*mx -xy*mx -x*mx -xx*my -xy*my -x*my xx*mxxyy  xy*mxxyy )
-    // ( -xy*mx -yy*mx -y*mx -xy*my -yy*my -y*my xy*mxxyy  yy*mxxyy  ) * w
-
-    // 1st row:  xx        xy    x      0       0    0    -xx*mx  -xy*mx
-    T* matrix_ptr = matrix->data();
-    matrix_ptr[0] += xxw;
-    matrix_ptr[1] += xyw;
-    matrix_ptr[2] += xw;
-    matrix_ptr[6] += -xxw * mx;
-    matrix_ptr[7] += -xyw * mx;
-
-    // 2nd row:  xy       yy   y      0       0    0    -xy*mx  -yy*mx
-    matrix_ptr += 8;
-    matrix_ptr[0] += xyw;
-    matrix_ptr[1] += yyw;
-    matrix_ptr[2] += yw;
-    matrix_ptr[6] += -xyw * mx;
-    matrix_ptr[7] += -yyw * mx;
-
-    // 3rd row: x         y     1      0       0    0     -x*mx   -y*mx
-    matrix_ptr += 8;
-    matrix_ptr[0] += xw;
-    matrix_ptr[1] += yw;
-    matrix_ptr[2] += w;
-    matrix_ptr[6] += -xw * mx;
-    matrix_ptr[7] += -yw * mx;
-
-    // 4th row: 0         0     0     xx      xy    x    -xx*my  -xy*my
-    matrix_ptr += 8;
-    matrix_ptr[3] += xxw;
-    matrix_ptr[4] += xyw;
-    matrix_ptr[5] += xw;
-    matrix_ptr[6] += -xxw * my;
-    matrix_ptr[7] += -xyw * my;
-
-    // 5th row: 0         0     0     xy      yy    y    -xy*my  -yy*my
-    matrix_ptr += 8;
-    matrix_ptr[3] += xyw;
-    matrix_ptr[4] += yyw;
-    matrix_ptr[5] += yw;
-    matrix_ptr[6] += -xyw * my;
-    matrix_ptr[7] += -yyw * my;
-
-    // 6th row:  0         0     0     x     y     1      -x*my    -y*my
-    matrix_ptr += 8;
-    matrix_ptr[3] += xw;
-    matrix_ptr[4] += yw;
-    matrix_ptr[5] += w;
-    matrix_ptr[6] += -xw * my;
-    matrix_ptr[7] += -yw * my;
-
-    // 7th row:  -xx*mx -xy*mx -x*mx -xx*my -xy*my -x*my xx*mxxyy  xy*mxxyy
-    matrix_ptr += 8;
-    matrix_ptr[0] += -xxw * mx;
-    matrix_ptr[1] += -xyw * mx;
-    matrix_ptr[2] += -xw * mx;
-    matrix_ptr[3] += -xxw * my;
-    matrix_ptr[4] += -xyw * my;
-    matrix_ptr[5] += -xw * my;
-    matrix_ptr[6] += xxw * mxxyy;
-    matrix_ptr[7] += xyw * mxxyy;
-
-    // 8th row: -xy*mx -yy*mx -y*mx -xy*my -yy*my -y*my xy*mxxyy  yy*mxxyy
-    matrix_ptr += 8;
-    matrix_ptr[0] += -xyw * mx;
-    matrix_ptr[1] += -yyw * mx;
-    matrix_ptr[2] += -yw * mx;
-    matrix_ptr[3] += -xyw * my;
-    matrix_ptr[4] += -yyw * my;
-    matrix_ptr[5] += -yw * my;
-    matrix_ptr[6] += xyw * mxxyy;
-    matrix_ptr[7] += yyw * mxxyy;
-
-    // Right hand side:
-    // b = ( x
-    //       y )
-    // Compute J^t * b  * w =
-    // ( x*mx  y*mx  mx  x*my  y*my  my  -x*mxxyy -y*mxxyy ) * w
-    T* rhs_ptr = rhs->data();
-    rhs_ptr[0] += xw * mx;
-    rhs_ptr[1] += yw * mx;
-    rhs_ptr[2] += mx * w;
-    rhs_ptr[3] += xw * my;
-    rhs_ptr[4] += yw * my;
-    rhs_ptr[5] += my * w;
-    rhs_ptr[6] += -xw * mxxyy;
-    rhs_ptr[7] += -yw * mxxyy;
-  }
+  // Jacobian
+  // double J[2 * 8] = {x, y, 1,  0,  0,   0, -x * m_x, -y * m_x,
+  //                   {0, 0, 0,  x,  y,   1, -x * m_y, -y * m_y}
+  //
+  // // Compute J^t * J * w =
+  // ( xx        xy    x      0       0    0    -xx*mx  -xy*mx    )
+  // ( xy        yy    y      0       0    0    -xy*mx  -yy*mx    )
+  // ( x         y     1      0       0    0     -x*mx   -y*mx    )
+  // ( 0         0     0     xx      xy    x    -xx*my  -xy*my    )
+  // ( 0         0     0     xy      yy    y    -xy*my  -yy*my    )
+  // ( 0         0     0      x      y     1     -x*my   -y*my    )
+  // ( -xx*mx -xy*mx -x*mx -xx*my -xy*my -x*my xx*mxxyy  xy*mxxyy )
+  // ( -xy*mx -yy*mx -y*mx -xy*my -yy*my -y*my xy*mxxyy  yy*mxxyy  ) * w
+  //
+  // Right hand side:
+  // b = ( x
+  //       y )
+  // Compute J^t * b  * w =
+  // ( x*mx  y*mx  mx  x*my  y*my  my  -x*mxxyy -y*mxxyy ) * w
+  features.HomographyNormalEquations(prev_solution, matrix, rhs);
 
   if (perspective_regularizer > 0) {
     // Additional constraint:
@@ -4028,9 +3852,9 @@ Homography HomographyL2NormalEquationSolve(
 
 namespace {
 
-float PatchDescriptorIRLSWeight(const RegionFlowFeature& feature) {
-  float weight = feature.irls_weight();
-
+// Returns the factor by which the irls weight of feature is scaled in the
+// mixture solves below.
+float PatchDescriptorIRLSScale(const RegionFlowFeature& feature) {
   // Blend weight to combine irls weight with a feature's path standard
   // deviation.
   const float alpha = 0.7f;
@@ -4042,15 +3866,16 @@ float PatchDescriptorIRLSWeight(const RegionFlowFeature& feature) {
       PatchDescriptorColorStdevL1(feature.feature_descriptor());
 
   if (feature_stdev_l1 >= 0.0f) {
-    weight *= alpha + (1.f - alpha) * std::min(1.f, feature_stdev_l1 * denom);
+    return alpha + (1.f - alpha) * std::min(1.f, feature_stdev_l1 * denom);
   }
 
-  return weight;
+  return 1.0f;
 }
 
 // Extension of above function to evenly spaced row-mixture models.
 bool MixtureHomographyL2DLTSolve(
-    const RegionFlowFeatureList& feature_list, int num_models,
+    const RegionFlowFeatureBuffer& features,
+    const std::vector<float>& patch_scales, int num_models,
     const MixtureRowWeights& row_weights, float regularizer_lambda,
     Eigen::MatrixXf* matrix,  // least squares matrix
     Eigen::MatrixXf* solution) {
@@ -4058,7 +3883,7 @@ bool MixtureHomographyL2DLTSolve(
   CHECK(solution);
 
   // cv::solve can hang for really bad conditioned systems.
-  const double feature_irls_sum = RegionFlowFeatureIRLSSum(feature_list);
+  const double feature_irls_sum = features.IrlsWeightSum();
   if (feature_irls_sum > kMaxCondition) {
     return false;
   }
@@ -4068,7 +3893,7 @@ bool MixtureHomographyL2DLTSolve(
 
   CHECK_EQ(matrix->cols(), num_dof);
   // 2 Rows (x,y) per feature.
-  CHECK_EQ(matrix->rows(), 2 * feature_list.feature_size() + num_constraints);
+  CHECK_EQ(matrix->rows(), 2 * features.size() + num_constraints);
   CHECK_EQ(solution->cols(), 1);
   CHECK_EQ(solution->rows(), num_dof);
 
@@ -4081,22 +3906,23 @@ bool MixtureHomographyL2DLTSolve(
   float irls_denom = 1.0 / (feature_irls_sum + 1e-6);
 
   // Create matrix for DLT.
-  int feature_idx = 0;
-  for (auto feature = feature_list.feature().begin();
-       feature != feature_list.feature().end(); ++feature, ++feature_idx) {
+  for (int feature_idx = 0; feature_idx < features.size(); ++feature_idx) {
     float* mat_row_1 = matrix->row(2 * feature_idx).data();
     float* mat_row_2 = matrix->row(2 * feature_idx + 1).data();
     float* rhs_row_1 = rhs.row(2 * feature_idx).data();
     float* rhs_row_2 = rhs.row(2 * feature_idx + 1).data();
 
-    Vector2_f pt = FeatureLocation(*feature);
-    Vector2_f prev_pt = FeatureMatchLocation(*feature);
+    const float y = features.y()[feature_idx];
+    Vector2_f pt(features.x()[feature_idx], y);
+    Vector2_f prev_pt =
+        pt + Vector2_f(features.dx()[feature_idx], features.dy()[feature_idx]);
     // Weight per feature.
-    const float f_w = PatchDescriptorIRLSWeight(*feature) * irls_denom;
+    const float f_w = features.irls_weight()[feature_idx] *
+                      patch_scales[feature_idx] * irls_denom;
 
     // Scale feature point by weight;
     Vector2_f pt_w = pt * f_w;
-    const float* mix_weights = row_weights.RowWeightsClamped(feature->y());
+    const float* mix_weights = row_weights.RowWeightsClamped(y);
 
     for (int m = 0; m < num_models; ++m, mat_row_1 += 8, mat_row_2 += 8) {
       const float w = mix_weights[m];
@@ -4126,7 +3952,7 @@ bool MixtureHomographyL2DLTSolve(
   // to roughly obtain similar magnitudes across parameters.
   const float param_weights[8] = {1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 100.f, 100.f};
 
-  const int reg_row_start = 2 * feature_list.feature_size();
+  const int reg_row_start = 2 * features.size();
   for (int m = 0; m < num_models - 1; ++m) {
     for (int p = 0; p < 8; ++p) {
       const int curr_idx = m * 8 + p;
@@ -4146,7 +3972,8 @@ bool MixtureHomographyL2DLTSolve(
 // strictly affine and perspective part (4 + 2 = 6 DOF) being constant across
 // the mixtures.
 bool TransMixtureHomographyL2DLTSolve(
-    const RegionFlowFeatureList& feature_list, int num_models,
+    const RegionFlowFeatureBuffer& features,
+    const std::vector<float>& patch_scales, int num_models,
     const MixtureRowWeights& row_weights, float regularizer_lambda,
     Eigen::MatrixXf* matrix,  // least squares matrix
     Eigen::MatrixXf* solution) {
@@ -4154,7 +3981,7 @@ bool TransMixtureHomographyL2DLTSolve(
   CHECK(solution);
 
   // cv::solve can hang for really bad conditioned systems.
-  const double feature_irls_sum = RegionFlowFeatureIRLSSum(feature_list);
+  const double feature_irls_sum = features.IrlsWeightSum();
   if (feature_irls_sum > kMaxCondition) {
     return false;
   }
@@ -4164,7 +3991,7 @@ bool TransMixtureHomographyL2DLTSolve(
 
   CHECK_EQ(matrix->cols(), num_dof);
   // 2 Rows (x,y) per feature.
-  CHECK_EQ(matrix->rows(), 2 * feature_list.feature_size() + num_constraints);
+  CHECK_EQ(matrix->rows(), 2 * features.size() + num_constraints);
   CHECK_EQ(solution->cols(), 1);
   CHECK_EQ(solution->rows(), num_dof);
 
@@ -4173,28 +4000,28 @@ bool TransMixtureHomographyL2DLTSolve(
   Eigen::Matrix<float, Eigen::Dynamic, 1> rhs =
       Eigen::MatrixXf::Zero(matrix->rows(), 1);
 
-  // Create matrix for DLT.
-  int feature_idx = 0;
-
   // Normalize feature sum to 1.
   float irls_denom = 1.0 / (feature_irls_sum + 1e-6);
 
-  for (auto feature = feature_list.feature().begin();
-       feature != feature_list.feature().end(); ++feature, ++feature_idx) {
+  // Create matrix for DLT.
+  for (int feature_idx = 0; feature_idx < features.size(); ++feature_idx) {
     float* mat_row_1 = matrix->row(2 * feature_idx).data();
     float* mat_row_2 = matrix->row(2 * feature_idx + 1).data();
     float* rhs_row_1 = rhs.row(2 * feature_idx).data();
     float* rhs_row_2 = rhs.row(2 * feature_idx + 1).data();
 
-    Vector2_f pt = FeatureLocation(*feature);
-    Vector2_f prev_pt = FeatureMatchLocation(*feature);
+    const float y = features.y()[feature_idx];
+    Vector2_f pt(features.x()[feature_idx], y);
+    Vector2_f prev_pt =
+        pt + Vector2_f(features.dx()[feature_idx], features.dy()[feature_idx]);
 
     // Weight per feature.
-    const float f_w = PatchDescriptorIRLSWeight(*feature) * irls_denom;
+    const float f_w = features.irls_weight()[feature_idx] *
+                      patch_scales[feature_idx] * irls_denom;
 
     // Scale feature point by weight.
     Vector2_f pt_w = pt * f_w;
-    const float* mix_weights = row_weights.RowWeightsClamped(feature->y());
+    const float* mix_weights = row_weights.RowWeightsClamped(y);
 
     // Entries 0 .. 1 are zero.
     mat_row_1[2] = -pt_w.x();
@@ -4224,7 +4051,7 @@ bool TransMixtureHomographyL2DLTSolve(
     }
   }
 
-  const int reg_row_start = 2 * feature_list.feature_size();
+  const int reg_row_start = 2 * features.size();
   int constraint_idx = 0;
   for (int m = 0; m < num_models - 1; ++m) {
     for (int p = 0; p < 2; ++p, ++constraint_idx) {
@@ -4245,7 +4072,8 @@ bool TransMixtureHomographyL2DLTSolve(
 // of size num_models, with scale and perspective part (2 + 2 = 4 DOF) being
 // constant across the mixtures.
 bool SkewRotMixtureHomographyL2DLTSolve(
-    const RegionFlowFeatureList& feature_list, int num_models,
+    const RegionFlowFeatureBuffer& features,
+    const std::vector<float>& patch_scales, int num_models,
     const MixtureRowWeights& row_weights, float regularizer_lambda,
     Eigen::MatrixXf* matrix,  // least squares matrix
     Eigen::MatrixXf* solution) {
@@ -4253,7 +4081,7 @@ bool SkewRotMixtureHomographyL2DLTSolve(
   CHECK(solution);
 
   // cv::solve can hang for really bad conditioned systems.
-  const double feature_irls_sum = RegionFlowFeatureIRLSSum(feature_list);
+  const double feature_irls_sum = features.IrlsWeightSum();
   if (feature_irls_sum > kMaxCondition) {
     return false;
   }
@@ -4263,7 +4091,7 @@ bool SkewRotMixtureHomographyL2DLTSolve(
 
   CHECK_EQ(matrix->cols(), num_dof);
   // 2 Rows (x,y) per feature.
-  CHECK_EQ(matrix->rows(), 2 * feature_list.feature_size() + num_constraints);
+  CHECK_EQ(matrix->rows(), 2 * features.size() + num_constraints);
   CHECK_EQ(solution->cols(), 1);
   CHECK_EQ(solution->rows(), num_dof);
 
@@ -4272,23 +4100,23 @@ bool SkewRotMixtureHomographyL2DLTSolve(
   Eigen::Matrix<float, Eigen::Dynamic, 1> rhs =
       Eigen::MatrixXf::Zero(matrix->rows(), 1);
 
-  // Create matrix for DLT.
-  int feature_idx = 0;
-
   // Normalize feature sum to 1.
   float irls_denom = 1.0 / (feature_irls_sum + 1e-6);
 
-  for (auto feature = feature_list.feature().begin();
-       feature != feature_list.feature().end(); ++feature, ++feature_idx) {
-    Vector2_f pt = FeatureLocation(*feature);
-    Vector2_f prev_pt = FeatureMatchLocation(*feature);
+  // Create matrix for DLT.
+  for (int feature_idx = 0; feature_idx < features.size(); ++feature_idx) {
+    const float y = features.y()[feature_idx];
+    Vector2_f pt(features.x()[feature_idx], y);
+    Vector2_f prev_pt =
+        pt + Vector2_f(features.dx()[feature_idx], features.dy()[feature_idx]);
 
     // Weight per feature.
-    const float f_w = PatchDescriptorIRLSWeight(*feature) * irls_denom;
+    const float f_w = features.irls_weight()[feature_idx] *
+                      patch_scales[feature_idx] * irls_denom;
 
     // Scale feature point by weight.
     Vector2_f pt_w = pt * f_w;
-    const float* mix_weights = row_weights.RowWeightsClamped(feature->y());
+    const float* mix_weights = row_weights.RowWeightsClamped(y);
 
     // Compare to MixtureHomographyDLTSolve.
     // Mapping of parameters (from homography to mixture) is as follows:
@@ -4326,7 +4154,7 @@ bool SkewRotMixtureHomographyL2DLTSolve(
     }
   }
 
-  const int reg_row_start = 2 * feature_list.feature_size();
+  const int reg_row_start = 2 * features.size();
   int constraint_idx = 0;
   for (int m = 0; m < num_models - 1; ++m) {
     for (int p = 0; p < 4; ++p, ++constraint_idx) {
@@ -4941,16 +4769,24 @@ bool MotionEstimation::EstimateHomographyIRLS(
     prev_solution = &norm_model;
   }
 
+  RegionFlowFeatureBuffer features(*feature_list);
+  const std::vector<float>& x = features.x();
+  const std::vector<float>& y = features.y();
+  const std::vector<float>& dx = features.dx();
+  const std::vector<float>& dy = features.dy();
+  std::vector<float> residuals(features.size());
+
   for (int r = 0; r < irls_rounds; ++r) {
     if (options_.use_exact_homography_estimation()) {
       bool success = false;
 
       success = HomographyL2QRSolve<float>(
-          *feature_list, prev_solution,
+          features, prev_solution,
           options_.homography_perspective_regularizer(), &matrix_e,
           &solution_e);
       if (!success) {
         VLOG(1) << "Could not solve for homography.";
+        features.CopyIrlsWeightsTo(feature_list);
         *camera_motion->mutable_homography() = Homography();
         camera_motion->set_flags(camera_motion->flags() |
                                  CameraMotion::FLAG_SINGULAR_ESTIMATION);
@@ -4963,18 +4799,19 @@ bool MotionEstimation::EstimateHomographyIRLS(
       if (options_.use_highest_accuracy_for_normal_equations()) {
         CHECK(!use_float);
         norm_model = HomographyL2NormalEquationSolve<double>(
-            *feature_list, prev_solution,
+            features, prev_solution,
             options_.homography_perspective_regularizer(), &matrix_d, &rhs_d,
             &solution_d, &success);
       } else {
         CHECK(use_float);
         norm_model = HomographyL2NormalEquationSolve<float>(
-            *feature_list, prev_solution,
+            features, prev_solution,
             options_.homography_perspective_regularizer(), &matrix_f, &rhs_f,
             &solution_f, &success);
       }
       if (!success) {
         VLOG(1) << "Could not solve for homography.";
+        features.CopyIrlsWeightsTo(feature_list);
         *camera_motion->mutable_homography() = Homography();
         camera_motion->set_flags(camera_motion->flags() |
                                  CameraMotion::FLAG_SINGULAR_ESTIMATION);
@@ -4982,50 +4819,30 @@ bool MotionEstimation::EstimateHomographyIRLS(
       }
     }
 
-    const float alpha = irls_alphas != nullptr ? (*irls_alphas)[r] : 0.0f;
-    const float one_minus_alpha = 1.0f - alpha;
-
     // Compute weights from registration errors.
-    const auto feature_start = feature_list->mutable_feature()->begin();
-    for (auto feature = feature_start;
-         feature != feature_list->mutable_feature()->end(); ++feature) {
-      // Ignored features marked as outliers.
-      if (feature->irls_weight() == 0.0f) {
-        continue;
-      }
-
+    for (int k = 0; k < features.size(); ++k) {
       // Residual is expressed as geometric difference, that is
       // for a point match (p<->q) with estimated homography p,
       // geometric difference is defined as Hp x q.
-      Vector2_f lhs = HomographyAdapter::TransformPoint(
-          norm_model, FeatureLocation(*feature));
+      const Vector2_f location(x[k], y[k]);
+      Vector2_f lhs = HomographyAdapter::TransformPoint(norm_model, location);
       // Map to original coordinate system to evaluate error.
       lhs = LinearSimilarityAdapter::TransformPoint(irls_transform_, lhs);
       const Vector3_f lhs3(lhs.x(), lhs.y(), 1);
       const Vector2_f rhs = LinearSimilarityAdapter::TransformPoint(
-          irls_transform_, FeatureMatchLocation(*feature));
+          irls_transform_, location + Vector2_f(dx[k], dy[k]));
 
       const Vector3_f rhs3(rhs.x(), rhs.y(), 1);
       const Vector3_f cross = lhs3.CrossProd(rhs3);
       // We only use the first 2 linearly independent rows.
-      const Vector2_f cross2(cross.x(), cross.y());
-
-      const float numerator =
-          alpha == 0.0f ? 1.0f
-                        : ((*irls_priors)[feature - feature_start] * alpha +
-                           one_minus_alpha);
-
-      if (irls_use_l0_norm) {
-        feature->set_irls_weight(
-            numerator / (cross2.Norm() * irls_residual_scale + kIrlsEps));
-      } else {
-        feature->set_irls_weight(
-            numerator / (std::sqrt(static_cast<double>(cross2.Norm() *
-                                                       irls_residual_scale)) +
-                         kIrlsEps));
-      }
+      residuals[k] = Vector2_f(cross.x(), cross.y()).Norm();
     }
+
+    const float alpha = irls_alphas != nullptr ? (*irls_alphas)[r] : 0.0f;
+    UpdateIrlsWeights(residuals, irls_residual_scale, irls_use_l0_norm,
+                      irls_priors, alpha, features.mutable_irls_weight());
   }
+  features.CopyIrlsWeightsTo(feature_list);
 
   // Undo pre_transform.
   Homography* model = camera_motion->mutable_homography();
@@ -5133,6 +4950,19 @@ bool MotionEstimation::MixtureHomographyFromFeature(
     irls_alphas = &prior_weights->alphas;
   }
 
+  RegionFlowFeatureBuffer features(*feature_list);
+  const std::vector<float>& x = features.x();
+  const std::vector<float>& y = features.y();
+  const std::vector<float>& dx = features.dx();
+  const std::vector<float>& dy = features.dy();
+  std::vector<float> residuals(features.size());
+
+  std::vector<float> patch_scales;
+  patch_scales.reserve(features.size());
+  for (const auto& feature : feature_list->feature()) {
+    patch_scales.push_back(PatchDescriptorIRLSScale(feature));
+  }
+
   for (int r = 0; r < irls_rounds; ++r) {
     // Unpack solution to mixture homographies, if not full model.
     std::vector<float> solution_unpacked(8 * num_mixtures);
@@ -5140,9 +4970,10 @@ bool MotionEstimation::MixtureHomographyFromFeature(
 
     switch (mixture_mode) {
       case MotionEstimationOptions::FULL_MIXTURE:
-        if (!MixtureHomographyL2DLTSolve(*feature_list, num_mixtures,
+        if (!MixtureHomographyL2DLTSolve(features, patch_scales, num_mixtures,
                                          *row_weights_, regularizer, &matrix,
                                          &solution)) {
+          features.CopyIrlsWeightsTo(feature_list);
           return false;
         }
         // No need to unpack solution.
@@ -5150,9 +4981,10 @@ bool MotionEstimation::MixtureHomographyFromFeature(
         break;
 
       case MotionEstimationOptions::TRANSLATION_MIXTURE:
-        if (!TransMixtureHomographyL2DLTSolve(*feature_list, num_mixtures,
-                                              *row_weights_, regularizer,
-                                              &matrix, &solution)) {
+        if (!TransMixtureHomographyL2DLTSolve(
+                features, patch_scales, num_mixtures, *row_weights_,
+                regularizer, &matrix, &solution)) {
+          features.CopyIrlsWeightsTo(feature_list);
           return false;
         }
         {
@@ -5172,9 +5004,10 @@ bool MotionEstimation::MixtureHomographyFromFeature(
         break;
 
       case MotionEstimationOptions::SKEW_ROTATION_MIXTURE:
-        if (!SkewRotMixtureHomographyL2DLTSolve(*feature_list, num_mixtures,
-                                                *row_weights_, regularizer,
-                                                &matrix, &solution)) {
+        if (!SkewRotMixtureHomographyL2DLTSolve(
+                features, patch_scales, num_mixtures, *row_weights_,
+                regularizer, &matrix, &solution)) {
+          features.CopyIrlsWeightsTo(feature_list);
           return false;
         }
         {
@@ -5200,50 +5033,33 @@ bool MotionEstimation::MixtureHomographyFromFeature(
     norm_model = MixtureHomographyAdapter::FromFloatPointer(
         solution_pointer, false, 0, num_mixtures);
 
-    const float alpha = irls_alphas != nullptr ? (*irls_alphas)[r] : 0.0f;
-    const float one_minus_alpha = 1.0f - alpha;
-
     // Evaluate IRLS error.
-    const auto feature_start = feature_list->mutable_feature()->begin();
-    for (auto feature = feature_start;
-         feature != feature_list->mutable_feature()->end(); ++feature) {
-      if (feature->irls_weight() == 0.0f) {
-        continue;
-      }
-
+    for (int k = 0; k < features.size(); ++k) {
       // Residual is expressed in geometric difference, that is
       // for a point match (p<->q) with estimated homography p,
       // geometric difference is defined as Hp x q.
+      const Vector2_f location(x[k], y[k]);
       Vector2_f lhs = MixtureHomographyAdapter::TransformPoint(
-          norm_model, row_weights_->RowWeightsClamped(feature->y()),
-          FeatureLocation(*feature));
+          norm_model, row_weights_->RowWeightsClamped(y[k]), location);
       // Map to original coordinate system to evaluate error.
       lhs = LinearSimilarityAdapter::TransformPoint(irls_transform_, lhs);
 
       const Vector3_f lhs3(lhs.x(), lhs.y(), 1);
       const Vector2_f rhs = LinearSimilarityAdapter::TransformPoint(
-          irls_transform_, FeatureMatchLocation(*feature));
+          irls_transform_, location + Vector2_f(dx[k], dy[k]));
 
       const Vector3_f rhs3(rhs.x(), rhs.y(), 1);
       const Vector3_f cross = lhs3.CrossProd(rhs3);
 
       // We only use the first 2 linearly independent rows.
-      const Vector2_f cross2(cross.x(), cross.y());
-
-      const float numerator =
-          alpha == 0.0f ? 1.0f
-                        : ((*irls_priors)[feature - feature_start] * alpha +
-                           one_minus_alpha);
-
-      if (irls_use_l0_norm) {
-        feature->set_irls_weight(numerator / (cross2.Norm() + kIrlsEps));
-      } else {
-        feature->set_irls_weight(
-            numerator /
-            (std::sqrt(static_cast<double>(cross2.Norm())) + kIrlsEps));
-      }
+      residuals[k] = Vector2_f(cross.x(), cross.y()).Norm();
     }
+
+    const float alpha = irls_alphas != nullptr ? (*irls_alphas)[r] : 0.0f;
+    UpdateIrlsWeights(residuals, 1.0f, irls_use_l0_norm, irls_priors, alpha,
+                      features.mutable_irls_weight());
   }
+  features.CopyIrlsWeightsTo(feature_list);
 
   // Undo pre_transform.
   *mix_homography = MixtureHomographyAdapter::ComposeLeft(
@@ -5467,7 +5283,8 @@ void MotionEstimation::DetermineOverlayIndices(
                                         DefaultModelOptions(), this,
                                         nullptr,  // No prior weights.
                                         nullptr,  // No thread storage here.
-                                        feature_lists, &translation_motions));
+                                        feature_lists, &translation_motions),
+              executor_);
 
   // Restore weights.
   for (int f = 0; f < num_frames; ++f) {
@@ -75,6 +75,7 @@ class RegionFlowFeatureList;
 class RegionFlowFrame;
 
 class EstimateMotionIRLSInvoker;
+class Executor;
 class InlierMask;
 class IrlsInitializationInvoker;
 // Thread local storage for pre-allocated memory.
@@ -93,6 +94,11 @@ class MotionEstimation {
   // EstimateMotionsParallel calls.
   void InitializeWithOptions(const MotionEstimationOptions& options);
 
+  // Runs the frame parallel estimation on executor, if not null, instead of
+  // the implementation selected in parallel_invoker.h. Executor must outlive
+  // this object.
+  void SetExecutor(Executor* executor) { executor_ = executor; }
+
   // Estimates motion models from RegionFlowFeatureLists based on
   // MotionEstimationOptions, in a multithreaded manner (frame parallel).
   // The computed IRLS weights used on the last iteration of the highest
@@ -624,6 +630,9 @@ class MotionEstimation {
   // For initialization biased towards previous frame.
   std::unique_ptr<InlierMask> inlier_mask_;
 
+  // Executor parallel loops run on, if set.
+  Executor* executor_ = nullptr;
+
   // Stores current bias for each track and the last K irls observations.
   struct LongFeatureBias {
     explicit LongFeatureBias(float initial_weight) : bias(initial_weight) {
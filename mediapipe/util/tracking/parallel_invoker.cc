@@ -14,6 +14,11 @@
 
 #include "mediapipe/util/tracking/parallel_invoker.h"
 
+#include <atomic>
+
+#include "absl/synchronization/notification.h"
+#include "mediapipe/framework/port/integral_types.h"
+
 // Choose between ThreadPool, OpenMP and serial execution.
 // Note only one parallel_using_* directive can be active.
 int flags_parallel_invoker_mode = PARALLEL_INVOKER_MAX_VALUE;
@@ -33,4 +38,133 @@ ThreadPool* ParallelInvokerThreadPool() {
 }
 #endif
 
+const GraphService<Executor> kParallelForExecutorService(
+    "kParallelForExecutorService");
+
+namespace internal {
+namespace {
+
+// Distributes chunks among workers. Each worker owns a range [begin, end) of
+// chunks, packed into one atomic word, from which it claims chunks at the
+// front while other workers steal at the back.
+class ChunkScheduler {
+ public:
+  ChunkScheduler(int num_chunks, int num_workers,
+                 std::function<void(int worker, int chunk)> run_chunk)
+      : num_chunks_(num_chunks),
+        num_workers_(num_workers),
+        run_chunk_(std::move(run_chunk)),
+        ranges_(new std::atomic<uint64>[num_workers]) {
+    for (int w = 0; w < num_workers; ++w) {
+      const int begin = static_cast<int64>(num_chunks) * w / num_workers;
+      const int end = static_cast<int64>(num_chunks) * (w + 1) / num_workers;
+      ranges_[w].store(PackRange(begin, end), std::memory_order_relaxed);
+    }
+  }
+
+  // Runs chunks as worker until no chunk is left to claim or steal.
+  void Work(int worker) {
+    int chunk;
+    while (true) {
+      if (!ClaimChunk(worker, &chunk)) {
+        if (StealChunks(worker)) continue;
+        break;
+      }
+      run_chunk_(worker, chunk);
+      if (num_done_.fetch_add(1, std::memory_order_acq_rel) + 1 ==
+          num_chunks_) {
+        done_.Notify();
+      }
+    }
+  }
+
+  // Blocks until all chunks have run. The acquire load orders the effects of
+  // all chunks before the return, as every worker counts its chunks with a
+  // release.
+  void WaitUntilDone() {
+    done_.WaitForNotification();
+    CHECK_EQ(num_chunks_, num_done_.load(std::memory_order_acquire));
+  }
+
+ private:
+  static uint64 PackRange(uint32 begin, uint32 end) {
+    return static_cast<uint64>(begin) << 32 | end;
+  }
+  static uint32 RangeBegin(uint64 range) { return range >> 32; }
+  static uint32 RangeEnd(uint64 range) { return range & 0xffffffff; }
+
+  // Claims the first chunk of the range of worker.
+  bool ClaimChunk(int worker, int* chunk) {
+    uint64 range = ranges_[worker].load(std::memory_order_acquire);
+    while (RangeBegin(range) < RangeEnd(range)) {
+      if (ranges_[worker].compare_exchange_weak(
+              range, PackRange(RangeBegin(range) + 1, RangeEnd(range)),
+              std::memory_order_acq_rel)) {
+        *chunk = RangeBegin(range);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Moves the upper half of the chunks left to another worker to the range of
+  // worker, which is empty. Only worker itself refills its range, so that a
+  // victim's range can not reappear with the same value (no ABA problem).
+  bool StealChunks(int worker) {
+    for (int i = 1; i < num_workers_; ++i) {
+      std::atomic<uint64>& victim = ranges_[(worker + i) % num_workers_];
+      uint64 range = victim.load(std::memory_order_acquire);
+      while (RangeBegin(range) < RangeEnd(range)) {
+        const uint32 middle =
+            RangeBegin(range) + (RangeEnd(range) - RangeBegin(range)) / 2;
+        if (victim.compare_exchange_weak(
+                range, PackRange(RangeBegin(range), middle),
+                std::memory_order_acq_rel)) {
+          ranges_[worker].store(PackRange(middle, RangeEnd(range)),
+                                std::memory_order_release);
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  const int num_chunks_;
+  const int num_workers_;
+  const std::function<void(int worker, int chunk)> run_chunk_;
+  std::unique_ptr<std::atomic<uint64>[]> ranges_;
+  std::atomic<int> num_done_{0};
+  absl::Notification done_;
+};
+
+}  // namespace
+
+void RunChunksOnExecutor(Executor* executor, int num_chunks, int num_workers,
+                         std::function<void(int worker, int chunk)> run_chunk) {
+  CHECK(executor != nullptr);
+  CHECK_GT(num_workers, 0);
+  if (num_chunks <= 0) {
+    return;
+  }
+  if (num_workers == 1 || num_chunks == 1) {
+    for (int chunk = 0; chunk < num_chunks; ++chunk) {
+      run_chunk(0, chunk);
+    }
+    return;
+  }
+
+  // Scheduled tasks share ownership of the scheduler, as they might only
+  // start once the calling thread has returned. By then, no chunk is left to
+  // run, and run_chunk is not invoked anymore.
+  auto scheduler = std::make_shared<ChunkScheduler>(num_chunks, num_workers,
+                                                    std::move(run_chunk));
+  for (int worker = 1; worker < num_workers; ++worker) {
+    executor->Schedule([scheduler, worker]() { scheduler->Work(worker); });
+  }
+  scheduler->Work(0);
+  scheduler->WaitUntilDone();
+}
+
+}  // namespace internal
+
 }  // namespace mediapipe
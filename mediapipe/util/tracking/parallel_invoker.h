@@ -63,15 +63,25 @@
 //       inputs[frame].copyTo(*(outputs)[frame]);
 //     }
 // }
+//
+// To share cores with a calculator graph, pass the graph's executor as last
+// argument. The iterations then run on that executor instead of the
+// implementation selected via flags_parallel_invoker_mode:
+// ParallelFor(0, num_frames, 1, CopyInvoker(inputs, &outputs), executor);
 
 #ifndef MEDIAPIPE_UTIL_TRACKING_PARALLEL_INVOKER_H_
 #define MEDIAPIPE_UTIL_TRACKING_PARALLEL_INVOKER_H_
 
 #include <stddef.h>
 
+#include <algorithm>
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/executor.h"
+#include "mediapipe/framework/graph_service.h"
 #include "mediapipe/framework/port/logging.h"
 
 #ifdef PARALLEL_INVOKER_ACTIVE
@@ -502,6 +512,79 @@ void ParallelFor2D(size_t start_row, size_t end_row, size_t start_col,
 #endif  // PARALLEL_INVOKER_ACTIVE
 }
 
+// The graph service that provides the executor parallel loops of tracking
+// calculators run on. Set it to the executor that runs the graph's nodes:
+//   graph.SetExecutor("", executor);
+//   graph.SetServiceObject(kParallelForExecutorService, executor);
+extern const GraphService<Executor> kParallelForExecutorService;
+
+namespace internal {
+
+// Runs run_chunk(worker, chunk) for each chunk in [0, num_chunks) on at most
+// num_workers workers: the calling thread and tasks scheduled on executor.
+// Chunks are split evenly between workers, and a worker that runs out of
+// chunks steals the upper half of the chunks left to another worker. Returns
+// once all chunks have run. The calling thread never waits for scheduled
+// tasks to start, which avoids deadlocks if all threads of executor are
+// busy, e.g. in nested loops.
+void RunChunksOnExecutor(Executor* executor, int num_chunks, int num_workers,
+                         std::function<void(int worker, int chunk)> run_chunk);
+
+}  // namespace internal
+
+// Same as above ParallelFor, but runs the iterations on executor if not null,
+// in blocks of grain_size iterations. Up to
+// flags_parallel_invoker_max_threads workers, each with its local copy of
+// invoker, run the blocks. Independent of PARALLEL_INVOKER_ACTIVE and
+// flags_parallel_invoker_mode.
+template <class Invoker>
+void ParallelFor(size_t start, size_t end, size_t grain_size,
+                 const Invoker& invoker, Executor* executor) {
+  if (executor == nullptr) {
+    ParallelFor(start, end, grain_size, invoker);
+    return;
+  }
+  const int num_chunks = (end - start + grain_size - 1) / grain_size;
+  CHECK_GT(num_chunks, 0);
+  std::vector<Invoker> invokers(
+      std::min(num_chunks, std::max(1, flags_parallel_invoker_max_threads)),
+      invoker);
+  internal::RunChunksOnExecutor(
+      executor, num_chunks, invokers.size(),
+      [start, end, grain_size, &invokers](int worker, int chunk) {
+        const size_t chunk_start = start + chunk * grain_size;
+        invokers[worker](BlockedRange(
+            chunk_start, std::min(end, chunk_start + grain_size), 1));
+      });
+}
+
+// Same as above ParallelFor2D, but runs on executor if not null, in blocks of
+// grain_size rows spanning all columns.
+template <class Invoker>
+void ParallelFor2D(size_t start_row, size_t end_row, size_t start_col,
+                   size_t end_col, size_t grain_size, const Invoker& invoker,
+                   Executor* executor) {
+  if (executor == nullptr) {
+    ParallelFor2D(start_row, end_row, start_col, end_col, grain_size, invoker);
+    return;
+  }
+  const int num_chunks = (end_row - start_row + grain_size - 1) / grain_size;
+  CHECK_GT(num_chunks, 0);
+  std::vector<Invoker> invokers(
+      std::min(num_chunks, std::max(1, flags_parallel_invoker_max_threads)),
+      invoker);
+  internal::RunChunksOnExecutor(
+      executor, num_chunks, invokers.size(),
+      [start_row, end_row, start_col, end_col, grain_size, &invokers](
+          int worker, int chunk) {
+        const size_t chunk_start = start_row + chunk * grain_size;
+        invokers[worker](BlockedRange2D(
+            BlockedRange(chunk_start,
+                         std::min(end_row, chunk_start + grain_size), 1),
+            BlockedRange(start_col, end_col, 1)));
+      });
+}
+
 }  // namespace mediapipe
 
 #endif  // MEDIAPIPE_UTIL_TRACKING_PARALLEL_INVOKER_H_
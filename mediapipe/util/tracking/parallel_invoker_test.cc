@@ -15,10 +15,12 @@
 #include "mediapipe/util/tracking/parallel_invoker.h"
 
 #include <algorithm>
+#include <atomic>
 #include <numeric>
 
 #include "absl/synchronization/mutex.h"
 #include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/thread_pool_executor.h"
 
 namespace mediapipe {
 namespace {
@@ -56,5 +58,62 @@ TEST(ParallelInvokerTest, ThreadPoolTest) {
   RunParallelTest();
 }
 
+TEST(ParallelInvokerTest, ExecutorTest) {
+  ThreadPoolExecutor executor(4);
+  const int kArraySize = 5000;
+  for (int grain_size : {1, 7, kArraySize, 2 * kArraySize}) {
+    std::vector<std::atomic<int>> counts(kArraySize);
+    ParallelFor(0, kArraySize, grain_size,
+                [&counts, grain_size](const BlockedRange& b) {
+                  EXPECT_LE(b.end() - b.begin(), grain_size);
+                  for (int k = b.begin(); k != b.end(); ++k) {
+                    ++counts[k];
+                  }
+                },
+                &executor);
+    for (int k = 0; k < kArraySize; ++k) {
+      ASSERT_EQ(1, counts[k]) << "at " << k << ", grain size " << grain_size;
+    }
+  }
+}
+
+TEST(ParallelInvokerTest, Executor2DTest) {
+  ThreadPoolExecutor executor(4);
+  const int kRows = 100;
+  const int kCols = 30;
+  std::vector<std::atomic<int>> counts(kRows * kCols);
+  ParallelFor2D(0, kRows, 0, kCols, 3,
+                [&counts](const BlockedRange2D& b) {
+                  for (int r = b.rows().begin(); r != b.rows().end(); ++r) {
+                    for (int c = b.cols().begin(); c != b.cols().end(); ++c) {
+                      ++counts[r * kCols + c];
+                    }
+                  }
+                },
+                &executor);
+  for (int k = 0; k < kRows * kCols; ++k) {
+    ASSERT_EQ(1, counts[k]) << "at " << k;
+  }
+}
+
+// Loops nested in the iterations of a loop on the same executor complete,
+// even though all threads of the executor are busy running outer iterations.
+TEST(ParallelInvokerTest, NestedExecutorTest) {
+  ThreadPoolExecutor executor(2);
+  const int kOuterSize = 16;
+  const int kInnerSize = 100;
+  std::atomic<int> count(0);
+  ParallelFor(0, kOuterSize, 1,
+              [&count, &executor](const BlockedRange& outer) {
+                ParallelFor(0, kInnerSize, 1,
+                            [&count](const BlockedRange& inner) {
+                              count += inner.end() - inner.begin();
+                            },
+                            &executor);
+              },
+              &executor);
+  EXPECT_EQ(kOuterSize * kInnerSize, count);
+}
+
 }  // namespace
 }  // namespace mediapipe
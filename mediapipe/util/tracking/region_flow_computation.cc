@@ -240,9 +240,11 @@ class PatchDescriptorInvoker {
 // feature_match_descriptor.
 // IMPORTANT: Ensure that patch_descriptor_rad <= distance_from_border in
 // GetRegionFlowFeatureList. Checked by function.
+// Runs on executor if not null, see ParallelFor.
 void ComputeRegionFlowFeatureDescriptors(
     const cv::Mat& rgb_frame, const cv::Mat* prev_rgb_frame,
-    int patch_descriptor_radius, RegionFlowFeatureList* flow_feature_list) {
+    int patch_descriptor_radius, Executor* executor,
+    RegionFlowFeatureList* flow_feature_list) {
   const int rows = rgb_frame.rows;
   const int cols = rgb_frame.cols;
   CHECK_EQ(rgb_frame.depth(), CV_8U);
@@ -260,7 +262,8 @@ void ComputeRegionFlowFeatureDescriptors(
   ParallelFor(
       0, flow_feature_list->feature_size(), 1,
       PatchDescriptorInvoker(rgb_frame, prev_rgb_frame, patch_descriptor_radius,
-                             flow_feature_list));
+                             flow_feature_list),
+      executor);
 }
 
 // Stores 2D location's of feature points and their corresponding descriptors,
@@ -884,7 +887,7 @@ RegionFlowComputation::RetrieveRegionFlowFeatureListImpl(
     ComputeRegionFlowFeatureDescriptors(
         *curr_color_image,
         compute_match_descriptor ? prev_color_image : nullptr,
-        options_.patch_descriptor_radius(), feature_list.get());
+        options_.patch_descriptor_radius(), executor_, feature_list.get());
   } else {
     CHECK(!compute_match_descriptor) << "Set compute_feature_descriptor also "
                                      << "if setting compute_match_descriptor";
@@ -1800,7 +1803,8 @@ void RegionFlowComputation::AdaptiveGoodFeaturesToTrack(
             bins_per_row, local_quality_level, lowest_quality_level,
             level_max_features, &corner_pointers, eig_image, tmp_image);
 
-        ParallelFor2D(0, bins_per_column, 0, bins_per_row, 1, locator);
+        ParallelFor2D(0, bins_per_column, 0, bins_per_row, 1, locator,
+                      executor_);
 
         // Round robin across bins, add one feature per bin, until
         // max_features is hit.
@@ -3130,7 +3134,8 @@ void RegionFlowComputation::ComputeBlockBasedFlow(
             grid_inliers[k].reserve(grid_feature_views[k].size());
             DetermineRegionFlowInliers(grid_feature_views[k], &grid_inliers[k]);
           }
-        });
+        },
+        executor_);
 
     for (int grid = 0; grid < num_grids; ++grid) {
       AppendUniqueFeaturesSorted(grid_inliers[grid], inlier_features);
@@ -68,6 +68,7 @@ namespace mediapipe {
 
 struct TrackedFeature;
 typedef std::vector<TrackedFeature> TrackedFeatureList;
+class Executor;
 class MotionAnalysis;
 
 class RegionFlowComputation {
@@ -78,6 +79,11 @@ class RegionFlowComputation {
   RegionFlowComputation(const RegionFlowComputation&) = delete;
   RegionFlowComputation& operator=(const RegionFlowComputation&) = delete;
 
+  // Runs parallel loops, e.g. feature extraction per grid bin, on executor if
+  // not null, instead of the implementation selected in parallel_invoker.h.
+  // Executor must outlive this object.
+  void SetExecutor(Executor* executor) { executor_ = executor; }
+
   // Performs motion analysis on source w.r.t. to source passed in previous
   // call. Therefore, first call will compute empty flow. If
   // RegionFlowComputationOptions::frame_to_track := ftt > 0, motion analysis
@@ -455,6 +461,9 @@ class RegionFlowComputation {
   // Extract descriptors only when counter == 0.
   int cnt_extract_descriptors_ = 0;
 
+  // Executor parallel loops run on, if set.
+  Executor* executor_ = nullptr;
+
   friend class MotionAnalysis;
 };
 
@@ -0,0 +1,271 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/tracking/region_flow_feature_buffer.h"
+
+#include <cmath>
+#include <type_traits>
+
+#include "mediapipe/framework/port/logging.h"
+
+namespace mediapipe {
+
+namespace {
+
+template <class T>
+using ArrayT = Eigen::Array<T, Eigen::Dynamic, 1>;
+
+// Returns values converted to an array of type T.
+template <class T>
+ArrayT<T> ToArray(const std::vector<float>& values) {
+  return Eigen::Map<const Eigen::ArrayXf>(values.data(), values.size())
+      .template cast<T>();
+}
+
+// Returns true if sums of type T are accumulated one feature at a time, in the
+// order of the feature list (see class comment).
+template <class T>
+bool SumsSequentially() {
+  return std::is_same<T, double>::value;
+}
+
+}  // namespace.
+
+void RegionFlowFeatureBuffer::Assign(
+    const RegionFlowFeatureList& feature_list) {
+  const int num_features = feature_list.feature_size();
+  x_.resize(num_features);
+  y_.resize(num_features);
+  dx_.resize(num_features);
+  dy_.resize(num_features);
+  irls_weight_.resize(num_features);
+  for (int i = 0; i < num_features; ++i) {
+    const RegionFlowFeature& feature = feature_list.feature(i);
+    x_[i] = feature.x();
+    y_[i] = feature.y();
+    dx_[i] = feature.dx();
+    dy_[i] = feature.dy();
+    irls_weight_[i] = feature.irls_weight();
+  }
+}
+
+void RegionFlowFeatureBuffer::CopyIrlsWeightsTo(
+    RegionFlowFeatureList* feature_list) const {
+  CHECK(feature_list != nullptr);
+  CHECK_EQ(size(), feature_list->feature_size());
+  for (int i = 0; i < size(); ++i) {
+    feature_list->mutable_feature(i)->set_irls_weight(irls_weight_[i]);
+  }
+}
+
+double RegionFlowFeatureBuffer::IrlsWeightSum() const {
+  double sum = 0.0;
+  for (const float weight : irls_weight_) {
+    sum += weight;
+  }
+  return sum;
+}
+
+template <class T>
+Vector2_f RegionFlowFeatureBuffer::WeightedMeanFlow() const {
+  T weight_sum = 0;
+  T flow_x = 0;
+  T flow_y = 0;
+  if (SumsSequentially<T>()) {
+    for (int i = 0; i < size(); ++i) {
+      const float w = irls_weight_[i];
+      flow_x += static_cast<T>(dx_[i]) * w;
+      flow_y += static_cast<T>(dy_[i]) * w;
+      weight_sum += w;
+    }
+  } else {
+    const ArrayT<T> w = ToArray<T>(irls_weight_);
+    weight_sum = w.sum();
+    flow_x = (ToArray<T>(dx_) * w).sum();
+    flow_y = (ToArray<T>(dy_) * w).sum();
+  }
+
+  if (weight_sum > 0) {
+    const T denom = T(1) / weight_sum;
+    flow_x *= denom;
+    flow_y *= denom;
+  }
+  return Vector2_f(flow_x, flow_y);
+}
+
+template <class T>
+void RegionFlowFeatureBuffer::LinearSimilarityNormalEquations(
+    Eigen::Matrix<T, 4, 4>* matrix, Eigen::Matrix<T, 4, 1>* rhs) const {
+  CHECK(matrix != nullptr);
+  CHECK(rhs != nullptr);
+
+  // J = {1, 0, x, -y,
+  //      0, 1, y,  x}, summing J^t * J * w and J^t * (dx, dy) * w.
+  T w_sum = 0;
+  T x_w_sum = 0;
+  T y_w_sum = 0;
+  T xx_yy_w_sum = 0;
+  rhs->setZero();
+  if (SumsSequentially<T>()) {
+    for (int i = 0; i < size(); ++i) {
+      const T x = x_[i];
+      const T y = y_[i];
+      const T w = irls_weight_[i];
+      w_sum += w;
+      x_w_sum += x * w;
+      y_w_sum += y * w;
+      xx_yy_w_sum += (x * x + y * y) * w;
+
+      const T m_x = dx_[i] * w;
+      const T m_y = dy_[i] * w;
+      (*rhs)(0) += m_x;
+      (*rhs)(1) += m_y;
+      (*rhs)(2) += x * m_x + y * m_y;
+      (*rhs)(3) += -y * m_x + x * m_y;
+    }
+  } else {
+    const ArrayT<T> x = ToArray<T>(x_);
+    const ArrayT<T> y = ToArray<T>(y_);
+    const ArrayT<T> w = ToArray<T>(irls_weight_);
+    const ArrayT<T> x_w = x * w;
+    const ArrayT<T> y_w = y * w;
+    const ArrayT<T> m_x = ToArray<T>(dx_) * w;
+    const ArrayT<T> m_y = ToArray<T>(dy_) * w;
+    w_sum = w.sum();
+    x_w_sum = x_w.sum();
+    y_w_sum = y_w.sum();
+    xx_yy_w_sum = (x * x_w + y * y_w).sum();
+    *rhs << m_x.sum(), m_y.sum(), (x * m_x + y * m_y).sum(),
+        (x * m_y - y * m_x).sum();
+  }
+
+  *matrix << w_sum, 0, x_w_sum, -y_w_sum,  //
+      0, w_sum, y_w_sum, x_w_sum,          //
+      x_w_sum, y_w_sum, xx_yy_w_sum, 0,    //
+      -y_w_sum, x_w_sum, 0, xx_yy_w_sum;
+}
+
+template <class T>
+void RegionFlowFeatureBuffer::HomographyNormalEquations(
+    const Homography* prev_solution, Eigen::Matrix<T, 8, 8>* matrix,
+    Eigen::Matrix<T, 8, 1>* rhs) const {
+  CHECK(matrix != nullptr);
+  CHECK(rhs != nullptr);
+
+  // Every entry of J^t * J * w and J^t * b * w (see
+  // HomographyL2NormalEquationSolve in motion_estimation.cc) is the sum over
+  // all features of a weighted monomial in x and y times a factor in mx and
+  // my, so that a single matrix product yields all of them.
+  enum { XX, XY, YY, X, Y, ONE };
+  enum { UNIT, MX, MY, MXXYY };
+  Eigen::Matrix<T, 6, 4> sums;
+  if (SumsSequentially<T>()) {
+    sums.setZero();
+    for (int i = 0; i < size(); ++i) {
+      T scale = 1.0;
+      if (prev_solution) {
+        const T denom = prev_solution->h_20() * x_[i] +
+                        prev_solution->h_21() * y_[i] + 1.0;
+        if (std::fabs(denom) > 1e-5) {
+          scale /= denom;
+        } else {
+          scale = 0;
+        }
+      }
+      const T w = irls_weight_[i] * scale;
+      const T x = x_[i];
+      const T y = y_[i];
+      const T mx = x_[i] + dx_[i];
+      const T my = y_[i] + dy_[i];
+
+      Eigen::Matrix<T, 6, 1> monomials;
+      monomials << x * x * w, x * y * w, y * y * w, x * w, y * w, w;
+      Eigen::Matrix<T, 1, 4> factors;
+      factors << 1, mx, my, mx * mx + my * my;
+      sums.noalias() += monomials * factors;
+    }
+  } else {
+    const int num_features = size();
+    const ArrayT<T> x = ToArray<T>(x_);
+    const ArrayT<T> y = ToArray<T>(y_);
+    ArrayT<T> w = ToArray<T>(irls_weight_);
+    if (prev_solution) {
+      const ArrayT<T> denom = x * T(prev_solution->h_20()) +
+                              y * T(prev_solution->h_21()) + T(1);
+      w *= (denom.abs() > T(1e-5)).select(denom.inverse(), T(0));
+    }
+    const ArrayT<T> mx = x + ToArray<T>(dx_);
+    const ArrayT<T> my = y + ToArray<T>(dy_);
+
+    Eigen::Matrix<T, Eigen::Dynamic, 6> monomials(num_features, 6);
+    monomials.col(X) = (x * w).matrix();
+    monomials.col(Y) = (y * w).matrix();
+    monomials.col(XX) = (x * x * w).matrix();
+    monomials.col(XY) = (x * y * w).matrix();
+    monomials.col(YY) = (y * y * w).matrix();
+    monomials.col(ONE) = w.matrix();
+
+    Eigen::Matrix<T, Eigen::Dynamic, 4> factors(num_features, 4);
+    factors.col(UNIT).setOnes();
+    factors.col(MX) = mx.matrix();
+    factors.col(MY) = my.matrix();
+    factors.col(MXXYY) = (mx * mx + my * my).matrix();
+
+    sums.noalias() = monomials.transpose() * factors;
+  }
+
+  // Affine blocks, identical for the x and y rows of J.
+  Eigen::Matrix<T, 3, 3> affine;
+  affine << sums(XX, UNIT), sums(XY, UNIT), sums(X, UNIT),  //
+      sums(XY, UNIT), sums(YY, UNIT), sums(Y, UNIT),        //
+      sums(X, UNIT), sums(Y, UNIT), sums(ONE, UNIT);
+  matrix->setZero();
+  matrix->template block<3, 3>(0, 0) = affine;
+  matrix->template block<3, 3>(3, 3) = affine;
+
+  // Perspective columns and, by symmetry, rows.
+  for (int r = 0; r < 2; ++r) {
+    const int factor = r == 0 ? MX : MY;
+    const int row = 3 * r;
+    (*matrix)(row, 6) = -sums(XX, factor);
+    (*matrix)(row + 1, 6) = -sums(XY, factor);
+    (*matrix)(row + 2, 6) = -sums(X, factor);
+    (*matrix)(row, 7) = -sums(XY, factor);
+    (*matrix)(row + 1, 7) = -sums(YY, factor);
+    (*matrix)(row + 2, 7) = -sums(Y, factor);
+  }
+  matrix->template block<2, 6>(6, 0) =
+      matrix->template block<6, 2>(0, 6).transpose();
+  (*matrix)(6, 6) = sums(XX, MXXYY);
+  (*matrix)(6, 7) = (*matrix)(7, 6) = sums(XY, MXXYY);
+  (*matrix)(7, 7) = sums(YY, MXXYY);
+
+  *rhs << sums(X, MX), sums(Y, MX), sums(ONE, MX), sums(X, MY), sums(Y, MY),
+      sums(ONE, MY), -sums(X, MXXYY), -sums(Y, MXXYY);
+}
+
+template Vector2_f RegionFlowFeatureBuffer::WeightedMeanFlow<float>() const;
+template Vector2_f RegionFlowFeatureBuffer::WeightedMeanFlow<double>() const;
+template void RegionFlowFeatureBuffer::LinearSimilarityNormalEquations<float>(
+    Eigen::Matrix<float, 4, 4>*, Eigen::Matrix<float, 4, 1>*) const;
+template void RegionFlowFeatureBuffer::LinearSimilarityNormalEquations<double>(
+    Eigen::Matrix<double, 4, 4>*, Eigen::Matrix<double, 4, 1>*) const;
+template void RegionFlowFeatureBuffer::HomographyNormalEquations<float>(
+    const Homography*, Eigen::Matrix<float, 8, 8>*,
+    Eigen::Matrix<float, 8, 1>*) const;
+template void RegionFlowFeatureBuffer::HomographyNormalEquations<double>(
+    const Homography*, Eigen::Matrix<double, 8, 8>*,
+    Eigen::Matrix<double, 8, 1>*) const;
+
+}  // namespace mediapipe
@@ -0,0 +1,95 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_UTIL_TRACKING_REGION_FLOW_FEATURE_BUFFER_H_
+#define MEDIAPIPE_UTIL_TRACKING_REGION_FLOW_FEATURE_BUFFER_H_
+
+#include <vector>
+
+#include "Eigen/Core"
+#include "mediapipe/framework/port/vector.h"
+#include "mediapipe/util/tracking/motion_models.pb.h"
+#include "mediapipe/util/tracking/region_flow.pb.h"
+
+namespace mediapipe {
+
+// Structure-of-arrays copy of the feature fields read and written by the IRLS
+// model estimation in MotionEstimation: location, flow and irls weight of
+// each feature, each field in a contiguous array.
+// Estimation copies a RegionFlowFeatureList once, runs all IRLS rounds on the
+// arrays, and writes the resulting irls weights back.
+// The sums below are templated on their accuracy T. Float sums are accumulated
+// with vectorized Eigen array and matrix products, which reorder the
+// summation. Double sums back use_highest_accuracy_for_normal_equations and
+// are accumulated one feature at a time in list order, as the per-feature
+// loops in MotionEstimation did, so that their results stay bit-identical.
+class RegionFlowFeatureBuffer {
+ public:
+  RegionFlowFeatureBuffer() = default;
+  explicit RegionFlowFeatureBuffer(const RegionFlowFeatureList& feature_list) {
+    Assign(feature_list);
+  }
+
+  // Replaces the buffered features with the ones of feature_list.
+  void Assign(const RegionFlowFeatureList& feature_list);
+
+  // Writes the buffered irls weights to the features of feature_list, which
+  // must hold the features passed to Assign() in the same order.
+  void CopyIrlsWeightsTo(RegionFlowFeatureList* feature_list) const;
+
+  int size() const { return x_.size(); }
+
+  const std::vector<float>& x() const { return x_; }
+  const std::vector<float>& y() const { return y_; }
+  const std::vector<float>& dx() const { return dx_; }
+  const std::vector<float>& dy() const { return dy_; }
+  const std::vector<float>& irls_weight() const { return irls_weight_; }
+  std::vector<float>* mutable_irls_weight() { return &irls_weight_; }
+
+  // Returns the sum of the irls weights, see RegionFlowFeatureIRLSSum.
+  double IrlsWeightSum() const;
+
+  // Returns the irls weighted mean of the flow, or zero if all weights are
+  // zero. T is float or double, specifying the accuracy of the accumulation.
+  template <class T>
+  Vector2_f WeightedMeanFlow() const;
+
+  // Sets matrix and rhs to the irls weighted normal equations of the linear
+  // similarity in identity parametrization (dx, dy, a - 1, b), mapping each
+  // feature location to its match location.
+  template <class T>
+  void LinearSimilarityNormalEquations(Eigen::Matrix<T, 4, 4>* matrix,
+                                       Eigen::Matrix<T, 4, 1>* rhs) const;
+
+  // Sets matrix and rhs to the irls weighted normal equations of the
+  // homography (h_00, h_01, h_02, h_10, h_11, h_12, h_20, h_21), mapping each
+  // feature location to its match location. If prev_solution is set, each
+  // feature's equations are scaled by the denominator of prev_solution at its
+  // location (see HomographyL2QRSolve in motion_estimation.cc).
+  template <class T>
+  void HomographyNormalEquations(const Homography* prev_solution,
+                                 Eigen::Matrix<T, 8, 8>* matrix,
+                                 Eigen::Matrix<T, 8, 1>* rhs) const;
+
+ private:
+  std::vector<float> x_;
+  std::vector<float> y_;
+  std::vector<float> dx_;
+  std::vector<float> dy_;
+  std::vector<float> irls_weight_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_TRACKING_REGION_FLOW_FEATURE_BUFFER_H_
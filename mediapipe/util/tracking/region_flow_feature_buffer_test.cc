@@ -0,0 +1,300 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/tracking/region_flow_feature_buffer.h"
+
+#include <random>
+
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+
+namespace mediapipe {
+namespace {
+
+// Returns num_features features in the unit square, with small flow and
+// irls weights in [0, 2], some of which are zero.
+RegionFlowFeatureList RandomFeatures(int num_features, std::mt19937* random) {
+  std::uniform_real_distribution<float> location(0.0f, 1.0f);
+  std::uniform_real_distribution<float> flow(-0.05f, 0.05f);
+  std::uniform_real_distribution<float> weight(0.0f, 2.0f);
+  RegionFlowFeatureList feature_list;
+  for (int i = 0; i < num_features; ++i) {
+    RegionFlowFeature* feature = feature_list.add_feature();
+    feature->set_x(location(*random));
+    feature->set_y(location(*random));
+    feature->set_dx(flow(*random));
+    feature->set_dy(flow(*random));
+    feature->set_irls_weight(i % 10 == 0 ? 0.0f : weight(*random));
+  }
+  return feature_list;
+}
+
+// Reference normal equations of the homography, from the Jacobian of each
+// feature.
+void ReferenceHomographyNormalEquations(
+    const RegionFlowFeatureList& feature_list, const Homography* prev_solution,
+    Eigen::Matrix<double, 8, 8>* matrix, Eigen::Matrix<double, 8, 1>* rhs) {
+  matrix->setZero();
+  rhs->setZero();
+  for (const auto& feature : feature_list.feature()) {
+    const double x = feature.x();
+    const double y = feature.y();
+    const double mx = x + feature.dx();
+    const double my = y + feature.dy();
+    double w = feature.irls_weight();
+    if (prev_solution) {
+      w /= prev_solution->h_20() * x + prev_solution->h_21() * y + 1.0;
+    }
+    Eigen::Matrix<double, 2, 8> jacobian;
+    jacobian << x, y, 1, 0, 0, 0, -x * mx, -y * mx,  //
+        0, 0, 0, x, y, 1, -x * my, -y * my;
+    const Eigen::Vector2d b(mx, my);
+    *matrix += jacobian.transpose() * jacobian * w;
+    *rhs += jacobian.transpose() * b * w;
+  }
+}
+
+TEST(RegionFlowFeatureBufferTest, AssignAndCopyWeights) {
+  std::mt19937 random(1);
+  RegionFlowFeatureList feature_list = RandomFeatures(20, &random);
+  RegionFlowFeatureBuffer features(feature_list);
+  ASSERT_EQ(20, features.size());
+  double weight_sum = 0;
+  for (int i = 0; i < features.size(); ++i) {
+    const RegionFlowFeature& feature = feature_list.feature(i);
+    EXPECT_EQ(feature.x(), features.x()[i]);
+    EXPECT_EQ(feature.y(), features.y()[i]);
+    EXPECT_EQ(feature.dx(), features.dx()[i]);
+    EXPECT_EQ(feature.dy(), features.dy()[i]);
+    EXPECT_EQ(feature.irls_weight(), features.irls_weight()[i]);
+    weight_sum += feature.irls_weight();
+  }
+  EXPECT_NEAR(weight_sum, features.IrlsWeightSum(), 1e-9);
+
+  for (int i = 0; i < features.size(); ++i) {
+    (*features.mutable_irls_weight())[i] = i;
+  }
+  features.CopyIrlsWeightsTo(&feature_list);
+  for (int i = 0; i < features.size(); ++i) {
+    EXPECT_EQ(i, feature_list.feature(i).irls_weight());
+  }
+
+  features.Assign(RegionFlowFeatureList());
+  EXPECT_EQ(0, features.size());
+}
+
+TEST(RegionFlowFeatureBufferTest, WeightedMeanFlow) {
+  std::mt19937 random(2);
+  RegionFlowFeatureList feature_list = RandomFeatures(100, &random);
+  double weight_sum = 0;
+  double dx_sum = 0;
+  double dy_sum = 0;
+  for (const auto& feature : feature_list.feature()) {
+    weight_sum += feature.irls_weight();
+    dx_sum += feature.dx() * feature.irls_weight();
+    dy_sum += feature.dy() * feature.irls_weight();
+  }
+  RegionFlowFeatureBuffer features(feature_list);
+  for (const Vector2_f& mean : {features.WeightedMeanFlow<float>(),
+                                features.WeightedMeanFlow<double>()}) {
+    EXPECT_NEAR(dx_sum / weight_sum, mean.x(), 1e-6);
+    EXPECT_NEAR(dy_sum / weight_sum, mean.y(), 1e-6);
+  }
+
+  for (auto& feature : *feature_list.mutable_feature()) {
+    feature.set_irls_weight(0);
+  }
+  features.Assign(feature_list);
+  EXPECT_EQ(Vector2_f(0, 0), features.WeightedMeanFlow<double>());
+}
+
+TEST(RegionFlowFeatureBufferTest, LinearSimilarityNormalEquations) {
+  std::mt19937 random(3);
+  RegionFlowFeatureList feature_list = RandomFeatures(100, &random);
+  Eigen::Matrix4d expected_matrix = Eigen::Matrix4d::Zero();
+  Eigen::Vector4d expected_rhs = Eigen::Vector4d::Zero();
+  for (const auto& feature : feature_list.feature()) {
+    const double x = feature.x();
+    const double y = feature.y();
+    Eigen::Matrix<double, 2, 4> jacobian;
+    jacobian << 1, 0, x, -y,  //
+        0, 1, y, x;
+    const Eigen::Vector2d b(feature.dx(), feature.dy());
+    expected_matrix += jacobian.transpose() * jacobian * feature.irls_weight();
+    expected_rhs += jacobian.transpose() * b * feature.irls_weight();
+  }
+
+  RegionFlowFeatureBuffer features(feature_list);
+  Eigen::Matrix4d matrix_d;
+  Eigen::Vector4d rhs_d;
+  features.LinearSimilarityNormalEquations(&matrix_d, &rhs_d);
+  EXPECT_TRUE(matrix_d.isApprox(expected_matrix, 1e-9));
+  EXPECT_TRUE(rhs_d.isApprox(expected_rhs, 1e-9));
+
+  Eigen::Matrix4f matrix_f;
+  Eigen::Vector4f rhs_f;
+  features.LinearSimilarityNormalEquations(&matrix_f, &rhs_f);
+  EXPECT_TRUE(matrix_f.cast<double>().isApprox(expected_matrix, 1e-5));
+  EXPECT_TRUE(rhs_f.cast<double>().isApprox(expected_rhs, 1e-5));
+}
+
+TEST(RegionFlowFeatureBufferTest, HomographyNormalEquations) {
+  std::mt19937 random(4);
+  RegionFlowFeatureList feature_list = RandomFeatures(100, &random);
+  RegionFlowFeatureBuffer features(feature_list);
+  Homography prev_solution;
+  prev_solution.set_h_20(0.1f);
+  prev_solution.set_h_21(-0.2f);
+  for (const Homography* prev : {static_cast<Homography*>(nullptr),
+                                 &prev_solution}) {
+    Eigen::Matrix<double, 8, 8> expected_matrix;
+    Eigen::Matrix<double, 8, 1> expected_rhs;
+    ReferenceHomographyNormalEquations(feature_list, prev, &expected_matrix,
+                                       &expected_rhs);
+
+    Eigen::Matrix<double, 8, 8> matrix_d;
+    Eigen::Matrix<double, 8, 1> rhs_d;
+    features.HomographyNormalEquations(prev, &matrix_d, &rhs_d);
+    EXPECT_TRUE(matrix_d.isApprox(expected_matrix, 1e-6));
+    EXPECT_TRUE(rhs_d.isApprox(expected_rhs, 1e-6));
+
+    Eigen::Matrix<float, 8, 8> matrix_f;
+    Eigen::Matrix<float, 8, 1> rhs_f;
+    features.HomographyNormalEquations(prev, &matrix_f, &rhs_f);
+    EXPECT_TRUE(matrix_f.cast<double>().isApprox(expected_matrix, 1e-5));
+    EXPECT_TRUE(rhs_f.cast<double>().isApprox(expected_rhs, 1e-5));
+  }
+}
+
+// Double sums back use_highest_accuracy_for_normal_equations and must match
+// the per-feature accumulation MotionEstimation used before the buffer
+// exactly, not only up to summation order.
+TEST(RegionFlowFeatureBufferTest, DoubleSumsKeepFeatureOrder) {
+  std::mt19937 random(7);
+  RegionFlowFeatureList feature_list = RandomFeatures(1000, &random);
+  RegionFlowFeatureBuffer features(feature_list);
+  Homography prev_solution;
+  prev_solution.set_h_20(0.1f);
+  prev_solution.set_h_21(-0.2f);
+
+  Vector2_d mean_flow(0, 0);
+  double weight_sum = 0;
+  Eigen::Matrix4d similarity_matrix = Eigen::Matrix4d::Zero();
+  Eigen::Vector4d similarity_rhs = Eigen::Vector4d::Zero();
+  Eigen::Matrix<double, 8, 8> homography_matrix =
+      Eigen::Matrix<double, 8, 8>::Zero();
+  Eigen::Matrix<double, 8, 1> homography_rhs =
+      Eigen::Matrix<double, 8, 1>::Zero();
+  for (const auto& feature : feature_list.feature()) {
+    mean_flow += Vector2_d(feature.dx(), feature.dy()) * feature.irls_weight();
+    weight_sum += feature.irls_weight();
+
+    const double x = feature.x();
+    const double y = feature.y();
+    double w = feature.irls_weight();
+    const double x_w = x * w;
+    const double y_w = y * w;
+    const double xx_yy_w = (x * x + y * y) * w;
+    Eigen::Matrix4d similarity;
+    similarity << w, 0, x_w, -y_w,  //
+        0, w, y_w, x_w,             //
+        x_w, y_w, xx_yy_w, 0,       //
+        -y_w, x_w, 0, xx_yy_w;
+    similarity_matrix += similarity;
+    const double m_x = feature.dx() * w;
+    const double m_y = feature.dy() * w;
+    similarity_rhs += Eigen::Vector4d(m_x, m_y, x * m_x + y * m_y,
+                                      -y * m_x + x * m_y);
+
+    const double denom = prev_solution.h_20() * feature.x() +
+                         prev_solution.h_21() * feature.y() + 1.0;
+    w = feature.irls_weight() * (1.0 / denom);
+    const double xw = x * w;
+    const double yw = y * w;
+    const double xxw = x * x * w;
+    const double yyw = y * y * w;
+    const double xyw = x * y * w;
+    const double mx = feature.x() + feature.dx();
+    const double my = feature.y() + feature.dy();
+    const double mxxyy = mx * mx + my * my;
+    Eigen::Matrix<double, 8, 8> homography;
+    homography << xxw, xyw, xw, 0, 0, 0, -xxw * mx, -xyw * mx,         //
+        xyw, yyw, yw, 0, 0, 0, -xyw * mx, -yyw * mx,                   //
+        xw, yw, w, 0, 0, 0, -xw * mx, -yw * mx,                        //
+        0, 0, 0, xxw, xyw, xw, -xxw * my, -xyw * my,                   //
+        0, 0, 0, xyw, yyw, yw, -xyw * my, -yyw * my,                   //
+        0, 0, 0, xw, yw, w, -xw * my, -yw * my,                        //
+        -xxw * mx, -xyw * mx, -xw * mx, -xxw * my, -xyw * my, -xw * my,  //
+        xxw * mxxyy, xyw * mxxyy,                                      //
+        -xyw * mx, -yyw * mx, -yw * mx, -xyw * my, -yyw * my, -yw * my,  //
+        xyw * mxxyy, yyw * mxxyy;
+    homography_matrix += homography;
+    Eigen::Matrix<double, 8, 1> homography_b;
+    homography_b << xw * mx, yw * mx, mx * w, xw * my, yw * my, my * w,
+        -xw * mxxyy, -yw * mxxyy;
+    homography_rhs += homography_b;
+  }
+  mean_flow *= 1.0 / weight_sum;
+
+  EXPECT_EQ(weight_sum, features.IrlsWeightSum());
+  EXPECT_EQ(Vector2_f::Cast(mean_flow), features.WeightedMeanFlow<double>());
+
+  Eigen::Matrix4d matrix_4;
+  Eigen::Vector4d rhs_4;
+  features.LinearSimilarityNormalEquations(&matrix_4, &rhs_4);
+  EXPECT_EQ(similarity_matrix, matrix_4);
+  EXPECT_EQ(similarity_rhs, rhs_4);
+
+  Eigen::Matrix<double, 8, 8> matrix_8;
+  Eigen::Matrix<double, 8, 1> rhs_8;
+  features.HomographyNormalEquations(&prev_solution, &matrix_8, &rhs_8);
+  EXPECT_EQ(homography_matrix, matrix_8);
+  EXPECT_EQ(homography_rhs, rhs_8);
+}
+
+// Measures the accumulation of the homography normal equations, done once
+// per IRLS round.
+template <class T>
+void BM_HomographyNormalEquations(benchmark::State& state) {
+  std::mt19937 random(5);
+  RegionFlowFeatureBuffer features(RandomFeatures(state.range(0), &random));
+  Eigen::Matrix<T, 8, 8> matrix;
+  Eigen::Matrix<T, 8, 1> rhs;
+  for (auto _ : state) {
+    features.HomographyNormalEquations(nullptr, &matrix, &rhs);
+    benchmark::DoNotOptimize(matrix.data());
+  }
+}
+BENCHMARK_TEMPLATE(BM_HomographyNormalEquations, float)
+    ->Arg(200)
+    ->Arg(2000);
+BENCHMARK_TEMPLATE(BM_HomographyNormalEquations, double)
+    ->Arg(200)
+    ->Arg(2000);
+
+// Measures the conversion of a feature list.
+void BM_Assign(benchmark::State& state) {
+  std::mt19937 random(6);
+  const RegionFlowFeatureList feature_list =
+      RandomFeatures(state.range(0), &random);
+  RegionFlowFeatureBuffer features;
+  for (auto _ : state) {
+    features.Assign(feature_list);
+    benchmark::DoNotOptimize(features.x().data());
+  }
+}
+BENCHMARK(BM_Assign)->Arg(200)->Arg(2000);
+
+}  // namespace
+}  // namespace mediapipe
@@ -0,0 +1,131 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/tracking/tracking_data_chunk_cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/string_view.h"
+#include "mediapipe/framework/port/logging.h"
+
+namespace mediapipe {
+
+namespace {
+
+// Maps the file at path read-only. Returns false if it can not be mapped.
+bool MapFile(const std::string& path, std::shared_ptr<const char>* mapping,
+             absl::string_view* data) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(ERROR) << "Could not open chunk file: " << path;
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    LOG(ERROR) << "Empty or unreadable chunk file: " << path;
+    close(fd);
+    return false;
+  }
+
+  const size_t size = file_stat.st_size;
+  void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    LOG(ERROR) << "Could not map chunk file: " << path;
+    return false;
+  }
+
+  mapping->reset(static_cast<const char*>(mapped), [size](const char* ptr) {
+    munmap(const_cast<char*>(ptr), size);
+  });
+  *data = absl::string_view(mapping->get(), size);
+  return true;
+}
+
+}  // namespace.
+
+std::unique_ptr<TrackingDataChunk> ReadTrackingDataChunkFile(
+    const std::string& path) {
+  std::shared_ptr<const char> mapping;
+  absl::string_view data;
+  if (!MapFile(path, &mapping, &data)) {
+    return nullptr;
+  }
+
+  auto chunk = absl::make_unique<TrackingDataChunk>();
+  if (!chunk->ParseFromArray(data.data(), data.size())) {
+    LOG(ERROR) << "Could not parse chunk file: " << path;
+    return nullptr;
+  }
+  return chunk;
+}
+
+TrackingDataChunkCache::ChunkPtr TrackingDataChunkCache::Lookup(
+    int chunk_idx) {
+  absl::MutexLock lock(&mutex_);
+  return LookupMutexHeld(chunk_idx);
+}
+
+TrackingDataChunkCache::ChunkPtr TrackingDataChunkCache::GetOrLoad(
+    int chunk_idx, const std::function<ChunkPtr()>& load) {
+  {
+    absl::MutexLock lock(&mutex_);
+    while (true) {
+      ChunkPtr chunk = LookupMutexHeld(chunk_idx);
+      if (chunk) {
+        return chunk;
+      }
+      if (loading_.insert(chunk_idx).second) {
+        break;
+      }
+      // Wait for the ongoing load, retry if it failed or was not cached.
+      loaded_.Wait(&mutex_);
+    }
+  }
+
+  ChunkPtr chunk = load();
+
+  // Evicted chunks are released after the mutex.
+  std::vector<ChunkPtr> evicted;
+  absl::MutexLock lock(&mutex_);
+  loading_.erase(chunk_idx);
+  loaded_.SignalAll();
+  if (chunk && capacity_ > 0) {
+    lru_.emplace_front(chunk_idx, chunk);
+    entries_[chunk_idx] = lru_.begin();
+    while (lru_.size() > capacity_) {
+      evicted.push_back(std::move(lru_.back().second));
+      entries_.erase(lru_.back().first);
+      lru_.pop_back();
+    }
+  }
+  return chunk;
+}
+
+TrackingDataChunkCache::ChunkPtr TrackingDataChunkCache::LookupMutexHeld(
+    int chunk_idx) {
+  auto entry = entries_.find(chunk_idx);
+  if (entry == entries_.end()) {
+    return nullptr;
+  }
+  lru_.splice(lru_.begin(), lru_, entry->second);
+  return entry->second->second;
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,79 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_UTIL_TRACKING_TRACKING_DATA_CHUNK_CACHE_H_
+#define MEDIAPIPE_UTIL_TRACKING_TRACKING_DATA_CHUNK_CACHE_H_
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/util/tracking/flow_packager.pb.h"
+
+namespace mediapipe {
+
+// Reads the serialized TrackingDataChunk file at path, as written by
+// FlowPackagerCalculator. Returns nullptr if the file can not be read or
+// parsed.
+std::unique_ptr<TrackingDataChunk> ReadTrackingDataChunkFile(
+    const std::string& path);
+
+// Thread-safe cache of the least recently used TrackingDataChunks, keyed by
+// chunk index.
+class TrackingDataChunkCache {
+ public:
+  typedef std::shared_ptr<const TrackingDataChunk> ChunkPtr;
+
+  // Retains up to capacity chunks, a capacity of zero disables caching.
+  explicit TrackingDataChunkCache(int capacity) : capacity_(capacity) {}
+
+  TrackingDataChunkCache(const TrackingDataChunkCache&) = delete;
+  TrackingDataChunkCache& operator=(const TrackingDataChunkCache&) = delete;
+
+  // Returns the cached chunk at chunk_idx, or nullptr if it is not cached.
+  ChunkPtr Lookup(int chunk_idx) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the chunk at chunk_idx, obtaining it from load if it is not
+  // cached. Concurrent calls for the same chunk_idx wait for a single load.
+  // Chunks that failed to load (nullptr) are not cached.
+  ChunkPtr GetOrLoad(int chunk_idx, const std::function<ChunkPtr()>& load)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  typedef std::list<std::pair<int, ChunkPtr>> LruList;
+
+  // Returns the cached chunk and marks it as most recently used.
+  ChunkPtr LookupMutexHeld(int chunk_idx)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const int capacity_;
+
+  absl::Mutex mutex_;
+  // Cached chunks, most recently used first.
+  LruList lru_ ABSL_GUARDED_BY(mutex_);
+  std::unordered_map<int, LruList::iterator> entries_ ABSL_GUARDED_BY(mutex_);
+  // Chunks currently being loaded.
+  std::unordered_set<int> loading_ ABSL_GUARDED_BY(mutex_);
+  absl::CondVar loaded_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_TRACKING_TRACKING_DATA_CHUNK_CACHE_H_
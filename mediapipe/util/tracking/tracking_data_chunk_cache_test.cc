@@ -0,0 +1,188 @@
+// Copyright 2019 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/tracking/tracking_data_chunk_cache.h"
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <random>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/deps/file_path.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/file_helpers.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/threadpool.h"
+#include "mediapipe/util/tracking/flow_packager.h"
+#include "mediapipe/util/tracking/region_flow.pb.h"
+
+namespace mediapipe {
+namespace {
+
+typedef TrackingDataChunkCache::ChunkPtr ChunkPtr;
+
+// Returns a chunk of num_items frames, 33 msec apart, with the packed flow of
+// num_features random features each.
+TrackingDataChunk RandomChunk(int num_items, int num_features,
+                              std::mt19937* random) {
+  std::uniform_real_distribution<float> x(0.0f, 640.0f);
+  std::uniform_real_distribution<float> y(0.0f, 480.0f);
+  std::uniform_real_distribution<float> flow(-5.0f, 5.0f);
+  FlowPackager packager((FlowPackagerOptions()));
+  TrackingDataChunk chunk;
+  chunk.set_first_chunk(true);
+  for (int i = 0; i < num_items; ++i) {
+    RegionFlowFeatureList feature_list;
+    feature_list.set_frame_width(640);
+    feature_list.set_frame_height(480);
+    for (int j = 0; j < num_features; ++j) {
+      RegionFlowFeature* feature = feature_list.add_feature();
+      feature->set_x(x(*random));
+      feature->set_y(y(*random));
+      feature->set_dx(flow(*random));
+      feature->set_dy(flow(*random));
+    }
+    TrackingDataChunk::Item* item = chunk.add_item();
+    packager.PackFlow(feature_list, nullptr, item->mutable_tracking_data());
+    item->set_frame_idx(i);
+    item->set_timestamp_usec(i * 33000);
+    item->set_prev_timestamp_usec(i > 0 ? (i - 1) * 33000 : 0);
+  }
+  return chunk;
+}
+
+std::string WriteChunkFile(const std::string& name, const std::string& data) {
+  const std::string path = file::JoinPath(getenv("TEST_TMPDIR"), name);
+  MEDIAPIPE_CHECK_OK(file::SetContents(path, data));
+  return path;
+}
+
+TEST(TrackingDataChunkCacheTest, ReadsSerializedChunk) {
+  std::mt19937 random(2);
+  const TrackingDataChunk chunk = RandomChunk(5, 100, &random);
+  const std::string path =
+      WriteChunkFile("serialized_chunk", chunk.SerializeAsString());
+
+  std::unique_ptr<TrackingDataChunk> read_chunk =
+      ReadTrackingDataChunkFile(path);
+  ASSERT_TRUE(read_chunk != nullptr);
+  EXPECT_EQ(chunk.SerializeAsString(), read_chunk->SerializeAsString());
+}
+
+TEST(TrackingDataChunkCacheTest, RejectsInvalidChunkFile) {
+  EXPECT_TRUE(ReadTrackingDataChunkFile(file::JoinPath(
+                  getenv("TEST_TMPDIR"), "missing_chunk")) == nullptr);
+  EXPECT_TRUE(ReadTrackingDataChunkFile(WriteChunkFile("empty_chunk", "")) ==
+              nullptr);
+
+  std::mt19937 random(3);
+  const std::string data = RandomChunk(5, 100, &random).SerializeAsString();
+  const std::string path =
+      WriteChunkFile("truncated_chunk", data.substr(0, data.size() - 13));
+  EXPECT_TRUE(ReadTrackingDataChunkFile(path) == nullptr);
+}
+
+TEST(TrackingDataChunkCacheTest, RetainsLeastRecentlyUsedChunks) {
+  TrackingDataChunkCache cache(2);
+  int num_loads = 0;
+  auto load = [&num_loads]() -> ChunkPtr {
+    ++num_loads;
+    return std::make_shared<TrackingDataChunk>();
+  };
+
+  ChunkPtr chunk_0 = cache.GetOrLoad(0, load);
+  ChunkPtr chunk_1 = cache.GetOrLoad(1, load);
+  EXPECT_EQ(2, num_loads);
+  EXPECT_EQ(chunk_0, cache.GetOrLoad(0, load));
+  EXPECT_EQ(2, num_loads);
+
+  // Chunk 1 is the least recently used one.
+  cache.GetOrLoad(2, load);
+  EXPECT_EQ(3, num_loads);
+  EXPECT_EQ(chunk_0, cache.Lookup(0));
+  EXPECT_TRUE(cache.Lookup(1) == nullptr);
+  EXPECT_TRUE(cache.Lookup(2) != nullptr);
+
+  // Failed loads are not cached.
+  EXPECT_TRUE(cache.GetOrLoad(3, []() { return nullptr; }) == nullptr);
+  EXPECT_TRUE(cache.Lookup(3) == nullptr);
+  EXPECT_TRUE(cache.Lookup(2) != nullptr);
+
+  TrackingDataChunkCache disabled_cache(0);
+  disabled_cache.GetOrLoad(0, load);
+  disabled_cache.GetOrLoad(0, load);
+  EXPECT_EQ(5, num_loads);
+  EXPECT_TRUE(disabled_cache.Lookup(0) == nullptr);
+}
+
+TEST(TrackingDataChunkCacheTest, LoadsConcurrentlyRequestedChunkOnce) {
+  constexpr int kNumRequests = 8;
+  TrackingDataChunkCache cache(4);
+  std::atomic<int> num_loads(0);
+  std::atomic<int> num_loaded(0);
+  {
+    ThreadPool pool(kNumRequests);
+    pool.StartWorkers();
+    for (int k = 0; k < kNumRequests; ++k) {
+      pool.Schedule([&cache, &num_loads, &num_loaded]() {
+        ChunkPtr chunk = cache.GetOrLoad(7, [&num_loads]() {
+          ++num_loads;
+          absl::SleepFor(absl::Milliseconds(20));
+          return std::make_shared<TrackingDataChunk>();
+        });
+        if (chunk) {
+          ++num_loaded;
+        }
+      });
+    }
+  }
+  EXPECT_EQ(1, num_loads);
+  EXPECT_EQ(kNumRequests, num_loaded);
+}
+
+// Measures reading a serialized chunk of 75 frames (2.5 seconds at 30 fps)
+// with range(0) features each.
+void BM_ReadChunk(benchmark::State& state) {
+  std::mt19937 random(4);
+  const std::string path = WriteChunkFile(
+      "bm_chunk", RandomChunk(75, state.range(0), &random).SerializeAsString());
+  for (auto _ : state) {
+    std::unique_ptr<TrackingDataChunk> read_chunk =
+        ReadTrackingDataChunkFile(path);
+    benchmark::DoNotOptimize(read_chunk.get());
+  }
+}
+BENCHMARK(BM_ReadChunk)->Arg(200)->Arg(1000);
+
+// Measures obtaining a cached chunk.
+void BM_CachedChunk(benchmark::State& state) {
+  TrackingDataChunkCache cache(4);
+  auto load = []() { return std::make_shared<TrackingDataChunk>(); };
+  for (int k = 0; k < 4; ++k) {
+    cache.GetOrLoad(k, load);
+  }
+  int k = 0;
+  for (auto _ : state) {
+    ChunkPtr chunk = cache.GetOrLoad(k, load);
+    benchmark::DoNotOptimize(chunk.get());
+    k = (k + 1) % 4;
+  }
+}
+BENCHMARK(BM_CachedChunk);
+
+}  // namespace
+}  // namespace mediapipe